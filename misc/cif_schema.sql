@@ -251,16 +251,36 @@ create index ix1_loop_item
 -- serialized list or table for kinds 2 and 3, respectively.  Both val and
 -- val_text are NULL for kinds 4 and 5.
 -- 
--- For kind 1, val_digits and su_digits record decimal digit-string
--- representations of the value and its standard uncertainty, with the
--- rightmost digit of each being interpreted as appearing in the
--- 10^(-scale) position.  These support arbitrary-precision fixed point
--- numbers of any scale expressible in CIF, but not necessarily in the
--- floating-point or integer format in which the DB stores numeric values.
--- su_digits is NULL for exact numbers.  The sign associated with the
--- (digit string, scale) representation of the value is taken from the
--- beginning of value_text; there is no separate field for it.
--- These fields are null for kinds other than 1.
+-- For kind 1, val_digits and su_digits record the digits of the value and
+-- its standard uncertainty, with the rightmost digit of each being
+-- interpreted as appearing in the 10^(-scale) position.  Where they fit,
+-- the digits are stored compactly as integers (signed, in the case of
+-- val_digits); otherwise they are stored as decimal digit strings.  The
+-- latter support arbitrary-precision fixed point numbers of any scale
+-- expressible in CIF, but not necessarily in the floating-point or integer
+-- format in which the DB stores numeric values.  su_digits is NULL for
+-- exact numbers.  These fields are null for kinds other than 0 and 1, and
+-- for kind 0 except as described below.
+--
+-- For kind 0, text_class records a summary of the value text's composition,
+-- computed when the value is stored, from which the CIF writer chooses the
+-- value's delimiters without rescanning the text (see
+-- cif_text_class_internal()).  It is NULL for other kinds, and may be NULL
+-- for kind 0, in which case the writer analyzes the text itself.
+--
+-- For kind 1, val_text may be NULL when val_digits is an integer and the
+-- value text is exactly the plain decimal form that the library produces
+-- from the digits, uncertainty, and scale; the text is then reconstructed
+-- on retrieval, and the sign of the value is that of val_digits.
+-- Otherwise, the sign associated with the (digits, scale) representation
+-- of the value is taken from the beginning of val_text.
+--
+-- Kind 0 values whose text is such a plain decimal, with value and
+-- uncertainty digits that fit in integers, are stored in the same compact
+-- form: val_text is NULL, and val_digits, su_digits, and scale are
+-- integers from which the text is reconstructed on retrieval.  For all
+-- other kind 0 values val_text is not NULL, and val_digits, su_digits, and
+-- scale are NULL.
 --
 -- IMPORTANT: If the precision or scale of a numeric CIF value exceeds that
 -- representable in the floating-point format used by the DB engine (8-byte
@@ -307,10 +327,14 @@ create table item_value (
   val numeric,
   -- specific to kinds 0 and 1:
   val_text varchar(80),
-  -- specific to kind 1:
-  val_digits varchar(15),
-  su_digits varchar(15),
+  -- specific to kind 1, and to compactly stored kind 0 values (no
+  -- declared types, so that integers and digit strings are each stored as
+  -- given; the check constraints below restrict their types):
+  val_digits,
+  su_digits,
   scale integer(4),
+  -- specific to kind 0:
+  text_class integer,
   
   primary key (container_id, name, row_num),
   foreign key (container_id, name)
@@ -318,10 +342,22 @@ create table item_value (
     on delete cascade,
   check (row_num > 0),
   check (case when (val is null) then kind in (4, 5) else kind in (0, 1, 2, 3) end),
-  check ((val_text is null) = (kind not in (0, 1))),
-  check (case when (kind = 1) then (scale is not null)
-        and (length(val_digits) > 0) and (val_digits not glob '*[^0-9]*')
-        and ((su_digits is null) or ((length(su_digits) > 0) and (su_digits not glob '*[^0-9]*')))
-      else (coalesce(val_digits, su_digits, scale) is null) end)
+  -- compactly stored values (see above) have integer digits and no text
+  check (case when (kind = 0) and (val_text is not null)
+        then (coalesce(val_digits, su_digits, scale) is null)
+      when (kind = 0) then (typeof(val_digits) = 'integer') and (typeof(su_digits) in ('integer', 'null'))
+      when (kind = 1) then (val_text is not null) or (typeof(val_digits) = 'integer')
+      else (coalesce(val_text, val_digits, su_digits, scale) is null) end),
+  check (case when (val_digits is null) then 1
+      else (typeof(scale) = 'integer')
+        and (case typeof(val_digits) when 'integer' then 1
+            when 'text' then (length(val_digits) > 0) and (val_digits not glob '*[^0-9]*')
+            else 0 end)
+        and (case typeof(su_digits) when 'null' then 1
+            when 'integer' then (su_digits >= 0)
+            when 'text' then (length(su_digits) > 0) and (su_digits not glob '*[^0-9]*')
+            else 0 end) end),
+  check ((kind != 1) or (val_digits is not null)),
+  check ((kind = 0) or (text_class is null))
 );
 
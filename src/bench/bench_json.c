@@ -0,0 +1,133 @@
+/*
+ * bench_json.c
+ *
+ * Times writing a generated managed CIF as CIF text and as CIF-JSON, and reading each form back into a new managed
+ * CIF via cif_parse() and cif_parse_json(), respectively.
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "../cif.h"
+
+#define DEFAULT_REPETITIONS 5
+#define NUM_ATOMS 2000
+
+/* the forms measured */
+#define CIF_TEXT 0
+#define CIF_JSON 1
+
+static const char * const FORM_NAMES[] = { "CIF", "CIF-JSON" };
+
+/* writes a CIF having a few scalar items and a loop of NUM_ATOMS packets, to a new temporary stream */
+static FILE *write_input(void) {
+    FILE *stream = tmpfile();
+    int i;
+
+    if (stream != NULL) {
+        fputs("#\\#CIF_2.0\ndata_structure\n_cell.length_a 10.512(2)\n_cell.length_b 12.5(1)\n_cell.angle_beta 90\n"
+                "_symmetry.ops ['x,y,z' '-x,y+1/2,-z']\n_refine.details {'method':'full-matrix' 'cycles':12}\n"
+                "_exptl.details\n;\nCrystal grown by slow evaporation\nfrom a mixture of solvents.\n;\n"
+                "loop_\n_atom_site.id\n_atom_site.type_symbol\n_atom_site.label_atom_id\n_atom_site.Cartn_x\n"
+                "_atom_site.Cartn_y\n_atom_site.Cartn_z\n_atom_site.occupancy\n_atom_site.B_iso_or_equiv\n", stream);
+        for (i = 0; i < NUM_ATOMS; i += 1) {
+            fprintf(stream, "%d C CA %d.%03d %d.%03d -%d.%03d 1.00 %d.%02d\n", i + 1, i % 97, i % 1000, i % 89,
+                    (i * 7) % 1000, i % 83, (i * 13) % 1000, 10 + i % 50, i % 100);
+        }
+        rewind(stream);
+    }
+
+    return stream;
+}
+
+/* reads the specified stream in the specified form into a new CIF, which is then destroyed; returns a CIF API code */
+static int read_form(FILE *stream, int form) {
+    cif_tp *cif = NULL;
+    int result = ((form == CIF_JSON) ? cif_parse_json(stream, &cif) : cif_parse(stream, NULL, &cif));
+
+    if ((cif != NULL) && (cif_destroy(cif) != CIF_OK) && (result == CIF_OK)) {
+        result = CIF_ERROR;
+    }
+
+    return result;
+}
+
+int main(int argc, char *argv[]) {
+    int repetitions = ((argc > 1) ? atoi(argv[1]) : DEFAULT_REPETITIONS);
+    FILE *input = write_input();
+    FILE *output[2];
+    struct cif_write_opts_s *options[2] = { NULL, NULL };
+    double best_write[2] = { -1.0, -1.0 };
+    double best_read[2] = { -1.0, -1.0 };
+    long bytes[2] = { 0, 0 };
+    cif_tp *cif = NULL;
+    int form;
+    int rep;
+
+    output[CIF_TEXT] = tmpfile();
+    output[CIF_JSON] = tmpfile();
+    if ((input == NULL) || (output[CIF_TEXT] == NULL) || (output[CIF_JSON] == NULL)
+            || (cif_parse(input, NULL, &cif) != CIF_OK) || (cif_write_options_create(&options[CIF_JSON]) != CIF_OK)) {
+        fputs("bench_json: setup failed\n", stderr);
+        return 1;
+    }
+    fclose(input);
+    options[CIF_JSON]->json = 1;
+
+    for (rep = 0; rep < repetitions; rep += 1) {
+        for (form = 0; form < 2; form += 1) {
+            clock_t start;
+            double seconds;
+
+            rewind(output[form]);
+            start = clock();
+            if (cif_write(output[form], options[form], cif) != CIF_OK) {
+                fprintf(stderr, "bench_json: writing %s failed\n", FORM_NAMES[form]);
+                return 1;
+            }
+            seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+            bytes[form] = ftell(output[form]);
+            if ((best_write[form] < 0) || (seconds < best_write[form])) {
+                best_write[form] = seconds;
+            }
+
+            rewind(output[form]);
+            start = clock();
+            if (read_form(output[form], form) != CIF_OK) {
+                fprintf(stderr, "bench_json: reading %s failed\n", FORM_NAMES[form]);
+                return 1;
+            }
+            seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+            if ((best_read[form] < 0) || (seconds < best_read[form])) {
+                best_read[form] = seconds;
+            }
+        }
+    }
+
+    for (form = 0; form < 2; form += 1) {
+        printf("%s: %ld bytes, best of %d: write %.3f s, read %.3f s\n", FORM_NAMES[form], bytes[form], repetitions,
+                best_write[form], best_read[form]);
+        fclose(output[form]);
+    }
+    free(options[CIF_JSON]);
+
+    return (cif_destroy(cif) != CIF_OK);
+}
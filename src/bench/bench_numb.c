@@ -0,0 +1,104 @@
+/*
+ * bench_numb.c
+ *
+ * Times conversions between doubles and the decimal representation of numeric values: cif_value_init_numb() and
+ * cif_value_get_number().
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "../cif.h"
+
+#define DEFAULT_REPETITIONS 5
+#define NUM_VALUES 1000
+#define NUM_CALLS 2000000L
+
+/* the number and scale of input i; the inputs span several magnitudes, with between 0 and 8 decimal places */
+#define INPUT_NUMBER(i) ((((i) % 100003) / 7.0) * ((((i) % 3) == 0) ? 1e-3 : 1.0))
+#define INPUT_SCALE(i) ((int) ((i) % 9))
+
+int main(int argc, char *argv[]) {
+    int repetitions = ((argc > 1) ? atoi(argv[1]) : DEFAULT_REPETITIONS);
+    cif_value_tp *values[NUM_VALUES];
+    cif_value_tp *scratch = NULL;
+    double best_init = -1.0;
+    double best_get = -1.0;
+    double sum = 0.0;
+    int rep;
+    long i;
+
+    /* values for cif_value_get_number() to convert back */
+    for (i = 0; i < NUM_VALUES; i += 1) {
+        values[i] = NULL;
+        if ((cif_value_create(CIF_UNK_KIND, values + i) != CIF_OK)
+                || (cif_value_init_numb(values[i], INPUT_NUMBER(i * 7919), 0.0, INPUT_SCALE(i), 5) != CIF_OK)) {
+            fputs("bench_numb: setup failed\n", stderr);
+            return 1;
+        }
+    }
+    if (cif_value_create(CIF_UNK_KIND, &scratch) != CIF_OK) {
+        fputs("bench_numb: setup failed\n", stderr);
+        return 1;
+    }
+
+    for (rep = 0; rep < repetitions; rep += 1) {
+        clock_t start = clock();
+        double seconds;
+
+        for (i = 0; i < NUM_CALLS; i += 1) {
+            if (cif_value_init_numb(scratch, INPUT_NUMBER(i), 0.0, INPUT_SCALE(i), 5) != CIF_OK) {
+                fputs("bench_numb: cif_value_init_numb() failed\n", stderr);
+                return 1;
+            }
+        }
+        seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+        if ((best_init < 0) || (seconds < best_init)) {
+            best_init = seconds;
+        }
+
+        start = clock();
+        for (i = 0; i < NUM_CALLS; i += 1) {
+            double number;
+
+            if (cif_value_get_number(values[i % NUM_VALUES], &number) != CIF_OK) {
+                fputs("bench_numb: cif_value_get_number() failed\n", stderr);
+                return 1;
+            }
+            sum += number;
+        }
+        seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+        if ((best_get < 0) || (seconds < best_get)) {
+            best_get = seconds;
+        }
+    }
+
+    printf("cif_value_init_numb: %ld calls, best of %d: %.3f s\n", NUM_CALLS, repetitions, best_init);
+    printf("cif_value_get_number: %ld calls, best of %d: %.3f s (checksum %g)\n", NUM_CALLS, repetitions, best_get,
+            sum);
+
+    cif_value_free(scratch);
+    for (i = 0; i < NUM_VALUES; i += 1) {
+        cif_value_free(values[i]);
+    }
+
+    return 0;
+}
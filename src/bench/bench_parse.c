@@ -0,0 +1,119 @@
+/*
+ * bench_parse.c
+ *
+ * Times parsing a CIF through a handler that only visits the data items, without building a target CIF.
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "../cif.h"
+
+#define DEFAULT_REPETITIONS 5
+#define NUM_BLOCKS 200
+#define NUM_ITEMS 100
+#define NUM_ROWS 200
+
+/*
+ * Writes a CIF 2.0 document of NUM_BLOCKS blocks, each having NUM_ITEMS unlooped items of assorted forms and one
+ * NUM_ROWS-packet loop, to the specified stream.
+ */
+static void write_input(FILE *stream) {
+    int block;
+
+    fputs("#\\#CIF_2.0\n", stream);
+    for (block = 0; block < NUM_BLOCKS; block += 1) {
+        int i;
+
+        fprintf(stream, "data_block%d\n", block);
+        for (i = 0; i < NUM_ITEMS; i += 1) {
+            switch (i % 4) {
+                case 0:
+                    fprintf(stream, "_item.number_%d %d.%04d(%d)\n", i, block + i, i * 7, i % 9 + 1);
+                    break;
+                case 1:
+                    fprintf(stream, "_item.quoted_%d 'value %d of block %d'\n", i, i, block);
+                    break;
+                case 2:
+                    fprintf(stream, "_item.list_%d [%d %d.5 'three' ?]\n", i, i, block);
+                    break;
+                default:
+                    fprintf(stream, "_item.table_%d {'a':%d 'b':'x%d'}\n", i, i, block);
+                    break;
+            }
+        }
+        fputs("loop_\n_atom.label\n_atom.type\n_atom.x\n_atom.y\n_atom.z\n_atom.occupancy\n", stream);
+        for (i = 0; i < NUM_ROWS; i += 1) {
+            fprintf(stream, "C%d C 0.%04d(3) 0.%04d(4) 0.%04d(5) 1.0\n", i, i * 37 % 10000, i * 53 % 10000,
+                    i * 71 % 10000);
+        }
+    }
+}
+
+static int count_item(UChar *name, cif_value_tp *value, void *context) {
+    (void) name;
+    (void) value;
+    *((long *) context) += 1;
+    return CIF_TRAVERSE_CONTINUE;
+}
+
+int main(int argc, char *argv[]) {
+    int repetitions = ((argc > 1) ? atoi(argv[1]) : DEFAULT_REPETITIONS);
+    struct cif_parse_opts_s *options = NULL;
+    cif_handler_tp handler = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+    FILE *stream = tmpfile();
+    double best = -1.0;
+    long items = 0;
+    int rep;
+
+    if ((stream == NULL) || (cif_parse_options_create(&options) != CIF_OK)) {
+        fputs("bench_parse: setup failed\n", stderr);
+        return 1;
+    }
+    write_input(stream);
+    handler.handle_item = count_item;
+    options->handler = &handler;
+    options->user_data = &items;
+
+    for (rep = 0; rep < repetitions; rep += 1) {
+        clock_t start;
+        double seconds;
+        int result;
+
+        rewind(stream);
+        items = 0;
+        start = clock();
+        result = cif_parse(stream, options, NULL);
+        seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+        if (result != CIF_OK) {
+            fprintf(stderr, "bench_parse: parse failed with code %d\n", result);
+            return 1;
+        }
+        if ((best < 0) || (seconds < best)) {
+            best = seconds;
+        }
+    }
+
+    printf("parse with handle_item, no target: %ld items reported, best of %d: %.3f s\n", items, repetitions, best);
+    free(options);
+    fclose(stream);
+    return 0;
+}
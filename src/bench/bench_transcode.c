@@ -0,0 +1,130 @@
+/*
+ * bench_transcode.c
+ *
+ * Times converting a generated CIF to formatted CIF output in two ways: by parsing it into a managed CIF and writing
+ * that via cif_write_to_sink(), and directly via cif_transcode().  The output is counted and discarded.
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "../cif.h"
+
+#define DEFAULT_REPETITIONS 5
+#define NUM_BLOCKS 4
+#define NUM_ATOMS 1000
+
+/* writes a CIF of NUM_BLOCKS blocks, each with a few items and a loop of NUM_ATOMS packets, to a new temporary stream */
+static FILE *write_input(void) {
+    FILE *stream = tmpfile();
+    int block;
+    int i;
+
+    if (stream != NULL) {
+        fputs("#\\#CIF_2.0\n", stream);
+        for (block = 0; block < NUM_BLOCKS; block += 1) {
+            fprintf(stream, "data_structure_%d\n_cell.length_a 10.%03d(2)\n_cell.length_b 12.5(1)\n"
+                    "_cell.angle_beta 90\n_symmetry.ops ['x,y,z' '-x,y+1/2,-z']\n"
+                    "_exptl.details\n;\nCrystal grown by slow evaporation\nfrom a mixture of solvents.\n;\n"
+                    "loop_\n_atom_site.id\n_atom_site.type_symbol\n_atom_site.label_atom_id\n"
+                    "_atom_site.Cartn_x\n_atom_site.Cartn_y\n_atom_site.Cartn_z\n_atom_site.occupancy\n",
+                    block, block);
+            for (i = 0; i < NUM_ATOMS; i += 1) {
+                fprintf(stream, "%d C CA %d.%03d %d.%03d -%d.%03d 1.00\n", i + 1, i % 97, i % 1000, i % 89,
+                        (i * 7) % 1000, i % 83, (i * 13) % 1000);
+            }
+        }
+    }
+
+    return stream;
+}
+
+/* a sink that discards its output, counting the bytes in the long to which the context points */
+static int count_bytes(void *context, const char *bytes, size_t count) {
+    (void) bytes;
+    *((long *) context) += (long) count;
+    return 0;
+}
+
+/* parses the input into a managed CIF and writes it out; returns the number of bytes written, or -1 on failure */
+static long parse_and_write(FILE *input) {
+    cif_tp *cif = NULL;
+    long bytes = 0;
+
+    if ((cif_parse(input, NULL, &cif) != CIF_OK) || (cif_write_to_sink(count_bytes, &bytes, NULL, cif) != CIF_OK)) {
+        bytes = -1;
+    }
+    if ((cif != NULL) && (cif_destroy(cif) != CIF_OK)) {
+        bytes = -1;
+    }
+
+    return bytes;
+}
+
+/* transcodes the input directly; returns the number of bytes written, or -1 on failure */
+static long transcode(FILE *input) {
+    long bytes = 0;
+
+    return ((cif_transcode(input, NULL, count_bytes, &bytes, NULL) == CIF_OK) ? bytes : -1);
+}
+
+int main(int argc, char *argv[]) {
+    int repetitions = ((argc > 1) ? atoi(argv[1]) : DEFAULT_REPETITIONS);
+    FILE *input = write_input();
+    double best[2] = { -1.0, -1.0 };
+    long bytes[2] = { 0, 0 };
+    long input_bytes;
+    int rep;
+
+    if ((input == NULL) || ((input_bytes = ftell(input)) <= 0)) {
+        fputs("bench_transcode: setup failed\n", stderr);
+        return 1;
+    }
+
+    for (rep = 0; rep < repetitions; rep += 1) {
+        int variant;
+
+        for (variant = 0; variant < 2; variant += 1) {
+            clock_t start;
+            double seconds;
+
+            rewind(input);
+            start = clock();
+            bytes[variant] = ((variant == 0) ? parse_and_write(input) : transcode(input));
+            seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+            if (bytes[variant] < 0) {
+                fputs("bench_transcode: conversion failed\n", stderr);
+                return 1;
+            }
+            if ((best[variant] < 0) || (seconds < best[variant])) {
+                best[variant] = seconds;
+            }
+        }
+    }
+    fclose(input);
+
+    printf("Parse, then cif_write_to_sink(): %ld bytes in, %ld bytes out, best of %d: %.3f s (%.2f MB/s)\n",
+            input_bytes, bytes[0], repetitions, best[0], (best[0] > 0) ? (input_bytes / best[0] / 1e6) : 0.0);
+    printf("cif_transcode(): %ld bytes in, %ld bytes out, best of %d: %.3f s (%.2f MB/s)\n",
+            input_bytes, bytes[1], repetitions, best[1], (best[1] > 0) ? (input_bytes / best[1] / 1e6) : 0.0);
+
+    return 0;
+}
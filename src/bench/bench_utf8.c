@@ -0,0 +1,213 @@
+/*
+ * bench_utf8.c
+ *
+ * Times a binding-style workload, in which the client's strings are UTF-8: looking up a block and the texts of its
+ * items, once through the UTF-16 functions with the client transcoding names and texts, and once through the UTF-8
+ * variants of the same functions.
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unicode/ustring.h>
+#include "../cif.h"
+
+#define DEFAULT_REPETITIONS 5
+#define NUM_ITEMS 40
+#define NUM_PASSES 5000
+#define NAME_SIZE 32
+#define TEXT_SIZE 64
+
+/* the block code, in a case different from that with which the block is created */
+static const char BLOCK_CODE[] = "DATA_1";
+
+/* converts the specified UTF-8 string to UTF-16 in newly-allocated space, as a binding would; returns NULL on error */
+static UChar *to_utf16(const char *s) {
+    UErrorCode error = U_ZERO_ERROR;
+    int32_t length;
+    UChar *result;
+
+    u_strFromUTF8(NULL, 0, &length, s, -1, &error);
+    error = U_ZERO_ERROR;
+    if ((result = (UChar *) malloc((length + 1) * sizeof(UChar))) != NULL) {
+        u_strFromUTF8(result, length + 1, NULL, s, -1, &error);
+        if (U_FAILURE(error)) {
+            free(result);
+            result = NULL;
+        }
+    }
+
+    return result;
+}
+
+/* converts the specified UTF-16 string to UTF-8 in newly-allocated space, as a binding would; returns NULL on error */
+static char *to_utf8(const UChar *s) {
+    UErrorCode error = U_ZERO_ERROR;
+    int32_t length;
+    char *result;
+
+    u_strToUTF8(NULL, 0, &length, s, -1, &error);
+    error = U_ZERO_ERROR;
+    if ((result = (char *) malloc(length + 1)) != NULL) {
+        u_strToUTF8(result, length + 1, NULL, s, -1, &error);
+        if (U_FAILURE(error)) {
+            free(result);
+            result = NULL;
+        }
+    }
+
+    return result;
+}
+
+/* looks up the block and the texts of all its items via the UTF-16 functions; returns the number of bytes seen */
+static long run_utf16(cif_tp *cif, char names[][NAME_SIZE], cif_value_tp **value) {
+    UChar *code = to_utf16(BLOCK_CODE);
+    cif_block_tp *block = NULL;
+    long bytes = 0;
+    int i;
+
+    if ((code == NULL) || (cif_get_block(cif, code, &block) != CIF_OK)) {
+        free(code);
+        return -1;
+    }
+    free(code);
+    for (i = 0; i < NUM_ITEMS; i += 1) {
+        UChar *name = to_utf16(names[i]);
+        UChar *text = NULL;
+        char *text8 = NULL;
+
+        if ((name == NULL) || (cif_container_get_value(block, name, value) != CIF_OK)
+                || (cif_value_get_text(*value, &text) != CIF_OK) || ((text8 = to_utf8(text)) == NULL)) {
+            bytes = -1;
+        } else {
+            bytes += (long) strlen(text8);
+        }
+        free(name);
+        free(text);
+        free(text8);
+        if (bytes < 0) break;
+    }
+    cif_block_free(block);
+
+    return bytes;
+}
+
+/* looks up the block and the texts of all its items via the UTF-8 functions; returns the number of bytes seen */
+static long run_utf8(cif_tp *cif, char names[][NAME_SIZE], cif_value_tp **value) {
+    cif_block_tp *block = NULL;
+    long bytes = 0;
+    int i;
+
+    if (cif_get_block_utf8(cif, BLOCK_CODE, &block) != CIF_OK) {
+        return -1;
+    }
+    for (i = 0; i < NUM_ITEMS; i += 1) {
+        char *text8 = NULL;
+
+        if ((cif_container_get_value_utf8(block, names[i], value) != CIF_OK)
+                || (cif_value_get_text_utf8(*value, &text8) != CIF_OK)) {
+            bytes = -1;
+            break;
+        }
+        bytes += (long) strlen(text8);
+        free(text8);
+    }
+    cif_block_free(block);
+
+    return bytes;
+}
+
+int main(int argc, char *argv[]) {
+    int repetitions = ((argc > 1) ? atoi(argv[1]) : DEFAULT_REPETITIONS);
+    char names[NUM_ITEMS][NAME_SIZE];
+    cif_tp *cif = NULL;
+    cif_block_tp *block = NULL;
+    cif_value_tp *value = NULL;
+    UChar *code = to_utf16("Data_1");
+    double best[2] = { -1.0, -1.0 };
+    long bytes[2] = { 0, 0 };
+    int rep;
+    int i;
+
+    /* one block of NUM_ITEMS character values */
+    if ((code == NULL) || (cif_create(&cif) != CIF_OK) || (cif_create_block(cif, code, &block) != CIF_OK)
+            || (cif_value_create(CIF_UNK_KIND, &value) != CIF_OK)) {
+        fputs("bench_utf8: setup failed\n", stderr);
+        return 1;
+    }
+    free(code);
+    for (i = 0; i < NUM_ITEMS; i += 1) {
+        char text[TEXT_SIZE];
+        UChar *name;
+        UChar *text16;
+
+        sprintf(names[i], "_cell.Length_%d", i);
+        sprintf(text, "value text number %d", i);
+        if (((name = to_utf16(names[i])) == NULL) || ((text16 = to_utf16(text)) == NULL)
+                || (cif_value_copy_char(value, text16) != CIF_OK)
+                || (cif_container_set_value(block, name, value) != CIF_OK)) {
+            fputs("bench_utf8: setup failed\n", stderr);
+            return 1;
+        }
+        free(name);
+        free(text16);
+    }
+    cif_block_free(block);
+
+    for (rep = 0; rep < repetitions; rep += 1) {
+        int variant;
+
+        for (variant = 0; variant < 2; variant += 1) {
+            clock_t start = clock();
+            double seconds;
+            int pass;
+
+            bytes[variant] = 0;
+            for (pass = 0; pass < NUM_PASSES; pass += 1) {
+                long seen = ((variant == 0) ? run_utf16(cif, names, &value) : run_utf8(cif, names, &value));
+
+                if (seen < 0) {
+                    fputs("bench_utf8: lookup failed\n", stderr);
+                    return 1;
+                }
+                bytes[variant] += seen;
+            }
+            seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+            if ((best[variant] < 0) || (seconds < best[variant])) {
+                best[variant] = seconds;
+            }
+        }
+    }
+
+    printf("UTF-16 functions, client transcoding: %d block lookups of %d items, best of %d: %.3f s (%.2f us/item)\n",
+            NUM_PASSES, NUM_ITEMS, repetitions, best[0], best[0] * 1e6 / ((double) NUM_PASSES * NUM_ITEMS));
+    printf("UTF-8 functions: %d block lookups of %d items, best of %d: %.3f s (%.2f us/item)\n",
+            NUM_PASSES, NUM_ITEMS, repetitions, best[1], best[1] * 1e6 / ((double) NUM_PASSES * NUM_ITEMS));
+
+    cif_value_free(value);
+    if ((bytes[0] != bytes[1]) || (cif_destroy(cif) != CIF_OK)) {
+        fputs("bench_utf8: the two variants disagree\n", stderr);
+        return 1;
+    }
+
+    return 0;
+}
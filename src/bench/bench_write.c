@@ -0,0 +1,124 @@
+/*
+ * bench_write.c
+ *
+ * Times cif_write() on two generated CIFs, one dominated by a loop of many short tokens and one dominated by text
+ * fields, and reports the output rate of each in MB/s.
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include "../cif.h"
+
+#define DEFAULT_REPETITIONS 5
+#define NUM_ATOMS 20000
+#define NUM_TEXTS 2000
+#define TEXT_LINES 12
+
+/* writes a CIF having one loop of NUM_ATOMS packets of short tokens, to a new temporary stream */
+static FILE *write_tokens_input(void) {
+    FILE *stream = tmpfile();
+    int i;
+
+    if (stream != NULL) {
+        fputs("#\\#CIF_2.0\ndata_tokens\nloop_\n_atom_site.id\n_atom_site.type_symbol\n_atom_site.label_atom_id\n"
+                "_atom_site.label_comp_id\n_atom_site.Cartn_x\n_atom_site.Cartn_y\n_atom_site.Cartn_z\n"
+                "_atom_site.occupancy\n_atom_site.B_iso_or_equiv\n", stream);
+        for (i = 0; i < NUM_ATOMS; i += 1) {
+            fprintf(stream, "%d C CA ALA %d.%03d %d.%03d -%d.%03d 1.00 %d.%02d\n", i + 1, i % 97, i % 1000,
+                    i % 89, (i * 7) % 1000, i % 83, (i * 13) % 1000, 10 + i % 50, i % 100);
+        }
+        rewind(stream);
+    }
+
+    return stream;
+}
+
+/* writes a CIF having NUM_TEXTS items whose values are multi-line text fields, to a new temporary stream */
+static FILE *write_texts_input(void) {
+    FILE *stream = tmpfile();
+    int i;
+    int j;
+
+    if (stream != NULL) {
+        fputs("#\\#CIF_2.0\ndata_texts\n", stream);
+        for (i = 0; i < NUM_TEXTS; i += 1) {
+            fprintf(stream, "_text.item_%d\n;\n", i);
+            for (j = 0; j < TEXT_LINES; j += 1) {
+                fprintf(stream, "Line %d of the description of item %d, written out as a typical text field.\n",
+                        j, i);
+            }
+            fputs(";\n", stream);
+        }
+        rewind(stream);
+    }
+
+    return stream;
+}
+
+/* parses the specified CIF input and times writing it out; returns nonzero on failure */
+static int run(const char *label, FILE *input, int repetitions) {
+    cif_tp *cif = NULL;
+    FILE *output = tmpfile();
+    double best = -1.0;
+    long bytes = 0;
+    int rep;
+
+    if ((input == NULL) || (output == NULL) || (cif_parse(input, NULL, &cif) != CIF_OK)) {
+        fprintf(stderr, "bench_write: setup failed for the %s CIF\n", label);
+        return 1;
+    }
+    fclose(input);
+
+    for (rep = 0; rep < repetitions; rep += 1) {
+        clock_t start;
+        double seconds;
+
+        rewind(output);
+        start = clock();
+        if (cif_write(output, NULL, cif) != CIF_OK) {
+            fprintf(stderr, "bench_write: writing the %s CIF failed\n", label);
+            return 1;
+        }
+        seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+        bytes = ftell(output);
+        if ((best < 0) || (seconds < best)) {
+            best = seconds;
+        }
+    }
+    fclose(output);
+
+    printf("%s: %ld bytes written, best of %d: %.3f s (%.1f MB/s)\n", label, bytes, repetitions, best,
+            (best > 0) ? (bytes / best / 1e6) : 0.0);
+
+    return (cif_destroy(cif) != CIF_OK);
+}
+
+int main(int argc, char *argv[]) {
+    int repetitions = ((argc > 1) ? atoi(argv[1]) : DEFAULT_REPETITIONS);
+
+    if (run("Short tokens", write_tokens_input(), repetitions)
+            || run("Text fields", write_texts_input(), repetitions)) {
+        return 1;
+    }
+
+    return 0;
+}
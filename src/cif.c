@@ -27,6 +27,10 @@
 #include "internal/compat.h"
 
 #include <stddef.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+#include <assert.h>
 #include <sqlite3.h>
 
 /* For UChar: */
@@ -43,6 +47,97 @@
 
 #define INIT_STMT(cif, stmt_name) cif->stmt_name##_stmt = NULL
 
+/*
+ * The binary form of a CIF written by cif_write_binary() and read by cif_read_binary() mirrors the storage layer:
+ *
+ *   file:       BINARY_MAGIC, BINARY_FORMAT_VERSION, container*, varint 0
+ *   container:  varint id, varint parent id (0 for a data block), string code, string original code,
+ *               varint next loop number, loop*, varint 0
+ *   loop:       varint (loop number + 1), string category (null for none), varint last packet number, item*,
+ *               string null
+ *   item:       string name, string original name, value*, byte BINARY_END_COLUMN
+ *   value:      [byte BINARY_ROW_GAP, varint count of packets skipped], byte header, kind-specific properties
+ *
+ * Varints are unsigned LEB128; signed quantities are zigzag-encoded first.  Strings are dictionary-encoded as a varint
+ * v: zero denotes a null string, an odd v introduces a string not seen before, (v - 1) / 2 bytes of UTF-8 that follow,
+ * and an even v refers to the (v / 2)th string introduced.  The low three bits of a value header are the value kind,
+ * and for characters and numbers the BINARY_QUOTED bit records the quoted flag.  A character value carries its text,
+ * or, with BINARY_DECIMAL, an integer mantissa (zigzag varint) and scale (varint) from which its text is reproduced
+ * exactly, such as an unquoted "-12.50" parsed as characters; it then carries its text class unless BINARY_SAME_CLASS
+ * marks that as the same as that of the column's previous character value.  A number carries its text if that is not
+ * canonical, its value as an IEEE double (eight bytes, little-endian), the integer mantissa and standard uncertainty
+ * as zigzag varints or, where they do not fit in 64 bits, digit strings, and its scale; a list or table carries its
+ * serialized form as a varint byte count and the bytes.  The packet numbers of a column count from one; a gap marker
+ * precedes any value whose packet does not immediately follow the previous one.
+ *
+ * The reader does not trust its input: every count, length, and dictionary reference is checked against the data
+ * actually read and the limits of the storage layer, each name must be well-formed and consistent with its normalized
+ * form, and each list and table value is fully decoded before it is recorded, so that damaged input is rejected
+ * instead of producing a CIF that cannot be used.  Names are not otherwise validated: the writer saves whatever the
+ * CIF holds, including names recovered leniently from erroneous input, and the reader accepts them back.
+ */
+#define BINARY_MAGIC "CIFB"
+#define BINARY_FORMAT_VERSION 1
+#define BINARY_BUFFER_SIZE 65536
+#define BINARY_KIND_MASK 0x07
+#define BINARY_ROW_GAP 0x06
+#define BINARY_END_COLUMN 0x07
+#define BINARY_QUOTED 0x08
+#define BINARY_NUMB_TEXT 0x10
+#define BINARY_DIGITS_TEXT 0x20
+#define BINARY_SU_INTEGER 0x40
+#define BINARY_SU_TEXT 0x80
+#define BINARY_DECIMAL 0x10
+#define BINARY_SAME_CLASS 0x20
+#define BINARY_MAX_DECIMAL_DIGITS 18
+/* the bound on container IDs and packet numbers read, well clear of overflowing the 64-bit integers that store them */
+#define BINARY_MAX_ID (((sqlite3_uint64) 1) << 62)
+/* the text class bits that are ever set, and the largest delimiter code */
+#define BINARY_TEXT_CLASS_MASK 0xffff
+#define BINARY_MAX_DELIM TEXT_DELIM_TEXT_FIELD
+
+/* A string of a binary writer's dictionary */
+typedef struct {
+    char *text;
+    size_t length;
+    unsigned long hash;
+    /* the string's index in the dictionary, plus one; zero marks an unused slot */
+    size_t index;
+} binary_string_t;
+
+/* The state of a binary write */
+typedef struct {
+    FILE *stream;
+    unsigned char *buffer;
+    size_t length;
+    /* the dictionary, an open-addressing hash table whose capacity is a power of two */
+    binary_string_t *strings;
+    size_t string_count;
+    size_t string_capacity;
+    /* the text class of the previous character value of the current column, or -1 if there is none */
+    sqlite3_int64 last_class;
+} binary_writer_t;
+
+/* The state of a binary read */
+typedef struct {
+    FILE *stream;
+    unsigned char *buffer;
+    size_t next;
+    size_t limit;
+    /* nonzero if reading the stream failed */
+    int read_error;
+    /* the dictionary, each string NUL-terminated */
+    char **strings;
+    size_t *lengths;
+    size_t string_count;
+    size_t string_capacity;
+    /* the bytes of the list or table value being read */
+    char *blob;
+    size_t blob_capacity;
+    /* the offset of the IDs of the containers read from those of the containers written */
+    sqlite3_int64 id_offset;
+} binary_reader_t;
+
 static int cif_create_callback(void *context, int n_columns, char **column_texts, char **column_names);
 static int walk_container(cif_container_tp *container, int depth, cif_handler_tp *handler, void *context);
 static int walk_loops(cif_container_tp *container, cif_handler_tp *handler, void *context);
@@ -50,6 +145,123 @@ static int walk_loop(cif_loop_tp *loop, cif_handler_tp *handler, void *context);
 static int walk_packet(cif_packet_tp *packet, cif_handler_tp *handler, void *context);
 static int walk_item(UChar *name, cif_value_tp *value, cif_handler_tp *handler, void *context);
 
+/*
+ * Looks up the block having the specified normalized code, via the prepared get_block statement.  Ownership of
+ * code_norm passes to this function.  If code_norm_utf8 is not NULL then it must be the UTF-8 form of code_norm, and
+ * it is bound in place of that string.  Other arguments and return value are as for cif_get_block().
+ */
+static int cif_get_block_internal(cif_tp *cif, UChar *code_norm, const char *code_norm_utf8, cif_block_tp **block);
+
+/* Writes the specified bytes to the specified binary writer's buffer, flushing it as needed */
+static int binary_put_bytes(binary_writer_t *writer, const void *bytes, size_t count);
+
+/* Writes the specified byte */
+static int binary_put_byte(binary_writer_t *writer, int byte);
+
+/* Writes the specified unsigned integer as a varint */
+static int binary_put_varint(binary_writer_t *writer, sqlite3_uint64 value);
+
+/* Writes the specified signed integer as a zigzag-encoded varint */
+static int binary_put_svarint(binary_writer_t *writer, sqlite3_int64 value);
+
+/* Writes the specified double as eight little-endian bytes */
+static int binary_put_double(binary_writer_t *writer, double value);
+
+/*
+ * Writes a reference to the text of the specified column of the current result row of the specified statement, which
+ * may be null, adding the text to the dictionary and writing it out if it is not already there
+ */
+static int binary_put_text(binary_writer_t *writer, sqlite3_stmt *stmt, int col);
+
+/*
+ * Writes a reference to the specified (non-null) text, adding the text to the dictionary and writing it out if it is
+ * not already there
+ */
+static int binary_put_string(binary_writer_t *writer, const unsigned char *text, size_t length);
+
+/* Doubles the capacity of the specified binary writer's dictionary */
+static int binary_grow_dictionary(binary_writer_t *writer);
+
+/*
+ * Writes the contents of the specified loop, taking the query results of the specified statement, which has been
+ * prepared from BINARY_GET_LOOP_VALUES_SQL and bound.  Returns a CIF API result code.
+ */
+static int binary_write_items(binary_writer_t *writer, sqlite3_stmt *stmt);
+
+/*
+ * Writes the value described by the columns of the current result row of the specified statement, starting at the
+ * specified column with the kind, in the order of BINARY_GET_LOOP_VALUES_SQL.  Returns a CIF API result code.
+ */
+static int binary_write_value(binary_writer_t *writer, sqlite3_stmt *stmt, int col);
+
+/*
+ * Determines whether the specified text is a decimal number that binary_format_decimal() reproduces exactly from an
+ * integer mantissa and scale, recording those if so.  Returns nonzero if it is, or zero if not.
+ */
+static int binary_decimal_form(const unsigned char *text, size_t length, sqlite3_int64 *mantissa, int *scale);
+
+/*
+ * Formats the specified mantissa and scale as decimal text into the specified buffer, which must have space for at
+ * least BINARY_MAX_DECIMAL_DIGITS + 3 characters, and returns the length of the text
+ */
+static size_t binary_format_decimal(char *buffer, sqlite3_int64 mantissa, int scale);
+
+/* Writes out the buffered output of the specified binary writer */
+static int binary_flush(binary_writer_t *writer);
+
+/* Reads the specified number of bytes from the specified binary reader into the specified space */
+static int binary_get_bytes(binary_reader_t *reader, void *bytes, size_t count);
+
+/* Reads one byte, recording it as an unsigned char converted to int */
+static int binary_get_byte(binary_reader_t *reader, int *byte);
+
+/* Reads a varint */
+static int binary_get_varint(binary_reader_t *reader, sqlite3_uint64 *value);
+
+/* Reads a zigzag-encoded varint */
+static int binary_get_svarint(binary_reader_t *reader, sqlite3_int64 *value);
+
+/* Reads an eight-byte little-endian double */
+static int binary_get_double(binary_reader_t *reader, double *value);
+
+/*
+ * Reads the specified number of bytes into the specified space, followed by one more byte of room, enlarging the space
+ * (and recording its new capacity) as needed.  The space grows only as data are actually read, so that a corrupt
+ * length cannot by itself force a huge allocation.
+ */
+static int binary_get_block(binary_reader_t *reader, size_t count, char **space, size_t *capacity);
+
+/*
+ * Reads a string reference, recording a pointer to the dictionary's copy of the string, or NULL for a null string,
+ * and its length in bytes.  The string belongs to the reader.
+ */
+static int binary_get_string(binary_reader_t *reader, const char **text, size_t *length);
+
+/*
+ * Reads the loops of the specified container, whose loop numbers must be less than the specified next loop number,
+ * into the specified CIF, and the items and values of those loops.  Returns a CIF API result code.
+ */
+static int binary_read_loops(binary_reader_t *reader, cif_tp *cif, sqlite3_stmt *insert_loop,
+        sqlite3_int64 container_id, sqlite3_uint64 next_loop_num);
+
+/*
+ * Reads the values of the specified item of the specified container into the specified CIF; their packet numbers
+ * must not exceed the specified one
+ */
+static int binary_read_column(binary_reader_t *reader, cif_tp *cif, sqlite3_int64 container_id, const char *name,
+        size_t name_length, sqlite3_uint64 last_row);
+
+/* Determines whether the specified text class is one that the library could have computed */
+static int binary_valid_text_class(sqlite3_uint64 text_class);
+
+/*
+ * Checks that the specified original name is well-formed UTF-8 and that the specified normalized name is its
+ * normalized form.  Whether the name is valid CIF is not checked, because a CIF recovered from erroneous input can
+ * hold names that are not, and those must survive being saved and reloaded.  Returns CIF_OK if the checks pass, or
+ * else CIF_ERROR or CIF_MEMORY_ERROR.
+ */
+static int binary_check_name(const char *name, size_t name_length, const char *name_orig, size_t name_orig_length);
+
 
 #ifdef DEBUG
 static void debug_sql(void *context, const char *text);
@@ -183,6 +395,10 @@ int cif_get_api_version(char **version) {
 }
 
 int cif_create(cif_tp **cif) {
+    return cif_create_internal(NULL, cif);
+}
+
+int cif_create_internal(const char *uri, cif_tp **cif) {
     FAILURE_HANDLING;
     cif_tp *temp;
     if (cif == NULL) return CIF_ARGUMENT_ERROR;
@@ -207,15 +423,20 @@ int cif_create(cif_tp **cif) {
                  * large space savings afforded by UTF-8 usage in the database yields
                  * also sufficient performance improvement to slightly outweigh the
                  * cost of transcoding into and out of the database.
+                 *
+                 * URI interpretation is enabled so that named, shared-cache databases (such as those used for the
+                 * per-thread stores of a parallel parse) can be attached to the connection.
                  */
                 && (DEBUG_WRAP2(sqlite3_open_v2(
+                        ((uri != NULL) ? uri :
 #ifdef SQLITE_MEMORY_ONLY
-                        ":memory:",
+                        ":memory:"
 #else
-                        "",
+                        ""
 #endif
-                        &(temp->db), SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX
-                        | SQLITE_OPEN_PRIVATECACHE, NULL)) == SQLITE_OK)) {
+                        ),
+                        &(temp->db), SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_NOMUTEX | SQLITE_OPEN_URI
+                        | ((uri != NULL) ? SQLITE_OPEN_SHAREDCACHE : SQLITE_OPEN_PRIVATECACHE), NULL)) == SQLITE_OK)) {
             int fks_enabled = 0;
 
 #ifdef PERFORM_QUERY_PROFILING
@@ -266,14 +487,18 @@ int cif_create(cif_tp **cif) {
                         INIT_STMT(temp, get_all_loops);
                         INIT_STMT(temp, prune_container);
                         INIT_STMT(temp, get_value);
+                        INIT_STMT(temp, get_scalars);
                         INIT_STMT(temp, set_all_values);
                         INIT_STMT(temp, get_loop_size);
                         INIT_STMT(temp, remove_item);
                         INIT_STMT(temp, destroy_loop);
                         INIT_STMT(temp, get_loop_names);
+                        INIT_STMT(temp, get_loop_widths);
+                        INIT_STMT(temp, get_loop_columns);
                         INIT_STMT(temp, get_packet_num);
                         INIT_STMT(temp, update_packet_num);
                         INIT_STMT(temp, reset_packet_num);
+                        INIT_STMT(temp, set_packet_num);
                         INIT_STMT(temp, check_item_loop);
                         INIT_STMT(temp, insert_value);
                         INIT_STMT(temp, update_value);
@@ -323,6 +548,379 @@ int cif_destroy(cif_tp *cif) {
     }
 }
 
+int cif_get_max_container_id(cif_tp *cif, sqlite3_int64 *id) {
+    sqlite3_stmt *stmt;
+    int result = CIF_ERROR;
+
+    if (DEBUG_WRAP(cif->db, sqlite3_prepare_v2(cif->db, GET_MAX_CONTAINER_ID_SQL, -1, &stmt, NULL)) == SQLITE_OK) {
+        if (DEBUG_WRAP(cif->db, sqlite3_step(stmt)) == SQLITE_ROW) {
+            *id = sqlite3_column_int64(stmt, 0);
+            result = CIF_OK;
+        }
+        DEBUG_WRAP(cif->db, sqlite3_finalize(stmt));
+    }
+
+    return result;
+}
+
+int cif_merge_store(cif_tp *cif, const char *uri, sqlite3_int64 id_limit) {
+    static const char * const merge_statements[] = {
+        MERGE_CONTAINERS_SQL,
+        MERGE_BLOCKS_SQL,
+        MERGE_FRAMES_SQL,
+        MERGE_LOOPS_SQL,
+        MERGE_LOOP_ITEMS_SQL,
+        MERGE_VALUES_SQL,
+        MERGE_SCALAR_ROWS_SQL,
+        NULL
+    };
+    FAILURE_HANDLING;
+    char *attach_sql;
+
+    if (cif == NULL) return CIF_INVALID_HANDLE;
+
+    attach_sql = sqlite3_mprintf(ATTACH_STORE_SQL, uri);
+    if (attach_sql == NULL) {
+        SET_RESULT(CIF_MEMORY_ERROR);
+    } else {
+        int attached = (DEBUG_WRAP2(sqlite3_exec(cif->db, attach_sql, NULL, NULL, NULL)) == SQLITE_OK);
+
+        sqlite3_free(attach_sql);
+        if (attached) {
+            if (BEGIN(cif->db) == SQLITE_OK) {
+                sqlite3_int64 offset;
+
+                if (cif_get_max_container_id(cif, &offset) == CIF_OK) {
+                    const char * const *sql_p;
+
+                    for (sql_p = merge_statements; *sql_p; sql_p += 1) {
+                        sqlite3_stmt *stmt;
+                        int step_result;
+
+                        if (DEBUG_WRAP(cif->db, sqlite3_prepare_v2(cif->db, *sql_p, -1, &stmt, NULL)) != SQLITE_OK) {
+                            DEFAULT_FAIL(soft);
+                        }
+                        if ((sqlite3_bind_int64(stmt, 1, offset) != SQLITE_OK)
+                                || (sqlite3_bind_int64(stmt, 2, id_limit) != SQLITE_OK)) {
+                            step_result = SQLITE_ERROR;
+                        } else {
+                            step_result = DEBUG_WRAP(cif->db, sqlite3_step(stmt));
+                        }
+                        DEBUG_WRAP(cif->db, sqlite3_finalize(stmt));
+                        if (step_result != SQLITE_DONE) {
+                            /* most likely a duplicate block code */
+                            FAIL(soft, (((step_result & 0xff) == SQLITE_CONSTRAINT) ? CIF_DUP_BLOCKCODE : CIF_ERROR));
+                        }
+                    }
+
+                    if (COMMIT(cif->db) == SQLITE_OK) {
+                        DEBUG_WRAP2(sqlite3_exec(cif->db, DETACH_STORE_SQL, NULL, NULL, NULL));  /* ignore any error */
+                        return CIF_OK;
+                    }
+                }
+
+                FAILURE_HANDLER(soft):
+                ROLLBACK(cif->db);  /* ignore any error */
+            }
+
+            DEBUG_WRAP2(sqlite3_exec(cif->db, DETACH_STORE_SQL, NULL, NULL, NULL));  /* ignore any error */
+        }
+    }
+
+    FAILURE_TERMINUS;
+}
+
+int cif_copy_store(cif_tp *cif, cif_tp **copy) {
+    cif_tp *temp;
+    int result = cif_create_internal(NULL, &temp);
+
+    if (result == CIF_OK) {
+        /* the copy's own, freshly-created contents are replaced wholesale */
+        sqlite3_backup *backup = sqlite3_backup_init(temp->db, "main", cif->db, "main");
+
+        if (backup == NULL) {
+            result = CIF_ERROR;
+        } else {
+            int step_result = DEBUG_WRAP(temp->db, sqlite3_backup_step(backup, -1));
+
+            if ((DEBUG_WRAP(temp->db, sqlite3_backup_finish(backup)) == SQLITE_OK) && (step_result == SQLITE_DONE)) {
+                *copy = temp;
+                return CIF_OK;
+            }
+            result = CIF_ERROR;
+        }
+
+        if (cif_destroy(temp) != CIF_OK) {
+            /* ignore the error; the copy is abandoned either way */
+        }
+    }
+
+    return result;
+}
+
+int cif_count_loops(cif_tp *cif, sqlite3_int64 *count) {
+    sqlite3_stmt *stmt;
+    int result = CIF_ERROR;
+
+    if (DEBUG_WRAP(cif->db, sqlite3_prepare_v2(cif->db, COUNT_LOOPS_SQL, -1, &stmt, NULL)) == SQLITE_OK) {
+        if (DEBUG_WRAP(cif->db, sqlite3_step(stmt)) == SQLITE_ROW) {
+            *count = sqlite3_column_int64(stmt, 0);
+            result = CIF_OK;
+        }
+        DEBUG_WRAP(cif->db, sqlite3_finalize(stmt));
+    }
+
+    return result;
+}
+
+int cif_write_binary(FILE *stream, cif_tp *cif) {
+    binary_writer_t writer;
+    sqlite3_stmt *containers = NULL;
+    sqlite3_stmt *loops = NULL;
+    sqlite3_stmt *values = NULL;
+    int result;
+
+    if (stream == NULL) {
+        return CIF_ARGUMENT_ERROR;
+    } else if (cif == NULL) {
+        return CIF_INVALID_HANDLE;
+    }
+
+    memset(&writer, 0, sizeof(writer));
+    writer.stream = stream;
+    writer.buffer = (unsigned char *) malloc(BINARY_BUFFER_SIZE);
+    if (writer.buffer == NULL) {
+        return CIF_MEMORY_ERROR;
+    }
+
+    if ((DEBUG_WRAP(cif->db, sqlite3_prepare_v2(cif->db, BINARY_GET_CONTAINERS_SQL, -1, &containers, NULL))
+                    != SQLITE_OK)
+            || (DEBUG_WRAP(cif->db, sqlite3_prepare_v2(cif->db, BINARY_GET_LOOPS_SQL, -1, &loops, NULL)) != SQLITE_OK)
+            || (DEBUG_WRAP(cif->db, sqlite3_prepare_v2(cif->db, BINARY_GET_LOOP_VALUES_SQL, -1, &values, NULL))
+                    != SQLITE_OK)) {
+        result = CIF_ERROR;
+    } else if (((result = binary_put_bytes(&writer, BINARY_MAGIC, 4)) == CIF_OK)
+            && ((result = binary_put_byte(&writer, BINARY_FORMAT_VERSION)) == CIF_OK)) {
+        int step_result;
+
+        while ((result == CIF_OK)
+                && ((step_result = DEBUG_WRAP(cif->db, sqlite3_step(containers))) == SQLITE_ROW)) {
+            sqlite3_int64 id = sqlite3_column_int64(containers, 0);
+
+            /* the container, followed by its loops */
+            if (((result = binary_put_varint(&writer, (sqlite3_uint64) id)) == CIF_OK)
+                    && ((result = binary_put_varint(&writer, (sqlite3_uint64) sqlite3_column_int64(containers, 1)))
+                            == CIF_OK)
+                    && ((result = binary_put_text(&writer, containers, 2)) == CIF_OK)
+                    && ((result = binary_put_text(&writer, containers, 3)) == CIF_OK)
+                    && ((result = binary_put_varint(&writer, (sqlite3_uint64) sqlite3_column_int64(containers, 4)))
+                            == CIF_OK)) {
+                if (sqlite3_bind_int64(loops, 1, id) != SQLITE_OK) {
+                    result = CIF_ERROR;
+                }
+                while ((result == CIF_OK) && ((step_result = DEBUG_WRAP(cif->db, sqlite3_step(loops))) == SQLITE_ROW)) {
+                    int loop_num = sqlite3_column_int(loops, 0);
+
+                    if (((result = binary_put_varint(&writer, (sqlite3_uint64) loop_num + 1)) == CIF_OK)
+                            && ((result = binary_put_text(&writer, loops, 1)) == CIF_OK)
+                            && ((result = binary_put_varint(&writer, (sqlite3_uint64) sqlite3_column_int64(loops, 2)))
+                                    == CIF_OK)) {
+                        if ((sqlite3_bind_int64(values, 1, id) != SQLITE_OK)
+                                || (sqlite3_bind_int(values, 2, loop_num) != SQLITE_OK)) {
+                            result = CIF_ERROR;
+                        } else {
+                            result = binary_write_items(&writer, values);
+                        }
+                        sqlite3_reset(values);
+                    }
+                }
+                if ((result == CIF_OK) && (step_result != SQLITE_DONE)) {
+                    result = CIF_ERROR;
+                }
+                sqlite3_reset(loops);
+                if (result == CIF_OK) {
+                    result = binary_put_varint(&writer, 0);
+                }
+            }
+        }
+        if ((result == CIF_OK) && (step_result != SQLITE_DONE)) {
+            result = CIF_ERROR;
+        }
+
+        if ((result == CIF_OK) && ((result = binary_put_varint(&writer, 0)) == CIF_OK)) {
+            result = binary_flush(&writer);
+        }
+    }
+
+    DEBUG_WRAP(cif->db, sqlite3_finalize(values));
+    DEBUG_WRAP(cif->db, sqlite3_finalize(loops));
+    DEBUG_WRAP(cif->db, sqlite3_finalize(containers));
+    if (writer.strings != NULL) {
+        size_t slot;
+
+        for (slot = 0; slot < writer.string_capacity; slot += 1) {
+            free(writer.strings[slot].text);
+        }
+        free(writer.strings);
+    }
+    free(writer.buffer);
+
+    return result;
+}
+
+int cif_read_binary(FILE *stream, cif_tp **cif) {
+    binary_reader_t reader;
+    sqlite3_stmt *insert_container = NULL;
+    sqlite3_stmt *insert_loop = NULL;
+    unsigned char header[5];
+    sqlite3_uint64 last_id = 0;
+    cif_tp *target;
+    int result;
+
+    if ((stream == NULL) || (cif == NULL)) {
+        return CIF_ARGUMENT_ERROR;
+    } else if ((*cif == NULL) && ((result = cif_create(cif)) != CIF_OK)) {
+        return result;
+    }
+    target = *cif;
+
+    /* the statements by which the contents are recorded */
+    PREPARE_STMT(target, create_block, CREATE_BLOCK_SQL);
+    PREPARE_STMT(target, create_frame, CREATE_FRAME_SQL);
+    PREPARE_STMT(target, add_loop_item, ADD_LOOP_ITEM_SQL);
+    PREPARE_STMT(target, insert_value, INSERT_VALUE_SQL);
+    PREPARE_STMT(target, set_packet_num, SET_PACKET_NUM_SQL);
+
+    memset(&reader, 0, sizeof(reader));
+    reader.stream = stream;
+    reader.buffer = (unsigned char *) malloc(BINARY_BUFFER_SIZE);
+    if (reader.buffer == NULL) {
+        return CIF_MEMORY_ERROR;
+    }
+
+    if ((DEBUG_WRAP(target->db, sqlite3_prepare_v2(target->db, BINARY_INSERT_CONTAINER_SQL, -1, &insert_container,
+                    NULL)) != SQLITE_OK)
+            || (DEBUG_WRAP(target->db, sqlite3_prepare_v2(target->db, BINARY_INSERT_LOOP_SQL, -1, &insert_loop, NULL))
+                    != SQLITE_OK)) {
+        result = CIF_ERROR;
+    } else if ((result = binary_get_bytes(&reader, header, 5)) != CIF_OK) {
+        /* nothing more to do */
+    } else if (memcmp(header, BINARY_MAGIC, 4) != 0) {
+        result = CIF_ERROR;
+    } else if (header[4] != BINARY_FORMAT_VERSION) {
+        result = CIF_NOT_SUPPORTED;
+    } else if (BEGIN(target->db) != SQLITE_OK) {
+        result = CIF_ERROR;
+    } else {
+        /* the contents are all recorded in one transaction, after any existing containers */
+        result = cif_get_max_container_id(target, &(reader.id_offset));
+        while (result == CIF_OK) {
+            STEP_HANDLING;
+            sqlite3_uint64 id;
+            sqlite3_uint64 parent_id;
+            sqlite3_uint64 next_loop_num;
+            const char *code;
+            size_t code_length;
+            const char *code_orig;
+            size_t code_orig_length;
+
+            if (((result = binary_get_varint(&reader, &id)) != CIF_OK) || (id == 0)) {
+                break;
+            } else if (((result = binary_get_varint(&reader, &parent_id)) != CIF_OK)
+                    || ((result = binary_get_string(&reader, &code, &code_length)) != CIF_OK)
+                    || ((result = binary_get_string(&reader, &code_orig, &code_orig_length)) != CIF_OK)
+                    || ((result = binary_get_varint(&reader, &next_loop_num)) != CIF_OK)) {
+                break;
+            } else if ((code == NULL) || (code_orig == NULL) || (parent_id >= id) || (id <= last_id)
+                    || ((sqlite3_uint64) reader.id_offset >= BINARY_MAX_ID)
+                    || (id > BINARY_MAX_ID - (sqlite3_uint64) reader.id_offset) || (next_loop_num > INT_MAX)) {
+                result = CIF_ERROR;
+                break;
+            } else if ((result = binary_check_name(code, code_length, code_orig, code_orig_length)) != CIF_OK) {
+                break;
+            }
+
+            /* container IDs increase, and each frame's parent precedes it */
+            last_id = id;
+            id += reader.id_offset;
+            if ((sqlite3_bind_int64(insert_container, 1, (sqlite3_int64) id) != SQLITE_OK)
+                    || (sqlite3_bind_int64(insert_container, 2, (sqlite3_int64) next_loop_num) != SQLITE_OK)
+                    || (DEBUG_WRAP(target->db, sqlite3_step(insert_container)) != SQLITE_DONE)
+                    || (sqlite3_reset(insert_container) != SQLITE_OK)) {
+                result = CIF_ERROR;
+            } else if (parent_id == 0) {
+                if ((sqlite3_bind_int64(target->create_block_stmt, 1, (sqlite3_int64) id) != SQLITE_OK)
+                        || (sqlite3_bind_text(target->create_block_stmt, 2, code, (int) code_length, SQLITE_STATIC)
+                                != SQLITE_OK)
+                        || (sqlite3_bind_text(target->create_block_stmt, 3, code_orig, (int) code_orig_length,
+                                SQLITE_STATIC) != SQLITE_OK)) {
+                    result = CIF_ERROR;
+                } else {
+                    switch (STEP_STMT(target, create_block)) {
+                        case SQLITE_DONE:
+                            break;
+                        case SQLITE_CONSTRAINT:
+                            /* the only constraint that correct input can violate */
+                            result = CIF_DUP_BLOCKCODE;
+                            break;
+                        default:
+                            result = CIF_ERROR;
+                            break;
+                    }
+                }
+            } else {
+                if ((sqlite3_bind_int64(target->create_frame_stmt, 1, (sqlite3_int64) id) != SQLITE_OK)
+                        || (sqlite3_bind_int64(target->create_frame_stmt, 2,
+                                (sqlite3_int64) (parent_id + reader.id_offset)) != SQLITE_OK)
+                        || (sqlite3_bind_text(target->create_frame_stmt, 3, code, (int) code_length, SQLITE_STATIC)
+                                != SQLITE_OK)
+                        || (sqlite3_bind_text(target->create_frame_stmt, 4, code_orig, (int) code_orig_length,
+                                SQLITE_STATIC) != SQLITE_OK)
+                        || (STEP_STMT(target, create_frame) != SQLITE_DONE)) {
+                    result = CIF_ERROR;
+                }
+            }
+
+            if (result == CIF_OK) {
+                result = binary_read_loops(&reader, target, insert_loop, (sqlite3_int64) id, next_loop_num);
+            }
+        }
+
+        if ((result == CIF_OK) && reader.read_error) {
+            result = CIF_ERROR;
+        }
+        if (result == CIF_OK) {
+            if (COMMIT(target->db) != SQLITE_OK) {
+                result = CIF_ERROR;
+            }
+        }
+        if (result != CIF_OK) {
+            /* abandon the statements left incomplete, then everything read */
+            sqlite3_reset(insert_container);
+            sqlite3_reset(insert_loop);
+            sqlite3_reset(target->create_block_stmt);
+            sqlite3_reset(target->create_frame_stmt);
+            sqlite3_reset(target->add_loop_item_stmt);
+            sqlite3_reset(target->insert_value_stmt);
+            sqlite3_reset(target->set_packet_num_stmt);
+            ROLLBACK(target->db);  /* ignore any error */
+        }
+    }
+
+    DEBUG_WRAP(target->db, sqlite3_finalize(insert_loop));
+    DEBUG_WRAP(target->db, sqlite3_finalize(insert_container));
+    while (reader.string_count > 0) {
+        reader.string_count -= 1;
+        free(reader.strings[reader.string_count]);
+    }
+    free(reader.strings);
+    free(reader.lengths);
+    free(reader.blob);
+    free(reader.buffer);
+
+    return result;
+}
+
 int cif_create_block(cif_tp *cif, const UChar *code, cif_block_tp **block) {
     return code ? cif_create_block_internal(cif, code, 0, block) : CIF_ARGUMENT_ERROR;
 }
@@ -410,8 +1008,8 @@ int cif_create_block_internal(cif_tp *cif, const UChar *code, int lenient, cif_b
 }
 
 int cif_get_block(cif_tp *cif, const UChar *code, cif_block_tp **block) {
-    FAILURE_HANDLING;
-    cif_block_tp *temp;
+    UChar *code_norm;
+    int result;
 
     if (cif == NULL) return CIF_INVALID_HANDLE;
 
@@ -421,49 +1019,35 @@ int cif_get_block(cif_tp *cif, const UChar *code, cif_block_tp **block) {
      */
     PREPARE_STMT(cif, get_block, GET_BLOCK_SQL);
 
-    temp = (cif_block_tp *) malloc(sizeof(cif_block_tp));
-    if (temp == NULL) {
-        SET_RESULT(CIF_MEMORY_ERROR);
-    } else {
-        int result;
+    result = cif_normalize(code, -1, &code_norm);
+    return ((result == CIF_OK) ? cif_get_block_internal(cif, code_norm, NULL, block) : result);
+}
 
-        temp->code_orig = NULL;
-        temp->parent_id = -1; /* ensure initialized, but this is meaningful only for save frames */
-        result = cif_normalize(code, -1, &(temp->code));
-        if (result != CIF_OK) {
-            SET_RESULT(result);
-        } else {
-            /* Bind the needed parameters to the create block statement and execute it */
-            /* there is a uniqueness constraint on the search key, so at most one row can be returned */
-            if (sqlite3_bind_text16(cif->get_block_stmt, 1, temp->code, -1, SQLITE_STATIC) == SQLITE_OK) {
-                STEP_HANDLING;
-
-                switch (STEP_STMT(cif, get_block)) {
-                    case SQLITE_ROW:
-                        temp->cif = cif;
-                        temp->id = sqlite3_column_int64(cif->get_block_stmt, 0);
-                        GET_COLUMN_STRING(cif->get_block_stmt, 1, temp->code_orig, hard_fail);
-                        /* ignore any error here: */
-                        sqlite3_reset(cif->get_block_stmt);
-                        ASSIGN_TEMP_PTR(temp, block, cif_container_free);
-                        return CIF_OK;
-                    case SQLITE_DONE:
-                        FAIL(soft, CIF_NOSUCH_BLOCK);
-                    /* default: do nothing */
-                }
-            }
+int cif_get_block_utf8(cif_tp *cif, const char *code, cif_block_tp **block) {
+    char *code_norm_utf8;
+    int result;
 
-            FAILURE_HANDLER(hard):
-            /* discard the prepared statement */
-            DROP_STMT(cif, get_block);
-        }
+    if (cif == NULL) return CIF_INVALID_HANDLE;
 
-        FAILURE_HANDLER(soft):
-        /* free the container object */
-        cif_container_free(temp);
+    /*
+     * Create any needed prepared statements, or prepare the existing ones for
+     * re-use, exiting this function with an error on failure.
+     */
+    PREPARE_STMT(cif, get_block, GET_BLOCK_SQL);
+
+    result = cif_normalize_utf8_internal(code, UTF8_NO_VALIDATION, &code_norm_utf8, CIF_NOSUCH_BLOCK);
+    if (result == CIF_OK) {
+        UChar *code_norm;
+
+        /* the block handle carries the normalized code in UTF-16 form, but the lookup binds the UTF-8 form */
+        result = cif_utf8_to_ustr_internal(code_norm_utf8, -1, &code_norm, CIF_ERROR);
+        if (result == CIF_OK) {
+            result = cif_get_block_internal(cif, code_norm, code_norm_utf8, block);
+        }
+        free(code_norm_utf8);
     }
 
-    FAILURE_TERMINUS;
+    return result;
 }
 
 int cif_get_all_blocks(cif_tp *cif, cif_block_tp ***blocks) {
@@ -625,6 +1209,56 @@ int cif_walk(cif_tp *cif, cif_handler_tp *handler, void *context) {
 }
 #endif
 
+static int cif_get_block_internal(cif_tp *cif, UChar *code_norm, const char *code_norm_utf8, cif_block_tp **block) {
+    FAILURE_HANDLING;
+    cif_block_tp *temp;
+
+    temp = (cif_block_tp *) malloc(sizeof(cif_block_tp));
+    if (temp == NULL) {
+        free(code_norm);
+        SET_RESULT(CIF_MEMORY_ERROR);
+    } else {
+        int bind_result;
+
+        temp->code = code_norm;
+        temp->code_orig = NULL;
+        temp->parent_id = -1; /* ensure initialized, but this is meaningful only for save frames */
+
+        /* Bind the needed parameters to the create block statement and execute it */
+        /* there is a uniqueness constraint on the search key, so at most one row can be returned */
+        bind_result = ((code_norm_utf8 == NULL)
+                ? sqlite3_bind_text16(cif->get_block_stmt, 1, temp->code, -1, SQLITE_STATIC)
+                : sqlite3_bind_text(cif->get_block_stmt, 1, code_norm_utf8, -1, SQLITE_STATIC));
+        if (bind_result == SQLITE_OK) {
+            STEP_HANDLING;
+
+            switch (STEP_STMT(cif, get_block)) {
+                case SQLITE_ROW:
+                    temp->cif = cif;
+                    temp->id = sqlite3_column_int64(cif->get_block_stmt, 0);
+                    GET_COLUMN_STRING(cif->get_block_stmt, 1, temp->code_orig, hard_fail);
+                    /* ignore any error here: */
+                    sqlite3_reset(cif->get_block_stmt);
+                    ASSIGN_TEMP_PTR(temp, block, cif_container_free);
+                    return CIF_OK;
+                case SQLITE_DONE:
+                    FAIL(soft, CIF_NOSUCH_BLOCK);
+                /* default: do nothing */
+            }
+        }
+
+        FAILURE_HANDLER(hard):
+        /* discard the prepared statement */
+        DROP_STMT(cif, get_block);
+
+        FAILURE_HANDLER(soft):
+        /* free the container object */
+        cif_container_free(temp);
+    }
+
+    FAILURE_TERMINUS;
+}
+
 static int walk_container(cif_container_tp *container, int depth, cif_handler_tp *handler, void *context) {
     /* call the handler for this element */
     int result = (depth ? HANDLER_RESULT(frame_start, (container, context), CIF_TRAVERSE_CONTINUE)
@@ -774,12 +1408,13 @@ static int walk_packet(cif_packet_tp *packet, cif_handler_tp *handler, void *con
     if (handler_result != CIF_TRAVERSE_CONTINUE) {
         return handler_result;
     } else {
-        struct entry_s *item;
+        size_t position;
 
-        for (item = packet->map.head; item != NULL; item = (struct entry_s *) item->hh.next) {
+        for (position = 0; position < packet->map.size; position += 1) {
+            struct entry_s *item = packet->map.entries + position;
             int item_result;
 
-            item_result = walk_item(item->key, &(item->as_value), handler, context);
+            item_result = walk_item(item->key, item->value, handler, context);
             switch (item_result) {
                 case CIF_TRAVERSE_CONTINUE:
                 case CIF_TRAVERSE_SKIP_CURRENT:
@@ -798,3 +1433,872 @@ static int walk_packet(cif_packet_tp *packet, cif_handler_tp *handler, void *con
 static int walk_item(UChar *name, cif_value_tp *value, cif_handler_tp *handler, void *context) {
     return HANDLER_RESULT(item, (name, value, context), CIF_TRAVERSE_CONTINUE);
 }
+
+static int binary_put_bytes(binary_writer_t *writer, const void *bytes, size_t count) {
+    const unsigned char *next = (const unsigned char *) bytes;
+
+    while (count > 0) {
+        size_t chunk = BINARY_BUFFER_SIZE - writer->length;
+
+        if (chunk == 0) {
+            int result = binary_flush(writer);
+
+            if (result != CIF_OK) {
+                return result;
+            }
+            chunk = BINARY_BUFFER_SIZE;
+        }
+        if (chunk > count) {
+            chunk = count;
+        }
+        memcpy(writer->buffer + writer->length, next, chunk);
+        writer->length += chunk;
+        next += chunk;
+        count -= chunk;
+    }
+
+    return CIF_OK;
+}
+
+static int binary_put_byte(binary_writer_t *writer, int byte) {
+    if (writer->length == BINARY_BUFFER_SIZE) {
+        int result = binary_flush(writer);
+
+        if (result != CIF_OK) {
+            return result;
+        }
+    }
+    writer->buffer[writer->length] = (unsigned char) byte;
+    writer->length += 1;
+
+    return CIF_OK;
+}
+
+static int binary_put_varint(binary_writer_t *writer, sqlite3_uint64 value) {
+    unsigned char bytes[10];
+    size_t count = 0;
+
+    while (value >= 0x80) {
+        bytes[count] = (unsigned char) ((value & 0x7f) | 0x80);
+        value >>= 7;
+        count += 1;
+    }
+    bytes[count] = (unsigned char) value;
+
+    return binary_put_bytes(writer, bytes, count + 1);
+}
+
+static int binary_put_svarint(binary_writer_t *writer, sqlite3_int64 value) {
+    return binary_put_varint(writer,
+            (value < 0) ? (((~(sqlite3_uint64) value) << 1) | 1) : ((sqlite3_uint64) value << 1));
+}
+
+static int binary_put_double(binary_writer_t *writer, double value) {
+    sqlite3_uint64 bits;
+    unsigned char bytes[8];
+    int i;
+
+    assert(sizeof(bits) == sizeof(value));
+    memcpy(&bits, &value, sizeof(bits));
+    for (i = 0; i < 8; i += 1) {
+        bytes[i] = (unsigned char) (bits & 0xff);
+        bits >>= 8;
+    }
+
+    return binary_put_bytes(writer, bytes, 8);
+}
+
+static int binary_put_text(binary_writer_t *writer, sqlite3_stmt *stmt, int col) {
+    const unsigned char *text;
+
+    if (sqlite3_column_type(stmt, col) == SQLITE_NULL) {
+        return binary_put_varint(writer, 0);
+    } else if ((text = sqlite3_column_text(stmt, col)) == NULL) {
+        return CIF_MEMORY_ERROR;
+    } else {
+        return binary_put_string(writer, text, (size_t) sqlite3_column_bytes(stmt, col));
+    }
+}
+
+static int binary_put_string(binary_writer_t *writer, const unsigned char *text, size_t length) {
+    unsigned long hash = 2166136261UL;
+    size_t slot;
+    size_t i;
+    char *copy;
+    int result;
+
+    /* FNV-1a */
+    for (i = 0; i < length; i += 1) {
+        hash = (hash ^ text[i]) * 16777619UL;
+    }
+
+    /* keep the table at most half full */
+    if ((2 * (writer->string_count + 1)) > writer->string_capacity) {
+        if ((result = binary_grow_dictionary(writer)) != CIF_OK) {
+            return result;
+        }
+    }
+
+    for (slot = hash & (writer->string_capacity - 1); writer->strings[slot].index != 0;
+            slot = (slot + 1) & (writer->string_capacity - 1)) {
+        binary_string_t *string = writer->strings + slot;
+
+        if ((string->hash == hash) && (string->length == length) && (memcmp(string->text, text, length) == 0)) {
+            /* a string already written */
+            return binary_put_varint(writer, 2 * (sqlite3_uint64) string->index);
+        }
+    }
+
+    /* a new string */
+    copy = (char *) malloc(length + 1);
+    if (copy == NULL) {
+        return CIF_MEMORY_ERROR;
+    }
+    memcpy(copy, text, length);
+    writer->string_count += 1;
+    writer->strings[slot].text = copy;
+    writer->strings[slot].length = length;
+    writer->strings[slot].hash = hash;
+    writer->strings[slot].index = writer->string_count;
+
+    if ((result = binary_put_varint(writer, 2 * (sqlite3_uint64) length + 1)) == CIF_OK) {
+        result = binary_put_bytes(writer, text, length);
+    }
+
+    return result;
+}
+
+static int binary_grow_dictionary(binary_writer_t *writer) {
+    size_t new_capacity = ((writer->string_capacity == 0) ? 1024 : (2 * writer->string_capacity));
+    binary_string_t *new_strings = (binary_string_t *) calloc(new_capacity, sizeof(binary_string_t));
+    size_t slot;
+
+    if (new_strings == NULL) {
+        return CIF_MEMORY_ERROR;
+    }
+    for (slot = 0; slot < writer->string_capacity; slot += 1) {
+        if (writer->strings[slot].index != 0) {
+            size_t new_slot;
+
+            for (new_slot = writer->strings[slot].hash & (new_capacity - 1); new_strings[new_slot].index != 0;
+                    new_slot = (new_slot + 1) & (new_capacity - 1)) ;
+            new_strings[new_slot] = writer->strings[slot];
+        }
+    }
+    free(writer->strings);
+    writer->strings = new_strings;
+    writer->string_capacity = new_capacity;
+
+    return CIF_OK;
+}
+
+static int binary_write_items(binary_writer_t *writer, sqlite3_stmt *stmt) {
+    sqlite3_int64 item = 0;
+    sqlite3_int64 last_row = 0;
+    int have_item = CIF_FALSE;
+    int step_result;
+    int result = CIF_OK;
+
+    while ((result == CIF_OK) && ((step_result = sqlite3_step(stmt)) == SQLITE_ROW)) {
+        sqlite3_int64 rowid = sqlite3_column_int64(stmt, 0);
+
+        if (!have_item || (rowid != item)) {
+            /* the first value of a new column */
+            if ((have_item && ((result = binary_put_byte(writer, BINARY_END_COLUMN)) != CIF_OK))
+                    || ((result = binary_put_text(writer, stmt, 1)) != CIF_OK)
+                    || ((result = binary_put_text(writer, stmt, 2)) != CIF_OK)) {
+                break;
+            }
+            item = rowid;
+            have_item = CIF_TRUE;
+            last_row = 0;
+            writer->last_class = -1;
+        }
+
+        /* an item without values has a null row number */
+        if (sqlite3_column_type(stmt, 3) != SQLITE_NULL) {
+            sqlite3_int64 row = sqlite3_column_int64(stmt, 3);
+
+            if ((row > (last_row + 1))
+                    && (((result = binary_put_byte(writer, BINARY_ROW_GAP)) != CIF_OK)
+                    || ((result = binary_put_varint(writer, (sqlite3_uint64) (row - last_row - 1))) != CIF_OK))) {
+                break;
+            }
+            last_row = row;
+            result = binary_write_value(writer, stmt, 4);
+        }
+    }
+
+    if (result != CIF_OK) {
+        return result;
+    } else if (step_result != SQLITE_DONE) {
+        return CIF_ERROR;
+    } else if (have_item && ((result = binary_put_byte(writer, BINARY_END_COLUMN)) != CIF_OK)) {
+        return result;
+    } else {
+        return binary_put_varint(writer, 0);
+    }
+}
+
+static int binary_write_value(binary_writer_t *writer, sqlite3_stmt *stmt, int col) {
+    int kind = sqlite3_column_int(stmt, col);
+    int header = kind;
+    int digits_type;
+    int su_type;
+    int result;
+
+    switch (kind) {
+        case CIF_CHAR_KIND:
+            /* the val column duplicates the text, and is not recorded */
+            {
+                const unsigned char *text = NULL;
+                size_t length = 0;
+                unsigned char decimal[2 * BINARY_MAX_DECIMAL_DIGITS + 8];
+                sqlite3_int64 text_class = sqlite3_column_int64(stmt, col + 7);
+                sqlite3_int64 mantissa = 0;
+                int scale = 0;
+
+                if (sqlite3_column_type(stmt, col + 3) != SQLITE_NULL) {
+                    if ((text = sqlite3_column_text(stmt, col + 3)) == NULL) {
+                        return CIF_MEMORY_ERROR;
+                    }
+                    length = (size_t) sqlite3_column_bytes(stmt, col + 3);
+                    if (binary_decimal_form(text, length, &mantissa, &scale)) {
+                        header |= BINARY_DECIMAL;
+                    }
+                } else if (sqlite3_column_type(stmt, col + 4) != SQLITE_INTEGER) {
+                    return CIF_INTERNAL_ERROR;
+                } else if ((sqlite3_column_type(stmt, col + 5) == SQLITE_NULL)
+                        && (sqlite3_column_int(stmt, col + 6) <= BINARY_MAX_DECIMAL_DIGITS)) {
+                    /* a plain decimal stored compactly, recorded directly */
+                    mantissa = sqlite3_column_int64(stmt, col + 4);
+                    scale = sqlite3_column_int(stmt, col + 6);
+                    header |= BINARY_DECIMAL;
+                } else {
+                    /* any other plain decimal stored compactly; its text is plain ASCII */
+                    UChar decimal_text[sizeof(decimal)];
+                    sqlite3_int64 su = ((sqlite3_column_type(stmt, col + 5) == SQLITE_NULL)
+                            ? -1 : sqlite3_column_int64(stmt, col + 5));
+                    size_t text_length = cif_decimal_text_length_internal(sqlite3_column_int64(stmt, col + 4), su,
+                            sqlite3_column_int(stmt, col + 6));
+
+                    if ((text_length == 0) || (text_length > sizeof(decimal))) {
+                        return CIF_INTERNAL_ERROR;
+                    }
+                    cif_decimal_write_text_internal(sqlite3_column_int64(stmt, col + 4), su,
+                            sqlite3_column_int(stmt, col + 6), decimal_text);
+                    for (length = 0; decimal_text[length] != 0; length += 1) {
+                        decimal[length] = (unsigned char) decimal_text[length];
+                    }
+                    text = decimal;
+                }
+                if (sqlite3_column_int(stmt, col + 1)) {
+                    header |= BINARY_QUOTED;
+                }
+                if (text_class == writer->last_class) {
+                    header |= BINARY_SAME_CLASS;
+                }
+                writer->last_class = text_class;
+                if ((result = binary_put_byte(writer, header)) != CIF_OK) {
+                    return result;
+                } else if (header & BINARY_DECIMAL) {
+                    if (((result = binary_put_svarint(writer, mantissa)) != CIF_OK)
+                            || ((result = binary_put_varint(writer, (sqlite3_uint64) scale)) != CIF_OK)) {
+                        return result;
+                    }
+                } else if ((result = binary_put_string(writer, text, length)) != CIF_OK) {
+                    return result;
+                }
+                return ((header & BINARY_SAME_CLASS) ? CIF_OK
+                        : binary_put_varint(writer, (sqlite3_uint64) text_class));
+            }
+        case CIF_NUMB_KIND:
+            digits_type = sqlite3_column_type(stmt, col + 4);
+            su_type = sqlite3_column_type(stmt, col + 5);
+            if (sqlite3_column_int(stmt, col + 1)) {
+                header |= BINARY_QUOTED;
+            }
+            if (sqlite3_column_type(stmt, col + 3) != SQLITE_NULL) {
+                header |= BINARY_NUMB_TEXT;
+            }
+            if (digits_type != SQLITE_INTEGER) {
+                header |= BINARY_DIGITS_TEXT;
+            }
+            if (su_type == SQLITE_INTEGER) {
+                header |= BINARY_SU_INTEGER;
+            } else if (su_type != SQLITE_NULL) {
+                header |= BINARY_SU_TEXT;
+            }
+            if (((result = binary_put_byte(writer, header)) == CIF_OK)
+                    && (((header & BINARY_NUMB_TEXT) == 0)
+                            || ((result = binary_put_text(writer, stmt, col + 3)) == CIF_OK))
+                    && ((result = binary_put_double(writer, sqlite3_column_double(stmt, col + 2))) == CIF_OK)
+                    && ((result = ((digits_type == SQLITE_INTEGER)
+                            ? binary_put_svarint(writer, sqlite3_column_int64(stmt, col + 4))
+                            : binary_put_text(writer, stmt, col + 4))) == CIF_OK)
+                    && ((result = ((su_type == SQLITE_INTEGER)
+                            ? binary_put_svarint(writer, sqlite3_column_int64(stmt, col + 5))
+                            : ((su_type == SQLITE_NULL) ? CIF_OK : binary_put_text(writer, stmt, col + 5))))
+                            == CIF_OK)) {
+                result = binary_put_svarint(writer, sqlite3_column_int64(stmt, col + 6));
+            }
+            return result;
+        case CIF_LIST_KIND:
+        case CIF_TABLE_KIND:
+            {
+                const void *blob = sqlite3_column_blob(stmt, col + 2);
+                size_t length = (size_t) sqlite3_column_bytes(stmt, col + 2);
+
+                if (((result = binary_put_byte(writer, header)) == CIF_OK)
+                        && ((result = binary_put_varint(writer, (sqlite3_uint64) length)) == CIF_OK)) {
+                    result = binary_put_bytes(writer, blob, length);
+                }
+            }
+            return result;
+        case CIF_NA_KIND:
+        case CIF_UNK_KIND:
+            return binary_put_byte(writer, header);
+        default:
+            return CIF_INTERNAL_ERROR;
+    }
+}
+
+static int binary_flush(binary_writer_t *writer) {
+    if ((writer->length > 0) && (fwrite(writer->buffer, 1, writer->length, writer->stream) != writer->length)) {
+        return CIF_ERROR;
+    }
+    writer->length = 0;
+
+    return CIF_OK;
+}
+
+static int binary_get_bytes(binary_reader_t *reader, void *bytes, size_t count) {
+    unsigned char *next = (unsigned char *) bytes;
+
+    while (count > 0) {
+        size_t chunk = reader->limit - reader->next;
+
+        if (chunk == 0) {
+            if (reader->read_error) {
+                return CIF_ERROR;
+            }
+            reader->next = 0;
+            reader->limit = fread(reader->buffer, 1, BINARY_BUFFER_SIZE, reader->stream);
+            if (reader->limit == 0) {
+                /* a read error, or input ending prematurely */
+                reader->read_error = CIF_TRUE;
+                return CIF_ERROR;
+            }
+            continue;
+        }
+        if (chunk > count) {
+            chunk = count;
+        }
+        memcpy(next, reader->buffer + reader->next, chunk);
+        reader->next += chunk;
+        next += chunk;
+        count -= chunk;
+    }
+
+    return CIF_OK;
+}
+
+static int binary_get_byte(binary_reader_t *reader, int *byte) {
+    if (reader->next < reader->limit) {
+        *byte = (int) reader->buffer[reader->next];
+        reader->next += 1;
+        return CIF_OK;
+    } else {
+        unsigned char c;
+        int result = binary_get_bytes(reader, &c, 1);
+
+        *byte = (int) c;
+        return result;
+    }
+}
+
+static int binary_get_varint(binary_reader_t *reader, sqlite3_uint64 *value) {
+    sqlite3_uint64 temp = 0;
+    int shift;
+
+    for (shift = 0; shift < 64; shift += 7) {
+        int byte;
+        int result = binary_get_byte(reader, &byte);
+
+        if (result != CIF_OK) {
+            return result;
+        }
+        temp |= ((sqlite3_uint64) (byte & 0x7f)) << shift;
+        if ((byte & 0x80) == 0) {
+            *value = temp;
+            return CIF_OK;
+        }
+    }
+
+    /* overlong */
+    return CIF_ERROR;
+}
+
+static int binary_get_svarint(binary_reader_t *reader, sqlite3_int64 *value) {
+    sqlite3_uint64 temp;
+    int result = binary_get_varint(reader, &temp);
+
+    if (result == CIF_OK) {
+        *value = ((temp & 1) ? (sqlite3_int64) ~(temp >> 1) : (sqlite3_int64) (temp >> 1));
+    }
+
+    return result;
+}
+
+static int binary_get_double(binary_reader_t *reader, double *value) {
+    unsigned char bytes[8];
+    int result = binary_get_bytes(reader, bytes, 8);
+
+    if (result == CIF_OK) {
+        sqlite3_uint64 bits = 0;
+        int i;
+
+        for (i = 7; i >= 0; i -= 1) {
+            bits = (bits << 8) | bytes[i];
+        }
+        memcpy(value, &bits, sizeof(*value));
+    }
+
+    return result;
+}
+
+static int binary_get_block(binary_reader_t *reader, size_t count, char **space, size_t *capacity) {
+    size_t done = 0;
+
+    do {
+        size_t chunk;
+        int result;
+
+        if (*capacity <= count) {
+            /* enough room for everything, or for twice what has been read so far, whichever is less */
+            size_t new_capacity = ((done < BINARY_BUFFER_SIZE / 2) ? BINARY_BUFFER_SIZE : (2 * done));
+
+            if (new_capacity >= count) {
+                new_capacity = count + 1;
+            }
+            if (new_capacity > *capacity) {
+                char *new_space = (char *) realloc(*space, new_capacity);
+
+                if (new_space == NULL) {
+                    return CIF_MEMORY_ERROR;
+                }
+                *space = new_space;
+                *capacity = new_capacity;
+            }
+        }
+        chunk = ((*capacity > count) ? count : *capacity) - done;
+        if ((result = binary_get_bytes(reader, *space + done, chunk)) != CIF_OK) {
+            return result;
+        }
+        done += chunk;
+    } while (done < count);
+
+    return CIF_OK;
+}
+
+static int binary_get_string(binary_reader_t *reader, const char **text, size_t *length) {
+    sqlite3_uint64 ref;
+    sqlite3_uint64 count;
+    char *string = NULL;
+    size_t capacity = 0;
+    int result;
+
+    if ((result = binary_get_varint(reader, &ref)) != CIF_OK) {
+        return result;
+    } else if (ref == 0) {
+        *text = NULL;
+        *length = 0;
+        return CIF_OK;
+    } else if ((ref & 1) == 0) {
+        /* a string read earlier */
+        if ((ref / 2) > reader->string_count) {
+            return CIF_ERROR;
+        }
+        *text = reader->strings[ref / 2 - 1];
+        *length = reader->lengths[ref / 2 - 1];
+        return CIF_OK;
+    }
+
+    /* a new string */
+    count = ref / 2;
+    if (count > INT_MAX) {
+        return CIF_ERROR;
+    }
+    if (reader->string_count == reader->string_capacity) {
+        size_t new_capacity = ((reader->string_capacity == 0) ? 1024 : (2 * reader->string_capacity));
+        char **new_strings = (char **) realloc(reader->strings, new_capacity * sizeof(char *));
+        size_t *new_lengths;
+
+        if (new_strings == NULL) {
+            return CIF_MEMORY_ERROR;
+        }
+        reader->strings = new_strings;
+        new_lengths = (size_t *) realloc(reader->lengths, new_capacity * sizeof(size_t));
+        if (new_lengths == NULL) {
+            return CIF_MEMORY_ERROR;
+        }
+        reader->lengths = new_lengths;
+        reader->string_capacity = new_capacity;
+    }
+    if ((result = binary_get_block(reader, (size_t) count, &string, &capacity)) != CIF_OK) {
+        free(string);
+        return result;
+    }
+    string[count] = '\0';
+    reader->strings[reader->string_count] = string;
+    reader->lengths[reader->string_count] = (size_t) count;
+    reader->string_count += 1;
+    *text = string;
+    *length = (size_t) count;
+
+    return CIF_OK;
+}
+
+static int binary_read_loops(binary_reader_t *reader, cif_tp *cif, sqlite3_stmt *insert_loop,
+        sqlite3_int64 container_id, sqlite3_uint64 next_loop_num) {
+    STEP_HANDLING;
+    int result;
+
+    while (CIF_TRUE) {
+        sqlite3_uint64 loop_ref;
+        sqlite3_uint64 last_row;
+        const char *category;
+        size_t category_length;
+        int loop_num;
+
+        if (((result = binary_get_varint(reader, &loop_ref)) != CIF_OK) || (loop_ref == 0)) {
+            return result;
+        } else if (loop_ref > next_loop_num) {
+            return CIF_ERROR;
+        } else if (((result = binary_get_string(reader, &category, &category_length)) != CIF_OK)
+                || ((result = binary_get_varint(reader, &last_row)) != CIF_OK)) {
+            return result;
+        } else if (last_row > BINARY_MAX_ID) {
+            return CIF_ERROR;
+        }
+        loop_num = (int) loop_ref - 1;
+
+        if ((sqlite3_bind_int64(insert_loop, 1, container_id) != SQLITE_OK)
+                || (sqlite3_bind_int(insert_loop, 2, loop_num) != SQLITE_OK)
+                || (((category == NULL) ? sqlite3_bind_null(insert_loop, 3)
+                        : sqlite3_bind_text(insert_loop, 3, category, (int) category_length, SQLITE_STATIC))
+                        != SQLITE_OK)
+                || (sqlite3_bind_int64(insert_loop, 4, (sqlite3_int64) last_row) != SQLITE_OK)
+                || (DEBUG_WRAP(cif->db, sqlite3_step(insert_loop)) != SQLITE_DONE)
+                || (sqlite3_reset(insert_loop) != SQLITE_OK)) {
+            return CIF_ERROR;
+        }
+
+        /* the loop's items, each followed by its values */
+        while (CIF_TRUE) {
+            const char *name;
+            size_t name_length;
+            const char *name_orig;
+            size_t name_orig_length;
+
+            if ((result = binary_get_string(reader, &name, &name_length)) != CIF_OK) {
+                return result;
+            } else if (name == NULL) {
+                break;
+            } else if ((result = binary_get_string(reader, &name_orig, &name_orig_length)) != CIF_OK) {
+                return result;
+            } else if (name_orig == NULL) {
+                return CIF_ERROR;
+            } else if ((result = binary_check_name(name, name_length, name_orig, name_orig_length)) != CIF_OK) {
+                return result;
+            } else if ((sqlite3_bind_int64(cif->add_loop_item_stmt, 1, container_id) != SQLITE_OK)
+                    || (sqlite3_bind_text(cif->add_loop_item_stmt, 2, name, (int) name_length, SQLITE_STATIC)
+                            != SQLITE_OK)
+                    || (sqlite3_bind_text(cif->add_loop_item_stmt, 3, name_orig, (int) name_orig_length,
+                            SQLITE_STATIC) != SQLITE_OK)
+                    || (sqlite3_bind_int(cif->add_loop_item_stmt, 4, loop_num) != SQLITE_OK)
+                    || (STEP_STMT(cif, add_loop_item) != SQLITE_DONE)) {
+                return CIF_ERROR;
+            } else if ((result = binary_read_column(reader, cif, container_id, name, name_length,
+                    ((last_row > 0) ? last_row : 1))) != CIF_OK) {
+                return result;
+            }
+        }
+
+        /* a scalar loop's row counter can be set only once it has its values */
+        if ((category != NULL) && (category_length == 0) && (last_row != 0)
+                && ((sqlite3_bind_int64(cif->set_packet_num_stmt, 1, (sqlite3_int64) last_row) != SQLITE_OK)
+                        || (sqlite3_bind_int64(cif->set_packet_num_stmt, 2, container_id) != SQLITE_OK)
+                        || (sqlite3_bind_int(cif->set_packet_num_stmt, 3, loop_num) != SQLITE_OK)
+                        || (STEP_STMT(cif, set_packet_num) != SQLITE_DONE))) {
+            return CIF_ERROR;
+        }
+    }
+}
+
+static int binary_read_column(binary_reader_t *reader, cif_tp *cif, sqlite3_int64 container_id, const char *name,
+        size_t name_length, sqlite3_uint64 last_row) {
+    STEP_HANDLING;
+    sqlite3_stmt *stmt = cif->insert_value_stmt;
+    sqlite3_uint64 row = 0;
+    sqlite3_int64 last_class = -1;
+    char decimal[BINARY_MAX_DECIMAL_DIGITS + 3];
+    int result;
+
+    while (CIF_TRUE) {
+        sqlite3_uint64 count;
+        sqlite3_int64 number = 0;
+        double val;
+        const char *text;
+        size_t length;
+        int scale = 0;
+        int header;
+        int kind;
+
+        if ((result = binary_get_byte(reader, &header)) != CIF_OK) {
+            return result;
+        } else if (header == BINARY_END_COLUMN) {
+            return CIF_OK;
+        } else if (header == BINARY_ROW_GAP) {
+            if ((result = binary_get_varint(reader, &count)) != CIF_OK) {
+                return result;
+            } else if (count >= last_row - row) {
+                /* the gap leaves no room for a value after it */
+                return CIF_ERROR;
+            }
+            row += count;
+            continue;
+        }
+
+        /* insert the value, binding only the properties of its kind */
+        if (row >= last_row) {
+            return CIF_ERROR;
+        }
+        row += 1;
+        kind = (header & BINARY_KIND_MASK);
+        if ((sqlite3_clear_bindings(stmt) != SQLITE_OK)
+                || (sqlite3_bind_int64(stmt, 1, container_id) != SQLITE_OK)
+                || (sqlite3_bind_text(stmt, 2, name, (int) name_length, SQLITE_STATIC) != SQLITE_OK)
+                || (sqlite3_bind_int64(stmt, 3, (sqlite3_int64) row) != SQLITE_OK)
+                || (sqlite3_bind_int(stmt, 4, kind) != SQLITE_OK)) {
+            return CIF_ERROR;
+        }
+        switch (kind) {
+            case CIF_CHAR_KIND:
+                if ((header & ~(BINARY_KIND_MASK | BINARY_QUOTED | BINARY_DECIMAL | BINARY_SAME_CLASS)) != 0) {
+                    return CIF_ERROR;
+                } else if (header & BINARY_DECIMAL) {
+                    sqlite3_int64 check_number;
+                    int check_scale;
+
+                    if (((result = binary_get_svarint(reader, &number)) != CIF_OK)
+                            || ((result = binary_get_varint(reader, &count)) != CIF_OK)) {
+                        return result;
+                    } else if (count > BINARY_MAX_DECIMAL_DIGITS) {
+                        return CIF_ERROR;
+                    }
+                    scale = (int) count;
+                    text = decimal;
+                    length = binary_format_decimal(decimal, number, scale);
+
+                    /* only a decimal that the writer would have encoded this way reproduces its text exactly */
+                    if (!binary_decimal_form((const unsigned char *) decimal, length, &check_number, &check_scale)
+                            || (check_number != number) || (check_scale != scale)) {
+                        return CIF_ERROR;
+                    }
+                } else if ((result = binary_get_string(reader, &text, &length)) != CIF_OK) {
+                    return result;
+                }
+                if (header & BINARY_SAME_CLASS) {
+                    if (last_class < 0) {
+                        return CIF_ERROR;
+                    }
+                } else if ((result = binary_get_varint(reader, &count)) != CIF_OK) {
+                    return result;
+                } else if (!binary_valid_text_class(count)) {
+                    return CIF_ERROR;
+                } else {
+                    last_class = (sqlite3_int64) count;
+                }
+                /* a decimal is stored compactly, as SET_VALUE_PROPS stores it, without its text */
+                if ((text == NULL)
+                        || (sqlite3_bind_int(stmt, 5, ((header & BINARY_QUOTED) != 0)) != SQLITE_OK)
+                        || ((header & BINARY_DECIMAL)
+                            ? ((sqlite3_bind_int64(stmt, 8, number) != SQLITE_OK)
+                                || (sqlite3_bind_int(stmt, 10, scale) != SQLITE_OK))
+                            : (sqlite3_bind_text(stmt, 6, text, (int) length, SQLITE_STATIC) != SQLITE_OK))
+                        || (sqlite3_bind_text(stmt, 7, text, (int) length, SQLITE_STATIC) != SQLITE_OK)
+                        || (sqlite3_bind_int64(stmt, 11, last_class) != SQLITE_OK)) {
+                    return CIF_ERROR;
+                }
+                break;
+            case CIF_NUMB_KIND:
+                if (((header & BINARY_SU_INTEGER) && (header & BINARY_SU_TEXT))
+                        || (sqlite3_bind_int(stmt, 5, ((header & BINARY_QUOTED) != 0)) != SQLITE_OK)) {
+                    return CIF_ERROR;
+                }
+                if (header & BINARY_NUMB_TEXT) {
+                    if ((result = binary_get_string(reader, &text, &length)) != CIF_OK) {
+                        return result;
+                    } else if ((text == NULL)
+                            || (sqlite3_bind_text(stmt, 6, text, (int) length, SQLITE_STATIC) != SQLITE_OK)) {
+                        return CIF_ERROR;
+                    }
+                }
+                if ((result = binary_get_double(reader, &val)) != CIF_OK) {
+                    return result;
+                } else if (sqlite3_bind_double(stmt, 7, val) != SQLITE_OK) {
+                    return CIF_ERROR;
+                }
+                if (header & BINARY_DIGITS_TEXT) {
+                    if ((result = binary_get_string(reader, &text, &length)) != CIF_OK) {
+                        return result;
+                    } else if ((text == NULL)
+                            || (sqlite3_bind_text(stmt, 8, text, (int) length, SQLITE_STATIC) != SQLITE_OK)) {
+                        return CIF_ERROR;
+                    }
+                } else if ((result = binary_get_svarint(reader, &number)) != CIF_OK) {
+                    return result;
+                } else if (sqlite3_bind_int64(stmt, 8, number) != SQLITE_OK) {
+                    return CIF_ERROR;
+                }
+                if (header & BINARY_SU_INTEGER) {
+                    if ((result = binary_get_svarint(reader, &number)) != CIF_OK) {
+                        return result;
+                    } else if (sqlite3_bind_int64(stmt, 9, number) != SQLITE_OK) {
+                        return CIF_ERROR;
+                    }
+                } else if (header & BINARY_SU_TEXT) {
+                    if ((result = binary_get_string(reader, &text, &length)) != CIF_OK) {
+                        return result;
+                    } else if ((text == NULL)
+                            || (sqlite3_bind_text(stmt, 9, text, (int) length, SQLITE_STATIC) != SQLITE_OK)) {
+                        return CIF_ERROR;
+                    }
+                }
+                /* the text of a number stored without it is rebuilt from the digits and a scale in this range */
+                if ((result = binary_get_svarint(reader, &number)) != CIF_OK) {
+                    return result;
+                } else if ((number > INT_MAX) || (number < INT_MIN)
+                        || (((header & BINARY_NUMB_TEXT) == 0) && ((number < 0) || (number > CIF_LINE_LENGTH)))
+                        || (sqlite3_bind_int64(stmt, 10, number) != SQLITE_OK)) {
+                    return CIF_ERROR;
+                }
+                break;
+            case CIF_LIST_KIND:
+            case CIF_TABLE_KIND:
+                if ((result = binary_get_varint(reader, &count)) != CIF_OK) {
+                    return result;
+                } else if ((header != kind) || (count > INT_MAX)) {
+                    return CIF_ERROR;
+                } else if ((result = binary_get_block(reader, (size_t) count, &(reader->blob),
+                        &(reader->blob_capacity))) != CIF_OK) {
+                    return result;
+                } else if ((cif_value_check_serialized_internal(reader->blob, (size_t) count, (cif_kind_tp) kind)
+                                != CIF_OK)
+                        || (sqlite3_bind_blob(stmt, 7, reader->blob, (int) count, SQLITE_STATIC) != SQLITE_OK)) {
+                    return CIF_ERROR;
+                }
+                break;
+            case CIF_NA_KIND:
+            case CIF_UNK_KIND:
+                if (header != kind) {
+                    return CIF_ERROR;
+                }
+                break;
+            default:
+                return CIF_ERROR;
+        }
+
+        if (STEP_STMT(cif, insert_value) != SQLITE_DONE) {
+            return CIF_ERROR;
+        }
+    }
+}
+
+static int binary_valid_text_class(sqlite3_uint64 text_class) {
+    return ((text_class == 0) || (((text_class & ~(sqlite3_uint64) BINARY_TEXT_CLASS_MASK) == 0)
+            && ((text_class & TEXT_CLASS_KNOWN) != 0)
+            && (TEXT_CLASS_DELIM(text_class, CIF_FALSE) <= BINARY_MAX_DELIM)
+            && (TEXT_CLASS_DELIM(text_class, CIF_TRUE) <= BINARY_MAX_DELIM)));
+}
+
+static int binary_check_name(const char *name, size_t name_length, const char *name_orig, size_t name_orig_length) {
+    char *normalized = NULL;
+    int result;
+
+    /* the strings read are NUL-terminated, but may also contain NULs */
+    if ((strlen(name_orig) != name_orig_length) || (strlen(name) != name_length)) {
+        return CIF_ERROR;
+    } else if ((result = cif_normalize_utf8_internal(name_orig, UTF8_NO_VALIDATION, &normalized, CIF_ERROR))
+            == CIF_OK) {
+        if (strcmp(normalized, name) != 0) {
+            result = CIF_ERROR;
+        }
+        free(normalized);
+    }
+
+    return result;
+}
+
+static int binary_decimal_form(const unsigned char *text, size_t length, sqlite3_int64 *mantissa, int *scale) {
+    char formatted[BINARY_MAX_DECIMAL_DIGITS + 3];
+    sqlite3_int64 value = 0;
+    size_t digits = 0;
+    size_t i = 0;
+    int negative = CIF_FALSE;
+    int fraction_digits = -1;
+
+    if ((length > 0) && (text[0] == '-')) {
+        negative = CIF_TRUE;
+        i = 1;
+    }
+    for (; i < length; i += 1) {
+        if ((text[i] >= '0') && (text[i] <= '9')) {
+            if (++digits > BINARY_MAX_DECIMAL_DIGITS) {
+                return CIF_FALSE;
+            }
+            value = 10 * value + (text[i] - '0');
+            if (fraction_digits >= 0) {
+                fraction_digits += 1;
+            }
+        } else if ((text[i] == '.') && (fraction_digits < 0)) {
+            fraction_digits = 0;
+        } else {
+            return CIF_FALSE;
+        }
+    }
+    if (digits == 0) {
+        return CIF_FALSE;
+    }
+    *mantissa = (negative ? -value : value);
+    *scale = ((fraction_digits < 0) ? 0 : fraction_digits);
+
+    /* forms such as "007", "-0", "1." and ".5" do not survive reformatting */
+    return ((binary_format_decimal(formatted, *mantissa, *scale) == length) && (memcmp(formatted, text, length) == 0));
+}
+
+static size_t binary_format_decimal(char *buffer, sqlite3_int64 mantissa, int scale) {
+    char digits[BINARY_MAX_DECIMAL_DIGITS + 2];
+    sqlite3_uint64 value = ((mantissa < 0) ? (0 - (sqlite3_uint64) mantissa) : (sqlite3_uint64) mantissa);
+    size_t count = 0;
+    size_t length = 0;
+
+    /* the digits, least significant first, at least one more than the scale */
+    do {
+        digits[count++] = (char) ('0' + (value % 10));
+        value /= 10;
+    } while (((value > 0) || (count <= (size_t) scale)) && (count < sizeof(digits)));
+
+    if (mantissa < 0) {
+        buffer[length++] = '-';
+    }
+    while (count > 0) {
+        if (count == (size_t) scale) {
+            buffer[length++] = '.';
+        }
+        buffer[length++] = digits[--count];
+    }
+
+    return length;
+}
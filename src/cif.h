@@ -660,6 +660,16 @@ typedef struct cif_packet_s cif_packet_tp;
  */
 typedef struct cif_pktitr_s cif_pktitr_tp;
 
+/**
+ * @brief An opaque data structure encapsulating the state of a pull-style reader of CIF text
+ */
+typedef struct cif_reader_s cif_reader_tp;
+
+/**
+ * @brief An opaque data structure encapsulating the state of an incremental writer of CIF text
+ */
+typedef struct cif_writer_s cif_writer_tp;
+
 /**
  * @brief The type of all data value objects
  */
@@ -822,6 +832,70 @@ typedef int (*cif_parse_error_callback_tp)(int code, size_t line, size_t column,
  */
 typedef void (*cif_syntax_callback_tp)(size_t line, size_t column, const UChar *token, size_t length, void *data);
 
+/**
+ * @brief A lightweight, undecoded view of a data value as it appears in CIF text.
+ *
+ * Token views are presented to an item token callback (see @c cif_item_token_callback_tp ) in place of fully
+ * decoded value objects.  The view, and the text to which it refers, belong to the parser and are valid only for the
+ * duration of the callback.  A callback that needs the value itself may obtain it via @c cif_token_get_value().
+ */
+struct cif_token_s {
+
+    /**
+     * @brief a hint at the kind of value represented: @c CIF_LIST_KIND or @c CIF_TABLE_KIND for the corresponding
+     * composite values, @c CIF_UNK_KIND or @c CIF_NA_KIND for an unquoted question mark or period, respectively, and
+     * otherwise @c CIF_CHAR_KIND.  Values that would be interpreted as numbers are not distinguished from other
+     * character values.
+     */
+    cif_kind_tp kind;
+
+    /**
+     * @brief whether the value was presented in quoted form (including as a text field)
+     */
+    cif_quoted_tp quoted;
+
+    /**
+     * @brief non-zero if and only if the value was presented as a text field
+     */
+    int text_field;
+
+    /**
+     * @brief the raw text of the value, without delimiters, or @c NULL for a list or table value.  The text of a text
+     * field is presented as it appears in the input, before any de-prefixing or line unfolding.  This text is @em not
+     * necessarily NUL-terminated.
+     */
+    const UChar *text;
+
+    /**
+     * @brief the number of @c UChar code units in @c text
+     */
+    size_t length;
+
+    /**
+     * @brief parser-private context supporting @c cif_token_get_value(); must not be modified
+     */
+    void *context;
+};
+
+/**
+ * @brief A pointer to a callback function by which a client application can be presented data items without their
+ *         values first being decoded
+ *
+ * If an item token callback is provided among the parse options then the parser invokes it for each data item
+ * (whether looped or not) before decoding the item's value, in place of the @c handle_item callback of the handler,
+ * if any.  The parser decodes the value only if the callback requests it via @c cif_token_get_value() or if it is
+ * needed to record the item in the target CIF.  This allows a client that is interested in only a few items to
+ * avoid the cost of decoding all the rest.
+ *
+ * @param[in] name the data name of the item, as a NUL-terminated Unicode string belonging to the parser
+ * @param[in,out] token a view of the item's value as it appears in the CIF text
+ * @param[in,out] data a pointer to the user data object provided by the parser caller
+ *
+ * @return Returns a @c CIF_TRAVERSE_* code as a @c handle_item callback would, with the same significance, or
+ *         an error code to abort the parse
+ */
+typedef int (*cif_item_token_callback_tp)(UChar *name, struct cif_token_s *token, void *data);
+
 /**
  * @brief Represents a collection of CIF parsing options.
  *
@@ -1059,6 +1133,67 @@ struct cif_parse_opts_s {
      *         parser itself, and may be @c NULL.
      */
     void *user_data;
+
+    /**
+     * @brief The maximum number of threads with which to parse a CIF containing multiple data blocks
+     *
+     * If greater than 1, and if the library was built with thread support, then the parser may split the input at
+     * data block headers and parse the resulting pieces concurrently, each into a separate, temporary store, before
+     * merging the results into the target CIF in document order.  The whole input is read into memory before
+     * parsing begins in this mode.
+     *
+     * Parallel parsing is performed only when no @c handler, no @c item_token_callback, and none of the syntax
+     * callbacks (@c whitespace_callback, @c keyword_callback, and @c dataname_callback) are specified, for they could
+     * not be invoked in document order by concurrent workers.  Any part of the input in which an error is detected is re-parsed serially, so the
+     * @c error_callback (if any) is invoked exactly as in a serial parse, with correct line numbers, and the results
+     * are the same as those of a serial parse.
+     *
+     * Values less than 2 disable parallel parsing; this is the default.
+     */
+    int max_parse_threads;
+
+    /**
+     * @brief A callback function by which the client application can be notified of data items before their values
+     *         are decoded; may be @c NULL.
+     *
+     * If not @c NULL, this function is invoked for each data item in place of the @c handle_item callback of the
+     * @c handler (which is then ignored), receiving a view of the item's value as it appears in the CIF text.  Values
+     * are fully decoded only when the callback asks for them via @c cif_token_get_value() or when they must be
+     * recorded in the target CIF.  Parallel parsing is not performed when this callback is specified.
+     *
+     * The default is @c NULL.
+     */
+    cif_item_token_callback_tp item_token_callback;
+
+    /**
+     * @brief Patterns designating the data names to be loaded; may be @c NULL.
+     *
+     * If not @c NULL, this is a NULL-terminated array of data name patterns, and only data items matching at least
+     * one of them are loaded (subject also to @c exclude_names ).  Each pattern is an ASCII string that is matched
+     * against data names case-insensitively.  A pattern ending with an asterisk (@c '*') matches every data name that
+     * begins with the rest of the pattern, such as @c "_cell_*" for the CIF 1 cell category.  Any other pattern
+     * matches the data name it spells, and also, as a DDL2 category name, every data name consisting of the pattern
+     * followed by a period and further characters.  Thus @c "_cell" selects both @c _cell and @c _cell.length_a .
+     *
+     * Items that are not selected are passed over as if they were not present: no handler or item token callbacks
+     * are invoked for them, their values are not decoded, and they are not recorded in the target CIF.  Syntax
+     * errors within them are still reported, however.  Columns of a loop that are not selected are omitted from the
+     * loop, and a loop having no selected columns is passed over altogether, without handler callbacks.
+     *
+     * The default is @c NULL, which selects all data names.
+     */
+    const char **include_names;
+
+    /**
+     * @brief Patterns designating data names to be passed over; may be @c NULL.
+     *
+     * If not @c NULL, this is a NULL-terminated array of data name patterns, of the same form as for
+     * @c include_names , and data items matching any of them are not loaded, even if they are selected by
+     * @c include_names .
+     *
+     * The default is @c NULL.
+     */
+    const char **exclude_names;
 };
 
 /**
@@ -1076,8 +1211,109 @@ struct cif_write_opts_s {
      * represented.
      */
     int cif_version;
+
+    /**
+     * @brief The maximum number of threads with which to format a CIF
+     *
+     * If greater than 1, and if the library was built with thread support, then the writer may format different
+     * loops (including the scalar "loops" of data blocks and save frames) concurrently, each worker thread reading from
+     * its own, private copy of the CIF and formatting into its own buffer, before the pieces are delivered to the
+     * destination in document order.  The output, and the result of the write, are the same as those of a serial write;
+     * the whole output is held in memory before any of it is delivered, however, and each copy of the CIF occupies as
+     * much memory as the original.
+     *
+     * Values less than 2 disable parallel writing; this is the default.
+     */
+    int max_write_threads;
+
+    /**
+     * @brief Whether to align the columns of loops
+     *
+     * If nonzero, then the values of each loop are padded with spaces so that each column begins at the same position
+     * on every line, for readability.  The widths of the columns are determined in advance, with a single query of the
+     * CIF per loop, so the packets are still formatted one at a time.  Alignment extends only to the columns that all
+     * fit on one line.  Multi-line values and list and table values are not accounted for in column widths, and may
+     * displace the values following them in the same packet.
+     *
+     * The default is zero, which separates values by single spaces.
+     */
+    int align_loops;
+
+    /**
+     * @brief Whether to write CIF-JSON instead of CIF
+     *
+     * If nonzero, then the output is a CIF-JSON document, encoded in UTF-8, instead of CIF text.  Each data block and
+     * save frame is written as an object whose members are the data names of its items, each bearing an array of
+     * the item's values in packet order, and whose save frames are members of a nested object under the key
+     * @c "Frames" .  Character and number values are written as JSON strings of their text, list values as arrays,
+     * table values as objects, the not-applicable value as @c null , and the unknown value as the string @c "\\?" .
+     * Each column of a loop is streamed from the CIF with a single query per loop, so only one value at a time is
+     * held in memory.  Loops without packets are omitted.  The grouping of items into loops is not represented, and
+     * the @c cif_version , @c max_write_threads , and @c align_loops options do not apply; the selection options do.
+     *
+     * The default is zero, which writes CIF.
+     */
+    int json;
+
+    /**
+     * @brief The codes of the data blocks to write; may be @c NULL.
+     *
+     * If not @c NULL, this is a NULL-terminated array of block codes, and only the data blocks bearing one of them
+     * (compared as block codes are always compared, without regard to case) are written.  Other blocks are passed over
+     * without anything more about them being read from the CIF.
+     *
+     * The default is @c NULL, which selects all data blocks.
+     */
+    const UChar **block_codes;
+
+    /**
+     * @brief The codes of the save frames to write; may be @c NULL.
+     *
+     * If not @c NULL, this is a NULL-terminated array of frame codes, and only the save frames bearing one of them
+     * are written.  Other save frames are passed over, together with any save frames nested within them, without
+     * anything more about them being read from the CIF.  An array containing only its terminating @c NULL therefore
+     * omits all save frames.
+     *
+     * The default is @c NULL, which selects all save frames.
+     */
+    const UChar **frame_codes;
+
+    /**
+     * @brief Patterns designating the only data names to write; may be @c NULL.
+     *
+     * If not @c NULL, this is a NULL-terminated array of data name patterns, of the same form and significance as the
+     * @c include_names parse option, and only data items matching at least one of them are written (subject also to
+     * @c exclude_names ).  Columns of a loop that are not selected are omitted from the loop, and a loop having no
+     * selected columns is passed over altogether, without its packets being read from the CIF.
+     *
+     * The default is @c NULL, which selects all data names.
+     */
+    const char **include_names;
+
+    /**
+     * @brief Patterns designating data names not to write; may be @c NULL.
+     *
+     * If not @c NULL, this is a NULL-terminated array of data name patterns, of the same form as for
+     * @c include_names , and data items matching any of them are not written, even if they are selected by
+     * @c include_names .
+     *
+     * The default is @c NULL.
+     */
+    const char **exclude_names;
 };
 
+/**
+ * @brief The type of a function to which @c cif_write_to_sink() passes formatted CIF output.
+ *
+ * @param[in,out] context the context pointer provided to @c cif_write_to_sink()
+ * @param[in] bytes the next @p count bytes of output; they belong to the caller, and are valid only for the duration
+ *         of the call
+ * @param[in] count the number of bytes of output available at @p bytes
+ *
+ * @return Returns zero if all the bytes were consumed, or nonzero to abort the write
+ */
+typedef int (*cif_write_sink_tp)(void *context, const char *bytes, size_t count);
+
 /**
  * @brief Represents the results of analyzing a string for characteristics directing its form when presented as a CIF
  * data value.
@@ -1142,6 +1378,79 @@ struct cif_string_analysis_s {
     int has_trailing_ws;
 };
 
+/**
+ * @brief The kinds of events reported by a CIF reader
+ */
+typedef enum cif_event_kind {
+    /** @brief The start of a data block; the event text is the block code (empty for a block lacking a header) */
+    CIF_EVENT_BLOCK_START,
+
+    /** @brief The end of a data block */
+    CIF_EVENT_BLOCK_END,
+
+    /** @brief The start of a save frame; the event text is the frame code */
+    CIF_EVENT_FRAME_START,
+
+    /** @brief The end of a save frame */
+    CIF_EVENT_FRAME_END,
+
+    /** @brief The start of a loop, signaled by a @c loop_ keyword */
+    CIF_EVENT_LOOP_START,
+
+    /** @brief A data name in a loop header; the event text is the data name */
+    CIF_EVENT_LOOP_NAME,
+
+    /** @brief A value in a loop body; the event text is the data name of the value's loop column */
+    CIF_EVENT_LOOP_VALUE,
+
+    /** @brief The end of a loop */
+    CIF_EVENT_LOOP_END,
+
+    /** @brief A data item outside any loop; the event text is the item's data name */
+    CIF_EVENT_ITEM
+} cif_event_kind_tp;
+
+/**
+ * @brief Describes one event reported by a CIF reader.
+ *
+ * All pointers in an event object refer to data belonging to the reader.  They are valid only until the next call
+ * to @c cif_reader_next() or @c cif_reader_close() for the same reader; a caller that needs the data longer must
+ * copy them.
+ */
+struct cif_event_s {
+
+    /**
+     * @brief the kind of event
+     */
+    cif_event_kind_tp kind;
+
+    /**
+     * @brief the block code, frame code, or data name associated with the event, if any, otherwise @c NULL.  This
+     * text is @em not necessarily NUL-terminated.
+     */
+    const UChar *text;
+
+    /**
+     * @brief the number of @c UChar code units in @c text
+     */
+    size_t length;
+
+    /**
+     * @brief the data value associated with an item or loop value event, otherwise @c NULL
+     */
+    cif_value_tp *value;
+
+    /**
+     * @brief the one-based number of the input line on which the event was recognized
+     */
+    size_t line;
+
+    /**
+     * @brief the number of characters of the current line that had been consumed when the event was recognized
+     */
+    size_t column;
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -1208,6 +1517,82 @@ CIF_INTFUNC_DECL(cif_parse, (
         cif_tp **cif
         ));
 
+/**
+ * @brief Reads a CIF-JSON document from the specified stream into a managed CIF.
+ *
+ * The document must be a JSON object, encoded in UTF-8, having a member @c "CIF-JSON" whose value is an object.  Each
+ * member of that object other than @c "Metadata" is read as a data block whose block code is the member's key, and
+ * each member of a block's (or save frame's) @c "Frames" object likewise as a save frame.  Other members of block and
+ * frame objects are data items, each bearing an array of its values; other members of the document object, and the
+ * metadata, are ignored.  This is the form in which @c cif_write() and its relatives write CIF-JSON when the @c json
+ * write option is set.
+ *
+ * JSON strings are read as character values, except that the string @c "\\?" denotes the unknown value; like
+ * unquoted CIF values, strings that have the form of numbers are taken as numbers when they are used as such.  JSON
+ * numbers are read in the same way as strings of the same text, @c null as the not-applicable value, arrays as
+ * lists, and objects as tables.  JSON @c true and @c false have no CIF counterpart, and are rejected.
+ *
+ * Because CIF-JSON does not represent loops, the loop structure is inferred: an item having exactly one value is
+ * recorded as a scalar, and an item having more joins the loop of the item preceding it in the same container if
+ * that one has the same number of values and the same category (the part of the data name up to its first period),
+ * or else starts a new loop.  A loop having only one packet is therefore read back as scalars.  The values of each
+ * item are recorded in a single transaction as soon as they have been read, so only one item's values are held in
+ * memory at a time.
+ *
+ * The input is read through to the end of the document object; any content other than whitespace following it is an
+ * error.  A stream containing only whitespace yields no data blocks.
+ *
+ * @param[in,out] stream a @c FILE @c * from which to read the CIF-JSON document; must be a non-NULL pointer to a
+ *         readable stream, open in @b BINARY mode on any system where that makes a difference
+ *
+ * @param[in,out] cif the location of a handle on the CIF to which to add the data; must not be NULL.  If a NULL handle
+ *         is initially recorded there then a new CIF is created to receive the data and its handle is recorded in its
+ *         place, with ownership going to the caller.
+ *
+ * @return Returns @c CIF_OK on success, @c CIF_ARGUMENT_ERROR if @p stream or @p cif is NULL, or else an error code.
+ *         Malformed JSON is reported as @c CIF_INVALID_CHAR , @c CIF_MISSING_DELIM , @c CIF_MISSING_ENDQUOTE , or
+ *         @c CIF_MISSING_VALUE , and a JSON document of the wrong form, including one having an item with an empty
+ *         array of values, as @c CIF_UNEXPECTED_VALUE .  Invalid or duplicate block codes, frame codes, and data
+ *         names are reported as they are by the functions that create those.  In the event of a failure, a new CIF
+ *         object may still be created and returned via the @p cif argument, or the provided one may still be
+ *         modified.
+ */
+CIF_INTFUNC_DECL(cif_parse_json, (
+        FILE *stream,
+        cif_tp **cif
+        ));
+
+/**
+ * @brief Reloads CIF data saved by @c cif_write_binary() from the specified stream into a managed CIF.
+ *
+ * The data are recorded directly in the CIF's storage, in a single transaction, without being parsed or validated
+ * as CIF text would be.  Input that has been truncated or damaged is nevertheless detected and rejected wherever
+ * it could not have been written by @c cif_write_binary() , including every count, length and reference it
+ * contains and the full content of list and table values.  Block codes, frame codes and data names are checked only
+ * for being well-formed, not for being valid CIF, so that any CIF saved by @c cif_write_binary() -- including one
+ * holding names recovered from erroneous CIF text -- can be reloaded.  The data blocks read follow any already
+ * present in the target CIF.  Reading stops at the end of the saved data, so other content may follow them in the
+ * stream, but the stream position is then undefined.
+ *
+ * @param[in,out] stream a @c FILE @c * from which to read the binary form; must be a non-NULL pointer to a readable
+ *         stream, open in @b BINARY mode on any system where that makes a difference
+ *
+ * @param[in,out] cif the location of a handle on the CIF to which to add the data; must not be NULL.  If a NULL handle
+ *         is initially recorded there then a new CIF is created to receive the data and its handle is recorded in its
+ *         place, with ownership going to the caller.
+ *
+ * @return Returns @c CIF_OK on success, @c CIF_ARGUMENT_ERROR if @p stream or @p cif is NULL, @c CIF_DUP_BLOCKCODE
+ *         if a data block read has the same code as one already present in the target CIF, @c CIF_NOT_SUPPORTED if
+ *         the input was written in a later version of the binary form than this library supports, or else an error
+ *         code (typically @c CIF_ERROR , as for input that is truncated or not in the binary form at all).  On
+ *         failure, the target CIF is unchanged, though a new one may still have been created and returned via the
+ *         @p cif argument.
+ */
+CIF_INTFUNC_DECL(cif_read_binary, (
+        FILE *stream,
+        cif_tp **cif
+        ));
+
 /**
  * @brief Allocates a parse options structure and initializes it with default values.
  *
@@ -1256,6 +1641,90 @@ CIF_INTFUNC_DECL(cif_parse_error_die, (
         void *data
         ));
 
+/**
+ * @brief Provides the decoded data value corresponding to a token view presented to an item token callback.
+ *
+ * The value is decoded from the CIF text on the first call for any given token; subsequent calls for the same token
+ * provide the same value object.  Any errors detected while decoding are reported to the error callback, as if the
+ * value had been decoded without the token callback's involvement.  This function may be called only during the
+ * item token callback to which the token was presented.
+ *
+ * @param[in,out] token a pointer to the token view presented to the item token callback
+ * @param[out] value the location where a pointer to the decoded value should be recorded; must not be NULL.  The
+ *         value belongs to the parser, and remains valid only for the duration of the callback.  The callback may
+ *         modify it, however, and if it does so then the modified value is the one recorded in the target CIF.
+ *
+ * @return Returns @c CIF_OK on success, or an error code on failure
+ */
+CIF_INTFUNC_DECL(cif_token_get_value, (
+        struct cif_token_s *token,
+        cif_value_tp **value
+        ));
+
+/**
+ * @brief Opens a pull-style reader of the CIF text in the specified stream.
+ *
+ * Where @c cif_parse() drives the whole parse itself, invoking callbacks, a reader instead reports the syntactic
+ * structure of its input one event at a time, on request, via @c cif_reader_next().  Only a bounded amount of the
+ * input is held in memory at any time (apart from individual values), nothing is stored in a managed CIF, and the
+ * caller may stop reading at any point.  Several readers may be used in an interleaved fashion.
+ *
+ * The character encoding and CIF version of the input are determined in the same way that @c cif_parse() determines
+ * them, and the same parse options apply, except that the @c handler , @c item_token_callback , @c include_names ,
+ * and @c exclude_names options are ignored.  Errors are reported to the error callback as they are detected.
+ * Because nothing is stored, semantic errors such as duplicate block codes or data names are not detected.
+ *
+ * @param[in,out] stream a @c FILE @c * from which to read the raw CIF data; must be a non-NULL pointer to a readable
+ *         stream, open in @b BINARY mode on any system where that makes a difference.  The caller retains ownership of
+ *         this stream, and must not close it before closing the reader.
+ *
+ * @param[in] options a pointer to a @c struct @c cif_parse_opts_s object describing options to use while reading, or
+ *         @c NULL to use default values for all options.  The reader refers to the options object while it is open.
+ *
+ * @param[out] reader the location where a handle on the new reader should be recorded; must not be NULL.  On success,
+ *         the caller assumes responsibility for closing the reader via @c cif_reader_close().
+ *
+ * @return Returns @c CIF_OK on success, or an error code (typically @c CIF_ERROR ) on failure
+ */
+CIF_INTFUNC_DECL(cif_reader_open, (
+        FILE *stream,
+        struct cif_parse_opts_s *options,
+        cif_reader_tp **reader
+        ));
+
+/**
+ * @brief Reads the next event from the specified reader.
+ *
+ * Events are reported in input order, and all structures are properly nested: every block, frame, and loop start
+ * event is eventually followed by a corresponding end event, even when the input is erroneous (provided that the
+ * error callback elects to continue).  The values of each loop are reported row by row, as they appear.
+ *
+ * @param[in,out] reader a handle on the reader from which to read an event; must be an open reader
+ *
+ * @param[out] event a pointer to the event object in which to describe the next event; must not be NULL
+ *
+ * @return Returns @c CIF_OK if an event was read, @c CIF_FINISHED if the end of the input has been reached, or an
+ *         error code on failure.  Errors include those returned by the error callback to abort reading.  After an
+ *         error, the only valid operation on the reader is to close it.
+ */
+CIF_INTFUNC_DECL(cif_reader_next, (
+        cif_reader_tp *reader,
+        struct cif_event_s *event
+        ));
+
+/**
+ * @brief Closes the specified reader, releasing all resources associated with it.
+ *
+ * The stream from which the reader was reading is not closed.  Its position is undefined.
+ *
+ * @param[in,out] reader a handle on the reader to close
+ *
+ * @return Returns @c CIF_OK on success, or an error code (typically @c CIF_ERROR ) on failure
+ */
+CIF_INTFUNC_DECL(cif_reader_close, (
+        cif_reader_tp *reader
+        ));
+
 /**
  * @brief Formats the CIF data represented by the @c cif handle to the specified output stream.
  *
@@ -1292,6 +1761,295 @@ CIF_INTFUNC_DECL(cif_write, (
         cif_tp *cif
         ));
 
+/**
+ * @brief Formats the CIF data represented by the @c cif handle, passing the output to the specified sink function.
+ *
+ * The output is the same as @c cif_write() would produce with the same options, but instead of being written to a
+ * stream it is passed in chunks, in order, to @p sink.  This is suitable for directing output to sockets, compressors,
+ * digest functions, or other destinations that do not have a @c FILE interface.  In CIF 2.0 mode the chunks are
+ * UTF-8; chunk boundaries are not guaranteed to fall on character boundaries.
+ *
+ * Ownership of the arguments does not transfer to the function.
+ *
+ * @param[in] sink the function to which to pass the output; must not be NULL.  If the sink returns nonzero then
+ *         writing stops, and this function fails with @c CIF_ERROR.
+ *
+ * @param[in] sink_context an arbitrary pointer to pass as the first argument to each call to @p sink; may be NULL
+ *
+ * @param[in] options a pointer to a @c struct @c cif_write_opts_s object describing options to use for writing, or
+ *         @c NULL to use default values for all options
+ *
+ * @param[in] cif a handle on the CIF object to serialize
+ *
+ * @return Returns @c CIF_OK if the data are fully written, @c CIF_ARGUMENT_ERROR if @p sink is NULL, or else an error
+ *         code as for @c cif_write()
+ */
+CIF_INTFUNC_DECL(cif_write_to_sink, (
+        cif_write_sink_tp sink,
+        void *sink_context,
+        struct cif_write_opts_s *options,
+        cif_tp *cif
+        ));
+
+/**
+ * @brief Formats the CIF data represented by the @c cif handle to the specified file descriptor.
+ *
+ * The output is the same as @c cif_write() would produce with the same options, but it is written directly to @p fd
+ * via @c write(), without stdio buffering.  Partial writes and interrupted writes are resumed.  The descriptor is not
+ * closed.
+ *
+ * @param[in] fd an open file descriptor to which to write the CIF format output
+ *
+ * @param[in] options a pointer to a @c struct @c cif_write_opts_s object describing options to use for writing, or
+ *         @c NULL to use default values for all options
+ *
+ * @param[in] cif a handle on the CIF object to serialize
+ *
+ * @return Returns @c CIF_OK if the data are fully written, @c CIF_NOT_SUPPORTED on systems that do not provide
+ *         @c write(), or else an error code as for @c cif_write()
+ */
+CIF_INTFUNC_DECL(cif_write_fd, (
+        int fd,
+        struct cif_write_opts_s *options,
+        cif_tp *cif
+        ));
+
+/**
+ * @brief Formats the CIF data represented by the @c cif handle into a newly-allocated block of memory.
+ *
+ * The output is the same as @c cif_write() would produce with the same options.  On success, the output is recorded
+ * in a block of memory belonging to the caller, which is responsible for freeing it.  The block carries a terminating
+ * NUL byte after the output, for convenience, but the output may contain NUL bytes of its own in CIF 1.1 mode with
+ * some default encodings, so the length should be used where that matters.
+ *
+ * @param[in] cif a handle on the CIF object to serialize
+ *
+ * @param[in] options a pointer to a @c struct @c cif_write_opts_s object describing options to use for writing, or
+ *         @c NULL to use default values for all options
+ *
+ * @param[in,out] bytes the location where a pointer to the output should be recorded; must not be NULL.  The initial
+ *         value of @p *bytes is ignored, and it is modified only on success.
+ *
+ * @param[in,out] length the location where the length of the output, in bytes, not counting the terminating NUL,
+ *         should be recorded, or NULL if the length is not needed.  Modified only on success.
+ *
+ * @return Returns @c CIF_OK on success, @c CIF_ARGUMENT_ERROR if @p bytes is NULL, or else an error code as for
+ *         @c cif_write() (including @c CIF_MEMORY_ERROR if the output cannot be accommodated)
+ */
+CIF_INTFUNC_DECL(cif_write_buffer, (
+        cif_tp *cif,
+        struct cif_write_opts_s *options,
+        char **bytes,
+        size_t *length
+        ));
+
+/**
+ * @brief Saves the CIF data represented by the @c cif handle to the specified stream in a compact binary form, from
+ *        which @c cif_read_binary() can reload them much faster than they could be parsed from CIF text.
+ *
+ * The binary form records the contents of the CIF exactly as they are stored: containers, loops, and items keep
+ * their codes and names as originally given, their order, and their loop numbers, and values keep their quoted flags
+ * and, for numbers, their text.  It is columnar, each loop's values being recorded item by item, with strings
+ * recorded only once each and referred to thereafter, numbers by their integer mantissas, and list and table values
+ * in their internal serialized form.  The form is specific to this library, and is not meant for interchange with
+ * other software.
+ *
+ * Ownership of the arguments does not transfer to the function.
+ *
+ * @param[in,out] stream a @c FILE @c * to which to write the binary form; must be a non-NULL pointer to a writable
+ *         stream, open in @b BINARY mode on any system where that makes a difference
+ *
+ * @param[in] cif a handle on the CIF object to save
+ *
+ * @return Returns @c CIF_OK if the data are fully written, @c CIF_ARGUMENT_ERROR if @p stream is NULL,
+ *         @c CIF_INVALID_HANDLE if @p cif is NULL, or else an error code (typically @c CIF_ERROR ).  The stream state
+ *         is undefined after a failure.
+ */
+CIF_INTFUNC_DECL(cif_write_binary, (
+        FILE *stream,
+        cif_tp *cif
+        ));
+
+/**
+ * @brief Opens an incremental writer of CIF text, which formats data as they are presented to it, without storing them.
+ *
+ * Where @c cif_write() formats a whole managed CIF, a writer accepts the structure of its output one element at a
+ * time: data block and save frame headers via @c cif_writer_begin_block() and @c cif_writer_begin_frame(), items
+ * outside loops via @c cif_writer_item(), and loops via @c cif_writer_begin_loop() followed by
+ * @c cif_writer_packet() for each packet.  Each element is formatted exactly as @c cif_write() would format it, and
+ * only a bounded amount of output is held in memory at any time, so arbitrarily large CIFs can be produced without
+ * first being loaded into a managed CIF.  A loop ends, and a save frame or data block is closed, implicitly when the
+ * next element that cannot belong to it is presented, or when the writer is closed.
+ *
+ * Because nothing is stored, semantic errors such as duplicate block codes or data names are not detected.  Block
+ * codes, frame codes, and data names are validated, however, and they and all values are checked for expressibility
+ * in CIF 1.1 when that version is requested.  A function that rejects its arguments has no effect, but once a
+ * function fails after output of an element has begun, all subsequent operations on the writer other than closing it
+ * fail with the same error code.
+ *
+ * @param[in] sink the function to which to pass the formatted output, in one or more pieces; must not be NULL
+ *
+ * @param[in] sink_context an arbitrary pointer to pass to the sink with each piece of output; may be NULL
+ *
+ * @param[in] options a pointer to a @c struct @c cif_write_opts_s object describing options to use for writing, or
+ *         @c NULL to use default values for all options.  Options pertaining to whole CIFs, such as
+ *         @c max_write_threads , @c align_loops , @c json , and the selection options, are ignored.
+ *
+ * @param[out] writer the location where a handle on the new writer should be recorded; must not be NULL.  On success,
+ *         the caller assumes responsibility for closing the writer via @c cif_writer_close().
+ *
+ * @return Returns @c CIF_OK on success, @c CIF_ARGUMENT_ERROR if @p sink or @p writer is NULL, or an error code
+ *         (typically @c CIF_ERROR ) on failure
+ */
+CIF_INTFUNC_DECL(cif_writer_open, (
+        cif_write_sink_tp sink,
+        void *sink_context,
+        struct cif_write_opts_s *options,
+        cif_writer_tp **writer
+        ));
+
+/**
+ * @brief Starts a new data block, closing the current one (and any open save frames in it), if any.
+ *
+ * @param[in,out] writer a handle on the writer to which the block is to be written
+ *
+ * @param[in] code the block code of the new block, as a NUL-terminated Unicode string; must not be NULL
+ *
+ * @return Returns @c CIF_OK on success, @c CIF_INVALID_BLOCKCODE if the code is not valid, or an error code on failure
+ */
+CIF_INTFUNC_DECL(cif_writer_begin_block, (
+        cif_writer_tp *writer,
+        const UChar *code
+        ));
+
+/**
+ * @brief Starts a new save frame within the current data block or save frame.
+ *
+ * @param[in,out] writer a handle on the writer to which the frame is to be written
+ *
+ * @param[in] code the frame code of the new frame, as a NUL-terminated Unicode string; must not be NULL
+ *
+ * @return Returns @c CIF_OK on success, @c CIF_INVALID_FRAMECODE if the code is not valid, @c CIF_MISUSE if no data
+ *         block has been started, or an error code on failure
+ */
+CIF_INTFUNC_DECL(cif_writer_begin_frame, (
+        cif_writer_tp *writer,
+        const UChar *code
+        ));
+
+/**
+ * @brief Closes the innermost open save frame, so that subsequent elements belong to its parent.
+ *
+ * @param[in,out] writer a handle on the writer to which the frame is being written
+ *
+ * @return Returns @c CIF_OK on success, @c CIF_MISUSE if there is no open save frame, or an error code on failure
+ */
+CIF_INTFUNC_DECL(cif_writer_end_frame, (
+        cif_writer_tp *writer
+        ));
+
+/**
+ * @brief Writes a data item outside any loop, in the current data block or save frame.
+ *
+ * @param[in,out] writer a handle on the writer to which the item is to be written
+ *
+ * @param[in] name the data name of the item, as a NUL-terminated Unicode string; must not be NULL
+ *
+ * @param[in] value the value of the item; must not be NULL
+ *
+ * @return Returns @c CIF_OK on success, @c CIF_INVALID_ITEMNAME if the name is not valid, @c CIF_MISUSE if no data
+ *         block has been started, or an error code on failure
+ */
+CIF_INTFUNC_DECL(cif_writer_item, (
+        cif_writer_tp *writer,
+        const UChar *name,
+        cif_value_tp *value
+        ));
+
+/**
+ * @brief Starts a loop in the current data block or save frame, writing its header.
+ *
+ * @param[in,out] writer a handle on the writer to which the loop is to be written
+ *
+ * @param[in] names a NULL-terminated array of the data names of the loop's items, in the order in which their values
+ *         will be presented to @c cif_writer_packet(); must not be NULL
+ *
+ * @return Returns @c CIF_OK on success, @c CIF_NULL_LOOP if there are no names, @c CIF_INVALID_ITEMNAME if any name
+ *         is not valid, @c CIF_MISUSE if no data block has been started, or an error code on failure
+ */
+CIF_INTFUNC_DECL(cif_writer_begin_loop, (
+        cif_writer_tp *writer,
+        const UChar *names[]
+        ));
+
+/**
+ * @brief Writes one packet of the current loop.
+ *
+ * @param[in,out] writer a handle on the writer to which the packet is to be written
+ *
+ * @param[in] values an array of the values of the packet, one for each of the loop's data names, in the same order;
+ *         must not be NULL, and neither may any of the elements
+ *
+ * @return Returns @c CIF_OK on success, @c CIF_MISUSE if the last element written was not a loop header or packet, or
+ *         an error code on failure
+ */
+CIF_INTFUNC_DECL(cif_writer_packet, (
+        cif_writer_tp *writer,
+        cif_value_tp *values[]
+        ));
+
+/**
+ * @brief Finishes the output of the specified writer and closes it, releasing all resources associated with it.
+ *
+ * Any open loop, save frames, and data block are closed, and all remaining output is passed to the sink, even if the
+ * writer is in an error state.
+ *
+ * @param[in,out] writer a handle on the writer to close
+ *
+ * @return Returns @c CIF_OK if all the output was written successfully, the writer's error code if it is in an error
+ *         state, or else an error code (typically @c CIF_ERROR ) on failure
+ */
+CIF_INTFUNC_DECL(cif_writer_close, (
+        cif_writer_tp *writer
+        ));
+
+/**
+ * @brief Converts the CIF text in the specified stream directly to formatted CIF output, without storing it.
+ *
+ * The input is read as by a reader opened via @c cif_reader_open(), and each block, frame, item, and loop it reports
+ * is passed on to an incremental writer as by @c cif_writer_open(), so the result is the same as that of parsing the
+ * input into a managed CIF and formatting it via @c cif_write_to_sink(), except that data appear in their input
+ * order instead of in the order in which @c cif_write() traverses a managed CIF.  Only a bounded amount of the input
+ * and output is held in memory at any time (apart from individual values), and no managed CIF is involved, so this is
+ * the most economical way to convert a CIF of any size between CIF versions, or to normalize its presentation.
+ *
+ * Because nothing is stored, semantic errors such as duplicate block codes or data names are not detected, and they
+ * are reproduced in the output.  Any output formatted before an error is detected is nevertheless passed to the sink.
+ *
+ * @param[in,out] stream a @c FILE @c * from which to read the raw CIF data; must be a non-NULL pointer to a readable
+ *         stream, open in @b BINARY mode on any system where that makes a difference
+ *
+ * @param[in] parse_options a pointer to a @c struct @c cif_parse_opts_s object describing options to use while
+ *         reading, or @c NULL to use default values for all options.  Options are applied as by @c cif_reader_open().
+ *
+ * @param[in] sink the function to which to pass the formatted output, in one or more pieces; must not be NULL
+ *
+ * @param[in] sink_context an arbitrary pointer to pass to the sink with each piece of output; may be NULL
+ *
+ * @param[in] write_options a pointer to a @c struct @c cif_write_opts_s object describing options to use for
+ *         writing, or @c NULL to use default values for all options.  Options are applied as by @c cif_writer_open().
+ *
+ * @return Returns @c CIF_OK on success, @c CIF_ARGUMENT_ERROR if @p stream or @p sink is NULL, or else an error code
+ *         as for @c cif_reader_next() or for the incremental writer functions
+ */
+CIF_INTFUNC_DECL(cif_transcode, (
+        FILE *stream,
+        struct cif_parse_opts_s *parse_options,
+        cif_write_sink_tp sink,
+        void *sink_context,
+        struct cif_write_opts_s *write_options
+        ));
+
 /**
  * @brief Allocates a write options structure and initializes it with default values.
  *
@@ -1415,6 +2173,31 @@ CIF_INTFUNC_DECL(cif_get_block, (
         cif_block_tp **block
         ));
 
+/**
+ * @brief Looks up and optionally returns the data block bearing the specified block code, given in UTF-8 form.
+ *
+ * This function behaves identically to @c cif_get_block(), except that the block code is provided as a UTF-8 string.
+ * The code is normalized and bound to the lookup in UTF-8 form, so callers whose native strings are UTF-8 need not
+ * convert them to UTF-16.  Block codes consisting entirely of ASCII characters are normalized without any conversion.
+ *
+ * @param[in] cif a handle on the managed CIF object in which to look up the specified block code; must be non-NULL
+ *         and valid.
+ *
+ * @param[in] code the block code to look up, as a NUL-terminated UTF-8 string.
+ *
+ * @param[in,out] block if not NULL on input, and if a block matching the specified code is found, then a handle on it
+ *         is written where this argument points.  The caller assumes responsibility for releasing this handle.
+ *
+ * @return @c CIF_OK on a successful lookup (even if @c block is NULL), @c CIF_NOSUCH_BLOCK if there is no data block
+ *         bearing the given code in the given CIF (including if the code is not well-formed UTF-8), or an error code
+ *         (typically @c CIF_ERROR ) if an error occurs.
+ */
+CIF_INTFUNC_DECL(cif_get_block_utf8, (
+        cif_tp *cif,
+        const char *code,
+        cif_block_tp **block
+        ));
+
 /**
  * @brief Provides a null-terminated array of data block handles, one for each block in the specified CIF.
  *
@@ -1806,6 +2589,84 @@ CIF_INTFUNC_DECL(cif_container_get_value, (
         cif_value_tp **val
         ));
 
+/**
+ * @brief Looks up an item by name, given in UTF-8 form, in a data block or save frame, and optionally returns (one of)
+ *         its value(s)
+ *
+ * This function behaves identically to @c cif_container_get_value(), except that the item name is provided as a UTF-8
+ * string.  The name is validated, normalized, and bound to the lookup in UTF-8 form; names consisting entirely of
+ * ASCII characters are handled without any conversion to UTF-16.  Names that are not well-formed UTF-8 are handled as
+ * absent.
+ *
+ * @param[in] container a handle on the data block or save frame in which to look up the item; must be non-NULL and
+ *         valid
+ *
+ * @param[in] item_name the name of the item to look up, as a NUL-terminated UTF-8 string; must not be NULL
+ *
+ * @param[in,out] val if non-NULL then the location where a pointer to (one of) the item's value(s) should be written,
+ *         as for @c cif_container_get_value()
+ *
+ * @return Returns a result code as described for @c cif_container_get_value()
+ */
+CIF_INTFUNC_DECL(cif_container_get_value_utf8, (
+        cif_container_tp *container,
+        const char *item_name,
+        cif_value_tp **val
+        ));
+
+/**
+ * @brief Looks up several items by name in a data block or save frame, returning a value for each one present
+ *
+ * This function produces the same results as calling @c cif_container_get_value() for each name in turn, but it
+ * retrieves all the container's scalars with a single query, and falls back to individual lookups only for names
+ * that are not among them (such as looped items).  It is therefore much more efficient for reading many scalar items,
+ * such as a structure's cell parameters and refinement details.
+ *
+ * For each name, the corresponding element of @p values receives a pointer to a new value object holding (one of) the
+ * item's value(s), or NULL if the item is absent or its name invalid.  The caller assumes responsibility for freeing
+ * the values provided.
+ *
+ * @param[in] container a handle on the data block or save frame in which to look up the items; must be non-NULL and
+ *         valid
+ *
+ * @param[in] names a NULL-terminated array of the names of the items to look up, each a NUL-terminated Unicode
+ *         string; must not be NULL
+ *
+ * @param[in,out] values an array with at least as many elements as @p names has names, in which the values are
+ *         recorded; must not be NULL.  Any pointers initially in the array are overwritten without being freed.
+ *
+ * @return Returns @c CIF_OK if every item is present with a single value; otherwise @c CIF_NOSUCH_ITEM or
+ *         @c CIF_AMBIGUOUS_ITEM, as @c cif_container_get_value() would report for the first name for which it would
+ *         not return @c CIF_OK (the values of the other items are provided all the same); or an error code
+ *         (typically @c CIF_ERROR ) if an error occurs, in which case no values are provided.
+ */
+CIF_INTFUNC_DECL(cif_container_get_values, (
+        cif_container_tp *container,
+        const UChar *names[],
+        cif_value_tp *values[]
+        ));
+
+/**
+ * @brief Retrieves the names and values of all the scalar items of a data block or save frame, as a packet
+ *
+ * All of the scalars are read with a single query.  The resulting packet is keyed by the items' original names, in
+ * the manner of the packets provided by a packet iterator over the container's scalar loop, and it is empty if the
+ * container has no scalars.  The caller assumes responsibility for freeing the packet.
+ *
+ * @param[in] container a handle on the data block or save frame whose scalars are requested; must be non-NULL and
+ *         valid
+ *
+ * @param[in,out] packet the location where a pointer to the new packet should be written; must not be NULL
+ *
+ * @return Returns @c CIF_OK on success; @c CIF_AMBIGUOUS_ITEM if the container's scalar loop has more than one
+ *         packet, in which case the packet provided holds one of the values of each item; or an error code
+ *         (typically @c CIF_ERROR ) on failure.
+ */
+CIF_INTFUNC_DECL(cif_container_get_all_scalars, (
+        cif_container_tp *container,
+        cif_packet_tp **packet
+        ));
+
 /**
  * @brief Sets the value of the specified item in the specified container, or adds it
  * as a scalar if it's not already present in the container.
@@ -1830,6 +2691,28 @@ CIF_INTFUNC_DECL(cif_container_set_value, (
         cif_value_tp *val
         ));
 
+/**
+ * @brief Sets the values of all the items in a packet in the specified container, adding as scalars those that are
+ *         not already present.
+ *
+ * The effect is the same as that of calling @c cif_container_set_value() for each item of the packet, but all the
+ * changes are made in a single transaction, so that they succeed or fail as a unit, and the items new to the
+ * container are inserted into its scalar loop together.  This is much faster than setting many scalars one at a time.
+ * The packet itself is not modified; its values are copied into the CIF.
+ *
+ * @param[in] container a handle on the container to modify; must be non-NULL and valid
+ *
+ * @param[in] packet a handle on a packet containing the items to set, under their original names; must not be NULL.
+ *         An empty packet is accepted, and causes no change.
+ *
+ * @return @c CIF_OK on success, or an error code (typically @c CIF_ERROR ) on failure, in which case the container
+ *         is unchanged
+ */
+CIF_INTFUNC_DECL(cif_container_set_values, (
+        cif_container_tp *container,
+        cif_packet_tp *packet
+        ));
+
 /**
  * @brief Removes the specified item and all its values from the specified container.
  *
@@ -1940,6 +2823,25 @@ CIF_INTFUNC_DECL(cif_loop_get_names, (
         UChar ***item_names
         ));
 
+/**
+ * @brief Retrieves the item names belonging to the specified loop, in UTF-8 form.
+ *
+ * The resulting name list takes the form of a NULL-terminated array of NUL-terminated UTF-8 strings, in the same
+ * order that @c cif_loop_get_names() provides them.  The caller assumes responsibility for freeing the individual
+ * names and the array containing them.
+ *
+ * @param[in] loop a handle on the loop whose item names are requested
+ *
+ * @param[in,out] item_names the location where a pointer to the resulting NULL-terminated item name array should be
+ *         written; must not be NULL
+ *
+ * @return Returns @c CIF_OK on success or an error code (typically @c CIF_ERROR ) on failure.
+ */
+CIF_INTFUNC_DECL(cif_loop_get_names_utf8, (
+        cif_loop_tp *loop,
+        char ***item_names
+        ));
+
 /**
  * @brief Adds the CIF data item identified by the specified name to the specified managed loop, with the given
  *         initial value in every existing loop packet.
@@ -2103,7 +3005,10 @@ CIF_INTFUNC_DECL(cif_pktitr_abort, (
  *
  * If @c packet is not NULL then the packet data are recorded where it points, either replacing the contents of a
  * packet provided that way by the caller (when @c *packet is not NULL) or providing a new packet to the caller.
- * "Replacing the contents" includes removing items that do not belong to the iterated loop.
+ * "Replacing the contents" includes removing items that do not belong to the iterated loop.  A caller-provided packet
+ * whose items are exactly those of the iterated loop is refilled in place, without allocating any new objects, so
+ * reusing one packet for a whole iteration is an efficient way to read a loop; @c cif_pktitr_next_borrowed_packet()
+ * is more efficient still, for callers that do not need to retain the packet.
  * A new packet provided to the caller in this way (when @p packet is not NULL and @p *packet is NULL on call) becomes
  * the responsibility of the caller; when no longer needed, its resources should be released via @c cif_packet_free().
  *
@@ -2124,6 +3029,38 @@ CIF_INTFUNC_DECL(cif_pktitr_next_packet, (
         cif_packet_tp **packet
         ));
 
+/**
+ * @brief Advances a packet iterator to the next packet, if any, and provides that packet as one belonging to the
+ *         iterator.
+ *
+ * This is an alternative to @c cif_pktitr_next_packet() for callers that only need to examine each packet briefly.
+ * The packet provided belongs to the iterator: the caller must not free it, and it and its values remain valid only
+ * until the next call to this function for the same iterator, or until the iterator is closed or aborted, whichever
+ * comes first.  The same packet object is ordinarily provided for every packet of the iteration, and the data of its
+ * values are held together in storage managed by the iterator and reused from packet to packet, so that reading a
+ * packet this way involves no memory allocation once the iteration is underway.
+ *
+ * The caller may modify the packet and its values, for example to pass to @c cif_pktitr_update_packet(), but any such
+ * changes are discarded by the next call to this function.  Values that must outlive the packet should be copied
+ * out of it via @c cif_value_clone(); clones are independent of the iterator.
+ *
+ * If no more packets are available from the iterator's loop then @c CIF_FINISHED is returned.
+ *
+ * @param[in,out] iterator a pointer to the packet iterator from which the next packet is requested
+ *
+ * @param[out] packet the location where a pointer to the iterator's packet should be recorded; must not be NULL.
+ *         The value initially at @p *packet is ignored.
+ *
+ * @return On success returns @c CIF_OK if the iterator successfully advanced, @c CIF_FINISHED if there were no
+ *         more packets available.  Returns an error code on failure, normally one of:
+ *         @li @c CIF_ARGUMENT_ERROR if @p packet is NULL
+ *         @li @c CIF_ERROR in most other cases
+ */
+CIF_INTFUNC_DECL(cif_pktitr_next_borrowed_packet, (
+        cif_pktitr_tp *iterator,
+        cif_packet_tp **packet
+        ));
+
 /**
  * @brief Updates the last packet iterated by the specified iterator with the values from the provided packet.
  *
@@ -2249,6 +3186,30 @@ CIF_INTFUNC_DECL(cif_packet_set_item, (
         cif_value_tp *value
         ));
 
+/**
+ * @brief Sets the value of the specified item in the specified packet, with the item name given in UTF-8 form.
+ *
+ * This function behaves identically to @c cif_packet_set_item(), except that the item name is provided as a UTF-8
+ * string.  Short names are converted without any dynamic memory allocation.
+ *
+ * @param[in,out] packet a pointer to the packet to modify
+ *
+ * @param[in] name the name of the item within the packet to modify, as a NUL-terminated UTF-8 string; must be
+ *         non-null and valid for a CIF data name
+ *
+ * @param[in] value the value object to copy into the packet, or @c NULL for an unknown-value value object to be added
+ *
+ * @return Returns @c CIF_OK on success, or else an error code characterizing the nature of the failure, normally one
+ *         of:
+ *         @li @c CIF_INVALID_ITEMNAME if @p name is not well-formed UTF-8 or not a valid CIF data name
+ *         @li @c CIF_ERROR in most other cases
+ */
+CIF_INTFUNC_DECL(cif_packet_set_item_utf8, (
+        cif_packet_tp *packet,
+        const char *name,
+        cif_value_tp *value
+        ));
+
 /**
  * @brief Determines whether a packet contains a value for a specified data name, and optionally provides that value.
  *
@@ -2272,6 +3233,28 @@ CIF_INTFUNC_DECL(cif_packet_get_item, (
         cif_value_tp **value
         ));
 
+/**
+ * @brief Determines whether a packet contains a value for a specified data name, given in UTF-8 form, and optionally
+ *         provides that value.
+ *
+ * This function behaves identically to @c cif_packet_get_item(), except that the data name is provided as a UTF-8
+ * string.  As with that function, the value provided belongs to the packet.
+ *
+ * @param[in] packet a pointer to the packet object from which to retrieve a value
+ *
+ * @param[in] name the data name requested from the packet, as a NUL-terminated UTF-8 string
+ *
+ * @param[in,out] value if not NULL, gives the location where a pointer to the requested value should be written.
+ *
+ * @return Returns @c CIF_OK if the packet contains an item having the specified data name, or @c CIF_NOSUCH_ITEM
+ *         otherwise (including if the name is not well-formed UTF-8).
+ */
+CIF_INTFUNC_DECL(cif_packet_get_item_utf8, (
+        cif_packet_tp *packet,
+        const char *name,
+        cif_value_tp **value
+        ));
+
 /**
  * @brief Removes the value, if any, associated with the specified name in the specified packet, optionally returning
  *         it to the caller.
@@ -2426,6 +3409,32 @@ CIF_INTFUNC_DECL(cif_value_clone, (
         cif_value_tp **clone
         ));
 
+/**
+ * @brief Converts the data of a CIF value object to immutable, reference-counted storage that clones of the value
+ *         share instead of copying.
+ *
+ * This is an optional optimization for programs that clone large values repeatedly, for example by recording the
+ * same value in many packets or in many list or table elements.  After this function succeeds, cloning the value,
+ * whether by @c cif_value_clone() or by any function that records a copy of a value, shares the text (and, for
+ * numbers, the digits) of the value and of every value within it, rather than copying them.  A list or table
+ * retrieved from a managed CIF shares its stored form, too, as long as none of its elements has been accessed.
+ * Values sharing storage in this way remain observably independent: modifying any one of them, or cleaning or freeing
+ * it, replaces or releases only its own reference to the shared storage.  Clones of shared values are themselves
+ * shared, as are elements subsequently accessed in a shared list or table.
+ *
+ * Reference counts are not synchronized, so values that share storage must not be cloned, modified, cleaned, or freed
+ * concurrently by different threads.
+ *
+ * @param[in,out] value a pointer to the value object whose data are to be shared; must not be NULL
+ *
+ * @return Returns @c CIF_OK on success, or an error code (typically @c CIF_MEMORY_ERROR ) on failure.  On failure,
+ *         the value is unchanged, except that some of the values within a list or table may already have been
+ *         converted.
+ */
+CIF_INTFUNC_DECL(cif_value_share, (
+        cif_value_tp *value
+        ));
+
 /**
  * @brief Reinitializes the provided value object to a default value of the specified kind.
  *
@@ -2799,6 +3808,25 @@ CIF_INTFUNC_DECL(cif_value_get_text, (
         UChar **text
         ));
 
+/**
+ * @brief Retrieves the value text, if any, of the specified value object in UTF-8 form.
+ *
+ * This function behaves identically to @c cif_value_get_text(), except that the text is provided as a newly-allocated,
+ * NUL-terminated UTF-8 string.  It is transcoded directly from the value's internal representation.  The text, if any,
+ * belongs to the caller.
+ *
+ * @param[in] value a pointer to the value object whose text is requested
+ *
+ * @param[in,out] text the location where a pointer to the UTF-8 value text (or NULL, as appropriate) should be
+ *         recorded; must not be NULL
+ *
+ * @return Returns @c CIF_OK on success, or an error code (typically @c CIF_ERROR or @c CIF_MEMORY_ERROR ) on failure
+ */
+CIF_INTFUNC_DECL(cif_value_get_text_utf8, (
+        cif_value_tp *value,
+        char **text
+        ));
+
 /**
  * @brief Determines the number of elements of a composite data value.
  *
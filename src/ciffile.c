@@ -29,13 +29,18 @@
 #include <stdio.h>
 #include <limits.h>
 #include <assert.h>
+#include <errno.h>
 
 #ifdef HAVE_UNISTD_H
 #include <unistd.h>
 #endif
 
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
 #include <unicode/ustring.h>
-#include <unicode/ustdio.h>
+#include <unicode/uchar.h>
 #include <unicode/ucsdet.h>
 #include <unicode/ucnv.h>
 #include <unicode/ucnv_cb.h>
@@ -81,25 +86,225 @@ typedef struct {
     int last_error;
 } uchar_stream_t;
 
+/* A character source reading from a span of already-decoded characters */
+typedef struct {
+    const UChar *next;
+    const UChar *limit;
+} uchar_slice_t;
+
+/* A segment of decoded CIF text, starting at the beginning of a line; segments other than the first start with a
+ * data block header */
+typedef struct {
+    const UChar *start;
+    size_t line;
+} segment_t;
+
+#ifdef HAVE_PTHREADS
+/* The shared, read-only description of a parallel parse */
+typedef struct {
+    struct cif_parse_opts_s *options;
+    int cif_version;
+    int not_utf8;
+    const segment_t *segments;
+    size_t segment_count;
+    const UChar *text_limit;
+} parse_job_t;
+
+/* The per-worker state of a parallel parse */
+typedef struct {
+    const parse_job_t *job;
+    size_t first_segment;
+    size_t end_segment;
+    /* the first segment that could not be parsed, or end_segment if all were parsed successfully */
+    size_t failed_segment;
+    /* the per-worker store, or NULL if none is needed or it could not be created */
+    cif_tp *store;
+    /* the largest container ID in the store belonging to a successfully parsed segment */
+    sqlite3_int64 id_limit;
+    char store_uri[96];
+    int keep_store;
+} parse_worker_t;
+#endif
+
+/* The character source of a CIF reader, together with its byte buffer */
+typedef struct {
+    uchar_stream_t ustream;
+    unsigned char buffer[4096];
+} reader_source_t;
+
+/* The size of the byte buffer through which the CIF writer's output passes, and the initial size of an in-memory one */
+#define WRITE_BUFFER_SIZE 65536
+
+/*
+ * A byte buffer through which the CIF writer's output passes on its way to its destination.  UTF-8 output is encoded
+ * directly into the buffer; other output goes through an ICU converter.  If the buffer has a sink then its contents are
+ * passed to the sink in one call each time it fills; otherwise the buffer itself is the destination, and it grows as
+ * needed.
+ */
+typedef struct {
+    /* the destination of the buffered bytes, or NULL if the output is to be accumulated in memory */
+    cif_write_sink_tp sink;
+    void *sink_context;
+    /* the converter for non-UTF-8 output, or NULL for UTF-8 */
+    UConverter *converter;
+    char *data;
+    size_t used;
+    size_t capacity;
+} write_buffer_t;
+
 typedef struct {
-    UFILE *file;
+    write_buffer_t *buffer;
     int write_item_names;
     int separate_values;
     int last_column;
     int depth;
     int version;
+    /* the write options bearing the block, frame, and data name selections, or NULL if all parts are written */
+    struct cif_write_opts_s *selection;
+    int align_loops;
+    /* the starting columns of the first aligned_columns columns of the current loop, if it is aligned */
+    size_t *column_starts;
+    size_t column_capacity;
+    size_t aligned_columns;
+    /* the index of the loop column to which the next value of the current packet belongs */
+    size_t packet_column;
+    /* nonzero if the output is CIF-JSON */
+    int json;
+    /* the number of JSON objects open around the current position, which determines indentation */
+    int json_level;
+    /* whether the next member of the innermost open JSON object must be preceded by a separator */
+    int json_separate;
+    /* whether the "Frames" object of the current data block or save frame is open */
+    int json_frames;
+    /* one of the JSON_COLUMN_* codes describing the loop column being written */
+    int json_column;
 } write_context_t;
 
-/* Unicode strings important for determining possible output formats for char values */
-static const char header_type[2][10] = { "\ndata_%S\n", "\nsave_%S\n" };
+/* The states of the CIF-JSON writer with respect to the column of a loop */
+#define JSON_NO_COLUMN      0
+#define JSON_COLUMN_SKIPPED 1
+#define JSON_COLUMN_OPEN    2
+
+/* The kinds of section a CIF writer can be in the middle of, within a data block or save frame */
+#define WRITER_NO_SECTION  0
+#define WRITER_IN_SCALARS  1
+#define WRITER_IN_LOOP     2
+
+/*
+ * The state of an incremental CIF writer.  The write context comes first, so that a pointer to the writer also serves
+ * as a context pointer for the CIF-writing functions.
+ */
+struct cif_writer_s {
+    write_context_t context;
+    write_buffer_t buffer;
+    /* one of the WRITER_* section codes */
+    int section;
+    /* the number of data names of the current loop, if any */
+    size_t loop_width;
+    /* the index of the loop column to which the next loop value belongs */
+    size_t next_column;
+    /* CIF_OK, or the code of the error that put the writer into an error state */
+    int result;
+};
+
+/* The state of a transcoding between a CIF reader and a CIF writer */
+typedef struct {
+    cif_writer_tp *writer;
+    /* the NULL-terminated data names of the current loop */
+    UChar **names;
+    size_t name_count;
+    size_t name_capacity;
+    /* CIF_TRUE if the header of the current loop has yet to be written */
+    int header_pending;
+    /* a NUL-terminated copy of the text of the current event */
+    UChar *text;
+    size_t text_capacity;
+} transcode_state_t;
+
+/* The size of the byte buffer through which CIF-JSON input is read */
+#define JSON_BUFFER_SIZE 65536
+
+/* The state of a CIF-JSON import */
+typedef struct {
+    FILE *stream;
+    unsigned char *buffer;
+    size_t next;
+    size_t limit;
+    /* nonzero if reading the stream failed */
+    int read_error;
+    /* the UTF-8 bytes of the string or number being read */
+    char *text;
+    size_t text_length;
+    size_t text_capacity;
+    /* the values of the data item being read */
+    cif_value_tp **values;
+    size_t value_count;
+    size_t value_capacity;
+} json_reader_t;
+
+/* The loop of a container to which the next looped item read from CIF-JSON may belong */
+typedef struct {
+    /* the loop, or NULL if there is none */
+    cif_loop_tp *loop;
+    /* the number of packets of the loop */
+    size_t packet_count;
+    /* the data name of the first item of the loop */
+    UChar *first_name;
+} json_loop_t;
+
+/* Evaluates to the next byte of CIF-JSON input, as an unsigned char, without consuming it, or to EOF at the end */
+#define JSON_PEEK(r) (((r)->next < (r)->limit) ? (int) (r)->buffer[(r)->next] : json_fill(r))
+
+#ifdef HAVE_PTHREADS
+/* The state shared among the workers of a parallel write */
+typedef struct {
+    pthread_mutex_t lock;
+    /* the number of loops in the CIF being written */
+    size_t loop_total;
+    /* the number of loops yet reached by any worker */
+    size_t loop_count;
+    /* for each loop yet reached, in walk order, the index of the worker that formats it */
+    size_t *loop_owners;
+    /* the index of the first loop in which any worker has failed, or loop_total if none has */
+    size_t failed_loop;
+} write_job_t;
+
+/*
+ * The per-worker state of a parallel write.  The write context comes first, so that the context pointer the CIF walker
+ * passes to the worker's handler functions is also a pointer to the worker.
+ */
+typedef struct {
+    write_context_t context;
+    write_buffer_t buffer;
+    cif_handler_tp handler;
+    write_job_t *job;
+    size_t index;
+    /* the CIF this worker reads: the original for the first worker, and a private copy for each of the others */
+    cif_tp *cif;
+    /* for each loop reached by this worker, the start and end offsets of the output for it in this worker's buffer */
+    size_t *loop_spans;
+    size_t loops_reached;
+    /* the index of the loop in which this worker's walk failed, or loops_reached if it did not fail within a loop */
+    size_t failed_loop;
+    int in_loop;
+    int result;
+} write_worker_t;
+#endif
+
+/* The leading parts of data block and save frame headers */
+#define HEADER_TYPE_LENGTH 6
+static const char header_type[2][HEADER_TYPE_LENGTH + 1] = { "\ndata_", "\nsave_" };
 
 /* the true data type of the CIF walker context pointers used by the CIF-writing functions */
 #define CONTEXT_S write_context_t
 #define CONTEXT_T CONTEXT_S *
-#define CONTEXT_INITIALIZE(c, f) do { \
-    c.file = f; c.write_item_names = CIF_FALSE; c.separate_values = 1; c.last_column = 0; c.depth = 0; c.version = 0; \
+#define CONTEXT_INITIALIZE(c, b) do { \
+    c.buffer = b; c.write_item_names = CIF_FALSE; c.separate_values = 1; c.last_column = 0; c.depth = 0; \
+    c.version = 0; c.selection = NULL; c.align_loops = CIF_FALSE; c.column_starts = NULL; c.column_capacity = 0; \
+    c.aligned_columns = 0; c.packet_column = 0; c.json = CIF_FALSE; c.json_level = 0; c.json_separate = CIF_FALSE; \
+    c.json_frames = CIF_FALSE; c.json_column = JSON_NO_COLUMN; \
 } while (CIF_FALSE)
-#define CONTEXT_UFILE(c) (((CONTEXT_T)(c))->file)
+#define CONTEXT_BUFFER(c) (((CONTEXT_T)(c))->buffer)
 #define SET_WRITE_ITEM_NAMES(c,v) do { ((CONTEXT_T)(c))->write_item_names = (v); } while (CIF_FALSE)
 #define IS_WRITE_ITEM_NAMES(c) (((CONTEXT_T)(c))->write_item_names)
 #define SET_SEPARATE_VALUES(c,v) do { ((CONTEXT_T)(c))->separate_values = (v); } while (CIF_FALSE)
@@ -110,6 +315,10 @@ static const char header_type[2][10] = { "\ndata_%S\n", "\nsave_%S\n" };
 #define CONTEXT_DEPTH(c) (((CONTEXT_T)(c))->depth)
 #define CONTEXT_INC_DEPTH(c, inc) do { ((CONTEXT_T)(c))->depth += (inc); } while (CIF_FALSE)
 #define IS_CIF1(c) (((CONTEXT_T)(c))->version == 1)
+#define CONTEXT_SELECTION(c) (((CONTEXT_T)(c))->selection)
+#define IS_ALIGN_LOOPS(c) (((CONTEXT_T)(c))->align_loops)
+#define SELECTS_NAMES(c) ((CONTEXT_SELECTION(c) != NULL) \
+        && ((CONTEXT_SELECTION(c)->include_names != NULL) || (CONTEXT_SELECTION(c)->exclude_names != NULL)))
 
 /*
  * A value-returning macro that ensures the current output position is preceded by whitespace, outputting appropriate
@@ -135,10 +344,78 @@ static const char header_type[2][10] = { "\ndata_%S\n", "\nsave_%S\n" };
         && ((u1) < MIN_TRAIL_SURROGATE) \
 )
 
+/*
+ * Chooses the character encoding in which to read the specified stream, and provisionally the CIF version, based on
+ * the parse options and on the initial bytes of the stream.  Unless the options force the default encoding, up to
+ * buffer_size initial bytes are read into the provided buffer, and their number is recorded where countp points.
+ * Returns CIF_FINISHED if the stream turns out to be empty.
+ */
+static int sniff_encoding(FILE *stream, struct cif_parse_opts_s *options, unsigned char *buffer, size_t buffer_size,
+        size_t *countp, const char **encoding_namep, int *cif_versionp);
+
+/*
+ * Prepares a character stream that decodes the specified byte stream via the named encoding, starting with the count
+ * bytes already read into the provided buffer.  Decoding errors are reported via the specified scanner's error
+ * callback.  On success, the caller is responsible for closing the stream's converter.
+ */
+static int open_uchar_stream(uchar_stream_t *ustream, FILE *stream, unsigned char *buffer, size_t buffer_size,
+        size_t count, const char *encoding_name, struct scanner_s *scanner, int *not_utf8);
+
 static void ustream_to_unicode_callback(const void *context, UConverterToUnicodeArgs *args, const char *codeUnits,
         int32_t length, UConverterCallbackReason reason, UErrorCode *error_code);
 static ssize_t ustream_read_chars(void *char_source, UChar *dest, ssize_t count, int *error_code);
 
+/*
+ * Initializes those properties of the specified scanner that derive from the caller's parse options, and sets its
+ * character source, starting line number, and initial CIF version
+ */
+static void init_scanner(struct scanner_s *scanner, struct cif_parse_opts_s *options, int cif_version,
+        void *char_source, read_chars_f read_func, size_t first_line);
+
+#ifdef HAVE_PTHREADS
+static ssize_t uslice_read_chars(void *char_source, UChar *dest, ssize_t count, int *error_code);
+
+/*
+ * Determines the CIF version with which decoded CIF text will be parsed, in the same manner that the parser does
+ * from the specified initial version assertion / evaluation and the CIF magic code, if any, at the start of the text
+ */
+static int resolve_cif_version(const UChar *text, size_t length, int cif_version, const char *extra_ws,
+        const char *extra_eol);
+
+/*
+ * Splits decoded CIF text into segments at data block headers that appear at the beginnings of lines, outside any
+ * text field or (in CIF 2) triple-quoted string.  The first segment always starts at the beginning of the text.  The
+ * split need not be exact: a boundary mistakenly placed inside a multi-line value produces segments that fail to
+ * parse on their own, and those are re-parsed serially.  The caller is responsible for freeing the segment array.
+ */
+static int find_segments(const UChar *text, size_t length, int cif_version, const char *extra_eol,
+        segment_t **segments, size_t *segment_count);
+
+/*
+ * Determines whether the specified CIF handler is NULL or has no handler functions
+ */
+static int is_empty_handler(const cif_handler_tp *handler);
+
+/*
+ * Parses the remainder of the specified stream, possibly splitting it at data block boundaries and parsing the
+ * pieces concurrently.  The results are the same as those of a serial parse via the provided scanner.
+ */
+static int parse_parallel(struct scanner_s *scanner, uchar_stream_t *ustream, struct cif_parse_opts_s *options,
+        int cif_version, int not_utf8, cif_tp *cif);
+
+/*
+ * Parses the segments assigned to one worker of a parallel parse into that worker's store, stopping at the first
+ * segment in which any error is detected.  Suitable for use as a thread start function.
+ */
+static void *parse_segments(void *worker);
+
+/*
+ * Parses the decoded text starting at the specified segment and running to the end of the input, serially, directly
+ * into the target CIF, with the caller's options
+ */
+static int parse_serial_tail(const parse_job_t *job, size_t first_segment, int cif_version, cif_tp *cif);
+#endif
+
 /*
  * CIF handler functions used by write_cif()
  */
@@ -163,6 +440,17 @@ static int write_container_start(cif_container_tp *block, void *context);
  */
 static int write_container_end(cif_container_tp *block, void *context);
 
+/*
+ * Determines whether the data block or save frame bearing the specified code, at the current depth, is selected for
+ * output.  Returns CIF_TRAVERSE_CONTINUE if so, CIF_TRAVERSE_SKIP_CURRENT if not, or an error code.
+ */
+static int select_container(void *context, const UChar *code);
+
+/*
+ * Outputs a data block or save frame header bearing the specified code, according to the current depth
+ */
+static int write_header(void *context, const UChar *code);
+
 /*
  * Handles the beginning of a loop by outputting a loop header
  * (unless it is the scalar loop)
@@ -174,6 +462,28 @@ static int write_loop_start(cif_loop_tp *loop, void *context);
  */
 static int write_loop_end(cif_loop_tp *loop, void *context);
 
+/*
+ * Determines the widths of the columns of the specified loop, whose header has been written with the specified names,
+ * and records where each column that fits on a line starts, so that write_item() can align its values
+ */
+static int align_columns(void *context, cif_loop_tp *loop, const UChar * const *names);
+
+/*
+ * Removes from the specified NULL-terminated array of data names, in place, those not selected for output, freeing
+ * them
+ */
+static void select_names(void *context, UChar **names);
+
+/*
+ * Starts the output of a container's scalar items
+ */
+static int write_scalars_start(void *context);
+
+/*
+ * Outputs a loop header for the specified NULL-terminated array of data names
+ */
+static int write_loop_header(void *context, const UChar * const *names);
+
 /*
  * Handles the beginning of a loop packet by doing nothing
  */
@@ -260,18 +570,291 @@ static int32_t write_literal(void *context, const char *text, int length, int wr
  */
 static int32_t write_uliteral(void *context, const UChar *text, int length, int wrap);
 
+/*
+ * Outputs the specified number of spaces, which must fit on the current line.  Returns a truthy (nonzero) int on
+ * success, or a falsey (0) int on failure.
+ */
+static int write_padding(void *context, size_t count);
+
 /*
  * An internal function for outputting a newline; helps keep track of the current column to which output is being
  * directed.  Returns a truthy (nonzero) int on success, or a falsey (0) int on failure.
  */
 static int write_newline(void *context);
 
+/*
+ * Writes the specified number of bytes, which must be in the output encoding, to the specified context's output
+ * buffer, without regard to line length.  Does not update the current column.  Returns a CIF API result code.
+ */
+static int write_bytes(void *context, const char *bytes, size_t count);
+
+/*
+ * Encodes the specified number of UChar units of the specified Unicode string (or all of it, if 'length' is negative)
+ * into the specified context's output buffer, without regard to line length.  Does not update the current column.
+ * Returns a CIF API result code.
+ */
+static int write_uchars(void *context, const UChar *text, int32_t length);
+
+/*
+ * Makes room in the specified output buffer for more bytes.  If the buffer has a sink then its contents are passed to
+ * the sink, and the buffer is emptied; otherwise the buffer is enlarged to at least double its capacity, and at least
+ * enough to accommodate 'needed' more bytes.  Returns a CIF API result code.
+ */
+static int flush_write_buffer(write_buffer_t *buffer, size_t needed);
+
+/*
+ * Prepares the specified output buffer, whose sink (if any) and sink context must already be set, to receive output of
+ * the specified CIF version.  On success, the caller is responsible for releasing the buffer's data and converter.
+ * Returns a CIF API result code.
+ */
+static int open_write_buffer(write_buffer_t *buffer, int cif_version);
+
+/*
+ * CIF walker callbacks writing CIF-JSON.  The loop start callback writes all the columns of the loop as members of
+ * the enclosing container's object, then directs the walker to skip the loop's packets.
+ */
+static int write_json_cif_start(cif_tp *cif, void *context);
+static int write_json_cif_end(cif_tp *cif, void *context);
+static int write_json_container_start(cif_container_tp *container, void *context);
+static int write_json_container_end(cif_container_tp *container, void *context);
+static int write_json_loop_start(cif_loop_tp *loop, void *context);
+
+/*
+ * Receives the values of a loop, column by column, from cif_loop_walk_columns_internal(), and writes each selected
+ * column as a member whose value is an array of the column's values.  Returns a CIF API result code.
+ */
+static int write_json_column_value(void *context, const UChar *name, cif_value_tp *value);
+
+/*
+ * Starts a member of the innermost open JSON object, writing a separator if needed, a new line indented for the
+ * object's level, the specified key, and a colon.  Returns a CIF API result code.
+ */
+static int write_json_key(void *context, const UChar *key);
+
+/*
+ * Starts a member of the innermost open JSON object whose value is a nested object with the specified key, and makes
+ * the nested object the innermost one.  Returns a CIF API result code.
+ */
+static int open_json_object(void *context, const UChar *key);
+
+/* Ends the innermost open JSON object on a new line.  Returns a CIF API result code. */
+static int close_json_object(void *context);
+
+/*
+ * Writes the specified value in CIF-JSON form, recursively for lists and tables, all on the current line.  Returns a
+ * CIF API result code.
+ */
+static int write_json_value(void *context, cif_value_tp *value);
+
+/*
+ * Writes the specified NUL-terminated text as a JSON string, escaping quotation marks, backslashes, and control
+ * characters.  Returns a CIF API result code.
+ */
+static int write_json_string(void *context, const UChar *text);
+
+/* Refills the buffer of the specified CIF-JSON reader, and returns the next byte as JSON_PEEK() does. */
+static int json_fill(json_reader_t *reader);
+
+/* Consumes JSON whitespace, and returns the next byte after it as JSON_PEEK() does. */
+static int json_skip_space(json_reader_t *reader);
+
+/*
+ * Consumes any JSON whitespace and then the specified delimiter.  Returns CIF_OK, or CIF_MISSING_DELIM if the next
+ * byte is not the delimiter.
+ */
+static int json_expect(json_reader_t *reader, int delimiter);
+
+/*
+ * Consumes the separator following a member of a JSON object or an element of an array, either a comma or the
+ * specified closing delimiter, recording in 'more' whether it was a comma.  Returns a CIF API result code.
+ */
+static int json_next_member(json_reader_t *reader, int close, int *more);
+
+/*
+ * Reads the JSON string starting at the next byte, which must be a quotation mark, into a newly-allocated Unicode
+ * string, recording a pointer to it in 'text'.  Returns a CIF API result code.
+ */
+static int json_read_string(json_reader_t *reader, UChar **text);
+
+/*
+ * Reads the JSON number starting at the next byte into a newly-allocated Unicode string of its text, recording a
+ * pointer to it in 'text'.  Returns a CIF API result code.
+ */
+static int json_read_number(json_reader_t *reader, UChar **text);
+
+/* Consumes the specified JSON literal name.  Returns CIF_OK, or CIF_INVALID_CHAR if the input does not match. */
+static int json_read_literal(json_reader_t *reader, const char *literal);
+
+/* Appends the specified bytes to the reader's text buffer.  Returns a CIF API result code. */
+static int json_append(json_reader_t *reader, const char *bytes, size_t count);
+
+/*
+ * Reads the next JSON value into the specified value object, which is overwritten, in the manner documented for
+ * cif_parse_json().  Returns a CIF API result code.
+ */
+static int json_read_value(json_reader_t *reader, cif_value_tp *value);
+
+/* Reads and discards the next JSON value, whatever it is.  Returns a CIF API result code. */
+static int json_skip_value(json_reader_t *reader);
+
+/*
+ * Reads the members of the "CIF-JSON" object, creating a data block in the specified CIF for each.  Returns a CIF API
+ * result code.
+ */
+static int json_read_blocks(json_reader_t *reader, cif_tp *cif);
+
+/*
+ * Reads a JSON object describing the contents of a data block or save frame into the specified container.  Returns a
+ * CIF API result code.
+ */
+static int json_read_container(json_reader_t *reader, cif_container_tp *container);
+
+/*
+ * Reads the members of a "Frames" object, creating a save frame in the specified container for each.  Returns a CIF
+ * API result code.
+ */
+static int json_read_frames(json_reader_t *reader, cif_container_tp *container);
+
+/*
+ * Reads the array of values of a data item into the reader's value buffer, replacing any values already there.
+ * Returns a CIF API result code.
+ */
+static int json_read_item_values(json_reader_t *reader);
+
+/*
+ * Records the values in the reader's value buffer as the values of the specified looped item of the specified
+ * container, either in the specified loop or in a new one, per the rules documented for cif_parse_json().  Returns a
+ * CIF API result code.
+ */
+static int json_add_looped_item(json_reader_t *reader, cif_container_tp *container, json_loop_t *current,
+        const UChar *name);
+
+/* Releases the values in the reader's value buffer */
+static void json_clear_values(json_reader_t *reader);
+
+/* Determines whether the specified data names have the same category part, the part up to the first period */
+static int json_same_category(const UChar *name1, const UChar *name2);
+
+/*
+ * Passes the specified reader event on to the writer of the specified transcoding state.  Returns a CIF API result
+ * code.
+ */
+static int transcode_event(transcode_state_t *state, struct cif_event_s *event);
+
+/*
+ * Records a NUL-terminated copy of the specified text in the specified transcoding state's text buffer, or in a new
+ * string if 'copy' is not NULL.  Returns a CIF API result code.
+ */
+static int copy_event_text(transcode_state_t *state, const UChar *text, size_t length, UChar **copy);
+
+/*
+ * Starts a data block or save frame with the specified code, which is assumed valid, on behalf of the specified CIF
+ * writer, first ending the current block if 'is_block' is nonzero, or else only the current section.  Returns a CIF
+ * API result code.
+ */
+static int writer_begin_container(cif_writer_tp *writer, const UChar *code, int is_block);
+
+/*
+ * Ends the innermost save frame of the specified CIF writer, which is assumed to be in one.  Returns a CIF API result
+ * code.
+ */
+static int writer_end_frame(cif_writer_tp *writer);
+
+/*
+ * Writes a scalar data item, whose name is assumed valid, on behalf of the specified CIF writer.  Returns a CIF API
+ * result code.
+ */
+static int writer_item(cif_writer_tp *writer, const UChar *name, cif_value_tp *value);
+
+/*
+ * Starts a loop with the specified NULL-terminated, non-empty array of data names, which are assumed valid, on behalf
+ * of the specified CIF writer.  Returns a CIF API result code.
+ */
+static int writer_begin_loop(cif_writer_tp *writer, const UChar * const *names);
+
+/*
+ * Writes the next value of the current loop of the specified CIF writer, ending the packet after the value of its last
+ * column.  Returns a CIF API result code.
+ */
+static int writer_loop_value(cif_writer_tp *writer, cif_value_tp *value);
+
+/*
+ * Ends whatever loop or run of scalar items the specified writer is in the middle of, if any.  Returns a CIF API
+ * result code.
+ */
+static int end_writer_section(cif_writer_tp *writer);
+
+/*
+ * Ends the writer's current section, and closes its open save frames, and also its open data block if 'end_block' is
+ * nonzero.  Returns a CIF API result code.
+ */
+static int end_writer_containers(cif_writer_tp *writer, int end_block);
+
+/*
+ * Formats the specified CIF into the specified output buffer, which must have its sink (if any) and sink context set.
+ * On success, if the buffer has no sink then its data belong to the caller; in all other cases they are released
+ * before this function returns.  Returns a CIF API result code.
+ */
+static int write_cif_to_buffer(write_buffer_t *buffer, struct cif_write_opts_s *options, cif_tp *cif);
+
+/*
+ * A write sink that writes to the stdio stream given by its context
+ */
+static int write_to_stream(void *context, const char *bytes, size_t count);
+
+#ifdef HAVE_UNISTD_H
+/*
+ * A write sink that writes to the file descriptor pointed to by its context
+ */
+static int write_to_fd(void *context, const char *bytes, size_t count);
+#endif
+
+/*
+ * Encodes Unicode text as UTF-8 into the specified output buffer, flushing it as necessary.  Unpaired surrogates are
+ * encoded as U+FFFD.  Returns a CIF API result code.
+ */
+static int encode_utf8(write_buffer_t *buffer, const UChar *text, const UChar *limit);
+
+#ifdef HAVE_PTHREADS
+/*
+ * Formats the specified CIF via the specified handler, which must be that of a serial write, with the help of up to
+ * worker_count - 1 additional threads.  The output is passed to the specified context's buffer in document order, and
+ * is the same as a serial walk would produce.  Returns a CIF API result code.
+ */
+static int write_parallel(void *context, cif_tp *cif, cif_handler_tp *handler, size_t worker_count);
+
+/*
+ * Walks the CIF of one worker of a parallel write, formatting into that worker's buffer each loop that no other worker
+ * has reached first, and recording where in the buffer the output for each loop lies.  Suitable for use as a thread
+ * start function.
+ */
+static void *write_loops(void *worker);
+
+/*
+ * Handles the beginning of a loop in a worker of a parallel write by claiming it for the worker if no other worker
+ * has reached it first, and writing a loop header if it is claimed; other loops are skipped
+ */
+static int write_claimed_loop_start(cif_loop_tp *loop, void *context);
+
+/*
+ * Handles the end of a loop claimed by a worker of a parallel write by outputting a newline
+ */
+static int write_claimed_loop_end(cif_loop_tp *loop, void *context);
+
+/*
+ * Handles the beginning of a packet in a worker of a parallel write by ending the walk if another worker has already
+ * failed in an earlier loop
+ */
+static int write_claimed_packet_start(cif_packet_tp *packet, void *context);
+#endif
+
 /* A CIF handler that handles nothing */
 static cif_handler_tp DEFAULT_CIF_HANDLER = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
 
 /* The CIF parsing options used when none are provided by the caller */
 static struct cif_parse_opts_s DEFAULT_OPTIONS =
-        { 0, NULL, 0, 0, 0, 1, NULL, NULL, &DEFAULT_CIF_HANDLER, NULL, NULL, NULL, cif_parse_error_die, NULL };
+        { 0, NULL, 0, 0, 0, 1, NULL, NULL, &DEFAULT_CIF_HANDLER, NULL, NULL, NULL, cif_parse_error_die, NULL, 0, NULL,
+                NULL, NULL };
 
 /* The length of the basic magic code identifying many CIFs (including all well-formed CIF 2.0 CIFs): "#\#CIF_" */
 #define MAGIC_LENGTH 7
@@ -311,6 +894,9 @@ int cif_parse_options_create(struct cif_parse_opts_s **opts) {
         opts_temp->dataname_callback = NULL;
         opts_temp->error_callback = NULL;
         opts_temp->user_data = NULL;
+        opts_temp->item_token_callback = NULL;
+        opts_temp->include_names = NULL;
+        opts_temp->exclude_names = NULL;
         /* members having integral types are pre-initialized to zero because calloc() clears the memory it allocates */
         opts_temp->max_frame_depth = 1;
 
@@ -326,7 +912,10 @@ int cif_write_options_create(struct cif_write_opts_s **opts) {
         return CIF_MEMORY_ERROR;
     } else {
         /* explicitly initialize all pointer members */
-        /* no pointer members in this version */
+        opts_temp->block_codes = NULL;
+        opts_temp->frame_codes = NULL;
+        opts_temp->include_names = NULL;
+        opts_temp->exclude_names = NULL;
 
         /* members having integral types are pre-initialized to zero because calloc() clears the memory it allocates */
 
@@ -363,8 +952,8 @@ int cif_parse(FILE *stream, struct cif_parse_opts_s *options, cif_tp **cifp) {
     cif_tp *cif;
     const char *encoding_name;
     uchar_stream_t ustream;
-    UErrorCode error_code = U_ZERO_ERROR;
     int cif_version;
+    int not_utf8;
     struct scanner_s scanner;
     int result;
 
@@ -380,44 +969,1673 @@ int cif_parse(FILE *stream, struct cif_parse_opts_s *options, cif_tp **cifp) {
         return result;
     }
 
-    if (options->prefer_cif2 > 19) {
-        cif_version = 2;
-    } else if (options->prefer_cif2 < 0) {
-        cif_version = 1;
-    } else {
-        cif_version = 0;
+    if ((result = sniff_encoding(stream, options, buffer, BUFFER_SIZE, &count, &encoding_name, &cif_version))
+            == CIF_FINISHED) {
+        /* simplest possible case: empty file --> empty CIF */
+        return CIF_OK;
+    } else if (result != CIF_OK) {
+        DEFAULT_FAIL(early);
     }
 
-    if (options->force_default_encoding != 0) {
-        encoding_name = options->default_encoding_name;
-        count = 0;
-        if ((options->prefer_cif2 < 20) && (options->prefer_cif2 > 0)) {
-            cif_version = -2;
+    /* encoding identified, or knowingly defaulted */
+
+    if (open_uchar_stream(&ustream, stream, buffer, BUFFER_SIZE, count, encoding_name, &scanner, &not_utf8)
+            == CIF_OK) {
+        /* set up those properties of the scanner that derive from caller input */
+        init_scanner(&scanner, options, cif_version, &ustream, ustream_read_chars, 1);
+
+#ifdef HAVE_PTHREADS
+        if ((options->max_parse_threads > 1)
+                && is_empty_handler(options->handler)
+                && (options->whitespace_callback == NULL)
+                && (options->keyword_callback == NULL)
+                && (options->dataname_callback == NULL)
+                && (options->item_token_callback == NULL)
+                && sqlite3_threadsafe()) {
+            result = parse_parallel(&scanner, &ustream, options, cif_version, not_utf8, cif);
+        } else
+#endif
+        {
+            /* perform the actual parse */
+            result = cif_parse_internal(&scanner, not_utf8, options->extra_ws_chars, options->extra_eol_chars, cif);
         }
-    } else {
-        /* attempt to guess the character encoding based on the first few bytes of the stream */
 
-        char *char_buffer = (char *) buffer;
+        ucnv_close(ustream.converter);
 
-        count = fread(char_buffer, 1, BUFFER_SIZE, stream);  /* returns a short count only if there isn't enough data */
-        if ((count < BUFFER_SIZE) && ferror(stream)) {
-            DEFAULT_FAIL(early);
-        } else if (count == 0) {
-            /* simplest possible case: empty file --> empty CIF */
-            return CIF_OK;
-        } else {
-            int32_t sig_length;
+        return result;
+    }
 
-            /* Look for a Unicode signature (a BOM encoded at the beginning of the stream) */
-            encoding_name = ucnv_detectUnicodeSignature(char_buffer, count, &sig_length, &error_code);
-            if (U_FAILURE(error_code)) {
-                /* TODO: verify that ICU's idea of failure is what we really want here */
-                DEFAULT_FAIL(early);
-            } else if (encoding_name != NULL) {
-                /* a Unicode encoding signature is successfully detected */
-                /* nothing to do here */
-            } else if (options->prefer_cif2 > 19) {
-                /*
+    FAILURE_HANDLER(early):
+    FAILURE_TERMINUS;
+}
+#undef BUFFER_SIZE
+
+int cif_parse_json(FILE *stream, cif_tp **cif) {
+    static const UChar cif_json_key[9] = { 'C', 'I', 'F', '-', 'J', 'S', 'O', 'N', 0 };
+    json_reader_t reader;
+    int have_blocks = CIF_FALSE;
+    int more;
+    int result;
+
+    if ((stream == NULL) || (cif == NULL)) {
+        return CIF_ARGUMENT_ERROR;
+    } else if ((*cif == NULL) && ((result = cif_create(cif)) != CIF_OK)) {
+        return result;
+    }
+
+    memset(&reader, 0, sizeof(reader));
+    reader.stream = stream;
+    reader.buffer = (unsigned char *) malloc(JSON_BUFFER_SIZE);
+    if (reader.buffer == NULL) {
+        return CIF_MEMORY_ERROR;
+    }
+
+    /* a UTF-8 byte-order mark is tolerated */
+    if (JSON_PEEK(&reader) == 0xef) {
+        static const unsigned char bom[3] = { 0xef, 0xbb, 0xbf };
+        size_t index;
+
+        for (index = 0; (index < 3) && (JSON_PEEK(&reader) == bom[index]); index += 1) {
+            reader.next += 1;
+        }
+        result = ((index == 3) ? CIF_OK : CIF_INVALID_CHAR);
+    } else {
+        result = CIF_OK;
+    }
+
+    if ((result == CIF_OK) && (json_skip_space(&reader) != EOF)) {
+        /* the document object */
+        result = json_expect(&reader, '{');
+        more = (json_skip_space(&reader) != '}');
+        while ((result == CIF_OK) && more) {
+            UChar *key;
+
+            if ((result = json_read_string(&reader, &key)) == CIF_OK) {
+                if ((result = json_expect(&reader, ':')) == CIF_OK) {
+                    if (u_strcmp(key, cif_json_key) == 0) {
+                        result = json_read_blocks(&reader, *cif);
+                        have_blocks = CIF_TRUE;
+                    } else {
+                        result = json_skip_value(&reader);
+                    }
+                }
+                free(key);
+            }
+            if (result == CIF_OK) {
+                result = json_next_member(&reader, '}', &more);
+            }
+        }
+        if (result == CIF_OK) {
+            reader.next += 1;  /* the closing brace */
+            if (!have_blocks) {
+                result = CIF_UNEXPECTED_VALUE;
+            } else if (json_skip_space(&reader) != EOF) {
+                result = CIF_INVALID_CHAR;
+            }
+        }
+    }
+
+    if (reader.read_error) {
+        result = CIF_ERROR;
+    }
+    json_clear_values(&reader);
+    free(reader.values);
+    free(reader.text);
+    free(reader.buffer);
+
+    return result;
+}
+
+int cif_reader_open(FILE *stream, struct cif_parse_opts_s *options, cif_reader_tp **reader) {
+    FAILURE_HANDLING;
+    cif_reader_tp *temp = (cif_reader_tp *) calloc(1, sizeof(cif_reader_tp));
+
+    if (options == NULL) {
+        options = &DEFAULT_OPTIONS;
+    }
+
+    if (temp != NULL) {
+        reader_source_t *source = (reader_source_t *) malloc(sizeof(reader_source_t));
+
+        if (source != NULL) {
+            size_t count;
+            const char *encoding_name;
+            int cif_version;
+            int not_utf8;
+
+            /* explicitly initialize the pointer members that cif_reader_clear_internal() examines */
+            temp->scanner.buffer = NULL;
+            temp->loop_names = NULL;
+            temp->item_name = NULL;
+            temp->value = NULL;
+            temp->source = NULL;
+
+            switch (sniff_encoding(stream, options, source->buffer, sizeof(source->buffer), &count, &encoding_name,
+                    &cif_version)) {
+                case CIF_FINISHED:
+                    /* an empty stream presents no events */
+                    temp->finished = CIF_TRUE;
+                    free(source);
+                    *reader = temp;
+                    return CIF_OK;
+                case CIF_OK:
+                    if (open_uchar_stream(&source->ustream, stream, source->buffer, sizeof(source->buffer), count,
+                            encoding_name, &temp->scanner, &not_utf8) == CIF_OK) {
+                        temp->source = source;
+                        init_scanner(&temp->scanner, options, cif_version, &source->ustream, ustream_read_chars, 1);
+                        SET_RESULT(cif_reader_start_internal(temp, not_utf8, options->extra_ws_chars,
+                                options->extra_eol_chars));
+                        if (FAILURE_VARIABLE == CIF_OK) {
+                            *reader = temp;
+                            return CIF_OK;
+                        }
+                        /* the reader's resources, including the source, are released via cif_reader_close() */
+                        if (cif_reader_close(temp) != CIF_OK) {
+                            /* ignore */
+                        }
+                        FAILURE_TERMINUS;
+                    }
+                    break;
+                /* default: do nothing */
+            }
+
+            free(source);
+        }
+
+        free(temp);
+    }
+
+    FAILURE_TERMINUS;
+}
+
+int cif_reader_close(cif_reader_tp *reader) {
+    reader_source_t *source = (reader_source_t *) reader->source;
+
+    cif_reader_clear_internal(reader);
+    if (source != NULL) {
+        ucnv_close(source->ustream.converter);
+        free(source);
+    }
+    free(reader);
+
+    return CIF_OK;
+}
+
+/*
+ * Formats the CIF data represented by the 'cif' handle to the specified
+ * output.
+ */
+int cif_write(FILE *stream, struct cif_write_opts_s *options, cif_tp *cif) {
+    write_buffer_t buffer;
+    int result;
+
+    buffer.sink = write_to_stream;
+    buffer.sink_context = stream;
+    result = write_cif_to_buffer(&buffer, options, cif);
+
+    /* flush whatever has been written successfully, even after an error */
+    if ((fflush(stream) != 0) && (result == CIF_OK)) {
+        result = CIF_ERROR;
+    }
+
+    return result;
+}
+
+int cif_write_to_sink(cif_write_sink_tp sink, void *sink_context, struct cif_write_opts_s *options, cif_tp *cif) {
+    write_buffer_t buffer;
+
+    if (sink == NULL) {
+        return CIF_ARGUMENT_ERROR;
+    }
+    buffer.sink = sink;
+    buffer.sink_context = sink_context;
+
+    return write_cif_to_buffer(&buffer, options, cif);
+}
+
+int cif_write_fd(int fd, struct cif_write_opts_s *options, cif_tp *cif) {
+#ifdef HAVE_UNISTD_H
+    write_buffer_t buffer;
+
+    buffer.sink = write_to_fd;
+    buffer.sink_context = &fd;
+
+    return write_cif_to_buffer(&buffer, options, cif);
+#else
+    return CIF_NOT_SUPPORTED;
+#endif
+}
+
+int cif_write_buffer(cif_tp *cif, struct cif_write_opts_s *options, char **bytes, size_t *length) {
+    write_buffer_t buffer;
+    int result;
+
+    if (bytes == NULL) {
+        return CIF_ARGUMENT_ERROR;
+    }
+    buffer.sink = NULL;
+    buffer.sink_context = NULL;
+    result = write_cif_to_buffer(&buffer, options, cif);
+    if (result == CIF_OK) {
+        /* terminate the output, without counting the terminator */
+        if ((buffer.used == buffer.capacity) && (flush_write_buffer(&buffer, 1) != CIF_OK)) {
+            free(buffer.data);
+            return CIF_MEMORY_ERROR;
+        }
+        buffer.data[buffer.used] = '\0';
+        *bytes = buffer.data;
+        if (length != NULL) {
+            *length = buffer.used;
+        }
+    }
+
+    return result;
+}
+
+int cif_writer_open(cif_write_sink_tp sink, void *sink_context, struct cif_write_opts_s *options,
+        cif_writer_tp **writer) {
+    cif_writer_tp *temp;
+    int result;
+
+    if ((sink == NULL) || (writer == NULL)) {
+        return CIF_ARGUMENT_ERROR;
+    }
+
+    temp = (cif_writer_tp *) malloc(sizeof(cif_writer_tp));
+    if (temp == NULL) {
+        return CIF_MEMORY_ERROR;
+    }
+
+    temp->buffer.sink = sink;
+    temp->buffer.sink_context = sink_context;
+    CONTEXT_INITIALIZE(temp->context, &(temp->buffer));
+    if (options && (options->cif_version == 1)) {
+        temp->context.version = 1;
+    }
+    temp->section = WRITER_NO_SECTION;
+    temp->loop_width = 0;
+    temp->next_column = 0;
+
+    result = open_write_buffer(&(temp->buffer), temp->context.version);
+    if (result == CIF_OK) {
+        temp->result = write_cif_start(NULL, temp);
+        *writer = temp;
+        return CIF_OK;
+    }
+
+    free(temp);
+    return result;
+}
+
+int cif_writer_begin_block(cif_writer_tp *writer, const UChar *code) {
+    int result;
+
+    if (writer->result != CIF_OK) {
+        return writer->result;
+    } else if (code == NULL) {
+        return CIF_ARGUMENT_ERROR;
+    }
+
+    result = cif_normalize_name(code, -1, NULL, CIF_INVALID_BLOCKCODE);
+    if (result == CIF_OK) {
+        result = writer_begin_container(writer, code, CIF_TRUE);
+        writer->result = result;
+    }
+
+    return result;
+}
+
+int cif_writer_begin_frame(cif_writer_tp *writer, const UChar *code) {
+    int result;
+
+    if (writer->result != CIF_OK) {
+        return writer->result;
+    } else if (code == NULL) {
+        return CIF_ARGUMENT_ERROR;
+    } else if (CONTEXT_DEPTH(writer) == 0) {
+        return CIF_MISUSE;
+    }
+
+    result = cif_normalize_name(code, -1, NULL, CIF_INVALID_FRAMECODE);
+    if (result == CIF_OK) {
+        result = writer_begin_container(writer, code, CIF_FALSE);
+        writer->result = result;
+    }
+
+    return result;
+}
+
+int cif_writer_end_frame(cif_writer_tp *writer) {
+    if (writer->result != CIF_OK) {
+        return writer->result;
+    } else if (CONTEXT_DEPTH(writer) < 2) {
+        return CIF_MISUSE;
+    }
+
+    writer->result = writer_end_frame(writer);
+
+    return writer->result;
+}
+
+int cif_writer_item(cif_writer_tp *writer, const UChar *name, cif_value_tp *value) {
+    int result;
+
+    if (writer->result != CIF_OK) {
+        return writer->result;
+    } else if ((name == NULL) || (value == NULL)) {
+        return CIF_ARGUMENT_ERROR;
+    } else if (CONTEXT_DEPTH(writer) == 0) {
+        return CIF_MISUSE;
+    }
+
+    result = cif_normalize_item_name(name, -1, NULL, CIF_INVALID_ITEMNAME);
+    if (result == CIF_OK) {
+        result = writer_item(writer, name, value);
+        writer->result = result;
+    }
+
+    return result;
+}
+
+int cif_writer_begin_loop(cif_writer_tp *writer, const UChar *names[]) {
+    const UChar **next_name;
+
+    if (writer->result != CIF_OK) {
+        return writer->result;
+    } else if (names == NULL) {
+        return CIF_ARGUMENT_ERROR;
+    } else if (CONTEXT_DEPTH(writer) == 0) {
+        return CIF_MISUSE;
+    } else if (*names == NULL) {
+        return CIF_NULL_LOOP;
+    }
+
+    for (next_name = names; *next_name != NULL; next_name += 1) {
+        int result = cif_normalize_item_name(*next_name, -1, NULL, CIF_INVALID_ITEMNAME);
+
+        if (result != CIF_OK) {
+            return result;
+        }
+    }
+
+    writer->result = writer_begin_loop(writer, names);
+
+    return writer->result;
+}
+
+int cif_writer_packet(cif_writer_tp *writer, cif_value_tp *values[]) {
+    size_t i;
+    int result = CIF_OK;
+
+    if (writer->result != CIF_OK) {
+        return writer->result;
+    } else if (values == NULL) {
+        return CIF_ARGUMENT_ERROR;
+    } else if (writer->section != WRITER_IN_LOOP) {
+        return CIF_MISUSE;
+    }
+    for (i = 0; i < writer->loop_width; i += 1) {
+        if (values[i] == NULL) {
+            return CIF_ARGUMENT_ERROR;
+        }
+    }
+
+    for (i = 0; (result == CIF_OK) && (i < writer->loop_width); i += 1) {
+        result = writer_loop_value(writer, values[i]);
+    }
+    writer->result = result;
+
+    return result;
+}
+
+int cif_writer_close(cif_writer_tp *writer) {
+    int result = writer->result;
+
+    if (result == CIF_OK) {
+        result = end_writer_containers(writer, CIF_TRUE);
+        if (result == CIF_OK) {
+            result = write_cif_end(NULL, writer);
+        }
+    }
+
+    /* pass on whatever has been written successfully, even after an error */
+    if ((flush_write_buffer(&(writer->buffer), 0) != CIF_OK) && (result == CIF_OK)) {
+        result = CIF_ERROR;
+    }
+    free(writer->buffer.data);
+    if (writer->buffer.converter != NULL) {
+        ucnv_close(writer->buffer.converter);
+    }
+    free(writer);
+
+    return result;
+}
+
+int cif_transcode(FILE *stream, struct cif_parse_opts_s *parse_options, cif_write_sink_tp sink, void *sink_context,
+        struct cif_write_opts_s *write_options) {
+    transcode_state_t state;
+    cif_reader_tp *reader;
+    int result;
+
+    if (stream == NULL) {
+        return CIF_ARGUMENT_ERROR;
+    }
+
+    result = cif_writer_open(sink, sink_context, write_options, &(state.writer));
+    if (result != CIF_OK) {
+        return result;
+    }
+    state.names = NULL;
+    state.name_count = 0;
+    state.name_capacity = 0;
+    state.header_pending = CIF_FALSE;
+    state.text = NULL;
+    state.text_capacity = 0;
+
+    result = cif_reader_open(stream, parse_options, &reader);
+    if (result == CIF_OK) {
+        struct cif_event_s event;
+        int close_result;
+
+        while ((result = cif_reader_next(reader, &event)) == CIF_OK) {
+            if ((result = transcode_event(&state, &event)) != CIF_OK) {
+                break;
+            }
+        }
+        if (result == CIF_FINISHED) {
+            result = CIF_OK;
+        }
+
+        close_result = cif_reader_close(reader);
+        if (result == CIF_OK) {
+            result = close_result;
+        }
+    }
+
+    /* closing the writer passes on the output formatted so far, even after an error */
+    if (result != CIF_OK) {
+        state.writer->result = result;
+    }
+    result = cif_writer_close(state.writer);
+
+    for (; state.name_count > 0; state.name_count -= 1) {
+        free(state.names[state.name_count - 1]);
+    }
+    free(state.names);
+    free(state.text);
+
+    return result;
+}
+
+static int transcode_event(transcode_state_t *state, struct cif_event_s *event) {
+    cif_writer_tp *writer = state->writer;
+    int result = CIF_OK;
+
+    switch (event->kind) {
+        case CIF_EVENT_BLOCK_START:
+        case CIF_EVENT_FRAME_START:
+            /* block codes are copied even when empty; the parser's recovery from a missing header makes such blocks */
+            result = copy_event_text(state, event->text, event->length, NULL);
+            if (result == CIF_OK) {
+                result = writer_begin_container(writer, state->text, (event->kind == CIF_EVENT_BLOCK_START));
+            }
+            break;
+        case CIF_EVENT_FRAME_END:
+            result = writer_end_frame(writer);
+            break;
+        case CIF_EVENT_LOOP_START:
+            for (; state->name_count > 0; state->name_count -= 1) {
+                free(state->names[state->name_count - 1]);
+            }
+            state->header_pending = CIF_TRUE;
+            break;
+        case CIF_EVENT_LOOP_NAME:
+            if ((state->name_count + 1) >= state->name_capacity) {
+                size_t new_capacity = (state->name_capacity == 0) ? 8 : (2 * state->name_capacity);
+                UChar **temp = (UChar **) realloc(state->names, new_capacity * sizeof(UChar *));
+
+                if (temp == NULL) {
+                    return CIF_MEMORY_ERROR;
+                }
+                state->names = temp;
+                state->name_capacity = new_capacity;
+            }
+            result = copy_event_text(state, event->text, event->length, state->names + state->name_count);
+            if (result == CIF_OK) {
+                state->name_count += 1;
+                state->names[state->name_count] = NULL;
+            }
+            break;
+        case CIF_EVENT_LOOP_VALUE:
+        case CIF_EVENT_LOOP_END:
+            if (state->header_pending && (state->name_count > 0)) {
+                /* the header is written when the loop body starts, or ends, so all the names are known */
+                result = writer_begin_loop(writer, (const UChar * const *) state->names);
+            }
+            state->header_pending = CIF_FALSE;
+            if ((result == CIF_OK) && (event->kind == CIF_EVENT_LOOP_VALUE)) {
+                result = writer_loop_value(writer, event->value);
+            }
+            break;
+        case CIF_EVENT_ITEM:
+            result = copy_event_text(state, event->text, event->length, NULL);
+            if (result == CIF_OK) {
+                result = writer_item(writer, state->text, event->value);
+            }
+            break;
+        default:
+            /* CIF_EVENT_BLOCK_END: blocks are closed when the next one starts, or when the writer is closed */
+            break;
+    }
+
+    return result;
+}
+
+static int copy_event_text(transcode_state_t *state, const UChar *text, size_t length, UChar **copy) {
+    UChar *dest;
+
+    if (copy != NULL) {
+        dest = (UChar *) malloc((length + 1) * sizeof(UChar));
+        if (dest == NULL) {
+            return CIF_MEMORY_ERROR;
+        }
+        *copy = dest;
+    } else {
+        if (length >= state->text_capacity) {
+            size_t new_capacity = (state->text_capacity == 0) ? 64 : state->text_capacity;
+            UChar *temp;
+
+            while (length >= new_capacity) {
+                new_capacity *= 2;
+            }
+            temp = (UChar *) realloc(state->text, new_capacity * sizeof(UChar));
+            if (temp == NULL) {
+                return CIF_MEMORY_ERROR;
+            }
+            state->text = temp;
+            state->text_capacity = new_capacity;
+        }
+        dest = state->text;
+    }
+
+    if (length > 0) {
+        memcpy(dest, text, length * sizeof(UChar));
+    }
+    dest[length] = 0;
+
+    return CIF_OK;
+}
+
+static int json_fill(json_reader_t *reader) {
+    if (reader->read_error) {
+        return EOF;
+    }
+    reader->next = 0;
+    reader->limit = fread(reader->buffer, 1, JSON_BUFFER_SIZE, reader->stream);
+    if (reader->limit == 0) {
+        reader->read_error = (ferror(reader->stream) != 0);
+        return EOF;
+    }
+
+    return (int) reader->buffer[0];
+}
+
+static int json_skip_space(json_reader_t *reader) {
+    while (CIF_TRUE) {
+        int c = JSON_PEEK(reader);
+
+        switch (c) {
+            case ' ':
+            case '\t':
+            case '\n':
+            case '\r':
+                reader->next += 1;
+                break;
+            default:
+                return c;
+        }
+    }
+}
+
+static int json_expect(json_reader_t *reader, int delimiter) {
+    if (json_skip_space(reader) == delimiter) {
+        reader->next += 1;
+        return CIF_OK;
+    } else {
+        return CIF_MISSING_DELIM;
+    }
+}
+
+static int json_next_member(json_reader_t *reader, int close, int *more) {
+    int c = json_skip_space(reader);
+
+    if (c == ',') {
+        reader->next += 1;
+        *more = CIF_TRUE;
+        /* a closing delimiter may not follow a separator */
+        c = json_skip_space(reader);
+        return (((c == close) || (c == EOF)) ? CIF_MISSING_VALUE : CIF_OK);
+    } else if (c == close) {
+        /* the closing delimiter is left for the caller to consume */
+        *more = CIF_FALSE;
+        return CIF_OK;
+    } else {
+        return CIF_MISSING_DELIM;
+    }
+}
+
+static int json_read_string(json_reader_t *reader, UChar **text) {
+    if (json_skip_space(reader) != '"') {
+        return CIF_UNEXPECTED_VALUE;
+    }
+    reader->next += 1;
+    reader->text_length = 0;
+
+    while (CIF_TRUE) {
+        size_t start = reader->next;
+        int c;
+
+        /* copy runs of bytes needing no decoding directly */
+        while ((reader->next < reader->limit) && (reader->buffer[reader->next] != '"')
+                && (reader->buffer[reader->next] != '\\') && (reader->buffer[reader->next] >= 0x20)) {
+            reader->next += 1;
+        }
+        if ((reader->next > start)
+                && (json_append(reader, (const char *) reader->buffer + start, reader->next - start) != CIF_OK)) {
+            return CIF_MEMORY_ERROR;
+        }
+
+        c = JSON_PEEK(reader);
+        if (c == '"') {
+            reader->next += 1;
+            return cif_utf8_to_ustr_internal(reader->text, (int32_t) reader->text_length, text, CIF_INVALID_CHAR);
+        } else if (c == EOF) {
+            return CIF_MISSING_ENDQUOTE;
+        } else if (c < 0x20) {
+            /* control characters must be escaped */
+            return CIF_INVALID_CHAR;
+        } else if (c == '\\') {
+            char decoded[4];
+            size_t length = 1;
+
+            reader->next += 1;
+            switch (c = JSON_PEEK(reader)) {
+                case '"':
+                case '\\':
+                case '/':
+                    decoded[0] = (char) c;
+                    break;
+                case 'b':
+                    decoded[0] = '\b';
+                    break;
+                case 'f':
+                    decoded[0] = '\f';
+                    break;
+                case 'n':
+                    decoded[0] = '\n';
+                    break;
+                case 'r':
+                    decoded[0] = '\r';
+                    break;
+                case 't':
+                    decoded[0] = '\t';
+                    break;
+                case 'u':
+                    {
+                        UChar32 code_point = 0;
+                        int units = 0;
+
+                        /* one escaped UTF-16 code unit, or two forming a surrogate pair */
+                        do {
+                            UChar32 unit = 0;
+                            int digits;
+
+                            if ((units > 0) && ((JSON_PEEK(reader) != '\\')
+                                    || ((reader->next += 1), (JSON_PEEK(reader) != 'u')))) {
+                                return CIF_INVALID_CHAR;
+                            }
+                            for (digits = 0; digits < 4; digits += 1) {
+                                reader->next += 1;
+                                c = JSON_PEEK(reader);
+                                if ((c >= '0') && (c <= '9')) {
+                                    unit = (unit << 4) + (c - '0');
+                                } else if ((c >= 'a') && (c <= 'f')) {
+                                    unit = (unit << 4) + (c - 'a' + 10);
+                                } else if ((c >= 'A') && (c <= 'F')) {
+                                    unit = (unit << 4) + (c - 'A' + 10);
+                                } else {
+                                    return CIF_INVALID_CHAR;
+                                }
+                            }
+                            reader->next += 1;
+                            if (units == 0) {
+                                code_point = unit;
+                            } else if (U16_IS_TRAIL(unit)) {
+                                code_point = U16_GET_SUPPLEMENTARY(code_point, unit);
+                            } else {
+                                return CIF_INVALID_CHAR;
+                            }
+                            units += 1;
+                        } while (U16_IS_LEAD(code_point));
+
+                        /* CIF text cannot contain NUL characters or unpaired surrogates */
+                        if ((code_point == 0) || U_IS_SURROGATE(code_point)) {
+                            return CIF_INVALID_CHAR;
+                        }
+                        length = 0;
+                        U8_APPEND_UNSAFE(decoded, length, code_point);
+                        if (json_append(reader, decoded, length) != CIF_OK) {
+                            return CIF_MEMORY_ERROR;
+                        }
+                    }
+                    continue;
+                default:
+                    return ((c == EOF) ? CIF_MISSING_ENDQUOTE : CIF_INVALID_CHAR);
+            }
+            reader->next += 1;
+            if (json_append(reader, decoded, length) != CIF_OK) {
+                return CIF_MEMORY_ERROR;
+            }
+        }
+    }
+}
+
+static int json_read_number(json_reader_t *reader, UChar **text) {
+    int c;
+
+    reader->text_length = 0;
+    for (c = JSON_PEEK(reader); ((c >= '0') && (c <= '9')) || (c == '-') || (c == '+') || (c == '.') || (c == 'e')
+            || (c == 'E'); c = JSON_PEEK(reader)) {
+        char byte = (char) c;
+
+        if (json_append(reader, &byte, 1) != CIF_OK) {
+            return CIF_MEMORY_ERROR;
+        }
+        reader->next += 1;
+    }
+
+    return cif_utf8_to_ustr_internal(reader->text, (int32_t) reader->text_length, text, CIF_INVALID_CHAR);
+}
+
+static int json_read_literal(json_reader_t *reader, const char *literal) {
+    for (; *literal != '\0'; literal += 1) {
+        if (JSON_PEEK(reader) != *literal) {
+            return CIF_INVALID_CHAR;
+        }
+        reader->next += 1;
+    }
+
+    return CIF_OK;
+}
+
+static int json_append(json_reader_t *reader, const char *bytes, size_t count) {
+    if ((reader->text_capacity - reader->text_length) < count) {
+        size_t new_capacity = ((reader->text_capacity == 0) ? 256 : reader->text_capacity);
+        char *new_text;
+
+        while ((new_capacity - reader->text_length) < count) {
+            new_capacity *= 2;
+        }
+        new_text = (char *) realloc(reader->text, new_capacity);
+        if (new_text == NULL) {
+            return CIF_MEMORY_ERROR;
+        }
+        reader->text = new_text;
+        reader->text_capacity = new_capacity;
+    }
+    memcpy(reader->text + reader->text_length, bytes, count);
+    reader->text_length += count;
+
+    return CIF_OK;
+}
+
+static int json_read_value(json_reader_t *reader, cif_value_tp *value) {
+    static const UChar unknown[3] = { UCHAR_BSL, UCHAR_QUERY, 0 };
+    static const UChar unk_string[2] = { UCHAR_QUERY, 0 };
+    static const UChar na_string[2] = { UCHAR_DECIMAL, 0 };
+    UChar *text;
+    int more;
+    int result;
+    int c = json_skip_space(reader);
+
+    switch (c) {
+        case '"':
+        case '-':
+        case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9':
+            result = ((c == '"') ? json_read_string(reader, &text) : json_read_number(reader, &text));
+            if (result != CIF_OK) {
+                return result;
+            } else if (u_strcmp(text, unknown) == 0) {
+                free(text);
+                return cif_value_init(value, CIF_UNK_KIND);
+            } else if ((result = cif_value_init_char(value, text)) != CIF_OK) {
+                free(text);
+                return result;
+            } else if ((u_strcmp(text, unk_string) == 0) || (u_strcmp(text, na_string) == 0)) {
+                /* the special strings "?" and "." remain quoted characters */
+                return CIF_OK;
+            } else {
+                /*
+                 * Mark the value unquoted where that is possible, as the parser does for whitespace-delimited values,
+                 * so that it is usable as a number if it has the form of one.  Values that cannot be unquoted, such as
+                 * those containing whitespace, remain quoted.
+                 */
+                result = cif_value_try_quoted(value, CIF_NOT_QUOTED);
+                return (((result == CIF_OK) || (result == CIF_ARGUMENT_ERROR)) ? CIF_OK : result);
+            }
+        case 'n':
+            return (((result = json_read_literal(reader, "null")) == CIF_OK) ? cif_value_init(value, CIF_NA_KIND)
+                    : result);
+        case 't':
+        case 'f':
+            /* well-formed JSON, but without a CIF counterpart */
+            return (((result = json_read_literal(reader, ((c == 't') ? "true" : "false"))) == CIF_OK)
+                    ? CIF_UNEXPECTED_VALUE : result);
+        case '[':
+            reader->next += 1;
+            if ((result = cif_value_init(value, CIF_LIST_KIND)) == CIF_OK) {
+                size_t index;
+
+                more = (json_skip_space(reader) != ']');
+                for (index = 0; (result == CIF_OK) && more; index += 1) {
+                    cif_value_tp *element;
+
+                    /* insert a dummy element, then read the value into it; this avoids copying */
+                    if (((result = cif_value_insert_element_at(value, index, NULL)) == CIF_OK)
+                            && ((result = cif_value_get_element_at(value, index, &element)) == CIF_OK)
+                            && ((result = json_read_value(reader, element)) == CIF_OK)) {
+                        result = json_next_member(reader, ']', &more);
+                    }
+                }
+                reader->next += (result == CIF_OK);
+            }
+            return result;
+        case '{':
+            reader->next += 1;
+            if ((result = cif_value_init(value, CIF_TABLE_KIND)) == CIF_OK) {
+                more = (json_skip_space(reader) != '}');
+                while ((result == CIF_OK) && more) {
+                    cif_value_tp *item;
+
+                    if ((result = json_read_string(reader, &text)) == CIF_OK) {
+                        /* insert a dummy value, then read the value into it */
+                        if (((result = json_expect(reader, ':')) == CIF_OK)
+                                && ((result = cif_value_set_item_by_key(value, text, NULL)) == CIF_OK)
+                                && ((result = cif_value_get_item_by_key(value, text, &item)) == CIF_OK)
+                                && ((result = json_read_value(reader, item)) == CIF_OK)) {
+                            result = json_next_member(reader, '}', &more);
+                        }
+                        free(text);
+                    }
+                }
+                reader->next += (result == CIF_OK);
+            }
+            return result;
+        case EOF:
+            return CIF_MISSING_VALUE;
+        default:
+            return CIF_INVALID_CHAR;
+    }
+}
+
+static int json_skip_value(json_reader_t *reader) {
+    UChar *text;
+    int close;
+    int more;
+    int result;
+    int c = json_skip_space(reader);
+
+    switch (c) {
+        case '"':
+            if ((result = json_read_string(reader, &text)) == CIF_OK) {
+                free(text);
+            }
+            return result;
+        case 'n':
+            return json_read_literal(reader, "null");
+        case 't':
+            return json_read_literal(reader, "true");
+        case 'f':
+            return json_read_literal(reader, "false");
+        case '[':
+        case '{':
+            close = ((c == '[') ? ']' : '}');
+            reader->next += 1;
+            more = (json_skip_space(reader) != close);
+            for (result = CIF_OK; (result == CIF_OK) && more; ) {
+                if ((c == '{') && (((result = json_read_string(reader, &text)) != CIF_OK)
+                        || (free(text), ((result = json_expect(reader, ':')) != CIF_OK)))) {
+                    break;
+                }
+                if ((result = json_skip_value(reader)) == CIF_OK) {
+                    result = json_next_member(reader, close, &more);
+                }
+            }
+            reader->next += (result == CIF_OK);
+            return result;
+        case EOF:
+            return CIF_MISSING_VALUE;
+        default:
+            if ((c == '-') || ((c >= '0') && (c <= '9'))) {
+                if ((result = json_read_number(reader, &text)) == CIF_OK) {
+                    free(text);
+                }
+                return result;
+            }
+            return CIF_INVALID_CHAR;
+    }
+}
+
+static int json_read_blocks(json_reader_t *reader, cif_tp *cif) {
+    static const UChar metadata_key[9] = { 'M', 'e', 't', 'a', 'd', 'a', 't', 'a', 0 };
+    int more;
+    int result = ((json_skip_space(reader) == '{') ? CIF_OK : CIF_UNEXPECTED_VALUE);
+
+    reader->next += 1;
+    more = (json_skip_space(reader) != '}');
+    while ((result == CIF_OK) && more) {
+        UChar *code;
+
+        if ((result = json_read_string(reader, &code)) == CIF_OK) {
+            if ((result = json_expect(reader, ':')) == CIF_OK) {
+                if (u_strcmp(code, metadata_key) == 0) {
+                    result = json_skip_value(reader);
+                } else {
+                    cif_block_tp *block = NULL;
+
+                    if ((result = cif_create_block_internal(cif, code, CIF_FALSE, &block)) == CIF_OK) {
+                        result = json_read_container(reader, block);
+                        cif_container_free(block);
+                    }
+                }
+            }
+            free(code);
+        }
+        if (result == CIF_OK) {
+            result = json_next_member(reader, '}', &more);
+        }
+    }
+    reader->next += (result == CIF_OK);
+
+    return result;
+}
+
+static int json_read_container(json_reader_t *reader, cif_container_tp *container) {
+    static const UChar frames_key[7] = { 'F', 'r', 'a', 'm', 'e', 's', 0 };
+    json_loop_t current = { NULL, 0, NULL };
+    cif_packet_tp *scalars = NULL;
+    size_t scalar_count = 0;
+    int more;
+    int result;
+
+    if (json_skip_space(reader) != '{') {
+        return CIF_UNEXPECTED_VALUE;
+    } else if ((result = cif_packet_create(&scalars, NULL)) != CIF_OK) {
+        return result;
+    }
+
+    reader->next += 1;
+    more = (json_skip_space(reader) != '}');
+    while ((result == CIF_OK) && more) {
+        UChar *name;
+
+        if ((result = json_read_string(reader, &name)) == CIF_OK) {
+            if ((result = json_expect(reader, ':')) != CIF_OK) {
+                /* nothing more to do for this member */
+            } else if (u_strcmp(name, frames_key) == 0) {
+                result = json_read_frames(reader, container);
+            } else if ((result = json_read_item_values(reader)) != CIF_OK) {
+                /* nothing more to do for this member */
+            } else if (reader->value_count > 1) {
+                /*
+                 * Record the scalars seen so far before the loop, so that the container's scalar loop precedes it as
+                 * it did in the source.
+                 */
+                if ((scalar_count > 0)
+                        && ((result = cif_container_set_values_internal(container, scalars, CIF_TRUE)) == CIF_OK)) {
+                    cif_packet_free(scalars);
+                    scalars = NULL;
+                    scalar_count = 0;
+                    result = cif_packet_create(&scalars, NULL);
+                }
+                if (result == CIF_OK) {
+                    result = json_add_looped_item(reader, container, &current, name);
+                }
+            } else {
+                /* a scalar, recorded later with the others of this container */
+                if (cif_packet_get_item(scalars, name, NULL) == CIF_OK) {
+                    result = CIF_DUP_ITEMNAME;
+                } else if ((result = cif_packet_adopt_item_internal(scalars, name, *(reader->values))) == CIF_OK) {
+                    reader->value_count = 0;
+                    scalar_count += 1;
+                }
+
+                /* the next looped item starts a new loop */
+                if (current.loop != NULL) {
+                    cif_loop_free(current.loop);
+                    current.loop = NULL;
+                }
+            }
+            free(name);
+        }
+        if (result == CIF_OK) {
+            result = json_next_member(reader, '}', &more);
+        }
+    }
+
+    if (result == CIF_OK) {
+        reader->next += 1;
+        result = cif_container_set_values_internal(container, scalars, CIF_TRUE);
+    }
+    json_clear_values(reader);
+    cif_packet_free(scalars);
+    if (current.loop != NULL) {
+        cif_loop_free(current.loop);
+    }
+    free(current.first_name);
+
+    return result;
+}
+
+static int json_read_frames(json_reader_t *reader, cif_container_tp *container) {
+    int more;
+    int result = ((json_skip_space(reader) == '{') ? CIF_OK : CIF_UNEXPECTED_VALUE);
+
+    reader->next += 1;
+    more = (json_skip_space(reader) != '}');
+    while ((result == CIF_OK) && more) {
+        UChar *code;
+
+        if ((result = json_read_string(reader, &code)) == CIF_OK) {
+            cif_frame_tp *frame = NULL;
+
+            if (((result = json_expect(reader, ':')) == CIF_OK)
+                    && ((result = cif_container_create_frame_internal(container, code, CIF_FALSE, &frame))
+                            == CIF_OK)) {
+                result = json_read_container(reader, frame);
+                cif_container_free(frame);
+            }
+            free(code);
+        }
+        if (result == CIF_OK) {
+            result = json_next_member(reader, '}', &more);
+        }
+    }
+    reader->next += (result == CIF_OK);
+
+    return result;
+}
+
+static int json_read_item_values(json_reader_t *reader) {
+    int more;
+    int result;
+
+    json_clear_values(reader);
+    if (json_skip_space(reader) != '[') {
+        return CIF_UNEXPECTED_VALUE;
+    }
+    reader->next += 1;
+    if (json_skip_space(reader) == ']') {
+        /* every item has at least one value */
+        return CIF_UNEXPECTED_VALUE;
+    }
+
+    do {
+        if (reader->value_count >= reader->value_capacity) {
+            size_t new_capacity = ((reader->value_capacity == 0) ? 64 : (2 * reader->value_capacity));
+            cif_value_tp **new_values = (cif_value_tp **) realloc(reader->values,
+                    new_capacity * sizeof(cif_value_tp *));
+
+            if (new_values == NULL) {
+                return CIF_MEMORY_ERROR;
+            }
+            reader->values = new_values;
+            reader->value_capacity = new_capacity;
+        }
+        if ((result = cif_value_create(CIF_UNK_KIND, reader->values + reader->value_count)) != CIF_OK) {
+            return result;
+        }
+        reader->value_count += 1;
+        if ((result = json_read_value(reader, reader->values[reader->value_count - 1])) == CIF_OK) {
+            result = json_next_member(reader, ']', &more);
+        }
+    } while ((result == CIF_OK) && more);
+    reader->next += (result == CIF_OK);
+
+    return result;
+}
+
+static int json_add_looped_item(json_reader_t *reader, cif_container_tp *container, json_loop_t *current,
+        const UChar *name) {
+    UChar *norm_name;
+    int result = cif_normalize_item_name(name, -1, &norm_name, CIF_INVALID_ITEMNAME);
+
+    if (result != CIF_OK) {
+        return result;
+    }
+
+    if ((current->loop != NULL) && (current->packet_count == reader->value_count)
+            && json_same_category(current->first_name, name)) {
+        /* another item of the current loop */
+        result = cif_loop_add_column_internal(current->loop, name, norm_name, CIF_TRUE, reader->values,
+                reader->value_count);
+    } else {
+        UChar *names[2];
+
+        if (current->loop != NULL) {
+            cif_loop_free(current->loop);
+            current->loop = NULL;
+        }
+        free(current->first_name);
+        current->first_name = NULL;
+
+        /* the first item of a new loop */
+        names[0] = (UChar *) name;
+        names[1] = NULL;
+        if (((result = cif_container_create_loop(container, NULL, names, &(current->loop))) == CIF_OK)
+                && ((result = cif_loop_add_column_internal(current->loop, name, norm_name, CIF_FALSE,
+                        reader->values, reader->value_count)) == CIF_OK)) {
+            current->packet_count = reader->value_count;
+            current->first_name = cif_u_strdup(name);
+            if (current->first_name == NULL) {
+                result = CIF_MEMORY_ERROR;
+            }
+        }
+    }
+    free(norm_name);
+    json_clear_values(reader);
+
+    return result;
+}
+
+static void json_clear_values(json_reader_t *reader) {
+    while (reader->value_count > 0) {
+        reader->value_count -= 1;
+        cif_value_free(reader->values[reader->value_count]);
+    }
+}
+
+static int json_same_category(const UChar *name1, const UChar *name2) {
+    const UChar *period1 = u_strchr(name1, UCHAR_DECIMAL);
+    const UChar *period2 = u_strchr(name2, UCHAR_DECIMAL);
+
+    if ((period1 == NULL) || (period2 == NULL)) {
+        /* names without categories match only each other */
+        return (period1 == period2);
+    } else {
+        return (((period1 - name1) == (period2 - name2))
+                && (u_strncasecmp(name1, name2, (int32_t) (period1 - name1), U_FOLD_CASE_DEFAULT) == 0));
+    }
+}
+
+static int writer_begin_container(cif_writer_tp *writer, const UChar *code, int is_block) {
+    int result = (is_block ? end_writer_containers(writer, CIF_TRUE) : end_writer_section(writer));
+
+    return ((result == CIF_OK) ? write_header(writer, code) : result);
+}
+
+static int writer_end_frame(cif_writer_tp *writer) {
+    int result = end_writer_section(writer);
+
+    return ((result == CIF_OK) ? write_container_end(NULL, writer) : result);
+}
+
+static int writer_item(cif_writer_tp *writer, const UChar *name, cif_value_tp *value) {
+    if (writer->section != WRITER_IN_SCALARS) {
+        int result = end_writer_section(writer);
+
+        if (result == CIF_OK) {
+            result = write_scalars_start(writer);
+        }
+        if (result != CIF_OK) {
+            return result;
+        }
+        writer->section = WRITER_IN_SCALARS;
+    }
+
+    return write_item((UChar *) name, value, writer);
+}
+
+static int writer_begin_loop(cif_writer_tp *writer, const UChar * const *names) {
+    int result = end_writer_section(writer);
+
+    if (result == CIF_OK) {
+        result = write_loop_header(writer, names);
+        if (result == CIF_OK) {
+            const UChar * const *next_name;
+
+            for (next_name = names; *next_name != NULL; next_name += 1) ;
+            writer->section = WRITER_IN_LOOP;
+            writer->loop_width = (size_t) (next_name - names);
+        }
+    }
+
+    return result;
+}
+
+static int writer_loop_value(cif_writer_tp *writer, cif_value_tp *value) {
+    int result = write_item(NULL, value, writer);
+
+    if (result == CIF_OK) {
+        writer->next_column += 1;
+        if (writer->next_column == writer->loop_width) {
+            writer->next_column = 0;
+            result = write_packet_end(NULL, writer);
+        }
+    }
+
+    return result;
+}
+
+static int end_writer_section(cif_writer_tp *writer) {
+    int result = CIF_OK;
+
+    switch (writer->section) {
+        case WRITER_IN_SCALARS:
+            /* the scalars form a single packet of the container's scalar loop */
+            result = write_packet_end(NULL, writer);
+            if (result == CIF_OK) {
+                result = write_loop_end(NULL, writer);
+            }
+            break;
+        case WRITER_IN_LOOP:
+            result = write_loop_end(NULL, writer);
+            break;
+        /* default: nothing to end */
+    }
+    writer->section = WRITER_NO_SECTION;
+    writer->loop_width = 0;
+    writer->next_column = 0;
+
+    return result;
+}
+
+static int end_writer_containers(cif_writer_tp *writer, int end_block) {
+    int result = end_writer_section(writer);
+
+    while ((result == CIF_OK) && (CONTEXT_DEPTH(writer) > (end_block ? 0 : 1))) {
+        result = write_container_end(NULL, writer);
+    }
+
+    return result;
+}
+
+static int write_cif_to_buffer(write_buffer_t *buffer, struct cif_write_opts_s *options, cif_tp *cif) {
+    cif_handler_tp handler = {
+        write_cif_start,
+        write_cif_end,
+        write_container_start,
+        write_container_end,
+        write_container_start,
+        write_container_end,
+        write_loop_start,
+        write_loop_end,
+        write_packet_start,
+        write_packet_end,
+        write_item
+    };
+    cif_handler_tp json_handler = {
+        write_json_cif_start,
+        write_json_cif_end,
+        write_json_container_start,
+        write_json_container_end,
+        write_json_container_start,
+        write_json_container_end,
+        write_json_loop_start,
+        NULL,
+        NULL,
+        NULL,
+        NULL
+    };
+    CONTEXT_S context;
+    int result;
+
+    CONTEXT_INITIALIZE(context, buffer);
+    if (options && options->json) {
+        /* CIF-JSON is always UTF-8, whatever CIF version is requested */
+        context.json = CIF_TRUE;
+    } else if (options && (options->cif_version == 1)) {
+        context.version = 1;
+    }
+    if (options && ((options->block_codes != NULL) || (options->frame_codes != NULL)
+            || (options->include_names != NULL) || (options->exclude_names != NULL))) {
+        context.selection = options;
+    }
+    if (options && options->align_loops) {
+        context.align_loops = CIF_TRUE;
+    }
+
+    result = open_write_buffer(buffer, context.version);
+    if (result == CIF_OK) {
+        if (context.json) {
+            result = cif_walk(cif, &json_handler, &context);
+        } else
+#ifdef HAVE_PTHREADS
+        if (options && (options->max_write_threads > 1) && sqlite3_threadsafe()) {
+            result = write_parallel(&context, cif, &handler, (size_t) options->max_write_threads);
+        } else
+#endif
+        {
+            result = cif_walk(cif, &handler, &context);
+        }
+
+        free(context.column_starts);
+        if (buffer->sink != NULL) {
+            /* pass on whatever has been written successfully, even after an error */
+            if ((flush_write_buffer(buffer, 0) != CIF_OK) && (result == CIF_OK)) {
+                result = CIF_ERROR;
+            }
+            free(buffer->data);
+        } else if (result != CIF_OK) {
+            free(buffer->data);
+        }
+
+        if (buffer->converter != NULL) {
+            ucnv_close(buffer->converter);
+        }
+    }
+
+    return result;
+}
+
+static int open_write_buffer(write_buffer_t *buffer, int cif_version) {
+    buffer->converter = NULL;
+    buffer->used = 0;
+    buffer->capacity = WRITE_BUFFER_SIZE;
+    if (cif_version == 1) {
+        /* CIF 1.1 output is in the default encoding */
+        UErrorCode error_code = U_ZERO_ERROR;
+
+        buffer->converter = ucnv_open(NULL, &error_code);
+        if (U_FAILURE(error_code)) {
+            return CIF_ERROR;
+        }
+    }
+
+    buffer->data = (char *) malloc(WRITE_BUFFER_SIZE);
+    if (buffer->data == NULL) {
+        if (buffer->converter != NULL) {
+            ucnv_close(buffer->converter);
+        }
+        return CIF_MEMORY_ERROR;
+    }
+
+    return CIF_OK;
+}
+
+#ifdef HAVE_PTHREADS
+static int write_parallel(void *context, cif_tp *cif, cif_handler_tp *handler, size_t worker_count) {
+    write_job_t job;
+    write_worker_t *workers;
+    pthread_t *threads;
+    sqlite3_int64 loop_total;
+    UChar space[2] = { UCHAR_SP, 0 };
+    size_t started;
+    size_t w;
+    int result;
+
+    if ((cif_count_loops(cif, &loop_total) != CIF_OK) || (loop_total < 2)) {
+        /* nothing to be gained */
+        return cif_walk(cif, handler, context);
+    } else if (worker_count > (size_t) loop_total) {
+        worker_count = (size_t) loop_total;
+    }
+
+    job.loop_total = (size_t) loop_total;
+    job.loop_count = 0;
+    job.failed_loop = job.loop_total;
+    job.loop_owners = (size_t *) malloc(job.loop_total * sizeof(size_t));
+    workers = (write_worker_t *) calloc(worker_count, sizeof(write_worker_t));
+    threads = (pthread_t *) malloc(worker_count * sizeof(pthread_t));
+    for (w = 0; (workers != NULL) && (w < worker_count); w += 1) {
+        workers[w].loop_spans = (size_t *) malloc(2 * job.loop_total * sizeof(size_t));
+        if (workers[w].loop_spans == NULL) {
+            break;
+        }
+    }
+    if ((job.loop_owners == NULL) || (threads == NULL) || (workers == NULL) || (w < worker_count)
+            || (pthread_mutex_init(&job.lock, NULL) != 0)) {
+        /* no resources with which to try */
+        result = cif_walk(cif, handler, context);
+    } else {
+        size_t position = 0;
+        size_t loop_index;
+        write_worker_t *first = workers;
+
+        /* the CIF 1.1 character table is initialized on first use, which must not happen concurrently */
+        if (cif_validate_cif11_characters(space, NULL) != CIF_OK) {
+            /* not expected, and harmless anyway */
+        }
+
+        for (w = 0; w < worker_count; w += 1) {
+            CONTEXT_INITIALIZE(workers[w].context, &(workers[w].buffer));
+            workers[w].context.version = ((CONTEXT_T) context)->version;
+            workers[w].context.selection = CONTEXT_SELECTION(context);
+            workers[w].context.align_loops = IS_ALIGN_LOOPS(context);
+            workers[w].handler = *handler;
+            workers[w].handler.handle_loop_start = write_claimed_loop_start;
+            workers[w].handler.handle_loop_end = write_claimed_loop_end;
+            workers[w].handler.handle_packet_start = write_claimed_packet_start;
+            workers[w].job = &job;
+            workers[w].index = w;
+            workers[w].cif = ((w == 0) ? cif : NULL);
+        }
+
+        /* start the other workers, each reading its own copy of the CIF, until one cannot be started */
+        for (started = 1; started < worker_count; started += 1) {
+            if (cif_copy_store(cif, &(workers[started].cif)) != CIF_OK) {
+                break;
+            } else if (pthread_create(threads + started, NULL, write_loops, workers + started) != 0) {
+                if (cif_destroy(workers[started].cif) != CIF_OK) {
+                    /* ignore the error; the copy is abandoned either way */
+                }
+                break;
+            }
+        }
+
+        /* the current thread serves as the first worker, formatting whatever the others do not */
+        (void) write_loops(first);
+        for (w = 1; w < started; w += 1) {
+            pthread_join(threads[w], NULL);
+        }
+
+        /*
+         * Assemble the output in document order: everything outside the loops comes from the first worker, and each
+         * loop from the worker that claimed it.  All workers reach the same loops in the same order, and any error
+         * outside a loop arises for every worker alike, so the first worker's walk determines the extent of the
+         * output, up to the first loop in which any worker failed.
+         */
+        result = CIF_OK;
+        for (loop_index = 0; loop_index < first->loops_reached; loop_index += 1) {
+            write_worker_t *owner = workers + job.loop_owners[loop_index];
+            size_t start = owner->loop_spans[2 * loop_index];
+
+            if ((write_bytes(context, first->buffer.data + position, first->loop_spans[2 * loop_index] - position)
+                    != CIF_OK) || (write_bytes(context, owner->buffer.data + start,
+                            owner->loop_spans[2 * loop_index + 1] - start) != CIF_OK)) {
+                result = CIF_ERROR;
+                break;
+            } else if (owner->failed_loop == loop_index) {
+                result = owner->result;
+                break;
+            }
+            position = first->loop_spans[2 * loop_index + 1];
+        }
+        if (loop_index == first->loops_reached) {
+            result = (((first->buffer.used == position)
+                    || (write_bytes(context, first->buffer.data + position, first->buffer.used - position) == CIF_OK))
+                    ? first->result : CIF_ERROR);
+        }
+
+        for (w = 0; w < started; w += 1) {
+            free(workers[w].buffer.data);
+            free(workers[w].context.column_starts);
+            if ((w > 0) && (cif_destroy(workers[w].cif) != CIF_OK)) {
+                /* ignore the error; the copy is abandoned either way */
+            }
+        }
+        pthread_mutex_destroy(&job.lock);
+    }
+
+    if (workers != NULL) {
+        for (w = 0; w < worker_count; w += 1) {
+            free(workers[w].loop_spans);
+        }
+    }
+    free(threads);
+    free(workers);
+    free(job.loop_owners);
+
+    return result;
+}
+
+static void *write_loops(void *worker) {
+    write_worker_t *w = (write_worker_t *) worker;
+
+    w->buffer.sink = NULL;
+    w->buffer.sink_context = NULL;
+    w->loops_reached = 0;
+    w->in_loop = CIF_FALSE;
+    w->result = open_write_buffer(&(w->buffer), w->context.version);
+    if (w->result != CIF_OK) {
+        /* formats nothing, and so also fails in no loop */
+        w->buffer.data = NULL;
+        w->buffer.used = 0;
+    } else {
+        w->result = cif_walk(w->cif, &(w->handler), w);
+        if (w->buffer.converter != NULL) {
+            ucnv_close(w->buffer.converter);
+        }
+    }
+
+    if (w->in_loop) {
+        /* the walk failed within the most recently reached loop; there is no need for any worker to go past it */
+        w->failed_loop = w->loops_reached - 1;
+        w->loop_spans[2 * w->failed_loop + 1] = w->buffer.used;
+        pthread_mutex_lock(&(w->job->lock));
+        if (w->failed_loop < w->job->failed_loop) {
+            w->job->failed_loop = w->failed_loop;
+        }
+        pthread_mutex_unlock(&(w->job->lock));
+    } else {
+        w->failed_loop = w->loops_reached;
+    }
+
+    return NULL;
+}
+
+static int write_claimed_loop_start(cif_loop_tp *loop, void *context) {
+    write_worker_t *worker = (write_worker_t *) context;
+    write_job_t *job = worker->job;
+    size_t loop_index = worker->loops_reached;
+    size_t owner;
+
+    if (loop_index >= job->loop_total) {
+        /* the CIF has more loops than it did when the write started */
+        return CIF_INTERNAL_ERROR;
+    }
+
+    pthread_mutex_lock(&(job->lock));
+    if (loop_index > job->failed_loop) {
+        /* the output cannot extend this far */
+        pthread_mutex_unlock(&(job->lock));
+        return CIF_TRAVERSE_END;
+    } else if (loop_index == job->loop_count) {
+        job->loop_owners[loop_index] = worker->index;
+        job->loop_count += 1;
+    }
+    owner = job->loop_owners[loop_index];
+    pthread_mutex_unlock(&(job->lock));
+
+    worker->loop_spans[2 * loop_index] = worker->buffer.used;
+    worker->loop_spans[2 * loop_index + 1] = worker->buffer.used;
+    worker->loops_reached += 1;
+    if (owner != worker->index) {
+        return CIF_TRAVERSE_SKIP_CURRENT;
+    } else {
+        int result;
+
+        worker->in_loop = CIF_TRUE;
+        result = write_loop_start(loop, context);
+        if (result == CIF_TRAVERSE_SKIP_CURRENT) {
+            /* no part of the loop is selected; the loop end handler will not be called */
+            worker->in_loop = CIF_FALSE;
+        }
+
+        return result;
+    }
+}
+
+static int write_claimed_packet_start(cif_packet_tp *packet, void *context) {
+    write_worker_t *worker = (write_worker_t *) context;
+    int result;
+
+    pthread_mutex_lock(&(worker->job->lock));
+    result = ((worker->loops_reached - 1 > worker->job->failed_loop) ? CIF_TRAVERSE_END : CIF_TRAVERSE_CONTINUE);
+    pthread_mutex_unlock(&(worker->job->lock));
+
+    return ((result == CIF_TRAVERSE_CONTINUE) ? write_packet_start(packet, context) : result);
+}
+
+static int write_claimed_loop_end(cif_loop_tp *loop, void *context) {
+    write_worker_t *worker = (write_worker_t *) context;
+    int result = write_loop_end(loop, context);
+
+    if (result == CIF_TRAVERSE_CONTINUE) {
+        worker->loop_spans[2 * worker->loops_reached - 1] = worker->buffer.used;
+        worker->in_loop = CIF_FALSE;
+    }
+
+    return result;
+}
+#endif
+
+static int sniff_encoding(FILE *stream, struct cif_parse_opts_s *options, unsigned char *buffer, size_t buffer_size,
+        size_t *countp, const char **encoding_namep, int *cif_versionp) {
+    FAILURE_HANDLING;
+    size_t count;
+    const char *encoding_name;
+    UErrorCode error_code = U_ZERO_ERROR;
+    int cif_version;
+
+    if (options->prefer_cif2 > 19) {
+        cif_version = 2;
+    } else if (options->prefer_cif2 < 0) {
+        cif_version = 1;
+    } else {
+        cif_version = 0;
+    }
+
+    if (options->force_default_encoding != 0) {
+        encoding_name = options->default_encoding_name;
+        count = 0;
+        if ((options->prefer_cif2 < 20) && (options->prefer_cif2 > 0)) {
+            cif_version = -2;
+        }
+    } else {
+        /* attempt to guess the character encoding based on the first few bytes of the stream */
+
+        char *char_buffer = (char *) buffer;
+
+        count = fread(char_buffer, 1, buffer_size, stream);  /* returns a short count only if there isn't enough data */
+        if ((count < buffer_size) && ferror(stream)) {
+            DEFAULT_FAIL(early);
+        } else if (count == 0) {
+            /* simplest possible case: empty file */
+            return CIF_FINISHED;
+        } else {
+            int32_t sig_length;
+
+            /* Look for a Unicode signature (a BOM encoded at the beginning of the stream) */
+            encoding_name = ucnv_detectUnicodeSignature(char_buffer, count, &sig_length, &error_code);
+            if (U_FAILURE(error_code)) {
+                /* TODO: verify that ICU's idea of failure is what we really want here */
+                DEFAULT_FAIL(early);
+            } else if (encoding_name != NULL) {
+                /* a Unicode encoding signature is successfully detected */
+                /* nothing to do here */
+            } else if (options->prefer_cif2 > 19) {
+                /*
                  * The encoding was not confidently identified or explicitly named, but the user insists on parsing as
                  * CIF 2.0 regardless of presence or absence of a magic code.  Therefore, use UTF-8.
                  */
@@ -449,111 +2667,46 @@ int cif_parse(FILE *stream, struct cif_parse_opts_s *options, cif_tp **cifp) {
         }
     }
 
-    /* encoding identified, or knowingly defaulted */
-
-    ustream.converter = ucnv_open(encoding_name, &error_code); /* XXX: is any other customization needed? */
-    if (U_SUCCESS(error_code)) {
-        const char *converter_name = ucnv_getName(ustream.converter, &error_code);  /* belongs to ustream.converter */
-
-        ucnv_setToUCallBack(ustream.converter, ustream_to_unicode_callback, &scanner, NULL, NULL, &error_code);
-
-        if (U_FAILURE(error_code)) {
-            result = CIF_ERROR;
-        } else {
-            /* XXX: this test is probably too simplistic: */
-            int not_utf8 = strcmp("UTF-8", converter_name);
-
-            /* set up those properties of the scanner that derive from caller input */
-
-            /* character source */
-            ustream.byte_stream = stream;
-            ustream.byte_buffer = buffer;
-            ustream.buffer_size = BUFFER_SIZE;
-            ustream.buffer_position = buffer;
-            ustream.buffer_limit = buffer + count;
-            ustream.eof_status = 0;
-            ustream.last_error = 0; /* this is a _user_ error code, not necessarily a CIF code */
-
-            /* scanner details */
-            scanner.char_source = &ustream;
-            scanner.read_func = ustream_read_chars;
-            scanner.at_eof = CIF_FALSE;
-            scanner.cif_version = cif_version;
-            scanner.line_unfolding = MIN(options->line_folding_modifier, 1);
-            scanner.prefix_removing = MIN(options->text_prefixing_modifier, 1);
-            scanner.max_frame_depth = MIN(options->max_frame_depth, 1);
-            scanner.handler = ((options->handler == NULL) ? DEFAULT_OPTIONS.handler : options->handler);
-            scanner.error_callback
-                    = ((options->error_callback == NULL) ? DEFAULT_OPTIONS.error_callback : options->error_callback);
-            scanner.whitespace_callback = ((options->whitespace_callback == NULL) ? DEFAULT_OPTIONS.whitespace_callback
-                    : options->whitespace_callback);
-            scanner.keyword_callback = ((options->keyword_callback == NULL) ? DEFAULT_OPTIONS.keyword_callback
-                    : options->keyword_callback);
-            scanner.dataname_callback = ((options->dataname_callback == NULL) ? DEFAULT_OPTIONS.dataname_callback
-                    : options->dataname_callback);
-            scanner.user_data = options->user_data;  /* may be NULL */
-
-            /* perform the actual parse */
-            result = cif_parse_internal(&scanner, not_utf8, options->extra_ws_chars, options->extra_eol_chars, cif);
-        }
-
-        ucnv_close(ustream.converter);
-
-        return result;
-    }
-
+
+    *countp = count;
+    *encoding_namep = encoding_name;
+    *cif_versionp = cif_version;
+    return CIF_OK;
+
     FAILURE_HANDLER(early):
     FAILURE_TERMINUS;
 }
-#undef BUFFER_SIZE
 
-/*
- * Formats the CIF data represented by the 'cif' handle to the specified
- * output.
- */
-int cif_write(FILE *stream, struct cif_write_opts_s *options, cif_tp *cif) {
-    cif_handler_tp handler = {
-        write_cif_start,
-        write_cif_end,
-        write_container_start,
-        write_container_end,
-        write_container_start,
-        write_container_end,
-        write_loop_start,
-        write_loop_end,
-        write_packet_start,
-        write_packet_end,
-        write_item
-    };
-    UFILE *u_stream;
-    int result;
+static int open_uchar_stream(uchar_stream_t *ustream, FILE *stream, unsigned char *buffer, size_t buffer_size,
+        size_t count, const char *encoding_name, struct scanner_s *scanner, int *not_utf8) {
+    UErrorCode error_code = U_ZERO_ERROR;
 
-    if (options && (options->cif_version == 1)) {
-        u_stream = u_finit(stream, NULL, NULL);
-    } else {
-        u_stream = u_finit(stream, "C", "UTF_8");
-    }
+    ustream->converter = ucnv_open(encoding_name, &error_code); /* XXX: is any other customization needed? */
+    if (U_SUCCESS(error_code)) {
+        const char *converter_name = ucnv_getName(ustream->converter, &error_code);  /* belongs to the converter */
 
-    if (u_stream != NULL) {
-        CONTEXT_S context;
+        ucnv_setToUCallBack(ustream->converter, ustream_to_unicode_callback, scanner, NULL, NULL, &error_code);
 
-        CONTEXT_INITIALIZE(context, u_stream);
-        if (options && (options->cif_version == 1)) {
-            context.version = 1;
-        }
-        result = cif_walk(cif, &handler, &context);
+        if (U_FAILURE(error_code)) {
+            ucnv_close(ustream->converter);
+        } else {
+            /* XXX: this test is probably too simplistic: */
+            *not_utf8 = strcmp("UTF-8", converter_name);
 
-        /* TODO: handle errors */
-        u_fclose(u_stream);
-        return result;
-    } else {
-        return CIF_ERROR;
+            ustream->byte_stream = stream;
+            ustream->byte_buffer = buffer;
+            ustream->buffer_size = buffer_size;
+            ustream->buffer_position = buffer;
+            ustream->buffer_limit = buffer + count;
+            ustream->eof_status = 0;
+            ustream->last_error = 0; /* this is a _user_ error code, not necessarily a CIF code */
+
+            return CIF_OK;
+        }
     }
-}
 
-#ifdef __cplusplus
+    return CIF_ERROR;
 }
-#endif
 
 static ssize_t ustream_read_chars(void *char_source, UChar *dest, ssize_t count, int *error_code) {
     uchar_stream_t *ustream = (uchar_stream_t *) char_source;
@@ -635,6 +2788,471 @@ static void ustream_to_unicode_callback(const void *context, UConverterToUnicode
     } /* else it's a lifecycle signal, which we can safely ignore */
 }
 
+static void init_scanner(struct scanner_s *scanner, struct cif_parse_opts_s *options, int cif_version,
+        void *char_source, read_chars_f read_func, size_t first_line) {
+    scanner->char_source = char_source;
+    scanner->read_func = read_func;
+    scanner->at_eof = CIF_FALSE;
+    scanner->pending_cr = CIF_FALSE;
+    scanner->line = first_line;
+    scanner->cif_version = cif_version;
+    scanner->line_unfolding = MIN(options->line_folding_modifier, 1);
+    scanner->prefix_removing = MIN(options->text_prefixing_modifier, 1);
+    scanner->max_frame_depth = MIN(options->max_frame_depth, 1);
+    scanner->handler = ((options->handler == NULL) ? DEFAULT_OPTIONS.handler : options->handler);
+    scanner->error_callback
+            = ((options->error_callback == NULL) ? DEFAULT_OPTIONS.error_callback : options->error_callback);
+    scanner->whitespace_callback = ((options->whitespace_callback == NULL) ? DEFAULT_OPTIONS.whitespace_callback
+            : options->whitespace_callback);
+    scanner->keyword_callback = ((options->keyword_callback == NULL) ? DEFAULT_OPTIONS.keyword_callback
+            : options->keyword_callback);
+    scanner->dataname_callback = ((options->dataname_callback == NULL) ? DEFAULT_OPTIONS.dataname_callback
+            : options->dataname_callback);
+    scanner->item_token_callback = options->item_token_callback;  /* may be NULL */
+    scanner->include_names = options->include_names;              /* may be NULL */
+    scanner->exclude_names = options->exclude_names;              /* may be NULL */
+    scanner->user_data = options->user_data;  /* may be NULL */
+}
+
+#ifdef HAVE_PTHREADS
+static ssize_t uslice_read_chars(void *char_source, UChar *dest, ssize_t count, int *error_code UNUSED) {
+    uchar_slice_t *slice = (uchar_slice_t *) char_source;
+    ssize_t available = slice->limit - slice->next;
+
+    if (count > available) {
+        count = available;
+    }
+    if (count > 0) {
+        memcpy(dest, slice->next, count * sizeof(UChar));
+        slice->next += count;
+        return count;
+    } else {
+        return 0;
+    }
+}
+
+/*
+ * Evaluates whether the specified character is a member of the specified set of extra characters, which is a C
+ * string or NULL
+ */
+#define IS_EXTRA_CHAR(c, extra) (((c) < 0x80) && ((c) != 0) && ((extra) != NULL) && (strchr((extra), (c)) != NULL))
+
+/* Evaluates whether the specified character is a CIF end-of-line character, given a set of extra EOL characters */
+#define IS_EOL_CHAR(c, extra) (((c) == UCHAR_NL) || ((c) == UCHAR_CR) || (((c) != UCHAR_SP) && ((c) != UCHAR_TAB) \
+        && IS_EXTRA_CHAR((c), (extra))))
+
+static int resolve_cif_version(const UChar *text, size_t length, int cif_version, const char *extra_ws,
+        const char *extra_eol) {
+    static const UChar cif1_magic[] = { 0x23, 0x5c, 0x23, 0x43, 0x49, 0x46, 0x5f };  /* #\#CIF_ */
+    static const UChar cif2_magic[] = { 0x23, 0x5c, 0x23, 0x43, 0x49, 0x46, 0x5f, 0x32, 0x2e, 0x30 };  /* #\#CIF_2.0 */
+
+    if (cif_version > 0) {
+        return cif_version;
+    } else {
+        size_t start = ((length > 0) && (text[0] == UCHAR_BOM)) ? 1 : 0;
+        size_t end;
+
+        for (end = start; end < length; end += 1) {
+            UChar c = text[end];
+
+            if ((c == UCHAR_SP) || (c == UCHAR_TAB) || IS_EOL_CHAR(c, extra_eol) || IS_EXTRA_CHAR(c, extra_ws)) {
+                break;
+            }
+        }
+
+        if (end - start == MAGIC_LENGTH + MAGIC_EXTRA) {
+            if (memcmp(text + start, cif2_magic, sizeof(cif2_magic)) == 0) {
+                return 2;
+            } else if (memcmp(text + start, cif1_magic, sizeof(cif1_magic)) == 0) {
+                return 1;
+            }
+        }
+
+        return ((cif_version < 0) ? -cif_version : 1);
+    }
+}
+
+static int find_segments(const UChar *text, size_t length, int cif_version, const char *extra_eol,
+        segment_t **segments, size_t *segment_count) {
+    static const char data_kw[] = "data_";
+    size_t capacity = 16;
+    size_t count = 0;
+    segment_t *found = (segment_t *) malloc(capacity * sizeof(segment_t));
+    size_t line = 1;
+    size_t index = 0;
+    int at_line_start = CIF_TRUE;
+    int in_text = CIF_FALSE;
+    UChar triple_delim = 0;  /* nonzero only inside a triple-quoted string */
+
+    if (found == NULL) {
+        return CIF_MEMORY_ERROR;
+    }
+    found[count].start = text;
+    found[count].line = line;
+    count += 1;
+
+    while (index < length) {
+        UChar c = text[index];
+
+        if (IS_EOL_CHAR(c, extra_eol)) {
+            /* a CR LF pair counts as a single line terminator */
+            if ((c != UCHAR_NL) || (index == 0) || (text[index - 1] != UCHAR_CR)) {
+                line += 1;
+            }
+            at_line_start = CIF_TRUE;
+            index += 1;
+            continue;
+        } else if (at_line_start) {
+            at_line_start = CIF_FALSE;
+            if (in_text) {
+                /* only a semicolon at the start of a line can end a text field */
+                if (c == UCHAR_SEMI) {
+                    in_text = CIF_FALSE;
+                    index += 1;
+                    continue;
+                }
+            } else if (triple_delim == 0) {
+                if (c == UCHAR_SEMI) {
+                    in_text = CIF_TRUE;
+                } else if ((length - index > 5) && (text[index + 5] != UCHAR_SP) && (text[index + 5] != UCHAR_TAB)
+                        && !IS_EOL_CHAR(text[index + 5], extra_eol)) {
+                    int i;
+
+                    for (i = 0; i < 5; i += 1) {
+                        UChar kc = text[index + i];
+
+                        if ((kc != data_kw[i]) && ((i == 4) || (kc != (data_kw[i] & ~0x20)))) {
+                            break;
+                        }
+                    }
+
+                    if (i == 5) {
+                        /* a data block header */
+                        if (count >= capacity) {
+                            segment_t *temp = (segment_t *) realloc(found, 2 * capacity * sizeof(segment_t));
+
+                            if (temp == NULL) {
+                                free(found);
+                                return CIF_MEMORY_ERROR;
+                            }
+                            found = temp;
+                            capacity *= 2;
+                        }
+                        found[count].start = text + index;
+                        found[count].line = line;
+                        count += 1;
+                    }
+                }
+            }
+        }
+
+        if (in_text) {
+            /* skip the rest of this line of the text field */
+            while ((index < length) && !IS_EOL_CHAR(text[index], extra_eol)) {
+                index += 1;
+            }
+        } else if (triple_delim != 0) {
+            if ((c == triple_delim) && (length - index >= 3) && (text[index + 1] == c) && (text[index + 2] == c)) {
+                triple_delim = 0;
+                index += 3;
+            } else {
+                index += 1;
+            }
+        } else if ((c == UCHAR_SP) || (c == UCHAR_TAB)) {
+            index += 1;
+        } else if (c == UCHAR_HASH) {
+            /* a comment runs to the end of the line */
+            while ((index < length) && !IS_EOL_CHAR(text[index], extra_eol)) {
+                index += 1;
+            }
+        } else if ((c == UCHAR_SQ) || (c == UCHAR_DQ)) {
+            if ((cif_version >= 2) && (length - index >= 3) && (text[index + 1] == c) && (text[index + 2] == c)) {
+                triple_delim = c;
+                index += 3;
+            } else {
+                /* an ordinary quoted string, which cannot span lines */
+                for (index += 1; (index < length) && !IS_EOL_CHAR(text[index], extra_eol); index += 1) {
+                    if ((text[index] == c) && ((cif_version >= 2) || (index + 1 >= length)
+                            || (text[index + 1] == UCHAR_SP) || (text[index + 1] == UCHAR_TAB)
+                            || IS_EOL_CHAR(text[index + 1], extra_eol))) {
+                        index += 1;
+                        /* skip the colon following a table key */
+                        if ((cif_version >= 2) && (index < length) && (text[index] == UCHAR_COLON)) {
+                            index += 1;
+                        }
+                        break;
+                    }
+                }
+            }
+        } else if ((cif_version >= 2) && ((c == UCHAR_OBRK) || (c == UCHAR_CBRK) || (c == UCHAR_OBRC)
+                || (c == UCHAR_CBRC))) {
+            index += 1;
+        } else {
+            /* an unquoted token */
+            for (index += 1; index < length; index += 1) {
+                UChar tc = text[index];
+
+                if ((tc == UCHAR_SP) || (tc == UCHAR_TAB) || IS_EOL_CHAR(tc, extra_eol) || ((cif_version >= 2)
+                        && ((tc == UCHAR_OBRK) || (tc == UCHAR_CBRK) || (tc == UCHAR_OBRC)
+                                || (tc == UCHAR_CBRC)))) {
+                    break;
+                }
+            }
+        }
+    }
+
+    *segments = found;
+    *segment_count = count;
+    return CIF_OK;
+}
+
+static int is_empty_handler(const cif_handler_tp *handler) {
+    return ((handler == NULL) || (
+            (handler->handle_cif_start == NULL)
+            && (handler->handle_cif_end == NULL)
+            && (handler->handle_block_start == NULL)
+            && (handler->handle_block_end == NULL)
+            && (handler->handle_frame_start == NULL)
+            && (handler->handle_frame_end == NULL)
+            && (handler->handle_loop_start == NULL)
+            && (handler->handle_loop_end == NULL)
+            && (handler->handle_packet_start == NULL)
+            && (handler->handle_packet_end == NULL)
+            && (handler->handle_item == NULL)));
+}
+
+static int parse_parallel(struct scanner_s *scanner, uchar_stream_t *ustream, struct cif_parse_opts_s *options,
+        int cif_version, int not_utf8, cif_tp *cif) {
+    FAILURE_HANDLING;
+    size_t byte_count = ustream->buffer_limit - ustream->buffer_position;
+    size_t byte_capacity = 4 * ustream->buffer_size;
+    unsigned char *bytes = (unsigned char *) malloc(byte_capacity);
+    UChar *text;
+
+    if (bytes == NULL) {
+        return CIF_MEMORY_ERROR;
+    }
+
+    /* read the whole remaining input into memory */
+    memcpy(bytes, ustream->buffer_position, byte_count);
+    while (ustream->eof_status == 0) {
+        if (byte_count == byte_capacity) {
+            unsigned char *temp = (unsigned char *) realloc(bytes, 2 * byte_capacity);
+
+            if (temp == NULL) {
+                FAIL(early, CIF_MEMORY_ERROR);
+            }
+            bytes = temp;
+            byte_capacity *= 2;
+        }
+        byte_count += fread(bytes + byte_count, 1, byte_capacity - byte_count, ustream->byte_stream);
+        if (byte_count < byte_capacity) {
+            if (ferror(ustream->byte_stream)) {
+                DEFAULT_FAIL(early);
+            }
+            ustream->eof_status = -1;
+        }
+    }
+
+    /* decode it all; there can be no more characters than there are bytes */
+    text = (UChar *) malloc((byte_count + 1) * sizeof(UChar));
+    if (text == NULL) {
+        SET_RESULT(CIF_MEMORY_ERROR);
+    } else {
+        UErrorCode icu_error_code = U_ZERO_ERROR;
+        const char *source = (const char *) bytes;
+        UChar *text_limit = text;
+
+        /* stop at any encoding error, to be handled (with position information) by a serial parse */
+        ucnv_setToUCallBack(ustream->converter, UCNV_TO_U_CALLBACK_STOP, NULL, NULL, NULL, &icu_error_code);
+        ucnv_toUnicode(ustream->converter, &text_limit, text + byte_count + 1, &source, (const char *) bytes
+                + byte_count, NULL, CIF_TRUE, &icu_error_code);
+
+        if (U_FAILURE(icu_error_code)) {
+            /* parse the raw bytes serially, from the beginning, reporting the error as usual */
+            icu_error_code = U_ZERO_ERROR;
+            ucnv_resetToUnicode(ustream->converter);
+            ucnv_setToUCallBack(ustream->converter, ustream_to_unicode_callback, scanner, NULL, NULL,
+                    &icu_error_code);
+            ustream->byte_buffer = bytes;
+            ustream->buffer_position = bytes;
+            ustream->buffer_limit = bytes + byte_count;
+            SET_RESULT(U_FAILURE(icu_error_code) ? CIF_ERROR : cif_parse_internal(scanner, not_utf8,
+                    options->extra_ws_chars, options->extra_eol_chars, cif));
+        } else {
+            parse_job_t job;
+            segment_t *segments;
+            size_t segment_count;
+
+            job.options = options;
+            job.cif_version = resolve_cif_version(text, text_limit - text, cif_version, options->extra_ws_chars,
+                    options->extra_eol_chars);
+            job.not_utf8 = not_utf8;
+            job.text_limit = text_limit;
+
+            SET_RESULT(find_segments(text, text_limit - text, job.cif_version, options->extra_eol_chars,
+                    &segments, &segment_count));
+            if (FAILURE_VARIABLE == CIF_OK) {
+                size_t worker_count = (size_t) options->max_parse_threads;
+                parse_worker_t *workers;
+
+                job.segments = segments;
+                job.segment_count = segment_count;
+
+                if (worker_count > segment_count) {
+                    worker_count = segment_count;
+                }
+
+                if ((worker_count < 2)
+                        || ((workers = (parse_worker_t *) malloc(worker_count * sizeof(parse_worker_t))) == NULL)) {
+                    /* nothing to be gained, or no resources with which to try */
+                    SET_RESULT(parse_serial_tail(&job, 0, cif_version, cif));
+                } else {
+                    pthread_t *threads = (pthread_t *) malloc(worker_count * sizeof(pthread_t));
+                    int *started = (int *) calloc(worker_count, sizeof(int));
+                    size_t resume_segment = segment_count;
+                    size_t first = 0;
+                    size_t w;
+
+                    /* assign each worker a run of consecutive segments, balancing the amount of text */
+                    for (w = 0; w < worker_count; w += 1) {
+                        size_t end;
+
+                        if (w == worker_count - 1) {
+                            end = segment_count;
+                        } else {
+                            size_t target = (text_limit - segments[first].start) / (worker_count - w);
+
+                            for (end = first + 1; (end < segment_count - (worker_count - w - 1))
+                                    && ((size_t) (segments[end].start - segments[first].start) < target); end += 1) {
+                                /* empty */
+                            }
+                        }
+
+                        workers[w].job = &job;
+                        workers[w].first_segment = first;
+                        workers[w].end_segment = end;
+                        workers[w].store = NULL;
+                        workers[w].keep_store = (cif != NULL);
+                        sprintf(workers[w].store_uri, "file:cif_parse_%p_%lu?mode=memory&cache=shared",
+                                (void *) workers, (unsigned long) w);
+                        first = end;
+                    }
+
+                    /*
+                     * the current thread serves as the first worker, and as a fallback for any that cannot start; if
+                     * the thread bookkeeping cannot be allocated then it performs all the work, serially
+                     */
+                    if ((threads != NULL) && (started != NULL)) {
+                        for (w = 1; w < worker_count; w += 1) {
+                            started[w] = (pthread_create(threads + w, NULL, parse_segments, workers + w) == 0);
+                        }
+                    }
+                    for (w = 0; w < worker_count; w += 1) {
+                        if ((started == NULL) || !started[w]) {
+                            (void) parse_segments(workers + w);
+                        }
+                    }
+                    for (w = 1; w < worker_count; w += 1) {
+                        if ((started != NULL) && started[w]) {
+                            pthread_join(threads[w], NULL);
+                        }
+                    }
+
+                    /* merge the workers' results in document order, up to the first failure */
+                    for (w = 0; w < worker_count; w += 1) {
+                        if ((workers[w].store != NULL) && (workers[w].id_limit > 0)
+                                && (cif_merge_store(cif, workers[w].store_uri, workers[w].id_limit) != CIF_OK)) {
+                            resume_segment = workers[w].first_segment;
+                            break;
+                        } else if (workers[w].failed_segment < workers[w].end_segment) {
+                            resume_segment = workers[w].failed_segment;
+                            break;
+                        }
+                    }
+
+                    for (w = 0; w < worker_count; w += 1) {
+                        if ((workers[w].store != NULL) && (cif_destroy(workers[w].store) != CIF_OK)) {
+                            /* ignore the error; the store is abandoned either way */
+                        }
+                    }
+
+                    /* re-parse serially from the first segment not successfully handled in parallel, if any */
+                    SET_RESULT((resume_segment < segment_count)
+                            ? parse_serial_tail(&job, resume_segment, cif_version, cif) : CIF_OK);
+
+                    free(started);
+                    free(threads);
+                    free(workers);
+                }
+
+                free(segments);
+            }
+        }
+
+        free(text);
+    }
+
+    FAILURE_HANDLER(early):
+    free(bytes);
+    FAILURE_TERMINUS;
+}
+
+static void *parse_segments(void *worker) {
+    parse_worker_t *w = (parse_worker_t *) worker;
+    const parse_job_t *job = w->job;
+    struct cif_parse_opts_s worker_options = *(job->options);
+    size_t seg;
+
+    /* abort at the first error of any kind; the failed segment will be re-parsed serially */
+    worker_options.error_callback = cif_parse_error_die;
+    worker_options.user_data = NULL;
+
+    w->failed_segment = w->first_segment;
+    w->id_limit = 0;
+
+    if (w->keep_store && (cif_create_internal(w->store_uri, &(w->store)) != CIF_OK)) {
+        w->store = NULL;
+        return NULL;
+    }
+
+    for (seg = w->first_segment; seg < w->end_segment; seg += 1) {
+        struct scanner_s scanner;
+        uchar_slice_t slice;
+
+        slice.next = job->segments[seg].start;
+        slice.limit = ((seg + 1 < job->segment_count) ? job->segments[seg + 1].start : job->text_limit);
+        init_scanner(&scanner, &worker_options, job->cif_version, &slice, uslice_read_chars,
+                job->segments[seg].line);
+
+        if ((cif_parse_internal(&scanner, ((seg == 0) ? job->not_utf8 : 0), worker_options.extra_ws_chars,
+                worker_options.extra_eol_chars, w->store) != CIF_OK)
+                || ((w->store != NULL) && (cif_get_max_container_id(w->store, &(w->id_limit)) != CIF_OK))) {
+            break;
+        }
+
+        w->failed_segment = seg + 1;
+    }
+
+    return NULL;
+}
+
+static int parse_serial_tail(const parse_job_t *job, size_t first_segment, int cif_version, cif_tp *cif) {
+    struct scanner_s scanner;
+    uchar_slice_t slice;
+
+    slice.next = job->segments[first_segment].start;
+    slice.limit = job->text_limit;
+
+    /* the first segment is parsed exactly as the whole input would be, so as to handle the CIF magic code */
+    init_scanner(&scanner, job->options, ((first_segment == 0) ? cif_version : job->cif_version), &slice,
+            uslice_read_chars, job->segments[first_segment].line);
+
+    return cif_parse_internal(&scanner, ((first_segment == 0) ? job->not_utf8 : 0), job->options->extra_ws_chars,
+            job->options->extra_eol_chars, cif);
+}
+#endif
+
 int cif_validate_cif11_characters(UChar *s, UChar **disallowed) {
     static int is_allowed[128];
 
@@ -642,14 +3260,14 @@ int cif_validate_cif11_characters(UChar *s, UChar **disallowed) {
     if (!is_allowed[UCHAR_SP]) {
         unsigned int i;
         for (i = 0; i < cif11_chars_elements; i += 1) {
-            assert((0 <= cif11_chars[i]) && (cif11_chars[i] < sizeof(is_allowed)));
+            assert((0 <= cif11_chars[i]) && (cif11_chars[i] < (sizeof(is_allowed) / sizeof(is_allowed[0]))));
             is_allowed[cif11_chars[i]] = 1;
         }
     }
     assert(is_allowed[UCHAR_SP]);
 
     while (*s) {
-        if ((*s >= sizeof(is_allowed)) || !is_allowed[*s]) {
+        if ((*s >= (sizeof(is_allowed) / sizeof(is_allowed[0]))) || !is_allowed[*s]) {
             if (disallowed) {
                 *disallowed = s;
             }
@@ -665,11 +3283,11 @@ int cif_validate_cif11_characters(UChar *s, UChar **disallowed) {
 }
 
 static int write_cif_start(cif_tp *cif UNUSED, void *context) {
-    int num_written = IS_CIF1(context) ? u_fprintf(CONTEXT_UFILE(context), "#\\#CIF_1.1\n")
-            : u_fprintf(CONTEXT_UFILE(context), "#\\#CIF_2.0\n");
+    const char *magic = IS_CIF1(context) ? "#\\#CIF_1.1\n" : "#\\#CIF_2.0\n";
+    int result = write_bytes(context, magic, strlen(magic));
 
     SET_LAST_COLUMN(context, 0);
-    return ((num_written > 0) ? CIF_TRAVERSE_CONTINUE : CIF_ERROR);
+    return ((result == CIF_OK) ? CIF_TRAVERSE_CONTINUE : CIF_ERROR);
 }
 
 static int write_cif_end(cif_tp *cif UNUSED, void *context) {
@@ -679,18 +3297,60 @@ static int write_cif_end(cif_tp *cif UNUSED, void *context) {
 static int write_container_start(cif_container_tp *block, void *context) {
     UChar *code;
     int result = cif_container_get_code(block, &code);
-    const char *this_header_type = header_type[(CONTEXT_DEPTH(context) == 0) ? 0 : 1];
 
-    if ((result == CIF_OK) && IS_CIF1(context)) {
-        result = cif_validate_cif11_characters(code, NULL);
+    if (result == CIF_OK) {
+        result = ((CONTEXT_SELECTION(context) != NULL) ? select_container(context, code) : CIF_TRAVERSE_CONTINUE);
+        if (result == CIF_TRAVERSE_CONTINUE) {
+            result = write_header(context, code);
+        }
+        free(code);
+    }
+    return result;
+}
+
+static int select_container(void *context, const UChar *code) {
+    const UChar **selected_codes = ((CONTEXT_DEPTH(context) == 0) ? CONTEXT_SELECTION(context)->block_codes
+            : CONTEXT_SELECTION(context)->frame_codes);
+    UChar *normalized_code;
+    int result;
+
+    if (selected_codes == NULL) {
+        return CIF_TRAVERSE_CONTINUE;
+    }
+
+    result = cif_normalize_name(code, -1, &normalized_code, CIF_INVALID_BLOCKCODE);
+    if (result == CIF_OK) {
+        result = CIF_TRAVERSE_SKIP_CURRENT;
+        for (; (result == CIF_TRAVERSE_SKIP_CURRENT) && (*selected_codes != NULL); selected_codes += 1) {
+            UChar *normalized_selection;
+
+            /* a selected code that is not a valid code can match nothing */
+            if (cif_normalize_name(*selected_codes, -1, &normalized_selection, CIF_INVALID_BLOCKCODE) == CIF_OK) {
+                if (u_strcmp(normalized_code, normalized_selection) == 0) {
+                    result = CIF_TRAVERSE_CONTINUE;
+                }
+                free(normalized_selection);
+            }
+        }
+        free(normalized_code);
     }
+
+    return result;
+}
+
+static int write_header(void *context, const UChar *code) {
+    const char *this_header_type = header_type[(CONTEXT_DEPTH(context) == 0) ? 0 : 1];
+    int result = (IS_CIF1(context) ? cif_validate_cif11_characters((UChar *) code, NULL) : CIF_OK);
+
     if (result == CIF_OK) {
-        result = ((u_fprintf(CONTEXT_UFILE(context), this_header_type, code) > 7) ? CIF_TRAVERSE_CONTINUE : CIF_ERROR);
+        result = (((write_bytes(context, this_header_type, HEADER_TYPE_LENGTH) == CIF_OK)
+                        && (write_uchars(context, code, -1) == CIF_OK)
+                        && (write_bytes(context, "\n", 1) == CIF_OK))
+                ? CIF_TRAVERSE_CONTINUE : CIF_ERROR);
         SET_LAST_COLUMN(context, 0);
         if (result == CIF_TRAVERSE_CONTINUE) {
             CONTEXT_INC_DEPTH(context, 1);
         }
-        free(code);
     }
     return result;
 }
@@ -701,7 +3361,7 @@ static int write_container_end(cif_container_tp *block UNUSED, void *context) {
     if (CONTEXT_DEPTH(context) == 0) {
         return (write_newline(context) ? CIF_TRAVERSE_CONTINUE : CIF_ERROR);
     } else {
-        return ((u_fprintf(CONTEXT_UFILE(context), "\nsave_\n") > 6) ? CIF_TRAVERSE_CONTINUE : CIF_ERROR);
+        return ((write_bytes(context, "\nsave_\n", 7) == CIF_OK) ? CIF_TRAVERSE_CONTINUE : CIF_ERROR);
     }
 }
 
@@ -709,56 +3369,143 @@ static int write_loop_start(cif_loop_tp *loop, void *context) {
     UChar *category;
     int result;
 
+    ((CONTEXT_T) context)->aligned_columns = 0;
+    ((CONTEXT_T) context)->packet_column = 0;
+
     result = cif_loop_get_category(loop, &category);
     if (result == CIF_OK) {
-        if ((category != NULL) && (u_strcmp(category, CIF_SCALARS) == 0)) {
+        int is_scalars = ((category != NULL) && (u_strcmp(category, CIF_SCALARS) == 0));
+
+        if (is_scalars && !SELECTS_NAMES(context)) {
             /* the scalar loop for this container */
-            if (write_newline(context)) {
-                SET_WRITE_ITEM_NAMES(context, CIF_TRUE);
-                result = CIF_TRAVERSE_CONTINUE;
-            } else {
-                result = CIF_ERROR;
+            result = write_scalars_start(context);
+        } else {
+            /* an ordinary loop, or a scalar loop from which only some items may be selected */
+            UChar **item_names;
+
+            result = cif_loop_get_names(loop, &item_names);
+            if (result == CIF_OK) {
+                UChar **next_name;
+
+                if (SELECTS_NAMES(context)) {
+                    select_names(context, item_names);
+                }
+                if (*item_names == NULL) {
+                    /* nothing in this loop is selected, so its packets need not be read */
+                    result = CIF_TRAVERSE_SKIP_CURRENT;
+                } else if (is_scalars) {
+                    result = write_scalars_start(context);
+                } else {
+                    result = write_loop_header(context, (const UChar * const *) item_names);
+                    if ((result == CIF_TRAVERSE_CONTINUE) && IS_ALIGN_LOOPS(context)) {
+                        result = align_columns(context, loop, (const UChar * const *) item_names);
+                    }
+                }
+
+                /* need to free all item names even after an error is detected */
+                for (next_name = item_names; *next_name != NULL; next_name += 1) {
+                    free(*next_name);
+                }
+                free(item_names);
             }
+        }
+    }
+
+    free(category);
+
+    return result;
+}
+
+static int align_columns(void *context, cif_loop_tp *loop, const UChar * const *names) {
+    CONTEXT_T c = (CONTEXT_T) context;
+    size_t count;
+    size_t index;
+    size_t start = 0;
+    int result;
+
+    for (count = 0; names[count] != NULL; count += 1) ;
+    if (count > c->column_capacity) {
+        size_t *temp = (size_t *) realloc(c->column_starts, count * sizeof(size_t));
+
+        if (temp == NULL) {
+            return CIF_MEMORY_ERROR;
+        }
+        c->column_starts = temp;
+        c->column_capacity = count;
+    }
+
+    result = cif_loop_get_widths_internal(loop, names, (IS_CIF1(context) ? 1 : 2), c->column_starts);
+    if (result != CIF_OK) {
+        return result;
+    }
+
+    /* convert the widths to starting columns, for as many columns as fit on one line */
+    for (index = 0; index < count; index += 1) {
+        size_t width = c->column_starts[index];
+
+        if ((start + width) > (size_t) LINE_LENGTH(context)) {
+            break;
+        }
+        c->column_starts[index] = start;
+        start += width + 1;
+    }
+    c->aligned_columns = index;
+
+    return CIF_TRAVERSE_CONTINUE;
+}
+
+static void select_names(void *context, UChar **names) {
+    UChar **next_name;
+    UChar **next_selected = names;
+
+    for (next_name = names; *next_name != NULL; next_name += 1) {
+        if (cif_name_selected_internal(CONTEXT_SELECTION(context)->include_names,
+                CONTEXT_SELECTION(context)->exclude_names, *next_name, -1)) {
+            *next_selected = *next_name;
+            next_selected += 1;
         } else {
-            /* an ordinary loop */
-            SET_WRITE_ITEM_NAMES(context, CIF_FALSE);
+            free(*next_name);
+        }
+    }
+    *next_selected = NULL;
+}
+
+static int write_scalars_start(void *context) {
+    if (write_newline(context)) {
+        SET_WRITE_ITEM_NAMES(context, CIF_TRUE);
+        return CIF_TRAVERSE_CONTINUE;
+    } else {
+        return CIF_ERROR;
+    }
+}
 
-            /* write a loop header */
-            if (u_fprintf(CONTEXT_UFILE(context), "\nloop_\n") > 6) {
-                UChar **item_names;
+static int write_loop_header(void *context, const UChar * const *names) {
+    const UChar * const *next_name;
 
-                SET_LAST_COLUMN(context, 0);
-                result = cif_loop_get_names(loop, &item_names);
-                if (result == CIF_OK) {
-                    UChar **next_name;
+    SET_WRITE_ITEM_NAMES(context, CIF_FALSE);
+    if (write_bytes(context, "\nloop_\n", 7) != CIF_OK) {
+        return CIF_ERROR;
+    }
+    SET_LAST_COLUMN(context, 0);
 
-                    assert(CIF_TRAVERSE_CONTINUE == CIF_OK);
-                    for (next_name = item_names; *next_name != NULL; next_name += 1) {
-                        if ((result == CIF_TRAVERSE_CONTINUE) && IS_CIF1(context)) {
-                            result = cif_validate_cif11_characters(*next_name, NULL);
-                        }
-                        if (result == CIF_TRAVERSE_CONTINUE) {
-                            if (u_fprintf(CONTEXT_UFILE(context), " %S\n", *next_name) < 4) {
-                                result = CIF_ERROR;
-                            }
-                            SET_LAST_COLUMN(context, 0);
-                        }
-                        /* need to free all item names even after an error is detected */
-                        free(*next_name);
-                    }
+    for (next_name = names; *next_name != NULL; next_name += 1) {
+        if (IS_CIF1(context)) {
+            int result = cif_validate_cif11_characters((UChar *) *next_name, NULL);
 
-                    /* always need to free the item name array itself */
-                    free(item_names);
-                }
-            } else {
-                result = CIF_ERROR;
+            if (result != CIF_OK) {
+                return result;
             }
         }
+        if ((write_bytes(context, " ", 1) != CIF_OK)
+                || (write_uchars(context, *next_name, -1) != CIF_OK)
+                || (write_bytes(context, "\n", 1) != CIF_OK)) {
+            return CIF_ERROR;
+        }
+        SET_LAST_COLUMN(context, 0);
     }
 
-    free(category);
-
-    return result;
+    assert(CIF_TRAVERSE_CONTINUE == CIF_OK);
+    return CIF_TRAVERSE_CONTINUE;
 }
 
 static int write_loop_end(cif_loop_tp *loop UNUSED, void *context) {
@@ -771,6 +3518,7 @@ static int write_packet_start(cif_packet_tp *packet UNUSED, void *context UNUSED
 }
 
 static int write_packet_end(cif_packet_tp *packet UNUSED, void *context) {
+    ((CONTEXT_T) context)->packet_column = 0;
     return (write_newline(context) ? CIF_TRAVERSE_CONTINUE : CIF_ERROR);
 }
 
@@ -778,6 +3526,32 @@ static int write_item(UChar *name, cif_value_tp *value, void *context) {
     FAILURE_HANDLING;
     int temp;
 
+    /* omit the items of unselected loop columns and scalars; they are read from the CIF regardless */
+    if ((name != NULL) && SELECTS_NAMES(context) && !cif_name_selected_internal(
+            CONTEXT_SELECTION(context)->include_names, CONTEXT_SELECTION(context)->exclude_names, name, -1)) {
+        return CIF_TRAVERSE_CONTINUE;
+    }
+
+    /* pad a loop value out to the start of its column if the loop is aligned */
+    if ((name != NULL) && !IS_WRITE_ITEM_NAMES(context)) {
+        CONTEXT_T c = (CONTEXT_T) context;
+
+        /* a multi-line value starts a new line anyway, and is not padded */
+        if ((c->packet_column < c->aligned_columns) && ((value->kind != CIF_CHAR_KIND)
+                || (u_strchr(value->as_char.text, UCHAR_NL) == NULL))) {
+            size_t column = (size_t) LAST_COLUMN(context);
+            size_t target = c->column_starts[c->packet_column];
+
+            /* the separating space written below counts toward the padding */
+            if ((column > 0) && (target > column + 1) && !write_padding(context, target - column - 1)) {
+                FAIL(soft, CIF_ERROR);
+            } else if ((column == 0) && (target > 0) && !write_padding(context, target)) {
+                FAIL(soft, CIF_ERROR);
+            }
+        }
+        c->packet_column += 1;
+    }
+
     /* output the data name if the context so indicates */
     if (IS_WRITE_ITEM_NAMES(context)) {
         if (IS_CIF1(context)) {
@@ -950,55 +3724,59 @@ static int write_table(void *context, cif_value_tp *table_value) {
 }
 
 static int write_char(void *context, cif_value_tp *char_value, int allow_text) {
+    /* numbers are written via this function, too, when they are quoted; their text is in the same place */
+    const UChar *text = char_value->as_char.text;
+    /* the class recorded when a character value was stored, if any, spares rescanning the text */
+    int text_class = (((char_value->kind == CIF_CHAR_KIND) && (char_value->as_char.text_class != 0))
+            ? char_value->as_char.text_class : cif_text_class_internal(text));
+    int32_t length;
+    int32_t first_line;
+    int32_t last_line;
+    UChar *text_copy;
     int result;
-    UChar *text;
-
-    if (cif_value_get_text(char_value, &text) == CIF_OK) {
-        struct cif_string_analysis_s analysis;
-        /* extra_space accounts for space consumed by preceding output that must not be separated from the current */
-        /* int32_t extra_space = (IS_SEPARATE_VALUES(context) ? 0 : LAST_COLUMN(context)); */
 
-        if ((!IS_CIF1(context) || ((result = cif_validate_cif11_characters(text, NULL)) == CIF_OK))
-                && ((result = cif_analyze_string(text, !cif_value_is_quoted(char_value), !IS_CIF1(context),
-                        LINE_LENGTH(context), &analysis)) == CIF_OK)
-                ) {
+    if (IS_CIF1(context) && !(text_class & TEXT_CLASS_CIF11)) {
+        return CIF_DISALLOWED_CHAR;
+    }
 
-            switch(analysis.delim_length) {
-                case 0: /* whitespace-delimited */
-                    assert(analysis.delim[0] == 0);
-                    result = write_unquoted(context, text, analysis.length_max);
-                    break;
-                case 1: /* single-quoted */
-                    assert(analysis.delim[0] == UCHAR_SQ || analysis.delim[0] == UCHAR_DQ);
-                    result = write_quoted(context, text, analysis.length, analysis.delim[0]);
-                    break;
-                case 3: /* triple-quoted */
-                    assert(analysis.delim[0] == UCHAR_SQ || analysis.delim[0] == UCHAR_DQ);
-                    result = write_triple_quoted(context, text, analysis.length_first + 3, analysis.length_last, analysis.delim[0]);
-                    break;
-                case 2: /* text field */
-                    assert(analysis.delim[0] == UCHAR_NL);
-                    /* XXX: should really flag more specifically for whether prefixing is enabled */
-                    if (!allow_text || (analysis.contains_text_delim && IS_CIF1(context))) {
-                        result = CIF_DISALLOWED_VALUE;
-                    } else {
-                        /* write as a text block, possibly with line-folding and/or prefixing  */
-                        result = write_text(context, text, analysis.length,
-                                ((analysis.length_first >= LINE_LENGTH(context))
-                                        || (analysis.length_max > LINE_LENGTH(context))
-                                        || analysis.has_reserved_start
-                                        || (analysis.max_semi_run >= (LINE_LENGTH(context) - 1))),
-                                analysis.contains_text_delim);
-                    }
-                    break;
-                default: /* unexpected value */
-                    result = CIF_INTERNAL_ERROR;
-                    break;
+    length = u_strlen(text);
+    switch (((text_class & TEXT_CLASS_BARE) && !cif_value_is_quoted(char_value))
+            ? TEXT_DELIM_NONE : TEXT_CLASS_DELIM(text_class, IS_CIF1(context))) {
+        case TEXT_DELIM_NONE: /* whitespace-delimited */
+            result = write_unquoted(context, text, length);
+            break;
+        case TEXT_DELIM_APOS: /* single-quoted */
+            result = write_quoted(context, text, length, UCHAR_SQ);
+            break;
+        case TEXT_DELIM_QUOT:
+            result = write_quoted(context, text, length, UCHAR_DQ);
+            break;
+        case TEXT_DELIM_APOS3: /* triple-quoted */
+        case TEXT_DELIM_QUOT3:
+            /* the first and last lines are delimited by any of the line terminators */
+            for (first_line = 0; (first_line < length) && (text[first_line] != UCHAR_NL)
+                    && (text[first_line] != UCHAR_CR); first_line += 1) ;
+            for (last_line = 0; (last_line < length) && (text[length - last_line - 1] != UCHAR_NL)
+                    && (text[length - last_line - 1] != UCHAR_CR); last_line += 1) ;
+            result = write_triple_quoted(context, text, first_line, last_line,
+                    ((TEXT_CLASS_DELIM(text_class, IS_CIF1(context)) == TEXT_DELIM_APOS3) ? UCHAR_SQ : UCHAR_DQ));
+            break;
+        case TEXT_DELIM_TEXT_FIELD:
+            /* XXX: should really flag more specifically for whether prefixing is enabled */
+            if (!allow_text || ((text_class & TEXT_CLASS_TEXT_DELIM) && IS_CIF1(context))) {
+                result = CIF_DISALLOWED_VALUE;
+            } else if ((text_copy = cif_u_strdup(text)) == NULL) {
+                result = CIF_MEMORY_ERROR;
+            } else {
+                /* write as a text block, possibly with line-folding and/or prefixing  */
+                result = write_text(context, text_copy, length, ((text_class & TEXT_CLASS_FOLD) != 0),
+                        ((text_class & TEXT_CLASS_TEXT_DELIM) != 0));
+                free(text_copy);
             }
-        }
-        free(text);
-    } else {
-        result = CIF_ERROR;
+            break;
+        default: /* unexpected value */
+            result = CIF_INTERNAL_ERROR;
+            break;
     }
 
     return result;
@@ -1019,10 +3797,6 @@ static int write_char(void *context, cif_value_tp *char_value, int allow_text) {
  * @param[in] prefix if true, the prefix protocol should be applied to the block contents
  */
 static int write_text(void *context, UChar *text, int32_t length, int fold, int prefix) {
-    /* TODO: test on text containing surrogate pairs -- the expected lengths may be wrong */
-    int expected = 2 + (prefix ? (PREFIX_LENGTH + 1) : 0) + (fold ? 1 : 0);
-    int32_t nchars;
-
     /*
      * This function is assumed to be called only for data that cannot be represented in other forms.  In particular,
      * it is assumed not to be called for an empty string (for which this implementation would do the wrong thing).
@@ -1030,15 +3804,16 @@ static int write_text(void *context, UChar *text, int32_t length, int fold, int
     assert(*text);
 
     /* opening delimiter and flags */
-    nchars = u_fprintf(CONTEXT_UFILE(context), "\n;%s%s", (prefix ? PREFIX "\\" : ""), (fold ? "\\" : ""));
-    if (nchars != expected) {
+    if ((write_bytes(context, "\n;", 2) != CIF_OK)
+            || (prefix && (write_bytes(context, PREFIX "\\", PREFIX_LENGTH + 1) != CIF_OK))
+            || (fold && (write_bytes(context, "\\", 1) != CIF_OK))) {
         return CIF_ERROR;
     }
 
     /* body */
     if (!fold && !prefix) {
         /* shortcut when neither line-folding nor prefixing: */
-        if (u_fprintf(CONTEXT_UFILE(context), "%S", text) != length) {
+        if (write_uchars(context, text, length) != CIF_OK) {
             return CIF_ERROR;
         }
     } else {
@@ -1063,7 +3838,7 @@ static int write_text(void *context, UChar *text, int32_t length, int fold, int
 
             /* special handling is required for empty lines */
             if (*next_tok == UCHAR_NL) {
-                if (u_fputc(UCHAR_NL, CONTEXT_UFILE(context)) != UCHAR_NL) {
+                if (write_bytes(context, "\n", 1) != CIF_OK) {
                     return CIF_ERROR;
                 } else {
                     next_tok += 1;
@@ -1107,10 +3882,10 @@ static int write_text(void *context, UChar *text, int32_t length, int fold, int
                     return CIF_INTERNAL_ERROR;
                 }
 
-                expected = 1 + prefix_chars + len;
-                nchars = u_fprintf(CONTEXT_UFILE(context), "\n%s%*.*S%s", prefix_text, len, len, tok,
-                        ((tok[len] || protect) ? (expected += 1, "\\") : ""));
-                if (nchars != expected) {
+                if ((write_bytes(context, "\n", 1) != CIF_OK)
+                        || (write_bytes(context, prefix_text, prefix_chars) != CIF_OK)
+                        || (write_uchars(context, tok, len) != CIF_OK)
+                        || ((tok[len] || protect) && (write_bytes(context, "\\", 1) != CIF_OK))) {
                     return CIF_ERROR;
                 }
                 if (!tok[len]) {
@@ -1120,14 +3895,14 @@ static int write_text(void *context, UChar *text, int32_t length, int fold, int
                 tok += len;
             }
 
-            if (protect && (u_fputc(UCHAR_NL, CONTEXT_UFILE(context)) != UCHAR_NL)) {
+            if (protect && (write_bytes(context, "\n", 1) != CIF_OK)) {
                 return CIF_ERROR;
             }
         }
     }
 
     /* closing delimiter */
-    if (u_fprintf(CONTEXT_UFILE(context), "\n;") != 2) {
+    if (write_bytes(context, "\n;", 2) != CIF_OK) {
         return CIF_ERROR;
     }
     SET_LAST_COLUMN(context, 1);
@@ -1216,7 +3991,6 @@ static int write_unquoted(void *context, const UChar *text, int32_t length) {
 }
 
 static int write_quoted(void *context, const UChar *text, int32_t length, char delimiter) {
-    int32_t nchars;
     int last_column = LAST_COLUMN(context);
 
     if ((last_column + length + 2) > LINE_LENGTH(context)) {
@@ -1227,35 +4001,46 @@ static int write_quoted(void *context, const UChar *text, int32_t length, char d
         }
     }
 
-    nchars = u_fprintf(CONTEXT_UFILE(context), "%c%*.*S%c", delimiter, length, length, text, delimiter);
+    if ((write_bytes(context, &delimiter, 1) != CIF_OK)
+            || (write_uchars(context, text, length) != CIF_OK)
+            || (write_bytes(context, &delimiter, 1) != CIF_OK)) {
+        return CIF_ERROR;
+    }
 
-    SET_LAST_COLUMN(context, last_column + nchars);
+    SET_LAST_COLUMN(context, last_column + length + 2);
 
-    return (nchars == (length + 2)) ? CIF_OK : CIF_ERROR;
+    return CIF_OK;
 }
 
 static int write_triple_quoted(void *context, const UChar *text, int32_t line1_length, int32_t last_line_length,
         char delimiter) {
-    int32_t nchars;
+    char delimiters[3];
     int last_column = LAST_COLUMN(context);
 
-    if ((last_column + line1_length + 3) > LINE_LENGTH(context)) {
+    /* room is reserved for both delimiters, as if the first line were also the last */
+    if ((last_column + line1_length + 6) > LINE_LENGTH(context)) {
         if (write_newline(context)) {
             last_column = 0;
         } else {
             return CIF_ERROR;
         }
     } else if (text[line1_length]) {
-        assert(text[line1_length] == '\n');
+        assert((text[line1_length] == '\n') || (text[line1_length] == '\r'));
         last_column = 0;  /* as-of before writing the last line */
     }
 
-    nchars = u_fprintf(CONTEXT_UFILE(context), "%c%c%c%S%c%c%c", delimiter, delimiter, delimiter,
-            text, delimiter, delimiter, delimiter);
+    delimiters[0] = delimiter;
+    delimiters[1] = delimiter;
+    delimiters[2] = delimiter;
+    if ((write_bytes(context, delimiters, 3) != CIF_OK)
+            || (write_uchars(context, text, -1) != CIF_OK)
+            || (write_bytes(context, delimiters, 3) != CIF_OK)) {
+        return CIF_ERROR;
+    }
 
     SET_LAST_COLUMN(context, last_column + last_line_length + 3);
 
-    return (nchars >= (line1_length + 6)) ? CIF_OK : CIF_ERROR;
+    return CIF_OK;
 }
 
 static int write_numb(void *context, cif_value_tp *numb_value) {
@@ -1302,7 +4087,6 @@ static int32_t write_literal(void *context, const char *text, int length, int wr
         return 0;
     } else {
         int last_column = LAST_COLUMN(context);
-        int32_t nchars;
 
         if ((length + last_column) > LINE_LENGTH(context)) {
             if (wrap) {
@@ -1317,12 +4101,12 @@ static int32_t write_literal(void *context, const char *text, int length, int wr
             }
         }
 
-        nchars = u_fprintf(CONTEXT_UFILE(context), "%*.*s", length, length, text);
-        if (nchars > 0) {
-            SET_LAST_COLUMN(context, last_column + nchars);
+        if (write_bytes(context, text, length) != CIF_OK) {
+            return -CIF_ERROR;
         }
+        SET_LAST_COLUMN(context, last_column + length);
 
-        return nchars;
+        return length;
     }
 }
 
@@ -1346,15 +4130,17 @@ static int32_t write_literal(void *context, const char *text, int length, int wr
  *        @li @c -CIF_ERROR for most other failures
  */
 static int32_t write_uliteral(void *context, const UChar *text, int length, int wrap) {
+    int32_t units = length;
+
     if (length < 0) {
-        length = u_countChar32(text, -1);
+        units = u_strlen(text);
+        length = u_countChar32(text, units);
     }
 
     if (length == 0) {
         return 0;
     } else {
         int last_column = LAST_COLUMN(context);
-        int32_t nchars;
 
         if ((length + last_column) > LINE_LENGTH(context)) {
             if (wrap == CIF_WRAP) {
@@ -1368,20 +4154,483 @@ static int32_t write_uliteral(void *context, const UChar *text, int length, int
             }
         }
 
-        nchars = u_fprintf(CONTEXT_UFILE(context), "%*.*S", length, length, text);
-        if (nchars > 0) {
-            SET_LAST_COLUMN(context, last_column + nchars);
+        if (write_uchars(context, text, units) != CIF_OK) {
+            return -CIF_ERROR;
+        }
+        SET_LAST_COLUMN(context, last_column + length);
+
+        return length;
+    }
+}
+
+static int write_json_cif_start(cif_tp *cif UNUSED, void *context) {
+    static const char header[] = "{\n  \"CIF-JSON\": {\n    \"Metadata\": {\n"
+            "      \"cif-version\": \"2.0\",\n"
+            "      \"schema-name\": \"CIF-JSON\",\n"
+            "      \"schema-version\": \"1.0.0\",\n"
+            "      \"schema-uri\": \"http://www.iucr.org/resources/cif/cif-json.json\"\n"
+            "    }";
+    CONTEXT_T c = (CONTEXT_T) context;
+
+    /* the data blocks follow the metadata as members of the "CIF-JSON" object */
+    c->json_level = 2;
+    c->json_separate = CIF_TRUE;
+
+    return ((write_bytes(context, header, sizeof(header) - 1) == CIF_OK) ? CIF_TRAVERSE_CONTINUE : CIF_ERROR);
+}
+
+static int write_json_cif_end(cif_tp *cif UNUSED, void *context) {
+    int result = close_json_object(context);
+
+    if (result == CIF_OK) {
+        result = close_json_object(context);
+    }
+
+    return (((result == CIF_OK) && (write_bytes(context, "\n", 1) == CIF_OK)) ? CIF_TRAVERSE_CONTINUE : CIF_ERROR);
+}
+
+static int write_json_container_start(cif_container_tp *container, void *context) {
+    static const UChar frames_key[7] = { 'F', 'r', 'a', 'm', 'e', 's', 0 };
+    CONTEXT_T c = (CONTEXT_T) context;
+    UChar *code;
+    int result = cif_container_get_code(container, &code);
+
+    if (result == CIF_OK) {
+        result = ((CONTEXT_SELECTION(context) != NULL) ? select_container(context, code) : CIF_TRAVERSE_CONTINUE);
+        if (result == CIF_TRAVERSE_CONTINUE) {
+            /* the save frames of a container are members of its "Frames" object, opened with the first of them */
+            if ((CONTEXT_DEPTH(context) > 0) && !c->json_frames) {
+                result = open_json_object(context, frames_key);
+            }
+            if (result == CIF_OK) {
+                result = open_json_object(context, code);
+            }
+            if (result == CIF_OK) {
+                c->json_frames = CIF_FALSE;
+                CONTEXT_INC_DEPTH(context, 1);
+            }
+        }
+        free(code);
+    }
+
+    return result;
+}
+
+static int write_json_container_end(cif_container_tp *container UNUSED, void *context) {
+    CONTEXT_T c = (CONTEXT_T) context;
+    int result = (c->json_frames ? close_json_object(context) : CIF_OK);
+
+    if (result == CIF_OK) {
+        result = close_json_object(context);
+    }
+    CONTEXT_INC_DEPTH(context, -1);
+
+    /* a save frame just ended, so the enclosing container's "Frames" object is open */
+    c->json_frames = (CONTEXT_DEPTH(context) > 0);
+
+    return result;
+}
+
+static int write_json_loop_start(cif_loop_tp *loop, void *context) {
+    CONTEXT_T c = (CONTEXT_T) context;
+    int result = CIF_OK;
+
+    /* the walker presents any save frames before the loops of their container */
+    if (c->json_frames) {
+        result = close_json_object(context);
+        c->json_frames = CIF_FALSE;
+    }
+
+    if (result == CIF_OK) {
+        c->json_column = JSON_NO_COLUMN;
+        result = cif_loop_walk_columns_internal(loop, write_json_column_value, context);
+        if ((result == CIF_OK) && (c->json_column == JSON_COLUMN_OPEN)) {
+            result = write_bytes(context, "]", 1);
+        }
+    }
+
+    /* the loop has been written in full */
+    return ((result == CIF_OK) ? CIF_TRAVERSE_SKIP_CURRENT : result);
+}
+
+static int write_json_column_value(void *context, const UChar *name, cif_value_tp *value) {
+    CONTEXT_T c = (CONTEXT_T) context;
+    int result;
+
+    if (name != NULL) {
+        /* the first value of a new column */
+        if ((c->json_column == JSON_COLUMN_OPEN) && (write_bytes(context, "]", 1) != CIF_OK)) {
+            return CIF_ERROR;
+        } else if (SELECTS_NAMES(context) && !cif_name_selected_internal(CONTEXT_SELECTION(context)->include_names,
+                CONTEXT_SELECTION(context)->exclude_names, name, -1)) {
+            c->json_column = JSON_COLUMN_SKIPPED;
+            return CIF_OK;
+        } else if (((result = write_json_key(context, name)) != CIF_OK)
+                || ((result = write_bytes(context, "[", 1)) != CIF_OK)) {
+            return result;
+        }
+        c->json_column = JSON_COLUMN_OPEN;
+    } else if (c->json_column == JSON_COLUMN_SKIPPED) {
+        return CIF_OK;
+    } else if ((result = write_bytes(context, ", ", 2)) != CIF_OK) {
+        return result;
+    }
+
+    return write_json_value(context, value);
+}
+
+static int write_json_key(void *context, const UChar *key) {
+    static const char indent[] = "                ";
+    CONTEXT_T c = (CONTEXT_T) context;
+    size_t count = 2 * (size_t) c->json_level;
+
+    if (write_bytes(context, (c->json_separate ? ",\n" : "\n"), (c->json_separate ? 2 : 1)) != CIF_OK) {
+        return CIF_ERROR;
+    }
+    for (; count > (sizeof(indent) - 1); count -= (sizeof(indent) - 1)) {
+        if (write_bytes(context, indent, sizeof(indent) - 1) != CIF_OK) {
+            return CIF_ERROR;
+        }
+    }
+    c->json_separate = CIF_TRUE;
+
+    return (((write_bytes(context, indent, count) == CIF_OK) && (write_json_string(context, key) == CIF_OK)
+            && (write_bytes(context, ": ", 2) == CIF_OK)) ? CIF_OK : CIF_ERROR);
+}
+
+static int open_json_object(void *context, const UChar *key) {
+    CONTEXT_T c = (CONTEXT_T) context;
+    int result = write_json_key(context, key);
+
+    if ((result == CIF_OK) && ((result = write_bytes(context, "{", 1)) == CIF_OK)) {
+        c->json_level += 1;
+        c->json_separate = CIF_FALSE;
+    }
+
+    return result;
+}
+
+static int close_json_object(void *context) {
+    static const char indent[] = "                ";
+    CONTEXT_T c = (CONTEXT_T) context;
+    size_t count;
+
+    c->json_level -= 1;
+    if (!c->json_separate) {
+        /* the object is empty */
+        c->json_separate = CIF_TRUE;
+        return write_bytes(context, "}", 1);
+    }
+    if (write_bytes(context, "\n", 1) != CIF_OK) {
+        return CIF_ERROR;
+    }
+    for (count = 2 * (size_t) c->json_level; count > (sizeof(indent) - 1); count -= (sizeof(indent) - 1)) {
+        if (write_bytes(context, indent, sizeof(indent) - 1) != CIF_OK) {
+            return CIF_ERROR;
+        }
+    }
+
+    return (((write_bytes(context, indent, count) == CIF_OK) && (write_bytes(context, "}", 1) == CIF_OK))
+            ? CIF_OK : CIF_ERROR);
+}
+
+static int write_json_value(void *context, cif_value_tp *value) {
+    size_t count;
+    size_t index;
+    int result;
+
+    switch (value->kind) {
+        case CIF_CHAR_KIND:
+            return write_json_string(context, value->as_char.text);
+        case CIF_NUMB_KIND:
+            /* numbers read from a managed CIF always have text */
+            return ((value->as_numb.text == NULL) ? CIF_INTERNAL_ERROR
+                    : write_json_string(context, value->as_numb.text));
+        case CIF_LIST_KIND:
+            if (cif_value_get_element_count(value, &count) != CIF_OK) {
+                return CIF_INTERNAL_ERROR;
+            } else if (write_bytes(context, "[", 1) != CIF_OK) {
+                return CIF_ERROR;
+            }
+            for (index = 0; index < count; index += 1) {
+                cif_value_tp *element;
+
+                if (cif_value_get_element_at(value, index, &element) != CIF_OK) {
+                    return CIF_INTERNAL_ERROR;
+                } else if ((index > 0) && (write_bytes(context, ", ", 2) != CIF_OK)) {
+                    return CIF_ERROR;
+                } else if ((result = write_json_value(context, element)) != CIF_OK) {
+                    return result;
+                }
+            }
+            return write_bytes(context, "]", 1);
+        case CIF_TABLE_KIND:
+            {
+                const UChar **keys;
+                const UChar **key;
+
+                if ((result = cif_value_get_keys(value, &keys)) != CIF_OK) {
+                    return result;
+                }
+                result = write_bytes(context, "{", 1);
+                for (key = keys; (result == CIF_OK) && (*key != NULL); key += 1) {
+                    cif_value_tp *item;
+
+                    if (cif_value_get_item_by_key(value, *key, &item) != CIF_OK) {
+                        result = CIF_INTERNAL_ERROR;
+                    } else if (((key > keys) && (write_bytes(context, ", ", 2) != CIF_OK))
+                            || (write_json_string(context, *key) != CIF_OK)
+                            || (write_bytes(context, ": ", 2) != CIF_OK)) {
+                        result = CIF_ERROR;
+                    } else {
+                        result = write_json_value(context, item);
+                    }
+                }
+                /* free only the key array, not the individual keys, as required by cif_value_get_keys() */
+                free(keys);
+
+                return ((result == CIF_OK) ? write_bytes(context, "}", 1) : result);
+            }
+        case CIF_NA_KIND:
+            return write_bytes(context, "null", 4);
+        case CIF_UNK_KIND:
+            return write_bytes(context, "\"\\\\?\"", 5);
+        default:
+            return CIF_INTERNAL_ERROR;
+    }
+}
+
+static int write_json_string(void *context, const UChar *text) {
+    static const char hex_digits[] = "0123456789abcdef";
+    const UChar *run = text;
+
+    if (write_bytes(context, "\"", 1) != CIF_OK) {
+        return CIF_ERROR;
+    }
+
+    for (;; text += 1) {
+        UChar c = *text;
+
+        if ((c == 0) || (c == UCHAR_DQ) || (c == UCHAR_BSL) || (c < 0x20)) {
+            char escape[7] = "\\u00";
+            size_t escape_length = 2;
+
+            /* the characters needing no escape are written in runs */
+            if ((text > run) && (write_uchars(context, run, (int32_t) (text - run)) != CIF_OK)) {
+                return CIF_ERROR;
+            } else if (c == 0) {
+                break;
+            }
+            run = text + 1;
+
+            switch (c) {
+                case UCHAR_DQ:
+                case UCHAR_BSL:
+                    escape[1] = (char) c;
+                    break;
+                case UCHAR_NL:
+                    escape[1] = 'n';
+                    break;
+                case UCHAR_CR:
+                    escape[1] = 'r';
+                    break;
+                case UCHAR_TAB:
+                    escape[1] = 't';
+                    break;
+                default:
+                    escape[4] = hex_digits[(c >> 4) & 0xf];
+                    escape[5] = hex_digits[c & 0xf];
+                    escape_length = 6;
+                    break;
+            }
+            if (write_bytes(context, escape, escape_length) != CIF_OK) {
+                return CIF_ERROR;
+            }
         }
+    }
+
+    return write_bytes(context, "\"", 1);
+}
+
+static int write_padding(void *context, size_t count) {
+    static const char spaces[] = "                                ";
+
+    while (count > 0) {
+        int length = (int) ((count < (sizeof(spaces) - 1)) ? count : (sizeof(spaces) - 1));
 
-        return nchars;
+        if (write_literal(context, spaces, length, CIF_NOWRAP) != length) {
+            return CIF_FALSE;
+        }
+        count -= (size_t) length;
     }
+
+    return CIF_TRUE;
 }
 
 static int write_newline(void *context) {
-    if (u_fputc('\n', CONTEXT_UFILE(context)) == '\n') {
+    if (write_bytes(context, "\n", 1) == CIF_OK) {
         SET_LAST_COLUMN(context, 0);
         return CIF_TRUE;
     } else {
         return CIF_FALSE;
     }
 }
+
+static int write_bytes(void *context, const char *bytes, size_t count) {
+    write_buffer_t *buffer = CONTEXT_BUFFER(context);
+
+    if (count > (buffer->capacity - buffer->used)) {
+        int result = flush_write_buffer(buffer, count);
+
+        if (result != CIF_OK) {
+            return result;
+        } else if (count > buffer->capacity) {
+            /* too big to buffer at all; only possible when there is a sink */
+            return ((buffer->sink(buffer->sink_context, bytes, count) == 0) ? CIF_OK : CIF_ERROR);
+        }
+    }
+    memcpy(buffer->data + buffer->used, bytes, count);
+    buffer->used += count;
+
+    return CIF_OK;
+}
+
+static int write_uchars(void *context, const UChar *text, int32_t length) {
+    write_buffer_t *buffer = CONTEXT_BUFFER(context);
+    const UChar *limit = text + ((length < 0) ? u_strlen(text) : length);
+
+    if (buffer->converter == NULL) {
+        return encode_utf8(buffer, text, limit);
+    } else {
+        while (CIF_TRUE) {
+            UErrorCode error_code = U_ZERO_ERROR;
+            char *target = buffer->data + buffer->used;
+
+            ucnv_fromUnicode(buffer->converter, &target, buffer->data + buffer->capacity, &text, limit, NULL,
+                    CIF_TRUE, &error_code);
+            buffer->used = (size_t) (target - buffer->data);
+            if (error_code == U_BUFFER_OVERFLOW_ERROR) {
+                int result = flush_write_buffer(buffer, 1);
+
+                if (result != CIF_OK) {
+                    return result;
+                }
+            } else {
+                return (U_FAILURE(error_code) ? CIF_ERROR : CIF_OK);
+            }
+        }
+    }
+}
+
+static int flush_write_buffer(write_buffer_t *buffer, size_t needed) {
+    if (buffer->sink != NULL) {
+        size_t used = buffer->used;
+
+        buffer->used = 0;
+        return (((used == 0) || (buffer->sink(buffer->sink_context, buffer->data, used) == 0)) ? CIF_OK : CIF_ERROR);
+    } else {
+        size_t new_capacity = buffer->capacity;
+        char *new_data;
+
+        do {
+            if (new_capacity > (((size_t) -1) / 2)) {
+                return CIF_MEMORY_ERROR;
+            }
+            new_capacity *= 2;
+        } while ((new_capacity - buffer->used) < needed);
+
+        new_data = (char *) realloc(buffer->data, new_capacity);
+        if (new_data == NULL) {
+            return CIF_MEMORY_ERROR;
+        }
+        buffer->data = new_data;
+        buffer->capacity = new_capacity;
+
+        return CIF_OK;
+    }
+}
+
+static int write_to_stream(void *context, const char *bytes, size_t count) {
+    return ((fwrite(bytes, 1, count, (FILE *) context) == count) ? 0 : 1);
+}
+
+#ifdef HAVE_UNISTD_H
+static int write_to_fd(void *context, const char *bytes, size_t count) {
+    int fd = *((int *) context);
+
+    while (count > 0) {
+        ssize_t written = write(fd, bytes, count);
+
+        if (written < 0) {
+            if (errno != EINTR) {
+                return 1;
+            }
+        } else {
+            bytes += written;
+            count -= (size_t) written;
+        }
+    }
+
+    return 0;
+}
+#endif
+
+static int encode_utf8(write_buffer_t *buffer, const UChar *text, const UChar *limit) {
+    while (text < limit) {
+        unsigned char *out;
+        /* leaves room for the longest (four-byte) encoded sequence after the last check */
+        unsigned char *out_limit;
+
+        if ((buffer->capacity - buffer->used) < 4) {
+            int result = flush_write_buffer(buffer, 4);
+
+            if (result != CIF_OK) {
+                return result;
+            }
+        }
+        out = (unsigned char *) buffer->data + buffer->used;
+        out_limit = (unsigned char *) buffer->data + buffer->capacity - 3;
+
+        while ((text < limit) && (out < out_limit)) {
+            UChar c = *text;
+
+            if (c < 0x80) {
+                /* ASCII fast path: most CIF text is ASCII */
+                do {
+                    *(out++) = (unsigned char) c;
+                    if (++text >= limit) {
+                        break;
+                    }
+                    c = *text;
+                } while ((c < 0x80) && (out < out_limit));
+            } else if (c < 0x800) {
+                *(out++) = (unsigned char) (0xc0 | (c >> 6));
+                *(out++) = (unsigned char) (0x80 | (c & 0x3f));
+                text += 1;
+            } else if (!U16_IS_SURROGATE(c)) {
+                *(out++) = (unsigned char) (0xe0 | (c >> 12));
+                *(out++) = (unsigned char) (0x80 | ((c >> 6) & 0x3f));
+                *(out++) = (unsigned char) (0x80 | (c & 0x3f));
+                text += 1;
+            } else if (U16_IS_SURROGATE_LEAD(c) && ((text + 1) < limit) && U16_IS_TRAIL(text[1])) {
+                UChar32 cp = U16_GET_SUPPLEMENTARY(c, text[1]);
+
+                *(out++) = (unsigned char) (0xf0 | (cp >> 18));
+                *(out++) = (unsigned char) (0x80 | ((cp >> 12) & 0x3f));
+                *(out++) = (unsigned char) (0x80 | ((cp >> 6) & 0x3f));
+                *(out++) = (unsigned char) (0x80 | (cp & 0x3f));
+                text += 2;
+            } else {
+                /* an unpaired surrogate; substitute U+FFFD */
+                *(out++) = 0xef;
+                *(out++) = 0xbf;
+                *(out++) = 0xbd;
+                text += 1;
+            }
+        }
+
+        buffer->used = (size_t) ((char *) out - buffer->data);
+    }
+
+    return CIF_OK;
+}
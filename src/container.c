@@ -92,6 +92,40 @@ static int cif_container_add_scalar(
         cif_value_tp *val
         );
 
+/*
+ * Adds the specified packet entries to the specified container as scalars, all together: every item is first recorded
+ * as belonging to the scalar loop, and then every value is inserted into the loop's single packet.  The scalar loop
+ * and its packet are created if necessary.  The entries' keys are assumed normalized and valid, and no item may
+ * already be present in the container.  No transaction management is performed.
+ */
+static int cif_container_add_scalars(
+        cif_container_tp *container,
+        struct entry_s **items,
+        size_t count
+        );
+
+/*
+ * Completes a lookup via the get_value prepared statement, to which the normalized item name must already have been
+ * bound.  Binds the container ID, executes the statement, and provides the value (if any) as cif_container_get_value()
+ * describes.  Drops the statement on error.
+ */
+static int cif_container_read_value(
+        cif_container_tp *container,
+        cif_value_tp **val
+        );
+
+/*
+ * Reads the names and values of all the scalars of the specified container into the specified packet with a single
+ * query, keyed by their original names.  If the scalar loop has more than one packet then only the value from the
+ * first one read is recorded for each item, and CIF_TRUE is written where 'ambiguous' points; otherwise CIF_FALSE is written
+ * there.  Drops the statement on error, after which the packet may hold some, but not all, of the scalars.
+ */
+static int cif_container_read_scalars(
+        cif_container_tp *container,
+        cif_packet_tp *packet,
+        int *ambiguous
+        );
+
 /*
  * Tests whether the specified container handle is valid.  No transaction management is performed, so the test will
  * be performed in the scope of the current transaction if there is one, or in its own transaction otherwise.
@@ -380,6 +414,247 @@ static int cif_container_add_scalar(
     FAILURE_TERMINUS;
 }
 
+static int cif_container_add_scalars(
+        cif_container_tp *container,
+        struct entry_s **items,
+        size_t count
+        ) {
+    FAILURE_HANDLING;
+    STEP_HANDLING;
+    cif_tp *cif = container->cif;
+    cif_loop_tp *loop;
+    UChar null_char = 0;
+    UChar *none = NULL;
+    int loop_num;
+    int row_num;
+    size_t index;
+    int result;
+
+    /*
+     * Create any needed prepared statements, or prepare the existing one(s)
+     * for re-use, exiting this function with an error on failure.
+     */
+    PREPARE_STMT(cif, add_loop_item, ADD_LOOP_ITEM_SQL);
+    PREPARE_STMT(cif, get_packet_num, GET_PACKET_NUM_SQL);
+    PREPARE_STMT(cif, update_packet_num, UPDATE_PACKET_NUM_SQL);
+    PREPARE_STMT(cif, insert_value, INSERT_VALUE_SQL);
+
+    /* identify the scalar loop, creating it if necessary */
+    TRACELINE;
+    result = cif_container_get_category_loop(container, &null_char, &loop);
+    if (result == CIF_NOSUCH_LOOP) {
+        result = cif_container_create_loop_internal(container, &null_char, &none, &none, &loop);
+    }
+    if (result != CIF_OK) {
+        FAIL(soft, result);
+    }
+    loop_num = loop->loop_num;
+    cif_loop_free(loop);
+
+    /* record all the items as belonging to the scalar loop */
+    TRACELINE;
+    if ((sqlite3_bind_int64(cif->add_loop_item_stmt, 1, container->id) != SQLITE_OK)
+            || (sqlite3_bind_int(cif->add_loop_item_stmt, 4, loop_num) != SQLITE_OK)) {
+        DEFAULT_FAIL(hard);
+    }
+    for (index = 0; index < count; index += 1) {
+        if ((sqlite3_bind_text16(cif->add_loop_item_stmt, 2, items[index]->key, -1, SQLITE_STATIC) != SQLITE_OK)
+                || (sqlite3_bind_text16(cif->add_loop_item_stmt, 3, items[index]->key_orig, -1, SQLITE_STATIC)
+                        != SQLITE_OK)) {
+            DEFAULT_FAIL(hard);
+        }
+        switch (STEP_STMT(cif, add_loop_item)) {
+            case SQLITE_DONE:
+                break;
+            case SQLITE_CONSTRAINT:
+                TRACELINE;
+                sqlite3_reset(cif->add_loop_item_stmt);
+                FAIL(soft, CIF_DUP_ITEMNAME);
+            default:
+                TRACELINE;
+                DEFAULT_FAIL(hard);
+        }
+    }
+
+    /* determine the number of the scalar packet, creating the packet if there is none yet */
+    TRACELINE;
+    if ((sqlite3_bind_int64(cif->get_packet_num_stmt, 1, container->id) != SQLITE_OK)
+            || (sqlite3_bind_int(cif->get_packet_num_stmt, 2, loop_num) != SQLITE_OK)
+            || (STEP_STMT(cif, get_packet_num) != SQLITE_ROW)) {
+        DEFAULT_FAIL(hard);
+    }
+    row_num = sqlite3_column_int(cif->get_packet_num_stmt, 0);
+    if (sqlite3_reset(cif->get_packet_num_stmt) != SQLITE_OK) {
+        DEFAULT_FAIL(hard);
+    }
+    if (row_num == 0) {
+        if ((sqlite3_bind_int64(cif->update_packet_num_stmt, 1, container->id) != SQLITE_OK)
+                || (sqlite3_bind_int(cif->update_packet_num_stmt, 2, loop_num) != SQLITE_OK)
+                || (STEP_STMT(cif, update_packet_num) != SQLITE_DONE)) {
+            DEFAULT_FAIL(hard);
+        }
+        row_num = 1;
+    }
+
+    /* insert the values */
+    TRACELINE;
+    for (index = 0; index < count; index += 1) {
+        /* bindings are cleared between values because not every kind of value binds every column */
+        if ((sqlite3_bind_int64(cif->insert_value_stmt, 1, container->id) != SQLITE_OK)
+                || (sqlite3_bind_text16(cif->insert_value_stmt, 2, items[index]->key, -1, SQLITE_STATIC) != SQLITE_OK)
+                || (sqlite3_bind_int(cif->insert_value_stmt, 3, row_num) != SQLITE_OK)) {
+            DEFAULT_FAIL(hard);
+        }
+        SET_VALUE_PROPS(cif->insert_value_stmt, 3, items[index]->value, hard, soft);
+        if ((STEP_STMT(cif, insert_value) != SQLITE_DONE)
+                || (sqlite3_clear_bindings(cif->insert_value_stmt) != SQLITE_OK)) {
+            DEFAULT_FAIL(hard);
+        }
+    }
+
+    return CIF_OK;
+
+    FAILURE_HANDLER(hard):
+    DROP_STMT(cif, insert_value);
+    DROP_STMT(cif, update_packet_num);
+    DROP_STMT(cif, get_packet_num);
+    DROP_STMT(cif, add_loop_item);
+
+    FAILURE_HANDLER(soft):
+    FAILURE_TERMINUS;
+}
+
+static int cif_container_read_value(
+        cif_container_tp *container,
+        cif_value_tp **val
+        ) {
+    FAILURE_HANDLING;
+    cif_tp *cif = container->cif;
+
+    /* bind the remaining statement parameter */
+    if (sqlite3_bind_int64(cif->get_value_stmt, 1, container->id) == SQLITE_OK) {
+        STEP_HANDLING;
+
+        /* start executing the statement (in an implicit transaction) */
+        switch (STEP_STMT(cif, get_value)) {
+            case SQLITE_DONE:
+                /* no item by the given name in the specified container */
+                FAIL(soft, CIF_NOSUCH_ITEM);
+            case SQLITE_ROW:
+                /* a value was found */
+                TRACELINE;
+                while (val != NULL) {
+                    /* load the value from the DB */
+                    cif_value_tp *temp = (cif_value_tp *) malloc(sizeof(cif_value_tp));
+
+                    if (temp == NULL) {
+                        SET_RESULT(CIF_MEMORY_ERROR);
+                    } else {
+                        GET_VALUE_PROPS(cif->get_value_stmt, 0, temp, inner);
+
+                        /* hand the value off to the caller */
+                        if (*val == NULL) {
+                            *val = temp;
+                            break;
+                        } else {
+                            cif_value_clean(*val);
+                            /* make a _shallow_ copy of 'temp' where 'val' points */
+                            memcpy(*val, temp, sizeof(cif_value_tp));
+                            free(temp);
+                            break;
+                        }
+
+                        FAILURE_HANDLER(inner):
+                        free(temp);
+                    }
+
+                    sqlite3_reset(cif->get_value_stmt);
+                    DEFAULT_FAIL(soft);
+                }
+
+                /* check whether there are any more values */
+                switch (STEP_STMT(cif, get_value)) {
+                    case SQLITE_ROW:
+                        sqlite3_reset(cif->get_value_stmt);
+                        FAIL(soft, CIF_AMBIGUOUS_ITEM);
+                    case SQLITE_DONE:
+                        return CIF_OK;
+                    /* default: do nothing */
+                }
+                /* fall through */
+            /* default: do nothing */
+        }
+    }
+
+    DROP_STMT(cif, get_value);
+
+    FAILURE_HANDLER(soft):
+    FAILURE_TERMINUS;
+}
+
+static int cif_container_read_scalars(
+        cif_container_tp *container,
+        cif_packet_tp *packet,
+        int *ambiguous
+        ) {
+    FAILURE_HANDLING;
+    cif_tp *cif = container->cif;
+
+    /*
+     * Create any needed prepared statements, or prepare the existing one(s)
+     * for re-use, exiting this function with an error on failure.
+     */
+    PREPARE_STMT(cif, get_scalars, GET_SCALARS_SQL);
+
+    *ambiguous = CIF_FALSE;
+    if (sqlite3_bind_int64(cif->get_scalars_stmt, 1, container->id) == SQLITE_OK) {
+        STEP_HANDLING;
+
+        while (CIF_TRUE) {
+            const UChar *name;
+            struct entry_s *entry;
+            UChar *key;
+            UChar *key_orig;
+
+            switch (STEP_STMT(cif, get_scalars)) {
+                case SQLITE_ROW:
+                    /* the normalized name from the DB serves directly as the packet's key */
+                    name = (const UChar *) sqlite3_column_text16(cif->get_scalars_stmt, 1);
+                    if (name == NULL) {
+                        DEFAULT_FAIL(row);
+                    } else if (cif_map_find_internal(&(packet->map), name) != NULL) {
+                        /* a value from a second scalar packet; keep the first */
+                        *ambiguous = CIF_TRUE;
+                        continue;
+                    }
+                    GET_COLUMN_STRING(cif->get_scalars_stmt, 1, key, HANDLER_LABEL(row));
+                    GET_COLUMN_STRING(cif->get_scalars_stmt, 0, key_orig, HANDLER_LABEL(key));
+                    if (cif_map_add_internal(&(packet->map), key, key_orig, NULL, &entry) != CIF_OK) {
+                        free(key_orig);
+                        FAIL(key, CIF_MEMORY_ERROR);
+                    }
+                    GET_VALUE_PROPS(cif->get_scalars_stmt, 2, entry->value, row);
+                    continue;
+                case SQLITE_DONE:
+                    return CIF_OK;
+                /* default: do nothing */
+            }
+
+            DEFAULT_FAIL(row);
+
+            FAILURE_HANDLER(key):
+            free(key);
+
+            FAILURE_HANDLER(row):
+            break;
+        }
+    }
+
+    DROP_STMT(cif, get_scalars);
+
+    FAILURE_TERMINUS;
+}
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -1024,8 +1299,8 @@ int cif_container_set_all_values(
      */
     PREPARE_STMT(cif, set_all_values, SET_ALL_VALUES_SQL);
     TRACELINE;
-    if ((sqlite3_bind_int64(cif->set_all_values_stmt, 8, container->id) == SQLITE_OK)
-            && (sqlite3_bind_text16(cif->set_all_values_stmt, 9, item_name, -1, SQLITE_STATIC) == SQLITE_OK)) {
+    if ((sqlite3_bind_int64(cif->set_all_values_stmt, 9, container->id) == SQLITE_OK)
+            && (sqlite3_bind_text16(cif->set_all_values_stmt, 10, item_name, -1, SQLITE_STATIC) == SQLITE_OK)) {
         STEP_HANDLING;
 
         SET_VALUE_PROPS(cif->set_all_values_stmt, 0, val, hard, soft);
@@ -1050,7 +1325,6 @@ int cif_container_get_value(
         const UChar *name,
         cif_value_tp **val
         ) {
-    FAILURE_HANDLING;
     cif_tp *cif = container->cif;
     UChar *name_norm;
     int result;
@@ -1064,69 +1338,134 @@ int cif_container_get_value(
     TRACELINE;
     result = cif_normalize_item_name(name, -1, &name_norm, CIF_NOSUCH_ITEM);
     if (result != CIF_OK) {
-        SET_RESULT(result);
+        return result;
+    } else if (sqlite3_bind_text16(cif->get_value_stmt, 2, name_norm, -1, free) == SQLITE_OK) {
+        return cif_container_read_value(container, val);
     } else {
-        /* bind the statement parameters */
-        if ((sqlite3_bind_text16(cif->get_value_stmt, 2, name_norm, -1, free) == SQLITE_OK)
-                && (sqlite3_bind_int64(cif->get_value_stmt, 1, container->id) == SQLITE_OK)) {
-            STEP_HANDLING;
+        DROP_STMT(cif, get_value);
+        return CIF_ERROR;
+    }
+}
 
-            /* start executing the statement (in an implicit transaction) */
-            switch (STEP_STMT(cif, get_value)) {
-                case SQLITE_DONE:
-                    /* no item by the given name in the specified container */
-                    FAIL(soft, CIF_NOSUCH_ITEM);
-                case SQLITE_ROW:
-                    /* a value was found */
-                    TRACELINE;
-                    while (val != NULL) {
-                        /* load the value from the DB */
-                        cif_value_tp *temp = (cif_value_tp *) malloc(sizeof(cif_value_tp));
+int cif_container_get_value_utf8(
+        cif_container_tp *container,
+        const char *name,
+        cif_value_tp **val
+        ) {
+    cif_tp *cif = container->cif;
+    char *name_norm;
+    int result;
 
-                        if (temp == NULL) {
-                            SET_RESULT(CIF_MEMORY_ERROR);
-                        } else {
-                            GET_VALUE_PROPS(cif->get_value_stmt, 0, temp, inner);
+    /*
+     * Create any needed prepared statements, or prepare the existing one(s)
+     * for re-use, exiting this function with an error on failure.
+     */
+    PREPARE_STMT(cif, get_value, GET_VALUE_SQL);
 
-                            /* hand the value off to the caller */
-                            if (*val == NULL) {
-                                *val = temp;
-                                break;
-                            } else {
-                                cif_value_clean(*val);
-                                /* make a _shallow_ copy of 'temp' where 'val' points */
-                                memcpy(*val, temp, sizeof(cif_value_tp));
-                                free(temp);
-                                break;
-                            }
+    TRACELINE;
+    result = cif_normalize_utf8_internal(name, UTF8_VALIDATE_ITEM, &name_norm, CIF_NOSUCH_ITEM);
+    if (result != CIF_OK) {
+        return result;
+    } else if (sqlite3_bind_text(cif->get_value_stmt, 2, name_norm, -1, free) == SQLITE_OK) {
+        return cif_container_read_value(container, val);
+    } else {
+        DROP_STMT(cif, get_value);
+        return CIF_ERROR;
+    }
+}
 
-                            FAILURE_HANDLER(inner):
-                            free(temp);
-                        }
+int cif_container_get_values(
+        cif_container_tp *container,
+        const UChar *names[],
+        cif_value_tp *values[]
+        ) {
+    cif_packet_tp *scalars;
+    int ambiguous;
+    int result;
+    size_t index;
 
-                        sqlite3_reset(cif->get_value_stmt);
-                        DEFAULT_FAIL(soft);
-                    }
-                   
-                    /* check whether there are any more values */ 
-                    switch (STEP_STMT(cif, get_value)) {
-                        case SQLITE_ROW:
-                            sqlite3_reset(cif->get_value_stmt);
-                            FAIL(soft, CIF_AMBIGUOUS_ITEM);
-                        case SQLITE_DONE:
-                            return CIF_OK;
-                        /* default: do nothing */
+    if ((names == NULL) || (values == NULL)) {
+        return CIF_ARGUMENT_ERROR;
+    }
+    for (index = 0; names[index] != NULL; index += 1) {
+        values[index] = NULL;
+    }
+
+    if ((result = cif_packet_create(&scalars, NULL)) != CIF_OK) {
+        return result;
+    } else if ((result = cif_container_read_scalars(container, scalars, &ambiguous)) == CIF_OK) {
+        int overall_result = CIF_OK;
+
+        for (index = 0; names[index] != NULL; index += 1) {
+            UChar *name_norm;
+
+            result = cif_normalize_item_name(names[index], -1, &name_norm, CIF_NOSUCH_ITEM);
+            if (result == CIF_OK) {
+                struct entry_s *entry = ((ambiguous != 0) ? NULL : cif_map_find_internal(&(scalars->map), name_norm));
+
+                free(name_norm);
+                if ((entry != NULL) && (entry->value != NULL)) {
+                    /*
+                     * Hand the scalar's value off to the caller.  The entry is left in place, without a value, to
+                     * avoid reindexing the packet; a repeated name therefore falls back to an individual lookup.
+                     */
+                    values[index] = entry->value;
+                    entry->value = NULL;
+                } else {
+                    /* a looped item, an absent one, or one of ambiguous scalars: look it up individually */
+                    result = cif_container_get_value(container, names[index], values + index);
+                }
+            }
+
+            switch (result) {
+                case CIF_OK:
+                    break;
+                case CIF_NOSUCH_ITEM:
+                case CIF_AMBIGUOUS_ITEM:
+                    /* report the first such item, but continue with the others */
+                    if (overall_result == CIF_OK) {
+                        overall_result = result;
                     }
-                    /* fall through */
-                /* default: do nothing */
+                    break;
+                default:
+                    /* release the values already retrieved */
+                    do {
+                        if (values[index] != NULL) {
+                            cif_value_free(values[index]);
+                            values[index] = NULL;
+                        }
+                    } while (index-- > 0);
+                    cif_packet_free(scalars);
+                    return result;
             }
         }
 
-        DROP_STMT(cif, get_value);
+        result = overall_result;
     }
 
-    FAILURE_HANDLER(soft):
-    FAILURE_TERMINUS;
+    cif_packet_free(scalars);
+    return result;
+}
+
+int cif_container_get_all_scalars(
+        cif_container_tp *container,
+        cif_packet_tp **packet
+        ) {
+    cif_packet_tp *temp;
+    int ambiguous;
+    int result;
+
+    if (packet == NULL) {
+        return CIF_ARGUMENT_ERROR;
+    } else if ((result = cif_packet_create(&temp, NULL)) != CIF_OK) {
+        return result;
+    } else if ((result = cif_container_read_scalars(container, temp, &ambiguous)) != CIF_OK) {
+        cif_packet_free(temp);
+        return result;
+    } else {
+        *packet = temp;
+        return ((ambiguous != 0) ? CIF_AMBIGUOUS_ITEM : CIF_OK);
+    }
 }
 
 /* Not safe to be called by other library functions */
@@ -1185,6 +1524,90 @@ int cif_container_set_value(
     FAILURE_TERMINUS;  /* and success terminus, too */
 }
 
+/* Not safe to be called by other library functions */
+int cif_container_set_values(
+        cif_container_tp *container,
+        cif_packet_tp *packet
+        ) {
+    if (container == NULL) {
+        return CIF_INVALID_HANDLE;
+    } else if (packet == NULL) {
+        return CIF_ARGUMENT_ERROR;
+    } else {
+        return cif_container_set_values_internal(container, packet, CIF_FALSE);
+    }
+}
+
+int cif_container_set_values_internal(
+        cif_container_tp *container,
+        cif_packet_tp *packet,
+        int assume_new
+        ) {
+    FAILURE_HANDLING;
+    struct entry_s **new_items;
+    sqlite3 *db = container->cif->db;
+
+    if (packet->map.size == 0) {
+        return CIF_OK;
+    }
+
+    new_items = (struct entry_s **) malloc(packet->map.size * sizeof(struct entry_s *));
+    if (new_items == NULL) {
+        SET_RESULT(CIF_MEMORY_ERROR);
+    } else {
+        if (BEGIN(db) == SQLITE_OK) {
+            size_t new_count = 0;
+            size_t index;
+            int result = CIF_OK;
+
+            /* set the values of the items already present, and set aside the others to be added as scalars */
+            for (index = 0; (result == CIF_OK) && (index < packet->map.size); index += 1) {
+                struct entry_s *entry = packet->map.entries + index;
+
+                if (assume_new) {
+                    new_items[new_count] = entry;
+                    new_count += 1;
+                } else {
+                    cif_loop_tp item_loop;
+
+                    result = cif_container_get_item_loop_internal(container, entry->key, &item_loop);
+                    switch (result) {
+                        case CIF_NOSUCH_ITEM:
+                            /* nothing to clean up in item_loop in this case */
+                            new_items[new_count] = entry;
+                            new_count += 1;
+                            result = CIF_OK;
+                            break;
+                        case CIF_OK:
+                            free(item_loop.category);
+                            result = cif_container_set_all_values(container, entry->key, entry->value);
+                            break;
+                        /* default: do nothing */
+                    }
+                }
+            }
+
+            if ((result == CIF_OK) && (new_count > 0)) {
+                result = cif_container_add_scalars(container, new_items, new_count);
+            }
+
+            if ((result == CIF_OK) && (COMMIT(db) != SQLITE_OK)) {
+                result = CIF_ERROR;
+            }
+
+            if (result != CIF_OK) {
+                (void) ROLLBACK(db);
+            }
+
+            SET_RESULT(result);
+        }
+
+        free(new_items);
+    }
+
+    FAILURE_TERMINUS;  /* and success terminus, too */
+}
+
 /* not safe to be called by other library functions */
 int cif_container_remove_item(
         cif_container_tp *container,
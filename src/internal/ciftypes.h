@@ -122,14 +122,18 @@ struct cif_s {
    sqlite3_stmt *get_all_loops_stmt;
    sqlite3_stmt *prune_container_stmt;
    sqlite3_stmt *get_value_stmt;
+   sqlite3_stmt *get_scalars_stmt;
    sqlite3_stmt *set_all_values_stmt;
    sqlite3_stmt *get_loop_size_stmt;
    sqlite3_stmt *remove_item_stmt;
    sqlite3_stmt *destroy_loop_stmt;
    sqlite3_stmt *get_loop_names_stmt;
+   sqlite3_stmt *get_loop_widths_stmt;
+   sqlite3_stmt *get_loop_columns_stmt;
    sqlite3_stmt *get_packet_num_stmt;
    sqlite3_stmt *update_packet_num_stmt;
    sqlite3_stmt *reset_packet_num_stmt;
+   sqlite3_stmt *set_packet_num_stmt;
    sqlite3_stmt *check_item_loop_stmt;
    sqlite3_stmt *insert_value_stmt;
    sqlite3_stmt *update_value_stmt;
@@ -155,6 +159,34 @@ struct cif_loop_s {
     UChar **names;
 };
 
+/*
+ * A block of memory from which an arena allocates; the usable memory follows the header
+ */
+struct arena_chunk_s {
+    struct arena_chunk_s *next;
+    size_t capacity;  /* the number of usable bytes in the chunk */
+    size_t used;      /* the number of usable bytes already allocated */
+};
+
+/*
+ * A simple bump allocator for short-lived objects that can all be released together.  Memory obtained from an
+ * arena is never freed individually; instead, the arena is released back to a previously-recorded mark, making all
+ * memory allocated since then available for reuse.  Chunks are retained until the arena is destroyed.  An arena
+ * having both pointers NULL is empty and ready for use.
+ */
+typedef struct {
+    struct arena_chunk_s *first;
+    struct arena_chunk_s *current;
+} arena_tp;
+
+/*
+ * A position in an arena, to which the arena can later be released
+ */
+typedef struct {
+    struct arena_chunk_s *chunk;
+    size_t used;
+} arena_mark_tp;
+
 /* loop packets */
 
 struct set_element_s {
@@ -170,7 +202,11 @@ struct entry_s;
  * underlying structure.
  */
 typedef struct cif_map_s {
-    struct entry_s *head;  /* must be initialized to NULL! */
+    struct entry_s *entries; /* contiguous, in insertion order; initialize via cif_map_init_internal() */
+    size_t size;             /* the number of entries in use */
+    size_t capacity;         /* the number of entries for which space is allocated */
+    size_t *index;           /* open-addressing hash index; each slot holds an entry position + 1, or 0 if empty */
+    size_t index_mask;       /* the number of index slots, less one; the number of slots is a power of two */
     int is_standalone; /* In (only) standalone maps, the keys belong to the entries */
     name_normalizer_f normalizer;
 } cif_map_t;
@@ -190,22 +226,37 @@ struct cif_pktitr_s {
     struct set_element_s *name_set;  /* a set representation of 'item_names' */
     int previous_row_num;
     int finished;
+    cif_packet_tp *borrowed_packet;  /* the packet provided by cif_pktitr_next_borrowed_packet(), if any */
+    arena_tp arena;                  /* storage for the data of the borrowed packet's values */
+    arena_mark_tp arena_start;       /* the position of 'arena' when it was empty */
 };
 
 /* values */
 
+/*
+ * The header of an immutable, reference-counted buffer holding data shared among several values (see
+ * cif_value_share()).  The shared data immediately follow the header.  Values whose data are borrowed instead refer to
+ * the distinguished pseudo buffer cif_borrowed_data, which has no data of its own.
+ */
+struct shared_buffer_s {
+    size_t refs;       /* the number of values referring to the buffer */
+};
+
 /* IMPORTANT: the order of the members of the following value structures is significant. */
 
 typedef struct char_value_s {
     cif_kind_tp kind;  /* expected: CIF_CHAR_KIND */
     cif_quoted_tp quoted;
     UChar *text;
+    struct shared_buffer_s *shared;  /* the buffer containing the text, if it is shared; otherwise NULL */
+    int text_class;    /* the text's class as computed by cif_text_class_internal(), or 0 if not yet computed */
 } cif_char_tp;
 
 typedef struct numb_value_s {
     cif_kind_tp kind;  /* expected: CIF_NUMB_KIND */
     cif_quoted_tp quoted;
     UChar *text;
+    struct shared_buffer_s *shared;  /* the buffer containing the text and digits, if they are shared; else NULL */
     int sign;         /* expected: +-1 */
     /*
      * digit strings are expressed in the C locale.   They are expressed without leading
@@ -219,16 +270,31 @@ typedef struct numb_value_s {
 
 struct list_element_s;
 
+/*
+ * The serialized form of a list or table value whose elements are decoded only as they are accessed.  While a
+ * composite value has one of these, its ordinary element storage is empty and unused.
+ */
+struct lazy_composite_s {
+    char *data;                 /* the serialized composite, starting with its element count */
+    struct shared_buffer_s *shared;  /* the buffer containing 'data', if it is shared; otherwise NULL */
+    size_t size;                /* the number of bytes at 'data' */
+    size_t count;               /* the number of elements */
+    size_t decoded;             /* the number of non-NULL pointers in 'elements' */
+    cif_value_tp **elements;    /* decoded elements, in serialized order; NULL for those not yet decoded */
+};
+
 typedef struct list_value_s {
     cif_kind_tp kind;  /* expected: CIF_LIST_KIND */
     cif_value_tp **elements;
     size_t size;
     size_t capacity;
+    struct lazy_composite_s *lazy;
 } cif_list_tp;
 
 typedef struct table_value_s {
     cif_kind_tp kind;  /* expected: CIF_TABLE_KIND */
     cif_map_t map;
+    struct lazy_composite_s *lazy;
 } cif_table_tp;
 
 union cif_value_u {
@@ -246,10 +312,10 @@ struct list_element_s {
 };
 
 struct entry_s {
-    cif_value_tp as_value; /* not a pointer; MUST BE FIRST */
+    cif_value_tp *value;   /* belongs to the entry; separately allocated so that its address is stable */
     UChar *key;
     UChar *key_orig;
-    UT_hash_handle hh;
+    unsigned long hash;    /* the hash of 'key', computed once when the entry is added to its map */
 };
 
 /*
@@ -306,6 +372,7 @@ struct scanner_s {
     void *char_source;
     read_chars_f read_func;
     int at_eof;
+    int pending_cr;         /* Whether the last character read was a CR, which a LF read next completes as a CRLF */
 
     /* cif version */
     int cif_version;
@@ -321,8 +388,19 @@ struct scanner_s {
     cif_syntax_callback_tp whitespace_callback;
     cif_syntax_callback_tp keyword_callback;
     cif_syntax_callback_tp dataname_callback;
+    cif_item_token_callback_tp item_token_callback;
     void *user_data;
 
+    /* data name selection; each is a NULL-terminated array of patterns, or NULL */
+    const char **include_names;
+    const char **exclude_names;
+
+    /* storage for transient parser objects, such as data names, that do not escape the parser */
+    arena_tp arena;
+
+    /* a value object reused for successive items outside loops, to avoid creating and destroying one per item */
+    cif_value_tp *item_value;
+
     /*
      * Used internally to supports navigational control via caller-provided CIF handlers.
      *
@@ -339,5 +417,30 @@ struct scanner_s {
     int skip_depth;
 };
 
+/*
+ * Tracks the state of a pull-style CIF reader
+ */
+struct cif_reader_s {
+    struct scanner_s scanner;  /* The scanner from which the reader draws tokens */
+    void *source;           /* The scanner's character source, managed by the function that opened the reader */
+
+    int finished;           /* Nonzero once the end of the input has been reported */
+    int in_block;           /* Nonzero while a data block is open */
+    int frame_depth;        /* The number of save frames currently open */
+    int loop_state;         /* Whether a loop header or a loop body is being read, if either */
+    int have_packets;       /* Nonzero if the current loop body contains at least one complete packet */
+    int padding_packet;     /* Nonzero while a partial packet is being completed with synthetic values */
+
+    UChar **loop_names;     /* Copies of the data names in the current loop header */
+    size_t loop_name_count;
+    size_t loop_name_capacity;
+    size_t next_column;     /* The index of the loop name to which the next loop value belongs */
+
+    UChar *item_name;       /* A copy of the data name of the current non-looped item */
+    size_t item_name_capacity;
+
+    cif_value_tp *value;    /* The most recently read value, which is reused for each value read */
+};
+
 #endif /* INTERNAL_CIFTYPES_H */
 
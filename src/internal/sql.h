@@ -38,13 +38,81 @@
 
 #define GET_BLOCK_SQL "select container_id as id, name_orig from data_block where name = ?"
 
-#define GET_ALL_BLOCKS_SQL "select container_id as id, name, name_orig from data_block"
+#define GET_ALL_BLOCKS_SQL "select container_id as id, name, name_orig from data_block order by container_id"
 
 #define CREATE_FRAME_SQL "insert into save_frame(container_id, parent_id, name, name_orig) values (?, ?, ?, ?)"
 
 #define GET_FRAME_SQL "select container_id as id, name_orig from save_frame where parent_id = ? and name = ?"
 
-#define GET_ALL_FRAMES_SQL "select container_id as id, name, name_orig from save_frame where parent_id = ?"
+#define GET_ALL_FRAMES_SQL "select container_id as id, name, name_orig from save_frame where parent_id = ? " \
+        "order by container_id"
+
+/*
+ * Statements supporting the merger of a separately-built store (such as one constructed by a parallel parse worker)
+ * into a CIF.  The source store is attached under the schema name "cif_merge"; its container IDs up to and including
+ * ?2 are copied, offset by ?1 so as to follow all the target's existing containers in document order.
+ */
+#define ATTACH_STORE_SQL "attach database %Q as cif_merge"
+
+#define DETACH_STORE_SQL "detach database cif_merge"
+
+#define GET_MAX_CONTAINER_ID_SQL "select coalesce(max(id), 0) from main.container"
+
+#define MERGE_CONTAINERS_SQL "insert into main.container(id, next_loop_num) " \
+        "select id + ?1, next_loop_num from cif_merge.container where id <= ?2"
+
+#define MERGE_BLOCKS_SQL "insert into main.data_block(container_id, name, name_orig) " \
+        "select container_id + ?1, name, name_orig from cif_merge.data_block where container_id <= ?2"
+
+#define MERGE_FRAMES_SQL "insert into main.save_frame(container_id, parent_id, name, name_orig) " \
+        "select container_id + ?1, parent_id + ?1, name, name_orig from cif_merge.save_frame where container_id <= ?2"
+
+/* the scalar loops' row counters are restored separately, after their values, to satisfy the loop triggers */
+#define MERGE_LOOPS_SQL "insert into main.loop(container_id, loop_num, category, last_row_num) " \
+        "select container_id + ?1, loop_num, category, (case when category = '' then 0 else last_row_num end) " \
+        "from cif_merge.loop where container_id <= ?2"
+
+#define MERGE_LOOP_ITEMS_SQL "insert into main.loop_item(container_id, name, name_orig, loop_num) " \
+        "select container_id + ?1, name, name_orig, loop_num from cif_merge.loop_item where container_id <= ?2"
+
+#define MERGE_VALUES_SQL "insert into main.item_value" \
+        "(container_id, name, row_num, kind, quoted, val, val_text, val_digits, su_digits, scale, text_class) " \
+        "select container_id + ?1, name, row_num, kind, quoted, val, val_text, val_digits, su_digits, scale, " \
+        "text_class " \
+        "from cif_merge.item_value where container_id <= ?2"
+
+#define MERGE_SCALAR_ROWS_SQL "update main.loop set last_row_num = (" \
+        "select s.last_row_num from cif_merge.loop s " \
+        "where s.container_id = main.loop.container_id - ?1 and s.loop_num = main.loop.loop_num) " \
+        "where category = '' and container_id > ?1 and container_id <= ?1 + ?2"
+
+/* The number of loops in a CIF, including the scalar loops; sizes the work of a parallel write */
+#define COUNT_LOOPS_SQL "select count(*) from main.loop"
+
+/*
+ * Statements supporting the binary form of a CIF (see cif_write_binary() and cif_read_binary()).  The containers are
+ * listed in ID order, so that every save frame follows its parent, and each loop's values column by column, in the
+ * order in which the items were added to the loop, each column in packet order.  The left join presents an item
+ * having no values as a single row with a null row number.
+ */
+#define BINARY_GET_CONTAINERS_SQL "select c.id, f.parent_id, coalesce(b.name, f.name), " \
+        "coalesce(b.name_orig, f.name_orig), c.next_loop_num from container c " \
+        "left join data_block b on b.container_id = c.id left join save_frame f on f.container_id = c.id " \
+        "order by c.id"
+
+#define BINARY_GET_LOOPS_SQL "select loop_num, category, last_row_num from loop where container_id = ? " \
+        "order by loop_num"
+
+#define BINARY_GET_LOOP_VALUES_SQL "select li.rowid, li.name, li.name_orig, iv.row_num, " \
+        "iv.kind, iv.quoted, iv.val, iv.val_text, iv.val_digits, iv.su_digits, iv.scale, iv.text_class " \
+        "from loop_item li left join item_value iv on iv.container_id = li.container_id and iv.name = li.name " \
+        "where li.container_id = ? and li.loop_num = ? order by li.rowid, iv.row_num"
+
+#define BINARY_INSERT_CONTAINER_SQL "insert into container(id, next_loop_num) values (?, ?)"
+
+/* as when merging stores, a scalar loop's row counter is restored separately, after its values */
+#define BINARY_INSERT_LOOP_SQL "insert into loop(container_id, loop_num, category, last_row_num) " \
+        "values (?1, ?2, ?3, (case when ?3 = '' then 0 else ?4 end))"
 
 #define VALIDATE_CONTAINER_SQL "select 1 from container where id = ?"
 
@@ -74,14 +142,14 @@
  * specified name in the specified container:
  */
 #define SET_ALL_VALUES_SQL "insert or replace into item_value " \
-  "(kind, quoted, val_text, val, val_digits, su_digits, scale, container_id, name, row_num) " \
-  "select ?, ?, ?, ?, ?, ?, ?, ?, ?, loop_row.row_num " \
+  "(kind, quoted, val_text, val, val_digits, su_digits, scale, text_class, container_id, name, row_num) " \
+  "select ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, loop_row.row_num " \
      "from (" \
        "select distinct iv.row_num as row_num " \
        "from loop_item li1 " \
          "join loop_item li2 on li1.container_id = li2.container_id and li1.loop_num = li2.loop_num " \
          "join item_value iv on li2.container_id = iv.container_id and li2.name = iv.name " \
-       "where li1.container_id = ?8 and li1.name = ?9" \
+       "where li1.container_id = ?9 and li1.name = ?10" \
      ") loop_row"
 
 /* Loop "size" is the number of data names in a loop.  See also COUNT_LOOP_PACKETS_SQL. */
@@ -103,6 +171,51 @@
 
 #define GET_LOOP_NAMES_SQL "select name_orig from loop_item where container_id = ? and loop_num = ?"
 
+/*
+ * The length of the text of a compactly stored decimal value (one having no val_text), as cif_decimal_text_internal()
+ * and cif_numb_rebuild_text_internal() generate it
+ */
+#define DECIMAL_TEXT_LENGTH_SQL \
+      "case when length(abs(iv.val_digits)) <= iv.scale then (iv.val_digits < 0) + 2 + iv.scale " \
+        "else length(iv.val_digits) + (iv.scale > 0) end " \
+      "+ coalesce(length(iv.su_digits) + 2, 0)"
+
+/*
+ * Computes, for each item of a loop, the greatest number of characters with which the CIF writer presents any of its
+ * values on a single line.  Parameter 3 is the shift of the text class bits giving the delimiters of quoted text in
+ * the output CIF version.  Multi-line values, including those presented as text fields, and list and table values do
+ * not contribute.  Value kinds are 0 = char, 1 = numb, 4 = n/a, 5 = unknown.
+ *
+ * The statement is longer than the 509 characters to which C90 limits string literals, so it is provided in two
+ * pieces, to be concatenated at run time: the first computes the length of each value's text, and the second adds the
+ * width of any delimiters and selects the maximum.
+ */
+#define GET_LOOP_WIDTHS_SQL_HEAD "select li.name_orig, (" \
+      "select max(coalesce(length(iv.val_text), " DECIMAL_TEXT_LENGTH_SQL ", 1) "
+
+#define GET_LOOP_WIDTHS_SQL_TAIL "+ case iv.kind " \
+        "when 0 then case " \
+          "when instr(iv.val_text, char(10)) then null " \
+          "when (iv.text_class & 4) and not iv.quoted then 0 " \
+          "else case ((iv.text_class >> ?3) & 7) when 0 then 0 when 1 then 2 when 2 then 2 " \
+            "when 3 then 6 when 4 then 6 end " \
+          "end " \
+        "when 1 then 2 * (iv.quoted != 0) " \
+        "when 4 then 0 when 5 then 0 end) " \
+      "from item_value iv where iv.container_id = li.container_id and iv.name = li.name" \
+    ") from loop_item li where li.container_id = ?1 and li.loop_num = ?2"
+
+/*
+ * Selects all the values of a loop column by column, in the order in which the items were added to the loop, and each
+ * column's values in packet order.  Each value is preceded by the rowid and original name of its item; the value
+ * properties follow in the order GET_VALUE_PROPS expects.  The cross join keeps loop_item the outer table, so that
+ * the rows come out in index order, without sorting.
+ */
+#define GET_LOOP_COLUMNS_SQL "select li.rowid, li.name_orig, iv.kind, iv.quoted, iv.val, iv.val_text, " \
+      "iv.val_digits, iv.su_digits, iv.scale, iv.text_class " \
+    "from loop_item li cross join item_value iv on iv.container_id = li.container_id and iv.name = li.name " \
+    "where li.container_id = ? and li.loop_num = ? order by li.rowid, iv.row_num"
+
 #define CHECK_ITEM_LOOP_SQL "select 1 from loop_item where container_id = ? and name = ? and loop_num = ?"
 
 /*
@@ -121,23 +234,36 @@
 
 #define RESET_PACKET_NUM_SQL "update loop set last_row_num = 0 where container_id = ? and loop_num = ?"
 
+#define SET_PACKET_NUM_SQL "update loop set last_row_num = ? where container_id = ? and loop_num = ?"
+
 #define ADD_LOOP_ITEM_SQL "insert into loop_item (container_id, name, name_orig, loop_num) values (?, ?, ?, ?)"
 
 #define INSERT_VALUE_SQL "insert into item_value (container_id, name, row_num, " \
-    "kind, quoted, val_text, val, val_digits, su_digits, scale) values (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)"
+    "kind, quoted, val_text, val, val_digits, su_digits, scale, text_class) values (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)"
 
 #define UPDATE_VALUE_SQL "insert or replace into item_value (container_id, name, row_num, " \
-    "kind, quoted, val_text, val, val_digits, su_digits, scale) values (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)"
+    "kind, quoted, val_text, val, val_digits, su_digits, scale, text_class) values (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)"
 
-#define GET_VALUE_SQL "select kind, quoted, val, val_text, val_digits, su_digits, scale " \
+#define GET_VALUE_SQL "select kind, quoted, val, val_text, val_digits, su_digits, scale, text_class " \
         "from item_value where container_id = ? and name = ?"
 
+/*
+ * The cross joins pin the join order so that only the scalar loop's values are visited, rather than all the
+ * container's values.  The scalar loop has at most one packet, so the rows need no ordering.
+ */
+#define GET_SCALARS_SQL "select li.name_orig, li.name, iv.kind, iv.quoted, iv.val, iv.val_text, iv.val_digits, " \
+        "iv.su_digits, iv.scale, iv.text_class " \
+        "from loop l cross join loop_item li using (container_id, loop_num) " \
+        "cross join item_value iv using (container_id, name) " \
+        "where l.container_id = ? and l.category = ''"
+
 /*
  * Note: there is no dedicated stmt in the cif struct corresponding to this SQL; a new statement is needed for each
  * loop iterated to allow multiple iterations to proceed simultaneously (as if doing that were a good idea ...)
  */
 #define GET_LOOP_VALUES_SQL \
-    "select iv.row_num, name, iv.kind, iv.quoted, iv.val, iv.val_text, iv.val_digits, iv.su_digits, iv.scale " \
+    "select iv.row_num, name, iv.kind, iv.quoted, iv.val, iv.val_text, iv.val_digits, iv.su_digits, iv.scale, " \
+    "iv.text_class " \
     "from loop_item li join item_value iv using (container_id, name) " \
     "where li.container_id=? and li.loop_num=? " \
     "order by iv.row_num"
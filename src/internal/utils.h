@@ -424,15 +424,40 @@ extern int total_queries;
     } \
 } while (0)
 
+/*
+ * Copies a number's digits out of the specified column (col) of the specified prepared statement (stmt) into
+ * newly-allocated space, as a null-terminated C string of decimal digits, and records a pointer to it in 'dest'.  The
+ * digits may be stored either as an integer or as a digit string; in the former case the sign of the stored integer is
+ * recorded in 'sign', and in the latter 'sign' is set to 1.  If an error occurs then jumps to the specified label
+ * (onerr).  Only if execution does not branch to 'onerr' may dest afterward point to memory that needs to be managed
+ * (but dest may be NULL in any case).
+ */
+#define GET_COLUMN_DIGITS(stmt, col, dest, sign, onerr) do { \
+    if (sqlite3_column_type(stmt, col) == SQLITE_INTEGER) { \
+        sqlite3_int64 digits_val = sqlite3_column_int64(stmt, col); \
+        sign = ((digits_val < 0) ? -1 : 1); \
+        dest = cif_int64_to_digits_internal(digits_val); \
+        if (dest == NULL) { SET_RESULT(CIF_MEMORY_ERROR); goto onerr; } \
+    } else { \
+        sign = 1; \
+        GET_COLUMN_BYTESTRING(stmt, col, dest, onerr); \
+    } \
+} while (0)
+
 /*
  * Binds the fields of a value object to the parameters of a prepared statement in a manner appropriate to the
  * value's kind (but does not assign the kind itself).  Reseting the statement and / or clearing its bindings is
  * the responsibility of the macro user.  Bindings should be cleared at least before updating a value with one
- * of a different kind.
+ * of a different kind.  The digits of numbers are bound as integers where they fit, and a number's text is omitted
+ * (bound as NULL) where GET_VALUE_PROPS can reconstruct it exactly.  Character values whose text is a plain decimal
+ * number accepted by cif_decimal_form_internal() are stored in the same compact form, with their quoted flag and text
+ * class, and likewise without text.
+ *
+ * The text class of a character value is computed and cached in the value object if it is not already known.
  *
  * stmt: a pointer to the sqlite3_stmt object whose parameters are to be updated.  It must have a consecutive
  *   sequence of parameters corresponding, respectively, to these columns of table item_value:
- *   kind, val_text, val, val_digits, su_digits, scale
+ *   kind, val_text, val, val_digits, su_digits, scale, text_class
  * col_ofs: one less than the index of the prepared statement parameter corresponding to item_value.kind
  * val: a pointer to the value object from which to fill statement parameters
  * onsqlerr: the code for the failure handler to invoke in the event that any of the parameter bindings fails
@@ -444,6 +469,10 @@ extern int total_queries;
     int ofs = (col_ofs); \
     cif_value_tp *v = (val); \
     double svp_d; \
+    sqlite3_int64 svp_digits; \
+    sqlite3_int64 svp_su; \
+    int svp_scale; \
+    int svp_compact; \
     buffer_tp *buf; \
     int _svp_result; \
     if (sqlite3_bind_int(s, 1 + ofs, v->kind) != SQLITE_OK) { \
@@ -451,19 +480,44 @@ extern int total_queries;
     } \
     switch (v->kind) { \
         case CIF_CHAR_KIND: \
+            if (v->as_char.text_class == 0) { \
+                v->as_char.text_class = cif_text_class_internal(v->as_char.text); \
+            } \
+            svp_compact = cif_decimal_form_internal(v->as_char.text, &svp_digits, &svp_su, &svp_scale); \
             if ((sqlite3_bind_int(s, 2 + ofs, v->as_char.quoted) != SQLITE_OK) \
-                    || (sqlite3_bind_text16(s, 3 + ofs, v->as_char.text, -1, SQLITE_STATIC) != SQLITE_OK) \
-                    || (sqlite3_bind_text16(s, 4 + ofs, v->as_char.text, -1, SQLITE_STATIC) != SQLITE_OK)) { \
+                    || (svp_compact \
+                        ? (sqlite3_bind_null(s, 3 + ofs) != SQLITE_OK) \
+                        : (sqlite3_bind_text16(s, 3 + ofs, v->as_char.text, -1, SQLITE_STATIC) != SQLITE_OK)) \
+                    || (sqlite3_bind_text16(s, 4 + ofs, v->as_char.text, -1, SQLITE_STATIC) != SQLITE_OK) \
+                    || (svp_compact \
+                        ? ((sqlite3_bind_int64(s, 5 + ofs, svp_digits) != SQLITE_OK) \
+                            || ((svp_su < 0) \
+                                ? (sqlite3_bind_null(s, 6 + ofs) != SQLITE_OK) \
+                                : (sqlite3_bind_int64(s, 6 + ofs, svp_su) != SQLITE_OK)) \
+                            || (sqlite3_bind_int(s, 7 + ofs, svp_scale) != SQLITE_OK)) \
+                        : ((sqlite3_bind_null(s, 5 + ofs) != SQLITE_OK) \
+                            || (sqlite3_bind_null(s, 6 + ofs) != SQLITE_OK) \
+                            || (sqlite3_bind_null(s, 7 + ofs) != SQLITE_OK))) \
+                    || (sqlite3_bind_int(s, 8 + ofs, v->as_char.text_class) != SQLITE_OK)) { \
                 DEFAULT_FAIL(onsqlerr); \
             } \
             break; \
         case CIF_NUMB_KIND: \
+            svp_compact = cif_digits_to_int64_internal(v->as_numb.digits, &svp_digits); \
+            if (svp_compact && (v->as_numb.sign < 0)) svp_digits = -svp_digits; \
             if ((sqlite3_bind_int(s, 2 + ofs, v->as_numb.quoted) != SQLITE_OK) \
-                    || (sqlite3_bind_text16(s, 3 + ofs, v->as_numb.text, -1, SQLITE_STATIC) != SQLITE_OK) \
+                    || ((svp_compact && ((svp_digits != 0) || (v->as_numb.sign > 0)) \
+                            && cif_numb_text_is_canonical_internal(&v->as_numb)) \
+                        ? (sqlite3_bind_null(s, 3 + ofs) != SQLITE_OK) \
+                        : (sqlite3_bind_text16(s, 3 + ofs, v->as_numb.text, -1, SQLITE_STATIC) != SQLITE_OK)) \
                     || (cif_value_get_number(v, &svp_d) != CIF_OK) \
                     || (sqlite3_bind_double(s, 4 + ofs, svp_d) != SQLITE_OK) \
-                    || (sqlite3_bind_text(s, 5 + ofs, v->as_numb.digits, -1, SQLITE_STATIC) != SQLITE_OK) \
-                    || (sqlite3_bind_text(s, 6 + ofs, v->as_numb.su_digits, -1, SQLITE_STATIC) != SQLITE_OK) \
+                    || (svp_compact \
+                        ? (sqlite3_bind_int64(s, 5 + ofs, svp_digits) != SQLITE_OK) \
+                        : (sqlite3_bind_text(s, 5 + ofs, v->as_numb.digits, -1, SQLITE_STATIC) != SQLITE_OK)) \
+                    || (cif_digits_to_int64_internal(v->as_numb.su_digits, &svp_su) \
+                        ? (sqlite3_bind_int64(s, 6 + ofs, svp_su) != SQLITE_OK) \
+                        : (sqlite3_bind_text(s, 6 + ofs, v->as_numb.su_digits, -1, SQLITE_STATIC) != SQLITE_OK)) \
                     || (sqlite3_bind_int(s, 7 + ofs, v->as_numb.scale) != SQLITE_OK)) { \
                 DEFAULT_FAIL(onsqlerr); \
             } \
@@ -486,29 +540,46 @@ extern int total_queries;
     }  \
 } while (0)
 
-/* column order: kind, val, val_text, val_digits, su_digits, scale */
+/* column order: kind, val, val_text, val_digits, su_digits, scale, text_class */
 #define GET_VALUE_PROPS(_s, _ofs, _val, errlabel) do { \
     sqlite3_stmt *_stmt = (_s); \
     cif_value_tp *_value = (_val); \
     int _col_ofs = (_ofs); \
+    int _sign; \
     const void *_blob; \
     _value->kind = (cif_kind_tp) sqlite3_column_int(_stmt, _col_ofs); \
     switch (_value->kind) { \
         case CIF_CHAR_KIND: \
             _value->as_char.quoted = (sqlite3_column_int(_stmt, _col_ofs + 1) ? CIF_QUOTED : CIF_NOT_QUOTED); \
+            _value->as_char.shared = NULL; \
+            _value->as_char.text_class = sqlite3_column_int(_stmt, _col_ofs + 7); \
             GET_COLUMN_STRING(_stmt, _col_ofs + 3, _value->as_char.text, HANDLER_LABEL(errlabel)); \
             if (_value->as_char.text != NULL) break; \
+            if (sqlite3_column_type(_stmt, _col_ofs + 4) == SQLITE_INTEGER) { \
+                /* a plain decimal stored compactly; reconstruct the text */ \
+                _value->as_char.text = cif_decimal_text_internal(sqlite3_column_int64(_stmt, _col_ofs + 4), \
+                        ((sqlite3_column_type(_stmt, _col_ofs + 5) == SQLITE_NULL) \
+                            ? -1 : sqlite3_column_int64(_stmt, _col_ofs + 5)), \
+                        sqlite3_column_int(_stmt, _col_ofs + 6)); \
+                if (_value->as_char.text != NULL) break; \
+            } \
             FAIL(errlabel, CIF_INTERNAL_ERROR); \
         case CIF_NUMB_KIND: \
             _value->as_numb.quoted = (sqlite3_column_int(_stmt, _col_ofs + 1) ? CIF_QUOTED : CIF_NOT_QUOTED); \
+            _value->as_numb.shared = NULL; \
             GET_COLUMN_STRING(_stmt, _col_ofs + 3, _value->as_numb.text, HANDLER_LABEL(errlabel)); \
-            GET_COLUMN_BYTESTRING(_stmt, _col_ofs + 4, _value->as_numb.digits, HANDLER_LABEL(errlabel)); \
-            if ((_value->as_numb.text != NULL) && (*(_value->as_numb.text) != 0) && (_value->as_numb.digits != NULL) \
-                    && (*(_value->as_numb.digits) != '\0')) { \
-                GET_COLUMN_BYTESTRING(_stmt, _col_ofs + 5, _value->as_numb.su_digits, HANDLER_LABEL(errlabel)); \
+            GET_COLUMN_DIGITS(_stmt, _col_ofs + 4, _value->as_numb.digits, _sign, HANDLER_LABEL(errlabel)); \
+            if ((_value->as_numb.digits != NULL) && (*(_value->as_numb.digits) != '\0')) { \
+                _value->as_numb.sign = _sign; \
+                GET_COLUMN_DIGITS(_stmt, _col_ofs + 5, _value->as_numb.su_digits, _sign, HANDLER_LABEL(errlabel)); \
                 _value->as_numb.scale = sqlite3_column_int(_stmt, _col_ofs + 6); \
-                _value->as_numb.sign = (*(_value->as_numb.text) == UCHAR_MINUS) ? -1 : 1; \
-                break; \
+                if (_value->as_numb.text == NULL) { \
+                    /* compactly stored; reconstruct the text */ \
+                    if (cif_numb_rebuild_text_internal(&_value->as_numb) == CIF_OK) break; \
+                } else if (*(_value->as_numb.text) != 0) { \
+                    _value->as_numb.sign = (*(_value->as_numb.text) == UCHAR_MINUS) ? -1 : 1; \
+                    break; \
+                } \
             } \
             FAIL(errlabel, CIF_INTERNAL_ERROR); \
         case CIF_LIST_KIND: \
@@ -518,6 +589,8 @@ extern int total_queries;
                     _blob, (size_t) sqlite3_column_bytes(_stmt, _col_ofs + 2), _value) == CIF_OK)) { \
                 break; \
             } \
+            /* the value holds no resources, and must not appear to be a list or table */ \
+            _value->kind = CIF_UNK_KIND; \
             FAIL(errlabel, CIF_INTERNAL_ERROR); \
         case CIF_UNK_KIND: \
         case CIF_NA_KIND: \
@@ -527,6 +600,44 @@ extern int total_queries;
     } \
 } while (0)
 
+/*
+ * Text classes summarize, for the CIF writer, the results of analyzing a character value's text as
+ * cif_analyze_string() does, for each of the writer's modes, with a line length limit of CIF_LINE_LENGTH.  A text
+ * class is zero if it has not been computed, and nonzero otherwise; it fits in 16 bits.
+ */
+
+/* set in every computed text class */
+#define TEXT_CLASS_KNOWN       0x0001
+/* the text contains only characters allowed in CIF 1.1 */
+#define TEXT_CLASS_CIF11       0x0002
+/* the text may be presented whitespace-delimited, if the value is not flagged as quoted */
+#define TEXT_CLASS_BARE        0x0004
+/* a text field presenting the text needs line folding */
+#define TEXT_CLASS_FOLD        0x0008
+/* the text contains the text field delimiter, so a text field presenting it needs prefixing */
+#define TEXT_CLASS_TEXT_DELIM  0x0010
+/* the shifts of the TEXT_DELIM_* delimiter codes for presenting the text as a quoted value in CIF 2.0 and CIF 1.1 */
+#define TEXT_CLASS_CIF2_SHIFT  5
+#define TEXT_CLASS_CIF1_SHIFT  8
+
+/* The delimiter code for presenting a value of the specified text class in CIF 1.1 (if cif1) or CIF 2.0 (otherwise) */
+#define TEXT_CLASS_DELIM(tc, cif1) (((tc) >> ((cif1) ? TEXT_CLASS_CIF1_SHIFT : TEXT_CLASS_CIF2_SHIFT)) & 0x7)
+
+/* delimiter codes recorded in text classes */
+#define TEXT_DELIM_NONE        0
+#define TEXT_DELIM_APOS        1
+#define TEXT_DELIM_QUOT        2
+#define TEXT_DELIM_APOS3       3
+#define TEXT_DELIM_QUOT3       4
+#define TEXT_DELIM_TEXT_FIELD  5
+
+/*
+ * Evaluates to nonzero if a text field presenting a string having the specified analysis (a
+ * struct cif_string_analysis_s) needs line folding to respect the specified line length limit
+ */
+#define ANALYSIS_NEEDS_FOLDING(a, limit) (((a).length_first >= (limit)) || ((a).length_max > (limit)) \
+        || (a).has_reserved_start || ((a).max_semi_run >= ((limit) - 1)))
+
 /* The number of _bytes_ in the given null(-character)-terminated Unicode string */
 #define U_BYTES(s) (u_strlen(s) * sizeof(UChar))
 
@@ -559,6 +670,64 @@ extern char *strdup(const char *s) INTERNAL
 extern const UChar cif11_chars[] INTERNAL_VAR;
 extern const size_t cif11_chars_elements INTERNAL_VAR;
 
+/*
+ * A pseudo shared buffer marking value data that belong to some other object, such as the arena of a packet iterator
+ * (see cif_pktitr_next_borrowed_packet()).  It carries no references: values marking their data with it neither release
+ * those data when cleaned nor share them with their clones, which receive copies instead.
+ */
+extern struct shared_buffer_s cif_borrowed_data INTERNAL_VAR;
+
+/*
+ * An internal version of cif_create() that allows the backing database to be named.  If 'uri' is NULL then the
+ * result is the same as from cif_create(); otherwise, 'uri' is interpreted as an SQLite URI filename, and the database
+ * is opened in shared-cache mode so that it can later be attached to another CIF's connection (see
+ * cif_merge_store()).
+ */
+int cif_create_internal(
+        const char *uri,
+        cif_tp **cif
+        ) INTERNAL;
+
+/*
+ * Records the largest container ID yet assigned in the specified CIF, or zero if there are no containers, in the
+ * location pointed-to by 'id'.
+ */
+int cif_get_max_container_id(
+        cif_tp *cif,
+        sqlite3_int64 *id
+        ) INTERNAL;
+
+/*
+ * Copies the containers having IDs not exceeding 'id_limit', and all their contents, from the store identified by
+ * 'uri' (see cif_create_internal()) into the specified CIF, after all its existing contents.  The copy is performed
+ * in a single transaction; on failure, the target CIF is unchanged.  Returns CIF_DUP_BLOCKCODE if the copy fails on
+ * account of a constraint violation, which can arise only from a block code that is present in both stores.
+ */
+int cif_merge_store(
+        cif_tp *cif,
+        const char *uri,
+        sqlite3_int64 id_limit
+        ) INTERNAL;
+
+/*
+ * Creates a new, private CIF whose contents are a copy of those of the specified CIF, recording a handle on it where
+ * 'copy' points.  Because the copy has its own database connection, it can be read by a different thread than the
+ * original, concurrently with it.
+ */
+int cif_copy_store(
+        cif_tp *cif,
+        cif_tp **copy
+        ) INTERNAL;
+
+/*
+ * Records the number of loops in the specified CIF, counting each container's scalar loop, in the location
+ * pointed-to by 'count'.
+ */
+int cif_count_loops(
+        cif_tp *cif,
+        sqlite3_int64 *count
+        ) INTERNAL;
+
 /*
  * An internal version of cif_create_block() that allows block code validation to be suppressed (when 'lenient' is
  * nonzero)
@@ -581,6 +750,28 @@ int cif_container_create_frame_internal(
         cif_frame_tp **frame
         ) INTERNAL ;
 
+/*
+ * An internal version of cif_container_set_values() that performs no argument validation, and that skips checking
+ * whether the items are already present when 'assume_new' is nonzero.  In that case, every item of the packet must
+ * be new to the container, else the function fails with CIF_DUP_ITEMNAME.
+ */
+int cif_container_set_values_internal(
+        cif_container_tp *container,
+        cif_packet_tp *packet,
+        int assume_new
+        ) INTERNAL ;
+
+/*
+ * Adds an item to a standalone packet, which must not already contain an item of the same name, handing off the
+ * specified value object to the packet instead of copying it.  The packet copies the name.  On failure, the caller
+ * retains responsibility for the value.
+ */
+int cif_packet_adopt_item_internal(
+        cif_packet_tp *packet,
+        const UChar *name,
+        cif_value_tp *value
+        ) INTERNAL ;
+
 /*
  * An internal version of cif_loop_add_item that performs no validation or normalization and provides the number
  * of changes (== the number of loop packets) back to the caller
@@ -593,6 +784,61 @@ int cif_loop_add_item_internal(
         int *changes
         ) INTERNAL ;
 
+/*
+ * Determines, with a single query, the greatest number of characters with which any value of each of the specified
+ * items of a stored loop would be presented on one line of CIF output of the specified version, recording the results
+ * in the corresponding elements of 'widths'.  Multi-line values, including those that would be presented as text
+ * fields, and list and table values are disregarded.  Items having no other values, and names that do not belong to
+ * the loop, are ascribed width zero.
+ *
+ * loop: a handle on a loop belonging to a managed CIF
+ * names: a NULL-terminated array of item names of the loop, as cif_loop_get_names() provides them
+ * cif_version: the major CIF version of the output, 1 or 2
+ * widths: an array of at least as many elements as there are names
+ */
+int cif_loop_get_widths_internal(
+        cif_loop_tp *loop,
+        const UChar * const *names,
+        int cif_version,
+        size_t *widths
+        ) INTERNAL;
+
+/*
+ * The type of a function to which cif_loop_walk_columns_internal() passes the values of a loop.  The item name is
+ * non-NULL only for the first value of each column.  Both the name and the value belong to the caller, and are valid
+ * only for the duration of the call.  Returns CIF_OK to continue, or else a code with which to abort the walk.
+ */
+typedef int (*cif_column_visitor_tp)(void *context, const UChar *name, cif_value_tp *value);
+
+/*
+ * Passes all the values of the specified stored loop to the specified visitor, column by column in the order in which
+ * the items were added to the loop, and each column's values in packet order, reading them with a single query and
+ * holding only one of them in memory at a time.  Returns CIF_OK if the visitor accepted all the values, the first
+ * other code it returned, or an error code.
+ */
+int cif_loop_walk_columns_internal(
+        cif_loop_tp *loop,
+        cif_column_visitor_tp visitor,
+        void *context
+        ) INTERNAL;
+
+/*
+ * Records the specified values as the values of an item of the specified stored loop in its packets 1 through
+ * 'count', in order, within a single transaction, and sets the number of the loop's last packet to 'count'.  If
+ * 'add_item' is nonzero then the item is first added to the loop; otherwise it must already belong to it.  The loop
+ * must have no values other than those of items previously recorded the same way with the same count.  Performs no
+ * validation or normalization of the name.  Fails with CIF_DUP_ITEMNAME if an item is added that the container
+ * already has.
+ */
+int cif_loop_add_column_internal(
+        cif_loop_tp *loop,
+        const UChar *item_name,
+        const UChar *norm_name,
+        int add_item,
+        cif_value_tp **values,
+        size_t count
+        ) INTERNAL;
+
 /*
  * Creates a new packet for the given item names, and records a pointer to it where the given pointer points.  The
  * names are assumed already normalized, as if by cif_normalize_name()
@@ -686,27 +932,136 @@ int cif_normalize_table_index(
         ) INTERNAL;
 
 /*
- * Releases the map metadata of an entry structure.  This allows the entry to be used as a fat value after removal from
- * its map, without leaking the resources previously bound up in the metadata.
+ * Converts (the initial part of) a UTF-8 string to a newly-allocated, NUL-terminated Unicode string.
  *
- * entry: the entry object whose metadata are to be released
+ * src: the UTF-8 string to convert; must not be NULL
+ * srclen: the number of bytes to convert, or -1 to convert all bytes up to a NUL terminator
+ * ustr: the location where a pointer to the result should be written; must not be NULL
+ * invalidityCode: the return code to use in the event that the input is not well-formed UTF-8
+ */
+int cif_utf8_to_ustr_internal(
+        const char *src,
+        int32_t srclen,
+        UChar **ustr,
+        int invalidityCode
+        ) INTERNAL;
+
+/*
+ * Converts (the initial part of) a Unicode string to a newly-allocated, NUL-terminated UTF-8 string.  Returns
+ * CIF_INVALID_CHAR if the input contains unpaired surrogates.
  *
- * map: the map from which the entry was extracted; this is necessary to determine which metadata belong to the entry
+ * src: the Unicode string to convert; must not be NULL
+ * srclen: the number of UChars to convert, or -1 to convert all UChars up to a NUL terminator
+ * utf8: the location where a pointer to the result should be written; must not be NULL
  */
-CIF_VOIDFUNC_DECL(cif_map_entry_clean_metadata_internal, (
+int cif_ustr_to_utf8_internal(
+        const UChar *src,
+        int32_t srclen,
+        char **utf8
+        ) INTERNAL;
+
+/* values for the 'validation' argument of cif_normalize_utf8_internal() */
+#define UTF8_NO_VALIDATION  (-1)
+#define UTF8_VALIDATE_NAME  0
+#define UTF8_VALIDATE_ITEM  1
+
+/*
+ * Normalizes a NUL-terminated UTF-8 string as cif_normalize() does, optionally first validating it as a block code or
+ * frame code (UTF8_VALIDATE_NAME) or as a data name (UTF8_VALIDATE_ITEM), and records the result in UTF-8 form.
+ * All-ASCII inputs are validated and normalized in place, without conversion to UTF-16.
+ *
+ * name: the UTF-8 string to normalize; if NULL then invalidityCode is returned
+ * validation: one of UTF8_NO_VALIDATION, UTF8_VALIDATE_NAME, or UTF8_VALIDATE_ITEM
+ * normalized_name: the location where a pointer to the normalized UTF-8 string should be written; must not be NULL
+ * invalidityCode: the return code to use if the input is not well-formed UTF-8 or fails the requested validation
+ */
+int cif_normalize_utf8_internal(
+        const char *name,
+        int validation,
+        char **normalized_name,
+        int invalidityCode
+        ) INTERNAL;
+
+/*
+ * Initializes the specified map as an empty one.  No memory is allocated.
+ *
+ * map: the map to initialize; any previous contents are ignored
+ *
+ * is_standalone: nonzero if the keys are to belong to the map's entries
+ *
+ * normalizer: the function by which keys presented to the map are to be normalized
+ */
+CIF_VOIDFUNC_DECL(cif_map_init_internal, (
+        cif_map_t *map,
+        int is_standalone,
+        name_normalizer_f normalizer
+        )) INTERNAL_VOID;
+
+/*
+ * Ensures that the specified map has space for at least the specified number of entries, so that adding entries
+ * up to that number will not require any further allocation.  Returns CIF_OK on success or CIF_MEMORY_ERROR on
+ * failure, in which case the map is unchanged.
+ */
+int cif_map_reserve_internal(
+        cif_map_t *map,
+        size_t capacity
+        ) INTERNAL;
+
+/*
+ * Looks up the entry, if any, having the specified (already normalized) key in the specified map.  Returns a pointer
+ * to the entry, or NULL if there is none.  Entry pointers remain valid only until the next addition to or removal
+ * from the map, but the value objects to which entries refer do not move.
+ */
+struct entry_s *cif_map_find_internal(
+        cif_map_t *map,
+        const UChar *key
+        ) INTERNAL;
+
+/*
+ * Appends a new entry with the specified normalized and original keys and the specified value to the specified map,
+ * which must not already contain the key.  If 'value' is NULL then a new value of kind CIF_UNK_KIND is allocated for
+ * the entry.  On success, the map takes responsibility for the value, and for the keys to the extent that they belong
+ * to entries of the map (see cif_map_entry_clean_metadata_internal()), and a pointer to the new entry is recorded
+ * where 'entry' points, if that is not NULL.
+ *
+ * Returns CIF_OK on success or CIF_MEMORY_ERROR on failure, in which case the map is unchanged.
+ */
+int cif_map_add_internal(
+        cif_map_t *map,
+        UChar *key,
+        UChar *key_orig,
+        cif_value_tp *value,
+        struct entry_s **entry
+        ) INTERNAL;
+
+/*
+ * Removes the specified entry from its map, releasing its metadata.  The entry's value object is freed, too, if
+ * 'free_value' is nonzero; otherwise the caller is assumed to have taken responsibility for it.  Later entries of
+ * the map are moved down to fill the gap, preserving insertion order.
+ */
+CIF_VOIDFUNC_DECL(cif_map_remove_internal, (
+        cif_map_t *map,
         struct entry_s *entry,
+        int free_value
+        )) INTERNAL_VOID;
+
+/*
+ * Releases all the entries of the specified map and the storage that holds them, leaving the map empty and
+ * ready for reuse.
+ */
+CIF_VOIDFUNC_DECL(cif_map_clean_internal, (
         cif_map_t *map
         )) INTERNAL_VOID;
 
 /*
- * Frees a map entry and all resources associated with it, including the value.  Should be used only after the entry
- * is removed from its map.
+ * Releases the map metadata of an entry structure.  This allows the entry's value to be handed off elsewhere after
+ * removal from its map, without leaking the resources previously bound up in the metadata.
  *
- * entry: the entry object to free
+ * entry: the entry object whose metadata are to be released
  *
  * map: the map from which the entry was extracted; this is necessary to determine which metadata belong to the entry
  */
-CIF_VOIDFUNC_DECL(cif_map_entry_free_internal, (
+CIF_VOIDFUNC_DECL(cif_map_entry_clean_metadata_internal, (
         struct entry_s *entry,
         cif_map_t *map
         )) INTERNAL_VOID;
@@ -730,6 +1085,155 @@ int cif_value_deserialize(
         cif_value_tp *dest
         ) INTERNAL;
 
+/*
+ * Deserializes a value as cif_value_deserialize() does, except that a list or table serialized in the versioned format
+ * refers to the serialized data in place (as borrowed data; see cif_borrowed_data) instead of copying them.  The data
+ * must remain valid and unmodified for as long as the value uses them.
+ */
+int cif_value_deserialize_borrowed_internal(
+        const void *src,
+        size_t len,
+        cif_value_tp *dest
+        ) INTERNAL;
+
+/*
+ * Parses a string of decimal digits as a non-negative integer, recording the result in the location 'value' points
+ * to.  Returns nonzero if 'digits' is non-NULL and consists of between one and eighteen decimal digits, so that the
+ * result is exact; otherwise returns zero, and 'value' is not modified.
+ */
+int cif_digits_to_int64_internal(
+        const char *digits,
+        sqlite3_int64 *value
+        ) INTERNAL;
+
+/*
+ * Formats the magnitude of the specified integer as a newly-allocated string of decimal digits, without leading zeroes.
+ * Returns NULL if memory cannot be allocated.
+ */
+char *cif_int64_to_digits_internal(
+        sqlite3_int64 value
+        ) INTERNAL;
+
+/* the size, in chars, of a buffer sufficient for cif_int64_format_digits_internal() */
+#define INT64_DIGITS_SIZE 24
+
+/*
+ * Formats the magnitude of the specified integer as a string of decimal digits, without leading zeroes, at the end of
+ * the specified buffer of INT64_DIGITS_SIZE chars.  Returns a pointer to the first digit.
+ */
+char *cif_int64_format_digits_internal(
+        sqlite3_int64 value,
+        char *buffer
+        ) INTERNAL;
+
+/*
+ * Determines whether the text of the specified number is exactly the plain decimal form that
+ * cif_numb_rebuild_text_internal() would produce from its sign, digits, uncertainty digits, and scale.  Returns
+ * nonzero if so, else zero.
+ */
+int cif_numb_text_is_canonical_internal(
+        const cif_numb_tp *numb
+        ) INTERNAL;
+
+/*
+ * Generates the plain decimal text of the specified number from its sign, digits, uncertainty digits, and scale, and
+ * records it as the number's text.  Any text previously recorded is NOT released.
+ */
+int cif_numb_rebuild_text_internal(
+        cif_numb_tp *numb
+        ) INTERNAL;
+
+/*
+ * Computes the number of UChars, including the terminator, of the plain decimal text that
+ * cif_numb_rebuild_text_internal() would generate for the specified number, or zero if that text would be too long.
+ */
+size_t cif_numb_text_length_internal(
+        const cif_numb_tp *numb
+        ) INTERNAL;
+
+/*
+ * Writes the plain decimal text of the specified number to the specified buffer, which must have room for at least
+ * cif_numb_text_length_internal() UChars.
+ */
+void cif_numb_write_text_internal(
+        const cif_numb_tp *numb,
+        UChar *text
+        ) INTERNAL_VOID;
+
+/*
+ * Determines whether the specified character value text is a plain decimal number, optionally with an uncertainty,
+ * whose value and uncertainty digits each fit in eighteen decimal digits, and which cif_decimal_write_text_internal()
+ * reproduces exactly.  If so, records the signed value digits, the uncertainty digits (or -1 if there is no
+ * uncertainty), and the scale, and returns nonzero; otherwise returns zero.
+ */
+int cif_decimal_form_internal(
+        const UChar *text,
+        sqlite3_int64 *digits,
+        sqlite3_int64 *su,
+        int *scale
+        ) INTERNAL;
+
+/*
+ * Computes the number of UChars, including the terminator, of the plain decimal text having the specified signed
+ * value digits, uncertainty digits (none if negative), and scale, or zero if that text would be too long.
+ */
+size_t cif_decimal_text_length_internal(
+        sqlite3_int64 digits,
+        sqlite3_int64 su,
+        int scale
+        ) INTERNAL;
+
+/*
+ * Writes the plain decimal text having the specified signed value digits, uncertainty digits (none if negative), and
+ * scale to the specified buffer, which must have room for at least cif_decimal_text_length_internal() UChars.
+ */
+void cif_decimal_write_text_internal(
+        sqlite3_int64 digits,
+        sqlite3_int64 su,
+        int scale,
+        UChar *text
+        ) INTERNAL_VOID;
+
+/*
+ * Returns the plain decimal text having the specified signed value digits, uncertainty digits (none if negative), and
+ * scale, in newly-allocated space, or NULL if memory cannot be allocated or the text would be too long.
+ */
+UChar *cif_decimal_text_internal(
+        sqlite3_int64 digits,
+        sqlite3_int64 su,
+        int scale
+        ) INTERNAL;
+
+/*
+ * Checks that the specified data are a serialized value of the specified kind, in the serialization format written by
+ * this library, by decoding it and all its elements.  Returns CIF_OK if they are, or an error code (typically
+ * CIF_INTERNAL_ERROR) if they are not.
+ */
+int cif_value_check_serialized_internal(
+        const void *src,
+        size_t len,
+        cif_kind_tp kind
+        ) INTERNAL;
+
+/*
+ * Fully decodes the specified list or table value if it was deserialized lazily, so that its elements can be
+ * modified or enumerated directly.  Has no effect on other values, or on lists and tables already decoded.
+ */
+int cif_value_materialize_internal(
+        cif_value_tp *value
+        ) INTERNAL;
+
+/*
+ * Looks up the value associated with the specified key in the specified lazily-deserialized table value, by means of
+ * the serialized table's sorted key index, decoding only that value.  The value, which belongs to the table, is
+ * returned via the 'value' pointer if that is not NULL.  Returns CIF_NOSUCH_ITEM if the table has no such key.
+ */
+int cif_table_get_lazy_item_internal(
+        cif_value_tp *table,
+        const UChar *key,
+        cif_value_tp **value
+        ) INTERNAL;
+
 /*
  * Sets any and all (possibly looped) values for the specified item in the
  * specified container; no values are set if the item does not appear in the
@@ -755,7 +1259,7 @@ void cif_pktitr_free(
  * forms.
  *
  * @param[in,out] scanner a pointer to a scanner structure initialized with character source properties, user options,
- *         and an initial CIF version assertion / evaluation
+ *         the number of the first input line, and an initial CIF version assertion / evaluation
  * @param[in] not_utf8 if non-zero, indicates that the characters provided by the scanner's character source are known
  *         to be derived from an encoded byte sequence via an encoding different from UTF-8
  * @param[in,out] dest a pointer to a @c cif_tp object to update with the CIF data read from the provided source.  May
@@ -770,6 +1274,72 @@ int cif_parse_internal(
         cif_tp *dest
         ) INTERNAL;
 
+/*
+ * Prepares a reader for reading events, in the manner of cif_parse_internal() preparing to parse.  The reader's
+ * scanner must already be initialized as for cif_parse_internal(); the rest of the reader must be zero-filled.
+ * Whatever the result, the reader's resources must afterward be released via cif_reader_clear_internal().
+ *
+ * @param[in,out] reader a pointer to the reader to prepare
+ * @param[in] not_utf8 if non-zero, indicates that the characters provided by the scanner's character source are known
+ *         to be derived from an encoded byte sequence via an encoding different from UTF-8
+ */
+int cif_reader_start_internal(
+        cif_reader_tp *reader,
+        int not_utf8,
+        const char *extra_ws,
+        const char *extra_eol
+        ) INTERNAL;
+
+/*
+ * Releases the parser resources held by the specified reader, but not its character source or the reader itself
+ */
+void cif_reader_clear_internal(
+        cif_reader_tp *reader
+        ) INTERNAL_VOID;
+
+/*
+ * Allocates 'size' bytes from the specified arena, suitably aligned for any object type the library stores there.
+ * Returns a pointer to the allocated memory, or NULL if memory could not be allocated.
+ */
+void *cif_arena_alloc(
+        arena_tp *arena,
+        size_t size
+        ) INTERNAL;
+
+/*
+ * Copies 'length' characters of the specified Unicode string into memory allocated from the specified arena, and
+ * NUL-terminates the copy.  Returns a pointer to the copy, or NULL if memory could not be allocated.
+ */
+UChar *cif_arena_ustrndup(
+        arena_tp *arena,
+        const UChar *src,
+        int32_t length
+        ) INTERNAL;
+
+/*
+ * Records the current position of the specified arena in the specified mark
+ */
+void cif_arena_mark(
+        arena_tp *arena,
+        arena_mark_tp *mark
+        ) INTERNAL_VOID;
+
+/*
+ * Releases all memory allocated from the specified arena since the specified mark was recorded, making it available
+ * for reuse.  Marks recorded after that one are thereby invalidated.
+ */
+void cif_arena_release(
+        arena_tp *arena,
+        const arena_mark_tp *mark
+        ) INTERNAL_VOID;
+
+/*
+ * Frees all memory belonging to the specified arena, leaving it empty and ready for reuse
+ */
+void cif_arena_destroy(
+        arena_tp *arena
+        ) INTERNAL_VOID;
+
 /*
  * Validates that the specified Unicode string contains only characters that are in the CIF 1.1 character set.  Returns
  * CIF_OK if all characters are allowed, or CIF_DISALLOWED_CHAR if not.
@@ -783,6 +1353,29 @@ int cif_validate_cif11_characters(
         UChar **disallowed
         ) INTERNAL;
 
+/*
+ * Computes the text class (see TEXT_CLASS_KNOWN) of the specified NUL-terminated Unicode string, in one pass over it.
+ * The result is always nonzero.
+ */
+int cif_text_class_internal(
+        const UChar *text
+        ) INTERNAL;
+
+/*
+ * Determines whether a data name is selected by the specified include and exclude patterns, which have the form and
+ * significance documented for the include_names and exclude_names parse options.  Either array may be NULL.  Returns
+ * non-zero if the name is selected, or zero if not.
+ *
+ * name: the data name to test; must not be NULL
+ * length: the number of UChars in the name, or -1 if it is NUL-terminated
+ */
+int cif_name_selected_internal(
+        const char **include_names,
+        const char **exclude_names,
+        const UChar *name,
+        int32_t length
+        ) INTERNAL;
+
 #ifdef __cplusplus
 }
 #endif
@@ -27,6 +27,7 @@
 #include "internal/compat.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include "cif.h"
 #include "internal/ciftypes.h"
@@ -263,6 +264,53 @@ int cif_loop_get_names(cif_loop_tp *loop, UChar ***item_names) {
     return cif_loop_get_names_internal(loop, item_names, CIF_FALSE);
 }
 
+/* safe to be called by anyone */
+int cif_loop_get_names_utf8(cif_loop_tp *loop, char ***item_names) {
+    UChar **names;
+    int result;
+
+    if (item_names == NULL) {
+        return CIF_ARGUMENT_ERROR;
+    } else if ((result = cif_loop_get_names_internal(loop, &names, CIF_FALSE)) != CIF_OK) {
+        return result;
+    } else if (names == NULL) {
+        *item_names = NULL;
+        return CIF_OK;
+    } else {
+        size_t count;
+        size_t index;
+        char **temp_names;
+
+        for (count = 0; names[count] != NULL; count += 1) ;
+        temp_names = (char **) malloc((count + 1) * sizeof(char *));
+        if (temp_names == NULL) {
+            result = CIF_MEMORY_ERROR;
+        } else {
+            temp_names[count] = NULL;
+            for (index = 0; index < count; index += 1) {
+                if ((result = cif_ustr_to_utf8_internal(names[index], -1, temp_names + index)) != CIF_OK) {
+                    /* release the names already converted */
+                    while (index > 0) {
+                        free(temp_names[--index]);
+                    }
+                    free(temp_names);
+                    break;
+                }
+            }
+            if (result == CIF_OK) {
+                *item_names = temp_names;
+            }
+        }
+
+        for (index = 0; index < count; index += 1) {
+            free(names[index]);
+        }
+        free(names);
+
+        return result;
+    }
+}
+
 /* safe to be called by anyone */
 int cif_loop_add_item(
         cif_loop_tp *loop,
@@ -375,7 +423,7 @@ int cif_loop_add_packet(
 
     if (container == NULL) {
         return CIF_INVALID_HANDLE;
-    } else if (!packet->map.head) {
+    } else if (packet->map.size == 0) {
         return CIF_INVALID_PACKET;
     } else {
         cif = container->cif;
@@ -414,8 +462,8 @@ int cif_loop_add_packet(
                             && (sqlite3_bind_int(cif->check_item_loop_stmt, 3, loop->loop_num) == SQLITE_OK)) {
 
                         /* step through the entries in the packet */
-                        for (item = packet->map.head; ; item = (struct entry_s *) item->hh.next) {
-                            if (item == NULL) { /* no more entries */
+                        for (item = packet->map.entries; ; item += 1) {
+                            if (item == packet->map.entries + packet->map.size) { /* no more entries */
                                 if (COMMIT_NESTTX(cif->db) == SQLITE_OK) {
                                     return CIF_OK;
                                 } else {
@@ -451,7 +499,7 @@ int cif_loop_add_packet(
                                     && (sqlite3_bind_text16(cif->insert_value_stmt, 2, item->key, -1, SQLITE_STATIC)
                                             == SQLITE_OK)
                                     && (sqlite3_bind_int(cif->insert_value_stmt, 3, row_num) == SQLITE_OK)) {
-                                SET_VALUE_PROPS(cif->insert_value_stmt, 3, &(item->as_value), hard, rb);
+                                SET_VALUE_PROPS(cif->insert_value_stmt, 3, item->value, hard, rb);
                                 TRACELINE;
                                 switch (STEP_STMT(cif, insert_value)) {
                                     case SQLITE_DONE:
@@ -539,6 +587,10 @@ int cif_loop_get_packets(
         temp_it->item_names = NULL;
         temp_it->name_set = NULL;
         temp_it->finished = 0;
+        temp_it->borrowed_packet = NULL;
+        temp_it->arena.first = NULL;
+        temp_it->arena.current = NULL;
+        cif_arena_mark(&(temp_it->arena), &(temp_it->arena_start));
 
         if ((result = cif_loop_get_names_internal(loop, &(temp_it->item_names), CIF_TRUE)) != CIF_OK) {
             SET_RESULT(result);
@@ -590,6 +642,205 @@ int cif_loop_get_packets(
     FAILURE_TERMINUS;
 }
 
+int cif_loop_get_widths_internal(cif_loop_tp *loop, const UChar * const *names, int cif_version, size_t *widths) {
+    FAILURE_HANDLING;
+    cif_container_tp *container = loop->container;
+    cif_tp *cif;
+    size_t count;
+    char sql[sizeof(GET_LOOP_WIDTHS_SQL_HEAD) + sizeof(GET_LOOP_WIDTHS_SQL_TAIL)];
+
+    if ((container == NULL) || (loop->loop_num < 0)) {
+        return CIF_INVALID_HANDLE;
+    } else {
+        cif = container->cif;
+    }
+
+    for (count = 0; names[count] != NULL; count += 1) {
+        widths[count] = 0;
+    }
+
+    /*
+     * Create any needed prepared statements, or prepare the existing one(s)
+     * for re-use, exiting this function with an error on failure.  The statement text is assembled only if it is
+     * actually needed.
+     */
+    PREPARE_STMT(cif, get_loop_widths, strcat(strcpy(sql, GET_LOOP_WIDTHS_SQL_HEAD), GET_LOOP_WIDTHS_SQL_TAIL));
+
+    if ((sqlite3_bind_int64(cif->get_loop_widths_stmt, 1, container->id) == SQLITE_OK)
+            && (sqlite3_bind_int(cif->get_loop_widths_stmt, 2, loop->loop_num) == SQLITE_OK)
+            && (sqlite3_bind_int(cif->get_loop_widths_stmt, 3,
+                    ((cif_version == 1) ? TEXT_CLASS_CIF1_SHIFT : TEXT_CLASS_CIF2_SHIFT)) == SQLITE_OK)) {
+        STEP_HANDLING;
+
+        while (CIF_TRUE) {
+            const UChar *name;
+            size_t index;
+
+            switch (STEP_STMT(cif, get_loop_widths)) {
+                case SQLITE_ROW:
+                    name = (const UChar *) sqlite3_column_text16(cif->get_loop_widths_stmt, 0);
+                    for (index = 0; (name != NULL) && (index < count); index += 1) {
+                        if (u_strcmp(name, names[index]) == 0) {
+                            widths[index] = (size_t) sqlite3_column_int(cif->get_loop_widths_stmt, 1);
+                            break;
+                        }
+                    }
+                    continue;
+                case SQLITE_DONE:
+                    return CIF_OK;
+                default:
+                    sqlite3_reset(cif->get_loop_widths_stmt);
+                    break;
+            }
+
+            break;
+        }
+    }
+
+    DROP_STMT(cif, get_loop_widths);
+
+    FAILURE_TERMINUS;
+}
+
+int cif_loop_walk_columns_internal(cif_loop_tp *loop, cif_column_visitor_tp visitor, void *context) {
+    FAILURE_HANDLING;
+    cif_container_tp *container = loop->container;
+    cif_tp *cif;
+
+    if ((container == NULL) || (loop->loop_num < 0)) {
+        return CIF_INVALID_HANDLE;
+    } else {
+        cif = container->cif;
+    }
+
+    /*
+     * Create any needed prepared statements, or prepare the existing one(s)
+     * for re-use, exiting this function with an error on failure.
+     */
+    PREPARE_STMT(cif, get_loop_columns, GET_LOOP_COLUMNS_SQL);
+
+    if ((sqlite3_bind_int64(cif->get_loop_columns_stmt, 1, container->id) == SQLITE_OK)
+            && (sqlite3_bind_int(cif->get_loop_columns_stmt, 2, loop->loop_num) == SQLITE_OK)) {
+        STEP_HANDLING;
+        /* rowids are positive, so no item has this one */
+        sqlite3_int64 last_item = 0;
+        cif_value_tp value;
+
+        value.kind = CIF_UNK_KIND;
+        while (CIF_TRUE) {
+            sqlite3_int64 item;
+            const UChar *name;
+            int result;
+
+            switch (STEP_STMT(cif, get_loop_columns)) {
+                case SQLITE_ROW:
+                    item = sqlite3_column_int64(cif->get_loop_columns_stmt, 0);
+                    if (item == last_item) {
+                        name = NULL;
+                    } else if ((name = (const UChar *) sqlite3_column_text16(cif->get_loop_columns_stmt, 1)) == NULL) {
+                        FAIL(row, CIF_INTERNAL_ERROR);
+                    }
+                    last_item = item;
+
+                    GET_VALUE_PROPS(cif->get_loop_columns_stmt, 2, &value, row);
+                    result = visitor(context, name, &value);
+                    cif_value_clean(&value);
+                    if (result == CIF_OK) {
+                        continue;
+                    }
+                    SET_RESULT(result);
+
+                    FAILURE_HANDLER(row):
+                    cif_value_clean(&value);
+                    sqlite3_reset(cif->get_loop_columns_stmt);
+                    FAILURE_TERMINUS;
+                case SQLITE_DONE:
+                    return CIF_OK;
+                default:
+                    sqlite3_reset(cif->get_loop_columns_stmt);
+                    break;
+            }
+
+            break;
+        }
+    }
+
+    DROP_STMT(cif, get_loop_columns);
+
+    return CIF_ERROR;
+}
+
+int cif_loop_add_column_internal(cif_loop_tp *loop, const UChar *item_name, const UChar *norm_name, int add_item,
+        cif_value_tp **values, size_t count) {
+    FAILURE_HANDLING;
+    NESTTX_HANDLING;
+    cif_container_tp *container = loop->container;
+    cif_tp *cif = container->cif;
+
+    /*
+     * Create any needed prepared statements, or prepare the existing one(s)
+     * for re-use, exiting this function with an error on failure.
+     */
+    PREPARE_STMT(cif, add_loop_item, ADD_LOOP_ITEM_SQL);
+    PREPARE_STMT(cif, insert_value, INSERT_VALUE_SQL);
+    PREPARE_STMT(cif, set_packet_num, SET_PACKET_NUM_SQL);
+
+    if (BEGIN_NESTTX(cif->db) == SQLITE_OK) {
+        STEP_HANDLING;
+        size_t index;
+
+        if (add_item) {
+            if ((sqlite3_bind_int64(cif->add_loop_item_stmt, 1, container->id) != SQLITE_OK)
+                    || (sqlite3_bind_text16(cif->add_loop_item_stmt, 2, norm_name, -1, SQLITE_STATIC) != SQLITE_OK)
+                    || (sqlite3_bind_text16(cif->add_loop_item_stmt, 3, item_name, -1, SQLITE_STATIC) != SQLITE_OK)
+                    || (sqlite3_bind_int(cif->add_loop_item_stmt, 4, loop->loop_num) != SQLITE_OK)) {
+                DEFAULT_FAIL(hard);
+            }
+            switch (STEP_STMT(cif, add_loop_item)) {
+                case SQLITE_DONE:
+                    break;
+                case SQLITE_CONSTRAINT:
+                    sqlite3_reset(cif->add_loop_item_stmt);
+                    FAIL(rb, CIF_DUP_ITEMNAME);
+                default:
+                    sqlite3_reset(cif->add_loop_item_stmt);
+                    DEFAULT_FAIL(hard);
+            }
+        }
+
+        for (index = 0; index < count; index += 1) {
+            /* the bindings are cleared for each value, because not every kind of value binds every property */
+            if ((sqlite3_clear_bindings(cif->insert_value_stmt) != SQLITE_OK)
+                    || (sqlite3_bind_int64(cif->insert_value_stmt, 1, container->id) != SQLITE_OK)
+                    || (sqlite3_bind_text16(cif->insert_value_stmt, 2, norm_name, -1, SQLITE_STATIC) != SQLITE_OK)
+                    || (sqlite3_bind_int64(cif->insert_value_stmt, 3, (sqlite3_int64) (index + 1)) != SQLITE_OK)) {
+                DEFAULT_FAIL(hard);
+            }
+            SET_VALUE_PROPS(cif->insert_value_stmt, 3, values[index], hard, rb);
+            if (STEP_STMT(cif, insert_value) != SQLITE_DONE) {
+                sqlite3_reset(cif->insert_value_stmt);
+                DEFAULT_FAIL(hard);
+            }
+        }
+
+        if ((sqlite3_bind_int64(cif->set_packet_num_stmt, 1, (sqlite3_int64) count) == SQLITE_OK)
+                && (sqlite3_bind_int64(cif->set_packet_num_stmt, 2, container->id) == SQLITE_OK)
+                && (sqlite3_bind_int(cif->set_packet_num_stmt, 3, loop->loop_num) == SQLITE_OK)
+                && (STEP_STMT(cif, set_packet_num) == SQLITE_DONE)
+                && (COMMIT_NESTTX(cif->db) == SQLITE_OK)) {
+            return CIF_OK;
+        }
+
+        FAILURE_HANDLER(hard):
+        SET_RESULT(CIF_ERROR);
+
+        FAILURE_HANDLER(rb):
+        (void) ROLLBACK_NESTTX(cif->db);
+    }
+
+    FAILURE_TERMINUS;
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -682,6 +933,7 @@ static int cif_loop_get_names_internal(cif_loop_tp *loop, UChar ***item_names, i
                                 while (temp_names[++name_count] != NULL) {
                                     free(temp_names[name_count]);
                                 }
+                                free(temp_names);
                             } /* else drop out the bottom and fail */
                             break;
                     }
@@ -27,47 +27,70 @@
 #include "internal/compat.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include "cif.h"
 #include "internal/ciftypes.h"
 #include "internal/utils.h"
 
-/* All uthash fatal errors arise from memory allocation failure */
-#undef uthash_fatal
-#define uthash_fatal(msg) FAIL(soft, CIF_MEMORY_ERROR)
+/* the number of entries for which space is allocated when an empty map first receives an entry */
+#define MAP_INITIAL_CAPACITY 4
 
-static int cif_map_clean(cif_map_t *map) {
-    if (map != NULL) {
-        struct entry_s *entry;
-        struct entry_s *temp;
+/* the capacity, in UChars, of the stack buffers into which UTF-8 item names are converted */
+#define NAME_BUFFER_SIZE 64
 
-        /* these hash operations do not use uthash_fatal(): */
-        HASH_ITER(hh, map->head, entry, temp) {
-            HASH_DEL(map->head, entry);
-            cif_map_entry_free_internal(entry, map);
-        }
+/*
+ * Computes the FNV-1a hash of the specified NUL-terminated key, over its code units
+ */
+static unsigned long cif_map_hash(const UChar *key) {
+    unsigned long hash = 2166136261UL;
+
+    for (; *key != 0; key += 1) {
+        hash = ((hash ^ (unsigned long) *key) * 16777619UL) & 0xffffffffUL;
     }
 
-    return CIF_OK;
+    return hash;
+}
+
+/*
+ * Records the entry at the specified position in the map's index, which is assumed to have a free slot
+ */
+static void cif_map_index_entry(cif_map_t *map, size_t position) {
+    size_t slot = (size_t) map->entries[position].hash & map->index_mask;
+
+    while (map->index[slot] != 0) {
+        slot = (slot + 1) & map->index_mask;
+    }
+    map->index[slot] = position + 1;
+}
+
+/*
+ * Rebuilds the index of the specified map from its entries
+ */
+static void cif_map_reindex(cif_map_t *map) {
+    size_t position;
+
+    if (map->index != NULL) {
+        memset(map->index, 0, (map->index_mask + 1) * sizeof(size_t));
+        for (position = 0; position < map->size; position += 1) {
+            cif_map_index_entry(map, position);
+        }
+    }
 }
 
 static int cif_map_get_keys(cif_map_t *map, const UChar ***names) {
     FAILURE_HANDLING;
-    size_t name_count = (size_t) HASH_COUNT(map->head);
-    const UChar **temp = (const UChar **) malloc(sizeof(const UChar *) * (name_count + 1));
+    const UChar **temp = (const UChar **) malloc(sizeof(const UChar *) * (map->size + 1));
 
     if (temp == NULL) {
         SET_RESULT(CIF_MEMORY_ERROR);
     } else {
-        struct entry_s *item;
-        struct entry_s *temp_item;
-        const UChar **next = temp;
+        size_t position;
 
-        HASH_ITER(hh, map->head, item, temp_item) {
-            *next = item->key_orig;
-            next += 1;
+        for (position = 0; position < map->size; position += 1) {
+            temp[position] = map->entries[position].key_orig;
         }
-        *next = NULL;
+        temp[map->size] = NULL;
 
         *names = temp;
         return CIF_OK;
@@ -90,22 +113,19 @@ static int convert_to_standalone(cif_map_t *map) {
          * Item key copies are initially recorded in a temporary array to avoid modifying the map until
          * complete success is certain.
          */
-        size_t item_count = (size_t) HASH_COUNT(map->head);
-        UChar **key_copies = (UChar **) malloc(sizeof(UChar *) * item_count);
+        size_t item_count = map->size;
+        UChar **key_copies = (UChar **) malloc(sizeof(UChar *) * (item_count + 1));
 
         if (key_copies == NULL) {
             SET_RESULT(CIF_MEMORY_ERROR);
         } else {
-            size_t next = 0;
-            struct entry_s *item;
-            struct entry_s *temp;
+            size_t next;
 
             /* Copy the names */
-            HASH_ITER(hh, map->head, item, temp) {
-                if (next >= item_count) FAIL(soft, CIF_INTERNAL_ERROR);
-                key_copies[next] = cif_u_strdup(item->key_orig);
+            for (next = 0; next < item_count; ) {
+                key_copies[next] = cif_u_strdup(map->entries[next].key_orig);
 
-                if (key_copies[next++] != NULL) {
+                if (key_copies[next] != NULL) {
                     next += 1;
                 } else {
                     FAIL(soft, CIF_MEMORY_ERROR);
@@ -113,10 +133,8 @@ static int convert_to_standalone(cif_map_t *map) {
             }
 
             /* Update the entries with the name copies */
-            next = 0;
-            HASH_ITER(hh, map->head, item, temp) {
-                if (next >= item_count) FAIL(soft, CIF_INTERNAL_ERROR);
-                item->key_orig = key_copies[next++];
+            for (next = 0; next < item_count; next += 1) {
+                map->entries[next].key_orig = key_copies[next];
             }
 
             /* success */
@@ -152,11 +170,9 @@ static int cif_map_set_item(cif_map_t *map, const UChar *key, cif_value_tp *valu
         SET_RESULT(result);
     } else {
         /* must ensure key_norm is freed or kept */
-        size_t key_bytes = (size_t) U_BYTES(key_norm);
-        struct entry_s *item;
+        struct entry_s *item = cif_map_find_internal(map, key_norm);
         int different_key;
 
-        HASH_FIND(hh, map->head, key_norm, key_bytes, item);
         /*
          * If the provided key is not identical to one of the existing _internal_ item keys, then the map must be
          * (made) standalone to proceed.
@@ -175,7 +191,7 @@ static int cif_map_set_item(cif_map_t *map, const UChar *key, cif_value_tp *valu
                      * assertions about aliasing than otherwise it could do (for otherwise, there is a need to cast
                      * &item to (cif_value_tp **)).  This allows for stronger optimizations on the whole file.
                      */
-                    cif_value_tp *existing_value = &(item->as_value);
+                    cif_value_tp *existing_value = item->value;
 
                     if (key_orig != item->key_orig) {
                         assert(map->is_standalone != 0);
@@ -195,39 +211,24 @@ static int cif_map_set_item(cif_map_t *map, const UChar *key, cif_value_tp *valu
                     }
                 }
             } else {
-                /* This will be a new item for the map */
+                /* This will be a new item for the map; the map is standalone, so we need to copy the original key */
+                UChar *key_copy = cif_u_strdup(key);
 
                 assert(map->is_standalone != 0);
-                item = (struct entry_s *) malloc(sizeof(struct entry_s));
-                if (item == NULL) {
+                if (key_copy == NULL) {
                     SET_RESULT(CIF_MEMORY_ERROR);
                 } else {
-                    /* The map is standalone, so we need to copy the original key */
-                    UChar *key_copy = cif_u_strdup(key);
-
-                    if (key_copy == NULL) {
-                        SET_RESULT(CIF_MEMORY_ERROR);
-                    } else {
-                        /*
-                         * Using a local pointer to the value enables the compiler (GCC, at least) to prove stronger
-                         * assertions about aliasing than otherwise it could do (see above):
-                         */
-                        cif_value_tp *new_value = &(item->as_value);
-
-                        new_value->kind = CIF_UNK_KIND;
-                        if ((value == NULL) || cif_value_clone(value, &new_value) == CIF_OK) {
-                            item->key = key_norm;
-                            item->key_orig = key_copy;
-                            HASH_ADD_KEYPTR(hh, map->head, item->key, key_bytes, item);
+                    cif_value_tp *new_value = NULL;
+
+                    if ((value == NULL) || (cif_value_clone(value, &new_value) == CIF_OK)) {
+                        if (cif_map_add_internal(map, key_norm, key_copy, new_value, NULL) == CIF_OK) {
                             return CIF_OK;
                         }
-
-                        /* referenced by the HASH_ADD_KEYPTR macro: */
-                        FAILURE_HANDLER(soft):
-                        free(key_copy);
+                        cif_value_free(new_value);
                     }
 
-                    free(item);
+                    SET_RESULT(CIF_MEMORY_ERROR);
+                    free(key_copy);
                 }
             }
         }
@@ -253,25 +254,20 @@ static int cif_map_retrieve_item(cif_map_t *map, const UChar *key, cif_value_tp
     if (result != CIF_OK) {
         SET_RESULT(result);
     } else {
-        struct entry_s *item = NULL;
+        struct entry_s *item = cif_map_find_internal(map, key_norm);
 
-        HASH_FIND(hh, map->head, key_norm, U_BYTES(key_norm), item);
         free(key_norm);
 
         if (item == NULL) {
             SET_RESULT(CIF_NOSUCH_ITEM);
         } else {
             if (value != NULL) {
-                *value = &(item->as_value);
+                *value = item->value;
             }
 
             if (do_remove != 0) {
-                HASH_DEL(map->head, item);
-                if (value != NULL) {
-                    cif_map_entry_clean_metadata_internal(item, map);
-                } else {
-                    cif_map_entry_free_internal(item, map);
-                }
+                /* if the value is being handed off to the caller then it must not be freed */
+                cif_map_remove_internal(map, item, (value == NULL));
             }
 
             return CIF_OK;
@@ -281,10 +277,155 @@ static int cif_map_retrieve_item(cif_map_t *map, const UChar *key, cif_value_tp
     FAILURE_TERMINUS;
 }
 
+/*
+ * Converts the specified UTF-8 name to UTF-16 form, using the provided buffer of NAME_BUFFER_SIZE UChars if it is
+ * large enough, or else a newly-allocated one.  On success, a pointer to the converted name is written where 'uname'
+ * points; that must be freed by the caller if and only if it differs from 'buffer'.  Returns 'invalidityCode' if the
+ * name is NULL or not well-formed UTF-8.
+ */
+static int cif_map_utf8_name(const char *name, UChar *buffer, UChar **uname, int invalidityCode) {
+    if (name == NULL) {
+        return invalidityCode;
+    } else {
+        UErrorCode error = U_ZERO_ERROR;
+        int32_t length;
+
+        (void) u_strFromUTF8(buffer, NAME_BUFFER_SIZE, &length, name, -1, &error);
+        if (U_SUCCESS(error) && (error != U_STRING_NOT_TERMINATED_WARNING)) {
+            *uname = buffer;
+            return CIF_OK;
+        } else if (error == U_INVALID_CHAR_FOUND) {
+            return invalidityCode;
+        } else {
+            /* too long for the buffer */
+            return cif_utf8_to_ustr_internal(name, -1, uname, invalidityCode);
+        }
+    }
+}
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+void cif_map_init_internal(cif_map_t *map, int is_standalone, name_normalizer_f normalizer) {
+    map->entries = NULL;
+    map->size = 0;
+    map->capacity = 0;
+    map->index = NULL;
+    map->index_mask = 0;
+    map->is_standalone = is_standalone;
+    map->normalizer = normalizer;
+}
+
+int cif_map_reserve_internal(cif_map_t *map, size_t capacity) {
+    if (capacity > map->capacity) {
+        struct entry_s *new_entries;
+        size_t *new_index;
+        size_t index_size = 1;
+
+        /* the index is kept at most half full */
+        while (index_size < 2 * capacity) {
+            index_size *= 2;
+        }
+
+        new_index = (size_t *) malloc(index_size * sizeof(size_t));
+        if (new_index == NULL) {
+            return CIF_MEMORY_ERROR;
+        }
+        new_entries = (struct entry_s *) realloc(map->entries, capacity * sizeof(struct entry_s));
+        if (new_entries == NULL) {
+            free(new_index);
+            return CIF_MEMORY_ERROR;
+        }
+
+        free(map->index);
+        map->entries = new_entries;
+        map->capacity = capacity;
+        map->index = new_index;
+        map->index_mask = index_size - 1;
+        cif_map_reindex(map);
+    }
+
+    return CIF_OK;
+}
+
+struct entry_s *cif_map_find_internal(cif_map_t *map, const UChar *key) {
+    if (map->size > 0) {
+        unsigned long hash = cif_map_hash(key);
+        size_t slot = (size_t) hash & map->index_mask;
+
+        for (; map->index[slot] != 0; slot = (slot + 1) & map->index_mask) {
+            struct entry_s *entry = map->entries + (map->index[slot] - 1);
+
+            if ((entry->hash == hash) && (u_strcmp(entry->key, key) == 0)) {
+                return entry;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+int cif_map_add_internal(cif_map_t *map, UChar *key, UChar *key_orig, cif_value_tp *value, struct entry_s **entry) {
+    struct entry_s *new_entry;
+
+    if ((map->size >= map->capacity) && (cif_map_reserve_internal(map,
+            ((map->capacity < MAP_INITIAL_CAPACITY) ? MAP_INITIAL_CAPACITY : (2 * map->capacity))) != CIF_OK)) {
+        return CIF_MEMORY_ERROR;
+    }
+
+    if (value == NULL) {
+        if ((value = (cif_value_tp *) malloc(sizeof(cif_value_tp))) == NULL) {
+            return CIF_MEMORY_ERROR;
+        }
+        value->kind = CIF_UNK_KIND;
+    }
+
+    new_entry = map->entries + map->size;
+    new_entry->value = value;
+    new_entry->key = key;
+    new_entry->key_orig = key_orig;
+    new_entry->hash = cif_map_hash(key);
+    cif_map_index_entry(map, map->size);
+    map->size += 1;
+
+    if (entry != NULL) {
+        *entry = new_entry;
+    }
+
+    return CIF_OK;
+}
+
+void cif_map_remove_internal(cif_map_t *map, struct entry_s *entry, int free_value) {
+    size_t position = (size_t) (entry - map->entries);
+
+    assert(position < map->size);
+    cif_map_entry_clean_metadata_internal(entry, map);
+    if (free_value != 0) {
+        cif_value_free(entry->value);
+    }
+
+    map->size -= 1;
+    memmove(entry, entry + 1, (map->size - position) * sizeof(struct entry_s));
+    cif_map_reindex(map);
+}
+
+void cif_map_clean_internal(cif_map_t *map) {
+    size_t position;
+
+    for (position = 0; position < map->size; position += 1) {
+        cif_map_entry_clean_metadata_internal(map->entries + position, map);
+        cif_value_free(map->entries[position].value);
+    }
+    free(map->entries);
+    free(map->index);
+    map->entries = NULL;
+    map->size = 0;
+    map->capacity = 0;
+    map->index = NULL;
+    map->index_mask = 0;
+}
+
 void cif_map_entry_clean_metadata_internal(struct entry_s *entry, cif_map_t *map) {
     if (entry->key != entry->key_orig) {
         free(entry->key);
@@ -294,14 +435,9 @@ void cif_map_entry_clean_metadata_internal(struct entry_s *entry, cif_map_t *map
     }
 }
 
-void cif_map_entry_free_internal(struct entry_s *entry, cif_map_t *map) {
-    cif_map_entry_clean_metadata_internal(entry, map);
-    cif_value_free(&(entry->as_value));
-}
-
 void cif_packet_free(cif_packet_tp *packet) {
     if (packet != NULL) {
-        cif_map_clean(&(packet->map));
+        cif_map_clean_internal(&(packet->map));
         free(packet);
     }
 }
@@ -314,17 +450,81 @@ int cif_packet_set_item(cif_packet_tp *packet, const UChar *name, cif_value_tp *
     return cif_map_set_item(&(packet->map), name, value, CIF_INVALID_ITEMNAME);
 }
 
+int cif_packet_adopt_item_internal(cif_packet_tp *packet, const UChar *name, cif_value_tp *value) {
+    FAILURE_HANDLING;
+    cif_map_t *map = &(packet->map);
+    UChar *key_norm;
+    int result;
+
+    assert(map->is_standalone != 0);
+    assert(value != NULL);
+    result = (*map->normalizer)(name, -1, &key_norm, CIF_INVALID_ITEMNAME);
+    if (result != CIF_OK) {
+        SET_RESULT(result);
+    } else {
+        /* the normalized key can serve as the original one, too, if they are the same */
+        UChar *key_orig = ((u_strcmp(name, key_norm) == 0) ? key_norm : cif_u_strdup(name));
+
+        assert(cif_map_find_internal(map, key_norm) == NULL);
+        if (key_orig == NULL) {
+            SET_RESULT(CIF_MEMORY_ERROR);
+        } else if (cif_map_add_internal(map, key_norm, key_orig, value, NULL) == CIF_OK) {
+            return CIF_OK;
+        } else {
+            SET_RESULT(CIF_MEMORY_ERROR);
+            if (key_orig != key_norm) {
+                free(key_orig);
+            }
+        }
+        free(key_norm);
+    }
+
+    FAILURE_TERMINUS;
+}
+
 int cif_packet_get_item(cif_packet_tp *packet, const UChar *name, cif_value_tp **value) {
     return cif_map_retrieve_item(&(packet->map), name, value, 0, CIF_NOSUCH_ITEM);
 }
 
+int cif_packet_set_item_utf8(cif_packet_tp *packet, const char *name, cif_value_tp *value) {
+    UChar buffer[NAME_BUFFER_SIZE];
+    UChar *uname;
+    int result = cif_map_utf8_name(name, buffer, &uname, CIF_INVALID_ITEMNAME);
+
+    if (result == CIF_OK) {
+        result = cif_map_set_item(&(packet->map), uname, value, CIF_INVALID_ITEMNAME);
+        if (uname != buffer) {
+            free(uname);
+        }
+    }
+
+    return result;
+}
+
+int cif_packet_get_item_utf8(cif_packet_tp *packet, const char *name, cif_value_tp **value) {
+    UChar buffer[NAME_BUFFER_SIZE];
+    UChar *uname;
+    int result = cif_map_utf8_name(name, buffer, &uname, CIF_NOSUCH_ITEM);
+
+    if (result == CIF_OK) {
+        result = cif_map_retrieve_item(&(packet->map), uname, value, 0, CIF_NOSUCH_ITEM);
+        if (uname != buffer) {
+            free(uname);
+        }
+    }
+
+    return result;
+}
+
 int cif_packet_remove_item(cif_packet_tp *packet, const UChar *name, cif_value_tp **value) {
     return cif_map_retrieve_item(&(packet->map), name, value, 1, CIF_NOSUCH_ITEM);
 }
 
 int cif_value_get_keys(cif_value_tp *table, const UChar ***keys) {
     if (table->kind == CIF_TABLE_KIND) {
-        return cif_map_get_keys(&(table->as_table.map), keys);
+        int result = cif_value_materialize_internal(table);
+
+        return ((result == CIF_OK) ? cif_map_get_keys(&(table->as_table.map), keys) : result);
     } else {
         return CIF_ARGUMENT_ERROR;
     }
@@ -332,23 +532,31 @@ int cif_value_get_keys(cif_value_tp *table, const UChar ***keys) {
 
 int cif_value_set_item_by_key(cif_value_tp *table, const UChar *key, cif_value_tp *item) {
     if (table->kind == CIF_TABLE_KIND) {
-        return cif_map_set_item(&(table->as_table.map), key, item, CIF_INVALID_INDEX);
+        int result = cif_value_materialize_internal(table);
+
+        return ((result == CIF_OK) ? cif_map_set_item(&(table->as_table.map), key, item, CIF_INVALID_INDEX) : result);
     } else {
         return CIF_ARGUMENT_ERROR;
     }
 }
 
 int cif_value_get_item_by_key(cif_value_tp *table, const UChar *name, cif_value_tp **value) {
-    if (table->kind == CIF_TABLE_KIND) {
-        return cif_map_retrieve_item(&(table->as_table.map), name, value, 0, CIF_NOSUCH_ITEM);
-    } else {
+    if (table->kind != CIF_TABLE_KIND) {
         return CIF_ARGUMENT_ERROR;
+    } else if (table->as_table.lazy != NULL) {
+        /* look the key up in the serialized key index, decoding only the requested value */
+        return cif_table_get_lazy_item_internal(table, name, value);
+    } else {
+        return cif_map_retrieve_item(&(table->as_table.map), name, value, 0, CIF_NOSUCH_ITEM);
     }
 }
 
 int cif_value_remove_item_by_key(cif_value_tp *table, const UChar *name, cif_value_tp **value) {
     if (table->kind == CIF_TABLE_KIND) {
-        return cif_map_retrieve_item(&(table->as_table.map), name, value, 1, CIF_NOSUCH_ITEM);
+        int result = cif_value_materialize_internal(table);
+
+        return ((result == CIF_OK) ? cif_map_retrieve_item(&(table->as_table.map), name, value, 1, CIF_NOSUCH_ITEM)
+                : result);
     } else {
         return CIF_ARGUMENT_ERROR;
     }
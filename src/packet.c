@@ -36,10 +36,6 @@
 #include "internal/ciftypes.h"
 #include "internal/utils.h"
 
-/* All uthash fatal errors arise from memory allocation failure */
-#undef uthash_fatal
-#define uthash_fatal(msg) FAIL(soft, CIF_MEMORY_ERROR)
-
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -77,13 +73,9 @@ int cif_packet_create(cif_packet_tp **packet, UChar *names[]) {
             struct entry_s *entry;
             size_t counter2;
 
-            /* assign the original item names */
-            /* iteration via hh.next is documented to proceed in insertion order */
-            for (counter2 = 0, entry = (*packet)->map.head;
-                    counter2 < element_count;
-                    counter2 += 1, entry = (struct entry_s *) entry->hh.next) {
+            /* assign the original item names; the packet's entries are in insertion order */
+            for (counter2 = 0, entry = (*packet)->map.entries; counter2 < element_count; counter2 += 1, entry += 1) {
                 next = names + counter2;
-                assert(entry != NULL);
                 if (u_strcmp(*next, entry->key) != 0) {
                     assert (entry->key_orig == entry->key);  /* implementation detail of cif_packet_create_norm() */
                     entry->key_orig = cif_u_strdup(*next);
@@ -134,24 +126,26 @@ int cif_packet_create_norm(cif_packet_tp **packet, UChar **names, int avoid_alia
     } else {
         UChar **name;
 
-        temp_packet->map.normalizer = cif_normalize_item_name;
-        temp_packet->map.is_standalone = avoid_aliasing;
-        temp_packet->map.head = NULL;
+        cif_map_init_internal(&(temp_packet->map), avoid_aliasing, cif_normalize_item_name);
+        for (name = names; *name; name += 1) ;
+        if (cif_map_reserve_internal(&(temp_packet->map), (size_t) (name - names)) != CIF_OK) {
+            FAIL(soft, CIF_MEMORY_ERROR);
+        }
         for (name = names; *name; name += 1) {
-            struct entry_s *scalar = (struct entry_s *) malloc(sizeof(struct entry_s));
+            UChar *key;
 
-            if (scalar == NULL) {
-                FAIL(soft, CIF_MEMORY_ERROR);
+            if (avoid_aliasing == 0) {
+                key = *name;
             } else {
-                scalar->as_value.kind = CIF_UNK_KIND;
-                if (avoid_aliasing == 0) {
-                    scalar->key = *name;
-                } else {
-                    scalar->key = cif_u_strdup(*name);
-                    if (scalar->key == NULL) FAIL(soft, CIF_MEMORY_ERROR);
+                key = cif_u_strdup(*name);
+                if (key == NULL) FAIL(soft, CIF_MEMORY_ERROR);
+            }
+
+            if (cif_map_add_internal(&(temp_packet->map), key, key, NULL, NULL) != CIF_OK) {
+                if (avoid_aliasing != 0) {
+                    free(key);
                 }
-                scalar->key_orig = scalar->key;
-                HASH_ADD_KEYPTR(hh, temp_packet->map.head, scalar->key, U_BYTES(scalar->key), scalar);
+                FAIL(soft, CIF_MEMORY_ERROR);
             }
         }
 
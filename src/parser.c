@@ -347,15 +347,21 @@ static const UChar CIF2_MAGIC[MAGIC_LENGTH]
 /* grammar productions */
 static int parse_cif(struct scanner_s *scanner, cif_tp *cifp);
 static int parse_container(struct scanner_s *scanner, cif_container_tp *container, int is_block);
-static int parse_item(struct scanner_s *scanner, cif_container_tp *container, UChar *name);
+static int parse_item(struct scanner_s *scanner, cif_container_tp *container, UChar *name, cif_packet_tp *scalars);
+static int read_item_value(struct scanner_s *scanner, UChar *name, cif_value_tp **valuep, int need,
+        int *disposition);
+static int parse_item_value(struct scanner_s *scanner, UChar *name, cif_value_tp **valuep, int need,
+        int *disposition);
 static int parse_loop(struct scanner_s *scanner, cif_container_tp *container);
 static int parse_loop_header(struct scanner_s *scanner, cif_container_tp *container, string_element_tp **name_list_head,
-        int *name_countp);
+        int *name_countp, int *selected_countp);
 static int parse_loop_packets(struct scanner_s *scanner, cif_loop_tp *loop, string_element_tp *first_name,
         UChar *names[], int column_count);
+static int skip_loop_packets(struct scanner_s *scanner, int column_count);
 static int parse_list(struct scanner_s *scanner, cif_value_tp **listp);
 static int parse_table(struct scanner_s *scanner, cif_value_tp **tablep);
 static int parse_value(struct scanner_s *scanner, cif_value_tp **valuep);
+static int skip_value(struct scanner_s *scanner);
 
 /* scanning functions */
 static int next_token(struct scanner_s *scanner);
@@ -372,13 +378,73 @@ static int get_more_chars(struct scanner_s *scanner);
 /* other functions */
 static int decode_text(struct scanner_s *scanner, UChar *text, int32_t text_length, cif_value_tp **dest);
 
+/*
+ * Records the scalars buffered in the specified packet, if any, in the specified container via a single batched
+ * insertion, and empties the packet.  Does nothing if 'scalars' is NULL.
+ */
+static int flush_scalars(cif_container_tp *container, cif_packet_tp *scalars);
+
+/*
+ * Allocates the scanner's buffer, consumes any initial byte-order mark, resolves the CIF version from the magic code
+ * if necessary, and configures the scanner accordingly.  Returns CIF_OK if there is CIF text to parse, CIF_FINISHED
+ * if the input is empty except possibly for a BOM, or an error code.  Whatever the result, the caller is responsible
+ * for afterward releasing the scanner's resources via stop_scanner().
+ */
+static int start_scanner(struct scanner_s *scanner, int not_utf8, const char *extra_ws, const char *extra_eol);
+
+/*
+ * Releases the resources acquired by start_scanner() and by parsing, leaving the character source untouched
+ */
+static void stop_scanner(struct scanner_s *scanner);
+
+/* reader support functions */
+static void clear_loop_names(cif_reader_tp *reader);
+static int copy_name(UChar **dest, size_t *capacity, const UChar *name, int32_t length);
+static int add_loop_name(cif_reader_tp *reader, const UChar *name, int32_t length);
+static int next_loop_value(cif_reader_tp *reader, struct cif_event_s *event);
+
+/* CIF reader loop states */
+#define READER_NO_LOOP     0
+#define READER_LOOP_HEADER 1
+#define READER_LOOP_BODY   2
+
+/* the degree to which the parser itself needs the decoded value of a data item */
+#define VALUE_NOT_NEEDED            0
+#define VALUE_NEEDED_UNLESS_SKIPPED 1
+#define VALUE_NEEDED                2
+
+/* the parser-private context of a token view presented to an item token callback */
+struct token_context_s {
+    struct scanner_s *scanner;
+    cif_value_tp **valuep;
+    int decoded;
+    int result;
+};
+
 /* function-like macros */
 
+/*
+ * Records the details of a CIF reader event.
+ * e: a pointer to the event object
+ * k: the event kind
+ * t, l: the event text, if any, and its length
+ * v: the event value, if any
+ * s: the scanner, from which the event position is taken
+ */
+#define SET_EVENT(e, k, t, l, v, s) do { \
+    struct cif_event_s *_e = (e); \
+    _e->kind = (k); \
+    _e->text = (t); \
+    _e->length = (l); \
+    _e->value = (v); \
+    _e->line = (s)->line; \
+    _e->column = (s)->column; \
+} while (CIF_FALSE)
+
 #define INIT_V2_SCANNER(s, ws, eol) do { \
     struct scanner_s *_s = (s); \
     int _i; \
     const char * _c; \
-    _s->line = 1; \
     _s->column = 0; \
     _s->ttype = END; \
     _s->line_unfolding += 1; \
@@ -742,119 +808,559 @@ int cif_parse_error_die(int code, size_t line UNUSED, size_t column UNUSED, cons
 
 int cif_parse_internal(struct scanner_s *scanner, int not_utf8, const char *extra_ws, const char *extra_eol,
         cif_tp *dest) {
-    FAILURE_HANDLING;
+    int result = start_scanner(scanner, not_utf8, extra_ws, extra_eol);
 
-    scanner->buffer = (UChar *) malloc(BUF_SIZE_INITIAL * sizeof(UChar));
-    scanner->buffer_size = BUF_SIZE_INITIAL;
-    scanner->buffer_limit = 0;
+    if (result == CIF_OK) {
+        result = parse_cif(scanner, dest);
+    } else if (result == CIF_FINISHED) {
+        /* empty or BOM-only CIF */
+        result = CIF_OK;
+    }
 
-    if (scanner->buffer == NULL) {
-        SET_RESULT(CIF_MEMORY_ERROR);
-    } else {
-        UChar c;
+    stop_scanner(scanner);
 
-        INIT_V2_SCANNER(scanner, extra_ws, extra_eol);
-        scanner->next_char = scanner->buffer;
-        scanner->text_start = scanner->buffer;
-        scanner->tvalue_start = scanner->buffer;
-        scanner->tvalue_length = 0;
+    return result;
+}
 
-        /*
-         * We must avoid get_more_chars() here (and also NEXT_CHAR, which uses it) because we want -- here only -- to
-         * accept a byte-order mark.
-         */
-        FAILURE_VARIABLE = get_first_char(scanner);
+int cif_token_get_value(struct cif_token_s *token, cif_value_tp **value) {
+    struct token_context_s *context = (struct token_context_s *) token->context;
 
-        if (FAILURE_VARIABLE == CIF_EOF) {
-            /* empty CIF */
-            FAILURE_VARIABLE = CIF_OK;
-        } else if (FAILURE_VARIABLE == CIF_OK) {
-            int scanned_bom;
+    if (!context->decoded) {
+        /* the scanner is still positioned at the value's first token */
+        context->decoded = CIF_TRUE;
+        context->result = parse_value(context->scanner, context->valuep);
+    }
+    if (context->result == CIF_OK) {
+        *value = *context->valuep;
+    }
 
-            c = *(scanner->next_char++);
+    return context->result;
+}
 
-            /* consume an initial BOM, if present, regardless of the actual source encoding */
-            /* NOTE: assumes that the character decoder, if any, does not also consume an initial BOM */
-            if ((scanned_bom = (c == UCHAR_BOM))) {
+#ifdef __cplusplus
+}
+#endif
+
+/*
+ * Calls a function via a function pointer, provided that the pointer is not NULL.  In that case, this macro evaluates
+ * to the function return value.  Otherwise, it evaluates to the specified default return value.
+ *
+ * f: a pointer to the function to call; may be NULL
+ * args: a parenthesized argument list for the function
+ * default_return: the logical return value of the function when the pointer is NULL
+ */
+#define OPTIONAL_CALL(f,args,default_return) ((f == NULL) ? default_return : f args)
+
+/*
+ * Calls a function via a function pointer, provided that the pointer is not NULL.  The function's return value, if
+ * any, is ignored.
+ *
+ * f: a pointer to the function to call; may be NULL
+ * args: a parenthesized argument list for the function
+ */
+#define OPTIONAL_VOIDCALL(f,args) do { if (f != NULL) f args; } while (CIF_FALSE)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int cif_reader_start_internal(cif_reader_tp *reader, int not_utf8, const char *extra_ws, const char *extra_eol) {
+    int result;
+
+    reader->loop_state = READER_NO_LOOP;
+    if ((result = cif_value_create(CIF_UNK_KIND, &reader->value)) != CIF_OK) {
+        return result;
+    }
+
+    result = start_scanner(&reader->scanner, not_utf8, extra_ws, extra_eol);
+    if (result == CIF_FINISHED) {
+        /* empty or BOM-only CIF */
+        reader->finished = CIF_TRUE;
+        result = CIF_OK;
+    }
+
+    return result;
+}
+
+void cif_reader_clear_internal(cif_reader_tp *reader) {
+    stop_scanner(&reader->scanner);
+    clear_loop_names(reader);
+    free(reader->loop_names);
+    reader->loop_names = NULL;
+    free(reader->item_name);
+    reader->item_name = NULL;
+    if (reader->value != NULL) {
+        cif_value_free(reader->value);  /* ignore any error */
+        reader->value = NULL;
+    }
+}
+
+int cif_reader_next(cif_reader_tp *reader, struct cif_event_s *event) {
+    struct scanner_s *scanner = &reader->scanner;
+    int disposition;
+    int result;
+
+    if (reader->finished) {
+        return CIF_FINISHED;
+    }
+
+    while ((result = next_token(scanner)) == CIF_OK) {
+        UChar *token_value = TVALUE_START(scanner);
+        int32_t token_length = TVALUE_LENGTH(scanner);
+        enum token_type alt_ttype = QVALUE;
+
+        if (reader->loop_state == READER_LOOP_HEADER) {
+            if (scanner->ttype == NAME) {
+                OPTIONAL_VOIDCALL( scanner->dataname_callback, (scanner->line, scanner->column, token_value,
+                        token_length, scanner->user_data) );
+                if ((result = add_loop_name(reader, token_value, token_length)) != CIF_OK) {
+                    return result;
+                }
+                SET_EVENT(event, CIF_EVENT_LOOP_NAME, token_value, token_length, NULL, scanner);
                 CONSUME_TOKEN(scanner);
-                NEXT_CHAR(scanner, c, FAILURE_VARIABLE);
+                return CIF_OK;
+            } else if (reader->loop_name_count == 0) {
+                /* error: empty loop header */
+                result = scanner->error_callback(CIF_NULL_LOOP, scanner->line,
+                        scanner->column - TVALUE_LENGTH(scanner), TVALUE_START(scanner), 0, scanner->user_data);
+                if (result != CIF_OK) {
+                    return result;
+                }
+                /* recover by ending the loop; the token is not consumed */
+                reader->loop_state = READER_NO_LOOP;
+                SET_EVENT(event, CIF_EVENT_LOOP_END, NULL, 0, NULL, scanner);
+                return CIF_OK;
+            } else {
+                reader->loop_state = READER_LOOP_BODY;
+                reader->next_column = 0;
+                reader->have_packets = CIF_FALSE;
+                reader->padding_packet = CIF_FALSE;
+                /* the current token is handled as the first token of the loop body */
             }
+        }
 
-            if (FAILURE_VARIABLE == CIF_EOF) {
-                /* BOM-only CIF; nothing else to do */
-                FAILURE_VARIABLE = CIF_OK;
-            } else if (FAILURE_VARIABLE == CIF_OK) {
-                /* If the CIF version is uncertain then use the CIF magic code, if any, to choose */
-                if (scanner->cif_version <= 0) {
-                    scanner->cif_version = (scanner->cif_version < 0) ? -scanner->cif_version : 1;
-                    if (CLASS_OF(c, scanner) == HASH_CLASS) {
-                        if ((FAILURE_VARIABLE = scan_to_ws(scanner)) != CIF_OK) {
-                            DEFAULT_FAIL(early);
-                        }
-                        if (TVALUE_LENGTH(scanner) == MAGIC_LENGTH) {
-                            if (u_strncmp(TVALUE_START(scanner), CIF2_MAGIC, MAGIC_LENGTH) == 0) {
-                                scanner->cif_version = 2;
-                            } else if (u_strncmp(TVALUE_START(scanner), CIF1_MAGIC, MAGIC_LENGTH - 3) == 0) {
-                                /* recognize magic codes for all CIF versions other than 2.0 as CIF 1 */
-                                scanner->cif_version = 1;
+        if (reader->loop_state == READER_LOOP_BODY) {
+            switch (scanner->ttype) {
+                case TKEY:
+                    alt_ttype = TVALUE;
+                    /* fall through */
+                case KEY:
+                    /* error: missing whitespace (or that's how we interpret it, anyway) */
+                    result = scanner->error_callback(CIF_MISSING_SPACE, scanner->line,
+                            scanner->column - TVALUE_LENGTH(scanner), TVALUE_START(scanner),
+                            TVALUE_LENGTH(scanner), scanner->user_data);
+                    if (result != CIF_OK) {
+                        return result;
+                    }
+                    /* recover by pushing back the colon */
+                    scanner->next_char -= 1;
+                    scanner->ttype = alt_ttype;  /* TVALUE or QVALUE */
+
+                    /* notify the configured whitespace callback, if any, of zero-length whitespace */
+                    OPTIONAL_VOIDCALL(scanner->whitespace_callback, (scanner->line, scanner->column,
+                            scanner->next_char - 1, 0, scanner->user_data));
+
+                    /* fall through */
+                case OLIST:  /* opening delimiter of a list value */
+                case OTABLE: /* opening delimiter of a table value */
+                case TVALUE:
+                case QVALUE:
+                case VALUE:
+                    if ((result = parse_value(scanner, &reader->value)) != CIF_OK) {
+                        return result;
+                    }
+                    return next_loop_value(reader, event);
+                case CLIST:
+                case CTABLE:
+                    /* error: unexpected list/table delimiter */
+                    result = scanner->error_callback(CIF_UNEXPECTED_DELIM, scanner->line,
+                            scanner->column - TVALUE_LENGTH(scanner), TVALUE_START(scanner),
+                            TVALUE_LENGTH(scanner), scanner->user_data);
+                    if (result != CIF_OK) {
+                        return result;
+                    }
+                    /* recover by dropping it; the loop body is not terminated */
+                    CONSUME_TOKEN(scanner);
+                    continue;
+                default: /* any other token type terminates the loop body */
+                    if (reader->next_column != 0) {
+                        if (!reader->padding_packet) {
+                            /* error: partial packet */
+                            result = scanner->error_callback(CIF_PARTIAL_PACKET, scanner->line,
+                                    scanner->column - TVALUE_LENGTH(scanner), TVALUE_START(scanner), 0,
+                                    scanner->user_data);
+                            if (result != CIF_OK) {
+                                return result;
                             }
+                            reader->padding_packet = CIF_TRUE;
+                        }
+                        /* recover by synthesizing unknown values to fill the packet, one per event */
+                        if ((result = cif_value_init(reader->value, CIF_UNK_KIND)) != CIF_OK) {
+                            return result;
+                        }
+                        return next_loop_value(reader, event);
+                    } else if (!reader->have_packets) {
+                        /* error: no packets */
+                        result = scanner->error_callback(CIF_EMPTY_LOOP, scanner->line,
+                                scanner->column - TVALUE_LENGTH(scanner), TVALUE_START(scanner),
+                                TVALUE_LENGTH(scanner), scanner->user_data);
+                        if (result != CIF_OK) {
+                            return result;
                         }
+                        /* recover by ending the loop */
+                    }
+
+                    /* the token is not consumed */
+                    clear_loop_names(reader);
+                    reader->loop_state = READER_NO_LOOP;
+                    SET_EVENT(event, CIF_EVENT_LOOP_END, NULL, 0, NULL, scanner);
+                    return CIF_OK;
+            }
+        }
+
+        /* outside any loop */
+        switch (scanner->ttype) {
+            case END:
+                /* close any open containers one at a time, then report the end of the input */
+                if (reader->frame_depth > 0) {
+                    /* error: unterminated save frame at EOF */
+                    result = scanner->error_callback(CIF_EOF_IN_FRAME, scanner->line, scanner->column,
+                            TVALUE_START(scanner), 0, scanner->user_data);
+                    if (result != CIF_OK) {
+                        return result;
+                    }
+                    /* recover by closing the frame */
+                    reader->frame_depth -= 1;
+                    SET_EVENT(event, CIF_EVENT_FRAME_END, NULL, 0, NULL, scanner);
+                    return CIF_OK;
+                } else if (reader->in_block) {
+                    reader->in_block = CIF_FALSE;
+                    SET_EVENT(event, CIF_EVENT_BLOCK_END, NULL, 0, NULL, scanner);
+                    return CIF_OK;
+                } else {
+                    reader->finished = CIF_TRUE;
+                    return CIF_FINISHED;
+                }
+            case BLOCK_HEAD:
+                if (reader->frame_depth > 0) {
+                    /* error: unterminated save frame */
+                    result = scanner->error_callback(CIF_NO_FRAME_TERM, scanner->line,
+                            scanner->column - TVALUE_LENGTH(scanner), TVALUE_START(scanner), TVALUE_LENGTH(scanner),
+                            scanner->user_data);
+                    if (result != CIF_OK) {
+                        return result;
+                    }
+                    /* recover by closing the frame; the token is not consumed */
+                    reader->frame_depth -= 1;
+                    SET_EVENT(event, CIF_EVENT_FRAME_END, NULL, 0, NULL, scanner);
+                } else if (reader->in_block) {
+                    /* the token is not consumed */
+                    reader->in_block = CIF_FALSE;
+                    SET_EVENT(event, CIF_EVENT_BLOCK_END, NULL, 0, NULL, scanner);
+                } else {
+                    reader->in_block = CIF_TRUE;
+                    SET_EVENT(event, CIF_EVENT_BLOCK_START, token_value, token_length, NULL, scanner);
+                    CONSUME_TOKEN(scanner);
+                }
+                return CIF_OK;
+            default:
+                if (!reader->in_block) {
+                    /* error: missing data block header */
+                    result = scanner->error_callback(CIF_NO_BLOCK_HEADER, scanner->line,
+                            scanner->column - TVALUE_LENGTH(scanner), TVALUE_START(scanner), TVALUE_LENGTH(scanner),
+                            scanner->user_data);
+                    if (result != CIF_OK) {
+                        return result;
+                    }
+                    /* recover by opening an anonymous block; the token is not consumed */
+                    reader->in_block = CIF_TRUE;
+                    SET_EVENT(event, CIF_EVENT_BLOCK_START, token_value, 0, NULL, scanner);
+                    return CIF_OK;
+                }
+                break;
+        }
+
+        switch (scanner->ttype) {
+            case FRAME_HEAD:
+                if (scanner->max_frame_depth == 0) {
+                    /* error: save frames are not permitted */
+                    result = scanner->error_callback(CIF_FRAME_NOT_ALLOWED, scanner->line,
+                            scanner->column - TVALUE_LENGTH(scanner), TVALUE_START(scanner),
+                            TVALUE_LENGTH(scanner), scanner->user_data);
+                    if (result != CIF_OK) {
+                        return result;
                     }
+                    /* recover, if so directed, by acting as if max_frame_depth were 1 */
+                } else if ((scanner->max_frame_depth == 1) && (reader->frame_depth > 0)) {
+                    /* error: nested save frames are not permitted */
+                    result = scanner->error_callback(CIF_NO_FRAME_TERM, scanner->line,
+                            scanner->column - TVALUE_LENGTH(scanner), TVALUE_START(scanner),
+                            TVALUE_LENGTH(scanner), scanner->user_data);
+                    if (result != CIF_OK) {
+                        return result;
+                    }
+                }
+                if (((scanner->max_frame_depth == 0) || (scanner->max_frame_depth == 1)) && (reader->frame_depth > 0)) {
+                    /* recover by assuming the missing terminator; the token is not consumed */
+                    reader->frame_depth -= 1;
+                    SET_EVENT(event, CIF_EVENT_FRAME_END, NULL, 0, NULL, scanner);
+                } else {
+                    reader->frame_depth += 1;
+                    SET_EVENT(event, CIF_EVENT_FRAME_START, token_value, token_length, NULL, scanner);
+                    CONSUME_TOKEN(scanner);
+                }
+                return CIF_OK;
+            case FRAME_TERM:
+                /* consume the token in all cases */
+                CONSUME_TOKEN(scanner);
+                if (reader->frame_depth > 0) {
+                    reader->frame_depth -= 1;
+                    SET_EVENT(event, CIF_EVENT_FRAME_END, NULL, 0, NULL, scanner);
+                    return CIF_OK;
+                }
+                /* error: unexpected frame terminator */
+                result = scanner->error_callback(CIF_UNEXPECTED_TERM, scanner->line,
+                        scanner->column - TVALUE_LENGTH(scanner), TVALUE_START(scanner),
+                        TVALUE_LENGTH(scanner), scanner->user_data);
+                if (result != CIF_OK) {
+                    return result;
                 }
+                /* recover by dropping the token */
+                break;
+            case LOOPKW:
+                OPTIONAL_VOIDCALL( scanner->keyword_callback, (scanner->line, scanner->column,
+                        TVALUE_START(scanner), TVALUE_LENGTH(scanner), scanner->user_data) );
+                CONSUME_TOKEN(scanner);
+                reader->loop_state = READER_LOOP_HEADER;
+                SET_EVENT(event, CIF_EVENT_LOOP_START, NULL, 0, NULL, scanner);
+                return CIF_OK;
+            case NAME:
+                OPTIONAL_VOIDCALL( scanner->dataname_callback, (scanner->line, scanner->column, token_value,
+                        token_length, scanner->user_data) );
+                if ((result = copy_name(&reader->item_name, &reader->item_name_capacity, token_value, token_length))
+                        != CIF_OK) {
+                    return result;
+                }
+                CONSUME_TOKEN(scanner);
+                if ((result = read_item_value(scanner, NULL, &reader->value, VALUE_NEEDED, &disposition))
+                        != CIF_OK) {
+                    return result;
+                }
+                SET_EVENT(event, CIF_EVENT_ITEM, reader->item_name, token_length, reader->value, scanner);
+                return CIF_OK;
+            case TKEY:
+                alt_ttype = TVALUE;
+                /* fall through */
+            case KEY:
+                /* error: missing whitespace (between a quoted value and a subsequent colon)*/
+                result = scanner->error_callback(CIF_MISSING_SPACE, scanner->line, scanner->column - 1,
+                        scanner->next_char - 1, 0, scanner->user_data);
+                if (result != CIF_OK) {
+                    return result;
+                }
+                /* recover by pushing back the colon */
+                scanner->next_char -= 1;
+                scanner->ttype = alt_ttype;  /* TVALUE or QVALUE */
+
+                /* notify the configured whitespace callback, if any, of zero-length whitespace */
+                OPTIONAL_VOIDCALL(scanner->whitespace_callback, (scanner->line, scanner->column,
+                        scanner->next_char - 1, 0, scanner->user_data));
+
+                /* fall through */
+            case TVALUE:
+            case QVALUE:
+            case VALUE:
+            case OLIST:  /* opening delimiter of a list value */
+            case OTABLE: /* opening delimiter of a table value */
+                /* error: unexpected value */
+                result = scanner->error_callback(CIF_UNEXPECTED_VALUE, scanner->line,
+                        1 + scanner->column - TVALUE_LENGTH(scanner), TVALUE_START(scanner),
+                        TVALUE_LENGTH(scanner), scanner->user_data);
+                if (result != CIF_OK) {
+                    return result;
+                }
+                /* recover by consuming and discarding the value */
+                if ((result = parse_value(scanner, &reader->value)) != CIF_OK) {
+                    return result;
+                }
+                break;
+            case CTABLE:
+            case CLIST:
+                /* error: unexpected closing delimiter */
+                result = scanner->error_callback(CIF_UNEXPECTED_DELIM, scanner->line,
+                        scanner->column - TVALUE_LENGTH(scanner), TVALUE_START(scanner),
+                        TVALUE_LENGTH(scanner), scanner->user_data);
+                if (result != CIF_OK) {
+                    return result;
+                }
+                /* recover by dropping it */
+                CONSUME_TOKEN(scanner);
+                break;
+            default:
+                /* should not happen */
+                return CIF_INTERNAL_ERROR;
+        }
+    }
+
+    return result;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+static int start_scanner(struct scanner_s *scanner, int not_utf8, const char *extra_ws, const char *extra_eol) {
+    UChar c;
+    int scanned_bom;
+    int result;
+
+    scanner->arena.first = NULL;
+    scanner->arena.current = NULL;
+    scanner->item_value = NULL;
+    scanner->buffer = (UChar *) malloc(BUF_SIZE_INITIAL * sizeof(UChar));
+    scanner->buffer_size = BUF_SIZE_INITIAL;
+    scanner->buffer_limit = 0;
+
+    if (scanner->buffer == NULL) {
+        return CIF_MEMORY_ERROR;
+    }
+
+    INIT_V2_SCANNER(scanner, extra_ws, extra_eol);
+    scanner->next_char = scanner->buffer;
+    scanner->text_start = scanner->buffer;
+    scanner->tvalue_start = scanner->buffer;
+    scanner->tvalue_length = 0;
+
+    /*
+     * We must avoid get_more_chars() here (and also NEXT_CHAR, which uses it) because we want -- here only -- to
+     * accept a byte-order mark.
+     */
+    if ((result = get_first_char(scanner)) != CIF_OK) {
+        /* CIF_EOF signals an empty CIF */
+        return ((result == CIF_EOF) ? CIF_FINISHED : result);
+    }
+
+    c = *(scanner->next_char++);
+
+    /* consume an initial BOM, if present, regardless of the actual source encoding */
+    /* NOTE: assumes that the character decoder, if any, does not also consume an initial BOM */
+    if ((scanned_bom = (c == UCHAR_BOM))) {
+        CONSUME_TOKEN(scanner);
+        NEXT_CHAR(scanner, c, result);
+        if (result != CIF_OK) {
+            /* CIF_EOF signals a BOM-only CIF */
+            return ((result == CIF_EOF) ? CIF_FINISHED : result);
+        }
+    }
+
+    /* If the CIF version is uncertain then use the CIF magic code, if any, to choose */
+    if (scanner->cif_version <= 0) {
+        scanner->cif_version = (scanner->cif_version < 0) ? -scanner->cif_version : 1;
+        if (CLASS_OF(c, scanner) == HASH_CLASS) {
+            if ((result = scan_to_ws(scanner)) != CIF_OK) {
+                return result;
+            }
+            if (TVALUE_LENGTH(scanner) == MAGIC_LENGTH) {
+                if (u_strncmp(TVALUE_START(scanner), CIF2_MAGIC, MAGIC_LENGTH) == 0) {
+                    scanner->cif_version = 2;
+                } else if (u_strncmp(TVALUE_START(scanner), CIF1_MAGIC, MAGIC_LENGTH - 3) == 0) {
+                    /* recognize magic codes for all CIF versions other than 2.0 as CIF 1 */
+                    scanner->cif_version = 1;
+                }
+            }
+        }
+    }
+
+    /* reset the scanner */
+    scanner->next_char = scanner->text_start;
+    scanner->column = 0;
+
+    if (scanner->cif_version == 1) {
+        if (scanned_bom) {
+            /* error: disallowed CIF 1 character */
+            result = scanner->error_callback(CIF_DISALLOWED_CHAR, 1, 0,
+                    scanner->next_char - 1, 1, scanner->user_data);
+            /* recover, if necessary, by ignoring the problem */
+        }
+        SET_V1(scanner);
+    } else if ((scanner->cif_version == 2) && (not_utf8 != 0)) {
+        /* error: CIF2 but not UTF-8 */
+        result = scanner->error_callback(CIF_WRONG_ENCODING, 1, 1, scanner->next_char, 0,
+                scanner->user_data);
+        /* recover, if necessary, by ignoring the problem */
+    }
+
+    return result;
+}
+
+static void stop_scanner(struct scanner_s *scanner) {
+    free(scanner->buffer);
+    scanner->buffer = NULL;
+    cif_arena_destroy(&scanner->arena);
+    if (scanner->item_value != NULL) {
+        cif_value_free(scanner->item_value);  /* ignore any error */
+        scanner->item_value = NULL;
+    }
+}
+
+static void clear_loop_names(cif_reader_tp *reader) {
+    while (reader->loop_name_count > 0) {
+        free(reader->loop_names[--reader->loop_name_count]);
+    }
+}
+
+static int copy_name(UChar **dest, size_t *capacity, const UChar *name, int32_t length) {
+    if (*capacity <= (size_t) length) {
+        UChar *temp = (UChar *) realloc(*dest, (length + 1) * sizeof(UChar));
+
+        if (temp == NULL) {
+            return CIF_MEMORY_ERROR;
+        }
+        *dest = temp;
+        *capacity = length + 1;
+    }
+    u_strncpy(*dest, name, length);
+    (*dest)[length] = 0;
+
+    return CIF_OK;
+}
 
-                /* reset the scanner */
-                scanner->next_char = scanner->text_start;
-                scanner->column = 0;
+static int add_loop_name(cif_reader_tp *reader, const UChar *name, int32_t length) {
+    size_t capacity = 0;
 
-                if (scanner->cif_version == 1) {
-                    if (scanned_bom) {
-                        /* error: disallowed CIF 1 character */
-                        FAILURE_VARIABLE = scanner->error_callback(CIF_DISALLOWED_CHAR, 1, 0,
-                                scanner->next_char - 1, 1, scanner->user_data);
-                        /* recover, if necessary, by ignoring the problem */
-                    }
-                    SET_V1(scanner);
-                } else if ((scanner->cif_version == 2) && (not_utf8 != 0)) {
-                    /* error: CIF2 but not UTF-8 */
-                    FAILURE_VARIABLE = scanner->error_callback(CIF_WRONG_ENCODING, 1, 1, scanner->next_char, 0,
-                            scanner->user_data);
-                    /* recover, if necessary, by ignoring the problem */
-                }
-                if (FAILURE_VARIABLE == CIF_OK) {
-                    SET_RESULT(parse_cif(scanner, dest));
-                }
-            }
+    if (reader->loop_name_count >= reader->loop_name_capacity) {
+        size_t new_capacity = (reader->loop_name_capacity == 0) ? 8 : (2 * reader->loop_name_capacity);
+        UChar **temp = (UChar **) realloc(reader->loop_names, new_capacity * sizeof(UChar *));
+
+        if (temp == NULL) {
+            return CIF_MEMORY_ERROR;
         }
+        reader->loop_names = temp;
+        reader->loop_name_capacity = new_capacity;
+    }
 
-        FAILURE_HANDLER(early):
-        free(scanner->buffer);
+    reader->loop_names[reader->loop_name_count] = NULL;
+    if (copy_name(reader->loop_names + reader->loop_name_count, &capacity, name, length) != CIF_OK) {
+        return CIF_MEMORY_ERROR;
     }
+    reader->loop_name_count += 1;
 
-    GENERAL_TERMINUS;
+    return CIF_OK;
 }
 
-#ifdef __cplusplus
-}
-#endif
+static int next_loop_value(cif_reader_tp *reader, struct cif_event_s *event) {
+    UChar *name = reader->loop_names[reader->next_column];
 
-/*
- * Calls a function via a function pointer, provided that the pointer is not NULL.  In that case, this macro evaluates
- * to the function return value.  Otherwise, it evaluates to the specified default return value.
- *
- * f: a pointer to the function to call; may be NULL
- * args: a parenthesized argument list for the function
- * default_return: the logical return value of the function when the pointer is NULL
- */
-#define OPTIONAL_CALL(f,args,default_return) ((f == NULL) ? default_return : f args)
+    SET_EVENT(event, CIF_EVENT_LOOP_VALUE, name, u_strlen(name), reader->value, &reader->scanner);
+    reader->next_column = (reader->next_column + 1) % reader->loop_name_count;
+    if (reader->next_column == 0) {
+        /* that was the last value in the packet */
+        reader->have_packets = CIF_TRUE;
+        reader->padding_packet = CIF_FALSE;
+    }
 
-/*
- * Calls a function via a function pointer, provided that the pointer is not NULL.  The function's return value, if
- * any, is ignored.
- *
- * f: a pointer to the function to call; may be NULL
- * args: a parenthesized argument list for the function
- */
-#define OPTIONAL_VOIDCALL(f,args) do { if (f != NULL) f args; } while (CIF_FALSE)
+    return CIF_OK;
+}
 
 /*
  * Parse a while CIF via the provided scanner into the provided CIF object.  On success, all characters available from
@@ -983,6 +1489,7 @@ static int parse_cif(struct scanner_s *scanner, cif_tp *cif) {
 }
 
 static int parse_container(struct scanner_s *scanner, cif_container_tp *container, int is_block) {
+    cif_packet_tp *scalars = NULL;  /* buffers scalars for batched insertion, when no handler needs to see them first */
     int result;
 
     if (scanner->skip_depth > 0) {
@@ -1010,10 +1517,16 @@ static int parse_container(struct scanner_s *scanner, cif_container_tp *containe
         }
     }
 
+    if ((result == CIF_OK) && (container != NULL) && (scanner->skip_depth <= 0)
+            && (scanner->handler->handle_item == NULL) && (scanner->item_token_callback == NULL)) {
+        result = cif_packet_create(&scalars, NULL);
+    }
+
     while (result == CIF_OK) {
         int32_t token_length;
         UChar *token_value;
         UChar *name;
+        arena_mark_tp name_mark;
         enum token_type alt_ttype = QVALUE;
         cif_container_tp *frame;
 
@@ -1042,6 +1555,10 @@ static int parse_container(struct scanner_s *scanner, cif_container_tp *containe
                 } else { 
                     UChar saved = *(token_value + token_length);
 
+                    if ((result = flush_scalars(container, scalars)) != CIF_OK) {
+                        goto container_end;
+                    }
+
                     if (scanner->max_frame_depth == 0) {
                         /* save frames are not permitted */
                         result = scanner->error_callback(CIF_FRAME_NOT_ALLOWED, scanner->line,
@@ -1131,31 +1648,46 @@ static int parse_container(struct scanner_s *scanner, cif_container_tp *containe
                             TVALUE_START(scanner), TVALUE_LENGTH(scanner), scanner->user_data) );
                 }
                 CONSUME_TOKEN(scanner);
-                result = parse_loop(scanner, container);
+                /* loop names must be checked against the scalars, so those must be recorded first */
+                if ((result = flush_scalars(container, scalars)) == CIF_OK) {
+                    result = parse_loop(scanner, container);
+                }
                 break;
             case NAME:
                 if (scanner->skip_depth > 0) {
                     CONSUME_TOKEN(scanner);
-                    result = parse_item(scanner, container, NULL);
+                    result = parse_item(scanner, container, NULL, scalars);
                 } else {
                     OPTIONAL_VOIDCALL( scanner->dataname_callback, (scanner->line, scanner->column, token_value,
                             token_length, scanner->user_data) );
-                    name = (UChar *) malloc((token_length + 1) * sizeof(UChar));
+                    if (!cif_name_selected_internal(scanner->include_names, scanner->exclude_names, token_value,
+                            token_length)) {
+                        /* pass over the item, as if it were a rejected one */
+                        CONSUME_TOKEN(scanner);
+                        result = parse_item(scanner, container, NULL, scalars);
+                        break;
+                    }
+
+                    /* copy the data name to a separate Unicode string, in transient storage */
+                    cif_arena_mark(&scanner->arena, &name_mark);
+                    name = cif_arena_ustrndup(&scanner->arena, token_value, token_length);
                     if (name == NULL) {
                         result = CIF_MEMORY_ERROR;
                         goto container_end;
                     } else {
-                        /* copy the data name to a separate Unicode string */
-                        u_strncpy(name, token_value, token_length);
-                        name[token_length] = 0;
                         CONSUME_TOKEN(scanner);
     
-                        /* check for dupes */
-                        result = ((container == NULL) ? CIF_NOSUCH_ITEM
-                                : cif_container_get_item_loop(container, name, NULL));
+                        /* check for dupes, among the buffered scalars first */
+                        if (container == NULL) {
+                            result = CIF_NOSUCH_ITEM;
+                        } else if ((scalars != NULL) && (cif_packet_get_item(scalars, name, NULL) == CIF_OK)) {
+                            result = CIF_OK;
+                        } else {
+                            result = cif_container_get_item_loop(container, name, NULL);
+                        }
 
                         if (result == CIF_NOSUCH_ITEM) {
-                            result = parse_item(scanner, container, name);
+                            result = parse_item(scanner, container, name, scalars);
                         } else if (result == CIF_OK) {
                             /* error: duplicate data name */
                             result = scanner->error_callback(CIF_DUP_ITEMNAME, scanner->line,
@@ -1165,10 +1697,10 @@ static int parse_container(struct scanner_s *scanner, cif_container_tp *containe
                                 goto container_end;
                             }
                             /* recover by rejecting the item (but still parsing the associated value) */
-                            result = parse_item(scanner, container, NULL);
+                            result = parse_item(scanner, container, NULL, scalars);
                         }
 
-                        free(name);
+                        cif_arena_release(&scanner->arena, &name_mark);
                     }
                 }
                 break;
@@ -1204,7 +1736,7 @@ static int parse_container(struct scanner_s *scanner, cif_container_tp *containe
                     goto container_end;
                 }
                 /* recover by consuming and discarding the value */
-                result = parse_item(scanner, container, NULL);
+                result = parse_item(scanner, container, NULL, scalars);
                 break;
             case CTABLE:
             case CLIST:
@@ -1236,6 +1768,15 @@ static int parse_container(struct scanner_s *scanner, cif_container_tp *containe
     }
 
     container_end:
+    if (scalars != NULL) {
+        /* record the buffered scalars even after an error, just as they would have been recorded without buffering */
+        int flush_result = flush_scalars(container, scalars);
+
+        if (result == CIF_OK) {
+            result = flush_result;
+        }
+        cif_packet_free(scalars);
+    }
     if (scanner->skip_depth > 0) {
         scanner->skip_depth -= 1;
     }
@@ -1261,16 +1802,81 @@ static int parse_container(struct scanner_s *scanner, cif_container_tp *containe
     return result;
 }
 
-static int parse_item(struct scanner_s *scanner, cif_container_tp *container, UChar *name) {
+static int parse_item(struct scanner_s *scanner, cif_container_tp *container, UChar *name, cif_packet_tp *scalars) {
+    cif_value_tp *value = scanner->item_value;  /* it is safe to re-use the value object of the previous item */
+    int disposition;
+    int result;
+
+    if (scanner->skip_depth > 0) {
+        scanner->skip_depth += 1;
+    }
+
+    /* the parser itself needs the value only if it may record it or present it to the item handler */
+    result = read_item_value(scanner, name, &value,
+            (((name == NULL) || (container == NULL)) ? VALUE_NOT_NEEDED
+                    : ((scanner->item_token_callback == NULL) ? VALUE_NEEDED : VALUE_NEEDED_UNLESS_SKIPPED)),
+            &disposition);
+
+    if (result == CIF_OK) {
+        if (scanner->item_token_callback != NULL) {
+            /* the token callback, if it was invoked, stands in for the item handler */
+            result = disposition;
+        } else if ((name != NULL) && (container != NULL)) {
+            result = OPTIONAL_CALL(scanner->handler->handle_item, (name, value, scanner->user_data), CIF_OK);
+        }
+
+        switch (result) {
+            case CIF_TRAVERSE_CONTINUE:
+                if ((name != NULL) && (container != NULL)) {
+                    assert(scanner->skip_depth <= 0);
+                    assert(value != NULL);
+
+                    if (scalars != NULL) {
+                        /* hand off the value to the scalar buffer, to be recorded later with its siblings */
+                        if ((result = cif_packet_adopt_item_internal(scalars, name, value)) == CIF_OK) {
+                            value = NULL;
+                        }
+                    } else {
+                        /* _copy_ the value into the CIF */
+                        result = cif_container_set_value(container, name, value);
+                    }
+                }
+                break;
+            case CIF_TRAVERSE_SKIP_CURRENT:
+                /* no need to set the skip depth because we don't go any deeper from here */
+                result = CIF_OK;
+                break;
+            case CIF_TRAVERSE_SKIP_SIBLINGS:
+                scanner->skip_depth = 2;
+                result = CIF_OK;
+                break;
+            /* default: do nothing */
+        }
+    }
+
+    /* retain the value object, if any, for the next item */
+    scanner->item_value = value;
+
+    if (scanner->skip_depth > 0) {
+        scanner->skip_depth -= 1;
+    }
+
+    return result;
+}
+
+/*
+ * Reads the value of a data item whose name has just been consumed, recovering from a missing value by providing
+ * an unknown value.  If valuep points to a non-NULL value handle then the referenced value object is modified;
+ * otherwise, a new value object is created and its handle recorded where valuep points.  The item name, the need
+ * for the decoded value, and the disposition are as for parse_item_value().
+ */
+static int read_item_value(struct scanner_s *scanner, UChar *name, cif_value_tp **valuep, int need,
+        int *disposition) {
     int result = next_token(scanner);
 
+    *disposition = CIF_TRAVERSE_CONTINUE;
     if (result == CIF_OK) {
-        cif_value_tp *value = NULL;
         enum token_type alt_ttype = QVALUE;
-    
-        if (scanner->skip_depth > 0) {
-            scanner->skip_depth += 1;
-        }
 
         switch (scanner->ttype) {
             case TKEY:
@@ -1297,8 +1903,8 @@ static int parse_item(struct scanner_s *scanner, cif_container_tp *container, UC
             case TVALUE:
             case QVALUE:
             case VALUE:
-                /* parse the value */
-                result = parse_value(scanner, &value);
+                /* parse or skip the value */
+                result = parse_item_value(scanner, name, valuep, need, disposition);
                 break;
             default:
                 /* error: missing value */
@@ -1307,61 +1913,147 @@ static int parse_item(struct scanner_s *scanner, cif_container_tp *container, UC
                         TVALUE_LENGTH(scanner), scanner->user_data);
                 if (result == CIF_OK) {
                     /* recover by inserting a synthetic unknown value */
-                    result = cif_value_create(CIF_UNK_KIND, &value);
+                    result = ((*valuep == NULL) ? cif_value_create(CIF_UNK_KIND, valuep)
+                            : cif_value_init(*valuep, CIF_UNK_KIND));
+                    if ((result == CIF_OK) && (name != NULL) && (scanner->item_token_callback != NULL)
+                            && (scanner->skip_depth <= 0)) {
+                        /* present the synthetic value to the token callback as an already-decoded token */
+                        struct token_context_s context;
+                        struct cif_token_s token;
+
+                        context.scanner = scanner;
+                        context.valuep = valuep;
+                        context.decoded = CIF_TRUE;
+                        context.result = CIF_OK;
+                        token.kind = CIF_UNK_KIND;
+                        token.quoted = CIF_NOT_QUOTED;
+                        token.text_field = CIF_FALSE;
+                        token.text = NULL;
+                        token.length = 0;
+                        token.context = &context;
+                        *disposition = scanner->item_token_callback(name, &token, scanner->user_data);
+                    }
                 }
                 /* do not consume the token */
                 break;
         }
-    
-        if (result == CIF_OK) {
-            if ((name != NULL) && (container != NULL)) {
-                assert(scanner->skip_depth <= 0);
+    }
 
-                result = OPTIONAL_CALL(scanner->handler->handle_item, (name, value, scanner->user_data), CIF_OK);
-                switch (result) {
-                    case CIF_TRAVERSE_CONTINUE:
-                        /* _copy_ the value into the CIF */
-                        result = cif_container_set_value(container, name, value);
-                        break;
-                    case CIF_TRAVERSE_SKIP_CURRENT:
-                        /* no need to set the skip depth because we don't go any deeper from here */
-                        result = CIF_OK;
-                        break;
-                    case CIF_TRAVERSE_SKIP_SIBLINGS:
-                        scanner->skip_depth = 2;
-                        result = CIF_OK;
-                        break;
-                    /* default: do nothing */
+    return result;
+}
+
+/*
+ * Parses or skips the value whose first token is next in the input, on behalf of the data item having the specified
+ * name (or NULL if the item is being rejected).  If an item token callback is configured, a name is given, and the
+ * parser is not skipping, then that callback is first presented a view of the token, and its return code is recorded
+ * where 'disposition' points; otherwise CIF_TRAVERSE_CONTINUE is recorded there.  The value is afterward decoded as
+ * by parse_value() if the callback requested it via cif_token_get_value(), if 'need' is VALUE_NEEDED, or if 'need' is
+ * VALUE_NEEDED_UNLESS_SKIPPED and the callback did not direct otherwise.  Otherwise the value is skipped, and
+ * *valuep is left unchanged.
+ */
+static int parse_item_value(struct scanner_s *scanner, UChar *name, cif_value_tp **valuep, int need,
+        int *disposition) {
+    struct token_context_s context;
+
+    context.scanner = scanner;
+    context.valuep = valuep;
+    context.decoded = CIF_FALSE;
+    context.result = CIF_OK;
+    *disposition = CIF_TRAVERSE_CONTINUE;
+
+    if ((name != NULL) && (scanner->item_token_callback != NULL) && (scanner->skip_depth <= 0)) {
+        struct cif_token_s token;
+        int result = next_token(scanner);
+
+        if (result != CIF_OK) {
+            return result;
+        }
+
+        token.kind = CIF_CHAR_KIND;
+        token.quoted = CIF_NOT_QUOTED;
+        token.text_field = CIF_FALSE;
+        token.text = TVALUE_START(scanner);
+        token.length = TVALUE_LENGTH(scanner);
+        token.context = &context;
+
+        switch (scanner->ttype) {
+            case OLIST:
+                token.kind = CIF_LIST_KIND;
+                token.text = NULL;
+                token.length = 0;
+                break;
+            case OTABLE:
+                token.kind = CIF_TABLE_KIND;
+                token.text = NULL;
+                token.length = 0;
+                break;
+            case TVALUE:
+                token.text_field = CIF_TRUE;
+                /* fall through */
+            case QVALUE:
+                token.quoted = CIF_QUOTED;
+                break;
+            default:
+                /* special cases for unquoted question mark (?) and period (.) */
+                if (token.length == 1) {
+                    if (*token.text == UCHAR_QUERY) {
+                        token.kind = CIF_UNK_KIND;
+                    } else if (*token.text == UCHAR_DECIMAL) {
+                        token.kind = CIF_NA_KIND;
+                    }
                 }
-                
-            }
-            cif_value_free(value); /* ignore any error */
+                break;
         }
 
-        if (scanner->skip_depth > 0) {
-            scanner->skip_depth -= 1;
+        *disposition = scanner->item_token_callback(name, &token, scanner->user_data);
+        if (context.result != CIF_OK) {
+            /* decoding on behalf of the callback failed */
+            return context.result;
+        } else if ((*disposition != CIF_TRAVERSE_CONTINUE) && (*disposition != CIF_TRAVERSE_SKIP_CURRENT)
+                && (*disposition != CIF_TRAVERSE_SKIP_SIBLINGS)) {
+            /* the parse is ending one way or another; the value will not be wanted */
+            return CIF_OK;
         }
     }
 
-    return result;
+    if (context.decoded) {
+        return CIF_OK;
+    } else if ((need == VALUE_NEEDED)
+            || ((need == VALUE_NEEDED_UNLESS_SKIPPED) && (*disposition == CIF_TRAVERSE_CONTINUE))) {
+        return parse_value(scanner, valuep);
+    } else {
+        return skip_value(scanner);
+    }
 }
 
 static int parse_loop(struct scanner_s *scanner, cif_container_tp *container) {
     string_element_tp *first_name = NULL;          /* the first data name in the header */
     int name_count = 0;
+    int selected_count = 0;
     cif_loop_tp *loop = NULL;
+    arena_mark_tp loop_mark;                       /* the header names and other loop-scoped objects follow this */
     int result;
 
     if (scanner->skip_depth > 0) {
         scanner->skip_depth += 1;
     }
 
+    cif_arena_mark(&scanner->arena, &loop_mark);
+
     /* parse the header */
-    result = parse_loop_header(scanner, container, &first_name, &name_count);
+    result = parse_loop_header(scanner, container, &first_name, &name_count, &selected_count);
     
     if (result == CIF_OK) {
         /* name_count is the number of data names in the header, including dupes and invalid ones */
-        if (name_count == 0) {
+        if ((name_count > 0) && (selected_count == 0)) {
+            /* no data name is selected for loading, so pass over the whole loop */
+            result = skip_loop_packets(scanner, name_count);
+            cif_arena_release(&scanner->arena, &loop_mark);
+            if (scanner->skip_depth > 0) {
+                scanner->skip_depth -= 1;
+            }
+            return result;
+        } else if (name_count == 0) {
             /* error: empty loop header */
             result = scanner->error_callback(CIF_NULL_LOOP, scanner->line, scanner->column - TVALUE_LENGTH(scanner),
                     TVALUE_START(scanner), 0, scanner->user_data);
@@ -1371,7 +2063,7 @@ static int parse_loop(struct scanner_s *scanner, cif_container_tp *container) {
             /* recover by ignoring it */
         } else {
             /* an array of data names for creating the loop; elements belong to the linked list, not this array */
-            UChar **names = (UChar **) malloc((name_count + 1) * sizeof(UChar *));
+            UChar **names = (UChar **) cif_arena_alloc(&scanner->arena, (name_count + 1) * sizeof(UChar *));
 
             if (names == NULL) {
                 result = CIF_MEMORY_ERROR;
@@ -1438,24 +2130,15 @@ static int parse_loop(struct scanner_s *scanner, cif_container_tp *container) {
                 if (dummy_loop.category != NULL) {
                     free(dummy_loop.category);
                 }
-                free(names);
-                /* elements of names belong to the linked list; they are freed later */
+                /* names and its elements are released with the rest of the loop's transient storage */
             } /* end ifelse (names) */
         } /* end ifelse (name_count) */
     } /* end if (header result) */
 
     loop_end:
 
-    /* clean up the header name linked list */
-    while (first_name != NULL) {
-        string_element_tp *next = first_name->next;
-
-        if (first_name->string != NULL) {
-            free(first_name->string);
-        }
-        free(first_name);
-        first_name = next;
-    }
+    /* release the header name linked list, the names array, and the packet value array */
+    cif_arena_release(&scanner->arena, &loop_mark);
 
     if (scanner->skip_depth > 0) {
         scanner->skip_depth -= 1;
@@ -1481,7 +2164,7 @@ static int parse_loop(struct scanner_s *scanner, cif_container_tp *container) {
 }
 
 static int parse_loop_header(struct scanner_s *scanner, cif_container_tp *container, string_element_tp **name_list_head,
-        int *name_countp) {
+        int *name_countp, int *selected_countp) {
     string_element_tp **next_namep = name_list_head;  /* a pointer to the pointer to the next data name in the header */
     int result;
 
@@ -1495,18 +2178,23 @@ static int parse_loop_header(struct scanner_s *scanner, cif_container_tp *contai
                     token_value, token_length, scanner->user_data) );
         }
 
-        *next_namep = (string_element_tp *) malloc(sizeof(string_element_tp));
+        /* the list nodes and names are allocated from the arena; the caller releases them */
+        *next_namep = (string_element_tp *) cif_arena_alloc(&scanner->arena, sizeof(string_element_tp));
         if (*next_namep == NULL) {
             return CIF_MEMORY_ERROR;
+        } else if (!cif_name_selected_internal(scanner->include_names, scanner->exclude_names, token_value,
+                token_length)) {
+            /* a place-holder is retained for the unselected name, as for a duplicate one */
+            (*next_namep)->next = NULL;
+            (*next_namep)->string = NULL;
+            next_namep = &((*next_namep)->next);
+            *name_countp += 1;
         } else {
             (*next_namep)->next = NULL;
-            (*next_namep)->string = (UChar *) malloc((token_length + 1) * sizeof(UChar));
+            (*next_namep)->string = cif_arena_ustrndup(&scanner->arena, token_value, token_length);
             if ((*next_namep)->string == NULL) {
                 return CIF_MEMORY_ERROR;
             } else {
-                u_strncpy((*next_namep)->string, token_value, token_length);
-                (*next_namep)->string[token_length] = 0;
-
                 /* check for data name duplication */
                 switch (result = ((container == NULL) ? CIF_NOSUCH_ITEM
                             : cif_container_get_item_loop(container, (*next_namep)->string, NULL))) {
@@ -1521,7 +2209,6 @@ static int parse_loop_header(struct scanner_s *scanner, cif_container_tp *contai
                             /* recover by ignoring the name, and later its associated values in the loop body */
                             /* a place-holder is retained in the list so that packet values can be counted and assigned
                                correctly */
-                            free((*next_namep)->string);
                             (*next_namep)->string = NULL;
                             break;
                         }
@@ -1532,6 +2219,7 @@ static int parse_loop_header(struct scanner_s *scanner, cif_container_tp *contai
 
                 next_namep = &((*next_namep)->next);
                 *name_countp += 1;
+                *selected_countp += 1;
             }
         }
 
@@ -1548,7 +2236,8 @@ static int parse_loop_packets(struct scanner_s *scanner, cif_loop_tp *loop, stri
 
     /* read packets */
     if (result == CIF_OK) {
-        cif_value_tp **packet_values = (cif_value_tp **) malloc(column_count * sizeof(cif_value_tp *));
+        cif_value_tp **packet_values = (cif_value_tp **) cif_arena_alloc(&scanner->arena,
+                column_count * sizeof(cif_value_tp *));
 
         if (packet_values == NULL) {
             result = CIF_MEMORY_ERROR;
@@ -1586,6 +2275,8 @@ static int parse_loop_packets(struct scanner_s *scanner, cif_loop_tp *loop, stri
                 while ((result = next_token(scanner)) == CIF_OK) {
                     UChar *name;
                     cif_value_tp *value = NULL;
+                    int need;
+                    int disposition;
                     enum token_type alt_ttype = QVALUE;
 
                     switch (scanner->ttype) {
@@ -1639,10 +2330,29 @@ static int parse_loop_packets(struct scanner_s *scanner, cif_loop_tp *loop, stri
                             name = next_name->string;
                             value = packet_values[column_index];  /* it is safe to re-use the existing value object */
 
+                            /*
+                             * The parser itself needs the value if an item handler expects it, or if the packet may
+                             * be recorded or presented to the packet handler
+                             */
+                            if (name == NULL) {
+                                /* the column is ignored */
+                                need = VALUE_NOT_NEEDED;
+                            } else if ((scanner->item_token_callback == NULL)
+                                    && (scanner->handler->handle_item != NULL)) {
+                                need = VALUE_NEEDED;
+                            } else if ((scanner->skip_depth <= 0)
+                                    && ((loop != NULL) || (scanner->handler->handle_packet_end != NULL))) {
+                                need = VALUE_NEEDED;
+                            } else {
+                                need = VALUE_NOT_NEEDED;
+                            }
+
                             /* parse the value */
-                            if ((result = parse_value(scanner, &value)) == CIF_OK) {
-                                result = OPTIONAL_CALL(scanner->handler->handle_item,
-                                        (name, value, scanner->user_data), CIF_OK);
+                            if (((result = parse_item_value(scanner, name, &value, need, &disposition)) == CIF_OK)
+                                    && (name != NULL)) {
+                                result = ((scanner->item_token_callback != NULL) ? disposition
+                                        : OPTIONAL_CALL(scanner->handler->handle_item,
+                                                (name, value, scanner->user_data), CIF_OK));
                                 switch (result) {
                                     case CIF_TRAVERSE_SKIP_CURRENT:
                                         result = CIF_OK;
@@ -1766,7 +2476,7 @@ static int parse_loop_packets(struct scanner_s *scanner, cif_loop_tp *loop, stri
                 packets_end:
                 cif_value_free(dummy_value);
             } /* end if (result == CIF_OK) [of cif_value_create()] */
-            free(packet_values);  /* free only the array; its elements belong to the packet */
+            /* the array is released with the loop's other transient storage; its elements belong to the packet */
         } /* end if (packet_values != NULL) */
         cif_packet_free(packet);
     } /* end if (cif_packet_create()) */
@@ -1774,6 +2484,85 @@ static int parse_loop_packets(struct scanner_s *scanner, cif_loop_tp *loop, stri
     return result;
 }
 
+/*
+ * Passes over the body of a loop none of whose data names is selected for loading, without decoding its values or
+ * invoking any handler callbacks, but detecting the same syntax errors that parse_loop_packets() would detect.
+ */
+static int skip_loop_packets(struct scanner_s *scanner, int column_count) {
+    int have_packets = CIF_FALSE;
+    int column_index = 0;
+    int result;
+
+    while ((result = next_token(scanner)) == CIF_OK) {
+        enum token_type alt_ttype = QVALUE;
+
+        switch (scanner->ttype) {
+            case TKEY:
+                alt_ttype = TVALUE;
+                /* fall through */
+            case KEY:
+                /* error: missing whitespace (or that's how we interpret it, anyway) */
+                result = scanner->error_callback(CIF_MISSING_SPACE, scanner->line,
+                        scanner->column - TVALUE_LENGTH(scanner), TVALUE_START(scanner),
+                        TVALUE_LENGTH(scanner), scanner->user_data);
+                if (result != CIF_OK) {
+                    return result;
+                }
+                /* recover by pushing back the colon */
+                scanner->next_char -= 1;
+                scanner->ttype = alt_ttype;  /* TVALUE or QVALUE */
+
+                /* notify the configured whitespace callback, if any, of zero-length whitespace */
+                OPTIONAL_VOIDCALL(scanner->whitespace_callback, (scanner->line, scanner->column,
+                        scanner->next_char - 1, 0, scanner->user_data));
+
+                /* fall through */
+            case OLIST:  /* opening delimiter of a list value */
+            case OTABLE: /* opening delimiter of a table value */
+            case TVALUE:
+            case QVALUE:
+            case VALUE:
+                if ((result = skip_value(scanner)) != CIF_OK) {
+                    return result;
+                }
+                column_index = (column_index + 1) % column_count;
+                if (column_index == 0) {
+                    have_packets = CIF_TRUE;
+                }
+                break;
+            case CLIST:
+            case CTABLE:
+                /* error: unexpected list/table delimiter */
+                result = scanner->error_callback(CIF_UNEXPECTED_DELIM, scanner->line,
+                        scanner->column - TVALUE_LENGTH(scanner), TVALUE_START(scanner),
+                        TVALUE_LENGTH(scanner), scanner->user_data);
+                if (result != CIF_OK) {
+                    return result;
+                }
+                /* recover by dropping it; the loop body is not terminated */
+                CONSUME_TOKEN(scanner);
+                break;
+            default: /* any other token type terminates the loop body */
+                if (column_index != 0) {
+                    /* error: partial packet */
+                    return scanner->error_callback(CIF_PARTIAL_PACKET, scanner->line,
+                            scanner->column - TVALUE_LENGTH(scanner), TVALUE_START(scanner), 0,
+                            scanner->user_data);
+                } else if (!have_packets) {
+                    /* error: no packets */
+                    return scanner->error_callback(CIF_EMPTY_LOOP, scanner->line,
+                            scanner->column - TVALUE_LENGTH(scanner), TVALUE_START(scanner),
+                            TVALUE_LENGTH(scanner), scanner->user_data);
+                }
+
+                /* the token is not consumed or examined in any way */
+                return CIF_OK;
+        }
+    }
+
+    return result;
+}
+
 static int parse_list(struct scanner_s *scanner, cif_value_tp **listp) {
     cif_value_tp *list = NULL;
     size_t next_index = 0;
@@ -1886,6 +2675,10 @@ static int parse_table(struct scanner_s *scanner, cif_value_tp **tablep) {
         /* parse (key, value) pairs */
         UChar *key = NULL;
         cif_value_tp *value = NULL;
+        arena_mark_tp key_mark;
+
+        /* keys are copied into the table, so the scanned key can be transient */
+        cif_arena_mark(&scanner->arena, &key_mark);
 
         /* scan the next key, if any */
 
@@ -1947,10 +2740,8 @@ static int parse_table(struct scanner_s *scanner, cif_value_tp **tablep) {
                 /* fall through */
             case KEY:  /* this and CTABLE are the only genuinely valid token types here */
                 /* copy the key to a NUL-terminated Unicode string */
-                key = (UChar *) malloc((TVALUE_LENGTH(scanner) + 1) * sizeof(UChar));
+                key = cif_arena_ustrndup(&scanner->arena, TVALUE_START(scanner), (int32_t) TVALUE_LENGTH(scanner));
                 if (key != NULL) {
-                    u_strncpy(key, TVALUE_START(scanner), TVALUE_LENGTH(scanner));
-                    key[TVALUE_LENGTH(scanner)] = 0;
                     CONSUME_TOKEN(scanner);    
                     break;
                 }
@@ -1965,8 +2756,17 @@ static int parse_table(struct scanner_s *scanner, cif_value_tp **tablep) {
                     /* recover by using the text field contents as a key */
                     if ((result = decode_text(scanner, TVALUE_START(scanner),
                             TVALUE_LENGTH(scanner), &value)) == CIF_OK) {
-                        result = cif_value_get_text(value, &key);
+                        UChar *text;
+
+                        if ((result = cif_value_get_text(value, &text)) == CIF_OK) {
+                            key = cif_arena_ustrndup(&scanner->arena, text, u_strlen(text));
+                            free(text);
+                            if (key == NULL) {
+                                result = CIF_MEMORY_ERROR;
+                            }
+                        }
                         cif_value_free(value); /* ignore any error */
+                        value = NULL;
                         CONSUME_TOKEN(scanner);
                         if (result == CIF_OK) {
                             break;
@@ -2009,7 +2809,7 @@ static int parse_table(struct scanner_s *scanner, cif_value_tp **tablep) {
         if ((key != NULL)
                 && (((result = cif_value_set_item_by_key(table, key, NULL)) != CIF_OK) 
                         || ((result = cif_value_get_item_by_key(table, key, &value)) != CIF_OK))) {
-            free(key);
+            cif_arena_release(&scanner->arena, &key_mark);
             break;
         }
 
@@ -2037,10 +2837,8 @@ static int parse_table(struct scanner_s *scanner, cif_value_tp **tablep) {
 
         if (key == NULL) {
             cif_value_free(value); /* ignore any error */
-        } else {
-            /* the value belongs to the table */
-            free(key);
-        }
+        } /* else the value belongs to the table */
+        cif_arena_release(&scanner->arena, &key_mark);
     } /* while */
 
     table_end:
@@ -2154,6 +2952,71 @@ static int parse_value(struct scanner_s *scanner, cif_value_tp **valuep) {
     return result;
 }
 
+/*
+ * Consumes the value whose first token is next in the input without recording it, but detecting the same errors that
+ * parse_value() would detect.  Only composite values are actually decoded, for their extent cannot otherwise be
+ * determined.
+ */
+static int skip_value(struct scanner_s *scanner) {
+    int result = next_token(scanner);
+
+    if (result == CIF_OK) {
+        cif_value_tp *value = NULL;
+        UChar *token_value;
+        int32_t token_length;
+
+        switch (scanner->ttype) {
+            case OLIST:  /* opening delimiter of a list value */
+            case OTABLE: /* opening delimiter of a table value */
+                if ((result = parse_value(scanner, &value)) == CIF_OK) {
+                    cif_value_free(value);  /* ignore any error */
+                }
+                /* the token is already consumed by parse_value() */
+                break;
+            case VALUE:
+                token_value = TVALUE_START(scanner);
+                token_length = TVALUE_LENGTH(scanner);
+
+                /* in CIF 2, reserved strings cannot be presented unquoted */
+                if (scanner->cif_version >= 2) {
+                    /* insert a string terminator into the input buffer, after the current token */
+                    UChar saved = *(token_value + token_length);
+                    int reserved;
+
+                    *(token_value + token_length) = 0;
+                    reserved = cif_is_reserved_string(token_value);
+                    *(token_value + token_length) = saved;
+                    if (reserved) {
+                        result = scanner->error_callback(CIF_INVALID_BARE_VALUE, scanner->line,
+                                scanner->column, TVALUE_START(scanner), 1, scanner->user_data);
+                    }
+                }
+                CONSUME_TOKEN(scanner);
+                break;
+            case TVALUE:
+            case QVALUE:
+                CONSUME_TOKEN(scanner);
+                break;
+            default:
+                /* This function should be called only when the incoming token is or starts a value */
+                result = CIF_INTERNAL_ERROR;
+                break;
+        }
+    }
+
+    return result;
+}
+
+static int flush_scalars(cif_container_tp *container, cif_packet_tp *scalars) {
+    int result = CIF_OK;
+
+    if ((scalars != NULL) && (scalars->map.size > 0)) {
+        result = cif_container_set_values_internal(container, scalars, CIF_TRUE);
+        cif_map_clean_internal(&(scalars->map));
+    }
+
+    return result;
+}
 
 /*
  * Decodes the contents of a text block by un-prefixing and unfolding lines as appropriate, and standardizing line
@@ -3059,8 +3922,8 @@ static int scan_text(struct scanner_s *scanner) {
 }
 
 /*
- * Transfers one or possibly two characters from the provided scanner's character source into its working character
- * buffer, provided that any are available.  Assumes that no characters have yet been transferred, and that the CIF
+ * Transfers one character from the provided scanner's character source into its working character buffer, provided
+ * that any are available.  Assumes that no characters have yet been transferred, and that the CIF
  * version being parsed may not yet be known.  Will raise the end-of-file flag if called when there are no characters
  * available.  Returns CIF_OK if any characters are transferred, CIF_EOF if the EOF flag is raised without
  * transferring any characters, or CIF_ERROR otherwise.
@@ -3099,17 +3962,8 @@ static int get_first_char(struct scanner_s *scanner) {
         } else if (ch == UCHAR_CR) { /* convert CR and CRLF to LF */
             *scanner->buffer = UCHAR_NL;
 
-            /* try to convert one more character, to check for CRLF */
-            nread = scanner->read_func(scanner->char_source, scanner->buffer + 1, scanner->buffer_size - 1,
-                    &read_error);
-            if (nread < 0) {
-                return read_error;
-            } else if (nread == 0) {
-                scanner->at_eof = CIF_TRUE;  /* but don't return CIF_EOF, because we do provide one character */
-            } else if (*(scanner->buffer + 1) != UCHAR_NL) {
-                scanner->buffer_limit += 1;
-            } /* else the buffer limit will overall be increased by 1 only, effectively consuming the NL */
-
+            /* get_more_chars() drops the LF of a CRLF, if one follows */
+            scanner->pending_cr = CIF_TRUE;
         }
 
         scanner->buffer_limit += 1;
@@ -3130,6 +3984,7 @@ static int get_more_chars(struct scanner_s *scanner) {
     size_t chars_consumed = scanner->text_start - scanner->buffer;
     ssize_t nread;
     int read_error;
+    int split_crlf;
 
     assert(chars_read < SSIZE_T_MAX);
     assert(chars_consumed <= chars_read); /* chars_consumed == chars_read only at the beginning of a parse */
@@ -3180,9 +4035,23 @@ static int get_more_chars(struct scanner_s *scanner) {
         scanner->buffer_limit = current_chars;
     } /* else just append to the currently buffered data */
 
-    /* once EOF has been detected, don't attempt to read from the character source any more */
-    nread = scanner->at_eof ? 0 : scanner->read_func(scanner->char_source, scanner->buffer + scanner->buffer_limit,
-                scanner->buffer_size - scanner->buffer_limit, &read_error);
+    do {
+        split_crlf = CIF_FALSE;
+
+        /* once EOF has been detected, don't attempt to read from the character source any more */
+        nread = scanner->at_eof ? 0 : scanner->read_func(scanner->char_source, scanner->buffer + scanner->buffer_limit,
+                    scanner->buffer_size - scanner->buffer_limit, &read_error);
+
+        if ((nread > 0) && scanner->pending_cr) {
+            scanner->pending_cr = CIF_FALSE;
+            if (scanner->buffer[scanner->buffer_limit] == UCHAR_NL) {
+                /* the LF of a CRLF split between reads, whose CR has already been converted to LF */
+                split_crlf = CIF_TRUE;
+                nread -= 1;
+                u_memmove(scanner->buffer + scanner->buffer_limit, scanner->buffer + scanner->buffer_limit + 1, nread);
+            }
+        }
+    } while (split_crlf && (nread == 0));
 
     if (nread < 0) {
         return read_error;
@@ -3196,9 +4065,15 @@ static int get_more_chars(struct scanner_s *scanner) {
         UChar *trail;
         UChar *dest;
 
+        /* a CR ending this read may be the first half of a CRLF */
+        scanner->pending_cr = (*(bound - 1) == UCHAR_CR);
+
         do {
             lead = u_memchr(lead, UCHAR_CR, bound - lead);
-            if ((!lead) || ((lead + 1 < bound) && (*(lead + 1) == UCHAR_NL))) {
+            if (!lead) {
+                break;
+            } else if ((lead + 1 < bound) && (*(lead + 1) == UCHAR_NL)) {
+                nread -= 1; /* CRLF will be converted to just LF */
                 break;
             } else {
                 *lead = UCHAR_NL;
@@ -43,6 +43,43 @@
  */
 static int cif_pktitr_reset_packet_number(cif_loop_tp *loop);
 
+/*
+ * Determines whether the specified packet has exactly the specified normalized item names, in any order, so that it
+ * can be refilled in place with the values of the next packet of an iteration over those names
+ */
+static int cif_pktitr_packet_matches(cif_packet_tp *packet, UChar **names);
+
+/*
+ * Reads the values of the iterator's current packet into the specified packet, which must contain an entry of kind
+ * CIF_UNK_KIND for each of the iterator's item names, and advances the iterator to the next packet.
+ *
+ * Returns CIF_OK on success or an error code (probably CIF_ERROR) on failure
+ */
+static int cif_pktitr_read_packet(cif_pktitr_tp *iterator, cif_packet_tp *packet, int borrow);
+
+/*
+ * Copies the specified number of chars of the specified string into memory allocated from the iterator's arena, and
+ * NUL-terminates the copy.  Returns a pointer to the copy, or NULL if memory could not be allocated.
+ */
+static char *cif_pktitr_arena_strndup(cif_pktitr_tp *iterator, const char *src, size_t length);
+
+/*
+ * Copies an optional string out of the specified column of the iterator's statement into the iterator's arena.  The
+ * text variant records NULL if the column is NULL; the digits variant does the same, and otherwise formats integer
+ * columns as the digits of their magnitude, in the manner of GET_COLUMN_DIGITS.
+ */
+static int cif_pktitr_borrow_text(cif_pktitr_tp *iterator, int col, UChar **text);
+static int cif_pktitr_borrow_digits(cif_pktitr_tp *iterator, int col, char **digits, int *sign);
+
+/*
+ * Sets the specified value, of kind CIF_UNK_KIND, from the columns of the iterator's statement starting at the
+ * specified offset, as GET_VALUE_PROPS does, except that the value's data are copied into the iterator's arena and
+ * marked as borrowed instead of being separately allocated.  On failure, the value is left of kind CIF_UNK_KIND.
+ *
+ * Returns CIF_OK on success or an error code (probably CIF_INTERNAL_ERROR or CIF_MEMORY_ERROR) on failure
+ */
+static int cif_pktitr_borrow_value(cif_pktitr_tp *iterator, int col_ofs, cif_value_tp *value);
+
 static int cif_pktitr_reset_packet_number(cif_loop_tp *loop) {
     FAILURE_HANDLING;
     STEP_HANDLING;
@@ -66,6 +103,221 @@ static int cif_pktitr_reset_packet_number(cif_loop_tp *loop) {
     FAILURE_TERMINUS;
 }
 
+static int cif_pktitr_packet_matches(cif_packet_tp *packet, UChar **names) {
+    size_t count;
+
+    for (count = 0; names[count] != NULL; count += 1) {
+        if (cif_map_find_internal(&(packet->map), names[count]) == NULL) {
+            return CIF_FALSE;
+        }
+    }
+
+    return (count == packet->map.size);
+}
+
+static int cif_pktitr_read_packet(cif_pktitr_tp *iterator, cif_packet_tp *packet, int borrow) {
+    FAILURE_HANDLING;
+    sqlite3_stmt *stmt = iterator->stmt;
+    int current_row = sqlite3_column_int(stmt, 0);
+
+    while (CIF_TRUE) {
+        const UChar *name;
+        struct entry_s *entry;
+        int next_row;
+
+        /* For which item is this value? */
+
+        /* will be freed automatically by SQLite: */
+        name = (const UChar *) sqlite3_column_text16(stmt, 1);
+
+        if (!name) {
+            DEFAULT_FAIL(soft);
+        }
+
+        entry = cif_map_find_internal(&(packet->map), name);
+        if ((entry == NULL) || entry->value->kind != CIF_UNK_KIND) {
+            /* The item was expected to have a dummy value pre-recorded in the packet */
+            FAIL(soft, CIF_INTERNAL_ERROR);
+        }
+
+        /* set value properties from the DB */
+        if (borrow) {
+            int result = cif_pktitr_borrow_value(iterator, 2, entry->value);
+
+            if (result != CIF_OK) FAIL(soft, result);
+        } else {
+            GET_VALUE_PROPS(stmt, 2, entry->value, soft);
+        }
+
+        /* check whether there are any more values for the current packet */
+        switch (sqlite3_step(stmt)) {
+            case SQLITE_ROW:
+                next_row = sqlite3_column_int(stmt, 0);
+                if (next_row == current_row) {
+                    /* there is another value for this packet; loop back to handle it */
+                    continue;
+                } /* else that was the last value for the packet, but there is another packet after it */
+                break;
+            case SQLITE_DONE:
+                /* that was the last value for the last packet */
+                iterator->finished = 1;
+                break;
+            default:
+                DEFAULT_FAIL(soft);
+        }
+
+        /* the current packet has been fully read from the DB */
+        iterator->previous_row_num = current_row;
+
+        return CIF_OK;
+    }
+
+    FAILURE_HANDLER(soft):
+    FAILURE_TERMINUS;
+}
+
+static char *cif_pktitr_arena_strndup(cif_pktitr_tp *iterator, const char *src, size_t length) {
+    char *dest = (char *) cif_arena_alloc(&(iterator->arena), length + 1);
+
+    if (dest != NULL) {
+        memcpy(dest, src, length);
+        dest[length] = '\0';
+    }
+
+    return dest;
+}
+
+static int cif_pktitr_borrow_text(cif_pktitr_tp *iterator, int col, UChar **text) {
+    /* will be freed automatically by SQLite: */
+    const UChar *string_val = (const UChar *) sqlite3_column_text16(iterator->stmt, col);
+
+    if (string_val == NULL) {
+        *text = NULL;
+    } else {
+        int32_t value_chars = (int32_t) (sqlite3_column_bytes16(iterator->stmt, col) / sizeof(UChar));
+
+        *text = cif_arena_ustrndup(&(iterator->arena), string_val, value_chars);
+        if (*text == NULL) return CIF_MEMORY_ERROR;
+    }
+
+    return CIF_OK;
+}
+
+static int cif_pktitr_borrow_digits(cif_pktitr_tp *iterator, int col, char **digits, int *sign) {
+    sqlite3_stmt *stmt = iterator->stmt;
+
+    if (sqlite3_column_type(stmt, col) == SQLITE_INTEGER) {
+        sqlite3_int64 digits_val = sqlite3_column_int64(stmt, col);
+        char buffer[INT64_DIGITS_SIZE];
+        char *formatted = cif_int64_format_digits_internal(digits_val, buffer);
+
+        *sign = ((digits_val < 0) ? -1 : 1);
+        *digits = cif_pktitr_arena_strndup(iterator, formatted, strlen(formatted));
+    } else {
+        /* will be freed automatically by SQLite: */
+        const char *string_val = (const char *) sqlite3_column_text(stmt, col);
+
+        *sign = 1;
+        if (string_val == NULL) {
+            *digits = NULL;
+            return CIF_OK;
+        }
+        *digits = cif_pktitr_arena_strndup(iterator, string_val, (size_t) sqlite3_column_bytes(stmt, col));
+    }
+
+    return ((*digits == NULL) ? CIF_MEMORY_ERROR : CIF_OK);
+}
+
+static int cif_pktitr_borrow_value(cif_pktitr_tp *iterator, int col_ofs, cif_value_tp *value) {
+    sqlite3_stmt *stmt = iterator->stmt;
+    cif_kind_tp kind = (cif_kind_tp) sqlite3_column_int(stmt, col_ofs);
+    cif_quoted_tp quoted = (sqlite3_column_int(stmt, col_ofs + 1) ? CIF_QUOTED : CIF_NOT_QUOTED);
+    cif_numb_tp *numb = &(value->as_numb);
+    const void *blob;
+    void *copy;
+    int sign;
+    int result;
+
+    switch (kind) {
+        case CIF_CHAR_KIND:
+            if ((result = cif_pktitr_borrow_text(iterator, col_ofs + 3, &(value->as_char.text))) != CIF_OK) {
+                return result;
+            } else if (value->as_char.text == NULL) {
+                /* a plain decimal stored compactly; reconstruct the text */
+                sqlite3_int64 digits = sqlite3_column_int64(stmt, col_ofs + 4);
+                sqlite3_int64 su = ((sqlite3_column_type(stmt, col_ofs + 5) == SQLITE_NULL)
+                        ? -1 : sqlite3_column_int64(stmt, col_ofs + 5));
+                int scale = sqlite3_column_int(stmt, col_ofs + 6);
+                size_t text_length = cif_decimal_text_length_internal(digits, su, scale);
+
+                if ((sqlite3_column_type(stmt, col_ofs + 4) != SQLITE_INTEGER) || (text_length == 0)) {
+                    return CIF_INTERNAL_ERROR;
+                }
+                value->as_char.text = (UChar *) cif_arena_alloc(&(iterator->arena), text_length * sizeof(UChar));
+                if (value->as_char.text == NULL) return CIF_MEMORY_ERROR;
+                cif_decimal_write_text_internal(digits, su, scale, value->as_char.text);
+            }
+            value->as_char.quoted = quoted;
+            value->as_char.shared = &cif_borrowed_data;
+            value->as_char.text_class = sqlite3_column_int(stmt, col_ofs + 7);
+            break;
+        case CIF_NUMB_KIND:
+            if (((result = cif_pktitr_borrow_text(iterator, col_ofs + 3, &(numb->text))) != CIF_OK)
+                    || ((result = cif_pktitr_borrow_digits(iterator, col_ofs + 4, &(numb->digits), &(numb->sign)))
+                            != CIF_OK)
+                    || ((result = cif_pktitr_borrow_digits(iterator, col_ofs + 5, &(numb->su_digits), &sign))
+                            != CIF_OK)) {
+                return result;
+            } else if ((numb->digits == NULL) || (*(numb->digits) == '\0')) {
+                return CIF_INTERNAL_ERROR;
+            }
+            numb->scale = sqlite3_column_int(stmt, col_ofs + 6);
+            if (numb->text == NULL) {
+                /* compactly stored; reconstruct the text */
+                size_t text_length = cif_numb_text_length_internal(numb);
+
+                if (text_length == 0) return CIF_INTERNAL_ERROR;
+                numb->text = (UChar *) cif_arena_alloc(&(iterator->arena), text_length * sizeof(UChar));
+                if (numb->text == NULL) return CIF_MEMORY_ERROR;
+                cif_numb_write_text_internal(numb, numb->text);
+            } else if (*(numb->text) == 0) {
+                return CIF_INTERNAL_ERROR;
+            } else {
+                numb->sign = ((*(numb->text) == UCHAR_MINUS) ? -1 : 1);
+            }
+            numb->quoted = quoted;
+            numb->shared = &cif_borrowed_data;
+            break;
+        case CIF_LIST_KIND:
+        case CIF_TABLE_KIND:
+            /* will be freed automatically by SQLite: */
+            blob = sqlite3_column_blob(stmt, col_ofs + 2);
+            if (blob == NULL) {
+                return CIF_INTERNAL_ERROR;
+            } else {
+                size_t size = (size_t) sqlite3_column_bytes(stmt, col_ofs + 2);
+
+                if ((copy = cif_arena_alloc(&(iterator->arena), size)) == NULL) {
+                    return CIF_MEMORY_ERROR;
+                }
+                memcpy(copy, blob, size);
+                if (cif_value_deserialize_borrowed_internal(copy, size, value) != CIF_OK) {
+                    cif_value_clean(value);
+                    return CIF_INTERNAL_ERROR;
+                }
+            }
+            return CIF_OK;
+        case CIF_UNK_KIND:
+        case CIF_NA_KIND:
+            break;
+        default:
+            return CIF_INTERNAL_ERROR;
+    }
+
+    value->kind = kind;
+    return CIF_OK;
+}
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -125,13 +377,14 @@ void cif_pktitr_free(
 
     sqlite3_finalize(iterator->stmt); /* harmless if the stmt is NULL */
 
+    if (iterator->borrowed_packet != NULL) {
+        cif_packet_free(iterator->borrowed_packet);
+    }
+    cif_arena_destroy(&(iterator->arena));
+
     free(iterator);
 }
 
-/* All uthash fatal errors arise from memory allocation failure */
-#undef uthash_fatal
-#define uthash_fatal(msg) FAIL(soft, CIF_MEMORY_ERROR)
-
 int cif_pktitr_next_packet(
         cif_pktitr_tp *iterator,
         cif_packet_tp **packet
@@ -140,8 +393,6 @@ int cif_pktitr_next_packet(
         return CIF_FINISHED;
     } else {
         FAILURE_HANDLING;
-        sqlite3_stmt *stmt = iterator->stmt;
-        int current_row = sqlite3_column_int(stmt, 0);
         cif_packet_tp *temp_packet;
         int result;
     
@@ -151,6 +402,17 @@ int cif_pktitr_next_packet(
             /* no transaction is active -- the provided iterator is stale */
             return CIF_INVALID_HANDLE;
         }
+
+        if ((packet != NULL) && (*packet != NULL) && cif_pktitr_packet_matches(*packet, iterator->item_names)) {
+            /* the caller's packet has exactly the expected items; refill its value objects in place */
+            size_t position;
+
+            for (position = 0; position < (*packet)->map.size; position += 1) {
+                cif_value_clean((*packet)->map.entries[position].value);
+            }
+
+            return cif_pktitr_read_packet(iterator, *packet, CIF_FALSE);
+        }
     
         /* create a new packet for the expected items, with all unknown values */
         /* Relies on the item names to be pre-normalized */
@@ -158,129 +420,133 @@ int cif_pktitr_next_packet(
             SET_RESULT(result);
         } else {
             /* populate the packet with values read from the DB */
-            while (CIF_TRUE) {
-                const UChar *name;
-                struct entry_s *entry;
-                int next_row;
-    
-                /* For which item is this value? */
-    
-                /* will be freed automatically by SQLite: */
-                name = (const UChar *) sqlite3_column_text16(stmt, 1);
-    
-                if (!name) {
-                    DEFAULT_FAIL(soft);
-                }
+            if ((result = cif_pktitr_read_packet(iterator, temp_packet, CIF_FALSE)) != CIF_OK) {
+                FAIL(soft, result);
+            }
 
-                HASH_FIND(hh, temp_packet->map.head, name, U_BYTES(name), entry);
-                if ((entry == NULL) || entry->as_value.kind != CIF_UNK_KIND) {
-                    /* The item was expected to have a dummy value pre-recorded in the packet */
-                    FAIL(soft, CIF_INTERNAL_ERROR);
-                }
-    
-                /* set value properties from the DB */
-                GET_VALUE_PROPS(stmt, 2, &(entry->as_value), soft);
-    
-                /* check whether there are any more values for the current packet */
-                switch (sqlite3_step(stmt)) {
-                    case SQLITE_ROW:
-                        next_row = sqlite3_column_int(stmt, 0);
-                        if (next_row == current_row) {
-                            /* there is another value for this packet; loop back to handle it */
-                            continue;
-                        } /* else that was the last value for the packet, but there is another packet after it */
-                        SET_RESULT(CIF_OK);
-                        break;
-                    case SQLITE_DONE:
-                        /* that was the last value for the last packet */
-                        iterator->finished = 1;
-                        SET_RESULT(CIF_OK);
-                        break;
-                    default:
-                        DEFAULT_FAIL(soft);
+            /* (Optionally) set the packet (or just its contents) in the result */
+            if (packet == NULL) {
+                /* drop the temporary packet */
+                cif_packet_free(temp_packet);
+            } else if (*packet == NULL) {
+                /* easy case: just give the caller a pointer to the packet we constructed */
+                *packet = temp_packet;
+            } else {
+                /* copy values into the existing packet */
+                cif_map_t *target_map = &((*packet)->map);
+                cif_map_t *source_map = &(temp_packet->map);
+                size_t position;
+
+                /*
+                 * Overwrite any needed target values already present in the result packet, and remove any that
+                 * are present but unwanted.
+                 */
+                for (position = 0; position < target_map->size; ) {
+                    struct entry_s *target = target_map->entries + position;
+                    struct entry_s *entry = cif_map_find_internal(source_map, target->key);
+
+                    if (entry == NULL) {
+                        /* FIXME: is this OK for a dependent packet? */
+                        /* remove target packet item with no corresponding item in the temporary packet */
+                        cif_map_remove_internal(target_map, target, CIF_TRUE);
+                    } else {
+                        /* release any resources held by the target value object */
+                        cif_value_clean(target->value);
+
+                        /* make the target value a *shallow* copy of the source value */
+                        memcpy(target->value, entry->value, sizeof(cif_value_tp));
+                        entry->value->kind = CIF_UNK_KIND;
+
+                        /* remove the source item from its packet */
+                        cif_map_remove_internal(source_map, entry, CIF_TRUE);
+                        position += 1;
+                    }
                 }
-    
-                /* the current packet has been fully read from the DB */
-                iterator->previous_row_num = current_row;
-    
-                /* (Optionally) set the packet (or just its contents) in the result */
-                if (packet == NULL) {
-                    /* drop the temporary packet */
-                    cif_packet_free(temp_packet);
-                } else if (*packet == NULL) {
-                    /* easy case: just give the caller a pointer to the packet we constructed */
-                    *packet = temp_packet;
-                } else {
-                    /* copy values into the existing packet */
-                    struct entry_s *target;
-                    struct entry_s *temp;
-                    size_t name_len;
-    
-                    /*
-                     * Overwrite any needed target values already present in the result packet, and remove any that
-                     * are present but unwanted.
-                     */
-                    HASH_ITER(hh, (*packet)->map.head, target, temp) {
-                        name_len = (size_t) U_BYTES(target->key);
-                        HASH_FIND(hh, temp_packet->map.head, target->key, name_len, entry);
-                        if (entry == NULL) {
-                            /* FIXME: is this OK for a dependent packet? */
-                            /* remove target packet item with no corresponding item in the temporary packet */
-                            HASH_DEL((*packet)->map.head, target);
-                            cif_map_entry_free_internal(target, &((*packet)->map));
-                        } else {
-                            /* remove the source item from its packet */
-                            HASH_DEL(temp_packet->map.head, entry);
-    
-                            /* release any resources held by the target value object */
-                            cif_value_clean(&(target->as_value));
 
-                            /* make the target value a *shallow* copy of the source value */
-                            memcpy(&(target->as_value), &(entry->as_value), sizeof(cif_value_tp));
-    
-                            /* release the temporary entry itself, but not any resources it refers to */
-                            cif_map_entry_clean_metadata_internal(entry, &(temp_packet->map));
-                            free(entry);
-                        }
-                    }
-    
-                    /* Move any remaining entries of the temp packet into the result packet */
-                    HASH_ITER(hh, temp_packet->map.head, entry, temp) {
-                        if ((*packet)->map.is_standalone == 0) {
-                            /* FIXME: change it to independent instead of failing? */
-                            /* can't add new items to a dependent target packet */
-                            FAIL(soft, CIF_ARGUMENT_ERROR);
-                        } else {
-                            HASH_DEL(temp_packet->map.head, entry);
-                            name_len = (size_t) U_BYTES(entry->key);
-    
-                            /* convert the entry to standalone, for compatibility with the packet */
-                            entry->key = cif_u_strdup(entry->key);
-    
-                            if (entry->key != NULL) {
-                                /* add the entry to the packet */
-                                HASH_ADD_KEYPTR(hh, (*packet)->map.head, entry->key, name_len, entry);
-                            } else {
-                                FAIL(soft, CIF_MEMORY_ERROR);
-                            }
-                        }
+                /* Move any remaining entries of the temp packet into the result packet */
+                for (position = 0; position < source_map->size; position += 1) {
+                    struct entry_s *entry = source_map->entries + position;
+                    UChar *key;
+
+                    if (target_map->is_standalone == 0) {
+                        /* FIXME: change it to independent instead of failing? */
+                        /* can't add new items to a dependent target packet */
+                        FAIL(soft, CIF_ARGUMENT_ERROR);
+                    } else if ((key = cif_u_strdup(entry->key)) == NULL) {
+                        FAIL(soft, CIF_MEMORY_ERROR);
+                    } else if (cif_map_add_internal(target_map, key, key, entry->value, NULL) != CIF_OK) {
+                        free(key);
+                        FAIL(soft, CIF_MEMORY_ERROR);
+                    } else {
+                        /* the value object now belongs to the result packet */
+                        entry->value = NULL;
                     }
-    
-                    /* Free whatever is left of the temporary packet */
-                    cif_packet_free(temp_packet);
                 }
-    
-                SUCCESS_TERMINUS;
+
+                /* Free whatever is left of the temporary packet */
+                cif_packet_free(temp_packet);
             }
-    
+
+            return CIF_OK;
+
             FAILURE_HANDLER(soft):
             cif_packet_free(temp_packet);
         }
-    
+
         FAILURE_TERMINUS;
     }
 }
 
+int cif_pktitr_next_borrowed_packet(
+        cif_pktitr_tp *iterator,
+        cif_packet_tp **packet
+        ) {
+    cif_packet_tp *borrowed = iterator->borrowed_packet;
+    int result;
+
+    assert (iterator->item_names != NULL);
+
+    if (iterator->finished != 0) {
+        return CIF_FINISHED;
+    } else if (packet == NULL) {
+        return CIF_ARGUMENT_ERROR;
+    } else if (sqlite3_get_autocommit(iterator->loop->container->cif->db) != 0) {
+        /* no transaction is active -- the provided iterator is stale */
+        return CIF_INVALID_HANDLE;
+    }
+
+    if ((borrowed != NULL) && !cif_pktitr_packet_matches(borrowed, iterator->item_names)) {
+        /* the caller has added items to or removed items from the previous packet; discard it */
+        cif_packet_free(borrowed);
+        iterator->borrowed_packet = NULL;
+        borrowed = NULL;
+    }
+
+    if (borrowed == NULL) {
+        /* Relies on the item names to be pre-normalized */
+        if ((result = cif_packet_create_norm(&borrowed, iterator->item_names, CIF_TRUE)) != CIF_OK) {
+            return result;
+        }
+        iterator->borrowed_packet = borrowed;
+    } else {
+        size_t position;
+
+        /* releases only data the caller may have assigned; borrowed data are not released individually */
+        for (position = 0; position < borrowed->map.size; position += 1) {
+            cif_value_clean(borrowed->map.entries[position].value);
+        }
+    }
+
+    /* the previous packet's data are no longer needed */
+    cif_arena_release(&(iterator->arena), &(iterator->arena_start));
+
+    if ((result = cif_pktitr_read_packet(iterator, borrowed, CIF_TRUE)) == CIF_OK) {
+        *packet = borrowed;
+    }
+
+    return result;
+}
+
 #define SET_ID_PROPS(stmt, ofs, container_id, item_name, row_num, onerr) do { \
     sqlite3_stmt *s = (stmt); \
     if ((sqlite3_bind_int64(s, ofs + 1, (container_id)) != SQLITE_OK) \
@@ -303,8 +569,7 @@ int cif_pktitr_update_packet(
     } else {
         cif_container_tp *container = iterator->loop->container;
         cif_tp *cif = container->cif;
-        struct entry_s *scalar;
-        struct entry_s *temp;
+        size_t position;
 
         /*
          * Create any needed prepared statements, or prepare the existing one(s)
@@ -314,7 +579,8 @@ int cif_pktitr_update_packet(
 
         if (SAVE(cif->db) == CIF_OK) {
             /* step through the items in the provided packet */
-            HASH_ITER(hh, packet->map.head, scalar, temp) {
+            for (position = 0; position < packet->map.size; position += 1) {
+                struct entry_s *scalar = packet->map.entries + position;
                 struct set_element_s *element;
 
                 HASH_FIND(hh, iterator->name_set, scalar->key, U_BYTES(scalar->key), element);
@@ -323,7 +589,7 @@ int cif_pktitr_update_packet(
 
                     SET_ID_PROPS(cif->update_value_stmt, 0, container->id, scalar->key,
                             iterator->previous_row_num, hard);
-                    SET_VALUE_PROPS(cif->update_value_stmt, 3, &(scalar->as_value), hard, soft);
+                    SET_VALUE_PROPS(cif->update_value_stmt, 3, scalar->value, hard, soft);
 
                     if ((STEP_STMT(cif, update_value) == SQLITE_DONE)
                             && (sqlite3_clear_bindings(cif->update_value_stmt) == SQLITE_OK)) {
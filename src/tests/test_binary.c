@@ -0,0 +1,414 @@
+/*
+ * test_binary.c
+ *
+ * Tests saving CIFs in the binary form and reloading them.
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unicode/ustring.h>
+#include "../cif.h"
+#include "test.h"
+
+#define BUFFER_SIZE 512
+#define NUM_FILES 8
+
+/* parses the specified CIF text into a new managed CIF */
+static int parse_text(const char *text, cif_tp **cif) {
+    FILE *stream = tmpfile();
+    int result;
+
+    if (stream == NULL) {
+        return CIF_ERROR;
+    } else if (fputs(text, stream) < 0) {
+        fclose(stream);
+        return CIF_ERROR;
+    }
+    rewind(stream);
+    *cif = NULL;
+    result = cif_parse(stream, NULL, cif);
+    fclose(stream);
+
+    return result;
+}
+
+/* saves the specified CIF in binary form to a new temporary stream, positioned at its beginning */
+static FILE *save(cif_tp *cif) {
+    FILE *stream = tmpfile();
+
+    if (stream != NULL) {
+        if (cif_write_binary(stream, cif) != CIF_OK) {
+            fclose(stream);
+            return NULL;
+        }
+        rewind(stream);
+    }
+
+    return stream;
+}
+
+/* saves the specified CIF in binary form and reloads it into a new managed CIF */
+static int round_trip(cif_tp *cif, cif_tp **copy) {
+    FILE *stream = save(cif);
+    int result;
+
+    if (stream == NULL) {
+        return CIF_ERROR;
+    }
+    *copy = NULL;
+    result = cif_read_binary(stream, copy);
+    fclose(stream);
+
+    return result;
+}
+
+/* copies the first length bytes of the specified stream, altered at the specified offset, to a new temporary stream */
+static FILE *altered_copy(FILE *stream, long length, long offset, int byte) {
+    FILE *copy = tmpfile();
+    long i;
+
+    if (copy != NULL) {
+        rewind(stream);
+        for (i = 0; i < length; i += 1) {
+            int c = getc(stream);
+
+            if ((c == EOF) || (putc(((i == offset) ? byte : c), copy) == EOF)) {
+                fclose(copy);
+                return NULL;
+            }
+        }
+        rewind(copy);
+    }
+
+    return copy;
+}
+
+/*
+ * Writes the specified CIFs as text and compares the results.  Returns zero if they are identical, or nonzero if not.
+ */
+static int compare_output(cif_tp *cif, cif_tp *other) {
+    char *bytes[2] = { NULL, NULL };
+    size_t lengths[2];
+    int result = 1;
+
+    if ((cif_write_buffer(cif, NULL, bytes, lengths) == CIF_OK)
+            && (cif_write_buffer(other, NULL, bytes + 1, lengths + 1) == CIF_OK)) {
+        result = ((lengths[0] != lengths[1]) || (memcmp(bytes[0], bytes[1], lengths[0]) != 0));
+    }
+    free(bytes[0]);
+    free(bytes[1]);
+
+    return result;
+}
+
+/*
+ * Saves the specified CIFs in binary form and compares the results, which captures details, such as packets lacking
+ * some items, that the text form does not.  Returns zero if they are identical, or nonzero if not.
+ */
+static int compare_saved(cif_tp *cif, cif_tp *other) {
+    FILE *streams[2];
+    int result = 1;
+
+    streams[0] = save(cif);
+    streams[1] = save(other);
+    if ((streams[0] != NULL) && (streams[1] != NULL)) {
+        int c;
+
+        do {
+            c = getc(streams[0]);
+        } while ((c == getc(streams[1])) && (c != EOF));
+        result = (c != EOF);
+    }
+    if (streams[0] != NULL) {
+        fclose(streams[0]);
+    }
+    if (streams[1] != NULL) {
+        fclose(streams[1]);
+    }
+
+    return result;
+}
+
+/* retrieves the kind, quoting, and UTF-8 text of the specified item of the specified block */
+static int item_text(cif_tp *cif, const char *block_code, const char *name, cif_kind_tp *kind, cif_quoted_tp *quoted,
+        char **text) {
+    cif_block_tp *block;
+    cif_value_tp *value = NULL;
+    int result = cif_get_block_utf8(cif, block_code, &block);
+
+    if (result == CIF_OK) {
+        result = cif_container_get_value_utf8(block, name, &value);
+        if (result == CIF_OK) {
+            *kind = cif_value_kind(value);
+            *quoted = cif_value_is_quoted(value);
+            result = cif_value_get_text_utf8(value, text);
+            cif_value_free(value);
+        }
+        cif_container_free(block);
+    }
+
+    return result;
+}
+
+/* sets the specified item of the specified container to a number parsed from the specified text */
+static int set_number(cif_container_tp *container, const char *name, const char *text) {
+    UChar name_u[BUFFER_SIZE];
+    UChar *text_u = (UChar *) malloc((strlen(text) + 1) * sizeof(UChar));
+    cif_value_tp *value = NULL;
+    int result;
+
+    if (text_u == NULL) {
+        return CIF_MEMORY_ERROR;
+    }
+    u_uastrcpy(name_u, name);
+    u_uastrcpy(text_u, text);
+    if ((result = cif_value_create(CIF_UNK_KIND, &value)) == CIF_OK) {
+        /* the value takes ownership of the text */
+        if ((result = cif_value_parse_numb(value, text_u)) == CIF_OK) {
+            text_u = NULL;
+            result = cif_container_set_value(container, name_u, value);
+        }
+        cif_value_free(value);
+    }
+    free(text_u);
+
+    return result;
+}
+
+/* adds a packet to the specified loop, with values for those of the specified items whose texts are not NULL */
+static int add_packet(cif_loop_tp *loop, UChar *names[], const char *texts[]) {
+    cif_packet_tp *packet;
+    cif_value_tp *value = NULL;
+    int result;
+    int i;
+
+    if ((result = cif_packet_create(&packet, NULL)) != CIF_OK) {
+        return result;
+    } else if ((result = cif_value_create(CIF_UNK_KIND, &value)) == CIF_OK) {
+        for (i = 0; (result == CIF_OK) && (names[i] != NULL); i += 1) {
+            if (texts[i] != NULL) {
+                UChar text[BUFFER_SIZE];
+
+                u_uastrcpy(text, texts[i]);
+                if ((result = cif_value_copy_char(value, text)) == CIF_OK) {
+                    result = cif_packet_set_item(packet, names[i], value);
+                }
+            }
+        }
+        if (result == CIF_OK) {
+            result = cif_loop_add_packet(loop, packet);
+        }
+        cif_value_free(value);
+    }
+    cif_packet_free(packet);
+
+    return result;
+}
+
+int main(void) {
+    char test_name[80] = "test_binary";
+    const char *input = "#\\#CIF_2.0\ndata_a\n"
+            "_s.a -12.50\n_s.b 007\n_s.c -0\n_s.d 1.\n_s.e .5\n_s.f '42'\n_s.g 12345678901234567890\n"
+            "_s.h 1.5(2)\n_s.i ?\n_s.j .\n_s.k [1 'two' [3]]\n_s.l {'x':1 'y':\"\"\"z\"\"\"}\n"
+            "_s.m\n;\nline 1\nline 2\n;\n"
+            "loop_\n_l.id _l.name _l.val\n1 alpha 0.25\n2 'beta gamma' -3\n3 alpha ?\n"
+            "save_f\n_f.x 'in a frame'\nsave_\n"
+            "data_b\n_s.a 'second block'\n";
+    const char *local_file_names[NUM_FILES] = {
+        "simple_data.cif", "simple_loops.cif", "simple_containers.cif", "complex_data.cif", "list_data.cif",
+        "table_data.cif", "unicode.cif", "cif_core.dic"
+    };
+    char file_name[BUFFER_SIZE];
+    struct cif_parse_opts_s *options = NULL;
+    cif_tp *cif = NULL;
+    cif_tp *copy = NULL;
+    cif_kind_tp kind;
+    cif_quoted_tp quoted;
+    char *text;
+    FILE *stream;
+    long length;
+    int i;
+
+    TESTHEADER(test_name);
+
+    /* argument checks */
+    TEST(parse_text(input, &cif), CIF_OK, test_name, 1);
+    stream = tmpfile();
+    TEST(stream == NULL, 0, test_name, 2);
+    TEST(cif_write_binary(NULL, cif), CIF_ARGUMENT_ERROR, test_name, 3);
+    TEST(cif_write_binary(stream, NULL), CIF_INVALID_HANDLE, test_name, 4);
+    TEST(cif_read_binary(NULL, &copy), CIF_ARGUMENT_ERROR, test_name, 5);
+    TEST(cif_read_binary(stream, NULL), CIF_ARGUMENT_ERROR, test_name, 6);
+    fclose(stream);
+
+    /* values keep their kinds, quoting, and exact text, including text resembling numbers */
+    TEST(round_trip(cif, &copy), CIF_OK, test_name, 7);
+    TEST(compare_output(cif, copy), 0, test_name, 8);
+    {
+        const char *names[7] = { "_s.a", "_s.b", "_s.c", "_s.d", "_s.e", "_s.f", "_s.g" };
+        const char *texts[7] = { "-12.50", "007", "-0", "1.", ".5", "42", "12345678901234567890" };
+
+        for (i = 0; i < 7; i += 1) {
+            TEST(item_text(copy, "a", names[i], &kind, &quoted, &text), CIF_OK, test_name, 10 + 3 * i);
+            TEST((kind != CIF_CHAR_KIND) || (quoted != ((i == 5) ? CIF_QUOTED : CIF_NOT_QUOTED)), 0, test_name,
+                    11 + 3 * i);
+            TEST(strcmp(text, texts[i]), 0, test_name, 12 + 3 * i);
+            free(text);
+        }
+    }
+    TEST(cif_destroy(copy), CIF_OK, test_name, 31);
+
+    /* numbers keep their text and uncertainty, and packets lacking some items keep their gaps */
+    {
+        UChar p_a[5] = { '_', 'p', '.', 'a', 0 };
+        UChar p_b[5] = { '_', 'p', '.', 'b', 0 };
+        UChar *names[3];
+        const char *full[2] = { "1", "x" };
+        const char *partial[2] = { "2", NULL };
+        const char *numbers[3] = { "-4.5e-3", "1.234(5)", "123456789012345678901234567890(123456789012345678901)" };
+        const char *number_names[3] = { "_n.a", "_n.b", "_n.c" };
+        cif_block_tp *block;
+        cif_loop_tp *loop;
+
+        names[0] = p_a;
+        names[1] = p_b;
+        names[2] = NULL;
+        TEST(cif_get_block_utf8(cif, "b", &block), CIF_OK, test_name, 32);
+        for (i = 0; i < 3; i += 1) {
+            TEST(set_number(block, number_names[i], numbers[i]), CIF_OK, test_name, 33 + i);
+        }
+        TEST(cif_container_create_loop(block, NULL, names, &loop), CIF_OK, test_name, 36);
+        TEST(add_packet(loop, names, full), CIF_OK, test_name, 37);
+        TEST(add_packet(loop, names, partial), CIF_OK, test_name, 38);
+        TEST(add_packet(loop, names, full), CIF_OK, test_name, 39);
+        cif_loop_free(loop);
+        cif_container_free(block);
+
+        TEST(round_trip(cif, &copy), CIF_OK, test_name, 40);
+        TEST(compare_output(cif, copy), 0, test_name, 41);
+        TEST(compare_saved(cif, copy), 0, test_name, 42);
+        for (i = 0; i < 3; i += 1) {
+            char *expected;
+
+            TEST(item_text(cif, "b", number_names[i], &kind, &quoted, &expected), CIF_OK, test_name, 43 + 4 * i);
+            TEST(item_text(copy, "b", number_names[i], &kind, &quoted, &text), CIF_OK, test_name, 44 + 4 * i);
+            TEST(kind, CIF_NUMB_KIND, test_name, 45 + 4 * i);
+            TEST(strcmp(text, expected), 0, test_name, 46 + 4 * i);
+            free(expected);
+            free(text);
+        }
+        TEST(cif_destroy(copy), CIF_OK, test_name, 55);
+    }
+
+    /* damaged input is rejected, and leaves the target unchanged */
+    stream = save(cif);
+    TEST(stream == NULL, 0, test_name, 60);
+    TEST(parse_text("data_other\n_o.x 1\n", &copy), CIF_OK, test_name, 61);
+    {
+        FILE *damaged[3];
+        int expected[3] = { CIF_ERROR, CIF_NOT_SUPPORTED, CIF_ERROR };
+        char *before;
+        size_t before_length;
+        char *after;
+        size_t after_length;
+
+        TEST(fseek(stream, 0, SEEK_END), 0, test_name, 62);
+        length = ftell(stream);
+        TEST(length < 6, 0, test_name, 63);
+        damaged[0] = altered_copy(stream, length, 0, 'X');
+        damaged[1] = altered_copy(stream, length, 4, 2);
+        damaged[2] = altered_copy(stream, length / 2, -1, 0);
+        TEST(cif_write_buffer(copy, NULL, &before, &before_length), CIF_OK, test_name, 64);
+        for (i = 0; i < 3; i += 1) {
+            TEST(damaged[i] == NULL, 0, test_name, 65 + 4 * i);
+            TEST(cif_read_binary(damaged[i], &copy), expected[i], test_name, 66 + 4 * i);
+            fclose(damaged[i]);
+            TEST(cif_write_buffer(copy, NULL, &after, &after_length), CIF_OK, test_name, 67 + 4 * i);
+            TEST((before_length != after_length) || memcmp(before, after, before_length), 0, test_name, 68 + 4 * i);
+            free(after);
+        }
+        free(before);
+
+        /* loading into an existing CIF adds to its contents, unless a block code is already taken */
+        rewind(stream);
+        TEST(cif_read_binary(stream, &copy), CIF_OK, test_name, 77);
+        {
+            cif_block_tp **blocks;
+
+            TEST(cif_get_all_blocks(copy, &blocks), CIF_OK, test_name, 78);
+            for (i = 0; blocks[i] != NULL; i += 1) {
+                cif_container_free(blocks[i]);
+            }
+            free(blocks);
+            TEST(i, 3, test_name, 79);
+        }
+        TEST(cif_write_buffer(copy, NULL, &before, &before_length), CIF_OK, test_name, 80);
+        rewind(stream);
+        TEST(cif_read_binary(stream, &copy), CIF_DUP_BLOCKCODE, test_name, 81);
+        TEST(cif_write_buffer(copy, NULL, &after, &after_length), CIF_OK, test_name, 82);
+        TEST((before_length != after_length) || memcmp(before, after, before_length), 0, test_name, 83);
+        free(after);
+        free(before);
+    }
+    fclose(stream);
+    TEST(cif_destroy(copy), CIF_OK, test_name, 85);
+    TEST(cif_destroy(cif), CIF_OK, test_name, 86);
+
+    /* every data file survives a round trip */
+    for (i = 0; i < NUM_FILES; i += 1) {
+        int subtest = 100 + 10 * i;
+        FILE *cif_file;
+
+        RESOLVE_DATADIR(file_name, BUFFER_SIZE - strlen(local_file_names[i]));
+        TEST_NOT(file_name[0], 0, test_name, subtest);
+        strcat(file_name, local_file_names[i]);
+        cif_file = fopen(file_name, "rb");
+        TEST(cif_file == NULL, 0, test_name, subtest + 1);
+        cif = NULL;
+        TEST(cif_parse(cif_file, NULL, &cif), CIF_OK, test_name, subtest + 2);
+        fclose(cif_file);
+        TEST(round_trip(cif, &copy), CIF_OK, test_name, subtest + 3);
+        TEST(compare_output(cif, copy), 0, test_name, subtest + 4);
+        TEST(compare_saved(cif, copy), 0, test_name, subtest + 5);
+        TEST(cif_destroy(copy), CIF_OK, test_name, subtest + 6);
+        TEST(cif_destroy(cif), CIF_OK, test_name, subtest + 7);
+    }
+
+    /* names recovered from erroneous input, which are not valid CIF, survive a round trip */
+    RESOLVE_DATADIR(file_name, BUFFER_SIZE - strlen("10.cif"));
+    TEST_NOT(file_name[0], 0, test_name, 200);
+    strcat(file_name, "10.cif");
+    TEST((stream = fopen(file_name, "rb")) == NULL, 0, test_name, 201);
+    TEST(cif_parse_options_create(&options), CIF_OK, test_name, 202);
+    options->error_callback = cif_parse_error_ignore;
+    cif = NULL;
+    TEST(cif_parse(stream, options, &cif), CIF_OK, test_name, 203);
+    fclose(stream);
+    free(options);
+    TEST(round_trip(cif, &copy), CIF_OK, test_name, 204);
+    TEST(compare_output(cif, copy), 0, test_name, 205);
+    TEST(compare_saved(cif, copy), 0, test_name, 206);
+    TEST(cif_destroy(copy), CIF_OK, test_name, 207);
+    TEST(cif_destroy(cif), CIF_OK, test_name, 208);
+
+    return 0;
+}
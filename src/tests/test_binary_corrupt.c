@@ -0,0 +1,147 @@
+/*
+ * test_binary_corrupt.c
+ *
+ * Tests that cif_read_binary() rejects truncated input, and that it either rejects corrupted input or loads a CIF
+ * that can safely be used, never crashing or reading out of bounds.
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unicode/ustring.h>
+#include "../cif.h"
+#include "test.h"
+
+#define BUFFER_SIZE 4096
+#define NUM_MUTATIONS 4
+
+/* a CIF exercising every value kind and every form in which values are saved */
+static const char INPUT[] = "#\\#CIF_2.0\ndata_a\n_s.char hello\n_s.dec -12.50\n_s.numb 1.25(3)\n"
+        "_s.big 123456789012345678901234567890(12345678901234567890123)\n_s.quoted '3.5'\n_s.na .\n_s.unk ?\n"
+        "_s.text\n;\nline one\nline two\n;\n_s.list [1 'b' [c]]\n_s.table {'k':v 'n':[1 2]}\n"
+        "loop_\n_l.id\n_l.v\n1 x\n2 .\n3 [4 {'x':y}]\n"
+        "save_f\n_f.x y\nloop_\n_m.a\n_m.b\n1 2\n3 4\nsave_\n"
+        "data_b\n_t.x 'bb'\n_t.y hello\n";
+
+/* returns the specified byte of saved data, as altered by the specified mutation */
+static unsigned char mutate(unsigned char byte, int mutation) {
+    switch (mutation) {
+        case 0:
+            return (unsigned char) (byte ^ 0x01);
+        case 1:
+            return (unsigned char) (byte ^ 0x80);
+        case 2:
+            return 0xff;
+        default:
+            return 0x00;
+    }
+}
+
+/*
+ * Loads the specified bytes via cif_read_binary().  If that succeeds, then the CIF loaded is written out as CIF text
+ * and in binary form, which reads every value, and the results of those writes are ignored.  Returns the result of
+ * the load.
+ */
+static int load(const unsigned char *bytes, size_t length) {
+    FILE *stream = tmpfile();
+    cif_tp *cif = NULL;
+    int result;
+
+    if (stream == NULL) {
+        return CIF_ERROR;
+    } else if (fwrite(bytes, 1, length, stream) != length) {
+        fclose(stream);
+        return CIF_ERROR;
+    }
+    rewind(stream);
+    result = cif_read_binary(stream, &cif);
+    fclose(stream);
+
+    if (result == CIF_OK) {
+        char *output = NULL;
+        size_t output_length;
+
+        if (cif_write_buffer(cif, NULL, &output, &output_length) == CIF_OK) {
+            free(output);
+        }
+        if ((stream = tmpfile()) != NULL) {
+            if (cif_write_binary(stream, cif) != CIF_OK) {
+                /* ignore the failure */
+            }
+            fclose(stream);
+        }
+    }
+    if ((cif != NULL) && (cif_destroy(cif) != CIF_OK) && (result == CIF_OK)) {
+        result = CIF_ERROR;
+    }
+
+    return result;
+}
+
+int main(void) {
+    char test_name[80] = "test_binary_corrupt";
+    unsigned char saved[BUFFER_SIZE];
+    unsigned char altered[BUFFER_SIZE];
+    size_t saved_length;
+    size_t length;
+    size_t position;
+    size_t accepted;
+    FILE *stream = tmpfile();
+    cif_tp *cif = NULL;
+    int mutation;
+
+    TESTHEADER(test_name);
+    TEST(stream == NULL, 0, test_name, 1);
+    TEST(fputs(INPUT, stream) < 0, 0, test_name, 2);
+    rewind(stream);
+    TEST(cif_parse(stream, NULL, &cif), CIF_OK, test_name, 3);
+    fclose(stream);
+    TEST((stream = tmpfile()) == NULL, 0, test_name, 4);
+    TEST(cif_write_binary(stream, cif), CIF_OK, test_name, 5);
+    rewind(stream);
+    saved_length = fread(saved, 1, BUFFER_SIZE, stream);
+    fclose(stream);
+    TEST((saved_length == 0) || (saved_length == BUFFER_SIZE), 0, test_name, 6);
+    TEST(cif_destroy(cif), CIF_OK, test_name, 7);
+    TEST(load(saved, saved_length), CIF_OK, test_name, 8);
+
+    /* every proper prefix of the saved data lacks at least its terminator */
+    accepted = 0;
+    for (length = 0; length < saved_length; length += 1) {
+        if (load(saved, length) == CIF_OK) {
+            accepted += 1;
+        }
+    }
+    TEST(accepted, 0, test_name, 9);
+
+    /* each byte altered in several ways, separately; whether each alteration is detected does not matter here */
+    for (position = 0; position < saved_length; position += 1) {
+        for (mutation = 0; mutation < NUM_MUTATIONS; mutation += 1) {
+            memcpy(altered, saved, saved_length);
+            altered[position] = mutate(saved[position], mutation);
+            if (altered[position] != saved[position]) {
+                (void) load(altered, saved_length);
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,164 @@
+/*
+ * test_container_get_values.c
+ *
+ * Tests the batched item retrieval functions cif_container_get_values() and cif_container_get_all_scalars(),
+ * checking that they agree with cif_container_get_value() for scalars, looped items, and absent items.
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unicode/ustring.h>
+#include "../cif.h"
+#include "assert_value.h"
+#include "test.h"
+
+#define BUFFER_SIZE 64
+#define NAME_COUNT 8
+
+int main(void) {
+    char test_name[80] = "test_container_get_values";
+    cif_tp *cif = NULL;
+    cif_block_tp *block = NULL;
+    cif_loop_tp *loop = NULL;
+    cif_packet_tp *packet = NULL;
+    cif_value_tp *value = NULL;
+    cif_value_tp *list = NULL;
+    cif_value_tp *expected = NULL;
+    cif_value_tp *element;
+    cif_value_tp *values[NAME_COUNT];
+    const UChar **packet_names;
+    UChar buffer[BUFFER_SIZE];
+    UChar name_a[] = { '_', 'a', 0 };
+    UChar name_b[] = { '_', 'B', 0 };
+    UChar name_c[] = { '_', 'c', 0 };
+    UChar name_l[] = { '_', 'l', 0 };
+    UChar name_m[] = { '_', 'm', 0 };
+    UChar name_A[] = { '_', 'A', 0 };
+    UChar name_none[] = { '_', 'n', 'o', 'n', 'e', 0 };
+    UChar name_bad[] = { 'b', 'a', 'd', 0 };
+    UChar *loop_names[2];
+    const UChar *names[NAME_COUNT + 1];
+    int i;
+
+    TESTHEADER(test_name);
+    CREATE_CIF(test_name, cif);
+    TEST(cif_create_block(cif, TO_UNICODE("b", buffer, BUFFER_SIZE), &block), CIF_OK, test_name, 1);
+
+    /* no scalars at all */
+    TEST(cif_container_get_all_scalars(block, &packet), CIF_OK, test_name, 2);
+    TEST(cif_packet_get_names(packet, &packet_names), CIF_OK, test_name, 3);
+    TEST(packet_names[0] != NULL, 0, test_name, 4);
+    free(packet_names);
+    cif_packet_free(packet);
+    packet = NULL;
+
+    /* three scalars of different kinds */
+    TEST(cif_value_create(CIF_UNK_KIND, &value), CIF_OK, test_name, 5);
+    TEST(cif_value_copy_char(value, TO_UNICODE("text", buffer, BUFFER_SIZE)), CIF_OK, test_name, 6);
+    TEST(cif_container_set_value(block, name_a, value), CIF_OK, test_name, 7);
+    TEST(cif_value_init_numb(value, 1.5, 0.25, 2, 5), CIF_OK, test_name, 8);
+    TEST(cif_container_set_value(block, name_b, value), CIF_OK, test_name, 9);
+    TEST(cif_value_create(CIF_LIST_KIND, &list), CIF_OK, test_name, 10);
+    TEST(cif_value_insert_element_at(list, 0, value), CIF_OK, test_name, 11);
+    TEST(cif_container_set_value(block, name_c, list), CIF_OK, test_name, 12);
+
+    /* a looped item with two values, and one with one value */
+    loop_names[0] = name_l;
+    loop_names[1] = NULL;
+    TEST(cif_container_create_loop(block, NULL, loop_names, &loop), CIF_OK, test_name, 13);
+    TEST(cif_packet_create(&packet, loop_names), CIF_OK, test_name, 14);
+    TEST(cif_loop_add_packet(loop, packet), CIF_OK, test_name, 15);
+    TEST(cif_loop_add_packet(loop, packet), CIF_OK, test_name, 16);
+    cif_packet_free(packet);
+    cif_loop_free(loop);
+    loop_names[0] = name_m;
+    TEST(cif_container_create_loop(block, NULL, loop_names, &loop), CIF_OK, test_name, 17);
+    TEST(cif_packet_create(&packet, loop_names), CIF_OK, test_name, 18);
+    TEST(cif_packet_set_item(packet, name_m, value), CIF_OK, test_name, 19);
+    TEST(cif_loop_add_packet(loop, packet), CIF_OK, test_name, 20);
+    cif_packet_free(packet);
+    packet = NULL;
+    cif_loop_free(loop);
+
+    /* all the scalars */
+    TEST(cif_container_get_all_scalars(block, &packet), CIF_OK, test_name, 21);
+    TEST(cif_packet_get_names(packet, &packet_names), CIF_OK, test_name, 22);
+    for (i = 0; packet_names[i] != NULL; i += 1) ;
+    TEST(i, 3, test_name, 23);
+    free(packet_names);
+    TEST(cif_packet_get_item(packet, name_A, &element), CIF_OK, test_name, 24);
+    TEST(cif_container_get_value(block, name_a, &expected), CIF_OK, test_name, 25);
+    TEST(!assert_values_equal(element, expected), 0, test_name, 26);
+    TEST(cif_packet_get_item(packet, name_b, &element), CIF_OK, test_name, 27);
+    TEST(!assert_values_equal(element, value), 0, test_name, 28);
+    TEST(cif_packet_get_item(packet, name_c, &element), CIF_OK, test_name, 29);
+    TEST(!assert_values_equal(element, list), 0, test_name, 30);
+    TEST(cif_packet_get_item(packet, name_m, NULL), CIF_NOSUCH_ITEM, test_name, 31);
+    cif_packet_free(packet);
+    packet = NULL;
+
+    /* batched lookups of scalars, looped items, and absent items */
+    names[0] = name_A;
+    names[1] = name_m;
+    names[2] = name_c;
+    names[3] = name_l;
+    names[4] = name_none;
+    names[5] = name_bad;
+    names[6] = name_b;
+    names[7] = name_a;
+    names[8] = NULL;
+    for (i = 0; i < NAME_COUNT; i += 1) {
+        values[i] = list;
+    }
+    TEST(cif_container_get_values(block, names, values), CIF_AMBIGUOUS_ITEM, test_name, 40);
+    TEST(!assert_values_equal(values[0], expected), 0, test_name, 41);
+    TEST(!assert_values_equal(values[1], value), 0, test_name, 42);
+    TEST(!assert_values_equal(values[2], list), 0, test_name, 43);
+    TEST(cif_value_kind(values[3]), CIF_UNK_KIND, test_name, 44);
+    TEST(values[4] != NULL, 0, test_name, 45);
+    TEST(values[5] != NULL, 0, test_name, 46);
+    TEST(!assert_values_equal(values[6], value), 0, test_name, 47);
+    /* a repeated name gets its own value */
+    TEST(!assert_values_equal(values[7], expected), 0, test_name, 48);
+    TEST(values[7] == values[0], 0, test_name, 49);
+    for (i = 0; i < NAME_COUNT; i += 1) {
+        if (values[i] != NULL) cif_value_free(values[i]);
+    }
+    names[3] = NULL;
+    TEST(cif_container_get_values(block, names, values), CIF_OK, test_name, 50);
+    for (i = 0; i < 3; i += 1) {
+        cif_value_free(values[i]);
+    }
+    names[1] = name_none;
+    TEST(cif_container_get_values(block, names, values), CIF_NOSUCH_ITEM, test_name, 51);
+    TEST(values[1] != NULL, 0, test_name, 52);
+    cif_value_free(values[0]);
+    cif_value_free(values[2]);
+    TEST(cif_container_get_values(block, names, NULL), CIF_ARGUMENT_ERROR, test_name, 53);
+
+    cif_value_free(expected);
+    cif_value_free(list);
+    cif_value_free(value);
+    cif_block_free(block);
+    DESTROY_CIF(test_name, cif);
+
+    return 0;
+}
@@ -0,0 +1,209 @@
+/*
+ * test_container_set_values.c
+ *
+ * Tests the batched item setting function cif_container_set_values(), and the parser's batched recording of scalars,
+ * checking that each has the same effect as setting the items one at a time with cif_container_set_value().
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unicode/ustring.h>
+#include "../cif.h"
+#include "assert_value.h"
+#include "test.h"
+
+#define BUFFER_SIZE 64
+
+/* Counts parse errors, and ignores them */
+static int count_errors(int code, size_t line, size_t column, const UChar *text, size_t length, void *data);
+
+/* Counts the scalars of the specified container, or returns -1 on error */
+static int count_scalars(cif_container_tp *container);
+
+static int count_errors(int code UNUSED, size_t line UNUSED, size_t column UNUSED, const UChar *text UNUSED,
+        size_t length UNUSED, void *data) {
+    *((int *) data) += 1;
+    return CIF_OK;
+}
+
+static int count_scalars(cif_container_tp *container) {
+    cif_packet_tp *packet;
+    const UChar **names;
+    int count = -1;
+
+    if (cif_container_get_all_scalars(container, &packet) == CIF_OK) {
+        if (cif_packet_get_names(packet, &names) == CIF_OK) {
+            for (count = 0; names[count] != NULL; count += 1) ;
+            free(names);
+        }
+        cif_packet_free(packet);
+    }
+
+    return count;
+}
+
+static const char SCALARS_CIF[] =
+        "data_d\n"
+        "_a 1\n"
+        "_B 'two'\n"
+        "_A 3\n"
+        "loop_\n_l 1 2\n"
+        "_c 4\n"
+        "_L 5\n"
+        "save_f\n"
+        "_a 10\n"
+        "_x 11\n"
+        "save_\n"
+        "_d 6\n";
+
+int main(void) {
+    char test_name[80] = "test_container_set_values";
+    cif_tp *cif = NULL;
+    cif_block_tp *block = NULL;
+    cif_frame_tp *frame = NULL;
+    cif_loop_tp *loop = NULL;
+    cif_packet_tp *packet = NULL;
+    cif_packet_tp *packet2 = NULL;
+    cif_value_tp *value = NULL;
+    cif_value_tp *value2 = NULL;
+    cif_value_tp *element;
+    struct cif_parse_opts_s *options;
+    FILE *stream;
+    UChar buffer[BUFFER_SIZE];
+    UChar name_a[] = { '_', 'a', 0 };
+    UChar name_B[] = { '_', 'B', 0 };
+    UChar name_c[] = { '_', 'c', 0 };
+    UChar name_l[] = { '_', 'l', 0 };
+    UChar name_x[] = { '_', 'x', 0 };
+    UChar *loop_names[2];
+    double d;
+    int count;
+
+    TESTHEADER(test_name);
+    CREATE_CIF(test_name, cif);
+    TEST(cif_create_block(cif, TO_UNICODE("b", buffer, BUFFER_SIZE), &block), CIF_OK, test_name, 1);
+
+    /* argument checks, and an empty packet */
+    TEST(cif_packet_create(&packet, NULL), CIF_OK, test_name, 2);
+    TEST(cif_container_set_values(NULL, packet), CIF_INVALID_HANDLE, test_name, 3);
+    TEST(cif_container_set_values(block, NULL), CIF_ARGUMENT_ERROR, test_name, 4);
+    TEST(cif_container_set_values(block, packet), CIF_OK, test_name, 5);
+    TEST(count_scalars(block), 0, test_name, 6);
+
+    /* three new scalars of different kinds, in a container without a scalar loop */
+    TEST(cif_value_create(CIF_UNK_KIND, &value), CIF_OK, test_name, 7);
+    TEST(cif_value_copy_char(value, TO_UNICODE("text", buffer, BUFFER_SIZE)), CIF_OK, test_name, 8);
+    TEST(cif_packet_set_item(packet, name_a, value), CIF_OK, test_name, 9);
+    TEST(cif_value_init_numb(value, 1.5, 0.25, 2, 5), CIF_OK, test_name, 10);
+    TEST(cif_packet_set_item(packet, name_B, value), CIF_OK, test_name, 11);
+    TEST(cif_packet_set_item(packet, name_c, NULL), CIF_OK, test_name, 12);
+    TEST(cif_container_set_values(block, packet), CIF_OK, test_name, 13);
+    TEST(count_scalars(block), 3, test_name, 14);
+    TEST(cif_container_get_value(block, name_B, &value2), CIF_OK, test_name, 15);
+    TEST(!assert_values_equal(value, value2), 0, test_name, 16);
+    TEST(cif_container_get_value(block, name_c, &value2), CIF_OK, test_name, 17);
+    TEST(cif_value_kind(value2), CIF_UNK_KIND, test_name, 18);
+    TEST(cif_container_get_all_scalars(block, &packet2), CIF_OK, test_name, 19);
+    TEST(cif_packet_get_item(packet2, name_a, &element), CIF_OK, test_name, 20);
+    cif_value_free(value2);
+    TEST(cif_packet_get_item(packet, name_a, &value2), CIF_OK, test_name, 21);
+    TEST(!assert_values_equal(element, value2), 0, test_name, 22);
+    cif_packet_free(packet2);
+    cif_packet_free(packet);
+    packet = NULL;
+    value2 = NULL;
+
+    /* a looped item with two packets */
+    loop_names[0] = name_l;
+    loop_names[1] = NULL;
+    TEST(cif_container_create_loop(block, NULL, loop_names, &loop), CIF_OK, test_name, 23);
+    TEST(cif_packet_create(&packet, loop_names), CIF_OK, test_name, 24);
+    TEST(cif_loop_add_packet(loop, packet), CIF_OK, test_name, 25);
+    TEST(cif_loop_add_packet(loop, packet), CIF_OK, test_name, 26);
+    cif_packet_free(packet);
+    cif_loop_free(loop);
+
+    /* existing scalars, an existing looped item, and new scalars together */
+    TEST(cif_packet_create(&packet, NULL), CIF_OK, test_name, 27);
+    TEST(cif_value_init_numb(value, 7, 0, 0, 1), CIF_OK, test_name, 28);
+    TEST(cif_packet_set_item(packet, name_B, value), CIF_OK, test_name, 29);
+    TEST(cif_packet_set_item(packet, TO_UNICODE("_L", buffer, BUFFER_SIZE), value), CIF_OK, test_name, 30);
+    TEST(cif_packet_set_item(packet, name_x, value), CIF_OK, test_name, 31);
+    TEST(cif_packet_set_item(packet, TO_UNICODE("_A", buffer, BUFFER_SIZE), value), CIF_OK, test_name, 32);
+    TEST(cif_container_set_values(block, packet), CIF_OK, test_name, 33);
+    TEST(count_scalars(block), 4, test_name, 34);
+    TEST(cif_container_get_value(block, name_a, &value2), CIF_OK, test_name, 35);
+    TEST(!assert_values_equal(value, value2), 0, test_name, 36);
+    TEST(cif_container_get_value(block, name_B, &value2), CIF_OK, test_name, 37);
+    TEST(!assert_values_equal(value, value2), 0, test_name, 38);
+    TEST(cif_container_get_value(block, name_x, &value2), CIF_OK, test_name, 39);
+    TEST(!assert_values_equal(value, value2), 0, test_name, 40);
+    /* the looped item is set in both its packets, and is not a scalar */
+    TEST(cif_container_get_value(block, name_l, &value2), CIF_AMBIGUOUS_ITEM, test_name, 41);
+    TEST(!assert_values_equal(value, value2), 0, test_name, 42);
+    TEST(cif_container_get_item_loop(block, name_l, &loop), CIF_OK, test_name, 43);
+    TEST(cif_loop_get_category(loop, &loop_names[0]), CIF_OK, test_name, 44);
+    TEST(loop_names[0] != NULL, 0, test_name, 45);
+    cif_loop_free(loop);
+    cif_packet_free(packet);
+    cif_value_free(value2);
+    cif_value_free(value);
+    value = NULL;
+    cif_block_free(block);
+    DESTROY_CIF(test_name, cif);
+    cif = NULL;
+
+    /* the parser's buffered scalars */
+    stream = tmpfile();
+    TEST(stream == NULL, 0, test_name, 51);
+    TEST(fwrite(SCALARS_CIF, 1, sizeof(SCALARS_CIF) - 1, stream), sizeof(SCALARS_CIF) - 1, test_name, 52);
+    rewind(stream);
+    TEST(cif_parse_options_create(&options), CIF_OK, test_name, 53);
+    options->error_callback = count_errors;
+    options->user_data = &count;
+    count = 0;
+    TEST(cif_parse(stream, options, &cif), CIF_OK, test_name, 54);
+    /* duplicates of a buffered scalar and of a looped item are both detected */
+    TEST(count, 2, test_name, 55);
+    TEST(cif_get_block(cif, TO_UNICODE("d", buffer, BUFFER_SIZE), &block), CIF_OK, test_name, 56);
+    TEST(count_scalars(block), 4, test_name, 57);
+    TEST(cif_container_get_value(block, name_a, &value), CIF_OK, test_name, 58);
+    TEST(cif_value_get_number(value, &d), CIF_OK, test_name, 59);
+    TEST(d != 1, 0, test_name, 60);
+    TEST(cif_container_get_value(block, TO_UNICODE("_d", buffer, BUFFER_SIZE), &value), CIF_OK, test_name, 61);
+    TEST(cif_value_get_number(value, &d), CIF_OK, test_name, 62);
+    TEST(d != 6, 0, test_name, 63);
+    TEST(cif_container_get_value(block, name_l, NULL), CIF_AMBIGUOUS_ITEM, test_name, 64);
+    TEST(cif_container_get_frame(block, TO_UNICODE("f", buffer, BUFFER_SIZE), &frame), CIF_OK, test_name, 65);
+    TEST(count_scalars(frame), 2, test_name, 66);
+    TEST(cif_container_get_value(frame, name_a, &value), CIF_OK, test_name, 67);
+    TEST(cif_value_get_number(value, &d), CIF_OK, test_name, 68);
+    TEST(d != 10, 0, test_name, 69);
+
+    cif_value_free(value);
+    cif_frame_free(frame);
+    cif_block_free(block);
+    free(options);
+    fclose(stream);
+    DESTROY_CIF(test_name, cif);
+
+    return 0;
+}
@@ -0,0 +1,273 @@
+/*
+ * test_json.c
+ *
+ * Tests writing CIF data in the CIF-JSON format, and reading it back with cif_parse_json().
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unicode/ustring.h>
+#include "../cif.h"
+#include "test.h"
+
+#define BUFFER_SIZE 512
+#define NUM_FILES 8
+
+/* writes the specified text to a new temporary stream, positioned at its beginning */
+static FILE *text_stream(const char *text, size_t length) {
+    FILE *stream = tmpfile();
+
+    if (stream != NULL) {
+        if (fwrite(text, 1, length, stream) != length) {
+            fclose(stream);
+            return NULL;
+        }
+        rewind(stream);
+    }
+
+    return stream;
+}
+
+/* parses the specified CIF text into a new managed CIF */
+static int parse_text(const char *text, cif_tp **cif) {
+    FILE *stream = text_stream(text, strlen(text));
+    int result;
+
+    if (stream == NULL) {
+        return CIF_ERROR;
+    }
+    *cif = NULL;
+    result = cif_parse(stream, NULL, cif);
+    fclose(stream);
+
+    return result;
+}
+
+/* parses the specified CIF-JSON text into a new managed CIF */
+static int parse_json_text(const char *text, size_t length, cif_tp **cif) {
+    FILE *stream = text_stream(text, length);
+    int result;
+
+    if (stream == NULL) {
+        return CIF_ERROR;
+    }
+    *cif = NULL;
+    result = cif_parse_json(stream, cif);
+    fclose(stream);
+
+    return result;
+}
+
+/* parses the specified CIF-JSON text, discarding the result; returns the parse result code */
+static int try_json(const char *text) {
+    cif_tp *cif = NULL;
+    int result = parse_json_text(text, strlen(text), &cif);
+
+    if ((cif != NULL) && (cif_destroy(cif) != CIF_OK) && (result == CIF_OK)) {
+        result = CIF_ERROR;
+    }
+
+    return result;
+}
+
+/* retrieves the kind and quoted status of the value of the specified item of the specified block */
+static int item_kind(cif_tp *cif, const char *block_code, const char *name, cif_kind_tp *kind,
+        cif_quoted_tp *quoted) {
+    UChar item_name[BUFFER_SIZE];
+    cif_block_tp *block;
+    cif_value_tp *value = NULL;
+    int result = cif_get_block_utf8(cif, block_code, &block);
+
+    if (result == CIF_OK) {
+        u_uastrcpy(item_name, name);
+        result = cif_container_get_value(block, item_name, &value);
+        if (result == CIF_OK) {
+            *kind = cif_value_kind(value);
+            *quoted = cif_value_is_quoted(value);
+            cif_value_free(value);
+        }
+        cif_container_free(block);
+    }
+
+    return result;
+}
+
+/* retrieves the number of packets in the loop containing the specified item of the specified block */
+static int item_packets(cif_tp *cif, const char *block_code, const char *name, int *count) {
+    UChar item_name[BUFFER_SIZE];
+    cif_block_tp *block;
+    cif_loop_tp *loop;
+    int result = cif_get_block_utf8(cif, block_code, &block);
+
+    if (result == CIF_OK) {
+        u_uastrcpy(item_name, name);
+        result = cif_container_get_item_loop(block, item_name, &loop);
+        if (result == CIF_OK) {
+            cif_pktitr_tp *iterator;
+
+            *count = 0;
+            result = cif_loop_get_packets(loop, &iterator);
+            if (result == CIF_OK) {
+                while ((result = cif_pktitr_next_packet(iterator, NULL)) == CIF_OK) {
+                    *count += 1;
+                }
+                if (cif_pktitr_close(iterator) != CIF_OK) {
+                    result = CIF_ERROR;
+                } else if (result == CIF_FINISHED) {
+                    result = CIF_OK;
+                }
+            }
+            cif_loop_free(loop);
+        }
+        cif_container_free(block);
+    }
+
+    return result;
+}
+
+int main(void) {
+    char test_name[80] = "test_json";
+    const char *input = "#\\#CIF_2.0\ndata_a\n_s.x 1.5(2)\n_s.q '?'\n_s.u ?\n_s.n .\n"
+            "_s.t '''tab\there \"q\" \\'''\n"
+            "loop_\n_l.id _l.v\n1 [a {'k':b}]\n2 .\n"
+            "loop_\n_m.id\n10 20 30\n"
+            "save_f\n_f.x y\nsave_\n";
+    const char *local_file_names[NUM_FILES] = {
+        "simple_data.cif", "simple_loops.cif", "simple_containers.cif", "list_data.cif", "table_data.cif",
+        "text_fields.cif", "triple.cif", "unicode.cif"
+    };
+    const char *include_names[2] = { "_l.v", NULL };
+    char file_name[BUFFER_SIZE];
+    struct cif_write_opts_s *options = NULL;
+    cif_tp *cif = NULL;
+    cif_tp *imported = NULL;
+    cif_kind_tp kind;
+    cif_quoted_tp quoted;
+    char *json;
+    size_t json_length;
+    char *rewritten;
+    size_t rewritten_length;
+    int count;
+    int i;
+
+    TESTHEADER(test_name);
+    TEST(cif_write_options_create(&options), CIF_OK, test_name, 1);
+    TEST(options->json, 0, test_name, 2);
+    options->json = 1;
+
+    /* the form of the output */
+    TEST(parse_text(input, &cif), CIF_OK, test_name, 3);
+    TEST(cif_write_buffer(cif, options, &json, &json_length), CIF_OK, test_name, 4);
+    TEST(strncmp(json, "{\n  \"CIF-JSON\": {\n    \"Metadata\": {\n", 35), 0, test_name, 5);
+    TEST(strstr(json, "\n    \"a\": {\n      \"Frames\": {\n        \"f\": {\n"
+            "          \"_f.x\": [\"y\"]\n") == NULL, 0, test_name, 6);
+    TEST(strstr(json, "\n      \"_s.x\": [\"1.5(2)\"],\n      \"_s.q\": [\"?\"],\n      \"_s.u\": [\"\\\\?\"],\n"
+            "      \"_s.n\": [null],\n      \"_s.t\": [\"tab\\there \\\"q\\\" \\\\\"],\n") == NULL, 0, test_name, 7);
+    TEST(strstr(json, "\n      \"_l.id\": [\"1\", \"2\"],\n"
+            "      \"_l.v\": [[\"a\", {\"k\": \"b\"}], null],\n") == NULL, 0, test_name, 8);
+
+    /* reading the output back reproduces the values and the loops */
+    TEST(parse_json_text(json, json_length, &imported), CIF_OK, test_name, 10);
+    TEST(item_kind(imported, "a", "_s.x", &kind, &quoted), CIF_OK, test_name, 11);
+    TEST((kind != CIF_CHAR_KIND) || (quoted != CIF_NOT_QUOTED), 0, test_name, 12);
+    TEST(item_kind(imported, "a", "_s.q", &kind, &quoted), CIF_OK, test_name, 13);
+    TEST((kind != CIF_CHAR_KIND) || (quoted != CIF_QUOTED), 0, test_name, 14);
+    TEST(item_kind(imported, "a", "_s.u", &kind, &quoted), CIF_OK, test_name, 15);
+    TEST(kind, CIF_UNK_KIND, test_name, 16);
+    TEST(item_kind(imported, "a", "_s.n", &kind, &quoted), CIF_OK, test_name, 17);
+    TEST(kind, CIF_NA_KIND, test_name, 18);
+    TEST(item_packets(imported, "a", "_l.v", &count), CIF_OK, test_name, 19);
+    TEST(count, 2, test_name, 20);
+    TEST(item_packets(imported, "a", "_m.id", &count), CIF_OK, test_name, 21);
+    TEST(count, 3, test_name, 22);
+    TEST(cif_write_buffer(imported, options, &rewritten, &rewritten_length), CIF_OK, test_name, 23);
+    TEST(rewritten_length != json_length, 0, test_name, 24);
+    TEST(memcmp(rewritten, json, json_length), 0, test_name, 25);
+    free(rewritten);
+    free(json);
+    TEST(cif_destroy(imported), CIF_OK, test_name, 26);
+
+    /* data name selection applies */
+    options->include_names = include_names;
+    TEST(cif_write_buffer(cif, options, &json, &json_length), CIF_OK, test_name, 27);
+    TEST(strstr(json, "\"_l.v\"") == NULL, 0, test_name, 28);
+    TEST(strstr(json, "\"_l.id\"") != NULL, 0, test_name, 29);
+    TEST(strstr(json, "\"_s.x\"") != NULL, 0, test_name, 30);
+    free(json);
+    options->include_names = NULL;
+    TEST(cif_destroy(cif), CIF_OK, test_name, 31);
+
+    /* round trips of the test data */
+    for (i = 0; i < NUM_FILES; i += 1) {
+        int subtest = 40 + 10 * i;
+        FILE *cif_file;
+
+        RESOLVE_DATADIR(file_name, BUFFER_SIZE - strlen(local_file_names[i]));
+        TEST_NOT(file_name[0], 0, test_name, subtest);
+        strcat(file_name, local_file_names[i]);
+        cif_file = fopen(file_name, "rb");
+        TEST(cif_file == NULL, 0, test_name, subtest + 1);
+        cif = NULL;
+        TEST(cif_parse(cif_file, NULL, &cif), CIF_OK, test_name, subtest + 2);
+        fclose(cif_file);
+
+        TEST(cif_write_buffer(cif, options, &json, &json_length), CIF_OK, test_name, subtest + 3);
+        TEST(parse_json_text(json, json_length, &imported), CIF_OK, test_name, subtest + 4);
+        TEST(cif_write_buffer(imported, options, &rewritten, &rewritten_length), CIF_OK, test_name, subtest + 5);
+        TEST(rewritten_length != json_length, 0, test_name, subtest + 6);
+        TEST(memcmp(rewritten, json, json_length), 0, test_name, subtest + 7);
+        free(rewritten);
+        free(json);
+        TEST(cif_destroy(imported), CIF_OK, test_name, subtest + 8);
+        TEST(cif_destroy(cif), CIF_OK, test_name, subtest + 9);
+    }
+
+    /* input accepted */
+    TEST(try_json(" \n"), CIF_OK, test_name, 130);
+    TEST(try_json("{\"CIF-JSON\": {}}"), CIF_OK, test_name, 131);
+    TEST(try_json("{\"x\": [true, {\"y\": null}], \"CIF-JSON\": {\"Metadata\": {\"v\": 1.0e3}, \"b\": {}}}"), CIF_OK,
+            test_name, 132);
+    TEST(try_json("{\"CIF-JSON\": {\"b\": {\"_x\": [\"\\u00e9\\ud83d\\ude00\", -1.5e-3]}}}"), CIF_OK, test_name, 133);
+
+    /* input rejected */
+    TEST(try_json("{\"CIF-JSON\": {\"b\": {\"_x\": [\"a\"]}}"), CIF_MISSING_DELIM, test_name, 140);
+    TEST(try_json("{\"CIF-JSON\": {\"b\": {\"_x\": [\"a\", ]}}}"), CIF_MISSING_VALUE, test_name, 141);
+    TEST(try_json("{\"CIF-JSON\": {\"b\": {\"_x\": [\"a]}}}"), CIF_MISSING_ENDQUOTE, test_name, 142);
+    TEST(try_json("{\"CIF-JSON\": {\"b\": {\"_x\": [\"\\u0000\"]}}}"), CIF_INVALID_CHAR, test_name, 143);
+    TEST(try_json("{\"CIF-JSON\": {\"b\": {\"_x\": [true]}}}"), CIF_UNEXPECTED_VALUE, test_name, 144);
+    TEST(try_json("{\"CIF-JSON\": {\"b\": {\"_x\": []}}}"), CIF_UNEXPECTED_VALUE, test_name, 145);
+    TEST(try_json("{\"CIF-JSON\": {\"b\": {\"_x\": \"a\"}}}"), CIF_UNEXPECTED_VALUE, test_name, 146);
+    TEST(try_json("{\"CIF-JSON\": {\"b\": {\"_x\": [1], \"_X\": [2]}}}"), CIF_DUP_ITEMNAME, test_name, 147);
+    TEST(try_json("{\"CIF-JSON\": {\"b\": {\"_x\": [1, 2], \"_X\": [3, 4]}}}"), CIF_DUP_ITEMNAME, test_name, 148);
+    TEST(try_json("{\"CIF-JSON\": {\"b\": {\"x\": [1]}}}"), CIF_INVALID_ITEMNAME, test_name, 149);
+    TEST(try_json("{\"CIF-JSON\": {\"b\": {}, \"B\": {}}}"), CIF_DUP_BLOCKCODE, test_name, 150);
+    TEST(try_json("{\"CIF-JSON\": {}} x"), CIF_INVALID_CHAR, test_name, 151);
+    TEST(try_json("{\"other\": {}}"), CIF_UNEXPECTED_VALUE, test_name, 152);
+
+    /* arguments */
+    TEST(cif_parse_json(NULL, &cif), CIF_ARGUMENT_ERROR, test_name, 160);
+    TEST(cif_parse_json(stdin, NULL), CIF_ARGUMENT_ERROR, test_name, 161);
+
+    free(options);
+
+    return 0;
+}
@@ -182,6 +182,15 @@ int main(void) {
     TEST(cif_pktitr_next_packet(pktitr, NULL), CIF_FINISHED, test_name, 86);
     TEST(cif_pktitr_abort(pktitr), CIF_OK, test_name, 87);
 
+    /* test that a packet having exactly the loop's items is refilled in place */
+    TEST(cif_loop_get_packets(loop, &pktitr), CIF_OK, test_name, 88);
+    TEST(cif_pktitr_next_packet(pktitr, &packet), CIF_OK, test_name, 89);
+    TEST(cif_packet_get_item(packet, item1l, &value1), CIF_OK, test_name, 90);
+    TEST(cif_pktitr_next_packet(pktitr, &packet), CIF_OK, test_name, 91);
+    TEST(cif_packet_get_item(packet, item1l, &value2), CIF_OK, test_name, 92);
+    TEST(value1 != value2, 0, test_name, 93);
+    TEST(cif_pktitr_abort(pktitr), CIF_OK, test_name, 94);
+
     cif_packet_free(packet);
     cif_loop_free(loop);
     cif_frame_free(frame);
@@ -0,0 +1,170 @@
+/*
+ * test_normalize_cache.c
+ *
+ * Tests repeated normalization of non-ASCII names by cif_normalize(), which may answer from a cache of earlier
+ * results.
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unicode/ustring.h>
+#include "../cif.h"
+#include "test.h"
+
+#define NUM_NAMES 1000
+#define NAME_SIZE 16
+#define LONG_NAME_LENGTH 200
+/* the number of slots in the library's cache; names whose hashes agree modulo this number share a slot */
+#define CACHE_SLOTS 256
+
+/*
+ * Writes the name number i to original, and its normalized form to expected.  Even-numbered names have a precomposed
+ * A-ring, and odd-numbered ones the decomposed equivalent, so pairs of distinct names normalize alike.  All have a
+ * Kelvin sign, which normalizes to a lower-case k.
+ */
+static void make_name(int i, UChar *original, UChar *expected);
+
+/* computes the FNV-1a hash of the specified string, as the library's cache does */
+static unsigned long hash_name(const UChar *name);
+
+/* normalizes the specified name and compares the result with the expected one; returns 0 if they match */
+static int check_name(const UChar *name, int32_t length, const UChar *expected);
+
+static void make_name(int i, UChar *original, UChar *expected) {
+    char digits[8];
+    int o = 0;
+    int e = 0;
+    int d;
+
+    original[o++] = 0x5f;
+    expected[e++] = 0x5f;
+    if (i % 2 == 0) {
+        original[o++] = 0xc5;
+    } else {
+        original[o++] = 0x41;
+        original[o++] = 0x030a;
+    }
+    expected[e++] = 0xe5;
+    original[o++] = 0x212a;
+    expected[e++] = 0x6b;
+    original[o++] = 0x2e;
+    expected[e++] = 0x2e;
+    sprintf(digits, "%d", i);
+    for (d = 0; digits[d] != '\0'; d += 1) {
+        original[o++] = (UChar) digits[d];
+        expected[e++] = (UChar) digits[d];
+    }
+    original[o] = 0;
+    expected[e] = 0;
+}
+
+static unsigned long hash_name(const UChar *name) {
+    unsigned long hash = 2166136261UL;
+
+    for (; *name != 0; name += 1) {
+        hash = ((hash ^ (unsigned long) *name) * 16777619UL) & 0xffffffffUL;
+    }
+
+    return hash;
+}
+
+static int check_name(const UChar *name, int32_t length, const UChar *expected) {
+    UChar *result = NULL;
+    int mismatch;
+
+    if ((cif_normalize(name, length, &result) != CIF_OK) || (result == NULL)) {
+        return 1;
+    }
+    mismatch = u_strcmp(result, expected);
+    free(result);
+
+    return mismatch;
+}
+
+int main(void) {
+    char test_name[80] = "test_normalize_cache";
+    UChar (*names)[NAME_SIZE] = (UChar (*)[NAME_SIZE]) malloc(NUM_NAMES * sizeof(*names));
+    UChar (*expected)[NAME_SIZE] = (UChar (*)[NAME_SIZE]) malloc(NUM_NAMES * sizeof(*expected));
+    UChar long_name[LONG_NAME_LENGTH + 1];
+    UChar long_expected[LONG_NAME_LENGTH + 1];
+    UChar prefix_expected[4] = { 0x5f, 0xe5, 0x6b, 0 };
+    int first = -1;
+    int second = -1;
+    int i;
+
+    TESTHEADER(test_name);
+    TEST(names == NULL, 0, test_name, 1);
+    TEST(expected == NULL, 0, test_name, 2);
+
+    for (i = 0; i < NUM_NAMES; i += 1) {
+        make_name(i, names[i], expected[i]);
+    }
+
+    /* first sight of each name; there are more names than cache slots, so many share slots */
+    for (i = 0; i < NUM_NAMES; i += 1) {
+        TEST(check_name(names[i], -1, expected[i]), 0, test_name, 3);
+    }
+
+    /* again in reverse order, so that names are found both in the cache and displaced from it */
+    for (i = NUM_NAMES - 1; i >= 0; i -= 1) {
+        TEST(check_name(names[i], -1, expected[i]), 0, test_name, 4);
+        TEST(check_name(names[i], u_strlen(names[i]), expected[i]), 0, test_name, 5);
+        TEST(cif_normalize(names[i], -1, NULL), CIF_OK, test_name, 6);
+    }
+
+    /* two names sharing a slot, alternately, each displacing the other */
+    for (i = 1; (i < NUM_NAMES) && (second < 0); i += 1) {
+        int j;
+
+        for (j = 0; j < i; j += 1) {
+            if (((hash_name(names[i]) ^ hash_name(names[j])) & (CACHE_SLOTS - 1)) == 0) {
+                first = j;
+                second = i;
+                break;
+            }
+        }
+    }
+    TEST(second < 0, 0, test_name, 7);
+    for (i = 0; i < 4; i += 1) {
+        TEST(check_name(names[first], -1, expected[first]), 0, test_name, 8);
+        TEST(check_name(names[second], -1, expected[second]), 0, test_name, 9);
+    }
+
+    /* a leading part of a name that was just normalized in full */
+    TEST(check_name(names[0], -1, expected[0]), 0, test_name, 10);
+    TEST(check_name(names[0], 3, prefix_expected), 0, test_name, 11);
+    TEST(check_name(names[0], -1, expected[0]), 0, test_name, 12);
+
+    /* a name too long to be cached, twice */
+    for (i = 0; i < LONG_NAME_LENGTH; i += 1) {
+        long_name[i] = 0xc5;
+        long_expected[i] = 0xe5;
+    }
+    long_name[LONG_NAME_LENGTH] = 0;
+    long_expected[LONG_NAME_LENGTH] = 0;
+    TEST(check_name(long_name, -1, long_expected), 0, test_name, 13);
+    TEST(check_name(long_name, -1, long_expected), 0, test_name, 14);
+
+    free(expected);
+    free(names);
+
+    return 0;
+}
@@ -0,0 +1,243 @@
+/*
+ * test_packet_map.c
+ *
+ * Tests the name and key lookup behind packets and table values, with enough entries to make the lookup index
+ * grow, and with removals from the middle of the entry sequence.
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unicode/ustring.h>
+#include "../cif.h"
+#include "test.h"
+
+#define BUFFER_SIZE 64
+#define NUM_ITEMS 200
+#define NUM_KEYS 300
+
+/* checks that the specified value is of kind CIF_CHAR_KIND and has the specified (ASCII) text; returns 0 if so */
+static int check_text(cif_value_tp *value, const char *expected);
+
+/* sets the value of the specified packet item to "v" followed by the specified number */
+static int set_numbered(cif_packet_tp *packet, const char *name, int number);
+
+static int check_text(cif_value_tp *value, const char *expected) {
+    char *text = NULL;
+    int result;
+
+    if ((value == NULL) || (cif_value_kind(value) != CIF_CHAR_KIND)) {
+        return 1;
+    } else if (cif_value_get_text_utf8(value, &text) != CIF_OK) {
+        return 2;
+    }
+    result = (((text != NULL) && (strcmp(text, expected) == 0)) ? 0 : 3);
+    free(text);
+
+    return result;
+}
+
+static int set_numbered(cif_packet_tp *packet, const char *name, int number) {
+    char text[BUFFER_SIZE];
+    UChar utext[BUFFER_SIZE];
+    cif_value_tp *value = NULL;
+    int result;
+
+    sprintf(text, "v%d", number);
+    if ((result = cif_value_create(CIF_UNK_KIND, &value)) == CIF_OK) {
+        if ((result = cif_value_copy_char(value, TO_UNICODE(text, utext, BUFFER_SIZE))) == CIF_OK) {
+            result = cif_packet_set_item_utf8(packet, name, value);
+        }
+        cif_value_free(value);
+    }
+
+    return result;
+}
+
+int main(void) {
+    char test_name[80] = "test_packet_map";
+    char name[BUFFER_SIZE];
+    char text[BUFFER_SIZE];
+    UChar buffer[BUFFER_SIZE];
+    UChar item1[] = { '_', 'f', 'i', 'r', 's', 't', 0 };
+    UChar item2[] = { '_', 's', 'e', 'c', 'o', 'n', 'd', 0 };
+    UChar *initial_names[] = { NULL, NULL, NULL };
+    UChar key_composed[] = { 'k', 0xc5, 0 };
+    UChar key_decomposed[] = { 'k', 'A', 0x30a, 0 };
+    cif_packet_tp *packet = NULL;
+    cif_value_tp *table = NULL;
+    cif_value_tp *first = NULL;
+    cif_value_tp *value = NULL;
+    cif_value_tp *removed = NULL;
+    const UChar **names;
+    size_t count;
+    int i;
+
+    TESTHEADER(test_name);
+
+    /* a packet created with two names, then grown well beyond them */
+    initial_names[0] = item1;
+    initial_names[1] = item2;
+    TEST(cif_packet_create(&packet, initial_names), CIF_OK, test_name, 1);
+    TEST(cif_packet_get_item(packet, item1, &first), CIF_OK, test_name, 2);
+    TEST(cif_value_copy_char(first, TO_UNICODE("first value", buffer, BUFFER_SIZE)), CIF_OK, test_name, 3);
+    for (i = 0; i < NUM_ITEMS; i += 1) {
+        sprintf(name, "_item.n%03d", i);
+        TEST(set_numbered(packet, name, i), CIF_OK, test_name, 4);
+    }
+
+    /* the names are in insertion order, and every item is found with its own value */
+    TEST(cif_packet_get_names(packet, &names), CIF_OK, test_name, 5);
+    TEST(u_strcmp(names[0], item1), 0, test_name, 6);
+    TEST(u_strcmp(names[1], item2), 0, test_name, 7);
+    for (i = 0; i < NUM_ITEMS; i += 1) {
+        sprintf(name, "_item.n%03d", i);
+        TEST(u_strcmp(names[i + 2], TO_UNICODE(name, buffer, BUFFER_SIZE)), 0, test_name, 8);
+    }
+    TEST(names[NUM_ITEMS + 2] != NULL, 0, test_name, 9);
+    free(names);
+    for (i = 0; i < NUM_ITEMS; i += 1) {
+        sprintf(name, "_item.n%03d", i);
+        sprintf(text, "v%d", i);
+        TEST(cif_packet_get_item_utf8(packet, name, &value), CIF_OK, test_name, 10);
+        TEST(check_text(value, text), 0, test_name, 11);
+    }
+
+    /* a value obtained before the packet grew is still the packet's value for its name */
+    TEST(cif_packet_get_item(packet, item1, &value), CIF_OK, test_name, 12);
+    TEST(value != first, 0, test_name, 13);
+    TEST(check_text(first, "first value"), 0, test_name, 14);
+
+    /* names match without regard to case; setting through a differently-cased name adopts that spelling */
+    TEST(cif_packet_get_item_utf8(packet, "_ITEM.N150", &value), CIF_OK, test_name, 15);
+    TEST(check_text(value, "v150"), 0, test_name, 16);
+    TEST(set_numbered(packet, "_Item.N150", 1150), CIF_OK, test_name, 17);
+    TEST(cif_packet_get_item_utf8(packet, "_item.n150", &value), CIF_OK, test_name, 18);
+    TEST(check_text(value, "v1150"), 0, test_name, 19);
+    TEST(cif_packet_get_names(packet, &names), CIF_OK, test_name, 20);
+    TEST(u_strcmp(names[152], TO_UNICODE("_Item.N150", buffer, BUFFER_SIZE)), 0, test_name, 21);
+    TEST(names[NUM_ITEMS + 2] != NULL, 0, test_name, 22);
+    free(names);
+
+    /* removing an item from the middle returns its value, closes the gap, and leaves the rest findable */
+    TEST(cif_packet_remove_item(packet, TO_UNICODE("_item.n100", buffer, BUFFER_SIZE), &removed), CIF_OK,
+            test_name, 23);
+    TEST(check_text(removed, "v100"), 0, test_name, 24);
+    cif_value_free(removed);
+    removed = NULL;
+    TEST(cif_packet_get_item_utf8(packet, "_item.n100", NULL), CIF_NOSUCH_ITEM, test_name, 25);
+    TEST(cif_packet_remove_item(packet, TO_UNICODE("_item.n100", buffer, BUFFER_SIZE), NULL), CIF_NOSUCH_ITEM,
+            test_name, 26);
+    TEST(cif_packet_get_names(packet, &names), CIF_OK, test_name, 27);
+    TEST(u_strcmp(names[101], TO_UNICODE("_item.n099", buffer, BUFFER_SIZE)), 0, test_name, 28);
+    TEST(u_strcmp(names[102], TO_UNICODE("_item.n101", buffer, BUFFER_SIZE)), 0, test_name, 29);
+    TEST(names[NUM_ITEMS + 1] != NULL, 0, test_name, 30);
+    free(names);
+
+    /* removing every even-numbered item, then restoring them, leaves every item findable */
+    for (i = 0; i < NUM_ITEMS; i += 2) {
+        sprintf(name, "_item.n%03d", i);
+        TEST(cif_packet_remove_item(packet, TO_UNICODE(name, buffer, BUFFER_SIZE), NULL),
+                ((i == 100) ? CIF_NOSUCH_ITEM : CIF_OK), test_name, 31);
+    }
+    for (i = 1; i < NUM_ITEMS; i += 2) {
+        sprintf(name, "_item.n%03d", i);
+        sprintf(text, "v%d", i);
+        TEST(cif_packet_get_item_utf8(packet, name, &value), CIF_OK, test_name, 32);
+        TEST(check_text(value, text), 0, test_name, 33);
+    }
+    for (i = 0; i < NUM_ITEMS; i += 2) {
+        sprintf(name, "_item.n%03d", i);
+        TEST(cif_packet_get_item_utf8(packet, name, NULL), CIF_NOSUCH_ITEM, test_name, 34);
+        TEST(set_numbered(packet, name, i), CIF_OK, test_name, 35);
+    }
+    for (i = 0; i < NUM_ITEMS; i += 1) {
+        sprintf(name, "_item.n%03d", i);
+        sprintf(text, "v%d", i);
+        TEST(cif_packet_get_item_utf8(packet, name, &value), CIF_OK, test_name, 36);
+        TEST(check_text(value, text), 0, test_name, 37);
+    }
+    TEST(check_text(first, "first value"), 0, test_name, 38);
+    cif_packet_free(packet);
+
+    /* a table value grown one key at a time */
+    TEST(cif_value_create(CIF_TABLE_KIND, &table), CIF_OK, test_name, 39);
+    TEST(cif_value_create(CIF_UNK_KIND, &value), CIF_OK, test_name, 40);
+    for (i = 0; i < NUM_KEYS; i += 1) {
+        sprintf(text, "v%d", i);
+        TEST(cif_value_copy_char(value, TO_UNICODE(text, buffer, BUFFER_SIZE)), CIF_OK, test_name, 41);
+        sprintf(name, "key %d", i);
+        TEST(cif_value_set_item_by_key(table, TO_UNICODE(name, buffer, BUFFER_SIZE), value), CIF_OK, test_name, 42);
+        if (i == 0) {
+            TEST(cif_value_get_item_by_key(table, buffer, &first), CIF_OK, test_name, 43);
+        }
+    }
+    cif_value_free(value);
+    TEST(cif_value_get_element_count(table, &count), CIF_OK, test_name, 44);
+    TEST(count, NUM_KEYS, test_name, 45);
+    for (i = 0; i < NUM_KEYS; i += 1) {
+        sprintf(name, "key %d", i);
+        sprintf(text, "v%d", i);
+        TEST(cif_value_get_item_by_key(table, TO_UNICODE(name, buffer, BUFFER_SIZE), &value), CIF_OK, test_name, 46);
+        TEST(check_text(value, text), 0, test_name, 47);
+    }
+    TEST(cif_value_get_item_by_key(table, TO_UNICODE("key 0", buffer, BUFFER_SIZE), &value), CIF_OK, test_name, 48);
+    TEST(value != first, 0, test_name, 49);
+
+    /* keys, unlike data names, match with regard to case */
+    TEST(cif_value_get_item_by_key(table, TO_UNICODE("KEY 7", buffer, BUFFER_SIZE), NULL), CIF_NOSUCH_ITEM,
+            test_name, 50);
+
+    /* keys match without regard to Unicode normalization form */
+    TEST(cif_value_set_item_by_key(table, key_composed, NULL), CIF_OK, test_name, 51);
+    TEST(cif_value_get_item_by_key(table, key_decomposed, &value), CIF_OK, test_name, 52);
+    TEST(cif_value_kind(value), CIF_UNK_KIND, test_name, 53);
+
+    /* removals leave the other entries findable, and return their values */
+    for (i = 0; i < NUM_KEYS; i += 3) {
+        sprintf(name, "key %d", i);
+        sprintf(text, "v%d", i);
+        TEST(cif_value_remove_item_by_key(table, TO_UNICODE(name, buffer, BUFFER_SIZE), &removed), CIF_OK,
+                test_name, 54);
+        TEST(check_text(removed, text), 0, test_name, 55);
+        cif_value_free(removed);
+        removed = NULL;
+    }
+    TEST(cif_value_get_element_count(table, &count), CIF_OK, test_name, 56);
+    TEST(count, NUM_KEYS - NUM_KEYS / 3 + 1, test_name, 57);
+    for (i = 0; i < NUM_KEYS; i += 1) {
+        sprintf(name, "key %d", i);
+        sprintf(text, "v%d", i);
+        if (i % 3 == 0) {
+            TEST(cif_value_get_item_by_key(table, TO_UNICODE(name, buffer, BUFFER_SIZE), NULL), CIF_NOSUCH_ITEM,
+                    test_name, 58);
+        } else {
+            TEST(cif_value_get_item_by_key(table, TO_UNICODE(name, buffer, BUFFER_SIZE), &value), CIF_OK,
+                    test_name, 59);
+            TEST(check_text(value, text), 0, test_name, 60);
+        }
+    }
+    TEST(cif_value_remove_item_by_key(table, key_decomposed, NULL), CIF_OK, test_name, 61);
+    TEST(cif_value_get_item_by_key(table, key_composed, NULL), CIF_NOSUCH_ITEM, test_name, 62);
+    cif_value_free(table);
+
+    return 0;
+}
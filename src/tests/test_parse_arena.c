@@ -0,0 +1,266 @@
+/*
+ * test_parse_arena.c
+ *
+ * Tests parsing CIFs whose transient data (data names, loop headers, table keys) exercise the parser's scratch
+ * arena, and whose unlooped items share one reused value object.
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unicode/ustring.h>
+#include "../cif.h"
+#include "test.h"
+
+#define BUFFER_SIZE 80
+#define NUM_NAMES 300
+#define NUM_KEYS 200
+
+/* the kinds of the values presented to the item handler, in order */
+struct kinds_s {
+    cif_kind_tp kinds[16];
+    int count;
+};
+
+/* writes the specified text to a new temporary file, and rewinds it */
+static FILE *text_stream(const char *text, size_t length);
+
+/* records the kind of each value presented, in a struct kinds_s */
+static int record_kind(UChar *name, cif_value_tp *value, void *context);
+
+/* checks the specified item of the specified block for the expected kind and (UTF-8) text */
+static int check_item(cif_block_tp *block, const char *name, cif_kind_tp kind, const char *text);
+
+static FILE *text_stream(const char *text, size_t length) {
+    FILE *stream = tmpfile();
+
+    if (stream != NULL) {
+        if (fwrite(text, 1, length, stream) != length) {
+            fclose(stream);
+            stream = NULL;
+        } else {
+            rewind(stream);
+        }
+    }
+
+    return stream;
+}
+
+static int record_kind(UChar *name UNUSED, cif_value_tp *value, void *context) {
+    struct kinds_s *kinds = (struct kinds_s *) context;
+
+    if (kinds->count < 16) {
+        kinds->kinds[kinds->count] = cif_value_kind(value);
+    }
+    kinds->count += 1;
+    return CIF_TRAVERSE_CONTINUE;
+}
+
+static int check_item(cif_block_tp *block, const char *name, cif_kind_tp kind, const char *text) {
+    cif_value_tp *value = NULL;
+    char *actual = NULL;
+    int result;
+
+    if (cif_container_get_value_utf8(block, name, &value) != CIF_OK) {
+        return 1;
+    }
+    if (cif_value_kind(value) != kind) {
+        result = 2;
+    } else if (text == NULL) {
+        result = 0;
+    } else if (cif_value_get_text_utf8(value, &actual) != CIF_OK) {
+        result = 3;
+    } else {
+        result = ((actual != NULL) && (strcmp(actual, text) == 0)) ? 0 : 4;
+        free(actual);
+    }
+    cif_value_free(value);
+
+    return result;
+}
+
+static const char MIXED_CIF[] =
+        "#\\#CIF_2.0\n"
+        "data_mixed\n"
+        "_a.numb 1.25(3)\n"
+        "_a.char unquoted\n"
+        "_a.list [1 'two' [3]]\n"
+        "_a.table {'k':v 'j':[x]}\n"
+        "_a.quoted 'quoted text'\n"
+        "_a.na .\n"
+        "_a.unk ?\n"
+        "_a.text\n;line one\nline two\n;\n"
+        "_a.last 42\n";
+
+static const char DUPLICATE_CIF[] =
+        "data_dup\n"
+        "_dup.name first\n"
+        "_dup.name second\n"
+        "_dup.after third\n";
+
+int main(void) {
+    char test_name[80] = "test_parse_arena";
+    struct cif_parse_opts_s *options;
+    cif_handler_tp handler = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+    struct kinds_s kinds;
+    FILE *stream;
+    cif_tp *cif = NULL;
+    cif_block_tp *block = NULL;
+    cif_loop_tp *loop = NULL;
+    cif_value_tp *value = NULL;
+    cif_value_tp *element = NULL;
+    UChar buffer[BUFFER_SIZE];
+    UChar **names;
+    char *big;
+    char *cursor;
+    size_t count;
+    int i;
+
+    TESTHEADER(test_name);
+
+    TEST(cif_parse_options_create(&options), CIF_OK, test_name, 1);
+
+    /* unlooped items of every kind, in sequence, each presented to the handler and recorded with its own value */
+    stream = text_stream(MIXED_CIF, sizeof(MIXED_CIF) - 1);
+    TEST(stream == NULL, 0, test_name, 2);
+    kinds.count = 0;
+    handler.handle_item = record_kind;
+    options->handler = &handler;
+    options->user_data = &kinds;
+    TEST(cif_parse(stream, options, &cif), CIF_OK, test_name, 3);
+    fclose(stream);
+    TEST(kinds.count, 9, test_name, 4);
+    TEST(kinds.kinds[0], CIF_CHAR_KIND, test_name, 5);
+    TEST(kinds.kinds[1], CIF_CHAR_KIND, test_name, 6);
+    TEST(kinds.kinds[2], CIF_LIST_KIND, test_name, 7);
+    TEST(kinds.kinds[3], CIF_TABLE_KIND, test_name, 8);
+    TEST(kinds.kinds[4], CIF_CHAR_KIND, test_name, 9);
+    TEST(kinds.kinds[5], CIF_NA_KIND, test_name, 10);
+    TEST(kinds.kinds[6], CIF_UNK_KIND, test_name, 11);
+    TEST(kinds.kinds[7], CIF_CHAR_KIND, test_name, 12);
+    TEST(kinds.kinds[8], CIF_CHAR_KIND, test_name, 13);
+    TEST(cif_get_block(cif, TO_UNICODE("mixed", buffer, BUFFER_SIZE), &block), CIF_OK, test_name, 14);
+    TEST(check_item(block, "_a.numb", CIF_CHAR_KIND, "1.25(3)"), 0, test_name, 15);
+    TEST(check_item(block, "_a.char", CIF_CHAR_KIND, "unquoted"), 0, test_name, 16);
+    TEST(check_item(block, "_a.list", CIF_LIST_KIND, NULL), 0, test_name, 17);
+    TEST(check_item(block, "_a.table", CIF_TABLE_KIND, NULL), 0, test_name, 18);
+    TEST(check_item(block, "_a.quoted", CIF_CHAR_KIND, "quoted text"), 0, test_name, 19);
+    TEST(check_item(block, "_a.na", CIF_NA_KIND, NULL), 0, test_name, 20);
+    TEST(check_item(block, "_a.unk", CIF_UNK_KIND, NULL), 0, test_name, 21);
+    TEST(check_item(block, "_a.text", CIF_CHAR_KIND, "line one\nline two"), 0, test_name, 22);
+    TEST(check_item(block, "_a.last", CIF_CHAR_KIND, "42"), 0, test_name, 23);
+
+    /* the composite values were not disturbed by reuse of the value object for the later items */
+    TEST(cif_container_get_value_utf8(block, "_a.list", &value), CIF_OK, test_name, 24);
+    TEST(cif_value_get_element_count(value, &count), CIF_OK, test_name, 25);
+    TEST(count, 3, test_name, 26);
+    TEST(cif_value_get_element_at(value, 2, &element), CIF_OK, test_name, 27);
+    TEST(cif_value_kind(element), CIF_LIST_KIND, test_name, 28);
+    cif_value_free(value);
+    value = NULL;
+    TEST(cif_container_get_value_utf8(block, "_a.table", &value), CIF_OK, test_name, 29);
+    TEST(cif_value_get_element_count(value, &count), CIF_OK, test_name, 30);
+    TEST(count, 2, test_name, 31);
+    TEST(cif_value_get_item_by_key(value, TO_UNICODE("j", buffer, BUFFER_SIZE), &element), CIF_OK, test_name, 32);
+    TEST(cif_value_kind(element), CIF_LIST_KIND, test_name, 33);
+    cif_value_free(value);
+    value = NULL;
+    cif_block_free(block);
+    block = NULL;
+    DESTROY_CIF(test_name, cif);
+    cif = NULL;
+    options->handler = NULL;
+    options->user_data = NULL;
+
+    /* a loop header and a table whose names and keys together exceed one arena chunk several times over */
+    big = (char *) malloc(NUM_NAMES * 64 + NUM_KEYS * 96 + 128);
+    TEST(big == NULL, 0, test_name, 34);
+    cursor = big;
+    cursor += sprintf(cursor, "#\\#CIF_2.0\ndata_big\nloop_\n");
+    for (i = 0; i < NUM_NAMES; i += 1) {
+        cursor += sprintf(cursor, "_a_rather_long_category_name.item_number_%03d\n", i);
+    }
+    for (i = 0; i < NUM_NAMES; i += 1) {
+        cursor += sprintf(cursor, "v%d\n", i);
+    }
+    cursor += sprintf(cursor, "_keyed.table {");
+    for (i = 0; i < NUM_KEYS; i += 1) {
+        cursor += sprintf(cursor, "'a rather long table key, number %03d, for the arena':%d\n", i, i);
+    }
+    cursor += sprintf(cursor, "}\n_after.all done\n");
+    stream = text_stream(big, (size_t) (cursor - big));
+    free(big);
+    TEST(stream == NULL, 0, test_name, 35);
+    TEST(cif_parse(stream, options, &cif), CIF_OK, test_name, 36);
+    fclose(stream);
+    TEST(cif_get_block(cif, TO_UNICODE("big", buffer, BUFFER_SIZE), &block), CIF_OK, test_name, 37);
+    TEST(cif_container_get_item_loop(block, TO_UNICODE("_a_rather_long_category_name.item_number_000", buffer,
+            BUFFER_SIZE), &loop), CIF_OK, test_name, 38);
+    TEST(cif_loop_get_names(loop, &names), CIF_OK, test_name, 39);
+    for (i = 0; names[i] != NULL; i += 1) {
+        free(names[i]);
+    }
+    free(names);
+    cif_loop_free(loop);
+    TEST(i, NUM_NAMES, test_name, 40);
+    TEST(check_item(block, "_a_rather_long_category_name.item_number_000", CIF_CHAR_KIND, "v0"), 0, test_name, 41);
+    TEST(check_item(block, "_a_rather_long_category_name.item_number_299", CIF_CHAR_KIND, "v299"), 0, test_name,
+            42);
+    TEST(cif_container_get_value_utf8(block, "_keyed.table", &value), CIF_OK, test_name, 43);
+    TEST(cif_value_get_element_count(value, &count), CIF_OK, test_name, 44);
+    TEST(count, NUM_KEYS, test_name, 45);
+    TEST(cif_value_get_item_by_key(value, TO_UNICODE("a rather long table key, number 199, for the arena", buffer,
+            BUFFER_SIZE), &element), CIF_OK, test_name, 46);
+    cif_value_free(value);
+    TEST(check_item(block, "_after.all", CIF_CHAR_KIND, "done"), 0, test_name, 47);
+    cif_block_free(block);
+    block = NULL;
+    DESTROY_CIF(test_name, cif);
+    cif = NULL;
+
+    /* a duplicate data name, with an error callback that aborts the parse */
+    stream = text_stream(DUPLICATE_CIF, sizeof(DUPLICATE_CIF) - 1);
+    TEST(stream == NULL, 0, test_name, 48);
+    options->error_callback = cif_parse_error_die;
+    TEST(cif_parse(stream, options, &cif), CIF_DUP_ITEMNAME, test_name, 49);
+    TEST(cif_get_block(cif, TO_UNICODE("dup", buffer, BUFFER_SIZE), &block), CIF_OK, test_name, 50);
+    TEST(check_item(block, "_dup.name", CIF_CHAR_KIND, "first"), 0, test_name, 51);
+    TEST(check_item(block, "_dup.after", CIF_CHAR_KIND, NULL), 1, test_name, 52);
+    cif_block_free(block);
+    block = NULL;
+    DESTROY_CIF(test_name, cif);
+    cif = NULL;
+
+    /* a duplicate data name, with an error callback that lets the parse continue */
+    rewind(stream);
+    options->error_callback = cif_parse_error_ignore;
+    TEST(cif_parse(stream, options, &cif), CIF_OK, test_name, 53);
+    fclose(stream);
+    TEST(cif_get_block(cif, TO_UNICODE("dup", buffer, BUFFER_SIZE), &block), CIF_OK, test_name, 54);
+    TEST(check_item(block, "_dup.name", CIF_CHAR_KIND, "first"), 0, test_name, 55);
+    TEST(check_item(block, "_dup.after", CIF_CHAR_KIND, "third"), 0, test_name, 56);
+    cif_block_free(block);
+    DESTROY_CIF(test_name, cif);
+
+    free(options);
+
+    return 0;
+}
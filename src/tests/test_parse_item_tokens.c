@@ -0,0 +1,220 @@
+/*
+ * test_parse_item_tokens.c
+ *
+ * Tests parsing with an item token callback, which receives undecoded views of data values.
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unicode/ustring.h>
+#include "../cif.h"
+#include "test.h"
+
+#define BUFFER_SIZE 256
+
+struct token_counts_s {
+    int items;
+    int mismatches;
+    int errors;
+    int abort_code;
+};
+
+/* Determines whether the specified name matches the specified ASCII string */
+static int name_is(const UChar *name, const char *expected);
+
+/* Determines whether the specified token text matches the specified ASCII string */
+static int text_is(struct cif_token_s *token, const char *expected);
+
+/* Verifies the token views presented for the data items of TOKEN_CIF */
+static int check_token(UChar *name, struct cif_token_s *token, void *data);
+
+/* Counts parse errors, and ignores them */
+static int count_errors(int code, size_t line, size_t column, const UChar *text, size_t length, void *data);
+
+static int name_is(const UChar *name, const char *expected) {
+    UChar buffer[BUFFER_SIZE];
+
+    return (u_strcmp(name, TO_UNICODE(expected, buffer, BUFFER_SIZE)) == 0);
+}
+
+static int text_is(struct cif_token_s *token, const char *expected) {
+    UChar buffer[BUFFER_SIZE];
+    int32_t length = u_unescape(expected, buffer, BUFFER_SIZE);
+
+    return (token->text != NULL) && (token->length == (size_t) length)
+            && (u_strncmp(token->text, buffer, length) == 0);
+}
+
+static int check_token(UChar *name, struct cif_token_s *token, void *data) {
+    struct token_counts_s *counts = (struct token_counts_s *) data;
+    cif_value_tp *value = NULL;
+    cif_value_tp *value2 = NULL;
+    UChar *text = NULL;
+    int ok = 1;
+    int result = CIF_TRAVERSE_CONTINUE;
+
+    counts->items += 1;
+    if (name_is(name, "_p")) {
+        ok = (token->kind == CIF_UNK_KIND) && !token->quoted;
+    } else if (name_is(name, "_q")) {
+        ok = (token->kind == CIF_CHAR_KIND) && token->quoted && !token->text_field && text_is(token, "quoted");
+    } else if (name_is(name, "_r")) {
+        ok = (token->kind == CIF_LIST_KIND) && (token->text == NULL)
+                && (cif_token_get_value(token, &value) == CIF_OK)
+                && (cif_token_get_value(token, &value2) == CIF_OK)
+                && (value == value2) && (cif_value_kind(value) == CIF_LIST_KIND);
+        if (ok && (counts->abort_code != CIF_OK)) {
+            result = counts->abort_code;
+        }
+    } else if (name_is(name, "_s")) {
+        ok = (token->kind == CIF_CHAR_KIND) && !token->quoted && text_is(token, "plain");
+        result = CIF_TRAVERSE_SKIP_CURRENT;
+    } else if (name_is(name, "_t")) {
+        ok = token->text_field && token->quoted && (cif_token_get_value(token, &value) == CIF_OK)
+                && (cif_value_get_text(value, &text) == CIF_OK) && name_is(text, "text");
+        free(text);
+    } else if (name_is(name, "_u") || name_is(name, "_v")) {
+        ok = (token->kind == CIF_CHAR_KIND) && !token->quoted && (token->length == 1);
+    } else if (name_is(name, "_w")) {
+        ok = (token->kind == CIF_NA_KIND);
+    } else {
+        ok = 0;
+    }
+
+    if (!ok) {
+        counts->mismatches += 1;
+    }
+
+    return result;
+}
+
+static int count_errors(int code UNUSED, size_t line UNUSED, size_t column UNUSED, const UChar *text UNUSED,
+        size_t length UNUSED, void *data) {
+    ((struct token_counts_s *) data)->errors += 1;
+    return CIF_OK;
+}
+
+static const char TOKEN_CIF[] =
+        "#\\#CIF_2.0\n"
+        "data_a\n"
+        "_p ?\n"
+        "_q 'quoted'\n"
+        "_r [1 2]\n"
+        "_s plain\n"
+        "_t\n;text\n;\n"
+        "loop_ _u _v 1 2 3 4\n"
+        "_w .\n";
+
+static const char BARE_CIF[] =
+        "#\\#CIF_2.0\n"
+        "data_b\n"
+        "_x $bad\n"
+        "loop_ _y a $worse\n";
+
+int main(void) {
+    char test_name[80] = "test_parse_item_tokens";
+    FILE *stream;
+    struct cif_parse_opts_s *options;
+    struct token_counts_s counts;
+    cif_tp *cif = NULL;
+    cif_block_tp *block = NULL;
+    cif_value_tp *value = NULL;
+    UChar buffer[BUFFER_SIZE];
+    UChar *text;
+
+    TESTHEADER(test_name);
+
+    stream = tmpfile();
+    TEST(stream == NULL, 0, test_name, 1);
+    TEST(fwrite(TOKEN_CIF, 1, sizeof(TOKEN_CIF) - 1, stream), sizeof(TOKEN_CIF) - 1, test_name, 2);
+    TEST(cif_parse_options_create(&options), CIF_OK, test_name, 3);
+    options->item_token_callback = check_token;
+    options->user_data = &counts;
+
+    /* parse into a CIF */
+    counts.items = 0;
+    counts.mismatches = 0;
+    counts.errors = 0;
+    counts.abort_code = CIF_OK;
+    rewind(stream);
+    TEST(cif_parse(stream, options, &cif), CIF_OK, test_name, 4);
+    TEST(counts.items, 10, test_name, 5);
+    TEST(counts.mismatches, 0, test_name, 6);
+
+    /* verify that the items were recorded, except for the one skipped */
+    TEST(cif_get_block(cif, TO_UNICODE("a", buffer, BUFFER_SIZE), &block), CIF_OK, test_name, 7);
+    TEST(cif_container_get_value(block, TO_UNICODE("_p", buffer, BUFFER_SIZE), &value), CIF_OK, test_name, 8);
+    TEST(cif_value_kind(value), CIF_UNK_KIND, test_name, 9);
+    TEST(cif_container_get_value(block, TO_UNICODE("_q", buffer, BUFFER_SIZE), &value), CIF_OK, test_name, 10);
+    TEST(cif_value_get_text(value, &text), CIF_OK, test_name, 11);
+    TEST(u_strcmp(text, TO_UNICODE("quoted", buffer, BUFFER_SIZE)), 0, test_name, 12);
+    free(text);
+    TEST(cif_container_get_value(block, TO_UNICODE("_r", buffer, BUFFER_SIZE), &value), CIF_OK, test_name, 13);
+    TEST(cif_value_kind(value), CIF_LIST_KIND, test_name, 14);
+    TEST(cif_container_get_value(block, TO_UNICODE("_s", buffer, BUFFER_SIZE), NULL), CIF_NOSUCH_ITEM,
+            test_name, 15);
+    TEST(cif_container_get_value(block, TO_UNICODE("_t", buffer, BUFFER_SIZE), &value), CIF_OK, test_name, 16);
+    TEST(cif_value_get_text(value, &text), CIF_OK, test_name, 17);
+    TEST(u_strcmp(text, TO_UNICODE("text", buffer, BUFFER_SIZE)), 0, test_name, 18);
+    free(text);
+    TEST(cif_container_get_value(block, TO_UNICODE("_u", buffer, BUFFER_SIZE), NULL), CIF_AMBIGUOUS_ITEM,
+            test_name, 19);
+    TEST(cif_container_get_value(block, TO_UNICODE("_w", buffer, BUFFER_SIZE), &value), CIF_OK, test_name, 20);
+    TEST(cif_value_kind(value), CIF_NA_KIND, test_name, 21);
+    cif_value_free(value);
+    value = NULL;
+    cif_block_free(block);
+    DESTROY_CIF(test_name, cif);
+    cif = NULL;
+
+    /* parse without recording anything; the callback still sees every item */
+    counts.items = 0;
+    rewind(stream);
+    TEST(cif_parse(stream, options, NULL), CIF_OK, test_name, 22);
+    TEST(counts.items, 10, test_name, 23);
+    TEST(counts.mismatches, 0, test_name, 24);
+
+    /* the callback can abort the parse */
+    counts.items = 0;
+    counts.abort_code = CIF_ERROR;
+    rewind(stream);
+    TEST(cif_parse(stream, options, NULL), CIF_ERROR, test_name, 25);
+    TEST(counts.items, 3, test_name, 26);
+    TEST(counts.mismatches, 0, test_name, 27);
+    fclose(stream);
+
+    /* values that are not decoded are still checked for validity */
+    stream = tmpfile();
+    TEST(stream == NULL, 0, test_name, 28);
+    TEST(fwrite(BARE_CIF, 1, sizeof(BARE_CIF) - 1, stream), sizeof(BARE_CIF) - 1, test_name, 29);
+    options->item_token_callback = NULL;
+    options->error_callback = count_errors;
+    counts.errors = 0;
+    rewind(stream);
+    TEST(cif_parse(stream, options, NULL), CIF_OK, test_name, 30);
+    TEST(counts.errors, 2, test_name, 31);
+    fclose(stream);
+
+    free(options);
+
+    return 0;
+}
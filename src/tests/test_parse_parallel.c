@@ -0,0 +1,216 @@
+/*
+ * test_parse_parallel.c
+ *
+ * Tests parsing multi-block CIFs in parallel mode.
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unicode/ustring.h>
+#include "../cif.h"
+
+#include "assert_cifs.h"
+#include "test.h"
+
+#define BUFFER_SIZE 512
+#define MAX_ERRORS   16
+
+/* records the errors reported during a parse */
+struct error_log_s {
+    int count;
+    int codes[MAX_ERRORS];
+    size_t lines[MAX_ERRORS];
+};
+
+static int record_error(int code, size_t line, size_t column, const UChar *text, size_t length, void *data);
+
+static int record_error(int code, size_t line, size_t column UNUSED, const UChar *text UNUSED, size_t length UNUSED,
+        void *data) {
+    struct error_log_s *log = (struct error_log_s *) data;
+
+    if (log->count < MAX_ERRORS) {
+        log->codes[log->count] = code;
+        log->lines[log->count] = line;
+    }
+    log->count += 1;
+
+    return CIF_OK;
+}
+
+/* CIF text with errors in its second and fourth blocks, and a duplicate block code in its last block */
+static const char ERRONEOUS_CIF[] =
+        "#\\#CIF_2.0\n"
+        "data_one\n_a 1\n"
+        "data_two\n_b 'unterminated\n_c 3\n"
+        "data_three\nloop_ _d _e 1 2 3 4\n"
+        "data_four\n_f 1\n_f 2\n"
+        "data_five\n_g [ 1 2 ]\n"
+        "data_ONE\n_h 1\n";
+
+int main(void) {
+    char test_name[80] = "test_parse_parallel";
+    char local_file_name[] = "multi_block.cif";
+    char file_name[BUFFER_SIZE];
+    FILE * cif_file;
+    cif_tp *cif_serial = NULL;
+    cif_tp *cif_parallel = NULL;
+    cif_block_tp **block_list;
+    cif_block_tp **block_p;
+    struct cif_parse_opts_s *options;
+    struct error_log_s serial_log;
+    struct error_log_s parallel_log;
+    int threads;
+    int i;
+    const char *expected_codes[] = { "first", "Second", "third", "Fourth", "fifth" };
+
+    /* Initialize data and prepare the test fixture */
+    TESTHEADER(test_name);
+
+    /* construct the test file name and open the file */
+    RESOLVE_DATADIR(file_name, BUFFER_SIZE - strlen(local_file_name));
+    TEST_NOT(file_name[0], 0, test_name, 1);
+    strcat(file_name, local_file_name);
+    cif_file = fopen(file_name, "rb");
+    TEST(cif_file == NULL, 0, test_name, 2);
+
+    /* parse the file serially, for reference */
+    TEST(cif_parse(cif_file, NULL, &cif_serial), CIF_OK, test_name, 3);
+    TEST(cif_parse_options_create(&options), CIF_OK, test_name, 4);
+
+    for (threads = 2; threads <= 8; threads *= 2) {
+        int subtest = 10 * threads;
+
+        /* parse the same file in parallel mode */
+        rewind(cif_file);
+        options->max_parse_threads = threads;
+        TEST(cif_parse(cif_file, options, &cif_parallel), CIF_OK, test_name, subtest + 1);
+        TEST(assert_cifs_equal(cif_serial, cif_parallel), 1, test_name, subtest + 2);
+
+        /* the blocks must be presented in document order */
+        TEST(cif_get_all_blocks(cif_parallel, &block_list), CIF_OK, test_name, subtest + 3);
+        for (i = 0, block_p = block_list; *block_p; i += 1, block_p += 1) {
+            UChar *code;
+            UChar expected[BUFFER_SIZE];
+
+            TEST(i < 5, 1, test_name, subtest + 4);
+            TEST(cif_container_get_code(*block_p, &code), CIF_OK, test_name, subtest + 5);
+            TO_UNICODE(expected_codes[i], expected, BUFFER_SIZE);
+            TEST(u_strcmp(code, expected), 0, test_name, subtest + 6);
+            free(code);
+            cif_container_free(*block_p);
+        }
+        free(block_list);
+        TEST(i, 5, test_name, subtest + 7);
+
+        DESTROY_CIF(test_name, cif_parallel);
+        cif_parallel = NULL;
+    }
+
+    DESTROY_CIF(test_name, cif_serial);
+    cif_serial = NULL;
+    fclose(cif_file);  /* ignore any failure here */
+
+    /* errors must be reported exactly as they are by a serial parse */
+    cif_file = tmpfile();
+    TEST(cif_file == NULL, 0, test_name, 100);
+    TEST(fwrite(ERRONEOUS_CIF, 1, sizeof(ERRONEOUS_CIF) - 1, cif_file), sizeof(ERRONEOUS_CIF) - 1, test_name, 101);
+
+    options->error_callback = record_error;
+    options->max_parse_threads = 1;
+    options->user_data = &serial_log;
+    serial_log.count = 0;
+    rewind(cif_file);
+    TEST(cif_parse(cif_file, options, &cif_serial), CIF_OK, test_name, 102);
+    TEST(serial_log.count >= 3, 1, test_name, 103);
+    TEST(serial_log.count <= MAX_ERRORS, 1, test_name, 104);
+
+    options->max_parse_threads = 4;
+    options->user_data = &parallel_log;
+    parallel_log.count = 0;
+    rewind(cif_file);
+    TEST(cif_parse(cif_file, options, &cif_parallel), CIF_OK, test_name, 105);
+    TEST(parallel_log.count, serial_log.count, test_name, 106);
+    for (i = 0; i < serial_log.count; i += 1) {
+        TEST(parallel_log.codes[i], serial_log.codes[i], test_name, 107);
+        TEST(parallel_log.lines[i], serial_log.lines[i], test_name, 108);
+    }
+    TEST(assert_cifs_equal(cif_serial, cif_parallel), 1, test_name, 109);
+
+    /* syntax-only mode */
+    parallel_log.count = 0;
+    rewind(cif_file);
+    TEST(cif_parse(cif_file, options, NULL), CIF_OK, test_name, 110);
+    TEST(parallel_log.count > 0, 1, test_name, 111);
+
+    DESTROY_CIF(test_name, cif_parallel);
+    DESTROY_CIF(test_name, cif_serial);
+    fclose(cif_file);
+
+    /*
+     * with CRLF line terminators, including some split between reads, errors are reported exactly as for LF ones;
+     * the padding lines make the text span several of the scanner's reads
+     */
+    cif_file = tmpfile();
+    TEST(cif_file == NULL, 0, test_name, 120);
+    for (i = 0; i < 2000; i += 1) {
+        TEST(fputs((i % 2) ? "#\r\n" : "\r\n", cif_file) < 0, 0, test_name, 121);
+    }
+    for (i = 0; ERRONEOUS_CIF[i] != '\0'; i += 1) {
+        if (ERRONEOUS_CIF[i] == '\n') {
+            TEST(putc('\r', cif_file), '\r', test_name, 122);
+        }
+        TEST(putc(ERRONEOUS_CIF[i], cif_file), ERRONEOUS_CIF[i], test_name, 123);
+    }
+    TEST(fputs("data_six\r\n_i\r\n", cif_file) < 0, 0, test_name, 124);
+
+    options->max_parse_threads = 1;
+    options->user_data = &serial_log;
+    serial_log.count = 0;
+    rewind(cif_file);
+    cif_serial = NULL;
+    TEST(cif_parse(cif_file, options, &cif_serial), CIF_OK, test_name, 125);
+    TEST(serial_log.count >= 4, 1, test_name, 126);
+    TEST(serial_log.count <= MAX_ERRORS, 1, test_name, 127);
+
+    /* the missing value at the end of the input is reported on the line following the last one */
+    TEST(serial_log.codes[serial_log.count - 1], CIF_MISSING_VALUE, test_name, 128);
+    TEST(serial_log.lines[serial_log.count - 1], 2000 + 15 + 3, test_name, 129);
+
+    options->max_parse_threads = 4;
+    options->user_data = &parallel_log;
+    parallel_log.count = 0;
+    rewind(cif_file);
+    cif_parallel = NULL;
+    TEST(cif_parse(cif_file, options, &cif_parallel), CIF_OK, test_name, 130);
+    TEST(parallel_log.count, serial_log.count, test_name, 131);
+    for (i = 0; i < serial_log.count; i += 1) {
+        TEST(parallel_log.codes[i], serial_log.codes[i], test_name, 132);
+        TEST(parallel_log.lines[i], serial_log.lines[i], test_name, 133);
+    }
+    TEST(assert_cifs_equal(cif_serial, cif_parallel), 1, test_name, 134);
+
+    DESTROY_CIF(test_name, cif_parallel);
+    DESTROY_CIF(test_name, cif_serial);
+    free(options);
+    fclose(cif_file);
+
+    return 0;
+}
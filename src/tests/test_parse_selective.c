@@ -0,0 +1,162 @@
+/*
+ * test_parse_selective.c
+ *
+ * Tests selective loading of data items via the include_names and exclude_names parse options.
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unicode/ustring.h>
+#include "../cif.h"
+#include "test.h"
+
+#define BUFFER_SIZE 64
+
+/* Determines whether the specified block has an item of the specified name; returns the lookup result code */
+static int has_item(cif_block_tp *block, const char *name);
+
+/* Counts parse errors, and ignores them */
+static int count_errors(int code, size_t line, size_t column, const UChar *text, size_t length, void *data);
+
+/* Counts handle_loop_start callbacks */
+static int count_loops(cif_loop_tp *loop, void *data);
+
+static int has_item(cif_block_tp *block, const char *name) {
+    UChar buffer[BUFFER_SIZE];
+
+    return cif_container_get_item_loop(block, TO_UNICODE(name, buffer, BUFFER_SIZE), NULL);
+}
+
+static int count_errors(int code UNUSED, size_t line UNUSED, size_t column UNUSED, const UChar *text UNUSED,
+        size_t length UNUSED, void *data) {
+    *((int *) data) += 1;
+    return CIF_OK;
+}
+
+static int count_loops(cif_loop_tp *loop UNUSED, void *data) {
+    *((int *) data) += 100;
+    return CIF_TRAVERSE_CONTINUE;
+}
+
+static const char SELECTIVE_CIF[] =
+        "data_x\n"
+        "_cell.length_a 10\n"
+        "_CELL.length_b 11\n"
+        "_symmetry.space_group 'P 1'\n"
+        "_cellar 5\n"
+        "loop_\n_atom.id _atom.x\n1 2 3 4\n"
+        "loop_\n_refine.a _other.b _refine_hist.c\n1 2 3 4 5 6\n"
+        "loop_\n_cell_measurement.t _cell_measurement.u\na b\n";
+
+static const char ERRONEOUS_CIF[] =
+        "data_y\n"
+        "_cell.length_a 10\n"
+        "loop_\n_atom.id _atom.x\n1 2 3\n";
+
+int main(void) {
+    char test_name[80] = "test_parse_selective";
+    const char *include[] = { "_cell", "_refine*", NULL };
+    const char *exclude[] = { "_cell.length_b", NULL };
+    FILE *stream;
+    struct cif_parse_opts_s *options;
+    cif_handler_tp handler = { NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL };
+    cif_tp *cif = NULL;
+    cif_block_tp *block = NULL;
+    cif_loop_tp *loop = NULL;
+    UChar buffer[BUFFER_SIZE];
+    UChar **names;
+    int count;
+
+    TESTHEADER(test_name);
+
+    stream = tmpfile();
+    TEST(stream == NULL, 0, test_name, 1);
+    TEST(fwrite(SELECTIVE_CIF, 1, sizeof(SELECTIVE_CIF) - 1, stream), sizeof(SELECTIVE_CIF) - 1, test_name, 2);
+    TEST(cif_parse_options_create(&options), CIF_OK, test_name, 3);
+    options->include_names = include;
+    handler.handle_loop_start = count_loops;
+    options->handler = &handler;
+    options->error_callback = count_errors;
+    options->user_data = &count;
+
+    /* include patterns only */
+    count = 0;
+    rewind(stream);
+    TEST(cif_parse(stream, options, &cif), CIF_OK, test_name, 4);
+    /* one loop handled, and no errors */
+    TEST(count, 100, test_name, 5);
+    TEST(cif_get_block(cif, TO_UNICODE("x", buffer, BUFFER_SIZE), &block), CIF_OK, test_name, 6);
+    TEST(has_item(block, "_cell.length_a"), CIF_OK, test_name, 7);
+    TEST(has_item(block, "_cell.length_b"), CIF_OK, test_name, 8);
+    TEST(has_item(block, "_symmetry.space_group"), CIF_NOSUCH_ITEM, test_name, 9);
+    TEST(has_item(block, "_cellar"), CIF_NOSUCH_ITEM, test_name, 10);
+    TEST(has_item(block, "_atom.id"), CIF_NOSUCH_ITEM, test_name, 11);
+    TEST(has_item(block, "_cell_measurement.t"), CIF_NOSUCH_ITEM, test_name, 12);
+    TEST(has_item(block, "_other.b"), CIF_NOSUCH_ITEM, test_name, 13);
+
+    /* the partially-selected loop retains only its selected columns, with the correct values */
+    TEST(cif_container_get_item_loop(block, TO_UNICODE("_refine.a", buffer, BUFFER_SIZE), &loop), CIF_OK,
+            test_name, 14);
+    TEST(cif_loop_get_names(loop, &names), CIF_OK, test_name, 15);
+    TEST(names[0] == NULL, 0, test_name, 16);
+    TEST(names[1] == NULL, 0, test_name, 17);
+    TEST(names[2] != NULL, 0, test_name, 18);
+    free(names[0]);
+    free(names[1]);
+    free(names);
+    cif_loop_free(loop);
+    TEST(has_item(block, "_refine_hist.c"), CIF_OK, test_name, 19);
+    cif_block_free(block);
+    block = NULL;
+    DESTROY_CIF(test_name, cif);
+    cif = NULL;
+
+    /* include and exclude patterns */
+    options->exclude_names = exclude;
+    count = 0;
+    rewind(stream);
+    TEST(cif_parse(stream, options, &cif), CIF_OK, test_name, 20);
+    TEST(count, 100, test_name, 21);
+    TEST(cif_get_block(cif, TO_UNICODE("x", buffer, BUFFER_SIZE), &block), CIF_OK, test_name, 22);
+    TEST(has_item(block, "_cell.length_a"), CIF_OK, test_name, 23);
+    TEST(has_item(block, "_cell.length_b"), CIF_NOSUCH_ITEM, test_name, 24);
+    TEST(has_item(block, "_refine_hist.c"), CIF_OK, test_name, 25);
+    cif_block_free(block);
+    block = NULL;
+    DESTROY_CIF(test_name, cif);
+    cif = NULL;
+    fclose(stream);
+
+    /* errors in loops that are passed over are still reported */
+    stream = tmpfile();
+    TEST(stream == NULL, 0, test_name, 26);
+    TEST(fwrite(ERRONEOUS_CIF, 1, sizeof(ERRONEOUS_CIF) - 1, stream), sizeof(ERRONEOUS_CIF) - 1, test_name, 27);
+    count = 0;
+    rewind(stream);
+    TEST(cif_parse(stream, options, NULL), CIF_OK, test_name, 28);
+    TEST(count, 1, test_name, 29);
+    fclose(stream);
+
+    free(options);
+
+    return 0;
+}
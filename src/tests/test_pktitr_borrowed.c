@@ -0,0 +1,261 @@
+/*
+ * test_pktitr_borrowed.c
+ *
+ * Tests iteration of loop packets via cif_pktitr_next_borrowed_packet(), whose packets and values belong to the
+ * iterator, including that values cloned from such packets remain valid after the iteration moves on.
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unicode/ustring.h>
+#include <unicode/ustdio.h>
+#include "../cif.h"
+#include "assert_value.h"
+#include "test.h"
+
+#define BUFFER_SIZE 64
+#define PACKET_COUNT 40
+#define LONG_TEXT_LENGTH 6000
+
+/* number texts stored with and without their text */
+static const char * const NUMBERS[] = { "-1.25(3)", "1.2e3", "0.0042", "12345678901234567890.5(7)" };
+
+/*
+ * Sets the specified values to those expected in the packet with the specified key
+ */
+static int set_values(int key, cif_value_tp *text, cif_value_tp *numb, cif_value_tp *list);
+
+static int set_values(int key, cif_value_tp *text, cif_value_tp *numb, cif_value_tp *list) {
+    UChar buffer[BUFFER_SIZE];
+    UChar *ustr;
+    cif_value_tp *element = NULL;
+    int i;
+
+    if ((key % 10) == 0) {
+        /* long enough to require more than one chunk of the iterator's storage */
+        ustr = (UChar *) malloc((LONG_TEXT_LENGTH + 1) * sizeof(UChar));
+        if (ustr == NULL) return CIF_MEMORY_ERROR;
+        for (i = 0; i < LONG_TEXT_LENGTH; i += 1) {
+            ustr[i] = (UChar) ('a' + ((i + key) % 26));
+        }
+        ustr[LONG_TEXT_LENGTH] = 0;
+    } else {
+        u_sprintf(buffer, "value_%d", key);
+        ustr = (UChar *) malloc((u_strlen(buffer) + 1) * sizeof(UChar));
+        if (ustr == NULL) return CIF_MEMORY_ERROR;
+        u_strcpy(ustr, buffer);
+    }
+    if (cif_value_init_char(text, ustr) != CIF_OK) {
+        free(ustr);
+        return CIF_ERROR;
+    }
+
+    ustr = (UChar *) malloc(BUFFER_SIZE * sizeof(UChar));
+    if (ustr == NULL) return CIF_MEMORY_ERROR;
+    u_uastrcpy(ustr, NUMBERS[key % 4]);
+    if (cif_value_parse_numb(numb, ustr) != CIF_OK) {
+        free(ustr);
+        return CIF_ERROR;
+    }
+
+    if ((cif_value_init(list, CIF_LIST_KIND) != CIF_OK)
+            || (cif_value_create(CIF_UNK_KIND, &element) != CIF_OK)) {
+        return CIF_ERROR;
+    }
+    for (i = 0; i < 3; i += 1) {
+        if ((cif_value_autoinit_numb(element, key + i * 0.5, 0.0, 19) != CIF_OK)
+                || (cif_value_insert_element_at(list, (size_t) i, element) != CIF_OK)) {
+            cif_value_free(element);
+            return CIF_ERROR;
+        }
+    }
+    cif_value_free(element);
+
+    return CIF_OK;
+}
+
+int main(void) {
+    char test_name[80] = "test_pktitr_borrowed";
+    cif_tp *cif = NULL;
+    cif_block_tp *block = NULL;
+    cif_loop_tp *loop = NULL;
+    cif_pktitr_tp *pktitr = NULL;
+    cif_packet_tp *packet = NULL;
+    cif_packet_tp *borrowed = NULL;
+    cif_packet_tp *previous = NULL;
+    cif_value_tp *key_value;
+    cif_value_tp *text;
+    cif_value_tp *numb;
+    cif_value_tp *list;
+    cif_value_tp *value;
+    cif_value_tp *element;
+    cif_value_tp *expected_text = NULL;
+    cif_value_tp *expected_numb = NULL;
+    cif_value_tp *expected_list = NULL;
+    cif_value_tp *text_clone = NULL;
+    cif_value_tp *numb_clone = NULL;
+    cif_value_tp *list_clone = NULL;
+    UChar buffer[BUFFER_SIZE];
+    UChar item_k[] = { '_', 'k', 0 };
+    UChar item_c[] = { '_', 'c', 0 };
+    UChar item_n[] = { '_', 'n', 0 };
+    UChar item_l[] = { '_', 'l', 0 };
+    UChar item_x[] = { '_', 'x', 0 };
+    UChar *item_names[5];
+    unsigned char seen[PACKET_COUNT] = { 0 };
+    int mismatches = 0;
+    int packets = 0;
+    int clone_key = -1;
+    int subtest;
+    int i;
+    double d;
+
+    TESTHEADER(test_name);
+    CREATE_CIF(test_name, cif);
+    TEST(cif_create_block(cif, TO_UNICODE("b", buffer, BUFFER_SIZE), &block), CIF_OK, test_name, 1);
+
+    item_names[0] = item_k;
+    item_names[1] = item_c;
+    item_names[2] = item_n;
+    item_names[3] = item_l;
+    item_names[4] = NULL;
+    TEST(cif_container_create_loop(block, NULL, item_names, &loop), CIF_OK, test_name, 2);
+
+    /* fill the loop */
+    TEST(cif_packet_create(&packet, item_names), CIF_OK, test_name, 3);
+    TEST(cif_packet_get_item(packet, item_k, &key_value), CIF_OK, test_name, 4);
+    TEST(cif_packet_get_item(packet, item_c, &text), CIF_OK, test_name, 5);
+    TEST(cif_packet_get_item(packet, item_n, &numb), CIF_OK, test_name, 6);
+    TEST(cif_packet_get_item(packet, item_l, &list), CIF_OK, test_name, 7);
+    for (i = 0; i < PACKET_COUNT; i += 1) {
+        TEST(cif_value_init_numb(key_value, (double) i, 0.0, 0, 1), CIF_OK, test_name, 10 + 3 * i);
+        TEST(set_values(i, text, numb, list), CIF_OK, test_name, 11 + 3 * i);
+        TEST(cif_loop_add_packet(loop, packet), CIF_OK, test_name, 12 + 3 * i);
+    }
+    cif_packet_free(packet);
+    packet = NULL;
+
+    TEST(cif_value_create(CIF_UNK_KIND, &expected_text), CIF_OK, test_name, 140);
+    TEST(cif_value_create(CIF_UNK_KIND, &expected_numb), CIF_OK, test_name, 141);
+    TEST(cif_value_create(CIF_UNK_KIND, &expected_list), CIF_OK, test_name, 142);
+
+    /* iterate the loop, checking every value */
+    TEST(cif_loop_get_packets(loop, &pktitr), CIF_OK, test_name, 143);
+    TEST(cif_pktitr_next_borrowed_packet(pktitr, NULL), CIF_ARGUMENT_ERROR, test_name, 144);
+    subtest = 150;
+    while (cif_pktitr_next_borrowed_packet(pktitr, &borrowed) == CIF_OK) {
+        int key;
+
+        packets += 1;
+        if ((previous != NULL) && (borrowed != previous) && (packets != 12)) {
+            /* the same packet object is provided each time, except after the caller changes its items */
+            mismatches += 1;
+        }
+        previous = borrowed;
+        if ((cif_packet_get_item(borrowed, item_k, &key_value) != CIF_OK)
+                || (cif_value_get_number(key_value, &d) != CIF_OK)
+                || (d < 0) || (d >= PACKET_COUNT) || seen[(int) d]) {
+            mismatches += 1;
+            continue;
+        }
+        key = (int) d;
+        seen[key] = 1;
+        if ((set_values(key, expected_text, expected_numb, expected_list) != CIF_OK)
+                || (cif_packet_get_item(borrowed, item_c, &text) != CIF_OK)
+                || (cif_packet_get_item(borrowed, item_n, &numb) != CIF_OK)
+                || (cif_packet_get_item(borrowed, item_l, &list) != CIF_OK)
+                || !assert_values_equal(text, expected_text)
+                || !assert_values_equal(numb, expected_numb)
+                || !assert_values_equal(list, expected_list)) {
+            mismatches += 1;
+        }
+        if (cif_value_is_quoted(numb) != CIF_NOT_QUOTED) mismatches += 1;
+
+        switch (packets) {
+            case 3:
+                /* retain copies of the values */
+                TEST(cif_value_clone(text, &text_clone), CIF_OK, test_name, subtest++);
+                TEST(cif_value_share(numb), CIF_OK, test_name, subtest++);
+                TEST(cif_value_clone(numb, &numb_clone), CIF_OK, test_name, subtest++);
+                TEST(cif_value_get_element_at(list, 1, &element), CIF_OK, test_name, subtest++);
+                TEST(cif_value_clone(list, &list_clone), CIF_OK, test_name, subtest++);
+                clone_key = key;
+                break;
+            case 7:
+                /* modify values in place */
+                TEST(cif_value_copy_char(text, TO_UNICODE("modified", buffer, BUFFER_SIZE)), CIF_OK, test_name,
+                        subtest++);
+                TEST(cif_value_get_element_at(list, 0, &element), CIF_OK, test_name, subtest++);
+                TEST(cif_value_init(element, CIF_NA_KIND), CIF_OK, test_name, subtest++);
+                TEST(cif_value_remove_element_at(list, 2, NULL), CIF_OK, test_name, subtest++);
+                break;
+            case 11:
+                /* add an item to the packet */
+                TEST(cif_packet_set_item(borrowed, item_x, NULL), CIF_OK, test_name, subtest++);
+                break;
+            default:
+                break;
+        }
+    }
+    TEST(mismatches, 0, test_name, 170);
+    TEST(packets, PACKET_COUNT, test_name, 171);
+    TEST(cif_pktitr_next_borrowed_packet(pktitr, &borrowed), CIF_FINISHED, test_name, 172);
+    TEST(cif_pktitr_close(pktitr), CIF_OK, test_name, 173);
+
+    /* the clones are independent of the iterator */
+    TEST(set_values(clone_key, expected_text, expected_numb, expected_list), CIF_OK, test_name, 174);
+    TEST(!assert_values_equal(text_clone, expected_text), 0, test_name, 175);
+    TEST(!assert_values_equal(numb_clone, expected_numb), 0, test_name, 176);
+    TEST(!assert_values_equal(list_clone, expected_list), 0, test_name, 177);
+    TEST(cif_value_get_su(numb_clone, &d), CIF_OK, test_name, 178);
+
+    /* the loop is unchanged by modifications to the borrowed packets */
+    TEST(cif_loop_get_packets(loop, &pktitr), CIF_OK, test_name, 180);
+    for (i = 0; i < PACKET_COUNT; i += 1) {
+        TEST(cif_pktitr_next_packet(pktitr, &packet), CIF_OK, test_name, 181);
+        TEST(cif_packet_get_item(packet, item_k, &key_value), CIF_OK, test_name, 182);
+        TEST(cif_value_get_number(key_value, &d), CIF_OK, test_name, 183);
+        TEST(set_values((int) d, expected_text, expected_numb, expected_list), CIF_OK, test_name, 184);
+        TEST(cif_packet_get_item(packet, item_c, &value), CIF_OK, test_name, 185);
+        TEST(!assert_values_equal(value, expected_text), 0, test_name, 186);
+        TEST(cif_packet_get_item(packet, item_l, &value), CIF_OK, test_name, 187);
+        TEST(!assert_values_equal(value, expected_list), 0, test_name, 188);
+    }
+    TEST(cif_pktitr_close(pktitr), CIF_OK, test_name, 189);
+
+    /* an iterator may be closed while it holds a borrowed packet */
+    TEST(cif_loop_get_packets(loop, &pktitr), CIF_OK, test_name, 190);
+    TEST(cif_pktitr_next_borrowed_packet(pktitr, &borrowed), CIF_OK, test_name, 191);
+    TEST(cif_pktitr_abort(pktitr), CIF_OK, test_name, 192);
+
+    cif_value_free(text_clone);
+    cif_value_free(numb_clone);
+    cif_value_free(list_clone);
+    cif_value_free(expected_text);
+    cif_value_free(expected_numb);
+    cif_value_free(expected_list);
+    cif_packet_free(packet);
+    cif_loop_free(loop);
+    cif_block_free(block);
+    DESTROY_CIF(test_name, cif);
+
+    return 0;
+}
@@ -0,0 +1,212 @@
+/*
+ * test_reader.c
+ *
+ * Tests the pull-style CIF reader.
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unicode/ustring.h>
+#include "../cif.h"
+#include "test.h"
+
+#define BUFFER_SIZE 256
+
+/* Reads the next event from the reader, and verifies its kind and text (when the expected text is not NULL) */
+static int check_event(cif_reader_tp *reader, cif_event_kind_tp kind, const char *text);
+
+static int check_event(cif_reader_tp *reader, cif_event_kind_tp kind, const char *text) {
+    struct cif_event_s event;
+    UChar buffer[BUFFER_SIZE];
+    int result = cif_reader_next(reader, &event);
+
+    if (result != CIF_OK) {
+        return result;
+    } else if (event.kind != kind) {
+        return CIF_ERROR;
+    } else if (text != NULL) {
+        int32_t length = u_unescape(text, buffer, BUFFER_SIZE);
+
+        if ((event.length != (size_t) length) || (u_strncmp(event.text, buffer, length) != 0)) {
+            return CIF_ERROR;
+        }
+    }
+    if ((kind == CIF_EVENT_ITEM) || (kind == CIF_EVENT_LOOP_VALUE)) {
+        return (event.value == NULL) ? CIF_ERROR : CIF_OK;
+    } else {
+        return (event.value == NULL) ? CIF_OK : CIF_ERROR;
+    }
+}
+
+static const char VALID_CIF[] =
+        "#\\#CIF_2.0\n"
+        "data_a\n_x 1\n"
+        "loop_ _y _z 1 2 3 4\n"
+        "save_f\n_w [1 2]\nsave_\n"
+        "data_b\n_v 'q'\n";
+
+static const char NESTED_CIF[] =
+        "#\\#CIF_2.0\n"
+        "data_n\n"
+        "save_outer\n_o 1\nsave_inner\n_i 2\nsave_\n_p 3\nsave_\n";
+
+static const char INVALID_CIF[] =
+        "#\\#CIF_2.0\n"
+        "_x 1\n"
+        "loop_ _p _q 1 2 3\n"
+        "_r x\n"
+        "save_g\n";
+
+/* an error callback that counts the errors reported in the int to which the user data point, and ignores them */
+static int count_errors(int code, size_t line, size_t column, const UChar *text, size_t length, void *data) {
+    (void) code; (void) line; (void) column; (void) text; (void) length;
+    *((int *) data) += 1;
+    return CIF_OK;
+}
+
+int main(void) {
+    char test_name[80] = "test_reader";
+    FILE *stream;
+    struct cif_parse_opts_s *options;
+    cif_reader_tp *reader = NULL;
+    struct cif_event_s event;
+    UChar buffer[BUFFER_SIZE];
+    UChar *text;
+    double d;
+    int errors;
+
+    TESTHEADER(test_name);
+
+    /* a well-formed CIF */
+    stream = tmpfile();
+    TEST(stream == NULL, 0, test_name, 1);
+    TEST(fwrite(VALID_CIF, 1, sizeof(VALID_CIF) - 1, stream), sizeof(VALID_CIF) - 1, test_name, 2);
+    rewind(stream);
+    TEST(cif_reader_open(stream, NULL, &reader), CIF_OK, test_name, 3);
+
+    TEST(check_event(reader, CIF_EVENT_BLOCK_START, "a"), CIF_OK, test_name, 4);
+    TEST(cif_reader_next(reader, &event), CIF_OK, test_name, 5);
+    TEST(event.kind, CIF_EVENT_ITEM, test_name, 6);
+    TEST(cif_value_get_number(event.value, &d), CIF_OK, test_name, 7);
+    TEST(d != 1.0, 0, test_name, 8);
+    TEST(check_event(reader, CIF_EVENT_LOOP_START, NULL), CIF_OK, test_name, 9);
+    TEST(check_event(reader, CIF_EVENT_LOOP_NAME, "_y"), CIF_OK, test_name, 10);
+    TEST(check_event(reader, CIF_EVENT_LOOP_NAME, "_z"), CIF_OK, test_name, 11);
+    TEST(check_event(reader, CIF_EVENT_LOOP_VALUE, "_y"), CIF_OK, test_name, 12);
+    TEST(check_event(reader, CIF_EVENT_LOOP_VALUE, "_z"), CIF_OK, test_name, 13);
+    TEST(check_event(reader, CIF_EVENT_LOOP_VALUE, "_y"), CIF_OK, test_name, 14);
+    TEST(cif_reader_next(reader, &event), CIF_OK, test_name, 15);
+    TEST(event.kind, CIF_EVENT_LOOP_VALUE, test_name, 16);
+    TEST(cif_value_get_number(event.value, &d), CIF_OK, test_name, 17);
+    TEST(d != 4.0, 0, test_name, 18);
+    TEST(check_event(reader, CIF_EVENT_LOOP_END, NULL), CIF_OK, test_name, 19);
+    TEST(check_event(reader, CIF_EVENT_FRAME_START, "f"), CIF_OK, test_name, 20);
+    TEST(cif_reader_next(reader, &event), CIF_OK, test_name, 21);
+    TEST(event.kind, CIF_EVENT_ITEM, test_name, 22);
+    TEST(cif_value_kind(event.value), CIF_LIST_KIND, test_name, 23);
+    TEST(check_event(reader, CIF_EVENT_FRAME_END, NULL), CIF_OK, test_name, 24);
+    TEST(check_event(reader, CIF_EVENT_BLOCK_END, NULL), CIF_OK, test_name, 25);
+    TEST(check_event(reader, CIF_EVENT_BLOCK_START, "b"), CIF_OK, test_name, 26);
+    TEST(check_event(reader, CIF_EVENT_ITEM, "_v"), CIF_OK, test_name, 27);
+    TEST(check_event(reader, CIF_EVENT_BLOCK_END, NULL), CIF_OK, test_name, 28);
+    TEST(cif_reader_next(reader, &event), CIF_FINISHED, test_name, 29);
+    TEST(cif_reader_next(reader, &event), CIF_FINISHED, test_name, 30);
+    TEST(cif_reader_close(reader), CIF_OK, test_name, 31);
+
+    /* stopping early */
+    rewind(stream);
+    TEST(cif_reader_open(stream, NULL, &reader), CIF_OK, test_name, 32);
+    TEST(check_event(reader, CIF_EVENT_BLOCK_START, "a"), CIF_OK, test_name, 33);
+    TEST(cif_reader_close(reader), CIF_OK, test_name, 34);
+    fclose(stream);
+
+    /* an erroneous CIF, with the default error callback */
+    stream = tmpfile();
+    TEST(stream == NULL, 0, test_name, 35);
+    TEST(fwrite(INVALID_CIF, 1, sizeof(INVALID_CIF) - 1, stream), sizeof(INVALID_CIF) - 1, test_name, 36);
+    rewind(stream);
+    TEST(cif_reader_open(stream, NULL, &reader), CIF_OK, test_name, 37);
+    TEST(cif_reader_next(reader, &event), CIF_NO_BLOCK_HEADER, test_name, 38);
+    TEST(cif_reader_close(reader), CIF_OK, test_name, 39);
+
+    /* the same CIF, with errors ignored */
+    TEST(cif_parse_options_create(&options), CIF_OK, test_name, 40);
+    options->error_callback = cif_parse_error_ignore;
+    rewind(stream);
+    TEST(cif_reader_open(stream, options, &reader), CIF_OK, test_name, 41);
+    TEST(check_event(reader, CIF_EVENT_BLOCK_START, ""), CIF_OK, test_name, 42);
+    TEST(check_event(reader, CIF_EVENT_ITEM, "_x"), CIF_OK, test_name, 43);
+    TEST(check_event(reader, CIF_EVENT_LOOP_START, NULL), CIF_OK, test_name, 44);
+    TEST(check_event(reader, CIF_EVENT_LOOP_NAME, "_p"), CIF_OK, test_name, 45);
+    TEST(check_event(reader, CIF_EVENT_LOOP_NAME, "_q"), CIF_OK, test_name, 46);
+    TEST(check_event(reader, CIF_EVENT_LOOP_VALUE, "_p"), CIF_OK, test_name, 47);
+    TEST(check_event(reader, CIF_EVENT_LOOP_VALUE, "_q"), CIF_OK, test_name, 48);
+    TEST(check_event(reader, CIF_EVENT_LOOP_VALUE, "_p"), CIF_OK, test_name, 49);
+    /* the partial packet is completed with an unknown value */
+    TEST(cif_reader_next(reader, &event), CIF_OK, test_name, 50);
+    TEST(event.kind, CIF_EVENT_LOOP_VALUE, test_name, 51);
+    TEST(cif_value_kind(event.value), CIF_UNK_KIND, test_name, 52);
+    TEST(check_event(reader, CIF_EVENT_LOOP_END, NULL), CIF_OK, test_name, 53);
+    TEST(cif_reader_next(reader, &event), CIF_OK, test_name, 54);
+    TEST(event.kind, CIF_EVENT_ITEM, test_name, 55);
+    TEST(cif_value_get_text(event.value, &text), CIF_OK, test_name, 56);
+    TEST(u_strcmp(text, TO_UNICODE("x", buffer, BUFFER_SIZE)), 0, test_name, 57);
+    free(text);
+    TEST(check_event(reader, CIF_EVENT_FRAME_START, "g"), CIF_OK, test_name, 58);
+    /* the unterminated frame is closed at the end of the input */
+    TEST(check_event(reader, CIF_EVENT_FRAME_END, NULL), CIF_OK, test_name, 59);
+    TEST(check_event(reader, CIF_EVENT_BLOCK_END, NULL), CIF_OK, test_name, 60);
+    TEST(cif_reader_next(reader, &event), CIF_FINISHED, test_name, 61);
+    TEST(cif_reader_close(reader), CIF_OK, test_name, 62);
+
+    free(options);
+    fclose(stream);
+
+    /* nested save frames, with unlimited nesting permitted */
+    stream = tmpfile();
+    TEST(stream == NULL, 0, test_name, 63);
+    TEST(fwrite(NESTED_CIF, 1, sizeof(NESTED_CIF) - 1, stream), sizeof(NESTED_CIF) - 1, test_name, 64);
+    rewind(stream);
+    TEST(cif_parse_options_create(&options), CIF_OK, test_name, 65);
+    options->max_frame_depth = -1;
+    options->error_callback = count_errors;
+    options->user_data = &errors;
+    errors = 0;
+    TEST(cif_reader_open(stream, options, &reader), CIF_OK, test_name, 66);
+    TEST(check_event(reader, CIF_EVENT_BLOCK_START, "n"), CIF_OK, test_name, 67);
+    TEST(check_event(reader, CIF_EVENT_FRAME_START, "outer"), CIF_OK, test_name, 68);
+    TEST(check_event(reader, CIF_EVENT_ITEM, "_o"), CIF_OK, test_name, 69);
+    TEST(check_event(reader, CIF_EVENT_FRAME_START, "inner"), CIF_OK, test_name, 70);
+    TEST(check_event(reader, CIF_EVENT_ITEM, "_i"), CIF_OK, test_name, 71);
+    TEST(check_event(reader, CIF_EVENT_FRAME_END, NULL), CIF_OK, test_name, 72);
+    TEST(check_event(reader, CIF_EVENT_ITEM, "_p"), CIF_OK, test_name, 73);
+    TEST(check_event(reader, CIF_EVENT_FRAME_END, NULL), CIF_OK, test_name, 74);
+    TEST(check_event(reader, CIF_EVENT_BLOCK_END, NULL), CIF_OK, test_name, 75);
+    TEST(cif_reader_next(reader, &event), CIF_FINISHED, test_name, 76);
+    TEST(cif_reader_close(reader), CIF_OK, test_name, 77);
+    TEST(errors, 0, test_name, 78);
+
+    free(options);
+    fclose(stream);
+
+    return 0;
+}
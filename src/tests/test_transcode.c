@@ -0,0 +1,210 @@
+/*
+ * test_transcode.c
+ *
+ * Tests transcoding CIF text directly from a stream to formatted output, checking that the output represents the same
+ * data as parsing the input into a managed CIF and writing that does.
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unicode/ustring.h>
+#include "../cif.h"
+#include "test.h"
+
+#define BUFFER_SIZE 512
+#define NUM_FILES 12
+
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} sink_data_t;
+
+/* a write sink that accumulates its output in memory */
+static int collect(void *context, const char *bytes, size_t count) {
+    sink_data_t *sink_data = (sink_data_t *) context;
+
+    if ((sink_data->length + count) > sink_data->capacity) {
+        char *temp;
+
+        while ((sink_data->length + count) > sink_data->capacity) {
+            sink_data->capacity = (sink_data->capacity == 0) ? 1024 : (2 * sink_data->capacity);
+        }
+        temp = (char *) realloc(sink_data->data, sink_data->capacity);
+        if (temp == NULL) {
+            return 1;
+        }
+        sink_data->data = temp;
+    }
+    memcpy(sink_data->data + sink_data->length, bytes, count);
+    sink_data->length += count;
+
+    return 0;
+}
+
+/*
+ * Parses the CIF in the specified stream with the specified parse options, and formats it in the specified CIF version
+ * into newly-allocated memory.  Returns a CIF API result code.
+ */
+static int parse_and_write(FILE *stream, struct cif_parse_opts_s *parse_options, int version, char **bytes,
+        size_t *length) {
+    struct cif_write_opts_s options;
+    cif_tp *cif = NULL;
+    int result;
+
+    memset(&options, 0, sizeof(options));
+    options.cif_version = version;
+    result = cif_parse(stream, parse_options, &cif);
+    if (result == CIF_OK) {
+        result = cif_write_buffer(cif, &options, bytes, length);
+    }
+    if ((cif != NULL) && (cif_destroy(cif) != CIF_OK) && (result == CIF_OK)) {
+        free(*bytes);
+        result = CIF_ERROR;
+    }
+
+    return result;
+}
+
+int main(void) {
+    char test_name[80] = "test_transcode";
+    const char *local_file_names[NUM_FILES] = {
+        "simple_data.cif", "simple_loops.cif", "simple_containers.cif", "nested.cif", "multi_block.cif",
+        "list_data.cif", "table_data.cif", "text_fields.cif", "triple.cif", "unicode.cif", "ver1.cif",
+        "cif_core.dic"
+    };
+    char file_name[BUFFER_SIZE];
+    struct cif_write_opts_s *options = NULL;
+    struct cif_parse_opts_s *parse_options = NULL;
+    FILE *cif_file;
+    FILE *transcoded;
+    sink_data_t sink_data;
+    char *expected;
+    size_t expected_length;
+    char *actual;
+    size_t actual_length;
+    int version;
+    int result;
+    int i;
+
+    TESTHEADER(test_name);
+    TEST(cif_write_options_create(&options), CIF_OK, test_name, 1);
+
+    for (i = 0; i < NUM_FILES; i += 1) {
+        int subtest = 10 + 20 * i;
+
+        RESOLVE_DATADIR(file_name, BUFFER_SIZE - strlen(local_file_names[i]));
+        TEST_NOT(file_name[0], 0, test_name, subtest);
+        strcat(file_name, local_file_names[i]);
+        cif_file = fopen(file_name, "rb");
+        TEST(cif_file == NULL, 0, test_name, subtest + 1);
+
+        for (version = 2; version > 0; version -= 1) {
+            int base = subtest + 10 * (2 - version);
+
+            /* the reference: parse the input into a managed CIF, and write that */
+            rewind(cif_file);
+            result = parse_and_write(cif_file, NULL, version, &expected, &expected_length);
+            if (result != CIF_OK) {
+                /*
+                 * not all of the test data are accepted under the default parse options, nor expressible in CIF 1.1;
+                 * the transcoder must fail in the same way
+                 */
+                rewind(cif_file);
+                memset(&sink_data, 0, sizeof(sink_data));
+                options->cif_version = version;
+                TEST(cif_transcode(cif_file, NULL, collect, &sink_data, options), result, test_name, base + 2);
+                free(sink_data.data);
+                continue;
+            }
+
+            /* transcode the input, and parse and write the result; it must describe the same data */
+            rewind(cif_file);
+            memset(&sink_data, 0, sizeof(sink_data));
+            options->cif_version = version;
+            TEST(cif_transcode(cif_file, NULL, collect, &sink_data, options), CIF_OK, test_name, base + 3);
+            transcoded = tmpfile();
+            TEST(transcoded == NULL, 0, test_name, base + 4);
+            TEST(fwrite(sink_data.data, 1, sink_data.length, transcoded) != sink_data.length, 0, test_name,
+                    base + 5);
+            rewind(transcoded);
+            free(sink_data.data);
+            TEST(parse_and_write(transcoded, NULL, version, &actual, &actual_length), CIF_OK, test_name, base + 6);
+            fclose(transcoded);
+            TEST(actual_length != expected_length, 0, test_name, base + 7);
+            TEST(memcmp(actual, expected, actual_length), 0, test_name, base + 8);
+            free(actual);
+            free(expected);
+        }
+        fclose(cif_file);
+    }
+
+    /* invalid input is rejected just as it is by the parser, but the output formatted before the error is kept */
+    cif_file = tmpfile();
+    TEST(cif_file == NULL, 0, test_name, 300);
+    TEST(fputs("#\\#CIF_2.0\ndata_good\n_a 1\ndata_bad\n_b\n", cif_file) < 0, 0, test_name, 301);
+    rewind(cif_file);
+    result = parse_and_write(cif_file, NULL, 2, &expected, &expected_length);
+    TEST(result == CIF_OK, 0, test_name, 302);
+    rewind(cif_file);
+    memset(&sink_data, 0, sizeof(sink_data));
+    TEST(cif_transcode(cif_file, NULL, collect, &sink_data, NULL), result, test_name, 303);
+    TEST(collect(&sink_data, "", 1), 0, test_name, 304);
+    TEST(strstr(sink_data.data, "data_good") == NULL, 0, test_name, 305);
+    free(sink_data.data);
+
+    /* arguments */
+    TEST(cif_transcode(NULL, NULL, collect, &sink_data, NULL), CIF_ARGUMENT_ERROR, test_name, 306);
+    TEST(cif_transcode(cif_file, NULL, NULL, &sink_data, NULL), CIF_ARGUMENT_ERROR, test_name, 307);
+    fclose(cif_file);
+
+    /* nested save frames, with unlimited nesting permitted, keep their structure */
+    cif_file = tmpfile();
+    TEST(cif_file == NULL, 0, test_name, 310);
+    TEST(fputs("#\\#CIF_2.0\ndata_n\n_b 0\nsave_outer\n_o 1\nsave_inner\n_i 2\nsave_innermost\n_j 3\nsave_\n"
+            "save_\n_p 4\nsave_\nsave_next\n_q 5\nsave_\n", cif_file) < 0, 0, test_name, 311);
+    TEST(cif_parse_options_create(&parse_options), CIF_OK, test_name, 312);
+    parse_options->max_frame_depth = -1;
+    rewind(cif_file);
+    TEST(parse_and_write(cif_file, parse_options, 2, &expected, &expected_length), CIF_OK, test_name, 313);
+    TEST(strstr(expected, "save_innermost") == NULL, 0, test_name, 314);
+    rewind(cif_file);
+    memset(&sink_data, 0, sizeof(sink_data));
+    TEST(cif_transcode(cif_file, parse_options, collect, &sink_data, NULL), CIF_OK, test_name, 315);
+    transcoded = tmpfile();
+    TEST(transcoded == NULL, 0, test_name, 316);
+    TEST(fwrite(sink_data.data, 1, sink_data.length, transcoded) != sink_data.length, 0, test_name, 317);
+    rewind(transcoded);
+    free(sink_data.data);
+    TEST(parse_and_write(transcoded, parse_options, 2, &actual, &actual_length), CIF_OK, test_name, 318);
+    fclose(transcoded);
+    TEST(actual_length != expected_length, 0, test_name, 319);
+    TEST(memcmp(actual, expected, actual_length), 0, test_name, 320);
+    free(actual);
+    free(expected);
+    free(parse_options);
+    fclose(cif_file);
+
+    free(options);
+
+    return 0;
+}
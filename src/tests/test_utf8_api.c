@@ -0,0 +1,147 @@
+/*
+ * test_utf8_api.c
+ *
+ * Tests the UTF-8 variants of the block lookup, value lookup, value text, packet, and loop name functions, checking
+ * that they match names exactly as their UTF-16 counterparts do.
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unicode/ustring.h>
+#include "../cif.h"
+#include "test.h"
+
+#define BUFFER_SIZE 128
+
+int main(void) {
+    char test_name[80] = "test_utf8_api";
+    cif_tp *cif = NULL;
+    cif_block_tp *block = NULL;
+    cif_block_tp *block2 = NULL;
+    cif_loop_tp *loop = NULL;
+    cif_packet_tp *packet = NULL;
+    cif_value_tp *value = NULL;
+    cif_value_tp *value2 = NULL;
+    UChar buffer[BUFFER_SIZE];
+    UChar *code;
+    /* "Ünï", and an item name "_Ünï" */
+    UChar unicode_code[] = { 0xdc, 'n', 0xef, 0 };
+    UChar unicode_name[] = { '_', 0xdc, 'n', 0xef, 0 };
+    UChar item1[] = { '_', 'a', 0 };
+    UChar item2[] = { '_', 'B', 0 };
+    /* "_Üx" */
+    UChar item3[] = { '_', 0xdc, 'x', 0 };
+    UChar *items[3];
+    /* "café" */
+    UChar cafe[] = { 'c', 'a', 'f', 0xe9, 0 };
+    char long_name[BUFFER_SIZE];
+    char **names;
+    char *text;
+
+    TESTHEADER(test_name);
+    CREATE_CIF(test_name, cif);
+    TEST(cif_create_block(cif, TO_UNICODE("Blk", buffer, BUFFER_SIZE), &block), CIF_OK, test_name, 1);
+    TEST(cif_create_block(cif, unicode_code, NULL), CIF_OK, test_name, 2);
+
+    /* block lookup */
+    TEST(cif_get_block_utf8(cif, "bLK", &block2), CIF_OK, test_name, 3);
+    TEST(cif_container_get_code(block2, &code), CIF_OK, test_name, 4);
+    TEST(u_strcmp(code, TO_UNICODE("Blk", buffer, BUFFER_SIZE)), 0, test_name, 5);
+    free(code);
+    cif_block_free(block2);
+    TEST(cif_get_block_utf8(cif, "nope", NULL), CIF_NOSUCH_BLOCK, test_name, 6);
+    TEST(cif_get_block_utf8(cif, "\xff\xfe", NULL), CIF_NOSUCH_BLOCK, test_name, 7);
+    /* differing case and decomposition */
+    TEST(cif_get_block_utf8(cif, "\xc3\xbcn\xc3\x8f", NULL), CIF_OK, test_name, 8);
+    TEST(cif_get_block_utf8(cif, "u\xcc\x88N\xc3\xaf", NULL), CIF_OK, test_name, 9);
+
+    /* item value lookup */
+    TEST(cif_value_create(CIF_UNK_KIND, &value), CIF_OK, test_name, 10);
+    TEST(cif_value_copy_char(value, cafe), CIF_OK, test_name, 11);
+    TEST(cif_container_set_value(block, TO_UNICODE("_Item", buffer, BUFFER_SIZE), value), CIF_OK, test_name, 12);
+    TEST(cif_value_init_numb(value, 1.25, 0.03, 2, 5), CIF_OK, test_name, 13);
+    TEST(cif_container_set_value(block, unicode_name, value), CIF_OK, test_name, 14);
+    TEST(cif_container_get_value_utf8(block, "_ITEM", &value2), CIF_OK, test_name, 15);
+    TEST(cif_container_get_value_utf8(block, "_none", NULL), CIF_NOSUCH_ITEM, test_name, 16);
+    TEST(cif_container_get_value_utf8(block, "item", NULL), CIF_NOSUCH_ITEM, test_name, 17);
+    TEST(cif_container_get_value_utf8(block, "_a b", NULL), CIF_NOSUCH_ITEM, test_name, 18);
+    TEST(cif_container_get_value_utf8(block, "_\xc0\x80", NULL), CIF_NOSUCH_ITEM, test_name, 19);
+
+    /* value text */
+    TEST(cif_value_get_text_utf8(value2, &text), CIF_OK, test_name, 20);
+    TEST(strcmp(text, "caf\xc3\xa9"), 0, test_name, 21);
+    free(text);
+    TEST(cif_container_get_value_utf8(block, "_\xc3\xbcN\xc3\xaf", &value2), CIF_OK, test_name, 22);
+    TEST(cif_value_get_text_utf8(value2, &text), CIF_OK, test_name, 23);
+    TEST(strcmp(text, "1.25(3)"), 0, test_name, 24);
+    free(text);
+    TEST(cif_value_init(value2, CIF_NA_KIND), CIF_OK, test_name, 25);
+    TEST(cif_value_get_text_utf8(value2, &text), CIF_OK, test_name, 26);
+    TEST(text != NULL, 0, test_name, 27);
+    cif_value_free(value2);
+    value2 = NULL;
+
+    /* packets */
+    TEST(cif_packet_create(&packet, NULL), CIF_OK, test_name, 30);
+    TEST(cif_packet_set_item_utf8(packet, "_A", value), CIF_OK, test_name, 31);
+    TEST(cif_packet_get_item(packet, item1, &value2), CIF_OK, test_name, 32);
+    TEST(cif_value_kind(value2), CIF_NUMB_KIND, test_name, 33);
+    TEST(cif_packet_set_item(packet, item2, NULL), CIF_OK, test_name, 34);
+    TEST(cif_packet_get_item_utf8(packet, "_b", &value2), CIF_OK, test_name, 35);
+    TEST(cif_value_kind(value2), CIF_UNK_KIND, test_name, 36);
+    TEST(cif_packet_get_item_utf8(packet, "_c", NULL), CIF_NOSUCH_ITEM, test_name, 37);
+    TEST(cif_packet_get_item_utf8(packet, "_\xff", NULL), CIF_NOSUCH_ITEM, test_name, 38);
+    TEST(cif_packet_set_item_utf8(packet, "a", NULL), CIF_INVALID_ITEMNAME, test_name, 39);
+    TEST(cif_packet_set_item_utf8(packet, "_\xe2\x82", NULL), CIF_INVALID_ITEMNAME, test_name, 40);
+    /* a name too long for the stack buffer */
+    memset(long_name, 'x', BUFFER_SIZE - 1);
+    long_name[0] = '_';
+    long_name[BUFFER_SIZE - 1] = 0;
+    TEST(cif_packet_set_item_utf8(packet, long_name, value), CIF_OK, test_name, 41);
+    long_name[1] = 'X';
+    TEST(cif_packet_get_item_utf8(packet, long_name, &value2), CIF_OK, test_name, 42);
+    TEST(cif_value_kind(value2), CIF_NUMB_KIND, test_name, 43);
+
+    /* loop names */
+    items[0] = item2;
+    items[1] = item3;
+    items[2] = NULL;
+    TEST(cif_container_create_loop(block, NULL, items, &loop), CIF_OK, test_name, 51);
+    TEST(cif_loop_get_names_utf8(loop, &names), CIF_OK, test_name, 52);
+    TEST(names[0] == NULL, 0, test_name, 53);
+    TEST(names[1] == NULL, 0, test_name, 54);
+    TEST(names[2] != NULL, 0, test_name, 55);
+    TEST(strcmp(names[0], "_B"), 0, test_name, 56);
+    TEST(strcmp(names[1], "_\xc3\x9cx"), 0, test_name, 57);
+    free(names[0]);
+    free(names[1]);
+    free(names);
+    TEST(cif_loop_get_names_utf8(loop, NULL), CIF_ARGUMENT_ERROR, test_name, 58);
+
+    cif_loop_free(loop);
+    cif_packet_free(packet);
+    cif_value_free(value);
+    cif_block_free(block);
+    DESTROY_CIF(test_name, cif);
+
+    return 0;
+}
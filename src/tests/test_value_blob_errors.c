@@ -0,0 +1,199 @@
+/*
+ * test_value_blob_errors.c
+ *
+ * Tests that list and table values whose stored serialized forms are malformed are reported as errors, and leave
+ * the values and packets into which they were being read safe to release.
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unicode/ustring.h>
+#include "../cif.h"
+#include "test.h"
+
+#define BUFFER_SIZE 4096
+#define NAME_SIZE 32
+
+/* the leading bytes of a serialized value in the library's current format */
+#define SERIAL_FORMAT_TAG 0xcf
+#define SERIAL_FORMAT_VERSION 2
+
+/* the ways in which the stored lists and tables are damaged */
+#define BAD_VERSION 0
+#define TAG_ONLY 1
+#define KIND_ONLY 2
+#define NUM_DAMAGES 3
+
+static const char INPUT[] = "#\\#CIF_2.0\ndata_b\n_s.list [1 2 3]\n_s.table {'a':1 'b':[2]}\n"
+        "loop_\n_l.key\n_l.list\nk1 [4 5]\nk2 [6]\n";
+
+/*
+ * Copies the specified binary CIF to the specified output buffer, damaging the serialized form of each list and table
+ * value as specified.  Returns the length of the copy, and records the number of values damaged in 'count'.
+ */
+static size_t damage(const unsigned char *in, size_t length, int how, unsigned char *out, int *count) {
+    size_t i = 0;
+    size_t o = 0;
+
+    *count = 0;
+    while (i < length) {
+        /* a list or table value header, a one-byte length, and the format tag and version */
+        if ((i + 4 < length) && ((in[i] == CIF_LIST_KIND) || (in[i] == CIF_TABLE_KIND)) && (in[i + 1] < 128)
+                && (in[i + 2] == SERIAL_FORMAT_TAG) && (in[i + 3] == SERIAL_FORMAT_VERSION)) {
+            size_t blob_length = in[i + 1];
+
+            *count += 1;
+            out[o++] = in[i];
+            switch (how) {
+                case BAD_VERSION:
+                    out[o++] = in[i + 1];
+                    out[o++] = SERIAL_FORMAT_TAG;
+                    out[o++] = SERIAL_FORMAT_VERSION + 0x70;
+                    memcpy(out + o, in + i + 4, blob_length - 2);
+                    o += blob_length - 2;
+                    break;
+                case TAG_ONLY:
+                    out[o++] = 1;
+                    out[o++] = SERIAL_FORMAT_TAG;
+                    break;
+                default:
+                    /* the node's kind code, without any of its data */
+                    out[o++] = 3;
+                    memcpy(out + o, in + i + 2, 3);
+                    o += 3;
+                    break;
+            }
+            i += 2 + blob_length;
+        } else {
+            out[o++] = in[i++];
+        }
+    }
+
+    return o;
+}
+
+/* attempts to read all the packets of the loop containing the specified item, returning the first failure code */
+static int read_packets(cif_block_tp *block, const char *name, int borrow) {
+    UChar name_u[NAME_SIZE];
+    cif_loop_tp *loop = NULL;
+    cif_pktitr_tp *iterator = NULL;
+    cif_packet_tp *packet = NULL;
+    int result;
+
+    u_uastrcpy(name_u, name);
+    if ((result = cif_container_get_item_loop(block, name_u, &loop)) == CIF_OK) {
+        if ((result = cif_loop_get_packets(loop, &iterator)) == CIF_OK) {
+            do {
+                result = (borrow ? cif_pktitr_next_borrowed_packet(iterator, &packet)
+                        : cif_pktitr_next_packet(iterator, &packet));
+            } while (result == CIF_OK);
+            if (!borrow) {
+                cif_packet_free(packet);
+            }
+            if ((cif_pktitr_close(iterator) != CIF_OK) && (result == CIF_FINISHED)) {
+                result = CIF_ERROR;
+            }
+        }
+        cif_loop_free(loop);
+    }
+
+    return result;
+}
+
+int main(void) {
+    char test_name[80] = "test_value_blob_errors";
+    unsigned char original[BUFFER_SIZE];
+    unsigned char damaged[BUFFER_SIZE];
+    size_t original_length;
+    FILE *stream = tmpfile();
+    cif_tp *cif = NULL;
+    int how;
+
+    TESTHEADER(test_name);
+    TEST(stream == NULL, 0, test_name, 1);
+    TEST(fputs(INPUT, stream) < 0, 0, test_name, 2);
+    rewind(stream);
+    TEST(cif_parse(stream, NULL, &cif), CIF_OK, test_name, 3);
+    fclose(stream);
+
+    /* the binary form gives direct access to the stored serialized values */
+    TEST((stream = tmpfile()) == NULL, 0, test_name, 4);
+    TEST(cif_write_binary(stream, cif), CIF_OK, test_name, 5);
+    rewind(stream);
+    original_length = fread(original, 1, BUFFER_SIZE, stream);
+    fclose(stream);
+    TEST((original_length == 0) || (original_length == BUFFER_SIZE), 0, test_name, 6);
+    TEST(cif_destroy(cif), CIF_OK, test_name, 7);
+
+    for (how = 0; how < NUM_DAMAGES; how += 1) {
+        int subtest = 10 + 20 * how;
+        size_t length;
+        int count;
+        int result;
+
+        length = damage(original, original_length, how, damaged, &count);
+        TEST(count, 4, test_name, subtest);
+        TEST((stream = tmpfile()) == NULL, 0, test_name, subtest + 1);
+        TEST(fwrite(damaged, 1, length, stream) != length, 0, test_name, subtest + 2);
+        rewind(stream);
+        cif = NULL;
+        result = cif_read_binary(stream, &cif);
+        fclose(stream);
+
+        /* the damage may be detected as the data are loaded; otherwise, it must be when the values are read */
+        if (result == CIF_OK) {
+            cif_block_tp *block = NULL;
+            cif_value_tp *value = NULL;
+            char *output = NULL;
+            size_t output_length;
+
+            TEST(cif_get_block_utf8(cif, "b", &block), CIF_OK, test_name, subtest + 3);
+
+            TEST_NOT(cif_container_get_value_utf8(block, "_s.list", &value), CIF_OK, test_name, subtest + 4);
+            cif_value_free(value);
+            value = NULL;
+            TEST(cif_value_create(CIF_UNK_KIND, &value), CIF_OK, test_name, subtest + 5);
+            TEST_NOT(cif_container_get_value_utf8(block, "_s.table", &value), CIF_OK, test_name, subtest + 6);
+            cif_value_free(value);
+            value = NULL;
+            TEST_NOT(cif_container_get_value_utf8(block, "_l.list", &value), CIF_OK, test_name, subtest + 7);
+            cif_value_free(value);
+            value = NULL;
+
+            TEST_NOT(read_packets(block, "_s.list", 0), CIF_FINISHED, test_name, subtest + 8);
+            TEST_NOT(read_packets(block, "_s.list", 1), CIF_FINISHED, test_name, subtest + 9);
+            TEST_NOT(read_packets(block, "_l.list", 0), CIF_FINISHED, test_name, subtest + 10);
+            TEST_NOT(read_packets(block, "_l.list", 1), CIF_FINISHED, test_name, subtest + 11);
+
+            TEST_NOT(cif_write_buffer(cif, NULL, &output, &output_length), CIF_OK, test_name, subtest + 12);
+            free(output);
+
+            cif_container_free(block);
+            TEST(cif_destroy(cif), CIF_OK, test_name, subtest + 13);
+        } else {
+            /* a CIF created for the failed load is returned, but is empty */
+            TEST((cif != NULL) && (cif_destroy(cif) != CIF_OK), 0, test_name, subtest + 14);
+        }
+    }
+
+    return 0;
+}
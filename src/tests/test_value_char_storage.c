@@ -0,0 +1,202 @@
+/*
+ * test_value_char_storage.c
+ *
+ * Tests storing and retrieving character values whose texts are, or resemble, plain decimal numbers, some of which
+ * are stored without their text.
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unicode/ustring.h>
+#include "../cif.h"
+#include "test.h"
+
+#define NAME_SIZE 32
+
+/*
+ * Value texts covering the canonical plain decimal form (stored without text), forms that do not survive
+ * reformatting, negative zero, digit strings too long to be stored as integers, and texts that are not numbers at all.
+ * The last few are quoted in the CIF.
+ */
+static const char * const TEXTS[] = {
+    "0", "12", "-12", "1.25", "-1.25(3)", "0.0042(17)", "-0.5", "10.5(120)", "0.000001", "123456789012345678",
+    "-0", "-0.0", "007", "1.", ".5", "+1", "1.2e3", "1(02)", "1(2", "12.5.3", "1234567890123456789",
+    "0.0000000000000000001", "1(1234567890123456789)", "abc", NULL
+};
+#define NUM_UNQUOTED 24
+static const char * const QUOTED_TEXTS[] = { "12", "-1.25(3)", "1.", NULL };
+
+/* writes a CIF presenting each text as an unlooped item and as a packet of a loop, to a new temporary stream */
+static FILE *write_input(void) {
+    FILE *stream = tmpfile();
+    int i;
+
+    if (stream != NULL) {
+        fputs("#\\#CIF_2.0\ndata_b\n", stream);
+        for (i = 0; TEXTS[i] != NULL; i += 1) {
+            fprintf(stream, "_v.n%d %s\n", i, TEXTS[i]);
+        }
+        for (i = 0; QUOTED_TEXTS[i] != NULL; i += 1) {
+            fprintf(stream, "_v.n%d '%s'\n", NUM_UNQUOTED + i, QUOTED_TEXTS[i]);
+        }
+        fputs("loop_\n_l.key\n_l.value\n", stream);
+        for (i = 0; TEXTS[i] != NULL; i += 1) {
+            fprintf(stream, "k%d %s\n", i, TEXTS[i]);
+        }
+        for (i = 0; QUOTED_TEXTS[i] != NULL; i += 1) {
+            fprintf(stream, "k%d '%s'\n", NUM_UNQUOTED + i, QUOTED_TEXTS[i]);
+        }
+        rewind(stream);
+    }
+
+    return stream;
+}
+
+/* returns the text expected for the item or packet having the specified index */
+static const char *expected_text(int index) {
+    return ((index < NUM_UNQUOTED) ? TEXTS[index] : QUOTED_TEXTS[index - NUM_UNQUOTED]);
+}
+
+/* returns zero if the specified value is a character value having the expected text and quoting, else nonzero */
+static int check_value(cif_value_tp *value, int index) {
+    char *text = NULL;
+    int mismatch;
+
+    if ((cif_value_kind(value) != CIF_CHAR_KIND)
+            || (cif_value_is_quoted(value) != ((index < NUM_UNQUOTED) ? CIF_NOT_QUOTED : CIF_QUOTED))
+            || (cif_value_get_text_utf8(value, &text) != CIF_OK) || (text == NULL)) {
+        return 1;
+    }
+    mismatch = strcmp(text, expected_text(index));
+    free(text);
+
+    return mismatch;
+}
+
+/*
+ * Checks all the unlooped items of the specified CIF, and all the packets of its loop, via both owned and borrowed
+ * packets.  Returns zero if all are as expected, or the number of the first failing check.
+ */
+static int check_cif(cif_tp *cif) {
+    cif_block_tp *block = NULL;
+    cif_loop_tp *loop = NULL;
+    cif_pktitr_tp *iterator = NULL;
+    cif_packet_tp *packet = NULL;
+    UChar loop_name[NAME_SIZE];
+    int num_values = NUM_UNQUOTED + 3;
+    int failure = 0;
+    int pass;
+    int i;
+
+    if (cif_get_block_utf8(cif, "b", &block) != CIF_OK) {
+        return 1;
+    }
+    for (i = 0; (i < num_values) && !failure; i += 1) {
+        char name[NAME_SIZE];
+        cif_value_tp *value = NULL;
+
+        sprintf(name, "_v.n%d", i);
+        if ((cif_container_get_value_utf8(block, name, &value) != CIF_OK) || check_value(value, i)) {
+            failure = 2;
+        }
+        cif_value_free(value);
+    }
+
+    for (pass = 0; (pass < 2) && !failure; pass += 1) {
+        int result;
+
+        if ((cif_container_get_item_loop(block, TO_UNICODE("_l.value", loop_name, NAME_SIZE), &loop) != CIF_OK)
+                || (cif_loop_get_packets(loop, &iterator) != CIF_OK)) {
+            failure = 3;
+            break;
+        }
+        for (i = 0; !failure; i += 1) {
+            cif_value_tp *value = NULL;
+
+            result = ((pass == 0) ? cif_pktitr_next_packet(iterator, &packet)
+                    : cif_pktitr_next_borrowed_packet(iterator, &packet));
+            if (result == CIF_FINISHED) {
+                break;
+            } else if ((result != CIF_OK) || (i >= num_values)
+                    || (cif_packet_get_item_utf8(packet, "_l.value", &value) != CIF_OK) || check_value(value, i)) {
+                failure = 4 + pass;
+            }
+        }
+        if (!failure && (i != num_values)) {
+            failure = 6;
+        }
+        if (pass == 0) {
+            cif_packet_free(packet);
+        }
+        packet = NULL;
+        if ((cif_pktitr_close(iterator) != CIF_OK) && !failure) {
+            failure = 7;
+        }
+        iterator = NULL;
+        cif_loop_free(loop);
+        loop = NULL;
+    }
+    cif_container_free(block);
+
+    return failure;
+}
+
+int main(void) {
+    char test_name[80] = "test_value_char_storage";
+    FILE *stream = write_input();
+    cif_tp *cif = NULL;
+    cif_tp *copy = NULL;
+    char *output = NULL;
+    size_t output_length;
+    FILE *saved;
+
+    TESTHEADER(test_name);
+    TEST(stream == NULL, 0, test_name, 1);
+    TEST(cif_parse(stream, NULL, &cif), CIF_OK, test_name, 2);
+    fclose(stream);
+    TEST(check_cif(cif), 0, test_name, 3);
+
+    /* written as text and parsed again */
+    TEST(cif_write_buffer(cif, NULL, &output, &output_length), CIF_OK, test_name, 4);
+    TEST((stream = tmpfile()) == NULL, 0, test_name, 5);
+    TEST(fwrite(output, 1, output_length, stream) != output_length, 0, test_name, 6);
+    free(output);
+    rewind(stream);
+    TEST(cif_parse(stream, NULL, &copy), CIF_OK, test_name, 7);
+    fclose(stream);
+    TEST(check_cif(copy), 0, test_name, 8);
+    TEST(cif_destroy(copy), CIF_OK, test_name, 9);
+
+    /* saved in binary form and reloaded */
+    TEST((saved = tmpfile()) == NULL, 0, test_name, 10);
+    TEST(cif_write_binary(saved, cif), CIF_OK, test_name, 11);
+    rewind(saved);
+    copy = NULL;
+    TEST(cif_read_binary(saved, &copy), CIF_OK, test_name, 12);
+    fclose(saved);
+    TEST(check_cif(copy), 0, test_name, 13);
+    TEST(cif_destroy(copy), CIF_OK, test_name, 14);
+
+    TEST(cif_destroy(cif), CIF_OK, test_name, 15);
+
+    return 0;
+}
@@ -0,0 +1,165 @@
+/*
+ * test_value_lazy_composite.c
+ *
+ * Tests that list and table values retrieved from a CIF, which are decoded lazily from their stored form, behave
+ * identically to fully-decoded ones when accessed, modified, cloned, and stored again.
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unicode/ustring.h>
+#include "../cif.h"
+#include "assert_value.h"
+#include "test.h"
+
+#define BUFFER_SIZE 64
+#define KEY_COUNT 6
+
+/* table keys, deliberately not in sorted order; the last differs from the third only by case */
+static const char * const KEYS[KEY_COUNT] = { "zeta", "alpha", "Mu", "", "beta gamma", "mu" };
+
+int main(void) {
+    char test_name[80] = "test_value_lazy_composite";
+    cif_tp *cif = NULL;
+    cif_block_tp *block = NULL;
+    cif_value_tp *table = NULL;
+    cif_value_tp *list = NULL;
+    cif_value_tp *value = NULL;
+    cif_value_tp *stored = NULL;
+    cif_value_tp *element = NULL;
+    cif_value_tp *clone = NULL;
+    cif_value_tp *original = NULL;
+    const UChar **keys;
+    const UChar **original_keys;
+    UChar buffer[BUFFER_SIZE];
+    UChar name[] = { '_', 't', 0 };
+    UChar decomposed[] = { 'c', 'a', 'f', 'e', 0x0301, 0 };
+    UChar composed[] = { 'c', 'a', 'f', 0x00e9, 0 };
+    UChar missing[] = { 'n', 'o', 'n', 'e', 0 };
+    UChar *text;
+    size_t count;
+    int i;
+
+    TESTHEADER(test_name);
+    CREATE_CIF(test_name, cif);
+    TEST(cif_create_block(cif, TO_UNICODE("b", buffer, BUFFER_SIZE), &block), CIF_OK, test_name, 1);
+
+    /* build a table of assorted values, including a nested list and a nested table */
+    TEST(cif_value_create(CIF_TABLE_KIND, &table), CIF_OK, test_name, 2);
+    TEST(cif_value_create(CIF_LIST_KIND, &list), CIF_OK, test_name, 3);
+    TEST(cif_value_create(CIF_UNK_KIND, &value), CIF_OK, test_name, 4);
+    for (i = 0; i < KEY_COUNT; i += 1) {
+        TEST(cif_value_autoinit_numb(value, (double) i + 0.25, 0.125, 19), CIF_OK, test_name, 10 + 3 * i);
+        TEST(cif_value_insert_element_at(list, (size_t) i, value), CIF_OK, test_name, 11 + 3 * i);
+        TEST(cif_value_set_item_by_key(table, TO_UNICODE(KEYS[i], buffer, BUFFER_SIZE), value), CIF_OK, test_name,
+                12 + 3 * i);
+    }
+    TEST(cif_value_init(value, CIF_NA_KIND), CIF_OK, test_name, 30);
+    TEST(cif_value_insert_element_at(list, 1, value), CIF_OK, test_name, 31);
+    TEST(cif_value_set_item_by_key(table, TO_UNICODE("list", buffer, BUFFER_SIZE), list), CIF_OK, test_name, 32);
+    cif_value_free(list);
+    list = NULL;
+    TEST(cif_value_copy_char(value, decomposed), CIF_OK, test_name, 33);
+    TEST(cif_value_set_item_by_key(table, decomposed, value), CIF_OK, test_name, 34);
+    TEST(cif_value_clone(table, &clone), CIF_OK, test_name, 35);
+    TEST(cif_value_set_item_by_key(table, TO_UNICODE("table", buffer, BUFFER_SIZE), clone), CIF_OK, test_name, 36);
+    cif_value_free(clone);
+    clone = NULL;
+
+    /* store the table and read it back */
+    TEST(cif_container_set_value(block, name, table), CIF_OK, test_name, 37);
+    TEST(cif_container_get_value(block, name, &stored), CIF_OK, test_name, 38);
+
+    /* look up items without first enumerating the keys */
+    TEST(cif_value_get_element_count(stored, &count), CIF_OK, test_name, 40);
+    TEST(count, KEY_COUNT + 3, test_name, 41);
+    TEST(cif_value_get_item_by_key(stored, missing, &element), CIF_NOSUCH_ITEM, test_name, 42);
+    TEST(cif_value_get_item_by_key(stored, composed, &element), CIF_OK, test_name, 43);
+    TEST(cif_value_get_text(element, &text), CIF_OK, test_name, 44);
+    TEST(u_strcmp(text, decomposed), 0, test_name, 45);
+    free(text);
+    TEST(cif_value_get_item_by_key(stored, TO_UNICODE("Mu", buffer, BUFFER_SIZE), &element), CIF_OK, test_name, 46);
+    TEST(cif_value_get_item_by_key(table, buffer, &original), CIF_OK, test_name, 47);
+    TEST(!assert_values_equal(original, element), 0, test_name, 48);
+    TEST(cif_value_get_item_by_key(stored, TO_UNICODE("MU", buffer, BUFFER_SIZE), &element), CIF_NOSUCH_ITEM,
+            test_name, 49);
+
+    /* access elements of the nested list, then modify it */
+    TEST(cif_value_get_item_by_key(stored, TO_UNICODE("list", buffer, BUFFER_SIZE), &list), CIF_OK, test_name, 50);
+    TEST(cif_value_get_element_count(list, &count), CIF_OK, test_name, 51);
+    TEST(count, KEY_COUNT + 1, test_name, 52);
+    TEST(cif_value_get_element_at(list, KEY_COUNT + 1, &element), CIF_INVALID_INDEX, test_name, 53);
+    TEST(cif_value_get_element_at(list, 1, &element), CIF_OK, test_name, 54);
+    TEST(cif_value_kind(element), CIF_NA_KIND, test_name, 55);
+    TEST(cif_value_remove_element_at(list, 1, NULL), CIF_OK, test_name, 56);
+    TEST(cif_value_get_element_count(list, &count), CIF_OK, test_name, 57);
+    TEST(count, KEY_COUNT, test_name, 58);
+    TEST(cif_value_get_element_at(list, 1, &element), CIF_OK, test_name, 59);
+    TEST(cif_value_kind(element), CIF_NUMB_KIND, test_name, 60);
+
+    /* the keys are enumerated in their original order */
+    TEST(cif_value_get_keys(stored, &keys), CIF_OK, test_name, 61);
+    TEST(cif_value_get_keys(table, &original_keys), CIF_OK, test_name, 62);
+    for (i = 0; i < KEY_COUNT + 3; i += 1) {
+        TEST(u_strcmp(keys[i], original_keys[i]), 0, test_name, 63);
+    }
+    free(keys);
+    free(original_keys);
+
+    /* the original differs from the retrieved, modified value only by the list element removed */
+    TEST(!assert_values_equal(table, stored), 1, test_name, 64);
+    TEST(cif_value_get_item_by_key(table, TO_UNICODE("list", buffer, BUFFER_SIZE), &element), CIF_OK, test_name, 65);
+    TEST(cif_value_remove_element_at(element, 1, NULL), CIF_OK, test_name, 66);
+    TEST(!assert_values_equal(table, stored), 0, test_name, 67);
+
+    /* clone the nested table without decoding it, and store the clone */
+    cif_value_free(stored);
+    stored = NULL;
+    TEST(cif_container_get_value(block, name, &stored), CIF_OK, test_name, 70);
+    TEST(cif_value_get_item_by_key(stored, TO_UNICODE("table", buffer, BUFFER_SIZE), &element), CIF_OK, test_name,
+            71);
+    TEST(cif_value_clone(element, &clone), CIF_OK, test_name, 72);
+    TEST(cif_container_set_value(block, name, clone), CIF_OK, test_name, 73);
+    cif_value_free(stored);
+    stored = NULL;
+    TEST(cif_container_get_value(block, name, &stored), CIF_OK, test_name, 74);
+    TEST(cif_value_get_item_by_key(table, TO_UNICODE("table", buffer, BUFFER_SIZE), &element), CIF_OK, test_name,
+            75);
+    TEST(!assert_values_equal(element, stored), 0, test_name, 76);
+    TEST(!assert_values_equal(clone, stored), 0, test_name, 77);
+
+    /* modify a retrieved table after looking up one of its items */
+    TEST(cif_value_get_item_by_key(stored, TO_UNICODE("zeta", buffer, BUFFER_SIZE), &element), CIF_OK, test_name,
+            78);
+    TEST(cif_value_remove_item_by_key(stored, buffer, NULL), CIF_OK, test_name, 79);
+    TEST(cif_value_get_item_by_key(stored, buffer, &element), CIF_NOSUCH_ITEM, test_name, 80);
+    TEST(cif_value_get_element_count(stored, &count), CIF_OK, test_name, 81);
+    TEST(count, KEY_COUNT + 1, test_name, 82);
+
+    cif_value_free(clone);
+    cif_value_free(stored);
+    cif_value_free(value);
+    cif_value_free(table);
+    cif_block_free(block);
+    DESTROY_CIF(test_name, cif);
+
+    return 0;
+}
@@ -0,0 +1,137 @@
+/*
+ * test_value_numb_conversion.c
+ *
+ * Tests the exactness of the CIF API's conversions between doubles and decimal digit strings, as exercised by
+ * cif_value_init_numb() and cif_value_get_number(), by comparison with the C library's conversions for a
+ * reproducible sequence of pseudo-random numbers.
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <unicode/ustring.h>
+#include "../cif.h"
+#include "test.h"
+
+#define BUFFER_SIZE 128
+#define SAMPLE_COUNT 20000
+
+/* A simple linear congruential generator, so that the test is reproducible on every platform */
+static unsigned long next_random(unsigned long *state);
+
+/* Produces a pseudo-random, positive double of varied magnitude and precision */
+static double random_double(unsigned long *state);
+
+static unsigned long next_random(unsigned long *state) {
+    *state = (*state * 1103515245UL + 12345UL) & 0xffffffffUL;
+    return (*state >> 8);
+}
+
+static double random_double(unsigned long *state) {
+    double mantissa = (double) next_random(state) * 16777216.0 + (double) next_random(state);
+
+    switch (next_random(state) % 3) {
+        case 0:
+            /* a value with few significant figures, such as those typical of CIF data */
+            return (double) (next_random(state) % 1000000) / pow(10.0, (double) (next_random(state) % 8));
+        case 1:
+            /* a value of full precision and moderate magnitude */
+            return ldexp(mantissa, (int) (next_random(state) % 80) - 88);
+        default:
+            /* a value of full precision and widely-varying magnitude */
+            return ldexp(mantissa, (int) (next_random(state) % 200) - 150);
+    }
+}
+
+int main(void) {
+    char test_name[80] = "test_value_numb_conversion";
+    cif_value_tp *value = NULL;
+    unsigned long state = 20150101UL;
+    char expected[BUFFER_SIZE];
+    char actual[BUFFER_SIZE];
+    UChar *text;
+    int format_mismatches = 0;
+    int parse_mismatches = 0;
+    int round_trip_mismatches = 0;
+    int failures = 0;
+    int i;
+
+    TESTHEADER(test_name);
+    TEST(cif_value_create(CIF_UNK_KIND, &value), CIF_OK, test_name, 1);
+
+    for (i = 0; i < SAMPLE_COUNT; i += 1) {
+        double d = random_double(&state);
+        int scale = (int) (next_random(&state) % 30);
+        double parsed;
+
+        /* formatting at a given scale must agree with the C library's correctly-rounded formatting */
+        sprintf(expected, "%.*f", scale, d);
+        if ((cif_value_init_numb(value, d, 0.0, scale, BUFFER_SIZE) != CIF_OK)
+                || (cif_value_get_text(value, &text) != CIF_OK)) {
+            failures += 1;
+            continue;
+        }
+        u_austrncpy(actual, text, BUFFER_SIZE);
+        free(text);
+        if (strcmp(actual, expected) != 0) {
+            fprintf(stderr, "%s: formatted %.17g at scale %d as %s, expected %s\n", test_name, d, scale, actual,
+                    expected);
+            format_mismatches += 1;
+        }
+
+        /* the number's value must be the one nearest its decimal representation */
+        if (cif_value_get_number(value, &parsed) != CIF_OK) {
+            failures += 1;
+        } else if (parsed != strtod(expected, NULL)) {
+            fprintf(stderr, "%s: converted %s to %.17g, expected %.17g\n", test_name, expected, parsed,
+                    strtod(expected, NULL));
+            parse_mismatches += 1;
+        }
+
+        /* seventeen significant digits suffice to represent any double exactly */
+        sprintf(expected, "%.16e", d);
+        text = (UChar *) malloc(BUFFER_SIZE * sizeof(UChar));
+        if (text == NULL) {
+            failures += 1;
+            continue;
+        }
+        u_uastrncpy(text, expected, BUFFER_SIZE);
+        if (cif_value_parse_numb(value, text) != CIF_OK) {
+            free(text);
+            failures += 1;
+        } else if (cif_value_get_number(value, &parsed) != CIF_OK) {
+            failures += 1;
+        } else if (parsed != d) {
+            fprintf(stderr, "%s: round-tripped %.17g as %.17g\n", test_name, d, parsed);
+            round_trip_mismatches += 1;
+        }
+    }
+
+    TEST(failures, 0, test_name, 2);
+    TEST(format_mismatches, 0, test_name, 3);
+    TEST(parse_mismatches, 0, test_name, 4);
+    TEST(round_trip_mismatches, 0, test_name, 5);
+
+    cif_value_free(value);
+
+    return 0;
+}
@@ -0,0 +1,95 @@
+/*
+ * test_value_numb_storage.c
+ *
+ * Tests that number values are stored and retrieved with full fidelity, whether their digits and text are stored
+ * compactly or not.
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unicode/ustring.h>
+#include "../cif.h"
+#include "assert_value.h"
+#include "test.h"
+
+#define BUFFER_SIZE 64
+
+/*
+ * Number texts covering the canonical plain decimal form (stored without text), non-canonical forms, negative zero,
+ * and digit strings too long to be stored as integers
+ */
+static const char * const NUMBERS[] = {
+    "0", "-0", "-0.0", "12", "-12", "1.25", "-1.25(3)", "0.0042(17)", "-0.5", "10.5(120)", "+1", ".5", "5.", "007",
+    "1.2e3", "-4.5E-02(2)", "0.000001", "123456789012345678", "-1234567890123456789", "12345678901234567890.5(7)",
+    "1(123456789012345678901)", "'1.5'", NULL
+};
+
+int main(void) {
+    char test_name[80] = "test_value_numb_storage";
+    cif_tp *cif = NULL;
+    cif_block_tp *block = NULL;
+    cif_value_tp *value = NULL;
+    cif_value_tp *value2 = NULL;
+    UChar buffer[BUFFER_SIZE];
+    UChar *text;
+    UChar name[] = { '_', 'n', 0 };
+    int i;
+
+    TESTHEADER(test_name);
+    CREATE_CIF(test_name, cif);
+    TEST(cif_create_block(cif, TO_UNICODE("b", buffer, BUFFER_SIZE), &block), CIF_OK, test_name, 1);
+    TEST(cif_value_create(CIF_UNK_KIND, &value), CIF_OK, test_name, 2);
+
+    for (i = 0; NUMBERS[i] != NULL; i += 1) {
+        int subtest = 10 + 13 * i;
+        const char *number = NUMBERS[i];
+        int quoted = (*number == '\'');
+        double d1;
+        double d2;
+
+        TO_UNICODE(number + quoted, buffer, BUFFER_SIZE);
+        if (quoted) buffer[u_strlen(buffer) - 1] = 0;
+        text = (UChar *) malloc((u_strlen(buffer) + 1) * sizeof(UChar));
+        TEST(text == NULL, 0, test_name, subtest);
+        u_strcpy(text, buffer);
+        TEST(cif_value_parse_numb(value, text), CIF_OK, test_name, subtest + 1);
+        TEST(cif_value_set_quoted(value, quoted ? CIF_QUOTED : CIF_NOT_QUOTED), CIF_OK, test_name, subtest + 2);
+        TEST(cif_container_set_value(block, name, value), CIF_OK, test_name, subtest + 3);
+        TEST(cif_container_get_value(block, name, &value2), CIF_OK, test_name, subtest + 4);
+        /* compares kind and text */
+        TEST(!assert_values_equal(value, value2), 0, test_name, subtest + 5);
+        TEST(cif_value_is_quoted(value2), (quoted ? CIF_QUOTED : CIF_NOT_QUOTED), test_name, subtest + 6);
+        TEST(cif_value_get_number(value, &d1), CIF_OK, test_name, subtest + 7);
+        TEST(cif_value_get_number(value2, &d2), CIF_OK, test_name, subtest + 8);
+        TEST(d1 != d2, 0, test_name, subtest + 9);
+        TEST(cif_value_get_su(value, &d1), CIF_OK, test_name, subtest + 10);
+        TEST(cif_value_get_su(value2, &d2), CIF_OK, test_name, subtest + 11);
+        TEST(d1 != d2, 0, test_name, subtest + 12);
+        cif_value_free(value2);
+        value2 = NULL;
+    }
+
+    cif_value_free(value);
+    cif_block_free(block);
+    DESTROY_CIF(test_name, cif);
+
+    return 0;
+}
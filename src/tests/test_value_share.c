@@ -0,0 +1,150 @@
+/*
+ * test_value_share.c
+ *
+ * Tests that values whose data are shared via cif_value_share() remain independent of their clones, and of the
+ * values they were cloned from.
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <unicode/ustring.h>
+#include "../cif.h"
+#include "assert_value.h"
+#include "test.h"
+
+#define BUFFER_SIZE 64
+
+int main(void) {
+    char test_name[80] = "test_value_share";
+    cif_tp *cif = NULL;
+    cif_block_tp *block = NULL;
+    cif_value_tp *value = NULL;
+    cif_value_tp *clone = NULL;
+    cif_value_tp *clone2 = NULL;
+    cif_value_tp *list = NULL;
+    cif_value_tp *table = NULL;
+    cif_value_tp *element = NULL;
+    UChar buffer[BUFFER_SIZE];
+    UChar name[] = { '_', 't', 0 };
+    UChar *text;
+    double d;
+    size_t count;
+
+    TESTHEADER(test_name);
+    CREATE_CIF(test_name, cif);
+    TEST(cif_create_block(cif, TO_UNICODE("b", buffer, BUFFER_SIZE), &block), CIF_OK, test_name, 1);
+
+    /* character values */
+    TEST(cif_value_create(CIF_UNK_KIND, &value), CIF_OK, test_name, 2);
+    TEST(cif_value_share(value), CIF_OK, test_name, 3);
+    TEST(cif_value_copy_char(value, TO_UNICODE("some_text", buffer, BUFFER_SIZE)), CIF_OK, test_name, 4);
+    TEST(cif_value_share(value), CIF_OK, test_name, 5);
+    TEST(cif_value_share(value), CIF_OK, test_name, 6);
+    TEST(cif_value_clone(value, &clone), CIF_OK, test_name, 7);
+    TEST(cif_value_clone(clone, &clone2), CIF_OK, test_name, 8);
+    TEST(!assert_values_equal(value, clone2), 0, test_name, 9);
+    TEST(cif_value_copy_char(clone, TO_UNICODE("other_text", buffer, BUFFER_SIZE)), CIF_OK, test_name, 10);
+    TEST(cif_value_get_text(value, &text), CIF_OK, test_name, 11);
+    TEST(u_strcmp(text, TO_UNICODE("some_text", buffer, BUFFER_SIZE)), 0, test_name, 12);
+    free(text);
+    cif_value_free(value);
+    value = NULL;
+    TEST(cif_value_get_text(clone2, &text), CIF_OK, test_name, 13);
+    TEST(u_strcmp(text, buffer), 0, test_name, 14);
+    free(text);
+    TEST(cif_value_set_quoted(clone2, CIF_NOT_QUOTED), CIF_OK, test_name, 15);
+    TEST(cif_value_clone(clone2, &clone), CIF_OK, test_name, 16);
+    TEST(cif_value_is_quoted(clone), CIF_NOT_QUOTED, test_name, 17);
+    TEST(!assert_values_equal(clone, clone2), 0, test_name, 18);
+
+    /* number values, with and without su */
+    TEST(cif_value_create(CIF_UNK_KIND, &value), CIF_OK, test_name, 20);
+    TEST(cif_value_init_numb(value, 12.25, 0.5, 2, 5), CIF_OK, test_name, 21);
+    TEST(cif_value_share(value), CIF_OK, test_name, 22);
+    TEST(cif_value_clone(value, &clone), CIF_OK, test_name, 23);
+    TEST(!assert_values_equal(value, clone), 0, test_name, 24);
+    TEST(cif_value_get_su(clone, &d), CIF_OK, test_name, 25);
+    TEST(d != 0.5, 0, test_name, 26);
+    TEST(cif_value_autoinit_numb(value, -3.0, 0.0, 19), CIF_OK, test_name, 27);
+    TEST(cif_value_share(value), CIF_OK, test_name, 28);
+    TEST(cif_value_clone(value, &clone2), CIF_OK, test_name, 29);
+    TEST(cif_value_get_su(clone2, &d), CIF_OK, test_name, 30);
+    TEST(d != 0.0, 0, test_name, 31);
+    TEST(cif_value_get_number(clone, &d), CIF_OK, test_name, 32);
+    TEST(d != 12.25, 0, test_name, 33);
+
+    /* a list and a table containing shared values, themselves shared */
+    TEST(cif_value_create(CIF_LIST_KIND, &list), CIF_OK, test_name, 40);
+    TEST(cif_value_insert_element_at(list, 0, value), CIF_OK, test_name, 41);
+    TEST(cif_value_insert_element_at(list, 1, clone), CIF_OK, test_name, 42);
+    TEST(cif_value_create(CIF_TABLE_KIND, &table), CIF_OK, test_name, 43);
+    TEST(cif_value_set_item_by_key(table, TO_UNICODE("list", buffer, BUFFER_SIZE), list), CIF_OK, test_name, 44);
+    cif_value_free(list);
+    TEST(cif_value_set_item_by_key(table, TO_UNICODE("numb", buffer, BUFFER_SIZE), value), CIF_OK, test_name, 45);
+    TEST(cif_value_copy_char(value, TO_UNICODE("unshared", buffer, BUFFER_SIZE)), CIF_OK, test_name, 46);
+    TEST(cif_value_set_item_by_key(table, buffer, value), CIF_OK, test_name, 47);
+    TEST(cif_value_share(table), CIF_OK, test_name, 48);
+    TEST(cif_value_clone(table, &clone2), CIF_OK, test_name, 49);
+    TEST(!assert_values_equal(table, clone2), 0, test_name, 50);
+    TEST(cif_value_get_item_by_key(table, buffer, &element), CIF_OK, test_name, 51);
+    TEST(cif_value_copy_char(element, TO_UNICODE("changed", buffer, BUFFER_SIZE)), CIF_OK, test_name, 52);
+    TEST(!assert_values_equal(table, clone2), 1, test_name, 53);
+    cif_value_free(table);
+    table = NULL;
+    TEST(cif_value_get_item_by_key(clone2, TO_UNICODE("unshared", buffer, BUFFER_SIZE), &element), CIF_OK, test_name,
+            54);
+    TEST(cif_value_get_text(element, &text), CIF_OK, test_name, 55);
+    TEST(u_strcmp(text, buffer), 0, test_name, 56);
+    free(text);
+
+    /* a table retrieved from a CIF, shared before and after access to its elements */
+    TEST(cif_container_set_value(block, name, clone2), CIF_OK, test_name, 60);
+    TEST(cif_container_get_value(block, name, &table), CIF_OK, test_name, 61);
+    TEST(cif_value_share(table), CIF_OK, test_name, 62);
+    cif_value_free(clone);
+    clone = NULL;
+    TEST(cif_value_clone(table, &clone), CIF_OK, test_name, 63);
+    TEST(cif_value_get_item_by_key(clone, TO_UNICODE("list", buffer, BUFFER_SIZE), &list), CIF_OK, test_name, 64);
+    cif_value_free(clone);
+    clone = NULL;
+    TEST(cif_value_get_item_by_key(table, buffer, &list), CIF_OK, test_name, 65);
+    TEST(cif_value_clone(table, &clone), CIF_OK, test_name, 66);
+    element = NULL;
+    TEST(cif_value_clone(list, &element), CIF_OK, test_name, 67);
+    TEST(cif_value_remove_element_at(list, 0, NULL), CIF_OK, test_name, 68);
+    TEST(cif_value_get_element_count(element, &count), CIF_OK, test_name, 69);
+    TEST(count, 2, test_name, 70);
+    TEST(cif_value_get_item_by_key(clone, buffer, &list), CIF_OK, test_name, 71);
+    TEST(!assert_values_equal(list, element), 0, test_name, 72);
+    TEST(!assert_values_equal(clone, clone2), 0, test_name, 73);
+    cif_value_free(table);
+    table = NULL;
+    TEST(!assert_values_equal(clone, clone2), 0, test_name, 74);
+
+    cif_value_free(element);
+    cif_value_free(clone);
+    cif_value_free(clone2);
+    cif_value_free(value);
+    cif_block_free(block);
+    DESTROY_CIF(test_name, cif);
+
+    return 0;
+}
@@ -0,0 +1,175 @@
+/*
+ * test_write_aligned.c
+ *
+ * Tests writing a CIF with the columns of its loops aligned.
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "../cif.h"
+#include "test.h"
+
+#define BUFFER_SIZE 512
+
+/* parses the specified CIF text into a new managed CIF */
+static int parse_text(const char *text, cif_tp **cif) {
+    FILE *stream = tmpfile();
+    int result;
+
+    if (stream == NULL) {
+        return CIF_ERROR;
+    } else if (fputs(text, stream) < 0) {
+        fclose(stream);
+        return CIF_ERROR;
+    }
+    rewind(stream);
+    *cif = NULL;
+    result = cif_parse(stream, NULL, cif);
+    fclose(stream);
+
+    return result;
+}
+
+/* parses the specified CIF output and writes it again without alignment */
+static int rewrite(const char *bytes, size_t length, char **rewritten, size_t *rewritten_length) {
+    char *text = (char *) malloc(length + 1);
+    cif_tp *cif = NULL;
+    int result = CIF_MEMORY_ERROR;
+
+    if (text != NULL) {
+        memcpy(text, bytes, length);
+        text[length] = '\0';
+        result = parse_text(text, &cif);
+        free(text);
+        if (result == CIF_OK) {
+            result = cif_write_buffer(cif, NULL, rewritten, rewritten_length);
+        }
+        if ((cif != NULL) && (cif_destroy(cif) != CIF_OK) && (result == CIF_OK)) {
+            free(*rewritten);
+            result = CIF_ERROR;
+        }
+    }
+
+    return result;
+}
+
+int main(void) {
+    char test_name[80] = "test_write_aligned";
+    const char *input = "#\\#CIF_2.0\ndata_a\n_s.scalar 'not in a loop'\n"
+            "loop_\n_x.id _x.name _x.val _x.q\n"
+            "1 short 1.5(2) ?\n"
+            "200 \"a longer name\" -0.005 .\n"
+            "33 it_s 12 xyz\n"
+            "4\n;\ntext\nfield\n;\n7 zz\n"
+            "5 x 100 y\n"
+            "loop_\n_y.list _y.after\n[1 2] a\n[3 4 5 6 7] b\n";
+    const char *expected_packets = "\n"
+            "1   short           1.5(2) ?\n"
+            "200 'a longer name' -0.005 .\n"
+            "33  it_s            12     xyz\n";
+    const char *expected_after_text = "\n;                   7      zz\n"
+            "5   x               100    y\n";
+    const char *local_file_names[2] = { "multi_block.cif", "cif_core.dic" };
+    char file_name[BUFFER_SIZE];
+    struct cif_write_opts_s *options = NULL;
+    cif_tp *cif = NULL;
+    char *aligned;
+    size_t aligned_length;
+    char *plain;
+    size_t plain_length;
+    char *rewritten;
+    size_t rewritten_length;
+    int i;
+
+    TESTHEADER(test_name);
+    TEST(cif_write_options_create(&options), CIF_OK, test_name, 1);
+    TEST(options->align_loops, 0, test_name, 2);
+    options->align_loops = 1;
+
+    /* columns are padded to the width of their widest single-line value; multi-line values are not padded */
+    TEST(parse_text(input, &cif), CIF_OK, test_name, 3);
+    TEST(cif_write_buffer(cif, options, &aligned, &aligned_length), CIF_OK, test_name, 4);
+    TEST(strstr(aligned, expected_packets) == NULL, 0, test_name, 5);
+    TEST(strstr(aligned, "\n4 '''\ntext\nfield'''            7      zz\n") == NULL, 0, test_name, 6);
+
+    /* the scalars and a loop whose widths are not known in advance are formatted as usual */
+    TEST(strstr(aligned, "\n_s.scalar 'not in a loop'\n") == NULL, 0, test_name, 7);
+    TEST(strstr(aligned, "\n[ 1 2 ] a\n[ 3 4 5 6 7 ] b\n") == NULL, 0, test_name, 8);
+    free(aligned);
+
+    /* CIF 1.1 presents the multi-line value as a text field */
+    TEST(cif_destroy(cif), CIF_OK, test_name, 9);
+    TEST(parse_text(input, &cif), CIF_OK, test_name, 10);
+    options->cif_version = 1;
+    {
+        UChar list_name[8] = { '_', 'y', '.', 'l', 'i', 's', 't', 0 };
+        cif_block_tp *block;
+        cif_loop_tp *loop;
+
+        TEST(cif_get_block_utf8(cif, "a", &block), CIF_OK, test_name, 11);
+        TEST(cif_container_get_item_loop(block, list_name, &loop), CIF_OK, test_name, 12);
+        TEST(cif_loop_destroy(loop), CIF_OK, test_name, 13);
+        cif_container_free(block);
+    }
+    TEST(cif_write_buffer(cif, options, &aligned, &aligned_length), CIF_OK, test_name, 14);
+    TEST(strstr(aligned, expected_packets) == NULL, 0, test_name, 15);
+    TEST(strstr(aligned, "\n4 \n;\ntext\nfield\n;") == NULL, 0, test_name, 16);
+    TEST(strstr(aligned, expected_after_text) == NULL, 0, test_name, 17);
+    free(aligned);
+    TEST(cif_destroy(cif), CIF_OK, test_name, 18);
+    options->cif_version = 0;
+
+    /* alignment changes only the whitespace, in serial and parallel writes alike */
+    for (i = 0; i < 2; i += 1) {
+        int subtest = 20 + 10 * i;
+        FILE *cif_file;
+
+        RESOLVE_DATADIR(file_name, BUFFER_SIZE - strlen(local_file_names[i]));
+        TEST_NOT(file_name[0], 0, test_name, subtest);
+        strcat(file_name, local_file_names[i]);
+        cif_file = fopen(file_name, "rb");
+        TEST(cif_file == NULL, 0, test_name, subtest + 1);
+        cif = NULL;
+        TEST(cif_parse(cif_file, NULL, &cif), CIF_OK, test_name, subtest + 2);
+        fclose(cif_file);
+
+        options->max_write_threads = 0;
+        TEST(cif_write_buffer(cif, options, &aligned, &aligned_length), CIF_OK, test_name, subtest + 3);
+        TEST(cif_write_buffer(cif, NULL, &plain, &plain_length), CIF_OK, test_name, subtest + 4);
+        TEST(rewrite(aligned, aligned_length, &rewritten, &rewritten_length), CIF_OK, test_name, subtest + 5);
+        TEST(rewritten_length != plain_length, 0, test_name, subtest + 6);
+        TEST(memcmp(rewritten, plain, plain_length), 0, test_name, subtest + 7);
+        free(rewritten);
+        free(plain);
+
+        options->max_write_threads = 3;
+        TEST(cif_write_buffer(cif, options, &plain, &plain_length), CIF_OK, test_name, subtest + 8);
+        TEST((plain_length != aligned_length) || memcmp(plain, aligned, aligned_length), 0, test_name, subtest + 9);
+        free(plain);
+        free(aligned);
+        TEST(cif_destroy(cif), CIF_OK, test_name, subtest + 10);
+    }
+
+    free(options);
+
+    return 0;
+}
@@ -0,0 +1,175 @@
+/*
+ * test_write_buffer.c
+ *
+ * Tests the buffered output of cif_write(): the UTF-8 encoding of non-ASCII names and values, output larger than the
+ * writer's buffer, and the reporting of errors writing to the underlying stream.
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unicode/ustring.h>
+#include "../cif.h"
+#include "test.h"
+
+#define BUFFER_SIZE 512
+#define NUM_PACKETS 4000
+
+/* comfortably more than the writer's internal buffer */
+#define MIN_LARGE_OUTPUT (3 * 65536L)
+
+/* a block code ending with U+1F600, which is encoded in UTF-16 as a surrogate pair */
+static const UChar CODE[] = { 0x62, 0xd83d, 0xde00, 0 };
+static const char CODE_UTF8[] = "data_b\xf0\x9f\x98\x80";
+
+/* item names containing two-, three- and four-byte characters */
+static const UChar NAME2[] = { 0x5f, 0x76, 0x2e, 0xe9, 0x74, 0xe9, 0 };
+static const char NAME2_UTF8[] = "_v.\xc3\xa9t\xc3\xa9";
+static const UChar NAME3[] = { 0x5f, 0x76, 0x2e, 0x20ac, 0 };
+static const char NAME3_UTF8[] = "_v.\xe2\x82\xac";
+static const UChar NAME4[] = { 0x5f, 0x76, 0x2e, 0xd83d, 0xde00, 0 };
+static const char NAME4_UTF8[] = "_v.\xf0\x9f\x98\x80";
+
+/* a value mixing characters of every encoded length, and a multi-line one */
+static const UChar MIXED[] = { 0x61, 0xe9, 0x20ac, 0xd83d, 0xde00, 0x7a, 0 };
+static const char MIXED_UTF8[] = "a\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80z";
+static const UChar LINES[] = { 0x6c, 0xe9, 0x0a, 0x20ac, 0xd83d, 0xde00, 0 };
+static const char LINES_UTF8[] = "'''l\xc3\xa9\n\xe2\x82\xac\xf0\x9f\x98\x80'''";
+
+/* reads the whole content of the specified stream into newly-allocated, NUL-terminated space */
+static char *slurp(FILE *stream, long *length) {
+    char *content;
+
+    if ((fseek(stream, 0, SEEK_END) != 0) || ((*length = ftell(stream)) < 0)) {
+        return NULL;
+    }
+    rewind(stream);
+    if ((content = (char *) malloc(*length + 1)) != NULL) {
+        if (fread(content, 1, *length, stream) != (size_t) *length) {
+            free(content);
+            return NULL;
+        }
+        content[*length] = '\0';
+    }
+
+    return content;
+}
+
+/* writes a CIF having a loop of NUM_PACKETS packets, each with some non-ASCII text, to a new temporary stream */
+static FILE *write_large_input(void) {
+    FILE *stream = tmpfile();
+    int i;
+
+    if (stream != NULL) {
+        fputs("#\\#CIF_2.0\ndata_large\nloop_\n_l.key\n_l.text\n_l.note\n", stream);
+        for (i = 0; i < NUM_PACKETS; i += 1) {
+            fprintf(stream, "k%d 'value %d caf\xc3\xa9 \xe2\x82\xac\xf0\x9f\x98\x80' ", i, i);
+            if (i % 100 == 0) {
+                fprintf(stream, "\n;\nline one of text %d\nline \xc3\xa9 two\n;\n", i);
+            } else {
+                fputs("[1 2.5(3) {'k':v}]\n", stream);
+            }
+        }
+        rewind(stream);
+    }
+
+    return stream;
+}
+
+int main(void) {
+    char test_name[80] = "test_write_buffer";
+    char file_name[BUFFER_SIZE];
+    cif_tp *cif = NULL;
+    cif_tp *copy = NULL;
+    cif_block_tp *block = NULL;
+    cif_value_tp *value = NULL;
+    FILE *stream;
+    FILE *second;
+    char *content;
+    char *content2;
+    long length;
+    long length2;
+
+    TESTHEADER(test_name);
+
+    /* non-ASCII names and values */
+    TEST(cif_create(&cif), CIF_OK, test_name, 1);
+    TEST(cif_create_block(cif, CODE, &block), CIF_OK, test_name, 2);
+    TEST(cif_value_create(CIF_UNK_KIND, &value), CIF_OK, test_name, 3);
+    TEST(cif_value_copy_char(value, MIXED), CIF_OK, test_name, 4);
+    TEST(cif_container_set_value(block, NAME2, value), CIF_OK, test_name, 5);
+    TEST(cif_container_set_value(block, NAME3, value), CIF_OK, test_name, 6);
+    TEST(cif_value_copy_char(value, LINES), CIF_OK, test_name, 7);
+    TEST(cif_container_set_value(block, NAME4, value), CIF_OK, test_name, 8);
+    cif_value_free(value);
+    cif_container_free(block);
+
+    TEST((stream = tmpfile()) == NULL, 0, test_name, 9);
+    TEST(cif_write(stream, NULL, cif), CIF_OK, test_name, 10);
+    TEST((content = slurp(stream, &length)) == NULL, 0, test_name, 11);
+    fclose(stream);
+    TEST(strstr(content, CODE_UTF8) == NULL, 0, test_name, 12);
+    TEST(strstr(content, NAME2_UTF8) == NULL, 0, test_name, 13);
+    TEST(strstr(content, NAME3_UTF8) == NULL, 0, test_name, 14);
+    TEST(strstr(content, NAME4_UTF8) == NULL, 0, test_name, 15);
+    TEST(strstr(content, MIXED_UTF8) == NULL, 0, test_name, 16);
+    TEST(strstr(content, LINES_UTF8) == NULL, 0, test_name, 17);
+    free(content);
+
+    /* writing to a stream that does not accept output */
+    RESOLVE_DATADIR(file_name, BUFFER_SIZE - strlen("simple_data.cif"));
+    TEST(file_name[0] == '\0', 0, test_name, 18);
+    strcat(file_name, "simple_data.cif");
+    TEST((stream = fopen(file_name, "rb")) == NULL, 0, test_name, 19);
+    TEST_NOT(cif_write(stream, NULL, cif), CIF_OK, test_name, 20);
+    fclose(stream);
+    TEST(cif_destroy(cif), CIF_OK, test_name, 21);
+
+    /* output spanning many buffers, written, parsed and written again */
+    TEST((stream = write_large_input()) == NULL, 0, test_name, 22);
+    cif = NULL;
+    TEST(cif_parse(stream, NULL, &cif), CIF_OK, test_name, 23);
+    fclose(stream);
+    TEST((stream = tmpfile()) == NULL, 0, test_name, 24);
+    TEST(cif_write(stream, NULL, cif), CIF_OK, test_name, 25);
+    rewind(stream);
+    TEST(cif_parse(stream, NULL, &copy), CIF_OK, test_name, 26);
+    TEST((second = tmpfile()) == NULL, 0, test_name, 27);
+    TEST(cif_write(second, NULL, copy), CIF_OK, test_name, 28);
+    TEST((content = slurp(stream, &length)) == NULL, 0, test_name, 29);
+    TEST((content2 = slurp(second, &length2)) == NULL, 0, test_name, 30);
+    fclose(second);
+    fclose(stream);
+    TEST(length < MIN_LARGE_OUTPUT, 0, test_name, 31);
+    TEST(length2 != length, 0, test_name, 32);
+    TEST(memcmp(content, content2, length), 0, test_name, 33);
+    free(content2);
+    free(content);
+    TEST(cif_destroy(copy), CIF_OK, test_name, 34);
+
+    /* a large write to a stream that does not accept output fails partway through */
+    TEST((stream = fopen(file_name, "rb")) == NULL, 0, test_name, 35);
+    TEST_NOT(cif_write(stream, NULL, cif), CIF_OK, test_name, 36);
+    fclose(stream);
+    TEST(cif_destroy(cif), CIF_OK, test_name, 37);
+
+    return 0;
+}
@@ -0,0 +1,220 @@
+/*
+ * test_write_parallel.c
+ *
+ * Tests writing CIF data with several writer threads, checking that the output and the result are the same as those
+ * of a serial write, both when the write succeeds and when it fails part way through.
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unicode/ustring.h>
+#include "../cif.h"
+#include "test.h"
+
+#define BUFFER_SIZE 64
+#define NUM_LOOPS 12
+
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} sink_data_t;
+
+/* a write sink that accumulates its output in memory */
+static int collect(void *context, const char *bytes, size_t count) {
+    sink_data_t *sink_data = (sink_data_t *) context;
+
+    if ((sink_data->length + count) > sink_data->capacity) {
+        char *temp;
+
+        while ((sink_data->length + count) > sink_data->capacity) {
+            sink_data->capacity = (sink_data->capacity == 0) ? 1024 : (2 * sink_data->capacity);
+        }
+        temp = (char *) realloc(sink_data->data, sink_data->capacity);
+        if (temp == NULL) {
+            return 1;
+        }
+        sink_data->data = temp;
+    }
+    memcpy(sink_data->data + sink_data->length, bytes, count);
+    sink_data->length += count;
+
+    return 0;
+}
+
+/*
+ * Adds to the specified container a loop of the specified number of packets, with the specified category, having
+ * one numeric and one text item.  Returns a CIF API result code.
+ */
+static int add_loop(cif_container_tp *container, const char *category, int packet_count, cif_value_tp *text) {
+    char name_buffer[BUFFER_SIZE];
+    UChar name_n[BUFFER_SIZE];
+    UChar name_t[BUFFER_SIZE];
+    UChar *names[3];
+    cif_loop_tp *loop = NULL;
+    cif_packet_tp *packet = NULL;
+    cif_value_tp *value = NULL;
+    int result;
+    int i;
+
+    sprintf(name_buffer, "_%s.n", category);
+    u_uastrcpy(name_n, name_buffer);
+    sprintf(name_buffer, "_%s.t", category);
+    u_uastrcpy(name_t, name_buffer);
+    names[0] = name_n;
+    names[1] = name_t;
+    names[2] = NULL;
+
+    result = cif_container_create_loop(container, NULL, names, &loop);
+    if (result == CIF_OK) {
+        result = cif_packet_create(&packet, names);
+        if (result == CIF_OK) {
+            result = cif_packet_set_item(packet, name_t, text);
+            if (result == CIF_OK) {
+                result = cif_packet_get_item(packet, name_n, &value);
+            }
+            for (i = 0; (result == CIF_OK) && (i < packet_count); i += 1) {
+                result = cif_value_init_numb(value, i, 0.5, 1, 5);
+                if (result == CIF_OK) {
+                    result = cif_loop_add_packet(loop, packet);
+                }
+            }
+            cif_packet_free(packet);
+        }
+        cif_loop_free(loop);
+    }
+
+    return result;
+}
+
+int main(void) {
+    char test_name[80] = "test_write_parallel";
+    cif_tp *cif = NULL;
+    cif_block_tp *block = NULL;
+    cif_frame_tp *frame = NULL;
+    cif_value_tp *value = NULL;
+    cif_value_tp *list = NULL;
+    struct cif_write_opts_s *options = NULL;
+    sink_data_t expected;
+    sink_data_t actual;
+    char category[16];
+    char *bytes;
+    size_t length;
+    UChar buffer[BUFFER_SIZE];
+    UChar name_title[] = { '_', 't', 'i', 't', 'l', 'e', 0 };
+    UChar name_list[] = { '_', 'l', 'i', 's', 't', 0 };
+    UChar name_text[] = { '_', 'l', 'o', 'o', 'p', '5', '.', 't', 0 };
+    int thread_counts[] = { 2, 3, 16 };
+    int expected_result;
+    int i;
+
+    TESTHEADER(test_name);
+    CREATE_CIF(test_name, cif);
+    TEST(cif_value_create(CIF_UNK_KIND, &value), CIF_OK, test_name, 1);
+    TEST(cif_value_copy_char(value, TO_UNICODE("some text, 'quoted'", buffer, BUFFER_SIZE)), CIF_OK, test_name, 2);
+
+    /* a block with scalars of several kinds, save frames, and loops of very different sizes */
+    TEST(cif_create_block(cif, TO_UNICODE("first", buffer, BUFFER_SIZE), &block), CIF_OK, test_name, 3);
+    TEST(cif_container_set_value(block, name_title, value), CIF_OK, test_name, 4);
+    TEST(cif_value_create(CIF_LIST_KIND, &list), CIF_OK, test_name, 5);
+    TEST(cif_value_insert_element_at(list, 0, value), CIF_OK, test_name, 6);
+    TEST(cif_container_set_value(block, name_list, list), CIF_OK, test_name, 7);
+    cif_value_free(list);
+    TEST(cif_container_create_frame(block, TO_UNICODE("frame1", buffer, BUFFER_SIZE), &frame), CIF_OK,
+            test_name, 8);
+    TEST(cif_container_set_value(frame, name_title, value), CIF_OK, test_name, 9);
+    TEST(add_loop(frame, "framed", 40, value), CIF_OK, test_name, 10);
+    cif_frame_free(frame);
+    TEST(cif_container_create_frame(block, TO_UNICODE("frame2", buffer, BUFFER_SIZE), &frame), CIF_OK,
+            test_name, 11);
+    cif_frame_free(frame);
+    for (i = 0; i < NUM_LOOPS; i += 1) {
+        sprintf(category, "loop%d", i);
+        /* mostly small loops, and a few large ones */
+        TEST(add_loop(block, category, ((i % 4 == 1) ? 2000 : (i + 1)), value), CIF_OK, test_name, 12);
+    }
+    cif_block_free(block);
+
+    /* an empty block, and another with only loops */
+    TEST(cif_create_block(cif, TO_UNICODE("empty", buffer, BUFFER_SIZE), &block), CIF_OK, test_name, 13);
+    cif_block_free(block);
+    TEST(cif_create_block(cif, TO_UNICODE("last", buffer, BUFFER_SIZE), &block), CIF_OK, test_name, 14);
+    TEST(add_loop(block, "tail", 300, value), CIF_OK, test_name, 15);
+    TEST(add_loop(block, "end", 1, value), CIF_OK, test_name, 16);
+    cif_block_free(block);
+
+    /* serial output */
+    TEST(cif_write_options_create(&options), CIF_OK, test_name, 17);
+    memset(&expected, 0, sizeof(expected));
+    TEST(cif_write_to_sink(collect, &expected, options, cif), CIF_OK, test_name, 18);
+
+    /* parallel output, to a sink and to memory, for various numbers of threads */
+    for (i = 0; i < (int) (sizeof(thread_counts) / sizeof(thread_counts[0])); i += 1) {
+        int subtest = 20 + 10 * i;
+
+        options->max_write_threads = thread_counts[i];
+        memset(&actual, 0, sizeof(actual));
+        TEST(cif_write_to_sink(collect, &actual, options, cif), CIF_OK, test_name, subtest);
+        TEST(actual.length != expected.length, 0, test_name, subtest + 1);
+        TEST(memcmp(actual.data, expected.data, actual.length), 0, test_name, subtest + 2);
+        free(actual.data);
+        TEST(cif_write_buffer(cif, options, &bytes, &length), CIF_OK, test_name, subtest + 3);
+        TEST(length != expected.length, 0, test_name, subtest + 4);
+        TEST(memcmp(bytes, expected.data, length), 0, test_name, subtest + 5);
+        free(bytes);
+    }
+    free(expected.data);
+
+    /*
+     * A CIF 1.1 write that fails within a loop: the parallel writer delivers the same partial output as the serial
+     * one, and reports the same error
+     */
+    TEST(cif_get_block(cif, TO_UNICODE("first", buffer, BUFFER_SIZE), &block), CIF_OK, test_name, 60);
+    TEST(cif_container_remove_item(block, name_list), CIF_OK, test_name, 61);
+    TEST(cif_value_copy_char(value, TO_UNICODE("\\u00c5ngstr\\u00f6m", buffer, BUFFER_SIZE)), CIF_OK,
+            test_name, 62);
+    TEST(cif_container_set_value(block, name_text, value), CIF_OK, test_name, 63);
+    cif_block_free(block);
+    options->cif_version = 1;
+    options->max_write_threads = 0;
+    memset(&expected, 0, sizeof(expected));
+    expected_result = cif_write_to_sink(collect, &expected, options, cif);
+    TEST(expected_result, CIF_DISALLOWED_CHAR, test_name, 64);
+    TEST(expected.length == 0, 0, test_name, 65);
+    for (i = 0; i < (int) (sizeof(thread_counts) / sizeof(thread_counts[0])); i += 1) {
+        int subtest = 70 + 10 * i;
+
+        options->max_write_threads = thread_counts[i];
+        memset(&actual, 0, sizeof(actual));
+        TEST(cif_write_to_sink(collect, &actual, options, cif), expected_result, test_name, subtest);
+        TEST(actual.length != expected.length, 0, test_name, subtest + 1);
+        TEST(memcmp(actual.data, expected.data, actual.length), 0, test_name, subtest + 2);
+        free(actual.data);
+    }
+    free(expected.data);
+
+    free(options);
+    cif_value_free(value);
+    DESTROY_CIF(test_name, cif);
+
+    return 0;
+}
@@ -0,0 +1,274 @@
+/*
+ * test_write_select.c
+ *
+ * Tests writing selected data blocks, save frames, and data items of a CIF, checking that the output represents the
+ * same data as writing a copy of the CIF from which the unselected parts have been removed does.
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unicode/ustring.h>
+#include "../cif.h"
+#include "test.h"
+
+#define BUFFER_SIZE 512
+
+/*
+ * Parses the CIF formatted in the specified bytes and writes it again, so that outputs describing the same data can be
+ * compared byte for byte.  Returns a CIF API result code.
+ */
+static int rewrite(const char *bytes, size_t length, char **rewritten, size_t *rewritten_length) {
+    FILE *stream = tmpfile();
+    cif_tp *cif = NULL;
+    int result;
+
+    if (stream == NULL) {
+        return CIF_ERROR;
+    } else if (fwrite(bytes, 1, length, stream) != length) {
+        fclose(stream);
+        return CIF_ERROR;
+    }
+    rewind(stream);
+    result = cif_parse(stream, NULL, &cif);
+    fclose(stream);
+    if (result == CIF_OK) {
+        result = cif_write_buffer(cif, NULL, rewritten, rewritten_length);
+    }
+    if ((cif != NULL) && (cif_destroy(cif) != CIF_OK) && (result == CIF_OK)) {
+        free(*rewritten);
+        result = CIF_ERROR;
+    }
+
+    return result;
+}
+
+/*
+ * Writes the specified CIF with the specified options, and compares the result with that of writing the reference CIF
+ * without any.  Returns zero if they represent the same data, or nonzero if not.
+ */
+static int compare_output(cif_tp *cif, struct cif_write_opts_s *options, cif_tp *reference) {
+    char *bytes[2] = { NULL, NULL };
+    size_t lengths[2];
+    char *rewritten[2] = { NULL, NULL };
+    size_t rewritten_lengths[2];
+    int result = 1;
+
+    if ((cif_write_buffer(cif, options, bytes, lengths) == CIF_OK)
+            && (cif_write_buffer(reference, NULL, bytes + 1, lengths + 1) == CIF_OK)
+            && (rewrite(bytes[0], lengths[0], rewritten, rewritten_lengths) == CIF_OK)
+            && (rewrite(bytes[1], lengths[1], rewritten + 1, rewritten_lengths + 1) == CIF_OK)) {
+        result = ((rewritten_lengths[0] != rewritten_lengths[1])
+                || (memcmp(rewritten[0], rewritten[1], rewritten_lengths[0]) != 0));
+    }
+    free(bytes[0]);
+    free(bytes[1]);
+    free(rewritten[0]);
+    free(rewritten[1]);
+
+    return result;
+}
+
+/* removes the specified data items from the specified container and all save frames nested within it */
+static int remove_items(cif_container_tp *container, const char **names) {
+    cif_frame_tp **frames;
+    cif_frame_tp **next_frame;
+    const char **next_name;
+    int result = CIF_OK;
+
+    for (next_name = names; (result == CIF_OK) && (*next_name != NULL); next_name += 1) {
+        UChar name[BUFFER_SIZE];
+
+        u_uastrcpy(name, *next_name);
+        result = cif_container_remove_item(container, name);
+        if (result == CIF_NOSUCH_ITEM) {
+            result = CIF_OK;
+        }
+    }
+
+    if ((result == CIF_OK) && ((result = cif_container_get_all_frames(container, &frames)) == CIF_OK)) {
+        for (next_frame = frames; *next_frame != NULL; next_frame += 1) {
+            if (result == CIF_OK) {
+                result = remove_items(*next_frame, names);
+            }
+            cif_container_free(*next_frame);
+        }
+        free(frames);
+    }
+
+    return result;
+}
+
+/* parses the specified test data file into a new managed CIF */
+static int parse_file(const char *local_file_name, cif_tp **cif) {
+    char file_name[BUFFER_SIZE];
+    FILE *cif_file;
+    int result;
+
+    RESOLVE_DATADIR(file_name, BUFFER_SIZE - strlen(local_file_name));
+    if (file_name[0] == 0) {
+        return CIF_ERROR;
+    }
+    strcat(file_name, local_file_name);
+    cif_file = fopen(file_name, "rb");
+    if (cif_file == NULL) {
+        return CIF_ERROR;
+    }
+    *cif = NULL;  /* else the file would be parsed into an existing CIF */
+    result = cif_parse(cif_file, NULL, cif);
+    fclose(cif_file);
+
+    return result;
+}
+
+/* destroys the specified save frame of the specified data block of the specified CIF */
+static int destroy_frame(cif_tp *cif, const char *block_code, const char *frame_code) {
+    UChar code[BUFFER_SIZE];
+    cif_block_tp *block;
+    cif_frame_tp *frame;
+    int result;
+
+    u_uastrcpy(code, block_code);
+    result = cif_get_block(cif, code, &block);
+    if (result == CIF_OK) {
+        u_uastrcpy(code, frame_code);
+        result = cif_container_get_frame(block, code, &frame);
+        if (result == CIF_OK) {
+            result = cif_container_destroy(frame);
+        }
+        cif_container_free(block);
+    }
+
+    return result;
+}
+
+int main(void) {
+    char test_name[80] = "test_write_select";
+    struct cif_write_opts_s *options = NULL;
+    cif_tp *cif = NULL;
+    cif_tp *reference = NULL;
+    cif_block_tp *block;
+    UChar second[7] = { 's', 'E', 'C', 'o', 'n', 'D', 0 };
+    UChar fourth[7] = { 'f', 'o', 'u', 'r', 't', 'h', 0 };
+    UChar missing[8] = { 'm', 'i', 's', 's', 'i', 'n', 'g', 0 };
+    UChar s1[3] = { 'S', '1', 0 };
+    const UChar *block_codes[4];
+    const UChar *frame_codes[2];
+    const UChar *no_codes[1] = { NULL };
+    const char *include_names[4] = { "_first_loop.id", "_third_loop", "_FIRST.Scalar", NULL };
+    const char *exclude_names[2] = { "_third_loop.y", NULL };
+    const char *removed_names[] = {
+        "_first.text", "_first_loop.value", "_second.list", "_second.table", "_frame.item", "_third.comment_only",
+        "_third_loop.y", "_fourth.na", "_fourth.unknown", "_fifth.text", NULL
+    };
+    char *serial;
+    size_t serial_length;
+    char *parallel;
+    size_t parallel_length;
+    int i;
+
+    TESTHEADER(test_name);
+    TEST(cif_write_options_create(&options), CIF_OK, test_name, 1);
+    TEST(options->block_codes != NULL, 0, test_name, 2);
+    TEST(options->frame_codes != NULL, 0, test_name, 3);
+    TEST(options->include_names != NULL, 0, test_name, 4);
+    TEST(options->exclude_names != NULL, 0, test_name, 5);
+
+    /* block selection, ignoring case and codes matching no block */
+    block_codes[0] = second;
+    block_codes[1] = missing;
+    block_codes[2] = fourth;
+    block_codes[3] = NULL;
+    options->block_codes = block_codes;
+    TEST(parse_file("multi_block.cif", &cif), CIF_OK, test_name, 10);
+    TEST(parse_file("multi_block.cif", &reference), CIF_OK, test_name, 11);
+    {
+        const char *removed_blocks[4] = { "first", "third", "fifth", NULL };
+
+        for (i = 0; removed_blocks[i] != NULL; i += 1) {
+            TEST(cif_get_block_utf8(reference, removed_blocks[i], &block), CIF_OK, test_name, 12 + 2 * i);
+            TEST(cif_container_destroy(block), CIF_OK, test_name, 13 + 2 * i);
+        }
+    }
+    TEST(compare_output(cif, options, reference), 0, test_name, 20);
+    TEST(cif_destroy(reference), CIF_OK, test_name, 21);
+    options->block_codes = NULL;
+
+    /* data name selection, in scalars and in loops, including whole loops and containers left empty */
+    options->include_names = include_names;
+    options->exclude_names = exclude_names;
+    TEST(parse_file("multi_block.cif", &reference), CIF_OK, test_name, 30);
+    {
+        cif_block_tp **blocks;
+        cif_block_tp **next_block;
+
+        TEST(cif_get_all_blocks(reference, &blocks), CIF_OK, test_name, 31);
+        for (next_block = blocks; *next_block != NULL; next_block += 1) {
+            TEST(remove_items(*next_block, removed_names), CIF_OK, test_name, 32);
+            cif_container_free(*next_block);
+        }
+        free(blocks);
+    }
+    TEST(compare_output(cif, options, reference), 0, test_name, 33);
+    TEST(cif_destroy(reference), CIF_OK, test_name, 34);
+
+    /* the same selection, written in parallel */
+    options->max_write_threads = 3;
+    TEST(cif_write_buffer(cif, options, &parallel, &parallel_length), CIF_OK, test_name, 35);
+    options->max_write_threads = 0;
+    TEST(cif_write_buffer(cif, options, &serial, &serial_length), CIF_OK, test_name, 36);
+    TEST(parallel_length != serial_length, 0, test_name, 37);
+    TEST(memcmp(parallel, serial, serial_length), 0, test_name, 38);
+    free(parallel);
+    free(serial);
+    options->include_names = NULL;
+    options->exclude_names = NULL;
+    TEST(cif_destroy(cif), CIF_OK, test_name, 39);
+
+    /* frame selection; unselected frames are omitted from every block */
+    frame_codes[0] = s1;
+    frame_codes[1] = NULL;
+    options->frame_codes = frame_codes;
+    TEST(parse_file("simple_containers.cif", &cif), CIF_OK, test_name, 40);
+    TEST(parse_file("simple_containers.cif", &reference), CIF_OK, test_name, 41);
+    TEST(destroy_frame(reference, "block1", "s2"), CIF_OK, test_name, 42);
+    TEST(destroy_frame(reference, "block3", "s3"), CIF_OK, test_name, 43);
+    TEST(compare_output(cif, options, reference), 0, test_name, 44);
+
+    /* an empty frame selection omits all frames */
+    options->frame_codes = no_codes;
+    TEST(destroy_frame(reference, "block1", "s1"), CIF_OK, test_name, 45);
+    TEST(destroy_frame(reference, "block3", "s1"), CIF_OK, test_name, 46);
+    TEST(compare_output(cif, options, reference), 0, test_name, 47);
+    TEST(cif_destroy(reference), CIF_OK, test_name, 48);
+
+    /* an empty block selection writes no blocks at all */
+    options->frame_codes = NULL;
+    options->block_codes = no_codes;
+    TEST(cif_create(&reference), CIF_OK, test_name, 50);
+    TEST(compare_output(cif, options, reference), 0, test_name, 51);
+    TEST(cif_destroy(reference), CIF_OK, test_name, 52);
+    TEST(cif_destroy(cif), CIF_OK, test_name, 53);
+
+    free(options);
+
+    return 0;
+}
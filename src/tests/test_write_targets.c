@@ -0,0 +1,223 @@
+/*
+ * test_write_targets.c
+ *
+ * Tests writing CIF data to memory, to a file descriptor, and to a sink function, checking that the output is the
+ * same as cif_write() produces.
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* for fileno() */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unicode/ustring.h>
+#include "../cif.h"
+#include "test.h"
+
+#define BUFFER_SIZE 64
+/* enough packets that the output is several times the size of the writer's internal buffer */
+#define NUM_PACKETS 8000
+
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+    int calls;
+    int fail_after;
+} sink_data_t;
+
+/* a write sink that accumulates its output in memory, and can be made to fail */
+static int collect(void *context, const char *bytes, size_t count) {
+    sink_data_t *sink_data = (sink_data_t *) context;
+
+    sink_data->calls += 1;
+    if ((sink_data->fail_after > 0) && (sink_data->calls > sink_data->fail_after)) {
+        return 1;
+    }
+    if ((sink_data->length + count) > sink_data->capacity) {
+        char *temp;
+
+        while ((sink_data->length + count) > sink_data->capacity) {
+            sink_data->capacity = (sink_data->capacity == 0) ? 1024 : (2 * sink_data->capacity);
+        }
+        temp = (char *) realloc(sink_data->data, sink_data->capacity);
+        if (temp == NULL) {
+            return 1;
+        }
+        sink_data->data = temp;
+    }
+    memcpy(sink_data->data + sink_data->length, bytes, count);
+    sink_data->length += count;
+
+    return 0;
+}
+
+/* reads the whole contents of the specified stream into newly-allocated memory, recording the length */
+static char *slurp(FILE *stream, size_t *length) {
+    size_t capacity = 1024;
+    char *data = (char *) malloc(capacity);
+
+    *length = 0;
+    rewind(stream);
+    while (data != NULL) {
+        *length += fread(data + *length, 1, capacity - *length, stream);
+        if (*length < capacity) {
+            break;
+        } else {
+            char *temp = (char *) realloc(data, 2 * capacity);
+
+            if (temp == NULL) {
+                free(data);
+                data = NULL;
+            } else {
+                data = temp;
+                capacity *= 2;
+            }
+        }
+    }
+
+    return data;
+}
+
+int main(void) {
+    char test_name[80] = "test_write_targets";
+    FILE *expected_file;
+    FILE *fd_file;
+    cif_tp *cif = NULL;
+    cif_block_tp *block = NULL;
+    cif_loop_tp *loop = NULL;
+    cif_packet_tp *packet = NULL;
+    cif_value_tp *value = NULL;
+    struct cif_write_opts_s *options = NULL;
+    char *expected;
+    size_t expected_length;
+    char *bytes;
+    size_t length;
+    sink_data_t sink_data;
+    UChar buffer[BUFFER_SIZE];
+    UChar name_id[] = { '_', 'i', 'd', 0 };
+    UChar name_text[] = { '_', 't', 'e', 'x', 't', 0 };
+    UChar value_text[] = { 'a', 'n', 'g', 's', 't', 'r', 0xc5, 'm', ' ', 0x00b1, ' ', 0x212b, 0 };
+    UChar *names[3];
+    int result;
+    int i;
+
+    TESTHEADER(test_name);
+    CREATE_CIF(test_name, cif);
+    TEST(cif_create_block(cif, TO_UNICODE("targets", buffer, BUFFER_SIZE), &block), CIF_OK, test_name, 1);
+
+    /* a loop large enough to overflow the writer's internal buffer several times */
+    names[0] = name_id;
+    names[1] = name_text;
+    names[2] = NULL;
+    TEST(cif_container_create_loop(block, NULL, names, &loop), CIF_OK, test_name, 2);
+    TEST(cif_packet_create(&packet, names), CIF_OK, test_name, 3);
+    TEST(cif_packet_get_item(packet, name_text, &value), CIF_OK, test_name, 4);
+    TEST(cif_value_copy_char(value, value_text), CIF_OK, test_name, 5);
+    TEST(cif_packet_get_item(packet, name_id, &value), CIF_OK, test_name, 6);
+    for (i = 0; i < NUM_PACKETS; i += 1) {
+        TEST(cif_value_init_numb(value, i, 0.0, 0, 1), CIF_OK, test_name, 7);
+        TEST(cif_loop_add_packet(loop, packet), CIF_OK, test_name, 8);
+    }
+    value = NULL;
+    cif_packet_free(packet);
+    cif_loop_free(loop);
+
+    /* the reference output */
+    expected_file = tmpfile();
+    TEST(expected_file == NULL, 0, test_name, 9);
+    TEST(cif_write(expected_file, NULL, cif), CIF_OK, test_name, 10);
+    expected = slurp(expected_file, &expected_length);
+    TEST(expected == NULL, 0, test_name, 11);
+    TEST(expected_length <= 65536, 0, test_name, 12);
+
+    /* in-memory output */
+    TEST(cif_write_buffer(cif, NULL, &bytes, &length), CIF_OK, test_name, 13);
+    TEST(length != expected_length, 0, test_name, 14);
+    TEST(memcmp(bytes, expected, length), 0, test_name, 15);
+    TEST(bytes[length], 0, test_name, 16);
+    free(bytes);
+    TEST(cif_write_buffer(cif, NULL, &bytes, NULL), CIF_OK, test_name, 17);
+    TEST(strcmp(bytes, expected) != 0, 0, test_name, 18);
+    free(bytes);
+    TEST(cif_write_buffer(cif, NULL, NULL, &length), CIF_ARGUMENT_ERROR, test_name, 19);
+
+    /* file descriptor output, where supported */
+    fd_file = tmpfile();
+    TEST(fd_file == NULL, 0, test_name, 20);
+    result = cif_write_fd(fileno(fd_file), NULL, cif);
+    if (result != CIF_NOT_SUPPORTED) {
+        TEST(result, CIF_OK, test_name, 21);
+        bytes = slurp(fd_file, &length);
+        TEST(bytes == NULL, 0, test_name, 22);
+        TEST(length != expected_length, 0, test_name, 23);
+        TEST(memcmp(bytes, expected, length), 0, test_name, 24);
+        free(bytes);
+    }
+    fclose(fd_file);
+
+    /* sink output, in more than one chunk */
+    memset(&sink_data, 0, sizeof(sink_data));
+    TEST(cif_write_to_sink(collect, &sink_data, NULL, cif), CIF_OK, test_name, 25);
+    TEST(sink_data.calls < 2, 0, test_name, 26);
+    TEST(sink_data.length != expected_length, 0, test_name, 27);
+    TEST(memcmp(sink_data.data, expected, sink_data.length), 0, test_name, 28);
+    TEST(cif_write_to_sink(NULL, &sink_data, NULL, cif), CIF_ARGUMENT_ERROR, test_name, 29);
+
+    /* a failing sink aborts the write */
+    sink_data.length = 0;
+    sink_data.calls = 0;
+    sink_data.fail_after = 1;
+    TEST(cif_write_to_sink(collect, &sink_data, NULL, cif), CIF_ERROR, test_name, 30);
+    TEST(sink_data.calls, 2, test_name, 31);
+    free(sink_data.data);
+    free(expected);
+
+    /* CIF 1.1 output goes through the same targets, and so do its failures */
+    TEST(cif_write_options_create(&options), CIF_OK, test_name, 32);
+    options->cif_version = 1;
+    bytes = NULL;
+    TEST(cif_write_buffer(cif, options, &bytes, &length), CIF_DISALLOWED_CHAR, test_name, 33);
+    TEST(bytes != NULL, 0, test_name, 34);
+    TEST(cif_value_create(CIF_UNK_KIND, &value), CIF_OK, test_name, 35);
+    TEST(cif_value_copy_char(value, TO_UNICODE("plain", buffer, BUFFER_SIZE)), CIF_OK, test_name, 36);
+    TEST(cif_container_set_value(block, name_text, value), CIF_OK, test_name, 37);
+    cif_value_free(value);
+    fclose(expected_file);
+    expected_file = tmpfile();
+    TEST(expected_file == NULL, 0, test_name, 38);
+    TEST(cif_write(expected_file, options, cif), CIF_OK, test_name, 39);
+    expected = slurp(expected_file, &expected_length);
+    TEST(expected == NULL, 0, test_name, 40);
+    TEST(cif_write_buffer(cif, options, &bytes, &length), CIF_OK, test_name, 41);
+    TEST(length != expected_length, 0, test_name, 42);
+    TEST(memcmp(bytes, expected, length), 0, test_name, 43);
+    free(bytes);
+    free(expected);
+    free(options);
+    fclose(expected_file);
+
+    cif_block_free(block);
+    DESTROY_CIF(test_name, cif);
+
+    return 0;
+}
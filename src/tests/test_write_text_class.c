@@ -0,0 +1,189 @@
+/*
+ * test_write_text_class.c
+ *
+ * Tests that the writer presents stored character values in the form recommended by cif_analyze_string(), in both
+ * CIF 2.0 and CIF 1.1 mode, and that the output parses back to the same values.
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unicode/ustring.h>
+#include "../cif.h"
+#include "test.h"
+
+#define BUFFER_SIZE 64
+#define NUM_STRINGS 14
+
+/*
+ * Checks whether the value of item _v in the specified writer output begins with the delimiter recommended by the
+ * specified analysis of the specified text.  Returns nonzero if so, or zero if not.
+ */
+static int has_delimiter(const char *output, const UChar *text, struct cif_string_analysis_s *analysis) {
+    const char *start = strstr(output, "\n_v");
+    unsigned i;
+
+    if (start == NULL) {
+        return 0;
+    }
+    for (start += 3; (*start == ' ') || (*start == '\n'); start += 1) ;
+    if (analysis->delim_length == 0) {
+        /* the output is UTF-8, so a non-ASCII first character is recognized only as such */
+        return (text[0] < 0x80) ? (*start == (char) text[0]) : ((unsigned char) *start >= 0x80);
+    } else if (analysis->delim[0] == '\n') {
+        /* a text field; the preceding newline has been skipped */
+        return (*start == ';');
+    }
+    for (i = 0; i < analysis->delim_length; i += 1) {
+        if (start[i] != (char) analysis->delim[i]) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/*
+ * Parses the specified writer output, and checks whether the value of item _v in its only block has the specified
+ * text.  Returns nonzero if so, or zero if not.
+ */
+static int parses_to(const char *output, size_t length, const UChar *text) {
+    FILE *stream = tmpfile();
+    cif_tp *cif = NULL;
+    cif_block_tp *block = NULL;
+    cif_value_tp *value = NULL;
+    UChar name_v[] = { '_', 'v', 0 };
+    UChar code[] = { 'b', 0 };
+    UChar *parsed_text;
+    int ok = 0;
+
+    if (stream == NULL) {
+        return 0;
+    }
+    if ((fwrite(output, 1, length, stream) == length) && (fseek(stream, 0, SEEK_SET) == 0)
+            && (cif_parse(stream, NULL, &cif) == CIF_OK)) {
+        if ((cif_get_block(cif, code, &block) == CIF_OK)
+                && (cif_container_get_value(block, name_v, &value) == CIF_OK)
+                && (cif_value_get_text(value, &parsed_text) == CIF_OK)) {
+            ok = (u_strcmp(parsed_text, text) == 0);
+            free(parsed_text);
+        }
+        if (value != NULL) cif_value_free(value);
+        if (block != NULL) cif_block_free(block);
+        if (cif_destroy(cif) != CIF_OK) ok = 0;
+    }
+    fclose(stream);
+
+    return ok;
+}
+
+int main(void) {
+    char test_name[80] = "test_write_text_class";
+    const char *strings[NUM_STRINGS] = {
+        "plain",
+        "it's",
+        "say \"hi\"",
+        "both ' and \"",
+        "'''x'''",
+        "line one\nline two",
+        "a ''' and a \"\"\" on one line",
+        "x'''y\"\"\"z\nw",
+        "\n;not the end",
+        ";starts with a semicolon",
+        "_looks_like_a_name",
+        "[not a list]",
+        "tab\there",
+        "\\u00c5ngstr\\u00f6m"
+    };
+    cif_tp *cif = NULL;
+    cif_block_tp *block = NULL;
+    cif_value_tp *value = NULL;
+    struct cif_write_opts_s *options = NULL;
+    struct cif_string_analysis_s analysis;
+    UChar buffer[BUFFER_SIZE];
+    UChar name_v[] = { '_', 'v', 0 };
+    char *bytes;
+    char *bytes_again;
+    size_t length;
+    int quoted;
+    int version;
+    int result;
+    int subtest;
+    int i;
+
+    TESTHEADER(test_name);
+    CREATE_CIF(test_name, cif);
+    TEST(cif_create_block(cif, TO_UNICODE("b", buffer, BUFFER_SIZE), &block), CIF_OK, test_name, 1);
+    TEST(cif_value_create(CIF_UNK_KIND, &value), CIF_OK, test_name, 2);
+    TEST(cif_write_options_create(&options), CIF_OK, test_name, 3);
+
+    subtest = 10;
+    for (i = 0; i < NUM_STRINGS; i += 1) {
+        TO_UNICODE(strings[i], buffer, BUFFER_SIZE);
+        for (quoted = 0; quoted < 2; quoted += 1) {
+            TEST(cif_value_copy_char(value, buffer), CIF_OK, test_name, subtest);
+            if (!quoted) {
+                /* values in reserved forms can be marked unquoted, but their presentation must not change */
+                result = cif_value_set_quoted(value, CIF_NOT_QUOTED);
+                if (result != CIF_OK) {
+                    subtest += 16;
+                    continue;
+                }
+            }
+            TEST(cif_container_set_value(block, name_v, value), CIF_OK, test_name, subtest + 1);
+
+            for (version = 2; version > 0; version -= 1) {
+                int base = subtest + 8 * (2 - version);
+
+                options->cif_version = version;
+                result = cif_write_buffer(cif, options, &bytes, &length);
+                if ((version == 1) && (result == CIF_DISALLOWED_CHAR)) {
+                    /* only the non-ASCII string is unrepresentable in CIF 1.1 */
+                    TEST(i, NUM_STRINGS - 1, test_name, base + 2);
+                    continue;
+                } else if ((version == 1) && (result == CIF_DISALLOWED_VALUE)) {
+                    /* CIF 1.1 cannot represent a value that contains a text field delimiter */
+                    TEST(strstr(strings[i], "\n;") == NULL, 0, test_name, base + 2);
+                    continue;
+                }
+                TEST(result, CIF_OK, test_name, base + 2);
+                TEST(cif_analyze_string(buffer, !quoted && !cif_is_reserved_string(buffer), version > 1,
+                        CIF_LINE_LENGTH, &analysis), CIF_OK, test_name, base + 3);
+                TEST(!has_delimiter(bytes, buffer, &analysis), 0, test_name, base + 4);
+                TEST(!parses_to(bytes, length, buffer), 0, test_name, base + 5);
+
+                /* a second write, of the same stored value, is identical */
+                TEST(cif_write_buffer(cif, options, &bytes_again, NULL), CIF_OK, test_name, base + 6);
+                TEST(strcmp(bytes, bytes_again) != 0, 0, test_name, base + 7);
+                free(bytes_again);
+                free(bytes);
+            }
+            subtest += 16;
+        }
+    }
+
+    free(options);
+    cif_value_free(value);
+    cif_block_free(block);
+    DESTROY_CIF(test_name, cif);
+
+    return 0;
+}
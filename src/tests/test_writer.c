@@ -0,0 +1,329 @@
+/*
+ * test_writer.c
+ *
+ * Tests the incremental CIF writer, checking that it formats a CIF presented element by element exactly as
+ * cif_write() formats the same CIF from a store, and that it rejects misuse and reports errors as documented.
+ *
+ * Copyright 2014, 2015 John C. Bollinger
+ *
+ *
+ * This file is part of the CIF API.
+ *
+ * The CIF API is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published
+ * by the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * The CIF API is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with the CIF API.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unicode/ustring.h>
+#include "../cif.h"
+#include "test.h"
+
+#define BUFFER_SIZE 64
+#define NUM_PACKETS 100
+
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} sink_data_t;
+
+/* the state of a walk that replays a stored CIF through an incremental writer */
+typedef struct {
+    cif_writer_tp *writer;
+    UChar **names;
+    int in_scalars;
+} replay_t;
+
+/* a write sink that accumulates its output in memory */
+static int collect(void *context, const char *bytes, size_t count) {
+    sink_data_t *sink_data = (sink_data_t *) context;
+
+    if ((sink_data->length + count) > sink_data->capacity) {
+        char *temp;
+
+        while ((sink_data->length + count) > sink_data->capacity) {
+            sink_data->capacity = (sink_data->capacity == 0) ? 1024 : (2 * sink_data->capacity);
+        }
+        temp = (char *) realloc(sink_data->data, sink_data->capacity);
+        if (temp == NULL) {
+            return 1;
+        }
+        sink_data->data = temp;
+    }
+    memcpy(sink_data->data + sink_data->length, bytes, count);
+    sink_data->length += count;
+
+    return 0;
+}
+
+static int replay_block_start(cif_container_tp *block, void *context) {
+    replay_t *replay = (replay_t *) context;
+    UChar *code;
+    int result = cif_container_get_code(block, &code);
+
+    if (result == CIF_OK) {
+        result = cif_writer_begin_block(replay->writer, code);
+        free(code);
+    }
+
+    return result;
+}
+
+static int replay_frame_start(cif_container_tp *frame, void *context) {
+    replay_t *replay = (replay_t *) context;
+    UChar *code;
+    int result = cif_container_get_code(frame, &code);
+
+    if (result == CIF_OK) {
+        result = cif_writer_begin_frame(replay->writer, code);
+        free(code);
+    }
+
+    return result;
+}
+
+static int replay_frame_end(cif_container_tp *frame UNUSED, void *context) {
+    return cif_writer_end_frame(((replay_t *) context)->writer);
+}
+
+static int replay_loop_start(cif_loop_tp *loop, void *context) {
+    replay_t *replay = (replay_t *) context;
+    UChar *category = NULL;
+    int result = cif_loop_get_category(loop, &category);
+
+    if (result == CIF_OK) {
+        replay->in_scalars = ((category != NULL) && (u_strcmp(category, CIF_SCALARS) == 0));
+        free(category);
+        if (!replay->in_scalars) {
+            result = cif_loop_get_names(loop, &replay->names);
+            if (result == CIF_OK) {
+                result = cif_writer_begin_loop(replay->writer, (const UChar **) replay->names);
+            }
+        }
+    }
+
+    return result;
+}
+
+static int replay_loop_end(cif_loop_tp *loop UNUSED, void *context) {
+    replay_t *replay = (replay_t *) context;
+
+    if (replay->names != NULL) {
+        UChar **name;
+
+        for (name = replay->names; *name != NULL; name += 1) {
+            free(*name);
+        }
+        free(replay->names);
+        replay->names = NULL;
+    }
+
+    return CIF_TRAVERSE_CONTINUE;
+}
+
+static int replay_packet_start(cif_packet_tp *packet, void *context) {
+    replay_t *replay = (replay_t *) context;
+    cif_value_tp *values[BUFFER_SIZE];
+    int result = CIF_OK;
+    int i;
+
+    if (replay->in_scalars) {
+        /* scalars are replayed item by item */
+        return CIF_TRAVERSE_CONTINUE;
+    }
+    for (i = 0; (result == CIF_OK) && (replay->names[i] != NULL); i += 1) {
+        result = cif_packet_get_item(packet, replay->names[i], &values[i]);
+    }
+
+    return (result == CIF_OK) ? cif_writer_packet(replay->writer, values) : result;
+}
+
+static int replay_item(UChar *name, cif_value_tp *value, void *context) {
+    replay_t *replay = (replay_t *) context;
+
+    return replay->in_scalars ? cif_writer_item(replay->writer, name, value) : CIF_TRAVERSE_CONTINUE;
+}
+
+/*
+ * Writes the specified CIF to the specified sink data via an incremental writer, by walking it.  Returns the result
+ * of closing the writer, or of the walk if that fails first.
+ */
+static int replay_cif(cif_tp *cif, struct cif_write_opts_s *options, sink_data_t *sink_data) {
+    /* the writer ends data blocks implicitly */
+    cif_handler_tp handler = { NULL, NULL, replay_block_start, NULL, replay_frame_start, replay_frame_end,
+            replay_loop_start, replay_loop_end, replay_packet_start, NULL, replay_item };
+    replay_t replay;
+    int result;
+    int close_result;
+
+    replay.names = NULL;
+    replay.in_scalars = 0;
+    result = cif_writer_open(collect, sink_data, options, &replay.writer);
+    if (result == CIF_OK) {
+        result = cif_walk(cif, &handler, &replay);
+        replay_loop_end(NULL, &replay);
+        close_result = cif_writer_close(replay.writer);
+        if (result == CIF_OK) {
+            result = close_result;
+        }
+    }
+
+    return result;
+}
+
+int main(void) {
+    char test_name[80] = "test_writer";
+    cif_tp *cif = NULL;
+    cif_block_tp *block = NULL;
+    cif_frame_tp *frame = NULL;
+    cif_loop_tp *loop = NULL;
+    cif_packet_tp *packet = NULL;
+    cif_value_tp *value = NULL;
+    cif_value_tp *number = NULL;
+    cif_value_tp *list = NULL;
+    cif_value_tp *values[3];
+    cif_writer_tp *writer = NULL;
+    struct cif_write_opts_s *options = NULL;
+    sink_data_t expected;
+    sink_data_t actual;
+    UChar buffer[BUFFER_SIZE];
+    UChar name_title[] = { '_', 't', 'i', 't', 'l', 'e', 0 };
+    UChar name_list[] = { '_', 'l', 'i', 's', 't', 0 };
+    UChar name_n[] = { '_', 'l', '.', 'n', 0 };
+    UChar name_t[] = { '_', 'l', '.', 't', 0 };
+    UChar bad_name[] = { 'n', 'o', '_', 'u', 'n', 'd', 'e', 'r', 's', 'c', 'o', 'r', 'e', 0 };
+    UChar bad_code[] = { 'a', ' ', 'b', 0 };
+    UChar value_text[] = { 'a', 'n', 'g', 's', 't', 'r', 0xc5, 'm', 0 };
+    const UChar *names[3];
+    const UChar *no_names[1];
+    int version;
+    int i;
+
+    TESTHEADER(test_name);
+    CREATE_CIF(test_name, cif);
+    TEST(cif_value_create(CIF_UNK_KIND, &value), CIF_OK, test_name, 1);
+    TEST(cif_value_copy_char(value, TO_UNICODE("some text, 'quoted'", buffer, BUFFER_SIZE)), CIF_OK, test_name, 2);
+    names[0] = name_n;
+    names[1] = name_t;
+    names[2] = NULL;
+    no_names[0] = NULL;
+
+    /* a block with scalars of several kinds, nested save frames, and a loop */
+    TEST(cif_create_block(cif, TO_UNICODE("first", buffer, BUFFER_SIZE), &block), CIF_OK, test_name, 3);
+    TEST(cif_container_set_value(block, name_title, value), CIF_OK, test_name, 4);
+    TEST(cif_value_create(CIF_LIST_KIND, &list), CIF_OK, test_name, 5);
+    TEST(cif_value_insert_element_at(list, 0, value), CIF_OK, test_name, 6);
+    TEST(cif_container_set_value(block, name_list, list), CIF_OK, test_name, 7);
+    cif_value_free(list);
+    TEST(cif_container_create_frame(block, TO_UNICODE("outer", buffer, BUFFER_SIZE), &frame), CIF_OK,
+            test_name, 8);
+    TEST(cif_container_set_value(frame, name_title, value), CIF_OK, test_name, 9);
+    TEST(cif_container_create_frame(frame, TO_UNICODE("inner", buffer, BUFFER_SIZE), NULL), CIF_OK,
+            test_name, 10);
+    cif_frame_free(frame);
+    TEST(cif_container_create_loop(block, NULL, (UChar **) names, &loop), CIF_OK, test_name, 11);
+    TEST(cif_packet_create(&packet, (UChar **) names), CIF_OK, test_name, 12);
+    TEST(cif_packet_set_item(packet, name_t, value), CIF_OK, test_name, 13);
+    TEST(cif_packet_get_item(packet, name_n, &number), CIF_OK, test_name, 14);
+    for (i = 0; i < NUM_PACKETS; i += 1) {
+        TEST(cif_value_init_numb(number, i, 0.5, 1, 5), CIF_OK, test_name, 15);
+        TEST(cif_loop_add_packet(loop, packet), CIF_OK, test_name, 16);
+    }
+    cif_packet_free(packet);
+    cif_loop_free(loop);
+    cif_block_free(block);
+
+    /* an empty block, and another with only a loop */
+    TEST(cif_create_block(cif, TO_UNICODE("empty", buffer, BUFFER_SIZE), NULL), CIF_OK, test_name, 17);
+    TEST(cif_create_block(cif, TO_UNICODE("last", buffer, BUFFER_SIZE), &block), CIF_OK, test_name, 18);
+    TEST(cif_container_create_loop(block, NULL, (UChar **) names, &loop), CIF_OK, test_name, 19);
+    TEST(cif_packet_create(&packet, (UChar **) names), CIF_OK, test_name, 20);
+    TEST(cif_loop_add_packet(loop, packet), CIF_OK, test_name, 21);
+    cif_packet_free(packet);
+    cif_loop_free(loop);
+    cif_block_free(block);
+
+    /* the incremental writer reproduces the stored CIF's output, in both CIF versions */
+    TEST(cif_write_options_create(&options), CIF_OK, test_name, 22);
+    for (version = 2; version > 0; version -= 1) {
+        int subtest = 30 + 10 * (2 - version);
+
+        if (version == 1) {
+            /* CIF 1.1 has no lists */
+            TEST(cif_get_block(cif, TO_UNICODE("first", buffer, BUFFER_SIZE), &block), CIF_OK, test_name, subtest + 4);
+            TEST(cif_container_remove_item(block, name_list), CIF_OK, test_name, subtest + 5);
+            cif_block_free(block);
+        }
+        options->cif_version = version;
+        memset(&expected, 0, sizeof(expected));
+        memset(&actual, 0, sizeof(actual));
+        TEST(cif_write_to_sink(collect, &expected, options, cif), CIF_OK, test_name, subtest);
+        TEST(replay_cif(cif, options, &actual), CIF_OK, test_name, subtest + 1);
+        TEST(actual.length != expected.length, 0, test_name, subtest + 2);
+        TEST(memcmp(actual.data, expected.data, actual.length), 0, test_name, subtest + 3);
+        free(actual.data);
+        free(expected.data);
+    }
+
+    /* misuse and invalid arguments are rejected without effect */
+    memset(&actual, 0, sizeof(actual));
+    TEST(cif_writer_open(NULL, &actual, NULL, &writer), CIF_ARGUMENT_ERROR, test_name, 50);
+    TEST(cif_writer_open(collect, &actual, NULL, NULL), CIF_ARGUMENT_ERROR, test_name, 51);
+    TEST(cif_writer_open(collect, &actual, NULL, &writer), CIF_OK, test_name, 52);
+    TEST(cif_writer_item(writer, name_title, value), CIF_MISUSE, test_name, 53);
+    TEST(cif_writer_begin_frame(writer, TO_UNICODE("f", buffer, BUFFER_SIZE)), CIF_MISUSE, test_name, 54);
+    TEST(cif_writer_begin_loop(writer, names), CIF_MISUSE, test_name, 55);
+    TEST(cif_writer_begin_block(writer, bad_code), CIF_INVALID_BLOCKCODE, test_name, 56);
+    TEST(cif_writer_begin_block(writer, TO_UNICODE("b", buffer, BUFFER_SIZE)), CIF_OK, test_name, 57);
+    TEST(cif_writer_end_frame(writer), CIF_MISUSE, test_name, 58);
+    TEST(cif_writer_begin_frame(writer, bad_code), CIF_INVALID_FRAMECODE, test_name, 59);
+    TEST(cif_writer_item(writer, bad_name, value), CIF_INVALID_ITEMNAME, test_name, 60);
+    TEST(cif_writer_item(writer, name_title, NULL), CIF_ARGUMENT_ERROR, test_name, 61);
+    TEST(cif_writer_packet(writer, values), CIF_MISUSE, test_name, 62);
+    TEST(cif_writer_begin_loop(writer, no_names), CIF_NULL_LOOP, test_name, 63);
+    TEST(cif_writer_begin_loop(writer, names), CIF_OK, test_name, 64);
+    values[0] = value;
+    values[1] = NULL;
+    TEST(cif_writer_packet(writer, values), CIF_ARGUMENT_ERROR, test_name, 65);
+    values[1] = value;
+    TEST(cif_writer_packet(writer, values), CIF_OK, test_name, 66);
+    TEST(cif_writer_close(writer), CIF_OK, test_name, 67);
+    TEST(actual.length == 0, 0, test_name, 68);
+    free(actual.data);
+
+    /*
+     * A value that CIF 1.1 cannot represent puts the writer into an error state, but the output up to that point is
+     * still delivered when the writer is closed
+     */
+    options->cif_version = 1;
+    memset(&actual, 0, sizeof(actual));
+    TEST(cif_writer_open(collect, &actual, options, &writer), CIF_OK, test_name, 70);
+    TEST(cif_writer_begin_block(writer, TO_UNICODE("b", buffer, BUFFER_SIZE)), CIF_OK, test_name, 71);
+    TEST(cif_writer_item(writer, name_title, value), CIF_OK, test_name, 72);
+    TEST(cif_value_copy_char(value, value_text), CIF_OK, test_name, 73);
+    TEST(cif_writer_item(writer, name_list, value), CIF_DISALLOWED_CHAR, test_name, 74);
+    TEST(cif_writer_begin_block(writer, TO_UNICODE("c", buffer, BUFFER_SIZE)), CIF_DISALLOWED_CHAR, test_name, 75);
+    TEST(cif_writer_close(writer), CIF_DISALLOWED_CHAR, test_name, 76);
+    TEST(actual.length == 0, 0, test_name, 77);
+    TEST(collect(&actual, "", 1), 0, test_name, 78);
+    TEST(strstr(actual.data, "_title") == NULL, 0, test_name, 79);
+    free(actual.data);
+
+    free(options);
+    cif_value_free(value);
+    DESTROY_CIF(test_name, cif);
+
+    return 0;
+}
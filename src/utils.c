@@ -27,6 +27,10 @@
 #include "internal/compat.h"
 
 #include <stdlib.h>
+#include <string.h>
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
 #include <unicode/ustring.h>
 #include <unicode/uchar.h>
 #include <unicode/unorm.h>
@@ -38,6 +42,19 @@
 #define MAX_LOW_SURROGATE 0xdfff
 #define HIGH_SURROGATE_OFFSET 10
 
+/* the number of entries in each thread's name normalization cache; must be a power of two */
+#define NORMALIZATION_CACHE_SIZE 256
+/* the maximum length, in UChars, of names whose normalized forms are cached */
+#define NORMALIZATION_CACHE_MAX_LENGTH 128
+
+/*
+ * The cache needs thread-specific storage, and a destructor function to release that storage and its key when the
+ * library is unloaded.
+ */
+#if defined(HAVE_PTHREADS) && defined(__GNUC__)
+#define HAVE_NORMALIZATION_CACHE
+#endif
+
 #ifdef DEBUG
 UFILE *ustderr = NULL;
 #define INIT_USTDERR do { if (ustderr == NULL) ustderr = u_finit(stderr, NULL, NULL); } while(0)
@@ -130,6 +147,77 @@ static int cif_unicode_normalize(const UChar *src, int32_t srclen, UNormalizatio
  */
 static int cif_fold_case(const UChar *src, int32_t srclen, UChar **result, int32_t *result_length);
 
+/*
+ * Performs the full case-folding normalization documented for cif_normalize(), via ICU, without reference to any
+ * cache.  Arguments and return value are as for cif_normalize().
+ */
+static int cif_normalize_full(const UChar *src, int32_t srclen, UChar **normalized);
+
+/*
+ * Determines whether the (initial segment of the) specified string consists entirely of ASCII characters
+ *
+ * src: the Unicode string to test; assumed non-NULL
+ * srclen: the number of characters to test; if less than zero then the whole string is tested up to the terminating
+ *     NUL character
+ *
+ * Returns the number of characters tested if all are ASCII, or -1 if any is not
+ */
+static int32_t cif_ascii_length(const UChar *src, int32_t srclen);
+
+/*
+ * Normalizes the specified all-ASCII string, which requires only that upper case letters be converted to lower case.
+ * Arguments and return value are as for cif_normalize(), except that the length is exact.
+ */
+static int cif_normalize_ascii(const UChar *src, int32_t length, UChar **normalized);
+
+/*
+ * Normalizes the specified string as cif_normalize_full() does, but memoizes the results in a per-thread cache of
+ * recently-normalized strings (when threads are supported).  Arguments and return value are as for cif_normalize().
+ */
+static int cif_normalize_cached(const UChar *src, int32_t srclen, UChar **normalized);
+
+/*
+ * Determines whether the specified data name pattern matches the data name of the specified length, ignoring the
+ * case of ASCII letters.  Returns non-zero if so, or zero if not.
+ */
+static int cif_matches_pattern(const char *pattern, const UChar *name, int32_t length);
+
+/*
+ * Statistics about a string gathered by cif_scan_string(), from which cif_choose_delimiter() chooses delimiters for
+ * presenting it.  The line lengths and counts have the significance of the corresponding members of
+ * struct cif_string_analysis_s.
+ */
+struct string_stats_s {
+    /* the number of appearances of each Basic Latin character; the last element also counts all others */
+    int32_t char_counts[128];
+    int32_t length;
+    int32_t num_lines;
+    int32_t first_line;
+    int32_t last_line;
+    int32_t max_line;
+    int32_t most_semis;
+    int has_nl_semi;
+    int has_trailing_ws;
+};
+
+/*
+ * Gathers the statistics about the specified NUL-terminated string that are needed for choosing its delimiters, in
+ * one pass over it.
+ */
+static void cif_scan_string(const UChar *str, struct string_stats_s *stats);
+
+/*
+ * Fills in the specified analysis of the specified string, as cif_analyze_string() does, from the specified
+ * statistics previously gathered about it by cif_scan_string()
+ */
+static void cif_choose_delimiter(const UChar *str, const struct string_stats_s *stats, int allow_unquoted,
+        int allow_triple_quoted, int32_t length_limit, struct cif_string_analysis_s *result);
+
+/*
+ * Returns the TEXT_DELIM_* code for the delimiter recommended by the specified analysis
+ */
+static int cif_delimiter_code(const struct cif_string_analysis_s *analysis);
+
 static int cif_has_disallowed_chars(const UChar *str) {
     const UChar *c;
 
@@ -180,11 +268,7 @@ static int cif_is_valid_name(const UChar *name, int for_item) {
             && (cif_has_disallowed_chars(name) == 0)) ? 1 : 0;
 }
 
-#ifdef __cplusplus
-extern "C" {
-#endif
-
-int cif_normalize(const UChar *src, int32_t srclen, UChar **normalized) {
+static int cif_normalize_full(const UChar *src, int32_t srclen, UChar **normalized) {
     FAILURE_HANDLING;
     int32_t result_length;
     UChar *buf;
@@ -232,6 +316,196 @@ int cif_normalize(const UChar *src, int32_t srclen, UChar **normalized) {
     FAILURE_TERMINUS;
 }
 
+static int32_t cif_ascii_length(const UChar *src, int32_t srclen) {
+    int32_t length;
+
+    if (srclen < 0) {
+        for (length = 0; src[length] != 0; length++) {
+            if (src[length] > 0x7f) return -1;
+        }
+    } else {
+        for (length = 0; length < srclen; length++) {
+            if (src[length] > 0x7f) return -1;
+        }
+    }
+
+    return length;
+}
+
+static int cif_normalize_ascii(const UChar *src, int32_t length, UChar **normalized) {
+    if (normalized) {
+        UChar *buf = (UChar *) malloc(((size_t) length + 1) * sizeof(UChar));
+        int32_t index;
+
+        if (buf == NULL) {
+            return CIF_MEMORY_ERROR;
+        }
+        for (index = 0; index < length; index++) {
+            buf[index] = (((src[index] >= 0x41) && (src[index] <= 0x5a)) ? (src[index] + 0x20) : src[index]);
+        }
+        buf[length] = 0;
+        *normalized = buf;
+    }
+
+    return CIF_OK;
+}
+
+#ifdef HAVE_NORMALIZATION_CACHE
+
+/*
+ * An entry in a normalization cache.  The original string and its normalized form share a single allocation, with the
+ * normalized form following the original's NUL terminator.
+ */
+struct norm_cache_entry_s {
+    UChar *original;
+    int32_t original_length;
+    UChar *normalized;
+    int32_t normalized_length;
+};
+
+static pthread_key_t norm_cache_key;
+static pthread_once_t norm_cache_once = PTHREAD_ONCE_INIT;
+static int norm_cache_available = 0;
+
+static void norm_cache_free(void *cache) {
+    struct norm_cache_entry_s *entries = (struct norm_cache_entry_s *) cache;
+    int index;
+
+    for (index = 0; index < NORMALIZATION_CACHE_SIZE; index++) {
+        free(entries[index].original);
+    }
+    free(entries);
+}
+
+static void norm_cache_init(void) {
+    norm_cache_available = (pthread_key_create(&norm_cache_key, norm_cache_free) == 0);
+}
+
+/*
+ * Returns the calling thread's normalization cache, creating it if necessary, or NULL if no cache is available
+ */
+static struct norm_cache_entry_s *norm_cache_get(void) {
+    struct norm_cache_entry_s *cache;
+
+    if ((pthread_once(&norm_cache_once, norm_cache_init) != 0) || !norm_cache_available) {
+        return NULL;
+    }
+
+    cache = (struct norm_cache_entry_s *) pthread_getspecific(norm_cache_key);
+    if (cache == NULL) {
+        cache = (struct norm_cache_entry_s *) calloc(NORMALIZATION_CACHE_SIZE, sizeof(struct norm_cache_entry_s));
+        if ((cache != NULL) && (pthread_setspecific(norm_cache_key, cache) != 0)) {
+            free(cache);
+            cache = NULL;
+        }
+    }
+
+    return cache;
+}
+
+static void norm_cache_shutdown(void) __attribute__ ((__destructor__));
+
+/*
+ * Runs when the library is unloaded or the program exits.  Frees the calling thread's cache, which for the main
+ * thread would otherwise never be freed, and deletes the key, so that no thread exiting afterward calls
+ * norm_cache_free() in a library that may no longer be mapped.  Caches of other threads still running at that point
+ * are abandoned.
+ */
+static void norm_cache_shutdown(void) {
+    if (norm_cache_available) {
+        struct norm_cache_entry_s *cache = (struct norm_cache_entry_s *) pthread_getspecific(norm_cache_key);
+
+        norm_cache_available = 0;
+        if (cache != NULL) {
+            pthread_setspecific(norm_cache_key, NULL);
+            norm_cache_free(cache);
+        }
+        pthread_key_delete(norm_cache_key);
+    }
+}
+
+#endif
+
+static int cif_normalize_cached(const UChar *src, int32_t srclen, UChar **normalized) {
+#ifdef HAVE_NORMALIZATION_CACHE
+    struct norm_cache_entry_s *cache = norm_cache_get();
+    int32_t length = ((srclen < 0) ? u_strlen(src) : srclen);
+
+    if ((cache != NULL) && (length <= NORMALIZATION_CACHE_MAX_LENGTH)) {
+        struct norm_cache_entry_s *entry;
+        unsigned long hash = 2166136261UL;
+        int32_t index;
+        UChar *buf;
+        int result;
+
+        /* FNV-1a over the code units */
+        for (index = 0; index < length; index++) {
+            hash = ((hash ^ (unsigned long) src[index]) * 16777619UL) & 0xffffffffUL;
+        }
+        entry = cache + (hash & (NORMALIZATION_CACHE_SIZE - 1));
+
+        if ((entry->original != NULL) && (entry->original_length == length)
+                && (memcmp(entry->original, src, (size_t) length * sizeof(UChar)) == 0)) {
+            /* cache hit */
+            if (normalized) {
+                size_t size = ((size_t) entry->normalized_length + 1) * sizeof(UChar);
+
+                if ((buf = (UChar *) malloc(size)) == NULL) {
+                    return CIF_MEMORY_ERROR;
+                }
+                *normalized = (UChar *) memcpy(buf, entry->normalized, size);
+            }
+
+            return CIF_OK;
+        }
+
+        /* cache miss */
+        if ((result = cif_normalize_full(src, length, &buf)) == CIF_OK) {
+            int32_t normalized_length = u_strlen(buf);
+            UChar *text = (UChar *) malloc(((size_t) length + normalized_length + 2) * sizeof(UChar));
+
+            if (text != NULL) {
+                free(entry->original);
+                memcpy(text, src, (size_t) length * sizeof(UChar));
+                text[length] = 0;
+                memcpy(text + length + 1, buf, ((size_t) normalized_length + 1) * sizeof(UChar));
+                entry->original = text;
+                entry->original_length = length;
+                entry->normalized = text + length + 1;
+                entry->normalized_length = normalized_length;
+            }  /* else the result simply is not cached */
+
+            if (normalized) {
+                *normalized = buf;
+            } else {
+                free(buf);
+            }
+        }
+
+        return result;
+    }
+#endif
+
+    return cif_normalize_full(src, srclen, normalized);
+}
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int cif_normalize(const UChar *src, int32_t srclen, UChar **normalized) {
+    int32_t ascii_length;
+
+    if (src == NULL) {
+        return cif_normalize_full(src, srclen, normalized);
+    } else if ((ascii_length = cif_ascii_length(src, srclen)) >= 0) {
+        /* all ASCII: normalization reduces to mapping upper case letters to lower case */
+        return cif_normalize_ascii(src, ascii_length, normalized);
+    } else {
+        return cif_normalize_cached(src, srclen, normalized);
+    }
+}
+
 
 UChar *cif_u_strdup(const UChar *src) {
     if (src) {
@@ -305,11 +579,24 @@ int cif_normalize_item_name(const UChar *name, int32_t namelen, UChar **normaliz
 
 int cif_normalize_table_index(const UChar *name, int32_t namelen, UChar **normalized_name, int invalidityCode) {
     if ((name != NULL) && (cif_has_disallowed_chars(name) == 0)) {
+        int32_t ascii_length = cif_ascii_length(name, namelen);
         int32_t dummy;
         UChar *buf;
         int result;
 
-        if ((result = cif_unicode_normalize(name, namelen, UNORM_NFC, &buf, &dummy, 1)) == CIF_OK) {
+        if (ascii_length >= 0) {
+            /* ASCII strings are invariant under NFC normalization */
+            if (normalized_name) {
+                if ((buf = (UChar *) malloc(((size_t) ascii_length + 1) * sizeof(UChar))) == NULL) {
+                    return CIF_MEMORY_ERROR;
+                }
+                memcpy(buf, name, (size_t) ascii_length * sizeof(UChar));
+                buf[ascii_length] = 0;
+                *normalized_name = buf;
+            }
+
+            return CIF_OK;
+        } else if ((result = cif_unicode_normalize(name, namelen, UNORM_NFC, &buf, &dummy, 1)) == CIF_OK) {
             if (normalized_name) {
                 *normalized_name = buf;
             } else {
@@ -323,6 +610,121 @@ int cif_normalize_table_index(const UChar *name, int32_t namelen, UChar **normal
     }
 }
 
+int cif_utf8_to_ustr_internal(const char *src, int32_t srclen, UChar **ustr, int invalidityCode) {
+    int32_t eff_srclen = ((srclen < 0) ? (int32_t) strlen(src) : srclen);
+    /* a UTF-8 string never requires more UTF-16 code units than it has bytes */
+    UChar *buf = (UChar *) malloc(((size_t) eff_srclen + 1) * sizeof(UChar));
+    UErrorCode error = U_ZERO_ERROR;
+    int32_t length;
+
+    if (buf == NULL) {
+        return CIF_MEMORY_ERROR;
+    }
+    (void) u_strFromUTF8(buf, eff_srclen + 1, &length, src, eff_srclen, &error);
+    if (U_FAILURE(error)) {
+        free(buf);
+        return ((error == U_INVALID_CHAR_FOUND) ? invalidityCode : CIF_ERROR);
+    }
+    *ustr = buf;
+
+    return CIF_OK;
+}
+
+int cif_ustr_to_utf8_internal(const UChar *src, int32_t srclen, char **utf8) {
+    int32_t eff_srclen = ((srclen < 0) ? u_strlen(src) : srclen);
+    /* no UTF-16 code unit requires more than three UTF-8 bytes */
+    int32_t capacity = 3 * eff_srclen + 1;
+    char *buf = (char *) malloc((size_t) capacity);
+    UErrorCode error = U_ZERO_ERROR;
+    int32_t length;
+
+    if (buf == NULL) {
+        return CIF_MEMORY_ERROR;
+    }
+    (void) u_strToUTF8(buf, capacity, &length, src, eff_srclen, &error);
+    if (U_FAILURE(error)) {
+        free(buf);
+        return ((error == U_INVALID_CHAR_FOUND) ? CIF_INVALID_CHAR : CIF_ERROR);
+    } else if (length + 1 < capacity) {
+        /* reallocate to the (usually smaller) size of the actual result; on failure the original remains valid */
+        char *shrunk = (char *) realloc(buf, (size_t) length + 1);
+
+        if (shrunk != NULL) {
+            buf = shrunk;
+        }
+    }
+    *utf8 = buf;
+
+    return CIF_OK;
+}
+
+int cif_normalize_utf8_internal(const char *name, int validation, char **normalized_name, int invalidityCode) {
+    size_t length;
+
+    if (name == NULL) {
+        return invalidityCode;
+    }
+
+    /* scan for non-ASCII bytes */
+    for (length = 0; name[length] != 0; length++) {
+        if ((unsigned char) name[length] > 0x7f) break;
+    }
+
+    if (name[length] == 0) {
+        /* all ASCII: validate directly, and normalize by mapping upper case letters to lower case */
+        char *buf;
+        size_t index;
+
+        if (validation != UTF8_NO_VALIDATION) {
+            if ((length == 0)
+                    || ((validation == UTF8_VALIDATE_ITEM) && ((name[0] != '_') || (length < 2)))
+                    || (length > (size_t) CIF_LINE_LENGTH - ((validation == UTF8_VALIDATE_ITEM) ? 0 : 5))) {
+                return invalidityCode;
+            }
+            for (index = 0; index < length; index++) {
+                /* whitespace, controls, and DEL are not allowed in names */
+                if ((name[index] <= 0x20) || (name[index] == 0x7f)) return invalidityCode;
+            }
+        }
+        if ((buf = (char *) malloc(length + 1)) == NULL) {
+            return CIF_MEMORY_ERROR;
+        }
+        for (index = 0; index < length; index++) {
+            buf[index] = (((name[index] >= 0x41) && (name[index] <= 0x5a)) ? (name[index] + 0x20) : name[index]);
+        }
+        buf[length] = 0;
+        *normalized_name = buf;
+
+        return CIF_OK;
+    } else {
+        /* general case: normalize in UTF-16 form */
+        UChar *uname;
+        UChar *unormalized;
+        int result = cif_utf8_to_ustr_internal(name, -1, &uname, invalidityCode);
+
+        if (result == CIF_OK) {
+            switch (validation) {
+                case UTF8_VALIDATE_NAME:
+                    result = cif_normalize_name(uname, -1, &unormalized, invalidityCode);
+                    break;
+                case UTF8_VALIDATE_ITEM:
+                    result = cif_normalize_item_name(uname, -1, &unormalized, invalidityCode);
+                    break;
+                default:
+                    result = cif_normalize(uname, -1, &unormalized);
+                    break;
+            }
+            free(uname);
+            if (result == CIF_OK) {
+                result = cif_ustr_to_utf8_internal(unormalized, -1, normalized_name);
+                free(unormalized);
+            }
+        }
+
+        return result;
+    }
+}
+
 int cif_is_reserved_string(const UChar *str) {
 #define UCHAR_A 0x41
 #define UCHAR_a 0x61
@@ -407,6 +809,119 @@ int cif_is_reserved_string(const UChar *str) {
 
 int cif_analyze_string(const UChar *str, int allow_unquoted, int allow_triple_quoted, int32_t length_limit,
         struct cif_string_analysis_s *result) {
+    struct string_stats_s stats;
+
+    cif_scan_string(str, &stats);
+    cif_choose_delimiter(str, &stats, allow_unquoted, allow_triple_quoted, length_limit, result);
+
+    return CIF_OK;
+}
+
+int cif_text_class_internal(const UChar *text) {
+    /* the characters of the Basic Latin block that are disallowed in CIF 1.1; 127 counts all others, too */
+    static const UChar cif11_disallowed[] = {
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x0b, 0x0c, 0x0e, 0x0f,
+        0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f,
+        0x7f
+    };
+    struct string_stats_s stats;
+    struct cif_string_analysis_s analysis;
+    int text_class = TEXT_CLASS_KNOWN | TEXT_CLASS_CIF11;
+    unsigned index;
+
+    cif_scan_string(text, &stats);
+    for (index = 0; index < ARRAY_LENGTH(cif11_disallowed); index += 1) {
+        if (stats.char_counts[cif11_disallowed[index]] != 0) {
+            text_class &= ~TEXT_CLASS_CIF11;
+            break;
+        }
+    }
+
+    cif_choose_delimiter(text, &stats, CIF_TRUE, CIF_TRUE, CIF_LINE_LENGTH, &analysis);
+    if (analysis.delim_length == 0) {
+        text_class |= TEXT_CLASS_BARE;
+        cif_choose_delimiter(text, &stats, CIF_FALSE, CIF_TRUE, CIF_LINE_LENGTH, &analysis);
+    }
+    text_class |= (cif_delimiter_code(&analysis) << TEXT_CLASS_CIF2_SHIFT);
+
+    /* CIF 1.1 offers a subset of the CIF 2.0 alternatives, in the same order of preference */
+    cif_choose_delimiter(text, &stats, CIF_FALSE, CIF_FALSE, CIF_LINE_LENGTH, &analysis);
+    text_class |= (cif_delimiter_code(&analysis) << TEXT_CLASS_CIF1_SHIFT);
+    if (analysis.delim_length == 2) {
+        if (ANALYSIS_NEEDS_FOLDING(analysis, CIF_LINE_LENGTH)) {
+            text_class |= TEXT_CLASS_FOLD;
+        }
+        if (analysis.contains_text_delim) {
+            text_class |= TEXT_CLASS_TEXT_DELIM;
+        }
+    }
+
+    return text_class;
+}
+
+int cif_name_selected_internal(const char **include_names, const char **exclude_names, const UChar *name,
+        int32_t length) {
+    const char **pattern;
+
+    if (length < 0) {
+        length = u_strlen(name);
+    }
+
+    if (include_names != NULL) {
+        for (pattern = include_names; *pattern != NULL; pattern += 1) {
+            if (cif_matches_pattern(*pattern, name, length)) {
+                break;
+            }
+        }
+        if (*pattern == NULL) {
+            /* no include pattern matched */
+            return CIF_FALSE;
+        }
+    }
+
+    if (exclude_names != NULL) {
+        for (pattern = exclude_names; *pattern != NULL; pattern += 1) {
+            if (cif_matches_pattern(*pattern, name, length)) {
+                return CIF_FALSE;
+            }
+        }
+    }
+
+    return CIF_TRUE;
+}
+
+static int cif_matches_pattern(const char *pattern, const UChar *name, int32_t length) {
+    int32_t index;
+
+    for (index = 0; pattern[index] != '\0'; index += 1) {
+        int pc = (unsigned char) pattern[index];
+        int nc;
+
+        if ((pc == '*') && (pattern[index + 1] == '\0')) {
+            /* a trailing wildcard matches all remaining characters, if any */
+            return CIF_TRUE;
+        } else if (index >= length) {
+            return CIF_FALSE;
+        }
+
+        /* fold ASCII letters to lowercase; data names are case-insensitive */
+        nc = name[index];
+        if ((pc >= 'A') && (pc <= 'Z')) {
+            pc += ('a' - 'A');
+        }
+        if ((nc >= 'A') && (nc <= 'Z')) {
+            nc += ('a' - 'A');
+        }
+        if (pc != nc) {
+            return CIF_FALSE;
+        }
+    }
+
+    /* the whole pattern matched; it must match the whole name, or else be a category of names */
+    return ((index == length) || (name[index] == '.'));
+}
+
+static void cif_scan_string(const UChar *str, struct string_stats_s *stats) {
 
 #define REMEMBER_SEMIS do { if (consec_semis > most_semis) most_semis = consec_semis; } while(0)
 #define TRACK_TRAILING_WS do { \
@@ -415,14 +930,8 @@ int cif_analyze_string(const UChar *str, int allow_unquoted, int allow_triple_qu
             || (str[length - 1] == UCHAR_VT)))); \
 } while (0)
 
-    static const UChar apos_delim[] = { UCHAR_SQ, 0 };
-    static const UChar quot_delim[] = { UCHAR_DQ, 0 };
-    static const UChar apos3_delim[] = { UCHAR_SQ, UCHAR_SQ, UCHAR_SQ, 0 };
-    static const UChar quot3_delim[] = { UCHAR_DQ, UCHAR_DQ, UCHAR_DQ, 0 };
-    static const UChar text_delim[] = { UCHAR_NL, UCHAR_SEMI, 0 };
-
     /* uses signed 32-bit integer character counters -- sufficient for very (very!) long values */
-    int32_t char_counts[128] = { 0 };
+    int32_t *char_counts = stats->char_counts;
     int32_t first_line = 0;
     int32_t this_line = 0;
     int32_t max_line = 0;
@@ -435,7 +944,7 @@ int cif_analyze_string(const UChar *str, int allow_unquoted, int allow_triple_qu
     int32_t num_lines;
     UChar ch;
 
-    result->has_reserved_start = CIF_FALSE;
+    memset(char_counts, 0, sizeof(stats->char_counts));
 
     /* Analyze the text to inform the choice of delimiters */
     for (ch = str[0]; ch; ch = str[++length]) {
@@ -483,11 +992,40 @@ int cif_analyze_string(const UChar *str, int allow_unquoted, int allow_triple_qu
         max_line = this_line;
     }
 
+    stats->length = length;
+    stats->num_lines = num_lines;
+    stats->first_line = first_line;
+    stats->last_line = this_line;
+    stats->max_line = max_line;
+    stats->most_semis = most_semis;
+    stats->has_nl_semi = has_nl_semi;
+    stats->has_trailing_ws = has_trailing_ws;
+
+#undef TRACK_TRAILING_WS
+#undef REMEMBER_SEMIS
+}
+
+static void cif_choose_delimiter(const UChar *str, const struct string_stats_s *stats, int allow_unquoted,
+        int allow_triple_quoted, int32_t length_limit, struct cif_string_analysis_s *result) {
+    static const UChar apos_delim[] = { UCHAR_SQ, 0 };
+    static const UChar quot_delim[] = { UCHAR_DQ, 0 };
+    static const UChar apos3_delim[] = { UCHAR_SQ, UCHAR_SQ, UCHAR_SQ, 0 };
+    static const UChar quot3_delim[] = { UCHAR_DQ, UCHAR_DQ, UCHAR_DQ, 0 };
+    static const UChar text_delim[] = { UCHAR_NL, UCHAR_SEMI, 0 };
+
+    const int32_t *char_counts = stats->char_counts;
+    int32_t first_line = stats->first_line;
+    int32_t this_line = stats->last_line;
+    int32_t max_line = stats->max_line;
+    int32_t length = stats->length;
+
+    result->has_reserved_start = CIF_FALSE;
+
     /* If the longest line surpasses the length limit then we cannot use anything other than a text block */
     if (max_line <= length_limit) {
 
         /* If the value is contained within a single line then all options are on the table */
-        if (num_lines == 1) {
+        if (stats->num_lines == 1) {
 
             /* Maybe whitespace-delimited */
             if (allow_unquoted && (length > 0)
@@ -580,19 +1118,113 @@ int cif_analyze_string(const UChar *str, int allow_unquoted, int allow_triple_qu
     }
 
     done:
-    result->num_lines = num_lines;
+    result->num_lines = stats->num_lines;
     result->length = length;
     result->length_first = first_line;
     result->length_last = this_line;
     result->length_max = max_line;
-    result->contains_text_delim = has_nl_semi;
-    result->max_semi_run = most_semis;
-    result->has_trailing_ws = has_trailing_ws;
+    result->contains_text_delim = stats->has_nl_semi;
+    result->max_semi_run = stats->most_semis;
+    result->has_trailing_ws = stats->has_trailing_ws;
+}
 
-#undef TRACK_TRAILING_WS
-#undef REMEMBER_SEMIS
+static int cif_delimiter_code(const struct cif_string_analysis_s *analysis) {
+    switch (analysis->delim_length) {
+        case 0:
+            return TEXT_DELIM_NONE;
+        case 1:
+            return ((analysis->delim[0] == UCHAR_SQ) ? TEXT_DELIM_APOS : TEXT_DELIM_QUOT);
+        case 3:
+            return ((analysis->delim[0] == UCHAR_SQ) ? TEXT_DELIM_APOS3 : TEXT_DELIM_QUOT3);
+        default:
+            return TEXT_DELIM_TEXT_FIELD;
+    }
+}
 
-    return CIF_OK;
+/* the alignment unit for arena allocations */
+union arena_align_u {
+    void *p;
+    double d;
+    size_t s;
+};
+#define ARENA_ALIGN  (sizeof(union arena_align_u))
+#define ARENA_ROUND(n) ((((n) + ARENA_ALIGN - 1) / ARENA_ALIGN) * ARENA_ALIGN)
+
+/* the size of a chunk header, rounded to preserve alignment of the usable memory following it */
+#define ARENA_HEADER_SIZE ARENA_ROUND(sizeof(struct arena_chunk_s))
+
+/* the minimum number of usable bytes in each arena chunk */
+#define ARENA_CHUNK_SIZE 8192
+
+void *cif_arena_alloc(arena_tp *arena, size_t size) {
+    struct arena_chunk_s *chunk = arena->current;
+
+    size = ARENA_ROUND(size);
+    if ((chunk == NULL) || ((chunk->capacity - chunk->used) < size)) {
+        /* use the next retained chunk, if it is large enough, or else insert a new one before it */
+        struct arena_chunk_s *next = ((chunk == NULL) ? arena->first : chunk->next);
+
+        if ((next == NULL) || (next->capacity < size)) {
+            size_t capacity = ((size > ARENA_CHUNK_SIZE) ? size : ARENA_CHUNK_SIZE);
+            struct arena_chunk_s *new_chunk = (struct arena_chunk_s *) malloc(ARENA_HEADER_SIZE + capacity);
+
+            if (new_chunk == NULL) {
+                return NULL;
+            }
+            new_chunk->next = next;
+            new_chunk->capacity = capacity;
+            if (chunk == NULL) {
+                arena->first = new_chunk;
+            } else {
+                chunk->next = new_chunk;
+            }
+            next = new_chunk;
+        }
+
+        next->used = 0;
+        arena->current = next;
+        chunk = next;
+    }
+
+    chunk->used += size;
+    return ((char *) chunk) + ARENA_HEADER_SIZE + (chunk->used - size);
+}
+
+UChar *cif_arena_ustrndup(arena_tp *arena, const UChar *src, int32_t length) {
+    UChar *dest = (UChar *) cif_arena_alloc(arena, (length + 1) * sizeof(UChar));
+
+    if (dest != NULL) {
+        u_strncpy(dest, src, length);
+        dest[length] = 0;
+    }
+
+    return dest;
+}
+
+void cif_arena_mark(arena_tp *arena, arena_mark_tp *mark) {
+    mark->chunk = arena->current;
+    mark->used = ((arena->current == NULL) ? 0 : arena->current->used);
+}
+
+void cif_arena_release(arena_tp *arena, const arena_mark_tp *mark) {
+    /* chunks following the marked one are reset as they are reused */
+    arena->current = mark->chunk;
+    if (mark->chunk != NULL) {
+        mark->chunk->used = mark->used;
+    }
+}
+
+void cif_arena_destroy(arena_tp *arena) {
+    struct arena_chunk_s *chunk = arena->first;
+
+    while (chunk != NULL) {
+        struct arena_chunk_s *next = chunk->next;
+
+        free(chunk);
+        chunk = next;
+    }
+    arena->first = NULL;
+    arena->current = NULL;
 }
 
 #ifdef __cplusplus
@@ -57,6 +57,17 @@ int fegetround(void);
 #endif
 #endif
 
+/*
+ * The exact fast paths for conversions between doubles and decimal digit strings rely on IEEE 754 binary64 doubles
+ * whose arithmetic is performed without excess precision
+ */
+#if defined(UINT64_MAX) && (FLT_RADIX == 2) && (DBL_MANT_DIG == 53)
+#if (defined(FLT_EVAL_METHOD) && (FLT_EVAL_METHOD == 0)) \
+        || (!defined(FLT_EVAL_METHOD) && defined(__FLT_EVAL_METHOD__) && (__FLT_EVAL_METHOD__ == 0))
+#define FAST_DECIMAL_CONVERSION 1
+#endif
+#endif
+
 #include <unicode/utext.h>
 #include <unicode/utypes.h>
 #include <unicode/parseerr.h>
@@ -93,6 +104,22 @@ int fegetround(void);
  */
 #define MSP(v) ((int) floor((v == 0.0) ? 0 : log10(fabs(v))))
 
+/*
+ * The first byte of every value serialized in the versioned format.  Values serialized in the original, unversioned
+ * format begin with a machine-order cif_kind_tp, and therefore never with this byte.
+ */
+#define SERIAL_FORMAT_TAG 0xcf
+
+/* The version of the serialization format written by this library, following SERIAL_FORMAT_TAG */
+#define SERIAL_FORMAT_VERSION 2
+
+/* The serialized length of an absent (NULL) Unicode string */
+#define NO_USTRING ((uint32_t) 0xffffffffUL)
+
+/* The maximum number of elements and of body bytes of a serialized list or table */
+#define MAX_SERIALIZED_COUNT ((size_t) 0x3fffffffUL)
+#define MAX_SERIALIZED_SIZE ((size_t) 0xfffffffeUL)
+
 /**
  * @brief Serializes a NUL-terminated Unicode string to the provided buffer.
  *
@@ -258,8 +285,10 @@ int fegetround(void);
             switch(_kind) { \
                 case CIF_CHAR_KIND: \
                     v->kind = CIF_CHAR_KIND; \
+                    v->as_char.text_class = 0; \
                     /* fall through */ \
                 case CIF_NUMB_KIND: \
+                    v->as_char.shared = NULL; \
                     DESERIALIZE_USTRING(v->as_char.text, _buf, vfail); \
                     if ((_kind == CIF_NUMB_KIND) && ((_D_result = cif_value_parse_numb(v, v->as_char.text)) != CIF_OK))\
                         FAIL(vfail, _D_result); \
@@ -411,6 +440,69 @@ static int cif_table_serialize(struct table_value_s *table, write_buffer_tp *buf
 static int cif_list_deserialize(struct list_value_s *list, read_buffer_tp *buf);
 static int cif_table_deserialize(struct table_value_s *table, read_buffer_tp *buf);
 
+/*
+ * Versioned serialization, with lazy decoding of list and table elements.  Each serialized value is a "node": a
+ * one-byte kind code followed by kind-specific data.  Character and number nodes carry a one-byte quoted flag and a
+ * counted Unicode string.  List and table nodes carry an element count and an index of element offsets followed by
+ * the elements themselves, so that any one element can be located and decoded without decoding the others; tables
+ * additionally carry the order of their entries sorted by normalized key, supporting lookup by binary search.
+ */
+static int cif_value_serialize_node(cif_value_tp *value, write_buffer_tp *buf);
+static int cif_list_serialize_node(struct list_value_s *list, write_buffer_tp *buf);
+static int cif_table_serialize_node(struct table_value_s *table, write_buffer_tp *buf);
+static int cif_serialize_ustring_node(const UChar *string, write_buffer_tp *buf);
+static int cif_value_decode_node(const char *data, size_t size, struct shared_buffer_s *shared,
+        cif_value_tp *value);
+static int cif_decode_ustring_node(const char **next, const char *end, UChar **string);
+
+/*
+ * Lazy composite management.  cif_lazy_create() validates the serialized data of a list or table node (following its
+ * kind code), and either copies them or, if they reside in the specified shared buffer or are borrowed, refers to them
+ * there.
+ * cif_lazy_get_element() decodes the element at the specified serialized position if
+ * necessary, and provides a pointer to it; for tables, the element is the entry's value.  The materialize functions
+ * move a lazy composite's elements into the value's ordinary element storage, decoding any that have not already been
+ * decoded, and release the lazy composite.  On failure they leave the value unchanged.
+ */
+static int cif_lazy_create(const char *data, size_t size, cif_kind_tp kind, struct shared_buffer_s *shared,
+        struct lazy_composite_s **lazy);
+static void cif_lazy_free(struct lazy_composite_s *lazy);
+static void cif_lazy_release_data(struct lazy_composite_s *lazy);
+static int cif_lazy_get_element(struct lazy_composite_s *lazy, cif_kind_tp kind, size_t index,
+        cif_value_tp **element);
+static int cif_list_materialize(struct list_value_s *list);
+static int cif_table_materialize(struct table_value_s *table);
+
+/*
+ * Fully decodes the specified value and, recursively, all of its elements, so that any malformation of the serialized
+ * data from which it was lazily deserialized is detected
+ */
+static int cif_value_decode_all(cif_value_tp *value);
+
+/*
+ * Shared buffer management.  cif_shared_create() allocates a buffer with the specified capacity and one reference;
+ * cif_shared_release() drops one reference, freeing the buffer when none remain.  The share functions move the
+ * data of the specified value or lazy composite into a new shared buffer, unless they are already shared.
+ */
+static struct shared_buffer_s *cif_shared_create(size_t size);
+static void cif_shared_release(struct shared_buffer_s *shared);
+static int cif_char_share(struct char_value_s *char_value);
+static int cif_numb_share(struct numb_value_s *numb_value);
+static int cif_lazy_share(struct lazy_composite_s *lazy);
+
+/*
+ * (macro) Evaluates to a char pointer to the data of the specified shared buffer
+ */
+#define SHARED_DATA(shared) ((char *) ((shared) + 1))
+
+/*
+ * (macro) Evaluates to nonzero if the specified shared buffer pointer refers to a reference-counted buffer, or to zero
+ * if the data it describes are either owned outright (NULL) or borrowed (&cif_borrowed_data)
+ */
+#define IS_SHARED(shared) (((shared) != NULL) && ((shared) != &cif_borrowed_data))
+
+struct shared_buffer_s cif_borrowed_data = { 0 };
+
 /**
  * @brief produces an unsigned digit-string representation of the specified double, rounded to the specified scale
  *
@@ -448,6 +540,40 @@ static char *to_digits(double d, int scale);
  */
 static double to_double(const char *ddigits, int scale);
 
+#ifdef FAST_DECIMAL_CONVERSION
+/**
+ * @brief Computes the result of @c to_digits() exactly via fixed-width integer arithmetic, if that is possible for the
+ *         arguments.
+ *
+ * The fast path applies when @p scale is between zero and @c MAX_FAST_SCALE, inclusive, and @p d scaled by ten to
+ * the power @p scale has an integer part that fits in 128 bits.  Rounding honors the current rounding mode in the same
+ * way that @c to_digits() does.
+ *
+ * @param[in] d the non-negative double value to convert
+ * @param[in] scale as for @c to_digits()
+ * @param[in] negative nonzero if the digits are to represent the negative of @p d, which affects directed rounding
+ * @param[in,out] result a pointer to the location where the result, as @c to_digits() would return it, should be
+ *         recorded if the fast path applies; this may be NULL if memory cannot be allocated for it
+ * @return nonzero if the fast path applied and a result was recorded, else zero
+ */
+static int to_digits_fast(double d, int scale, int negative, char **result);
+
+/**
+ * @brief Computes the result of @c to_double() via a single, correctly-rounded floating-point multiplication or
+ *         division, if that is possible for the arguments.
+ *
+ * The fast path applies when the significant digits of @p ddigits form an integer no greater than two to the power
+ * @c DBL_MANT_DIG, and the remaining power of ten is exactly representable as a double.  Both operands of the
+ * final operation are then exact, so its result is the correctly-rounded value in the current rounding mode.
+ *
+ * @param[in] ddigits as for @c to_double() , but with leading zeroes removed and at least one nonzero digit
+ * @param[in] scale as for @c to_double()
+ * @param[in,out] result a pointer to the location where the result should be recorded if the fast path applies
+ * @return nonzero if the fast path applied and a result was recorded, else zero
+ */
+static int to_double_fast(const char *ddigits, int scale, double *result);
+#endif
+
 /**
  * @brief Formats the text representation of a number value, in plain decimal form
  *
@@ -468,6 +594,14 @@ static double to_double(const char *ddigits, int scale);
 static int format_text_decimal(double sign_num, char *digit_buf, char *su_buf, size_t su_size, int scale,
         UChar **result);
 
+/*
+ * The two halves of format_text_decimal(): text_decimal_length() computes the number of UChars, including the
+ * terminator, in the plain decimal text of a number, and write_text_decimal() writes that text into a buffer of at
+ * least that size.  The arguments have the same significance as format_text_decimal()'s.
+ */
+static size_t text_decimal_length(double sign_num, const char *digit_buf, size_t su_size, int scale);
+static void write_text_decimal(double sign_num, char *digit_buf, char *su_buf, int scale, UChar *text);
+
 /**
  * @brief Formats the text representation of a number value, in scientific notation
  *
@@ -507,35 +641,53 @@ static void cif_list_init(struct list_value_s *list_value) {
     list_value->elements = NULL;
     list_value->size = 0;
     list_value->capacity = 0;
+    list_value->lazy = NULL;
 }
 
 static void cif_table_init(struct table_value_s *table_value) {
     table_value->kind = CIF_TABLE_KIND;
-    table_value->map.head = NULL;
-    table_value->map.is_standalone = 1;
-    table_value->map.normalizer = cif_normalize_table_index;
+    cif_map_init_internal(&(table_value->map), CIF_TRUE, cif_normalize_table_index);
+    table_value->lazy = NULL;
 }
 
 /*
  * Frees the components of a character-type value, but not the value object itself
  */
 static void cif_char_value_clean(struct char_value_s *char_value) {
-    CLEAN_PTR(char_value->text);
+    if (char_value->shared != NULL) {
+        cif_shared_release(char_value->shared);
+        char_value->shared = NULL;
+        char_value->text = NULL;
+    } else {
+        CLEAN_PTR(char_value->text);
+    }
 }
 
 /*
  * Frees the components of a number-type value, but not the value object itself
  */
 static void cif_numb_value_clean(struct numb_value_s *numb_value) {
-    CLEAN_PTR(numb_value->text);
-    CLEAN_PTR(numb_value->digits);
-    CLEAN_PTR(numb_value->su_digits);
+    if (numb_value->shared != NULL) {
+        cif_shared_release(numb_value->shared);
+        numb_value->shared = NULL;
+        numb_value->text = NULL;
+        numb_value->digits = NULL;
+        numb_value->su_digits = NULL;
+    } else {
+        CLEAN_PTR(numb_value->text);
+        CLEAN_PTR(numb_value->digits);
+        CLEAN_PTR(numb_value->su_digits);
+    }
 }
 
 /*
  * Frees the components of a list-type value, but not the value object itself
  */
 static void cif_list_value_clean(struct list_value_s *list_value) {
+    if (list_value->lazy != NULL) {
+        cif_lazy_free(list_value->lazy);
+        list_value->lazy = NULL;
+    }
     for (; list_value->size > 0; ) {
         list_value->size -= 1;
         cif_value_free(list_value->elements[list_value->size]);
@@ -548,13 +700,11 @@ static void cif_list_value_clean(struct list_value_s *list_value) {
  * Frees the components of a table-type value, but not the value object itself
  */
 static void cif_table_value_clean(struct table_value_s *table_value) {
-    struct entry_s *entry;
-    struct entry_s *temp;
-
-    HASH_ITER(hh, table_value->map.head, entry, temp) {
-        HASH_DEL(table_value->map.head, entry);
-        cif_map_entry_free_internal(entry, &(table_value->map));
+    if (table_value->lazy != NULL) {
+        cif_lazy_free(table_value->lazy);
+        table_value->lazy = NULL;
     }
+    cif_map_clean_internal(&(table_value->map));
 }
 
 /**
@@ -573,6 +723,13 @@ static int cif_value_clone_numb(struct numb_value_s *value, struct numb_value_s
     FAILURE_HANDLING;
 
     assert(value->text != NULL);
+    if (IS_SHARED(value->shared)) {
+        /* the text and digits are immutable; share them */
+        *clone = *value;
+        value->shared->refs += 1;
+        return CIF_OK;
+    }
+    clone->shared = NULL;
     clone->text = cif_u_strdup(value->text);
     if (clone->text == NULL) {
         SET_RESULT(CIF_MEMORY_ERROR);
@@ -614,6 +771,17 @@ static int cif_value_clone_list(struct list_value_s *value, struct list_value_s
     FAILURE_HANDLING;
 
     cif_list_init(clone);
+    if (value->lazy != NULL) {
+        if (value->lazy->decoded == 0) {
+            /* no element has been exposed for modification, so the serialized form is current; copy or share it */
+            return cif_lazy_create(value->lazy->data, value->lazy->size, CIF_LIST_KIND,
+                    (IS_SHARED(value->lazy->shared) ? value->lazy->shared : NULL), &(clone->lazy));
+        } else {
+            int result = cif_list_materialize(value);
+
+            if (result != CIF_OK) return result;
+        }
+    }
     clone->elements = (cif_value_tp **) malloc(sizeof(cif_value_tp *) * value->size);
     if (clone->elements == NULL) {
         FAIL(soft, CIF_MEMORY_ERROR);
@@ -646,52 +814,64 @@ static int cif_value_clone_list(struct list_value_s *value, struct list_value_s
 static int cif_value_clone_table(struct table_value_s *value, struct table_value_s *clone) {
     FAILURE_HANDLING;
     struct table_value_s temp;
-    struct entry_s *entry;
-    struct entry_s *tmp;
+    size_t position;
 
     cif_table_init(&temp);
-    HASH_ITER(hh, value->map.head, entry, tmp) {
-        struct entry_s *new_entry = (struct entry_s *) malloc(sizeof(struct entry_s));
+    if (value->lazy != NULL) {
+        if (value->lazy->decoded == 0) {
+            /* no entry has been exposed for modification, so the serialized form is current; copy or share it */
+            if (cif_lazy_create(value->lazy->data, value->lazy->size, CIF_TABLE_KIND,
+                    (IS_SHARED(value->lazy->shared) ? value->lazy->shared : NULL), &(temp.lazy)) != CIF_OK) {
+                return CIF_MEMORY_ERROR;
+            }
+            *clone = temp;
+            return CIF_OK;
+        } else if (cif_table_materialize(value) != CIF_OK) {
+            return CIF_MEMORY_ERROR;
+        }
+    }
+    if (cif_map_reserve_internal(&(temp.map), value->map.size) != CIF_OK) {
+        SET_RESULT(CIF_MEMORY_ERROR);
+    } else {
+        for (position = 0; position < value->map.size; position += 1) {
+            struct entry_s *entry = value->map.entries + position;
+            UChar *key = cif_u_strdup(entry->key);
 
-        if (new_entry == NULL) {
-            SET_RESULT(CIF_MEMORY_ERROR);
-        } else {
-            new_entry->key = cif_u_strdup(entry->key);
-            if (new_entry->key == NULL) {
+            if (key == NULL) {
                 SET_RESULT(CIF_MEMORY_ERROR);
             } else {
-                new_entry->key_orig = cif_u_strdup(entry->key_orig);
-                if (new_entry->key_orig == NULL) {
+                UChar *key_orig = cif_u_strdup(entry->key_orig);
+
+                if (key_orig == NULL) {
                     SET_RESULT(CIF_MEMORY_ERROR);
                 } else {
-                    cif_value_tp *new_value = &(new_entry->as_value);
-
-                    new_value->kind = CIF_UNK_KIND;
-                    if (cif_value_clone(&(entry->as_value), &new_value) == CIF_OK) {
-/* All uthash fatal errors arise from memory allocation failure */
-#undef uthash_fatal
-#define uthash_fatal(msg) FAIL(hash, CIF_MEMORY_ERROR)
-                        HASH_ADD_KEYPTR(hh, temp.map.head, new_entry->key, U_BYTES(new_entry->key), new_entry);
-                        continue;
-                    }
+                    cif_value_tp *new_value = NULL;
 
-                    FAILURE_HANDLER(hash):
-                    free(new_entry->key_orig);
+                    if (cif_value_clone(entry->value, &new_value) == CIF_OK) {
+                        if (cif_map_add_internal(&(temp.map), key, key_orig, new_value, NULL) == CIF_OK) {
+                            continue;
+                        }
+                        cif_value_free(new_value);
+                    }
+                    free(key_orig);
                 }
-                free(new_entry->key);
+                free(key);
             }
-            free(new_entry);
+
+            break;
+        }
+
+        if (position >= value->map.size) {
+            /* success */
+            *clone = temp;
+
+            return CIF_OK;
         }
 
         cif_table_value_clean(&temp);
-        FAILURE_TERMINUS;
     }
 
-    /* success */
-    cif_table_init(clone);
-    clone->map.head = temp.map.head;
-
-    return CIF_OK;
+    FAILURE_TERMINUS;
 }
 
 /*
@@ -719,10 +899,9 @@ static int cif_list_serialize(struct list_value_s *list, write_buffer_tp *buf) {
 static int cif_table_serialize(struct table_value_s *table, write_buffer_tp *buf) {
     FAILURE_HANDLING;
     struct entry_s *element;
-    struct entry_s *temp;
     int flag;
 
-    HASH_ITER(hh, table->map.head, element, temp) {
+    for (element = table->map.entries; element < table->map.entries + table->map.size; element += 1) {
         int result;
 
         /* serialize a flag indicating that another entry follows */
@@ -735,7 +914,7 @@ static int cif_table_serialize(struct table_value_s *table, write_buffer_tp *buf
             /* serialize the un-normalized key, or NULL if it is the same object as the key */
             SERIALIZE_USTRING(((element->key_orig == element->key) ? NULL : element->key_orig), buf, element);
             /* serialize the value */
-            SERIALIZE(element, buf, element);
+            SERIALIZE(element->value, buf, element);
         }
     }
 
@@ -809,6 +988,7 @@ static int cif_table_deserialize(struct table_value_s *table, read_buffer_tp *bu
     UChar *key;
     UChar *key_orig;
     struct entry_s *entry;
+    cif_value_tp *value;
 
     cif_table_init(&(temp.as_table));
     for (;;) {
@@ -819,21 +999,20 @@ static int cif_table_deserialize(struct table_value_s *table, read_buffer_tp *bu
         } else {
             switch (flag) {
                 case -1:  /* no more entries */
-                    cif_table_init(table);
-                    table->map.head = temp.as_table.map.head;
+                    *table = temp.as_table;
                     return CIF_OK;
                 case 0:  /* another entry is available */
                     key = NULL;
                     DESERIALIZE_USTRING(key, buf, key);
                     key_orig = NULL;
                     DESERIALIZE_USTRING(key_orig, buf, key_orig);
-                    entry = NULL;
-                    DESERIALIZE(struct entry_s, entry, buf, value);
-                    entry->key = key;
-                    entry->key_orig = ((key_orig == NULL) ? key : key_orig);
-#undef  uthash_fatal
-#define uthash_fatal(msg) DEFAULT_FAIL(hash)
-                    HASH_ADD_KEYPTR(hh, temp.as_table.map.head, entry->key, U_BYTES(entry->key), entry);
+                    if (cif_map_add_internal(&(temp.as_table.map), key, ((key_orig == NULL) ? key : key_orig), NULL,
+                            &entry) != CIF_OK) {
+                        FAIL(value, CIF_MEMORY_ERROR);
+                    }
+                    /* the keys now belong to the map; the value is deserialized directly into the new entry */
+                    value = entry->value;
+                    DESERIALIZE(cif_value_tp, value, buf, key);
                     break;
                 default:
                     FAIL(key, CIF_INTERNAL_ERROR);
@@ -841,9 +1020,6 @@ static int cif_table_deserialize(struct table_value_s *table, read_buffer_tp *bu
         }
     }
 
-    FAILURE_HANDLER(hash):
-    cif_value_free(&(entry->as_value));
-
     FAILURE_HANDLER(value):
     free(key_orig);
 
@@ -856,15 +1032,634 @@ static int cif_table_deserialize(struct table_value_s *table, read_buffer_tp *bu
     FAILURE_TERMINUS;
 }
 
+/*
+ * Reads a 32-bit unsigned integer, in machine order, from possibly-unaligned serialized data
+ */
+static uint32_t cif_read_uint32(const char *data) {
+    uint32_t result;
+
+    memcpy(&result, data, sizeof(uint32_t));
+    return result;
+}
+
+/*
+ * Overwrites a 32-bit unsigned integer, in machine order, at the specified position in the specified write buffer,
+ * which must already contain at least that position and the following three bytes
+ */
+static void cif_patch_uint32(write_buffer_tp *buf, size_t position, uint32_t value) {
+    memcpy(buf->start + position, &value, sizeof(uint32_t));
+}
+
+/* an entry of a table's sorted-key index, as used while serializing the table */
+struct sorted_key_s {
+    const UChar *key;
+    uint32_t position;
+};
+
+/* orders sorted_key_s objects by key, in code unit order */
+static int cif_compare_sorted_keys(const void *key1, const void *key2) {
+    return u_strcmp(((const struct sorted_key_s *) key1)->key, ((const struct sorted_key_s *) key2)->key);
+}
+
+static int cif_value_serialize_node(cif_value_tp *value, write_buffer_tp *buf) {
+    unsigned char code[2];
+    int result;
+
+    code[0] = (unsigned char) value->kind;
+    switch (value->kind) {
+        case CIF_CHAR_KIND:
+        case CIF_NUMB_KIND:
+            code[1] = (unsigned char) value->as_char.quoted;
+            if ((result = cif_buf_write(buf, code, 2)) == CIF_OK) {
+                result = cif_serialize_ustring_node(value->as_char.text, buf);
+            }
+            return result;
+        case CIF_LIST_KIND:
+            if ((result = cif_buf_write(buf, code, 1)) == CIF_OK) {
+                result = cif_list_serialize_node(&(value->as_list), buf);
+            }
+            return result;
+        case CIF_TABLE_KIND:
+            if ((result = cif_buf_write(buf, code, 1)) == CIF_OK) {
+                result = cif_table_serialize_node(&(value->as_table), buf);
+            }
+            return result;
+        case CIF_NA_KIND:
+        case CIF_UNK_KIND:
+            return cif_buf_write(buf, code, 1);
+        default:
+            return CIF_ARGUMENT_ERROR;
+    }
+}
+
+static int cif_serialize_ustring_node(const UChar *string, write_buffer_tp *buf) {
+    uint32_t length = ((string == NULL) ? NO_USTRING : (uint32_t) u_strlen(string));
+    int result = cif_buf_write(buf, &length, sizeof(uint32_t));
+
+    if ((result == CIF_OK) && (string != NULL)) {
+        result = cif_buf_write(buf, string, length * sizeof(UChar));
+    }
+
+    return result;
+}
+
+static int cif_list_serialize_node(struct list_value_s *list, write_buffer_tp *buf) {
+    FAILURE_HANDLING;
+    uint32_t count;
+    size_t offsets_pos;
+    size_t body_pos;
+    size_t index;
+    int result;
+
+    if (list->lazy != NULL) {
+        if (list->lazy->decoded == 0) {
+            /* the serialized form is current */
+            return cif_buf_write(buf, list->lazy->data, list->lazy->size);
+        } else if ((result = cif_list_materialize(list)) != CIF_OK) {
+            return result;
+        }
+    }
+
+    if (list->size > MAX_SERIALIZED_COUNT) return CIF_ARGUMENT_ERROR;
+    count = (uint32_t) list->size;
+    if ((result = cif_buf_write(buf, &count, sizeof(uint32_t))) != CIF_OK) FAIL(fail, result);
+
+    /* reserve space for the element offsets, to be filled in as the elements are serialized */
+    offsets_pos = buf->position;
+    for (index = 0; index <= list->size; index += 1) {
+        if ((result = cif_buf_write(buf, &count, sizeof(uint32_t))) != CIF_OK) FAIL(fail, result);
+    }
+
+    body_pos = buf->position;
+    for (index = 0; index < list->size; index += 1) {
+        cif_patch_uint32(buf, offsets_pos + index * sizeof(uint32_t), (uint32_t) (buf->position - body_pos));
+        if ((result = cif_value_serialize_node(list->elements[index], buf)) != CIF_OK) FAIL(fail, result);
+    }
+    if (buf->position - body_pos > MAX_SERIALIZED_SIZE) FAIL(fail, CIF_ARGUMENT_ERROR);
+    cif_patch_uint32(buf, offsets_pos + index * sizeof(uint32_t), (uint32_t) (buf->position - body_pos));
+
+    return CIF_OK;
+
+    FAILURE_HANDLER(fail):
+    FAILURE_TERMINUS;
+}
+
+static int cif_table_serialize_node(struct table_value_s *table, write_buffer_tp *buf) {
+    FAILURE_HANDLING;
+    struct sorted_key_s *sorted;
+    uint32_t count;
+    size_t offsets_pos;
+    size_t body_pos;
+    size_t index;
+    int result;
+
+    if (table->lazy != NULL) {
+        if (table->lazy->decoded == 0) {
+            /* the serialized form is current */
+            return cif_buf_write(buf, table->lazy->data, table->lazy->size);
+        } else if ((result = cif_table_materialize(table)) != CIF_OK) {
+            return result;
+        }
+    }
+
+    if (table->map.size > MAX_SERIALIZED_COUNT) return CIF_ARGUMENT_ERROR;
+    count = (uint32_t) table->map.size;
+    sorted = (struct sorted_key_s *) malloc((count + 1) * sizeof(struct sorted_key_s));
+    if (sorted == NULL) return CIF_MEMORY_ERROR;
+
+    if ((result = cif_buf_write(buf, &count, sizeof(uint32_t))) != CIF_OK) FAIL(fail, result);
+
+    /* reserve space for the entry offsets, to be filled in as the entries are serialized */
+    offsets_pos = buf->position;
+    for (index = 0; index <= table->map.size; index += 1) {
+        if ((result = cif_buf_write(buf, &count, sizeof(uint32_t))) != CIF_OK) FAIL(fail, result);
+    }
+
+    /* record the positions of the entries in key order */
+    for (index = 0; index < table->map.size; index += 1) {
+        sorted[index].key = table->map.entries[index].key;
+        sorted[index].position = (uint32_t) index;
+    }
+    qsort(sorted, table->map.size, sizeof(struct sorted_key_s), cif_compare_sorted_keys);
+    for (index = 0; index < table->map.size; index += 1) {
+        if ((result = cif_buf_write(buf, &(sorted[index].position), sizeof(uint32_t))) != CIF_OK) FAIL(fail, result);
+    }
+
+    /* serialize the entries, in their original order */
+    body_pos = buf->position;
+    for (index = 0; index < table->map.size; index += 1) {
+        struct entry_s *entry = table->map.entries + index;
+
+        cif_patch_uint32(buf, offsets_pos + index * sizeof(uint32_t), (uint32_t) (buf->position - body_pos));
+        if (((result = cif_serialize_ustring_node(entry->key, buf)) != CIF_OK)
+                || ((result = cif_serialize_ustring_node(((entry->key_orig == entry->key) ? NULL : entry->key_orig),
+                        buf)) != CIF_OK)
+                || ((result = cif_value_serialize_node(entry->value, buf)) != CIF_OK)) {
+            FAIL(fail, result);
+        }
+    }
+    if (buf->position - body_pos > MAX_SERIALIZED_SIZE) FAIL(fail, CIF_ARGUMENT_ERROR);
+    cif_patch_uint32(buf, offsets_pos + index * sizeof(uint32_t), (uint32_t) (buf->position - body_pos));
+
+    free(sorted);
+    return CIF_OK;
+
+    FAILURE_HANDLER(fail):
+    free(sorted);
+    FAILURE_TERMINUS;
+}
+
+static int cif_decode_ustring_node(const char **next, const char *end, UChar **string) {
+    uint32_t length;
+
+    if ((size_t) (end - *next) < sizeof(uint32_t)) return CIF_INTERNAL_ERROR;
+    length = cif_read_uint32(*next);
+    *next += sizeof(uint32_t);
+    if (length == NO_USTRING) {
+        *string = NULL;
+    } else if (((size_t) (end - *next) / sizeof(UChar)) < length) {
+        return CIF_INTERNAL_ERROR;
+    } else {
+        UChar *result = (UChar *) malloc((length + 1) * sizeof(UChar));
+
+        if (result == NULL) return CIF_MEMORY_ERROR;
+        memcpy(result, *next, length * sizeof(UChar));
+        result[length] = 0;
+        *next += length * sizeof(UChar);
+        *string = result;
+    }
+
+    return CIF_OK;
+}
+
+static int cif_value_decode_node(const char *data, size_t size, struct shared_buffer_s *shared,
+        cif_value_tp *value) {
+    const char *end = data + size;
+    int result;
+
+    /* the value is left valid, and of unknown kind, if decoding fails */
+    value->kind = CIF_UNK_KIND;
+    if (size < 1) return CIF_INTERNAL_ERROR;
+    switch ((cif_kind_tp) *((const unsigned char *) data)) {
+        case CIF_CHAR_KIND:
+        case CIF_NUMB_KIND:
+            if (size < 2) {
+                return CIF_INTERNAL_ERROR;
+            } else {
+                cif_kind_tp kind = (cif_kind_tp) *((const unsigned char *) data);
+                cif_quoted_tp quoted = (cif_quoted_tp) *((const unsigned char *) data + 1);
+                UChar *text;
+
+                if ((quoted != CIF_QUOTED) && (quoted != CIF_NOT_QUOTED)) return CIF_INTERNAL_ERROR;
+                data += 2;
+                if ((result = cif_decode_ustring_node(&data, end, &text)) != CIF_OK) return result;
+                if (text == NULL) return CIF_INTERNAL_ERROR;
+                if (kind == CIF_NUMB_KIND) {
+                    if ((result = cif_value_parse_numb(value, text)) != CIF_OK) {
+                        free(text);
+                        value->kind = CIF_UNK_KIND;
+                        return result;
+                    }
+                } else {
+                    value->as_char.text = text;
+                    value->as_char.shared = NULL;
+                    value->as_char.text_class = 0;
+                    value->kind = CIF_CHAR_KIND;
+                }
+                value->as_char.quoted = quoted;
+                return CIF_OK;
+            }
+        case CIF_LIST_KIND:
+            cif_list_init(&(value->as_list));
+            if ((result = cif_lazy_create(data + 1, size - 1, CIF_LIST_KIND, shared, &(value->as_list.lazy)))
+                    != CIF_OK) {
+                value->kind = CIF_UNK_KIND;
+            }
+            return result;
+        case CIF_TABLE_KIND:
+            cif_table_init(&(value->as_table));
+            if ((result = cif_lazy_create(data + 1, size - 1, CIF_TABLE_KIND, shared, &(value->as_table.lazy)))
+                    != CIF_OK) {
+                value->kind = CIF_UNK_KIND;
+            }
+            return result;
+        case CIF_NA_KIND:
+            value->kind = CIF_NA_KIND;
+            return CIF_OK;
+        case CIF_UNK_KIND:
+            value->kind = CIF_UNK_KIND;
+            return CIF_OK;
+        default:
+            return CIF_INTERNAL_ERROR;
+    }
+}
+
+static int cif_lazy_create(const char *data, size_t size, cif_kind_tp kind, struct shared_buffer_s *shared,
+        struct lazy_composite_s **lazy) {
+    FAILURE_HANDLING;
+    struct lazy_composite_s *temp;
+    size_t count;
+    size_t header_size;
+    size_t index;
+
+    /* validate the element index */
+    if (size < sizeof(uint32_t)) return CIF_INTERNAL_ERROR;
+    count = cif_read_uint32(data);
+    if (count > ((size / sizeof(uint32_t)) / 2)) return CIF_INTERNAL_ERROR;
+    header_size = (count + 2 + ((kind == CIF_TABLE_KIND) ? count : 0)) * sizeof(uint32_t);
+    if ((header_size > size) || (cif_read_uint32(data + sizeof(uint32_t)) != 0)
+            || (cif_read_uint32(data + (count + 1) * sizeof(uint32_t)) != size - header_size)) {
+        return CIF_INTERNAL_ERROR;
+    }
+    for (index = 1; index <= count; index += 1) {
+        if (cif_read_uint32(data + (index + 1) * sizeof(uint32_t)) < cif_read_uint32(data + index * sizeof(uint32_t))) {
+            return CIF_INTERNAL_ERROR;
+        }
+    }
+    if (kind == CIF_TABLE_KIND) {
+        for (index = 0; index < count; index += 1) {
+            if (cif_read_uint32(data + (count + 2 + index) * sizeof(uint32_t)) >= count) return CIF_INTERNAL_ERROR;
+        }
+    }
+
+    temp = (struct lazy_composite_s *) malloc(sizeof(struct lazy_composite_s));
+    if (temp == NULL) {
+        SET_RESULT(CIF_MEMORY_ERROR);
+    } else {
+        temp->data = ((shared != NULL) ? (char *) data : (char *) malloc(size));
+        if (temp->data == NULL) {
+            SET_RESULT(CIF_MEMORY_ERROR);
+        } else {
+            temp->elements = (cif_value_tp **) calloc((count > 0) ? count : 1, sizeof(cif_value_tp *));
+            if (temp->elements == NULL) {
+                SET_RESULT(CIF_MEMORY_ERROR);
+            } else {
+                if (shared == NULL) {
+                    memcpy(temp->data, data, size);
+                } else if (shared != &cif_borrowed_data) {
+                    shared->refs += 1;
+                }
+                temp->shared = shared;
+                temp->size = size;
+                temp->count = count;
+                temp->decoded = 0;
+                *lazy = temp;
+                return CIF_OK;
+            }
+            if (shared == NULL) free(temp->data);
+        }
+        free(temp);
+    }
+
+    FAILURE_TERMINUS;
+}
+
+static void cif_lazy_free(struct lazy_composite_s *lazy) {
+    size_t index;
+
+    for (index = 0; index < lazy->count; index += 1) {
+        cif_value_free(lazy->elements[index]);
+    }
+    free(lazy->elements);
+    cif_lazy_release_data(lazy);
+    free(lazy);
+}
+
+static void cif_lazy_release_data(struct lazy_composite_s *lazy) {
+    if (lazy->shared != NULL) {
+        cif_shared_release(lazy->shared);
+        lazy->shared = NULL;
+    } else {
+        free(lazy->data);
+    }
+    lazy->data = NULL;
+}
+
+/*
+ * Computes the bounds of the serialized data of the element at the specified serialized position of the specified lazy
+ * composite.  For a table, these are the bounds of the whole entry, starting with its key.
+ */
+static void cif_lazy_element_bounds(struct lazy_composite_s *lazy, cif_kind_tp kind, size_t index,
+        const char **start, const char **end) {
+    const char *body = lazy->data
+            + (lazy->count + 2 + ((kind == CIF_TABLE_KIND) ? lazy->count : 0)) * sizeof(uint32_t);
+
+    *start = body + cif_read_uint32(lazy->data + (index + 1) * sizeof(uint32_t));
+    *end = body + cif_read_uint32(lazy->data + (index + 2) * sizeof(uint32_t));
+}
+
+/*
+ * Advances the specified pointer past the serialized key and original key of a table entry, without decoding them
+ */
+static int cif_lazy_skip_keys(const char **next, const char *end) {
+    int i;
+
+    for (i = 0; i < 2; i += 1) {
+        uint32_t length;
+
+        if ((size_t) (end - *next) < sizeof(uint32_t)) return CIF_INTERNAL_ERROR;
+        length = cif_read_uint32(*next);
+        *next += sizeof(uint32_t);
+        if (length != NO_USTRING) {
+            if (((size_t) (end - *next) / sizeof(UChar)) < length) return CIF_INTERNAL_ERROR;
+            *next += length * sizeof(UChar);
+        }
+    }
+
+    return CIF_OK;
+}
+
+static int cif_lazy_get_element(struct lazy_composite_s *lazy, cif_kind_tp kind, size_t index,
+        cif_value_tp **element) {
+    if (lazy->elements[index] == NULL) {
+        const char *start;
+        const char *end;
+        cif_value_tp *value;
+        int result;
+
+        cif_lazy_element_bounds(lazy, kind, index, &start, &end);
+        if ((kind == CIF_TABLE_KIND) && ((result = cif_lazy_skip_keys(&start, end)) != CIF_OK)) {
+            return result;
+        }
+        if ((value = (cif_value_tp *) malloc(sizeof(cif_value_tp))) == NULL) {
+            return CIF_MEMORY_ERROR;
+        }
+        if ((result = cif_value_decode_node(start, (size_t) (end - start), lazy->shared, value)) != CIF_OK) {
+            free(value);
+            return result;
+        }
+        if (IS_SHARED(lazy->shared) && ((result = cif_value_share(value)) != CIF_OK)) {
+            /* the elements of a shared composite are themselves shared */
+            cif_value_free(value);
+            return result;
+        }
+        lazy->elements[index] = value;
+        lazy->decoded += 1;
+    }
+
+    *element = lazy->elements[index];
+    return CIF_OK;
+}
+
+/*
+ * Compares a Unicode string with the serialized key at the start of the specified data, in code unit order, with the
+ * same sense as u_strcmp()
+ */
+static int cif_lazy_compare_key(const UChar *key, const char *data, const char *end) {
+    uint32_t length;
+    uint32_t index;
+
+    if ((size_t) (end - data) < sizeof(uint32_t)) return -1;
+    length = cif_read_uint32(data);
+    data += sizeof(uint32_t);
+    if ((length == NO_USTRING) || (((size_t) (end - data) / sizeof(UChar)) < length)) return -1;
+
+    for (index = 0; index < length; index += 1) {
+        UChar unit;
+
+        memcpy(&unit, data + index * sizeof(UChar), sizeof(UChar));
+        if (key[index] != unit) {
+            /* this also covers the case where the key is a proper prefix of the serialized key */
+            return ((key[index] < unit) ? -1 : 1);
+        }
+    }
+
+    return ((key[index] == 0) ? 0 : 1);
+}
+
+static int cif_list_materialize(struct list_value_s *list) {
+    struct lazy_composite_s *lazy = list->lazy;
+    size_t index;
+
+    if (lazy != NULL) {
+        for (index = 0; index < lazy->count; index += 1) {
+            cif_value_tp *element;
+            int result = cif_lazy_get_element(lazy, CIF_LIST_KIND, index, &element);
+
+            if (result != CIF_OK) return result;
+        }
+
+        /* the list takes ownership of the elements */
+        list->elements = lazy->elements;
+        list->size = lazy->count;
+        list->capacity = ((lazy->count > 0) ? lazy->count : 1);
+        cif_lazy_release_data(lazy);
+        free(lazy);
+        list->lazy = NULL;
+    }
+
+    return CIF_OK;
+}
+
+static int cif_table_materialize(struct table_value_s *table) {
+    FAILURE_HANDLING;
+    struct lazy_composite_s *lazy = table->lazy;
+
+    if (lazy != NULL) {
+        const char *order = lazy->data + (lazy->count + 2) * sizeof(uint32_t);
+        UChar **keys;
+        struct table_value_s temp;
+        size_t index;
+        int result;
+
+        /* decode all the values */
+        for (index = 0; index < lazy->count; index += 1) {
+            cif_value_tp *element;
+
+            if ((result = cif_lazy_get_element(lazy, CIF_TABLE_KIND, index, &element)) != CIF_OK) return result;
+        }
+
+        /* decode all the keys, normalized followed by original */
+        keys = (UChar **) calloc(2 * lazy->count + 1, sizeof(UChar *));
+        if (keys == NULL) return CIF_MEMORY_ERROR;
+        for (index = 0; index < lazy->count; index += 1) {
+            const char *start;
+            const char *end;
+
+            cif_lazy_element_bounds(lazy, CIF_TABLE_KIND, index, &start, &end);
+            if (((result = cif_decode_ustring_node(&start, end, keys + 2 * index)) != CIF_OK)
+                    || ((result = cif_decode_ustring_node(&start, end, keys + 2 * index + 1)) != CIF_OK)) {
+                FAIL(keys, result);
+            } else if (keys[2 * index] == NULL) {
+                FAIL(keys, CIF_INTERNAL_ERROR);
+            }
+        }
+
+        /* the key index must list the keys in strictly increasing order, so there are no duplicates */
+        for (index = 1; index < lazy->count; index += 1) {
+            size_t previous = cif_read_uint32(order + (index - 1) * sizeof(uint32_t));
+            size_t current = cif_read_uint32(order + index * sizeof(uint32_t));
+
+            if (u_strcmp(keys[2 * previous], keys[2 * current]) >= 0) {
+                FAIL(keys, CIF_INTERNAL_ERROR);
+            }
+        }
+
+        /* build the map; additions cannot fail once sufficient capacity is reserved */
+        cif_table_init(&temp);
+        if ((result = cif_map_reserve_internal(&(temp.map), lazy->count)) != CIF_OK) FAIL(keys, result);
+        for (index = 0; index < lazy->count; index += 1) {
+            UChar *key = keys[2 * index];
+            UChar *key_orig = keys[2 * index + 1];
+
+            result = cif_map_add_internal(&(temp.map), key, ((key_orig == NULL) ? key : key_orig),
+                    lazy->elements[index], NULL);
+            assert(result == CIF_OK);
+        }
+
+        /* the map takes ownership of the keys and values */
+        free(keys);
+        table->map = temp.map;
+        free(lazy->elements);
+        cif_lazy_release_data(lazy);
+        free(lazy);
+        table->lazy = NULL;
+        return CIF_OK;
+
+        FAILURE_HANDLER(keys):
+        for (index = 0; index < 2 * lazy->count; index += 1) {
+            free(keys[index]);
+        }
+        free(keys);
+    } else {
+        return CIF_OK;
+    }
+
+    FAILURE_TERMINUS;
+}
+
+static struct shared_buffer_s *cif_shared_create(size_t size) {
+    struct shared_buffer_s *shared = (struct shared_buffer_s *) malloc(sizeof(struct shared_buffer_s) + size);
+
+    if (shared != NULL) {
+        shared->refs = 1;
+    }
+
+    return shared;
+}
+
+static void cif_shared_release(struct shared_buffer_s *shared) {
+    if (shared == &cif_borrowed_data) return;
+    assert(shared->refs > 0);
+    shared->refs -= 1;
+    if (shared->refs == 0) {
+        free(shared);
+    }
+}
+
+static int cif_char_share(struct char_value_s *char_value) {
+    if (!IS_SHARED(char_value->shared)) {
+        size_t text_size = (u_strlen(char_value->text) + 1) * sizeof(UChar);
+        struct shared_buffer_s *shared = cif_shared_create(text_size);
+
+        if (shared == NULL) return CIF_MEMORY_ERROR;
+        memcpy(SHARED_DATA(shared), char_value->text, text_size);
+        if (char_value->shared == NULL) free(char_value->text);
+        char_value->text = (UChar *) SHARED_DATA(shared);
+        char_value->shared = shared;
+    }
+
+    return CIF_OK;
+}
+
+static int cif_numb_share(struct numb_value_s *numb_value) {
+    if (!IS_SHARED(numb_value->shared)) {
+        /* the text, digits, and su digits are packed into one buffer, in that order */
+        size_t text_size = (u_strlen(numb_value->text) + 1) * sizeof(UChar);
+        size_t digits_size = strlen(numb_value->digits) + 1;
+        size_t su_size = ((numb_value->su_digits == NULL) ? 0 : (strlen(numb_value->su_digits) + 1));
+        struct shared_buffer_s *shared = cif_shared_create(text_size + digits_size + su_size);
+        char *data;
+
+        if (shared == NULL) return CIF_MEMORY_ERROR;
+        data = SHARED_DATA(shared);
+        memcpy(data, numb_value->text, text_size);
+        memcpy(data + text_size, numb_value->digits, digits_size);
+        if (numb_value->su_digits != NULL) {
+            memcpy(data + text_size + digits_size, numb_value->su_digits, su_size);
+        }
+        if (numb_value->shared == NULL) {
+            free(numb_value->text);
+            free(numb_value->digits);
+            free(numb_value->su_digits);
+        }
+        numb_value->text = (UChar *) data;
+        numb_value->digits = data + text_size;
+        numb_value->su_digits = ((su_size == 0) ? NULL : (data + text_size + digits_size));
+        numb_value->shared = shared;
+    }
+
+    return CIF_OK;
+}
+
+static int cif_lazy_share(struct lazy_composite_s *lazy) {
+    size_t index;
+
+    if (!IS_SHARED(lazy->shared)) {
+        struct shared_buffer_s *shared = cif_shared_create(lazy->size);
+
+        if (shared == NULL) return CIF_MEMORY_ERROR;
+        memcpy(SHARED_DATA(shared), lazy->data, lazy->size);
+        if (lazy->shared == NULL) free(lazy->data);
+        lazy->data = SHARED_DATA(shared);
+        lazy->shared = shared;
+    }
+
+    /* elements already decoded must be shared individually */
+    for (index = 0; index < lazy->count; index += 1) {
+        if (lazy->elements[index] != NULL) {
+            int result = cif_value_share(lazy->elements[index]);
+
+            if (result != CIF_OK) return result;
+        }
+    }
+
+    return CIF_OK;
+}
+
 static int format_text_decimal(double sign_num, char *digit_buf, char *su_buf, size_t su_size, int scale,
         UChar **result) {
-    int val_digits = strlen(digit_buf);
-    size_t total_chars = 
-              ((sign_num < 0) ? 1 : 0)                            /* sign */
-            + ((val_digits <= scale) ? (scale + 1) : val_digits)  /* value digits, including leading zeroes */
-            + ((scale == 0) ? 0 : 1)                              /* decimal point */
-            + ((su_size > 0) ? (su_size + 2) : 0)                 /* su, including parentheses */
-            + 1;                                                  /* terminator */
+    size_t total_chars = text_decimal_length(sign_num, digit_buf, su_size, scale);
 
     if (total_chars <= CIF_LINE_LENGTH + 1) {
         UChar *text = (UChar *) malloc(total_chars * sizeof(UChar));
@@ -872,38 +1667,51 @@ static int format_text_decimal(double sign_num, char *digit_buf, char *su_buf, s
         if (text == NULL) {
             return CIF_MEMORY_ERROR;
         } else {
-            UChar *c = text;
-            char *next_digit = digit_buf;
-            int whole_digits = val_digits - scale;
+            write_text_decimal(sign_num, digit_buf, su_buf, scale, text);
+            *result = text;
+            return CIF_OK;
+        }
+    } /* else formatted representation is too long; should be possible only for crazy scales */
 
-            /* The sign, if needed */
-            if (sign_num < 0) *(c++) = UCHAR_MINUS;
+    return CIF_ARGUMENT_ERROR;
+}
 
-            if (whole_digits <= 0) {
-                /* leading zeroes */
-                *(c++) = UCHAR_0;
-                *(c++) = UCHAR_DECIMAL;
-                while (whole_digits++ < 0) {
-                    *(c++) = (UChar) '0';
-                }
-            } else {
-                /* significant whole-number digits */
-                do {
-                    *(c++) = (UChar) *(next_digit++);
-                } while (--whole_digits > 0);
-                if (scale > 0) *(c++) = UCHAR_DECIMAL;
-            }
+static size_t text_decimal_length(double sign_num, const char *digit_buf, size_t su_size, int scale) {
+    int val_digits = strlen(digit_buf);
+
+    return    ((sign_num < 0) ? 1 : 0)                            /* sign */
+            + ((val_digits <= scale) ? (scale + 1) : val_digits)  /* value digits, including leading zeroes */
+            + ((scale == 0) ? 0 : 1)                              /* decimal point */
+            + ((su_size > 0) ? (su_size + 2) : 0)                 /* su, including parentheses */
+            + 1;                                                  /* terminator */
+}
 
-            /* significant fraction digits and uncertainty */
-            USTRCPY_C(c, next_digit);
-            WRITE_SU(c, su_buf);
+static void write_text_decimal(double sign_num, char *digit_buf, char *su_buf, int scale, UChar *text) {
+    UChar *c = text;
+    char *next_digit = digit_buf;
+    int whole_digits = (int) strlen(digit_buf) - scale;
 
-            *result = text;
-            return CIF_OK;
+    /* The sign, if needed */
+    if (sign_num < 0) *(c++) = UCHAR_MINUS;
+
+    if (whole_digits <= 0) {
+        /* leading zeroes */
+        *(c++) = UCHAR_0;
+        *(c++) = UCHAR_DECIMAL;
+        while (whole_digits++ < 0) {
+            *(c++) = (UChar) '0';
         }
-    } /* else formatted representation is too long; should be possible only for crazy scales */
+    } else {
+        /* significant whole-number digits */
+        do {
+            *(c++) = (UChar) *(next_digit++);
+        } while (--whole_digits > 0);
+        if (scale > 0) *(c++) = UCHAR_DECIMAL;
+    }
 
-    return CIF_ARGUMENT_ERROR;
+    /* significant fraction digits and uncertainty */
+    USTRCPY_C(c, next_digit);
+    WRITE_SU(c, su_buf);
 }
 
 static int format_text_sci(double sign_num, char *digit_buf, char *su_buf, size_t su_size, int scale,
@@ -1142,8 +1950,237 @@ static uintmax_t round_to_int(uintmax_t round_value, uint32_t *digits, int units
     return round_value + ((lsd < work_digit) ? 0 : round_it(0, 0, *work_digit, work_digit, lsd));
 }
 
+#ifdef FAST_DECIMAL_CONVERSION
+
+/* The largest power of ten that is exactly representable as a double */
+#define MAX_EXACT_POW10 22
+
+/* All non-negative integers up to and including this one are exactly representable as doubles */
+#define MAX_EXACT_INT (((uint64_t) 1) << DBL_MANT_DIG)
+
+/* The largest scale handled by to_digits_fast(); five to this power must fit in 63 bits */
+#define MAX_FAST_SCALE 27
+
+/* The largest number of decimal digits that always fits in a uint64_t */
+#define MAX_UINT64_DDIGITS 19
+
+static const double exact_pow10[MAX_EXACT_POW10 + 1] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static int to_digits_fast(double d, int scale, int negative, char **result) {
+    uint64_t mantissa;
+    uint64_t factor;
+    uint64_t hi;
+    uint64_t lo;
+    int exponent;
+    int shift;
+    int tail;  /* 0: exact; 1: below one half; 2: exactly one half; 3: above one half */
+    int round_up;
+
+    if ((scale < 0) || (scale > MAX_FAST_SCALE)) {
+        return 0;
+    }
+
+    /* d == mantissa * 2^exponent, exactly */
+    mantissa = (uint64_t) ldexp(frexp(d, &exponent), DBL_MANT_DIG);
+    exponent -= DBL_MANT_DIG;
+    for (factor = 1, shift = 0; shift < scale; shift += 1) {
+        factor *= 5;
+    }
+
+    /*
+     * d * 10^scale == (mantissa * 5^scale) * 2^(exponent + scale).  Form the 128-bit product hi:lo of the first two
+     * factors via 32-bit partial products.
+     */
+    {
+        uint64_t m0 = mantissa & 0xffffffffUL;
+        uint64_t m1 = mantissa >> 32;
+        uint64_t f0 = factor & 0xffffffffUL;
+        uint64_t f1 = factor >> 32;
+        uint64_t p00 = m0 * f0;
+        uint64_t p01 = m0 * f1;
+        uint64_t p10 = m1 * f0;
+        uint64_t middle = (p00 >> 32) + (p01 & 0xffffffffUL) + (p10 & 0xffffffffUL);
+
+        lo = (middle << 32) | (p00 & 0xffffffffUL);
+        hi = (m1 * f1) + (p01 >> 32) + (p10 >> 32) + (middle >> 32);
+    }
+    shift = exponent + scale;
+
+    if (shift >= 0) {
+        /* an integer; fall back to the general algorithm if it does not fit in 128 bits */
+        int bits = 0;
+        uint64_t top = ((hi != 0) ? hi : lo);
+
+        for (; top != 0; top >>= 1) bits += 1;
+        if (hi != 0) bits += 64;
+        if (bits + shift > 128) {
+            return 0;
+        } else if (shift >= 64) {
+            hi = lo << (shift - 64);
+            lo = 0;
+        } else if (shift > 0) {
+            hi = (hi << shift) | (lo >> (64 - shift));
+            lo <<= shift;
+        }
+        tail = 0;
+    } else if (shift <= -128) {
+        /* the product is less than 2^116, so the result is zero plus a nonzero tail less than one half */
+        hi = 0;
+        lo = 0;
+        tail = 1;
+    } else {
+        /* classify the bits to be shifted out relative to one half (bit -shift - 1) */
+        int half_bit = -shift - 1;
+        int half_set;
+        int below_half;
+
+        if (half_bit >= 64) {
+            half_set = (int) ((hi >> (half_bit - 64)) & 1);
+            below_half = ((lo != 0) || ((half_bit > 64) && ((hi & ((((uint64_t) 1) << (half_bit - 64)) - 1)) != 0)));
+        } else {
+            half_set = (int) ((lo >> half_bit) & 1);
+            below_half = ((half_bit > 0) && ((lo & ((((uint64_t) 1) << half_bit) - 1)) != 0));
+        }
+        tail = (half_set ? 2 : 0) + (below_half ? 1 : 0);
+
+        /* shift right */
+        shift = -shift;
+        if (shift >= 64) {
+            lo = hi >> (shift - 64);
+            hi = 0;
+        } else {
+            lo = (lo >> shift) | (hi << (64 - shift));
+            hi >>= shift;
+        }
+    }
+
+    /* round as round_it() does */
+#ifdef HAVE_FEGETROUND
+    switch (fegetround()) {
+        case FE_TOWARDZERO:
+            round_up = 0;
+            break;
+        case FE_DOWNWARD:
+            round_up = ((negative != 0) && (tail != 0));
+            break;
+        case FE_UPWARD:
+            round_up = ((negative == 0) && (tail != 0));
+            break;
+        default:
+        case FE_TONEAREST:
+#endif
+            round_up = ((tail == 3) || ((tail == 2) && ((lo & 1) != 0)));
+#ifdef HAVE_FEGETROUND
+            break;
+    }
+#endif
+    if (round_up) {
+        lo += 1;
+        if (lo == 0) hi += 1;
+    }
+
+    /* format the 128-bit result in decimal */
+    {
+        uint32_t limbs[4];
+        uint32_t chunks[(128 / 29) + 1];  /* base-BBASE digits, least-significant first */
+        int chunk_count = 0;
+        int ddigit_count;
+        char *work;
+
+        limbs[0] = (uint32_t) (hi >> 32);
+        limbs[1] = (uint32_t) (hi & 0xffffffffUL);
+        limbs[2] = (uint32_t) (lo >> 32);
+        limbs[3] = (uint32_t) (lo & 0xffffffffUL);
+
+        do {
+            uint64_t remainder = 0;
+            int i;
+
+            for (i = 0; i < 4; i += 1) {
+                uint64_t current = (remainder << 32) | limbs[i];
+
+                limbs[i] = (uint32_t) (current / BBASE);
+                remainder = current % BBASE;
+            }
+            chunks[chunk_count++] = (uint32_t) remainder;
+        } while ((limbs[0] | limbs[1] | limbs[2] | limbs[3]) != 0);
+
+        /* count the decimal digits of the most-significant chunk, forcing at least one */
+        ddigit_count = 1;
+        for (factor = chunks[chunk_count - 1] / 10; factor > 0; factor /= 10) ddigit_count += 1;
+        ddigit_count += (chunk_count - 1) * DDIG_PER_DIG;
+
+        *result = (char *) malloc(ddigit_count + 1);
+        if (*result != NULL) {
+            work = *result + ddigit_count;
+            *work = '\0';
+            for (shift = 0; shift < chunk_count; shift += 1) {
+                uint32_t chunk = chunks[shift];
+                int i;
+
+                for (i = 0; (i < DDIG_PER_DIG) && (work > *result); i += 1) {
+                    /* assumes the 'C' locale or one sufficiently similar: */
+                    *(--work) = (char) ((chunk % 10) + '0');
+                    chunk /= 10;
+                }
+            }
+        }
+    }
+
+    return 1;
+}
+
+static int to_double_fast(const char *ddigits, int scale, double *result) {
+    const char *end;
+    uint64_t significand = 0;
+    int exponent = -scale;
+
+    /* ignore trailing zeroes, accounting for them in the exponent */
+    for (end = ddigits; *end != '\0'; end += 1) ;
+    while (*(end - 1) == '0') {
+        end -= 1;
+        exponent += 1;
+    }
+
+    if (end - ddigits > MAX_UINT64_DDIGITS) {
+        return 0;
+    }
+    for (; ddigits < end; ddigits += 1) {
+        significand = (significand * 10) + (uint64_t) (*ddigits - '0');
+    }
+    if (significand > MAX_EXACT_INT) {
+        return 0;
+    }
+
+    if (exponent < 0) {
+        if (exponent < -MAX_EXACT_POW10) {
+            return 0;
+        }
+        *result = (double) significand / exact_pow10[-exponent];
+    } else {
+        /* move any excess power of ten into the significand, for as long as that remains exact */
+        for (; exponent > MAX_EXACT_POW10; exponent -= 1) {
+            if (significand > (MAX_EXACT_INT / 10)) {
+                return 0;
+            }
+            significand *= 10;
+        }
+        *result = (double) significand * exact_pow10[exponent];
+    }
+
+    return 1;
+}
+
+#endif
+
 static char *to_digits(double d, int scale) {
     int negative;
+#ifdef FAST_DECIMAL_CONVERSION
+    char *fast_result;
+#endif
 
     if (d < 0) {
         negative = 1;
@@ -1154,6 +2191,10 @@ static char *to_digits(double d, int scale) {
 
     if (d == 0.0) {
         return strdup("0");
+#ifdef FAST_DECIMAL_CONVERSION
+    } else if (to_digits_fast(d, scale, negative, &fast_result) != 0) {
+        return fast_result;
+#endif
     } else {
         uint32_t digits[DIG_PER_DBL + 1];
 
@@ -1280,8 +2321,9 @@ static char *to_digits(double d, int scale) {
             if (lsd < msd) {
                 msd = lsd;
                 /* no carry needed */
-                assert(*msd <= 1);
-                p10 = 1;
+                assert(*msd <= p10);
+                /* a rounded-up unit in the last place is truncated below like any other digit; a zero is kept */
+                if (*msd == 0) p10 = 1;
             } else {
                 /* Complete the rounding by applying any carry digit(s) -- iteratively, if necessary */
                 for (work_dig = lsd; *work_dig >= BBASE; ) {
@@ -1351,12 +2393,20 @@ static char *to_digits(double d, int scale) {
 
 /* FIXME: parts of the following assume DBL_MANT_DIG is not more than 64 and that FLT_RADIX is 2 */
 static double to_double(const char *ddigits, int scale) {
+#ifdef FAST_DECIMAL_CONVERSION
+    double fast_result;
+#endif
+
     /* skip leading zeroes: */
     while (*ddigits == '0') ddigits++;
 
     if (*ddigits == '\0') {
         /* all digits are zero */
         return 0.0;
+#ifdef FAST_DECIMAL_CONVERSION
+    } else if (to_double_fast(ddigits, scale, &fast_result) != 0) {
+        return fast_result;
+#endif
     } else {
         /* the least-significant decimal place in the input */
         int lsp = -scale;
@@ -1663,24 +2713,27 @@ static int cif_buf_write(write_buffer_tp *buf, const void *src, size_t len) {
         char *new_start;
 
         do {
-            proposed_cap = (working_cap * 3) >> 1;
+            proposed_cap = ((working_cap * 3) >> 1) + 1;
 
-            if (proposed_cap < working_cap) { /* overflow */
+            if (proposed_cap <= working_cap) { /* overflow */
                 /* fall back to requesting only what is imminently needed */
                 proposed_cap = needed_cap;
             }
+            working_cap = proposed_cap;
         } while (proposed_cap < needed_cap);
 
         /* reallocate the buffer space */
         new_start = (char *) realloc(buf->start, proposed_cap);
         if ((new_start == NULL) && (needed_cap < proposed_cap)) {
-            new_start = (char *) realloc(buf->start, needed_cap);
+            proposed_cap = needed_cap;
+            new_start = (char *) realloc(buf->start, proposed_cap);
         }
 
         if (new_start == NULL) {
             return CIF_MEMORY_ERROR;
         } else {
             buf->start = new_start;
+            buf->capacity = proposed_cap;
         }
     }
 
@@ -1784,6 +2837,8 @@ int cif_value_create(cif_kind_tp kind, cif_value_tp **value) {
                 temp->as_char.text = (UChar *) malloc(sizeof(UChar));
                 if (temp->as_char.text == NULL) FAIL(soft, CIF_MEMORY_ERROR);
                 *(temp->as_char.text) = 0;
+                temp->as_char.shared = NULL;
+                temp->as_char.text_class = 0;
                 temp->as_char.quoted = CIF_QUOTED;
                 temp->kind = CIF_CHAR_KIND;
                 break;
@@ -1863,9 +2918,18 @@ int cif_value_clone(cif_value_tp *value, cif_value_tp **clone) {
 
     switch (value->kind) {
         case CIF_CHAR_KIND:
-            temp->as_char.text = cif_u_strdup(value->as_char.text);
-            if (temp->as_char.text == NULL) FAIL(soft, CIF_MEMORY_ERROR);
+            if (IS_SHARED(value->as_char.shared)) {
+                /* the text is immutable; share it */
+                temp->as_char.text = value->as_char.text;
+                temp->as_char.shared = value->as_char.shared;
+                value->as_char.shared->refs += 1;
+            } else {
+                temp->as_char.text = cif_u_strdup(value->as_char.text);
+                if (temp->as_char.text == NULL) FAIL(soft, CIF_MEMORY_ERROR);
+                temp->as_char.shared = NULL;
+            }
             temp->as_char.quoted = value->as_char.quoted;
+            temp->as_char.text_class = value->as_char.text_class;
             temp->kind = CIF_CHAR_KIND;
             break;
         case CIF_NUMB_KIND:
@@ -1894,6 +2958,37 @@ int cif_value_clone(cif_value_tp *value, cif_value_tp **clone) {
     FAILURE_TERMINUS;
 }
 
+int cif_value_share(cif_value_tp *value) {
+    size_t index;
+    int result;
+
+    switch (value->kind) {
+        case CIF_CHAR_KIND:
+            return cif_char_share(&(value->as_char));
+        case CIF_NUMB_KIND:
+            return cif_numb_share(&(value->as_numb));
+        case CIF_LIST_KIND:
+            if (value->as_list.lazy != NULL) {
+                return cif_lazy_share(value->as_list.lazy);
+            }
+            for (index = 0; index < value->as_list.size; index += 1) {
+                if ((result = cif_value_share(value->as_list.elements[index])) != CIF_OK) return result;
+            }
+            return CIF_OK;
+        case CIF_TABLE_KIND:
+            if (value->as_table.lazy != NULL) {
+                return cif_lazy_share(value->as_table.lazy);
+            }
+            for (index = 0; index < value->as_table.map.size; index += 1) {
+                if ((result = cif_value_share(value->as_table.map.entries[index].value)) != CIF_OK) return result;
+            }
+            return CIF_OK;
+        default:
+            /* nothing to share for CIF_UNK_KIND or CIF_NA_KIND */
+            return CIF_OK;
+    }
+}
+
 /*
  * Note: in addition to its publicly-documented use, this function may be used to initialize value objects allocated on
  * the stack, provided that their kind is pre-initialized to CIF_UNK_KIND.
@@ -1912,6 +3007,8 @@ int cif_value_init(cif_value_tp *value, cif_kind_tp kind) {
                     result = CIF_MEMORY_ERROR;
                 } else {
                     *(value->as_char.text) = 0;
+                    value->as_char.shared = NULL;
+                    value->as_char.text_class = 0;
                     value->as_char.quoted = CIF_QUOTED;
                     value->kind = CIF_CHAR_KIND;
                 }
@@ -1945,7 +3042,15 @@ int cif_value_serialize(cif_value_tp *value, buffer_tp **buf) {
         SET_RESULT(CIF_MEMORY_ERROR);
     } else {
         write_buffer_tp *wbuf = &(temp->for_writing);  /* wbuf is an alias of temp */
-        SERIALIZE(value, wbuf, fail);
+        unsigned char header[2];
+        int result;
+
+        header[0] = SERIAL_FORMAT_TAG;
+        header[1] = SERIAL_FORMAT_VERSION;
+        if (((result = cif_buf_write(wbuf, header, 2)) != CIF_OK)
+                || ((result = cif_value_serialize_node(value, wbuf)) != CIF_OK)) {
+            FAIL(fail, result);
+        }
         *buf = temp;
         return CIF_OK;
 
@@ -1960,6 +3065,17 @@ int cif_value_deserialize(const void *src, size_t len, cif_value_tp *dest) {
     FAILURE_HANDLING;
     read_buffer_tp buf;
 
+    if ((len > 0) && (*((const unsigned char *) src) == SERIAL_FORMAT_TAG)) {
+        /* as in the original format, the value is left valid, and of unknown kind, if decoding fails */
+        dest->kind = CIF_UNK_KIND;
+        if ((len < 2) || (((const unsigned char *) src)[1] != SERIAL_FORMAT_VERSION)) {
+            return CIF_INTERNAL_ERROR;
+        } else {
+            return cif_value_decode_node((const char *) src + 2, len - 2, NULL, dest);
+        }
+    }
+
+    /* the original, unversioned format */
     buf.start = (const char *) src;
     buf.capacity = len;
     buf.limit = len;
@@ -1972,6 +3088,301 @@ int cif_value_deserialize(const void *src, size_t len, cif_value_tp *dest) {
     GENERAL_TERMINUS;
 }
 
+int cif_value_deserialize_borrowed_internal(const void *src, size_t len, cif_value_tp *dest) {
+    if ((len > 1) && (*((const unsigned char *) src) == SERIAL_FORMAT_TAG)
+            && (((const unsigned char *) src)[1] == SERIAL_FORMAT_VERSION)) {
+        return cif_value_decode_node((const char *) src + 2, len - 2, &cif_borrowed_data, dest);
+    } else {
+        /* other formats are not decoded lazily, so the data are not retained in any case */
+        return cif_value_deserialize(src, len, dest);
+    }
+}
+
+int cif_value_materialize_internal(cif_value_tp *value) {
+    switch (value->kind) {
+        case CIF_LIST_KIND:
+            return cif_list_materialize(&(value->as_list));
+        case CIF_TABLE_KIND:
+            return cif_table_materialize(&(value->as_table));
+        default:
+            return CIF_OK;
+    }
+}
+
+int cif_value_check_serialized_internal(const void *src, size_t len, cif_kind_tp kind) {
+    const unsigned char *bytes = (const unsigned char *) src;
+    cif_value_tp value;
+    int result;
+
+    if ((len < 3) || (bytes[0] != SERIAL_FORMAT_TAG) || (bytes[1] != SERIAL_FORMAT_VERSION) || (bytes[2] != kind)) {
+        return CIF_INTERNAL_ERROR;
+    } else if ((result = cif_value_decode_node((const char *) src + 2, len - 2, &cif_borrowed_data, &value))
+            == CIF_OK) {
+        result = cif_value_decode_all(&value);
+        cif_value_clean(&value);
+    }
+
+    return result;
+}
+
+static int cif_value_decode_all(cif_value_tp *value) {
+    size_t index;
+    int result;
+
+    if ((result = cif_value_materialize_internal(value)) != CIF_OK) {
+        return result;
+    }
+    switch (value->kind) {
+        case CIF_LIST_KIND:
+            for (index = 0; index < value->as_list.size; index += 1) {
+                if ((result = cif_value_decode_all(value->as_list.elements[index])) != CIF_OK) return result;
+            }
+            break;
+        case CIF_TABLE_KIND:
+            for (index = 0; index < value->as_table.map.size; index += 1) {
+                if ((result = cif_value_decode_all(value->as_table.map.entries[index].value)) != CIF_OK) return result;
+            }
+            break;
+        default:
+            break;
+    }
+
+    return CIF_OK;
+}
+
+int cif_table_get_lazy_item_internal(cif_value_tp *table, const UChar *key, cif_value_tp **value) {
+    struct lazy_composite_s *lazy = table->as_table.lazy;
+    const char *order = lazy->data + (lazy->count + 2) * sizeof(uint32_t);
+    UChar *key_norm;
+    size_t low = 0;
+    size_t high = lazy->count;
+    int result;
+
+    if ((result = cif_normalize_table_index(key, -1, &key_norm, CIF_NOSUCH_ITEM)) != CIF_OK) return result;
+
+    /* binary search of the key index */
+    result = CIF_NOSUCH_ITEM;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        size_t position = cif_read_uint32(order + mid * sizeof(uint32_t));
+        const char *start;
+        const char *end;
+        int comparison;
+
+        cif_lazy_element_bounds(lazy, CIF_TABLE_KIND, position, &start, &end);
+        comparison = cif_lazy_compare_key(key_norm, start, end);
+        if (comparison < 0) {
+            high = mid;
+        } else if (comparison > 0) {
+            low = mid + 1;
+        } else {
+            cif_value_tp *element;
+
+            result = cif_lazy_get_element(lazy, CIF_TABLE_KIND, position, &element);
+            if ((result == CIF_OK) && (value != NULL)) {
+                *value = element;
+            }
+            break;
+        }
+    }
+
+    free(key_norm);
+    return result;
+}
+
+/* the largest number of decimal digits that always fit in an sqlite3_int64 */
+#define MAX_INT64_DDIGITS 18
+
+int cif_digits_to_int64_internal(const char *digits, sqlite3_int64 *value) {
+    if (digits != NULL) {
+        sqlite3_int64 result = 0;
+        const char *c;
+
+        for (c = digits; (*c >= '0') && (*c <= '9'); c += 1) {
+            if ((c - digits) >= MAX_INT64_DDIGITS) {
+                return 0;
+            }
+            result = (result * 10) + (*c - '0');
+        }
+
+        if ((*c == '\0') && (c > digits)) {
+            *value = result;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+char *cif_int64_to_digits_internal(sqlite3_int64 value) {
+    char buffer[INT64_DIGITS_SIZE];
+
+    return strdup(cif_int64_format_digits_internal(value, buffer));
+}
+
+char *cif_int64_format_digits_internal(sqlite3_int64 value, char *buffer) {
+    /* an unsigned magnitude avoids overflow for the most negative value */
+    sqlite3_uint64 magnitude = ((value < 0) ? (((sqlite3_uint64) -(value + 1)) + 1) : (sqlite3_uint64) value);
+    char *c = buffer + (INT64_DIGITS_SIZE - 1);
+
+    *c = '\0';
+    do {
+        /* assumes the 'C' locale or one sufficiently similar: */
+        *(--c) = (char) ((magnitude % 10) + '0');
+        magnitude /= 10;
+    } while (magnitude > 0);
+
+    return c;
+}
+
+int cif_numb_text_is_canonical_internal(const cif_numb_tp *numb) {
+    const UChar *c = numb->text;
+    const char *next_digit = numb->digits;
+    int whole_digits;
+
+    if ((c == NULL) || (next_digit == NULL) || (numb->scale < 0)) {
+        return 0;
+    }
+
+    /* this mirrors format_text_decimal() */
+    whole_digits = (int) strlen(next_digit) - numb->scale;
+    if ((numb->sign < 0) && (*(c++) != UCHAR_MINUS)) {
+        return 0;
+    }
+    if (whole_digits <= 0) {
+        if ((*(c++) != UCHAR_0) || (*(c++) != UCHAR_DECIMAL)) {
+            return 0;
+        }
+        for (; whole_digits < 0; whole_digits += 1) {
+            if (*(c++) != UCHAR_0) return 0;
+        }
+    } else {
+        for (; whole_digits > 0; whole_digits -= 1) {
+            if (*(c++) != (UChar) *(next_digit++)) return 0;
+        }
+        if ((numb->scale > 0) && (*(c++) != UCHAR_DECIMAL)) {
+            return 0;
+        }
+    }
+    while (*next_digit != '\0') {
+        if (*(c++) != (UChar) *(next_digit++)) return 0;
+    }
+    if (numb->su_digits != NULL) {
+        if (*(c++) != UCHAR_OPEN) return 0;
+        for (next_digit = numb->su_digits; *next_digit != '\0'; ) {
+            if (*(c++) != (UChar) *(next_digit++)) return 0;
+        }
+        if (*(c++) != UCHAR_CLOSE) return 0;
+    }
+
+    /* the text must end here, and must not be too long to be formatted again */
+    return ((*c == 0) && ((c - numb->text) <= CIF_LINE_LENGTH));
+}
+
+int cif_numb_rebuild_text_internal(cif_numb_tp *numb) {
+    return format_text_decimal((double) numb->sign, numb->digits, numb->su_digits,
+            ((numb->su_digits == NULL) ? 0 : strlen(numb->su_digits)), numb->scale, &(numb->text));
+}
+
+size_t cif_numb_text_length_internal(const cif_numb_tp *numb) {
+    size_t total_chars = text_decimal_length((double) numb->sign, numb->digits,
+            ((numb->su_digits == NULL) ? 0 : strlen(numb->su_digits)), numb->scale);
+
+    return ((total_chars <= CIF_LINE_LENGTH + 1) ? total_chars : 0);
+}
+
+void cif_numb_write_text_internal(const cif_numb_tp *numb, UChar *text) {
+    write_text_decimal((double) numb->sign, numb->digits, numb->su_digits, numb->scale, text);
+}
+
+int cif_decimal_form_internal(const UChar *text, sqlite3_int64 *digits, sqlite3_int64 *su, int *scale) {
+    char digit_buffer[INT64_DIGITS_SIZE];
+    char su_buffer[INT64_DIGITS_SIZE];
+    cif_numb_tp numb;
+    const UChar *c = text;
+    sqlite3_int64 value = 0;
+    sqlite3_int64 uncertainty = -1;
+    int count = 0;
+    int fraction_digits = -1;
+
+    numb.sign = 1;
+    if (*c == UCHAR_MINUS) {
+        numb.sign = -1;
+        c += 1;
+    }
+    for (; ; c += 1) {
+        if ((*c >= UCHAR_0) && (*c <= UCHAR_9)) {
+            if (++count > MAX_INT64_DDIGITS) return 0;
+            value = (value * 10) + (*c - UCHAR_0);
+            if (fraction_digits >= 0) fraction_digits += 1;
+        } else if ((*c == UCHAR_DECIMAL) && (fraction_digits < 0)) {
+            fraction_digits = 0;
+        } else {
+            break;
+        }
+    }
+
+    /* a signed integer cannot carry negative zero */
+    if ((count == 0) || ((value == 0) && (numb.sign < 0))) {
+        return 0;
+    }
+
+    if (*c == UCHAR_OPEN) {
+        uncertainty = 0;
+        for (count = 0, c += 1; (*c >= UCHAR_0) && (*c <= UCHAR_9); c += 1) {
+            if (++count > MAX_INT64_DDIGITS) return 0;
+            uncertainty = (uncertainty * 10) + (*c - UCHAR_0);
+        }
+        if ((count == 0) || (*c != UCHAR_CLOSE)) {
+            return 0;
+        }
+    }
+
+    /* forms such as "007", "1.", ".5", and "1(02)" do not survive reformatting from the integers */
+    numb.text = (UChar *) text;
+    numb.digits = cif_int64_format_digits_internal(value, digit_buffer);
+    numb.su_digits = ((uncertainty < 0) ? NULL : cif_int64_format_digits_internal(uncertainty, su_buffer));
+    numb.scale = ((fraction_digits < 0) ? 0 : fraction_digits);
+    if (!cif_numb_text_is_canonical_internal(&numb)) {
+        return 0;
+    }
+
+    *digits = ((numb.sign < 0) ? -value : value);
+    *su = uncertainty;
+    *scale = numb.scale;
+    return 1;
+}
+
+size_t cif_decimal_text_length_internal(sqlite3_int64 digits, sqlite3_int64 su, int scale) {
+    char digit_buffer[INT64_DIGITS_SIZE];
+    char su_buffer[INT64_DIGITS_SIZE];
+    size_t total_chars = text_decimal_length(((digits < 0) ? -1.0 : 1.0),
+            cif_int64_format_digits_internal(digits, digit_buffer),
+            ((su < 0) ? 0 : strlen(cif_int64_format_digits_internal(su, su_buffer))), scale);
+
+    return (((scale >= 0) && (total_chars <= CIF_LINE_LENGTH + 1)) ? total_chars : 0);
+}
+
+void cif_decimal_write_text_internal(sqlite3_int64 digits, sqlite3_int64 su, int scale, UChar *text) {
+    char digit_buffer[INT64_DIGITS_SIZE];
+    char su_buffer[INT64_DIGITS_SIZE];
+
+    write_text_decimal(((digits < 0) ? -1.0 : 1.0), cif_int64_format_digits_internal(digits, digit_buffer),
+            ((su < 0) ? NULL : cif_int64_format_digits_internal(su, su_buffer)), scale, text);
+}
+
+UChar *cif_decimal_text_internal(sqlite3_int64 digits, sqlite3_int64 su, int scale) {
+    size_t length = cif_decimal_text_length_internal(digits, su, scale);
+    UChar *text;
+
+    if ((length == 0) || ((text = (UChar *) malloc(length * sizeof(UChar))) == NULL)) {
+        return NULL;
+    }
+    cif_decimal_write_text_internal(digits, su, scale, text);
+
+    return text;
+}
+
 int cif_value_parse_numb(cif_value_tp *n, UChar *text) {
     FAILURE_HANDLING;
     struct numb_value_s *numb = &(n->as_numb);
@@ -2123,6 +3534,7 @@ int cif_value_parse_numb(cif_value_tp *n, UChar *text) {
         numb->kind = CIF_NUMB_KIND;
         numb->quoted = CIF_NOT_QUOTED;
         numb->text = text;
+        numb->shared = NULL;
         numb->sign = n_temp.sign;
         numb->digits = n_temp.digits;
         numb->su_digits = n_temp.su_digits;
@@ -2144,6 +3556,8 @@ int cif_value_init_char(cif_value_tp *value, UChar *text) {
     } else {
         cif_value_clean(value);
         value->as_char.text = text;
+        value->as_char.shared = NULL;
+        value->as_char.text_class = 0;
         value->as_char.quoted = CIF_QUOTED;
         value->kind = CIF_CHAR_KIND;
         return CIF_OK;
@@ -2227,6 +3641,7 @@ int cif_value_init_numb(cif_value_tp *n, double val, double su, int scale, int m
                     numb->quoted = CIF_NOT_QUOTED;
                     numb->sign = (val < 0) ? -1 : 1;
                     numb->text = text;
+                    numb->shared = NULL;
                     numb->digits = digit_buf;
                     numb->su_digits = su_buf;
                     numb->scale = scale;
@@ -2512,15 +3927,29 @@ int cif_value_get_text(cif_value_tp *value, UChar **text) {
     return CIF_OK;
 }
 
+int cif_value_get_text_utf8(cif_value_tp *value, char **text) {
+    switch (value->kind) {
+        case CIF_CHAR_KIND:
+            /* fall through */
+        case CIF_NUMB_KIND:
+            assert(value->as_char.text != NULL);
+            /* transcode directly from the internal text, without an intermediate UTF-16 copy */
+            return cif_ustr_to_utf8_internal(value->as_char.text, -1, text);
+        default:
+            *text = NULL;
+            return CIF_OK;
+    }
+}
+
 int cif_value_get_element_count(
         cif_value_tp *value,
         size_t *count) {
     switch (value->kind) {
         case CIF_LIST_KIND:
-            *count = value->as_list.size;
+            *count = ((value->as_list.lazy != NULL) ? value->as_list.lazy->count : value->as_list.size);
             return CIF_OK;
         case CIF_TABLE_KIND:
-            *count = (size_t) HASH_COUNT(value->as_table.map.head);
+            *count = ((value->as_table.lazy != NULL) ? value->as_table.lazy->count : value->as_table.map.size);
             return CIF_OK;
         default:
             return CIF_ARGUMENT_ERROR;
@@ -2533,6 +3962,10 @@ int cif_value_get_element_at(
         cif_value_tp **element) {
     if (value->kind != CIF_LIST_KIND) {
         return CIF_ARGUMENT_ERROR;
+    } else if (value->as_list.lazy != NULL) {
+        /* decode only the requested element */
+        return ((index >= value->as_list.lazy->count) ? CIF_INVALID_INDEX
+                : cif_lazy_get_element(value->as_list.lazy, CIF_LIST_KIND, index, element));
     } else if (index >= value->as_list.size) {
         return CIF_INVALID_INDEX;
     } else {
@@ -2547,6 +3980,8 @@ int cif_value_set_element_at(
         cif_value_tp *element) {
     if (value->kind != CIF_LIST_KIND) {
         return CIF_ARGUMENT_ERROR;
+    } else if ((value->as_list.lazy != NULL) && (cif_list_materialize(&(value->as_list)) != CIF_OK)) {
+        return CIF_MEMORY_ERROR;
     } else if (index >= value->as_list.size) {
         return CIF_INVALID_INDEX;
     } else {
@@ -2570,6 +4005,8 @@ int cif_value_insert_element_at(
         cif_value_tp *element) {
     if (value->kind != CIF_LIST_KIND) {
         return CIF_ARGUMENT_ERROR;
+    } else if ((value->as_list.lazy != NULL) && (cif_list_materialize(&(value->as_list)) != CIF_OK)) {
+        return CIF_MEMORY_ERROR;
     } else if (index > value->as_list.size) {
         return CIF_INVALID_INDEX;
     } else {
@@ -2624,6 +4061,8 @@ int cif_value_remove_element_at(
         cif_value_tp **element) {
     if (value->kind != CIF_LIST_KIND) {
         return CIF_ARGUMENT_ERROR;
+    } else if ((value->as_list.lazy != NULL) && (cif_list_materialize(&(value->as_list)) != CIF_OK)) {
+        return CIF_MEMORY_ERROR;
     } else if (index >= value->as_list.size) {
         return CIF_INVALID_INDEX;
     } else {